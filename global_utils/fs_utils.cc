@@ -14,16 +14,23 @@
 
 #include "global_utils/fs_utils.h"
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
 
 #include <string>
+#include <vector>
 
+#include "file/base/path.h"
 #include "strings/substitute.h"
 #include "system_api/libc_fs_api.h"
 #include "util/errors.h"
 #include "util/task/codes.pb.h"
 #include "util/task/statusor.h"
 
+using ::file::JoinPath;
+using ::std::vector;
 using ::strings::Substitute;
 using ::system_api::GlobalLibcFsApi;
 using ::util::error::INVALID_ARGUMENT;
@@ -44,6 +51,24 @@ static bool IsRegFile(const struct stat &statbuf) {
   return S_ISREG(statbuf.st_mode);
 }
 
+// Size of the buffer directory entries are read into. Large enough for a few
+// hundred entries per getdents64() call.
+static const size_t kDirentBufferSize = 32768;
+
+// Flags to open directories with while reading them.
+static const int kOpenDirectoryFlags =
+    O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+// Returns the status for a failure to open 'dirpath' with the current errno.
+static Status OpenDirectoryError(const string &dirpath) {
+  if (errno == ENOENT) {
+    return {NOT_FOUND, Substitute("$0 is not found in the filesystem",
+                                  dirpath)};
+  }
+  return {INTERNAL, Substitute("Unable to open directory $0. Error: $1",
+                               dirpath, strerror(errno))};
+}
+
 class FsUtilsImpl : public FsUtils {
  public:
   FsUtilsImpl() {}
@@ -89,7 +114,112 @@ class FsUtilsImpl : public FsUtils {
     return true;
   }
 
+  StatusOr<vector<string>> ListSubdirectories(
+      const string &dirpath) const override {
+    const int fd = GlobalLibcFsApi()->Open(dirpath.c_str(),
+                                           kOpenDirectoryFlags);
+    if (fd < 0) {
+      return OpenDirectoryError(dirpath);
+    }
+    ::system_api::ScopedFileCloser fd_closer(fd);
+
+    return ListSubdirectoriesAt(fd, dirpath);
+  }
+
+  StatusOr<vector<string>> ListSubdirectoriesAt(
+      int dirfd, const string &dirpath) const override {
+    vector<string> subdirectories;
+    char buffer[kDirentBufferSize]
+        __attribute__((aligned(__alignof__(struct dirent64))));
+    while (true) {
+      const ssize_t bytes_read =
+          GlobalLibcFsApi()->GetDents64(dirfd, buffer, sizeof(buffer));
+      if (bytes_read < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return Status(INTERNAL,
+                      Substitute("Unable to read directory $0. Error: $1",
+                                 dirpath, strerror(errno)));
+      }
+      if (bytes_read == 0) {
+        return subdirectories;
+      }
+
+      for (ssize_t offset = 0; offset < bytes_read;) {
+        const struct dirent64 *entry =
+            reinterpret_cast<const struct dirent64 *>(buffer + offset);
+        offset += entry->d_reclen;
+
+        const char *name = entry->d_name;
+        if (name[0] == '.' &&
+            (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+          continue;
+        }
+
+        bool is_directory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+          // The filesystem does not report entry types.
+          struct stat statbuf;
+          if (GlobalLibcFsApi()->FStatAt(dirfd, name, &statbuf,
+                                         AT_SYMLINK_NOFOLLOW) == 0) {
+            is_directory = IsDirectory(statbuf);
+          } else if (errno != ENOENT) {
+            return Status(INTERNAL, Substitute("Unable to stat $0. Error: $1",
+                                               JoinPath(dirpath, name),
+                                               strerror(errno)));
+          }
+        }
+        if (is_directory) {
+          subdirectories.emplace_back(name);
+        }
+      }
+    }
+  }
+
+  Status WalkDirectoryTree(const string &dirpath,
+                           const DirectoryVisitor &visitor) const override {
+    const int fd = GlobalLibcFsApi()->Open(dirpath.c_str(),
+                                           kOpenDirectoryFlags);
+    if (fd < 0) {
+      return OpenDirectoryError(dirpath);
+    }
+    ::system_api::ScopedFileCloser fd_closer(fd);
+
+    return WalkSubdirectories(fd, dirpath, "", visitor);
+  }
+
  private:
+  // Walks the subdirectories of the open directory 'fd', whose path relative
+  // to the root of the walk 'dirpath' is 'relative_path'.
+  Status WalkSubdirectories(int fd, const string &dirpath,
+                            const string &relative_path,
+                            const DirectoryVisitor &visitor) const {
+    const vector<string> subdirectories = RETURN_IF_ERROR(
+        ListSubdirectoriesAt(fd, JoinPath(dirpath, relative_path)));
+
+    for (const string &name : subdirectories) {
+      const int subdirectory_fd =
+          GlobalLibcFsApi()->OpenAt(fd, name.c_str(), kOpenDirectoryFlags);
+      if (subdirectory_fd < 0) {
+        // Removed since its parent was read.
+        if (errno == ENOENT) {
+          continue;
+        }
+        return OpenDirectoryError(JoinPath(dirpath, relative_path, name));
+      }
+      ::system_api::ScopedFileCloser subdirectory_fd_closer(subdirectory_fd);
+
+      const string subdirectory_relative_path =
+          relative_path.empty() ? name : relative_path + "/" + name;
+      visitor(subdirectory_relative_path);
+      RETURN_IF_ERROR(WalkSubdirectories(subdirectory_fd, dirpath,
+                                         subdirectory_relative_path, visitor));
+    }
+
+    return Status::OK;
+  }
+
   // Creates a new directory at 'dirpath'. Returns INTERNAL if creating
   // directory fails for any reason including a directory already existing at
   // dirpath. 'mode' will be the mode applied to 'dirpath'.
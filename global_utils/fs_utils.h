@@ -15,7 +15,9 @@
 #ifndef GLOBAL_UTILS_FS_UTILS_H_
 #define GLOBAL_UTILS_FS_UTILS_H_
 
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "util/task/statusor.h"
 
@@ -49,6 +51,33 @@ class FsUtils {
   virtual ::util::StatusOr<bool> FileExists(
       const ::std::string &filepath) const = 0;
 
+  // Called by WalkDirectoryTree() with the path of each directory, relative to
+  // the root of the walk (e.g.: "sub", "sub/subsub").
+  typedef ::std::function<void(const string &relative_path)> DirectoryVisitor;
+
+  // Lists the names of the subdirectories of 'dirpath'. Entries are read with
+  // getdents64() and told apart by their d_type, they are only stat'd on
+  // filesystems that don't report it. Returns NOT_FOUND if 'dirpath' doesn't
+  // exist. Returns INTERNAL if any syscall fails.
+  virtual ::util::StatusOr< ::std::vector<string>> ListSubdirectories(
+      const string &dirpath) const = 0;
+
+  // Same as ListSubdirectories() for the open directory 'dirfd', which is read
+  // from its current offset. 'dirpath' is its path, used only in error
+  // messages. Does not take ownership of 'dirfd'. Returns INTERNAL if any
+  // syscall fails.
+  virtual ::util::StatusOr< ::std::vector<string>> ListSubdirectoriesAt(
+      int dirfd, const string &dirpath) const = 0;
+
+  // Calls 'visitor' with every directory under 'dirpath', depth-first and
+  // parents before their subdirectories. Each directory is read as in
+  // ListSubdirectories() and its subdirectories are opened relative to it, so
+  // no absolute path is built or resolved per entry. Directories removed
+  // during the walk are skipped. Returns NOT_FOUND if 'dirpath' doesn't exist.
+  // Returns INTERNAL if any syscall fails.
+  virtual ::util::Status WalkDirectoryTree(
+      const string &dirpath, const DirectoryVisitor &visitor) const = 0;
+
  protected:
   FsUtils() {}
 
@@ -32,6 +32,15 @@ class MockFsUtils : public FsUtils {
   MOCK_CONST_METHOD1(DirExists, ::util::Status(const string &dirpath));
   MOCK_CONST_METHOD1(FileExists, ::util::StatusOr<bool>(
       const string &filepath));
+  MOCK_CONST_METHOD1(ListSubdirectories,
+                     ::util::StatusOr< ::std::vector<string>>(
+                         const string &dirpath));
+  MOCK_CONST_METHOD2(ListSubdirectoriesAt,
+                     ::util::StatusOr< ::std::vector<string>>(
+                         int dirfd, const string &dirpath));
+  MOCK_CONST_METHOD2(WalkDirectoryTree,
+                     ::util::Status(const string &dirpath,
+                                    const DirectoryVisitor &visitor));
 };
 
 extern const FsUtils *GlobalFsUtils();
@@ -16,6 +16,7 @@
 #define INCLUDE_LMCTFY_H_
 
 #include <time.h>
+#include <map>
 #include <string>
 using ::std::string;
 #include <vector>
@@ -31,8 +32,6 @@ using ::std::string;
 namespace containers {
 namespace lmctfy {
 
-class Container;
-
 // lmctfy: Base Containers Library.
 //
 // Facilitates the creation, management, monitoring, and interaction with
@@ -91,95 +90,11 @@ class Container;
 // container. These threads shall be referred to as "tourist threads." This use
 // is in general discouraged as it can lead to hard to manage edge cases. Some
 // of these edge cases are described in the documentation below.
-//
-// Class is thread-safe.
-class ContainerApi {
- public:
-  // TODO(vishnuk): Empty Spec should trigger default initialization.
-  // Initializes the machine to start being able to create containers. All
-  // creations of ContainerApi objects will fail before this initialization is
-  // complete. This should be called once during machine boot.
-  //
-  // Regular users do NOT need to call this.
-  static ::util::Status InitMachine(const InitSpec &spec);
-
-  // Returns a new instance of ContainerApi iff the status is OK. The returned
-  // instance is thread-safe and the caller takes ownership.
-  static ::util::StatusOr<ContainerApi *> New();
-
-  virtual ~ContainerApi() {}
-
-  // Attach to an existing container. Get an object through which we can
-  // interact with that container. If the container does not exist, an error is
-  // returned.
-  //
-  // Multiple Get() operations on the same container (or a Create() and a Get())
-  // return different Container object instances pointing to the same underlying
-  // container. Any of these instances can be used to interact with the
-  // container and certain interactions are synchronized (those that specify
-  // it).
-  //
-  // Arguments:
-  //   container_name: The name of the existing container. The container name
-  //       format is outlined near the top of this file.
-  // Return:
-  //   StatusOr: OK iff the operation was successful. On success we populate an
-  //       object for container interactions and the caller takes ownership.
-  virtual ::util::StatusOr<Container *> Get(
-      StringPiece container_name) const = 0;
-
-  // Create a new container from the provided specification. Get an object
-  // through which we can interact with that container. If the container name
-  // already exists, an error is returned.
-  //
-  // Arguments:
-  //   container_name: The desired name for the new container. The container
-  //       name format is outlined near the top of this file.
-  //   spec: Container specification. Only resources that are specified will be
-  //       included in the container. All those resources not specified will
-  //       share their parent's limits.
-  // Return:
-  //   StatusOr: OK iff the operation was successful. On success we populate an
-  //       object for container interactions and the caller takes ownership.
-  virtual ::util::StatusOr<Container *> Create(
-      StringPiece container_name,
-      const ContainerSpec &spec) const = 0;
-
-  // Destroys the container and all subcontainers (recursive). Also kills any
-  // processes inside the containers being destroyed.
-  //
-  // Arguments:
-  //   container: The container to destroy. Takes ownership (and deletes) the
-  //       pointer on success.
-  // Return:
-  //   Status: OK iff the container was destroyed (and deleted). Otherwise, the
-  //       container is not destroyed (or deleted) and the caller retains
-  //       ownership.
-  virtual ::util::Status Destroy(Container *container) const = 0;
-
-  // Detect what container the specified thread is in.
-  //
-  // Arguments:
-  //   tid: The thread ID to check. 0 refers to self.
-  // Return:
-  //   StatusOr: OK iff the container exists. On success we populate the name of
-  //       the container in which the thread lives. The name is a full and
-  //       absolute name as described by the container name format near the top
-  //       of this file.
-  virtual ::util::StatusOr<string> Detect(pid_t tid) const = 0;
-  inline ::util::StatusOr<string> Detect() const { return Detect(0); }
-
- protected:
-  ContainerApi() {}
-
- private:
-  DISALLOW_COPY_AND_ASSIGN(ContainerApi);
-};
 
 // A lmctfy Container.
 //
 // Allows direct interactions with the container and its properties. Containers
-// are created and destroyed by the lmctfy library above.
+// are created and destroyed by the lmctfy library below.
 //
 // TODO(vmarmol): Make this thread-safe for calls on the same container object.
 // Class is thread-compatible. It is not inherently thread-safe, but can be made
@@ -450,6 +365,143 @@ class Container {
   DISALLOW_COPY_AND_ASSIGN(Container);
 };
 
+// Entry point for creating, attaching to, and destroying containers.
+//
+// Class is thread-safe.
+class ContainerApi {
+ public:
+  // TODO(vishnuk): Empty Spec should trigger default initialization.
+  // Initializes the machine to start being able to create containers. All
+  // creations of ContainerApi objects will fail before this initialization is
+  // complete. This should be called once during machine boot.
+  //
+  // Regular users do NOT need to call this.
+  static ::util::Status InitMachine(const InitSpec &spec);
+
+  // Returns a new instance of ContainerApi iff the status is OK. The returned
+  // instance is thread-safe and the caller takes ownership.
+  static ::util::StatusOr<ContainerApi *> New();
+
+  virtual ~ContainerApi() {}
+
+  // Attach to an existing container. Get an object through which we can
+  // interact with that container. If the container does not exist, an error is
+  // returned.
+  //
+  // Multiple Get() operations on the same container (or a Create() and a Get())
+  // return different Container object instances pointing to the same underlying
+  // container. Any of these instances can be used to interact with the
+  // container and certain interactions are synchronized (those that specify
+  // it).
+  //
+  // Arguments:
+  //   container_name: The name of the existing container. The container name
+  //       format is outlined near the top of this file.
+  // Return:
+  //   StatusOr: OK iff the operation was successful. On success we populate an
+  //       object for container interactions and the caller takes ownership.
+  virtual ::util::StatusOr<Container *> Get(
+      StringPiece container_name) const = 0;
+
+  // Create a new container from the provided specification. Get an object
+  // through which we can interact with that container. If the container name
+  // already exists, an error is returned.
+  //
+  // Arguments:
+  //   container_name: The desired name for the new container. The container
+  //       name format is outlined near the top of this file.
+  //   spec: Container specification. Only resources that are specified will be
+  //       included in the container. All those resources not specified will
+  //       share their parent's limits.
+  // Return:
+  //   StatusOr: OK iff the operation was successful. On success we populate an
+  //       object for container interactions and the caller takes ownership.
+  virtual ::util::StatusOr<Container *> Create(
+      StringPiece container_name,
+      const ContainerSpec &spec) const = 0;
+
+  // Destroys the container and all subcontainers (recursive). Also kills any
+  // processes inside the containers being destroyed.
+  //
+  // Arguments:
+  //   container: The container to destroy. Takes ownership (and deletes) the
+  //       pointer on success.
+  // Return:
+  //   Status: OK iff the container was destroyed (and deleted). Otherwise, the
+  //       container is not destroyed (or deleted) and the caller retains
+  //       ownership.
+  virtual ::util::Status Destroy(Container *container) const = 0;
+
+  // Detect what container the specified thread is in.
+  //
+  // Arguments:
+  //   tid: The thread ID to check. 0 refers to self.
+  // Return:
+  //   StatusOr: OK iff the container exists. On success we populate the name of
+  //       the container in which the thread lives. The name is a full and
+  //       absolute name as described by the container name format near the top
+  //       of this file.
+  virtual ::util::StatusOr<string> Detect(pid_t tid) const = 0;
+  inline ::util::StatusOr<string> Detect() const { return Detect(0); }
+
+  // Get the statistics of many containers in one call. This is equivalent to
+  // calling Get() followed by Container::Stats() on each container, but it
+  // avoids setting up a Container object (and its tasks and freezer handlers)
+  // for each container and shares the resource factories across all of them.
+  // Prefer this over a Get()/Stats() loop when polling many containers.
+  //
+  // Containers that do not exist (or that are destroyed while their stats are
+  // being gathered) are omitted from the output rather than failing the whole
+  // request. If errors is specified, so are containers whose stats can't be
+  // gathered, with their status in errors.
+  //
+  // Arguments:
+  //   container_names: The names of the containers whose stats to get. The
+  //       container name format is outlined near the top of this file.
+  //   type: The type of statistics to get for each container.
+  //   errors: If not nullptr, populated with the status of each container
+  //       whose name is invalid or whose stats can't be gathered, keyed by its
+  //       absolute name (or by its name as given if it is invalid). If nullptr,
+  //       the first such container fails the whole request.
+  // Return:
+  //   StatusOr: OK iff the operation was successful. On success we populate a
+  //       map from the absolute name of each existing container to its stats.
+  virtual ::util::StatusOr< ::std::map<string, ContainerStats>> StatsMany(
+      const ::std::vector<string> &container_names, Container::StatsType type,
+      ::std::map<string, ::util::Status> *errors) const = 0;
+  inline ::util::StatusOr< ::std::map<string, ContainerStats>> StatsMany(
+      const ::std::vector<string> &container_names,
+      Container::StatsType type) const {
+    return StatsMany(container_names, type, nullptr);
+  }
+
+  // Get the rates of a container's resource usage (e.g.: CPU cores used,
+  // throttle ratio, page fault rate) along with their distribution over time.
+  // Rates are computed from samples of the container's stats that this
+  // ContainerApi instance takes periodically in the background.
+  //
+  // The first call for a container starts sampling it and returns UNAVAILABLE
+  // since at least two samples are needed, call again after the sampling
+  // interval. The container is sampled until it is destroyed or its rates stop
+  // being requested.
+  //
+  // Arguments:
+  //   container_name: The name of the container whose rates to get. The
+  //       container name format is outlined near the top of this file.
+  // Return:
+  //   StatusOr: OK iff the operation was successful. On success we populate
+  //       the rates over the sampled window. UNAVAILABLE if not enough samples
+  //       have been taken yet.
+  virtual ::util::StatusOr<ContainerStatsRates> StatsRates(
+      StringPiece container_name) const = 0;
+
+ protected:
+  ContainerApi() {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ContainerApi);
+};
+
 }  // namespace lmctfy
 }  // namespace containers
 
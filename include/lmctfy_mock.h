@@ -23,6 +23,10 @@ namespace lmctfy {
 
 class MockContainerApi : public ContainerApi {
  public:
+  // Needed since the MOCK_* macros can't handle commas in the return type.
+  typedef ::std::map<string, ContainerStats> ContainerStatsMap;
+  typedef ::std::map<string, ::util::Status> StatusMap;
+
   virtual ~MockContainerApi() {}
 
   MOCK_CONST_METHOD1(Get,
@@ -32,6 +36,12 @@ class MockContainerApi : public ContainerApi {
                                                    const ContainerSpec &spec));
   MOCK_CONST_METHOD1(Destroy, ::util::Status(Container *container));
   MOCK_CONST_METHOD1(Detect, ::util::StatusOr<string>(pid_t pid));
+  MOCK_CONST_METHOD3(StatsMany, ::util::StatusOr<ContainerStatsMap>(
+                                    const ::std::vector<string> &names,
+                                    Container::StatsType type,
+                                    StatusMap *errors));
+  MOCK_CONST_METHOD1(StatsRates, ::util::StatusOr<ContainerStatsRates>(
+                                     StringPiece container_name));
 };
 
 typedef ::testing::NiceMock<MockContainerApi> NiceMockContainerApi;
@@ -29,7 +29,6 @@
 using ::file::JoinPath;
 using ::std::queue;
 using ::std::remove_if;
-using ::std::sort;
 using ::std::unique_ptr;
 using ::std::vector;
 using ::util::Status;
@@ -73,37 +72,19 @@ Status CgroupTasksHandler::Delegate(::util::UnixUid uid,
 
 StatusOr<vector<string>> CgroupTasksHandler::ListSubcontainers(
     TasksHandler::ListType type) const {
-  vector<string> subcontainers =
-      RETURN_IF_ERROR(cgroup_controller_->GetSubcontainers());
-  // Make the container names absolute by appending the subdirectory name to the
-  // current container's name.
+  // The recursive listing is sorted and served from the tree index when there
+  // is one.
+  vector<string> subcontainers = RETURN_IF_ERROR(
+      type == TasksHandler::ListType::RECURSIVE
+          ? cgroup_controller_->GetSubcontainersRecursive()
+          : cgroup_controller_->GetSubcontainers());
+
+  // Make the container names absolute by appending the subdirectory path to
+  // the current container's name.
   for (string &subcontainer : subcontainers) {
     subcontainer.assign(JoinPath(container_name_, subcontainer));
   }
 
-  if (type == TasksHandler::ListType::RECURSIVE) {
-    // Get all subcontainers of the subcontainers, recursively.
-    vector<string> to_check;
-    to_check.swap(subcontainers);
-    while (!to_check.empty()) {
-      unique_ptr<TasksHandler> handler(
-          RETURN_IF_ERROR(tasks_handler_factory_->Get(to_check.back())));
-
-      // We examine all subcontainers, add them to the result after having done
-      // so.
-      subcontainers.emplace_back(to_check.back());
-      to_check.pop_back();
-
-      // Get subcontainers and add them to the ones we will check.
-      const vector<string> containers = RETURN_IF_ERROR(
-          handler->ListSubcontainers(TasksHandler::ListType::SELF));
-      to_check.insert(to_check.end(), containers.begin(), containers.end());
-    }
-
-    // Ensure the result is sorted.
-    sort(subcontainers.begin(), subcontainers.end());
-  }
-
   return subcontainers;
 }
 
@@ -121,43 +102,42 @@ StatusOr<vector<pid_t>> CgroupTasksHandler::ListThreads(
   return tids;
 }
 
+Status CgroupTasksHandler::VisitProcesses(const PidVisitor &visitor) const {
+  return cgroup_controller_->VisitProcesses(visitor);
+}
+
+Status CgroupTasksHandler::VisitThreads(const PidVisitor &visitor) const {
+  return cgroup_controller_->VisitThreads(visitor);
+}
+
+StatusOr<ActiveNotifications::Handle>
+CgroupTasksHandler::RegisterEmptyNotification(Callback1<Status> *callback) {
+  return cgroup_controller_->RegisterEmptyNotification(callback);
+}
+
 Status CgroupTasksHandler::ListProcessesOrThreads(TasksHandler::ListType type,
                                                   PidsOrTids pids_or_tids,
                                                   vector<pid_t> *output) const {
-  if (pids_or_tids == PidsOrTids::PIDS) {
-    *output = RETURN_IF_ERROR(cgroup_controller_->GetProcesses());
-  } else {
-    *output = RETURN_IF_ERROR(cgroup_controller_->GetThreads());
-  }
-
   if (type == TasksHandler::ListType::RECURSIVE) {
-    set<pid_t> unique_pids(output->begin(), output->end());
-
-    // Get all subcontainers and list the PIDs/TIDs of those too.
-    const vector<string> subcontainers =
-        RETURN_IF_ERROR(ListSubcontainers(TasksHandler::ListType::RECURSIVE));
-    for (const string &subcontainer : subcontainers) {
-      StatusOr<vector<pid_t>> statusor;
-      unique_ptr<TasksHandler> handler(
-          RETURN_IF_ERROR(tasks_handler_factory_->Get(subcontainer)));
-      if (pids_or_tids == PidsOrTids::PIDS) {
-        statusor = handler->ListProcesses(TasksHandler::ListType::SELF);
-      } else {
-        statusor = handler->ListThreads(TasksHandler::ListType::SELF);
-      }
-      if (!statusor.ok()) {
-        return statusor.status();
-      }
-
-      // Aggregate PIDs/TIDS uniquely. Although TasksHandler guarantees that no
-      // PID/TID will be in two containers at the same time, our queries to the
-      // handler are not atomic so PIDs/TIDs may have moved since the last
-      // query.
-      unique_pids.insert(statusor.ValueOrDie().begin(),
-                         statusor.ValueOrDie().end());
+    // Aggregate PIDs/TIDS uniquely. Although TasksHandler guarantees that no
+    // PID/TID will be in two containers at the same time, the cgroups are not
+    // read atomically so PIDs/TIDs may have moved while they are read.
+    set<pid_t> unique_pids;
+    auto insert = [&unique_pids](pid_t pid) { unique_pids.insert(pid); };
+    if (pids_or_tids == PidsOrTids::PIDS) {
+      RETURN_IF_ERROR(cgroup_controller_->VisitProcessesRecursive(insert));
+    } else {
+      RETURN_IF_ERROR(cgroup_controller_->VisitThreadsRecursive(insert));
     }
 
     output->assign(unique_pids.begin(), unique_pids.end());
+    return Status::OK;
+  }
+
+  if (pids_or_tids == PidsOrTids::PIDS) {
+    *output = RETURN_IF_ERROR(cgroup_controller_->GetProcesses());
+  } else {
+    *output = RETURN_IF_ERROR(cgroup_controller_->GetThreads());
   }
 
   return Status::OK;
@@ -21,6 +21,7 @@
 using ::std::string;
 #include <vector>
 
+#include "base/logging.h"
 #include "system_api/kernel_api.h"
 #include "lmctfy/controllers/cgroup_controller.h"
 #include "lmctfy/tasks_handler.h"
@@ -74,6 +75,10 @@ class CgroupTasksHandler : public TasksHandler {
       ListType type) const override;
   ::util::StatusOr<::std::vector<pid_t>> ListThreads(
       ListType type) const override;
+  ::util::Status VisitProcesses(const PidVisitor &visitor) const override;
+  ::util::Status VisitThreads(const PidVisitor &visitor) const override;
+  ::util::StatusOr<ActiveNotifications::Handle> RegisterEmptyNotification(
+      Callback1< ::util::Status> *callback) override;
 
  private:
   enum class PidsOrTids {
@@ -126,6 +131,14 @@ class CgroupTasksHandlerFactory : public TasksHandlerFactory {
     CgroupController *cgroup_controller =
         RETURN_IF_ERROR(cgroup_controller_factory_->Create(container_name));
 
+    // Only the cgroups release notifications are registered for need the
+    // release agent, not the ones below them.
+    ::util::Status status = cgroup_controller->ClearReleaseNotification();
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to clear the release notification of \""
+                   << container_name << "\": " << status.error_message();
+    }
+
     return new CgroupTasksHandler(container_name, cgroup_controller, this);
   }
 
@@ -43,10 +43,12 @@ using ::std::unique_ptr;
 using ::strings::SubstituteAndAppend;
 using ::testing::Contains;
 using ::testing::DoAll;
+using ::testing::Invoke;
 using ::testing::NotNull;
 using ::testing::Return;
 using ::testing::SetArgPointee;
 using ::testing::StrictMock;
+using ::testing::_;
 using ::std::unique_ptr;
 using ::std::vector;
 using ::util::Status;
@@ -82,8 +84,11 @@ class CgroupTasksHandlerFactoryTest : public ::testing::Test {
 TEST_F(CgroupTasksHandlerFactoryTest, CreateSuccess) {
   ContainerSpec spec;
 
+  MockJobController *mock_controller = new StrictMockJobController();
+  EXPECT_CALL(*mock_controller, ClearReleaseNotification())
+      .WillOnce(Return(Status::OK));
   EXPECT_CALL(*mock_cgroup_controller_factory_, Create(kContainer))
-      .WillOnce(Return(new StrictMockJobController()));
+      .WillOnce(Return(mock_controller));
 
   StatusOr<TasksHandler *> statusor = factory_->Create(kContainer, spec);
   ASSERT_TRUE(statusor.ok());
@@ -91,6 +96,21 @@ TEST_F(CgroupTasksHandlerFactoryTest, CreateSuccess) {
   delete statusor.ValueOrDie();
 }
 
+TEST_F(CgroupTasksHandlerFactoryTest, CreateClearReleaseNotificationFails) {
+  ContainerSpec spec;
+
+  // The container is still created.
+  MockJobController *mock_controller = new StrictMockJobController();
+  EXPECT_CALL(*mock_controller, ClearReleaseNotification())
+      .WillOnce(Return(Status::CANCELLED));
+  EXPECT_CALL(*mock_cgroup_controller_factory_, Create(kContainer))
+      .WillOnce(Return(mock_controller));
+
+  StatusOr<TasksHandler *> statusor = factory_->Create(kContainer, spec);
+  ASSERT_OK(statusor);
+  delete statusor.ValueOrDie();
+}
+
 TEST_F(CgroupTasksHandlerFactoryTest, CreateFails) {
   ContainerSpec spec;
 
@@ -170,14 +190,6 @@ class CgroupTasksHandlerTest : public ::testing::Test {
     }
   }
 
-  // Expect to Get() a TasksHandler. This is not owned by the caller.
-  MockTasksHandler *ExpectGetTasksHandler(const string &container_name) {
-    MockTasksHandler *handler = new StrictMockTasksHandler(container_name);
-    EXPECT_CALL(*mock_tasks_handler_factory_, Get(container_name))
-        .WillOnce(Return(handler));
-    return handler;
-  }
-
  protected:
   MockCgroupController *mock_cgroup_controller_;
   unique_ptr<MockTasksHandlerFactory> mock_tasks_handler_factory_;
@@ -305,50 +317,30 @@ TEST_F(CgroupTasksHandlerTest, ListSubcontainersSelf_Fails) {
 }
 
 TEST_F(CgroupTasksHandlerTest, ListSubcontainersRecursive_Success) {
-  const string kContainer1 = JoinPath(kContainer, "sub1");
-  const string kContainer2 = JoinPath(kContainer, "sub2");
-  const string kContainer3 = JoinPath(kContainer, "sub1", "ssub1");
-  MockTasksHandler *mock_handler1 = ExpectGetTasksHandler(kContainer1);
-  MockTasksHandler *mock_handler2 = ExpectGetTasksHandler(kContainer2);
-  MockTasksHandler *mock_handler3 = ExpectGetTasksHandler(kContainer3);
+  EXPECT_CALL(*mock_cgroup_controller_, GetSubcontainersRecursive())
+      .WillRepeatedly(Return(vector<string>{"sub1", "sub1/ssub1", "sub2"}));
 
-  EXPECT_CALL(*mock_cgroup_controller_, GetSubcontainers())
-      .WillRepeatedly(Return(vector<string>{"sub1", "sub2"}));
+  StatusOr<vector<string>> statusor =
+      handler_->ListSubcontainers(TasksHandler::ListType::RECURSIVE);
+  ASSERT_OK(statusor);
+  EXPECT_EQ((vector<string>{JoinPath(kContainer, "sub1"),
+                            JoinPath(kContainer, "sub1", "ssub1"),
+                            JoinPath(kContainer, "sub2")}),
+            statusor.ValueOrDie());
+}
 
-  EXPECT_CALL(*mock_handler1, ListSubcontainers(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<string>{kContainer3}));
-  EXPECT_CALL(*mock_handler2, ListSubcontainers(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<string>()));
-  EXPECT_CALL(*mock_handler3, ListSubcontainers(TasksHandler::ListType::SELF))
+TEST_F(CgroupTasksHandlerTest, ListSubcontainersRecursive_NoSubcontainers) {
+  EXPECT_CALL(*mock_cgroup_controller_, GetSubcontainersRecursive())
       .WillRepeatedly(Return(vector<string>()));
 
   StatusOr<vector<string>> statusor =
       handler_->ListSubcontainers(TasksHandler::ListType::RECURSIVE);
   ASSERT_OK(statusor);
-
-  const vector<string> subcontainers = statusor.ValueOrDie();
-  EXPECT_EQ(3, subcontainers.size());
-  EXPECT_THAT(subcontainers, Contains(kContainer1));
-  EXPECT_THAT(subcontainers, Contains(kContainer2));
-  EXPECT_THAT(subcontainers, Contains(kContainer3));
+  EXPECT_TRUE(statusor.ValueOrDie().empty());
 }
 
 TEST_F(CgroupTasksHandlerTest, ListSubcontainersRecursive_Fails) {
-  const string kContainer1 = JoinPath(kContainer, "sub1");
-  const string kContainer2 = JoinPath(kContainer, "sub2");
-  const string kContainer3 = JoinPath(kContainer, "sub1", "ssub1");
-  MockTasksHandler *mock_handler1 = ExpectGetTasksHandler(kContainer1);
-  MockTasksHandler *mock_handler2 = ExpectGetTasksHandler(kContainer2);
-  MockTasksHandler *mock_handler3 = ExpectGetTasksHandler(kContainer3);
-
-  EXPECT_CALL(*mock_cgroup_controller_, GetSubcontainers())
-      .WillRepeatedly(Return(vector<string>{"sub1", "sub2"}));
-
-  EXPECT_CALL(*mock_handler1, ListSubcontainers(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<string>{kContainer3}));
-  EXPECT_CALL(*mock_handler2, ListSubcontainers(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<string>()));
-  EXPECT_CALL(*mock_handler3, ListSubcontainers(TasksHandler::ListType::SELF))
+  EXPECT_CALL(*mock_cgroup_controller_, GetSubcontainersRecursive())
       .WillRepeatedly(Return(Status::CANCELLED));
 
   EXPECT_EQ(
@@ -404,27 +396,36 @@ TEST_F(CgroupTasksHandlerPidsTidsTest, ListProcessesSelf_Success) {
   CheckPids(kExpected, statusor.ValueOrDie());
 }
 
+// Calls visitor with the PIDs of a cgroup and its descendants, one of which
+// moved between two of them while they were read.
+static Status VisitRecursivePids(const TasksHandler::PidVisitor &visitor) {
+  visitor(2);
+  visitor(1);
+  visitor(5);
+  visitor(3);
+  visitor(4);
+  visitor(5);
+  visitor(6);
+  return Status::OK;
+}
+
 TEST_F(CgroupTasksHandlerPidsTidsTest, ListProcessesRecursive_Success) {
-  EXPECT_CALL(*mock_cgroup_controller_, GetProcesses())
-      .WillRepeatedly(Return(vector<pid_t>{1, 2}));
-
-  // Expect 2 containers with 2 threads each.
-  const string sub1 = JoinPath(kContainer, "s1");
-  const string sub2 = JoinPath(kContainer, "s2");
-  EXPECT_CALL(*partial_handler_,
-              ListSubcontainers(TasksHandler::ListType::RECURSIVE))
-      .WillRepeatedly(Return(vector<string>{sub1, sub2}));
-  MockTasksHandler *handler1 = ExpectGetTasksHandler(sub1);
-  MockTasksHandler *handler2 = ExpectGetTasksHandler(sub2);
-  EXPECT_CALL(*handler1, ListProcesses(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<pid_t>{3, 4}));
-  EXPECT_CALL(*handler2, ListProcesses(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<pid_t>{5, 6}));
+  EXPECT_CALL(*mock_cgroup_controller_, VisitProcessesRecursive(_))
+      .WillOnce(Invoke(&VisitRecursivePids));
 
   StatusOr<vector<pid_t>> statusor =
       partial_handler_->ListProcesses(TasksHandler::ListType::RECURSIVE);
   ASSERT_OK(statusor);
-  CheckPids({1, 2, 3, 4, 5, 6}, statusor.ValueOrDie());
+  EXPECT_EQ((vector<pid_t>{1, 2, 3, 4, 5, 6}), statusor.ValueOrDie());
+}
+
+TEST_F(CgroupTasksHandlerPidsTidsTest, ListProcessesRecursive_Fails) {
+  EXPECT_CALL(*mock_cgroup_controller_, VisitProcessesRecursive(_))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED,
+            partial_handler_->ListProcesses(TasksHandler::ListType::RECURSIVE)
+                .status());
 }
 
 TEST_F(CgroupTasksHandlerPidsTidsTest, ListProcessesSelf_Empty) {
@@ -454,59 +455,18 @@ TEST_F(CgroupTasksHandlerPidsTidsTest, ListThreadsSelf_Success) {
 }
 
 TEST_F(CgroupTasksHandlerPidsTidsTest, ListThreadsRecursive_Success) {
-  EXPECT_CALL(*mock_cgroup_controller_, GetThreads())
-      .WillRepeatedly(Return(vector<pid_t>{1, 2}));
-
-  // Expect 2 containers with 2 threads each.
-  const string sub1 = JoinPath(kContainer, "s1");
-  const string sub2 = JoinPath(kContainer, "s2");
-  EXPECT_CALL(*partial_handler_,
-              ListSubcontainers(TasksHandler::ListType::RECURSIVE))
-      .WillRepeatedly(Return(vector<string>{sub1, sub2}));
-  MockTasksHandler *handler1 = ExpectGetTasksHandler(sub1);
-  MockTasksHandler *handler2 = ExpectGetTasksHandler(sub2);
-  EXPECT_CALL(*handler1, ListThreads(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<pid_t>{3, 4}));
-  EXPECT_CALL(*handler2, ListThreads(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<pid_t>{5, 6}));
+  EXPECT_CALL(*mock_cgroup_controller_, VisitThreadsRecursive(_))
+      .WillOnce(Invoke(&VisitRecursivePids));
 
   StatusOr<vector<pid_t>> statusor =
       partial_handler_->ListThreads(TasksHandler::ListType::RECURSIVE);
   ASSERT_OK(statusor);
-  CheckPids({1, 2, 3, 4, 5, 6}, statusor.ValueOrDie());
-}
-
-TEST_F(CgroupTasksHandlerPidsTidsTest,
-       ListThreadsRecursive_ListSubcontainersFails) {
-  EXPECT_CALL(*mock_cgroup_controller_, GetThreads())
-      .WillRepeatedly(Return(vector<pid_t>{1, 2}));
-
-  const string sub1 = JoinPath(kContainer, "s1");
-  const string sub2 = JoinPath(kContainer, "s2");
-  EXPECT_CALL(*partial_handler_,
-              ListSubcontainers(TasksHandler::ListType::RECURSIVE))
-      .WillRepeatedly(Return(Status::CANCELLED));
-
-  EXPECT_EQ(Status::CANCELLED,
-            partial_handler_->ListThreads(TasksHandler::ListType::RECURSIVE)
-                .status());
+  EXPECT_EQ((vector<pid_t>{1, 2, 3, 4, 5, 6}), statusor.ValueOrDie());
 }
 
-TEST_F(CgroupTasksHandlerPidsTidsTest, ListThreadsRecursive_ListThreadsFails) {
-  EXPECT_CALL(*mock_cgroup_controller_, GetThreads())
-      .WillRepeatedly(Return(vector<pid_t>{1, 2}));
-
-  const string sub1 = JoinPath(kContainer, "s1");
-  const string sub2 = JoinPath(kContainer, "s2");
-  EXPECT_CALL(*partial_handler_,
-              ListSubcontainers(TasksHandler::ListType::RECURSIVE))
-      .WillRepeatedly(Return(vector<string>{sub1, sub2}));
-  MockTasksHandler *handler1 = ExpectGetTasksHandler(sub1);
-  MockTasksHandler *handler2 = ExpectGetTasksHandler(sub2);
-  EXPECT_CALL(*handler1, ListThreads(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(vector<pid_t>{3, 4}));
-  EXPECT_CALL(*handler2, ListThreads(TasksHandler::ListType::SELF))
-      .WillRepeatedly(Return(Status::CANCELLED));
+TEST_F(CgroupTasksHandlerPidsTidsTest, ListThreadsRecursive_Fails) {
+  EXPECT_CALL(*mock_cgroup_controller_, VisitThreadsRecursive(_))
+      .WillOnce(Return(Status::CANCELLED));
 
   EXPECT_EQ(Status::CANCELLED,
             partial_handler_->ListThreads(TasksHandler::ListType::RECURSIVE)
@@ -523,6 +483,76 @@ TEST_F(CgroupTasksHandlerPidsTidsTest, ListThreadsSelf_Empty) {
   EXPECT_EQ(0, statusor.ValueOrDie().size());
 }
 
+// Tests for VisitProcesses() and VisitThreads().
+
+// Calls visitor with 1, 2 and 3.
+static Status VisitThreePids(const TasksHandler::PidVisitor &visitor) {
+  visitor(1);
+  visitor(2);
+  visitor(3);
+  return Status::OK;
+}
+
+TEST_F(CgroupTasksHandlerTest, VisitProcessesSuccess) {
+  EXPECT_CALL(*mock_cgroup_controller_, VisitProcesses(_))
+      .WillOnce(Invoke(&VisitThreePids));
+
+  vector<pid_t> pids;
+  ASSERT_OK(handler_->VisitProcesses(
+      [&pids](pid_t pid) { pids.push_back(pid); }));
+  EXPECT_EQ((vector<pid_t>{1, 2, 3}), pids);
+}
+
+TEST_F(CgroupTasksHandlerTest, VisitProcessesFails) {
+  EXPECT_CALL(*mock_cgroup_controller_, VisitProcesses(_))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED, handler_->VisitProcesses([](pid_t pid) {}));
+}
+
+TEST_F(CgroupTasksHandlerTest, VisitThreadsSuccess) {
+  EXPECT_CALL(*mock_cgroup_controller_, VisitThreads(_))
+      .WillOnce(Invoke(&VisitThreePids));
+
+  vector<pid_t> tids;
+  ASSERT_OK(handler_->VisitThreads(
+      [&tids](pid_t tid) { tids.push_back(tid); }));
+  EXPECT_EQ((vector<pid_t>{1, 2, 3}), tids);
+}
+
+TEST_F(CgroupTasksHandlerTest, VisitThreadsFails) {
+  EXPECT_CALL(*mock_cgroup_controller_, VisitThreads(_))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED, handler_->VisitThreads([](pid_t tid) {}));
+}
+
+void NoopEmptyCallback(Status status) {}
+
+TEST_F(CgroupTasksHandlerTest, RegisterEmptyNotificationSuccess) {
+  unique_ptr<Callback1<Status>> callback(
+      NewPermanentCallback(&NoopEmptyCallback));
+  EXPECT_CALL(*mock_cgroup_controller_,
+              RegisterEmptyNotification(callback.get()))
+      .WillOnce(Return(1));
+
+  StatusOr<ActiveNotifications::Handle> statusor =
+      handler_->RegisterEmptyNotification(callback.get());
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
+TEST_F(CgroupTasksHandlerTest, RegisterEmptyNotificationFails) {
+  unique_ptr<Callback1<Status>> callback(
+      NewPermanentCallback(&NoopEmptyCallback));
+  EXPECT_CALL(*mock_cgroup_controller_,
+              RegisterEmptyNotification(callback.get()))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    handler_->RegisterEmptyNotification(callback.get()));
+}
+
 }  // namespace
 }  // namespace lmctfy
 }  // namespace containers
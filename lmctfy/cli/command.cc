@@ -250,9 +250,10 @@ Status RunCommand(const vector<string> &args, OutputMap::Style output_style,
         return status;
       }
 
-      // Create the lmctfy object except for the initialization commands.
+      // Create the lmctfy object except for the initialization commands and
+      // callers that did not provide a factory.
       unique_ptr<ContainerApi> lmctfy;
-      if (command->type != CMD_TYPE_INIT) {
+      if (command->type != CMD_TYPE_INIT && lmctfy_factory != nullptr) {
         StatusOr<ContainerApi *> statusor = lmctfy_factory->Run();
         if (!statusor.ok()) {
           fprintf(stderr,
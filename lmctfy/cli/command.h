@@ -137,7 +137,8 @@ void RegisterRootCommand(const Command &new_command);
 typedef ResultCallback< ::util::StatusOr<ContainerApi *>> ContainerApiFactory;
 
 // Looks up a command and executes it, or prints help. Does not own
-// lmctfy_factory which must be a repeatable callback.
+// lmctfy_factory which must be a repeatable callback. If lmctfy_factory is
+// NULL, no ContainerApi is created and the command receives a NULL lmctfy.
 ::util::Status RunCommand(const ::std::vector<string> &args,
                           OutputMap::Style output_style,
                           ContainerApiFactory *lmctfy_factory,
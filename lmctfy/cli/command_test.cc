@@ -53,6 +53,13 @@ static Status CommandFunc2(const vector<string> &argv, const ContainerApi *lmctf
   return cmd_func_retval;
 }
 
+static bool cmd_func_had_lmctfy;
+static Status CommandFunc3(const vector<string> &argv,
+                           const ContainerApi *lmctfy, OutputMap *output) {
+  cmd_func_had_lmctfy = lmctfy != nullptr;
+  return Status::OK;
+}
+
 class CommandTest : public ::testing::Test {
  protected:
   virtual void TearDown() {
@@ -196,6 +203,7 @@ class SampleTreeCommandTest : public ::testing::Test {
       CMD("c1", "This does a", "", CMD_TYPE_GETTER, 0, 0, &CommandFunc1),
       CMD("c2", "This does b", "", CMD_TYPE_GETTER, 0, 0, &CommandFunc2),
       CMD("c3", "This does c", "", CMD_TYPE_GETTER, 0, 0, &CommandFunc1),
+      CMD("c4", "This does d", "", CMD_TYPE_GETTER, 0, 0, &CommandFunc3),
     });
     RegisterRootCommand(root1);
     RegisterRootCommand(root2);
@@ -261,6 +269,21 @@ TEST_F(SampleTreeCommandTest, RunCommand) {
   EXPECT_EQ(0, cmd_func_magic);
 }
 
+TEST_F(SampleTreeCommandTest, RunCommandWithoutFactory) {
+  vector<string> args = {"test", "r2", "c4"};
+  unique_ptr<ContainerApiFactory> mock_factory(NewPermanentCallback(&MockFactory));
+
+  cmd_func_had_lmctfy = false;
+  EXPECT_TRUE(
+      RunCommand(args, OutputMap::STYLE_VALUES, mock_factory.get(), stdout)
+          .ok());
+  EXPECT_TRUE(cmd_func_had_lmctfy);
+
+  cmd_func_had_lmctfy = true;
+  EXPECT_TRUE(RunCommand(args, OutputMap::STYLE_VALUES, nullptr, stdout).ok());
+  EXPECT_FALSE(cmd_func_had_lmctfy);
+}
+
 TEST_F(SampleTreeCommandTest, FindPartialCommandAndPrintUsageNormal) {
   // When a valid partial command is passed to FindPartialCommandAndPrintUsage,
   // it should print out the correct usage information for the indicated
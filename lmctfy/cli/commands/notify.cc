@@ -111,6 +111,78 @@ Status MemoryThresholdHandler(const vector<string> &argv,
   return RegisterNotification(spec, container_name, lmctfy, output);
 }
 
+// Register and wait for a pressure stall threshold notification on the
+// specified resource.
+static Status PressureHandler(EventSpec::PressureThreshold::Resource resource,
+                              const vector<string> &argv,
+                              const ContainerApi *lmctfy, OutputMap *output) {
+  // Args: pressure <container name> <threshold in usecs> <window in usecs>
+  //           [some|full]
+  if (argv.size() != 4 && argv.size() != 5) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  "See help for supported options.");
+  }
+  const string container_name = argv[1];
+  int64 threshold;
+  if (!SimpleAtoi(argv[2], &threshold)) {
+    return Status(
+        ::util::error::INVALID_ARGUMENT,
+        Substitute("Failed to parse a threshold from \"$0\"", argv[2]));
+  }
+  int64 window;
+  if (!SimpleAtoi(argv[3], &window)) {
+    return Status(
+        ::util::error::INVALID_ARGUMENT,
+        Substitute("Failed to parse a window from \"$0\"", argv[3]));
+  }
+
+  EventSpec spec;
+  EventSpec::PressureThreshold *pressure = spec.mutable_pressure_threshold();
+  pressure->set_resource(resource);
+  pressure->set_threshold(threshold);
+  pressure->set_window(window);
+  if (argv.size() == 5) {
+    if (argv[4] == "some") {
+      pressure->set_type(EventSpec::PressureThreshold::SOME);
+    } else if (argv[4] == "full") {
+      pressure->set_type(EventSpec::PressureThreshold::FULL);
+    } else {
+      return Status(::util::error::INVALID_ARGUMENT,
+                    Substitute("Unknown stall type \"$0\", expected \"some\" "
+                               "or \"full\"",
+                               argv[4]));
+    }
+  }
+  return RegisterNotification(spec, container_name, lmctfy, output);
+}
+
+Status MemoryPressureHandler(const vector<string> &argv,
+                             const ContainerApi *lmctfy, OutputMap *output) {
+  return PressureHandler(EventSpec::PressureThreshold::MEMORY, argv, lmctfy,
+                         output);
+}
+
+Status CpuPressureHandler(const vector<string> &argv,
+                          const ContainerApi *lmctfy, OutputMap *output) {
+  return PressureHandler(EventSpec::PressureThreshold::CPU, argv, lmctfy,
+                         output);
+}
+
+// Register and wait for a container empty notification.
+Status ContainerEmptyHandler(const vector<string> &argv,
+                             const ContainerApi *lmctfy, OutputMap *output) {
+  // Args: empty <container name>
+  if (argv.size() != 2) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  "See help for supported options.");
+  }
+  const string container_name = argv[1];
+
+  EventSpec spec;
+  spec.mutable_container_empty();
+  return RegisterNotification(spec, container_name, lmctfy, output);
+}
+
 void RegisterNotifyCommands() {
   RegisterRootCommand(SUB(
       "notify",
@@ -130,7 +202,37 @@ void RegisterNotifyCommands() {
                 "The notification is triggered when the memory usage goes "
                 "above the specified threshold.",
                 "<container name> <threshold in bytes>", CMD_TYPE_SETTER, 2, 2,
-                &MemoryThresholdHandler)})}));
+                &MemoryThresholdHandler),
+            CMD("pressure",
+                "Register for and deliver a memory pressure notification. "
+                "The notification is triggered when the tasks of the "
+                "container were stalled on memory for longer than the "
+                "threshold within the window. Requires the cgroup v2 unified "
+                "hierarchy.",
+                "<container name> <threshold in usecs> <window in usecs> "
+                "[some|full]",
+                CMD_TYPE_SETTER, 3, 4, &MemoryPressureHandler)}),
+       SUB("cpu", "Register for and deliver a CPU related notification.",
+           "<event> <container name> [<event arguments>]",
+           {CMD("pressure",
+                "Register for and deliver a CPU pressure notification. "
+                "The notification is triggered when the tasks of the "
+                "container were stalled on CPU for longer than the threshold "
+                "within the window. Requires the cgroup v2 unified "
+                "hierarchy.",
+                "<container name> <threshold in usecs> <window in usecs> "
+                "[some|full]",
+                CMD_TYPE_SETTER, 3, 4, &CpuPressureHandler)}),
+       SUB("container",
+           "Register for and deliver a notification about the container "
+           "itself.",
+           "<event> <container name>",
+           {CMD("empty",
+                "Register for and deliver a container empty notification. "
+                "The notification is triggered when the container and its "
+                "subcontainers no longer have any processes or threads.",
+                "<container name>", CMD_TYPE_SETTER, 1, 1,
+                &ContainerEmptyHandler)})}));
 }
 
 }  // namespace cli
@@ -40,6 +40,21 @@ class OutputMap;
                                       const ContainerApi *lmctfy,
                                       OutputMap *output);
 
+// Register and wait for a memory pressure stall threshold notification.
+::util::Status MemoryPressureHandler(const ::std::vector<string> &argv,
+                                     const ContainerApi *lmctfy,
+                                     OutputMap *output);
+
+// Register and wait for a CPU pressure stall threshold notification.
+::util::Status CpuPressureHandler(const ::std::vector<string> &argv,
+                                  const ContainerApi *lmctfy,
+                                  OutputMap *output);
+
+// Register and wait for a container empty notification.
+::util::Status ContainerEmptyHandler(const ::std::vector<string> &argv,
+                                     const ContainerApi *lmctfy,
+                                     OutputMap *output);
+
 void RegisterNotifyCommands();
 
 }  // namespace cli
@@ -161,6 +161,97 @@ TEST_F(NotifyTest, MemoryOomRegisterFails) {
   EXPECT_NOT_OK(MemoryOomHandler(args, mock_lmctfy_.get(), &output_));
 }
 
+TEST_F(NotifyTest, ContainerEmptySuccess) {
+  const vector<string> args = {"empty", kContainerName};
+  EventSpec spec;
+  spec.mutable_container_empty();
+
+  EXPECT_CALL(*mock_lmctfy_, Get(kContainerName))
+      .WillOnce(Return(mock_container_));
+  EXPECT_CALL(*mock_container_,
+              RegisterNotification(EqualsInitializedProto(spec), NotNull()))
+      .WillOnce(
+           DoAll(Invoke(&RunCallback), Invoke(&DeleteCallback), Return(1)));
+
+  EXPECT_OK(ContainerEmptyHandler(args, mock_lmctfy_.get(), &output_));
+}
+
+TEST_F(NotifyTest, ContainerEmptyRegisterFails) {
+  const vector<string> args = {"empty", kContainerName};
+  EventSpec spec;
+  spec.mutable_container_empty();
+
+  EXPECT_CALL(*mock_lmctfy_, Get(kContainerName))
+      .WillOnce(Return(mock_container_));
+  EXPECT_CALL(*mock_container_,
+              RegisterNotification(EqualsInitializedProto(spec), NotNull()))
+      .WillOnce(DoAll(Invoke(&DeleteCallback), Return(Status::CANCELLED)));
+
+  EXPECT_NOT_OK(ContainerEmptyHandler(args, mock_lmctfy_.get(), &output_));
+}
+
+TEST_F(NotifyTest, MemoryPressureSuccess) {
+  const vector<string> args = {"pressure", kContainerName, "100000", "1000000",
+                               "full"};
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::MEMORY);
+  spec.mutable_pressure_threshold()->set_type(
+      EventSpec::PressureThreshold::FULL);
+  spec.mutable_pressure_threshold()->set_threshold(100000);
+  spec.mutable_pressure_threshold()->set_window(1000000);
+
+  EXPECT_CALL(*mock_lmctfy_, Get(kContainerName))
+      .WillOnce(Return(mock_container_));
+  EXPECT_CALL(*mock_container_,
+              RegisterNotification(EqualsInitializedProto(spec), NotNull()))
+      .WillOnce(
+           DoAll(Invoke(&RunCallback), Invoke(&DeleteCallback), Return(1)));
+
+  EXPECT_OK(MemoryPressureHandler(args, mock_lmctfy_.get(), &output_));
+}
+
+TEST_F(NotifyTest, CpuPressureSuccess) {
+  const vector<string> args = {"pressure", kContainerName, "100000",
+                               "1000000"};
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::CPU);
+  spec.mutable_pressure_threshold()->set_threshold(100000);
+  spec.mutable_pressure_threshold()->set_window(1000000);
+
+  EXPECT_CALL(*mock_lmctfy_, Get(kContainerName))
+      .WillOnce(Return(mock_container_));
+  EXPECT_CALL(*mock_container_,
+              RegisterNotification(EqualsInitializedProto(spec), NotNull()))
+      .WillOnce(
+           DoAll(Invoke(&RunCallback), Invoke(&DeleteCallback), Return(1)));
+
+  EXPECT_OK(CpuPressureHandler(args, mock_lmctfy_.get(), &output_));
+}
+
+TEST_F(NotifyTest, PressureBadWindow) {
+  // Delete the container since we never get it.
+  unique_ptr<MockContainer> d(mock_container_);
+
+  const vector<string> args = {"pressure", kContainerName, "100000", "NaN"};
+
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    CpuPressureHandler(args, mock_lmctfy_.get(), &output_));
+}
+
+TEST_F(NotifyTest, PressureBadStallType) {
+  // Delete the container since we never get it.
+  unique_ptr<MockContainer> d(mock_container_);
+
+  const vector<string> args = {"pressure", kContainerName, "100000", "1000000",
+                               "most"};
+
+  EXPECT_ERROR_CODE(
+      ::util::error::INVALID_ARGUMENT,
+      MemoryPressureHandler(args, mock_lmctfy_.get(), &output_));
+}
+
 }  // namespace
 }  // namespace cli
 }  // namespace lmctfy
@@ -27,10 +27,30 @@ using ::std::string;
 #include "lmctfy/cli/command.h"
 #include "include/lmctfy.h"
 #include "include/lmctfy.pb.h"
+#include "lmctfy/stats_publisher.h"
+#include "lmctfy/stats_shm.h"
 #include "util/errors.h"
 #include "util/task/statusor.h"
 
 DECLARE_bool(lmctfy_binary);
+DECLARE_bool(lmctfy_perf_open_enabled_counters);
+DEFINE_int32(lmctfy_stats_rate_window_ms, 5000,
+             "The number of milliseconds to sample a container for when its "
+             "rates are requested and it is not already being sampled.");
+DEFINE_bool(lmctfy_stats_from_shm, false,
+            "Whether to read the stats of containers from the stats file "
+            "written by \"stats publish\" instead of from the kernel. Also "
+            "set by --from-shm.");
+DEFINE_string(lmctfy_stats_shm_path, "/run/lmctfy/stats",
+              "The stats file written by \"stats publish\".");
+DEFINE_int32(lmctfy_stats_publish_interval_ms, 1000,
+             "The number of milliseconds between the rounds of \"stats "
+             "publish\".");
+DEFINE_int32(lmctfy_stats_publish_max_containers, 4096,
+             "The maximum number of containers \"stats publish\" publishes.");
+DEFINE_int32(lmctfy_stats_publish_slot_size, 16384,
+             "The number of bytes the stats file holds for each container. "
+             "Must be a multiple of 64.");
 
 using ::std::unique_ptr;
 using ::std::vector;
@@ -41,6 +61,57 @@ namespace containers {
 namespace lmctfy {
 namespace cli {
 
+// Outputs the proto in binary or ASCII format as specified.
+static void OutputProto(const ::google::protobuf::Message &proto,
+                        OutputMap *output) {
+  string proto_output;
+  if (FLAGS_lmctfy_binary) {
+    proto.SerializeToString(&proto_output);
+  } else {
+    ::google::protobuf::TextFormat::PrintToString(proto, &proto_output);
+  }
+  output->AddRaw(proto_output);
+}
+
+// Gets the name of the container specified in the arguments, or that of the
+// parent's container if none was specified.
+static StatusOr<string> GetContainerName(const vector<string> &argv,
+                                         const ContainerApi *lmctfy) {
+  if (argv.size() == 2) {
+    return argv[1];
+  }
+
+  // Detect parent's container.
+  return lmctfy->Detect(getppid());
+}
+
+// Gets the stats of a container from the stats file.
+static Status StatsFromShm(const string &container_name,
+                           Container::StatsType stats_type,
+                           OutputMap *output) {
+  // Published stats are indexed by absolute name.
+  if (container_name.empty() || container_name[0] != '/') {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  "Published stats can only be read by absolute container "
+                  "name");
+  }
+
+  unique_ptr<StatsShmReader> reader(
+      RETURN_IF_ERROR(StatsShmReader::Open(FLAGS_lmctfy_stats_shm_path)));
+
+  // Summary stats are a subset of the full stats.
+  if (stats_type == Container::STATS_FULL &&
+      reader->stats_type() != Container::STATS_FULL) {
+    return Status(::util::error::FAILED_PRECONDITION,
+                  "Only summary stats are published");
+  }
+
+  StatsShmReader::Record record =
+      RETURN_IF_ERROR(reader->Read(container_name));
+  OutputProto(record.stats, output);
+  return Status::OK;
+}
+
 // Command to get stats for a container.
 static Status StatsContainer(const vector<string> &argv,
                              const ContainerApi *lmctfy,
@@ -53,12 +124,10 @@ static Status StatsContainer(const vector<string> &argv,
   }
 
   // Get container name.
-  string container_name;
-  if (argv.size() == 2) {
-    container_name = argv[1];
-  } else {
-    // Detect parent's container.
-    container_name = RETURN_IF_ERROR(lmctfy->Detect(getppid()));
+  const string container_name = RETURN_IF_ERROR(GetContainerName(argv, lmctfy));
+
+  if (FLAGS_lmctfy_stats_from_shm) {
+    return StatsFromShm(container_name, stats_type, output);
   }
 
   // Ensure the container exists.
@@ -72,14 +141,7 @@ static Status StatsContainer(const vector<string> &argv,
   }
 
   // Output the stats as a proto in binary or ASCII format as specified.
-  string stats_output;
-  if (FLAGS_lmctfy_binary) {
-    statusor_stats.ValueOrDie().SerializeToString(&stats_output);
-  } else {
-    ::google::protobuf::TextFormat::PrintToString(statusor_stats.ValueOrDie(),
-                                        &stats_output);
-  }
-  output->AddRaw(stats_output);
+  OutputProto(statusor_stats.ValueOrDie(), output);
 
   return Status::OK;
 }
@@ -96,18 +158,80 @@ Status StatsFull(const vector<string> &argv, const ContainerApi *lmctfy,
   return StatsContainer(argv, lmctfy, output, Container::STATS_FULL);
 }
 
+// Get the rates of a container's resource usage.
+Status StatsRate(const vector<string> &argv, const ContainerApi *lmctfy,
+                 OutputMap *output) {
+  // Args: rate [<container name>]
+  if (argv.size() < 1 || argv.size() > 2) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  "See help for supported options.");
+  }
+  const string container_name = RETURN_IF_ERROR(GetContainerName(argv, lmctfy));
+
+  // The first request starts sampling the container, wait for the window to be
+  // sampled before asking again.
+  StatusOr<ContainerStatsRates> statusor = lmctfy->StatsRates(container_name);
+  if (statusor.status().error_code() == ::util::error::UNAVAILABLE) {
+    usleep(FLAGS_lmctfy_stats_rate_window_ms * 1000);
+    statusor = lmctfy->StatsRates(container_name);
+  }
+  if (!statusor.ok()) {
+    return statusor.status();
+  }
+
+  OutputProto(statusor.ValueOrDie(), output);
+  return Status::OK;
+}
+
+// Publish the stats of all containers.
+Status StatsPublish(const vector<string> &argv, const ContainerApi *lmctfy,
+                    OutputMap *output) {
+  // Args: publish
+  if (argv.size() != 1) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  "See help for supported options.");
+  }
+
+  // Full stats serve both summary and full readers.
+  StatsShmWriter *writer = RETURN_IF_ERROR(StatsShmWriter::New(
+      FLAGS_lmctfy_stats_shm_path, FLAGS_lmctfy_stats_publish_max_containers,
+      FLAGS_lmctfy_stats_publish_slot_size, Container::STATS_FULL));
+  StatsPublisher publisher(lmctfy, writer, Container::STATS_FULL);
+
+  // Perf counters enabled by other processes only count once opened, this
+  // process reads them every round.
+  FLAGS_lmctfy_perf_open_enabled_counters = true;
+
+  while (true) {
+    Status status = publisher.Publish();
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to publish container stats: "
+                   << status.ToString();
+    }
+    usleep(FLAGS_lmctfy_stats_publish_interval_ms * 1000);
+  }
+}
+
+bool IsStatsFromShmCommand(const vector<string> &args) {
+  // Args: <program> stats full|summary <absolute container name>
+  return FLAGS_lmctfy_stats_from_shm && args.size() == 4 &&
+         args[1] == "stats" && (args[2] == "summary" || args[2] == "full") &&
+         !args[3].empty() && args[3][0] == '/';
+}
+
 void RegisterStatsCommand() {
   RegisterRootCommand(
       SUB("stats",
           "Get statistics about the specified container's usage of each "
           "resource.",
-          "<stats type> [-b] [<container name>]", {
+          "<stats type> [-b] [--from-shm] [<container name>]", {
             CMD("summary",
                 "Get summary statistics of a container's usage for each "
                 "resource. If no container is specified, those of the calling "
                 "process' container are listed. Statistics are output as a "
                 "ContainerStats proto in ASCII format. If -b is specified they "
-                "are output in binary form.",
+                "are output in binary form. With --from-shm they are read from "
+                "the stats published by \"stats publish\".",
                 "[-b] [<container name>]",
                 CMD_TYPE_GETTER,
                 0,
@@ -118,12 +242,39 @@ void RegisterStatsCommand() {
                 "each resource. If no container is specified, those of the "
                 "calling process' container are listed. Statistics are output "
                 "as a ContainerStats proto in ASCII format. If -b is specified "
-                "they are output in binary form.",
+                "they are output in binary form. With --from-shm they are "
+                "read from the stats published by \"stats publish\".",
                 "[-b] [<container name>]",
                 CMD_TYPE_GETTER,
                 0,
                 1,
-                &StatsFull)
+                &StatsFull),
+            CMD("rate",
+                "Get the rates of the specified container's usage of each "
+                "resource (e.g.: CPU cores used, throttle ratio, page fault "
+                "rate) and their percentiles, computed from periodic samples "
+                "of its statistics. The container is sampled for "
+                "--lmctfy_stats_rate_window_ms. If no container is specified, "
+                "those of the calling process' container are listed. Rates "
+                "are output as a ContainerStatsRates proto in ASCII format. If "
+                "-b is specified they are output in binary form.",
+                "[-b] [<container name>]",
+                CMD_TYPE_GETTER,
+                0,
+                1,
+                &StatsRate),
+            CMD("publish",
+                "Publish the full statistics of all containers to "
+                "--lmctfy_stats_shm_path every "
+                "--lmctfy_stats_publish_interval_ms until killed. The "
+                "statistics are then read without gathering them from the "
+                "kernel with --from-shm, or by mapping the file with the "
+                "StatsShmReader library.",
+                "",
+                CMD_TYPE_SETTER,
+                0,
+                0,
+                &StatsPublish)
           }));
 }
 
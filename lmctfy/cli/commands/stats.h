@@ -41,6 +41,22 @@ class OutputMap;
                          const ContainerApi *lmctfy,
                          OutputMap *output);
 
+// Command to get the rates of a container's resource usage.
+::util::Status StatsRate(const ::std::vector<string> &argv,
+                         const ContainerApi *lmctfy,
+                         OutputMap *output);
+
+// Command to publish the stats of all containers to a stats file until killed.
+::util::Status StatsPublish(const ::std::vector<string> &argv,
+                            const ContainerApi *lmctfy,
+                            OutputMap *output);
+
+// Whether the full commandline in args (including the program name) is a
+// "stats summary" or "stats full" of an absolute container name that is served
+// from the published stats file. Such commands never use the ContainerApi, so
+// the caller can skip creating one.
+bool IsStatsFromShmCommand(const ::std::vector<string> &args);
+
 void RegisterStatsCommand();
 
 }  // namespace cli
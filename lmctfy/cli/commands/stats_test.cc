@@ -18,19 +18,29 @@
 #include <vector>
 
 #include "gflags/gflags.h"
+#include "file/base/path.h"
 #include "include/lmctfy.h"
 #include "include/lmctfy.pb.h"
 #include "include/lmctfy_mock.h"
+#include "lmctfy/stats_shm.h"
+#include "util/errors_test_util.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
 
 DECLARE_bool(lmctfy_binary);
+DECLARE_int32(lmctfy_stats_rate_window_ms);
+DECLARE_bool(lmctfy_stats_from_shm);
+DECLARE_string(lmctfy_stats_shm_path);
+DECLARE_string(test_tmpdir);
 
+using ::file::JoinPath;
 using ::std::unique_ptr;
 using ::std::vector;
 using ::testing::Ge;
 using ::testing::Return;
 using ::util::Status;
+using ::util::StatusOr;
 
 namespace containers {
 namespace lmctfy {
@@ -210,6 +220,145 @@ TEST_F(StatsTest, FullStatsFails) {
             StatsFull(args, mock_lmctfy_.get(), &output_maps_));
 }
 
+TEST_F(StatsTest, RateSuccess) {
+  const vector<string> args = {"rate", kContainerName};
+  ContainerStatsRates rates;
+
+  EXPECT_CALL(*mock_lmctfy_, StatsRates(kContainerName))
+      .WillOnce(Return(rates));
+
+  FLAGS_lmctfy_binary = false;
+  EXPECT_OK(StatsRate(args, mock_lmctfy_.get(), &output_maps_));
+
+  // Delete the container since it is never returned.
+  delete mock_container_;
+}
+
+TEST_F(StatsTest, RateWaitsForSamples) {
+  const vector<string> args = {"rate", kContainerName};
+  ContainerStatsRates rates;
+
+  EXPECT_CALL(*mock_lmctfy_, StatsRates(kContainerName))
+      .WillOnce(Return(Status(::util::error::UNAVAILABLE, "")))
+      .WillOnce(Return(rates));
+
+  FLAGS_lmctfy_binary = true;
+  FLAGS_lmctfy_stats_rate_window_ms = 0;
+  EXPECT_OK(StatsRate(args, mock_lmctfy_.get(), &output_maps_));
+
+  delete mock_container_;
+}
+
+TEST_F(StatsTest, RateSelfDetectFails) {
+  const vector<string> args = {"rate"};
+
+  EXPECT_CALL(*mock_lmctfy_, Detect(Ge(0)))
+      .WillRepeatedly(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED,
+            StatsRate(args, mock_lmctfy_.get(), &output_maps_));
+
+  delete mock_container_;
+}
+
+TEST_F(StatsTest, RateFails) {
+  const vector<string> args = {"rate", kContainerName};
+
+  EXPECT_CALL(*mock_lmctfy_, StatsRates(kContainerName))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED,
+            StatsRate(args, mock_lmctfy_.get(), &output_maps_));
+
+  delete mock_container_;
+}
+
+class StatsFromShmTest : public StatsTest {
+ public:
+  void SetUp() override {
+    StatsTest::SetUp();
+    FLAGS_lmctfy_stats_from_shm = true;
+    FLAGS_lmctfy_stats_shm_path =
+        JoinPath(FLAGS_test_tmpdir, "stats_from_shm_test/stats");
+    FLAGS_lmctfy_binary = false;
+  }
+
+  void TearDown() override {
+    FLAGS_lmctfy_stats_from_shm = false;
+    writer_.reset();
+    // Stats are not read through lmctfy.
+    delete mock_container_;
+  }
+
+  // Publishes the stats of the container.
+  void Publish(const ContainerStats &stats) {
+    StatusOr<StatsShmWriter *> statusor = StatsShmWriter::New(
+        FLAGS_lmctfy_stats_shm_path, 8, 1024, Container::STATS_FULL);
+    ASSERT_OK(statusor);
+    writer_.reset(statusor.ValueOrDie());
+    ASSERT_OK(writer_->Write(kContainerName, stats, 0));
+  }
+
+ protected:
+  unique_ptr<StatsShmWriter> writer_;
+};
+
+TEST_F(StatsFromShmTest, SummarySuccess) {
+  ContainerStats stats;
+  stats.mutable_cpu()->mutable_usage()->set_total(42);
+  Publish(stats);
+
+  EXPECT_OK(StatsSummary({"summary", kContainerName}, mock_lmctfy_.get(),
+                         &output_maps_));
+  EXPECT_OK(StatsFull({"full", kContainerName}, mock_lmctfy_.get(),
+                      &output_maps_));
+}
+
+TEST_F(StatsFromShmTest, SummaryWithoutContainerApi) {
+  Publish(ContainerStats());
+
+  EXPECT_OK(StatsSummary({"summary", kContainerName}, nullptr, &output_maps_));
+}
+
+TEST_F(StatsFromShmTest, IsStatsFromShmCommand) {
+  EXPECT_TRUE(IsStatsFromShmCommand({"lmctfy", "stats", "summary", "/test"}));
+  EXPECT_TRUE(IsStatsFromShmCommand({"lmctfy", "stats", "full", "/test"}));
+
+  // Needs an absolute container name.
+  EXPECT_FALSE(IsStatsFromShmCommand({"lmctfy", "stats", "summary", "test"}));
+  EXPECT_FALSE(IsStatsFromShmCommand({"lmctfy", "stats", "summary"}));
+
+  // Only summary and full stats are published.
+  EXPECT_FALSE(IsStatsFromShmCommand({"lmctfy", "stats", "rate", "/test"}));
+  EXPECT_FALSE(IsStatsFromShmCommand({"lmctfy", "list", "summary", "/test"}));
+
+  FLAGS_lmctfy_stats_from_shm = false;
+  EXPECT_FALSE(IsStatsFromShmCommand({"lmctfy", "stats", "summary", "/test"}));
+}
+
+TEST_F(StatsFromShmTest, NotPublished) {
+  Publish(ContainerStats());
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    StatsSummary({"summary", "/other"}, mock_lmctfy_.get(),
+                                 &output_maps_));
+}
+
+TEST_F(StatsFromShmTest, RelativeName) {
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    StatsSummary({"summary", "test"}, mock_lmctfy_.get(),
+                                 &output_maps_));
+}
+
+TEST_F(StatsFromShmTest, NoStatsFile) {
+  FLAGS_lmctfy_stats_shm_path =
+      JoinPath(FLAGS_test_tmpdir, "stats_from_shm_test/missing");
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    StatsSummary({"summary", kContainerName},
+                                 mock_lmctfy_.get(), &output_maps_));
+}
+
 }  // namespace
 }  // namespace cli
 }  // namespace lmctfy
@@ -62,6 +62,8 @@ DECLARE_bool(lmctfy_force);
 DECLARE_bool(lmctfy_no_wait);
 DECLARE_bool(lmctfy_recursive);
 DECLARE_string(lmctfy_config);
+DECLARE_bool(lmctfy_stats_from_shm);
+DECLARE_int32(lmctfy_warm_pool_size);
 
 // Define our app-specific command line flags.
 // IMPORTANT: These flags are global across all linked components
@@ -124,6 +126,12 @@ static bool ParseShortFlags(int *argc, char ***argv) {
       continue;
     }
 
+    // Long alias of --lmctfy_stats_from_shm.
+    if (strcmp(cur_arg, "--from-shm") == 0) {
+      FLAGS_lmctfy_stats_from_shm = true;
+      continue;
+    }
+
     switch (cur_arg[1]) {
       case 'b':
         FLAGS_lmctfy_binary = true;
@@ -232,9 +240,12 @@ static int HandleCommand(const vector<string> &args_vector) {
     return EXIT_SUCCESS;
   }
 
-  // Run the command.
-  unique_ptr<ContainerApiFactory> lmctfy_factory(
-      NewPermanentCallback(&ContainerApi::New));
+  // Run the command. Stats read from the published stats file do not need a
+  // ContainerApi, so avoid the cost of creating one.
+  unique_ptr<ContainerApiFactory> lmctfy_factory;
+  if (!IsStatsFromShmCommand(args_vector)) {
+    lmctfy_factory.reset(NewPermanentCallback(&ContainerApi::New));
+  }
   return RunCommand(args_vector, output_style, lmctfy_factory.get(), out)
       .error_code();
 }
@@ -252,6 +263,10 @@ int Main(int argc, char *argv[]) {
 
   ::gflags::ParseCommandLineFlags(&argc, &argv, true);
 
+  // The CLI runs a single command, warm containers would only be created to be
+  // destroyed on exit.
+  FLAGS_lmctfy_warm_pool_size = 0;
+
   // Execute command handling logic.
   vector<string> args_vector(argv, argv + argc);
   int ret = HandleCommand(args_vector);
@@ -45,6 +45,94 @@ BlockIoController::BlockIoController(const string &hierarchy_path,
 
 static const int kWeightMultiplier = 10;
 
+// Range of the weights of the v1 hierarchy, and of those of the unified
+// hierarchy.
+static const int64 kMinWeight = 10;
+static const int64 kMaxWeight = 1000;
+static const int64 kMinUnifiedWeight = 1;
+static const int64 kMaxUnifiedWeight = 10000;
+
+// Default weights of the kernel, in the v1 and the unified hierarchy.
+static const int64 kDefaultWeight = 500;
+static const int64 kDefaultUnifiedWeight = 100;
+
+// Name of the default weight in io.weight.
+static const char kUnifiedDefaultWeight[] = "default";
+
+// Value of a limit in io.max when there is no limit.
+static const char kUnifiedNoLimit[] = "max";
+
+// Keys of the limits in io.max, in the order they are listed by the kernel.
+static const struct {
+  const char *key;
+  BlockIoSpec::LimitType limit_type;
+  BlockIoSpec::OpType op_type;
+} kUnifiedMaxLimitKeys[] = {
+  {"rbps", BlockIoSpec::BYTES_PER_SECOND, BlockIoSpec::READ},
+  {"wbps", BlockIoSpec::BYTES_PER_SECOND, BlockIoSpec::WRITE},
+  {"riops", BlockIoSpec::IO_PER_SECOND, BlockIoSpec::READ},
+  {"wiops", BlockIoSpec::IO_PER_SECOND, BlockIoSpec::WRITE},
+};
+
+// Map of major:minor to the stats of the device.
+typedef map< ::std::pair<int64, int64>, BlockIoStats::DeviceStats *>
+    DeviceStatsMap;
+
+// Returns the stats of the major:minor device, adding them to stats and
+// devices if they are not there yet.
+static BlockIoStats::DeviceStats *GetDeviceStats(int64 major, int64 minor,
+                                                 BlockIoStats *stats,
+                                                 DeviceStatsMap *devices) {
+  BlockIoStats::DeviceStats *&device_stats =
+      (*devices)[::std::make_pair(major, minor)];
+  if (device_stats == nullptr) {
+    device_stats = stats->add_devices();
+    device_stats->mutable_device()->set_major(major);
+    device_stats->mutable_device()->set_minor(minor);
+  }
+  return device_stats;
+}
+
+// Sets the counter of the operation named op in op_stats to value. Returns
+// false if the operation is unknown.
+static bool SetOpStat(const string &op, uint64 value,
+                      BlockIoStats::OpStats *op_stats) {
+  if (op == "Read") {
+    op_stats->set_read(value);
+  } else if (op == "Write") {
+    op_stats->set_write(value);
+  } else if (op == "Sync") {
+    op_stats->set_sync(value);
+  } else if (op == "Async") {
+    op_stats->set_async(value);
+  } else if (op == "Discard") {
+    op_stats->set_discard(value);
+  } else if (op == "Total") {
+    op_stats->set_total(value);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Maps a limit in [1, 100] linearly onto the range of weights of the unified
+// hierarchy, through the v1 weight it would have.
+static int64 LimitToUnifiedWeight(uint64 limit) {
+  const int64 weight = limit * kWeightMultiplier;
+  return kMinUnifiedWeight +
+         ((weight - kMinWeight) * (kMaxUnifiedWeight - kMinUnifiedWeight)) /
+             (kMaxWeight - kMinWeight);
+}
+
+// Inverse of LimitToUnifiedWeight(), rounded to the nearest limit.
+static uint64 UnifiedWeightToLimit(int64 unified_weight) {
+  const int64 weight =
+      kMinWeight + ((unified_weight - kMinUnifiedWeight) *
+                    (kMaxWeight - kMinWeight)) /
+                       (kMaxUnifiedWeight - kMinUnifiedWeight);
+  return (weight + kWeightMultiplier / 2) / kWeightMultiplier;
+}
+
 Status BlockIoController::IsValidLimit(uint64 limit) {
   static const int32 kMinLimit = 1;
   static const int32 kMaxLimit = 100;
@@ -60,28 +148,59 @@ Status BlockIoController::IsValidLimit(uint64 limit) {
 Status BlockIoController::UpdateDefaultLimit(uint32 limit) {
   RETURN_IF_ERROR(IsValidLimit(limit));
 
+  if (unified()) {
+    return SetParamString(KernelFiles::Unified::IO::kWeight,
+                          Substitute("$0 $1", kUnifiedDefaultWeight,
+                                     LimitToUnifiedWeight(limit)));
+  }
+
   // cgroup interface allows the range of 10 - 1000.
   return SetParamInt(KernelFiles::BlockIO::kWeight, limit * kWeightMultiplier);
 }
 
 StatusOr<uint32> BlockIoController::GetDefaultLimit() const {
+  if (unified()) {
+    FileLines weight_lines =
+        RETURN_IF_ERROR(GetParamLines(KernelFiles::Unified::IO::kWeight));
+    for (const StringPiece line : weight_lines) {
+      const vector<string> values = Split(line, AnyOf(" \n"), SkipEmpty());
+      int64 weight = 0;
+      if (values.size() == 2 && values[0] == kUnifiedDefaultWeight &&
+          SimpleAtoi(values[1], &weight)) {
+        return UnifiedWeightToLimit(weight);
+      }
+    }
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("No default weight found in $0",
+                             KernelFiles::Unified::IO::kWeight));
+  }
+
   int32 weight = RETURN_IF_ERROR(GetParamInt(KernelFiles::BlockIO::kWeight));
 
   return weight/kWeightMultiplier;
 }
 
+StatusOr<string> BlockIoController::FormatDevice(
+    const BlockIoSpec::DeviceLimit &device_limit) const {
+  if (!device_limit.has_device() || !device_limit.device().has_major() ||
+      !device_limit.device().has_minor()) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  Substitute("Incomplete device specified: $0",
+                             device_limit.DebugString()));
+  }
+  return Substitute("$0:$1", device_limit.device().major(),
+                    device_limit.device().minor());
+}
+
 StatusOr<string> BlockIoController::FormatWeightString(
     const BlockIoSpec::DeviceLimit &device_limit, int64 multiplier) const {
-  if (!device_limit.has_device() || !device_limit.device().has_major() ||
-      !device_limit.device().has_minor() ||
-      !device_limit.has_limit()) {
+  const string device = RETURN_IF_ERROR(FormatDevice(device_limit));
+  if (!device_limit.has_limit()) {
     return Status(::util::error::INVALID_ARGUMENT,
                   Substitute("Incomplete device specified: $0",
                              device_limit.DebugString()));
   }
-  return Substitute("$0:$1 $2", device_limit.device().major(),
-                    device_limit.device().minor(),
-                    device_limit.limit() * multiplier);
+  return Substitute("$0 $1", device, device_limit.limit() * multiplier);
 }
 
 Status BlockIoController::UpdatePerDeviceLimit(
@@ -90,6 +209,15 @@ Status BlockIoController::UpdatePerDeviceLimit(
     if (limit.has_limit()) {
       RETURN_IF_ERROR(IsValidLimit(limit.limit()));
     }
+    if (unified()) {
+      BlockIoSpec::DeviceLimit weight = limit;
+      weight.set_limit(LimitToUnifiedWeight(limit.limit()));
+      const string device_weight_str =
+          RETURN_IF_ERROR(FormatWeightString(weight, 1));
+      RETURN_IF_ERROR(SetParamString(KernelFiles::Unified::IO::kWeight,
+                                     device_weight_str));
+      continue;
+    }
     const string device_limit_str =
         RETURN_IF_ERROR(FormatWeightString(limit, kWeightMultiplier));
     RETURN_IF_ERROR(SetParamString(KernelFiles::BlockIO::kPerDeviceWeight,
@@ -98,28 +226,100 @@ Status BlockIoController::UpdatePerDeviceLimit(
   return Status::OK;
 }
 
+StatusOr<string> BlockIoController::GetMaxLimitKey(
+    const BlockIoSpec::MaxLimit &max_limit) const {
+  if (!max_limit.has_op_type() || !max_limit.has_limit_type()) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  Substitute("Incomplete device IO max limit specified: $0",
+                             max_limit.DebugString()));
+  }
+
+  if (unified()) {
+    for (const auto &limit_key : kUnifiedMaxLimitKeys) {
+      if (limit_key.limit_type == max_limit.limit_type() &&
+          limit_key.op_type == max_limit.op_type()) {
+        return string(limit_key.key);
+      }
+    }
+    return Status(::util::error::INVALID_ARGUMENT,
+                  Substitute("Unsupported device IO max limit specified: $0",
+                             max_limit.DebugString()));
+  }
+
+  if (max_limit.limit_type() == BlockIoSpec::BYTES_PER_SECOND) {
+    return string((max_limit.op_type() == BlockIoSpec::READ) ?
+        KernelFiles::BlockIO::kMaxReadBytesPerSecond :
+        KernelFiles::BlockIO::kMaxWriteBytesPerSecond);
+  }
+  return string((max_limit.op_type() == BlockIoSpec::READ) ?
+      KernelFiles::BlockIO::kMaxReadIoPerSecond :
+      KernelFiles::BlockIO::kMaxWriteIoPerSecond);
+}
+
 Status BlockIoController::UpdateMaxLimit(
     const BlockIoSpec::MaxLimitSet &limits_set) {
   for (const BlockIoSpec::MaxLimit &max_limit : limits_set.max_limits()) {
-    if (!max_limit.has_op_type() || !max_limit.has_limit_type()) {
-      return Status(::util::error::INVALID_ARGUMENT,
-                    Substitute("Incomplete device IO max limit specified: $0",
-                               max_limit.DebugString()));
-    }
-    string path;
-    if (max_limit.limit_type() == BlockIoSpec::BYTES_PER_SECOND) {
-      path = (max_limit.op_type() == BlockIoSpec::READ) ?
-          KernelFiles::BlockIO::kMaxReadBytesPerSecond :
-          KernelFiles::BlockIO::kMaxWriteBytesPerSecond;
-    } else {
-      path = (max_limit.op_type() == BlockIoSpec::READ) ?
-          KernelFiles::BlockIO::kMaxReadIoPerSecond :
-          KernelFiles::BlockIO::kMaxWriteIoPerSecond;
-    }
+    const string key = RETURN_IF_ERROR(GetMaxLimitKey(max_limit));
     for (const BlockIoSpec::DeviceLimit device : max_limit.limits()) {
+      if (unified()) {
+        // Validates the device and its limit.
+        RETURN_IF_ERROR(FormatWeightString(device, 1));
+
+        // Limits of other types that are not written are left as they are.
+        RETURN_IF_ERROR(SetParamString(
+            KernelFiles::Unified::IO::kMax,
+            Substitute("$0:$1 $2=$3", device.device().major(),
+                       device.device().minor(), key, device.limit())));
+        continue;
+      }
       const string device_limit_str =
           RETURN_IF_ERROR(FormatWeightString(device, 1));
-      RETURN_IF_ERROR(SetParamString(path, device_limit_str));
+      RETURN_IF_ERROR(SetParamString(key, device_limit_str));
+    }
+  }
+  return Status::OK;
+}
+
+Status BlockIoController::ResetDefaultLimit() {
+  if (unified()) {
+    return SetParamString(KernelFiles::Unified::IO::kWeight,
+                          Substitute("$0 $1", kUnifiedDefaultWeight,
+                                     kDefaultUnifiedWeight));
+  }
+  return SetParamInt(KernelFiles::BlockIO::kWeight, kDefaultWeight);
+}
+
+Status BlockIoController::ClearPerDeviceLimit(
+    const BlockIoSpec::DeviceLimitSet &limits_set) {
+  for (const BlockIoSpec::DeviceLimit &limit : limits_set.device_limits()) {
+    const string device = RETURN_IF_ERROR(FormatDevice(limit));
+    // A device weight of "default" (unified) or 0 (v1) removes the override.
+    if (unified()) {
+      RETURN_IF_ERROR(SetParamString(
+          KernelFiles::Unified::IO::kWeight,
+          Substitute("$0 $1", device, kUnifiedDefaultWeight)));
+    } else {
+      RETURN_IF_ERROR(SetParamString(KernelFiles::BlockIO::kPerDeviceWeight,
+                                     Substitute("$0 0", device)));
+    }
+  }
+  return Status::OK;
+}
+
+Status BlockIoController::ClearMaxLimit(
+    const BlockIoSpec::MaxLimitSet &limits_set) {
+  for (const BlockIoSpec::MaxLimit &max_limit : limits_set.max_limits()) {
+    const string key = RETURN_IF_ERROR(GetMaxLimitKey(max_limit));
+    for (const BlockIoSpec::DeviceLimit &limit : max_limit.limits()) {
+      const string device = RETURN_IF_ERROR(FormatDevice(limit));
+      // A limit of "max" (unified) or 0 (v1) removes the rule of the device.
+      if (unified()) {
+        RETURN_IF_ERROR(SetParamString(
+            KernelFiles::Unified::IO::kMax,
+            Substitute("$0 $1=$2", device, key, kUnifiedNoLimit)));
+      } else {
+        RETURN_IF_ERROR(SetParamString(key, Substitute("$0 0", device)));
+      }
     }
   }
   return Status::OK;
@@ -167,8 +367,62 @@ Status BlockIoController::FillThrottlingSpec(
   return Status::OK;
 }
 
+// Each line of io.max holds all the limits of a device:
+//   <major>:<minor> rbps=<limit> wbps=<limit> riops=<limit> wiops=<limit>
+// where a limit is a number or "max".
+Status BlockIoController::FillUnifiedThrottlingSpec(
+    BlockIoSpec::MaxLimitSet *max_limit_set) const {
+  const int kNumKeys =
+      sizeof(kUnifiedMaxLimitKeys) / sizeof(kUnifiedMaxLimitKeys[0]);
+  BlockIoSpec::MaxLimit max_limits[kNumKeys];
+  for (int i = 0; i < kNumKeys; ++i) {
+    max_limits[i].set_limit_type(kUnifiedMaxLimitKeys[i].limit_type);
+    max_limits[i].set_op_type(kUnifiedMaxLimitKeys[i].op_type);
+  }
+
+  FileLines limit_lines =
+      RETURN_IF_ERROR(GetParamLines(KernelFiles::Unified::IO::kMax));
+  for (const StringPiece line : limit_lines) {
+    const vector<string> fields = Split(line, AnyOf(" \n"), SkipEmpty());
+    int major, minor;
+    // Ignore malformed lines.
+    if (fields.empty() ||
+        sscanf(fields[0].c_str(), "%d:%d", &major, &minor) != 2) {
+      continue;
+    }
+
+    for (int f = 1; f < fields.size(); ++f) {
+      const vector<string> key_value = Split(fields[f], "=");
+      uint64 limit;
+      if (key_value.size() != 2 || key_value[1] == kUnifiedNoLimit ||
+          !SimpleAtoi(key_value[1], &limit)) {
+        continue;
+      }
+      for (int i = 0; i < kNumKeys; ++i) {
+        if (key_value[0] == kUnifiedMaxLimitKeys[i].key) {
+          BlockIoSpec::DeviceLimit *device_limit = max_limits[i].add_limits();
+          device_limit->mutable_device()->set_major(major);
+          device_limit->mutable_device()->set_minor(minor);
+          device_limit->set_limit(limit);
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < kNumKeys; ++i) {
+    if (max_limits[i].limits_size() != 0) {
+      *max_limit_set->add_max_limits() = max_limits[i];
+    }
+  }
+  return Status::OK;
+}
+
 StatusOr<BlockIoSpec::MaxLimitSet> BlockIoController::GetMaxLimit() const {
   BlockIoSpec::MaxLimitSet max_limits;
+  if (unified()) {
+    RETURN_IF_ERROR(FillUnifiedThrottlingSpec(&max_limits));
+    return max_limits;
+  }
   RETURN_IF_ERROR(FillThrottlingSpec(
       &max_limits, KernelFiles::BlockIO::kMaxReadIoPerSecond));
   RETURN_IF_ERROR(FillThrottlingSpec(
@@ -183,6 +437,18 @@ StatusOr<BlockIoSpec::MaxLimitSet> BlockIoController::GetMaxLimit() const {
 StatusOr<BlockIoSpec::DeviceLimitSet>
 BlockIoController::GetDeviceLimits() const {
   BlockIoSpec::DeviceLimitSet limits_set;
+  if (unified()) {
+    // The default weight line of io.weight is not parsed as a device.
+    RETURN_IF_ERROR(FillLimitSpec(limits_set.mutable_device_limits(),
+                                  KernelFiles::Unified::IO::kWeight));
+    for (int i = 0; i < limits_set.device_limits_size(); ++i) {
+      const uint64 weight = limits_set.device_limits(i).limit();
+      limits_set.mutable_device_limits(i)->set_limit(
+          UnifiedWeightToLimit(weight));
+    }
+    return limits_set;
+  }
+
   RETURN_IF_ERROR(FillLimitSpec(limits_set.mutable_device_limits(),
                                 KernelFiles::BlockIO::kPerDeviceWeight));
   // Adjust weight to be a fraction of available I/O limit.
@@ -193,5 +459,137 @@ BlockIoController::GetDeviceLimits() const {
   return limits_set;
 }
 
+Status BlockIoController::FillOpStats(
+    const string &stats_file,
+    BlockIoStats::OpStats *(BlockIoStats::DeviceStats::*field)(),
+    BlockIoStats *stats, DeviceStatsMap *devices) const {
+  FileLines stats_lines = RETURN_IF_ERROR(GetParamLines(stats_file));
+  for (const StringPiece line : stats_lines) {
+    // Lines are "$MAJ:$MIN $OP $VALUE", followed by a "Total $VALUE" line for
+    // all devices which is skipped as malformed.
+    const vector<string> fields = Split(line, AnyOf(" \n"), SkipEmpty());
+    int major, minor;
+    uint64 value;
+    if (fields.size() != 3 ||
+        sscanf(fields[0].c_str(), "%d:%d", &major, &minor) != 2 ||
+        !SimpleAtoi(fields[2], &value)) {
+      continue;
+    }
+
+    BlockIoStats::OpStats op_stats;
+    if (!SetOpStat(fields[1], value, &op_stats)) {
+      continue;
+    }
+    (GetDeviceStats(major, minor, stats, devices)->*field)()->MergeFrom(
+        op_stats);
+  }
+  return Status::OK;
+}
+
+Status BlockIoController::FillUnifiedStats(BlockIoStats *stats) const {
+  DeviceStatsMap devices;
+  FileLines stats_lines =
+      RETURN_IF_ERROR(GetParamLines(KernelFiles::Unified::IO::kStat));
+  for (const StringPiece line : stats_lines) {
+    const vector<string> fields = Split(line, AnyOf(" \n"), SkipEmpty());
+    int major, minor;
+    // Ignore malformed lines.
+    if (fields.empty() ||
+        sscanf(fields[0].c_str(), "%d:%d", &major, &minor) != 2) {
+      continue;
+    }
+
+    BlockIoStats::DeviceStats *device_stats =
+        GetDeviceStats(major, minor, stats, &devices);
+    BlockIoStats::OpStats *bytes = device_stats->mutable_io_service_bytes();
+    BlockIoStats::OpStats *ios = device_stats->mutable_io_serviced();
+    for (int f = 1; f < fields.size(); ++f) {
+      const vector<string> key_value = Split(fields[f], "=");
+      uint64 value;
+      if (key_value.size() != 2 || !SimpleAtoi(key_value[1], &value)) {
+        continue;
+      }
+      const string &key = key_value[0];
+      if (key == "rbytes") {
+        bytes->set_read(value);
+      } else if (key == "wbytes") {
+        bytes->set_write(value);
+      } else if (key == "dbytes") {
+        bytes->set_discard(value);
+      } else if (key == "rios") {
+        ios->set_read(value);
+      } else if (key == "wios") {
+        ios->set_write(value);
+      } else if (key == "dios") {
+        ios->set_discard(value);
+      }
+    }
+    bytes->set_total(bytes->read() + bytes->write() + bytes->discard());
+    ios->set_total(ios->read() + ios->write() + ios->discard());
+  }
+  return Status::OK;
+}
+
+StatusOr<BlockIoStats> BlockIoController::GetStats(
+    Container::StatsType type) const {
+  BlockIoStats stats;
+  if (unified()) {
+    RETURN_IF_ERROR(FillUnifiedStats(&stats));
+    return stats;
+  }
+
+  // The throttling counters are cheap to read and always there. The CFQ ones
+  // are only read for full stats.
+  struct StatsFile {
+    const char *file;
+    BlockIoStats::OpStats *(BlockIoStats::DeviceStats::*field)();
+  };
+  const StatsFile kSummaryFiles[] = {
+    {KernelFiles::BlockIO::kThrottledIoServiceBytes,
+     &BlockIoStats::DeviceStats::mutable_throttle_io_service_bytes},
+    {KernelFiles::BlockIO::kThrottledIoServiced,
+     &BlockIoStats::DeviceStats::mutable_throttle_io_serviced},
+  };
+  const StatsFile kFullFiles[] = {
+    {KernelFiles::BlockIO::kServiceBytes,
+     &BlockIoStats::DeviceStats::mutable_io_service_bytes},
+    {KernelFiles::BlockIO::kServiced,
+     &BlockIoStats::DeviceStats::mutable_io_serviced},
+    {KernelFiles::BlockIO::kWaitTime,
+     &BlockIoStats::DeviceStats::mutable_io_wait_time},
+    {KernelFiles::BlockIO::kServiceTime,
+     &BlockIoStats::DeviceStats::mutable_io_service_time},
+    {KernelFiles::BlockIO::kQueued,
+     &BlockIoStats::DeviceStats::mutable_io_queued},
+  };
+
+  DeviceStatsMap devices;
+  vector<StatsFile> files(kSummaryFiles,
+                          kSummaryFiles + arraysize(kSummaryFiles));
+  if (type == Container::STATS_FULL) {
+    files.insert(files.end(), kFullFiles, kFullFiles + arraysize(kFullFiles));
+  }
+  for (const StatsFile &stats_file : files) {
+    const Status status =
+        FillOpStats(stats_file.file, stats_file.field, &stats, &devices);
+    if (!status.ok() && status.error_code() != ::util::error::NOT_FOUND) {
+      return status;
+    }
+  }
+  return stats;
+}
+
+StatusOr<PressureData> BlockIoController::GetPressure() const {
+  return GetParamPressure(KernelFiles::Unified::IO::kPressure);
+}
+
+StatusOr<ActiveNotifications::Handle>
+BlockIoController::RegisterPressureNotification(
+    const EventSpec::PressureThreshold &threshold,
+    CgroupController::EventCallback *callback) {
+  return CgroupController::RegisterPressureNotification(
+      KernelFiles::Unified::IO::kPressure, threshold, callback);
+}
+
 }  // namespace lmctfy
 }  // namespace containers
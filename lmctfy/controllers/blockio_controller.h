@@ -15,11 +15,14 @@
 #ifndef SRC_CONTROLLERS_BLOCKIO_CONTROLLER_H_
 #define SRC_CONTROLLERS_BLOCKIO_CONTROLLER_H_
 
+#include <map>
 #include <string>
 using ::std::string;
+#include <utility>
 
 #include "base/macros.h"
 #include "lmctfy/controllers/cgroup_controller.h"
+#include "include/lmctfy.h"
 #include "include/lmctfy.pb.h"
 #include "util/task/status.h"
 #include "util/task/statusor.h"
@@ -69,6 +72,19 @@ class BlockIoController : public CgroupController {
   virtual ::util::Status UpdateMaxLimit(
       const BlockIoSpec::MaxLimitSet &max_limits);
 
+  // Resets the default limit of all devices to the default of the kernel.
+  virtual ::util::Status ResetDefaultLimit();
+
+  // Removes the per-device limit overrides of the devices in device_limits,
+  // which then get the default limit. The limits themselves are ignored.
+  virtual ::util::Status ClearPerDeviceLimit(
+      const BlockIoSpec::DeviceLimitSet &device_limits);
+
+  // Removes the max limits of the devices in max_limits, for the operation and
+  // limit type of each. The limits themselves are ignored.
+  virtual ::util::Status ClearMaxLimit(
+      const BlockIoSpec::MaxLimitSet &max_limits);
+
   // Get current default limit.
   virtual ::util::StatusOr<uint32> GetDefaultLimit() const;
 
@@ -78,10 +94,41 @@ class BlockIoController : public CgroupController {
   // Get current setting for max limits.
   virtual ::util::StatusOr<BlockIoSpec::MaxLimitSet> GetMaxLimit() const;
 
+  // Gets the per-device IO accounting of this cgroup.
+  //
+  // Summary stats only have the throttling counters, which the kernel keeps
+  // for every device. Full stats add the CFQ accounting (bytes and IOs
+  // serviced, wait and service times, and queued IOs). Accounting files the
+  // kernel does not have are skipped. In the unified hierarchy both come from
+  // io.stat.
+  virtual ::util::StatusOr<BlockIoStats> GetStats(
+      Container::StatsType type) const;
+
+  // Gets the IO pressure stall information of this cgroup. Only available in
+  // the unified hierarchy.
+  virtual ::util::StatusOr<PressureData> GetPressure() const;
+
+  // Registers a notification for when the IO stall time of this cgroup goes
+  // above the threshold. The handler for the event is returned on success.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+      RegisterPressureNotification(
+          const EventSpec::PressureThreshold &threshold,
+          CgroupController::EventCallback *callback);
+
  private:
   ::util::StatusOr<string> FormatWeightString(
       const BlockIoSpec::DeviceLimit &device, int64 multiplier) const;
 
+  // Formats the device as "major:minor". INVALID_ARGUMENT if it is incomplete.
+  ::util::StatusOr<string> FormatDevice(
+      const BlockIoSpec::DeviceLimit &device_limit) const;
+
+  // Gets the throttling file of the max limit in the v1 hierarchy, or its key
+  // in io.max in the unified hierarchy. INVALID_ARGUMENT if its operation or
+  // limit type is missing or unsupported.
+  ::util::StatusOr<string> GetMaxLimitKey(
+      const BlockIoSpec::MaxLimit &max_limit) const;
+
   ::util::Status FillLimitSpec(
       google::protobuf::RepeatedPtrField<BlockIoSpec::DeviceLimit> *limits,
       const string &spec_file) const;
@@ -89,6 +136,23 @@ class BlockIoController : public CgroupController {
   ::util::Status FillThrottlingSpec(BlockIoSpec::MaxLimitSet *max_limit_set,
                                     const string &spec_file) const;
 
+  // Fills max_limit_set with the limits in io.max in the unified hierarchy.
+  ::util::Status FillUnifiedThrottlingSpec(
+      BlockIoSpec::MaxLimitSet *max_limit_set) const;
+
+  // Adds the counters in the accounting file stats_file to the field of the
+  // devices in stats. Devices not in stats yet are added to both stats and
+  // devices, which indexes them by major:minor.
+  ::util::Status FillOpStats(
+      const string &stats_file,
+      BlockIoStats::OpStats *(BlockIoStats::DeviceStats::*field)(),
+      BlockIoStats *stats,
+      ::std::map< ::std::pair<int64, int64>, BlockIoStats::DeviceStats *>
+          *devices) const;
+
+  // Fills stats with the accounting in io.stat in the unified hierarchy.
+  ::util::Status FillUnifiedStats(BlockIoStats *stats) const;
+
   ::util::Status IsValidLimit(uint64 limit);
 
   DISALLOW_COPY_AND_ASSIGN(BlockIoController);
@@ -51,14 +51,26 @@ class MockBlockIoController : public BlockIoController {
           reinterpret_cast<EventFdNotifications *>(0xFFFFFFFF)) {}
 
   MOCK_METHOD1(UpdateDefaultLimit, ::util::Status(uint32 limit));
-  MOCK_CONST_METHOD0(GetDefaultLimit, ::util::Status<uint32>());
+  MOCK_CONST_METHOD0(GetDefaultLimit, ::util::StatusOr<uint32>());
   MOCK_METHOD1(UpdatePerDeviceLimit, ::util::Status(
       const BlockIoSpec::DeviceLimitSet &device_limits));
   MOCK_CONST_METHOD0(GetDeviceLimits,
                      ::util::StatusOr<BlockIoSpec::DeviceLimitSet>());
   MOCK_METHOD1(UpdateMaxLimit, ::util::Status(
       const BlockIoSpec::MaxLimitSet &max_limits));
+  MOCK_METHOD0(ResetDefaultLimit, ::util::Status());
+  MOCK_METHOD1(ClearPerDeviceLimit, ::util::Status(
+      const BlockIoSpec::DeviceLimitSet &device_limits));
+  MOCK_METHOD1(ClearMaxLimit, ::util::Status(
+      const BlockIoSpec::MaxLimitSet &max_limits));
   MOCK_CONST_METHOD0(GetMaxLimit, ::util::StatusOr<BlockIoSpec::MaxLimitSet>());
+  MOCK_CONST_METHOD1(GetStats, ::util::StatusOr<BlockIoStats>(
+      Container::StatsType type));
+  MOCK_CONST_METHOD0(GetPressure, ::util::StatusOr<PressureData>());
+  MOCK_METHOD2(RegisterPressureNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   const EventSpec::PressureThreshold &threshold,
+                   CgroupController::EventCallback *callback));
 };
 
 typedef ::testing::StrictMock<MockBlockIoController>
@@ -91,6 +91,18 @@ TEST_F(BlockIoControllerTest, UpdateDefaultLimit) {
   EXPECT_OK(controller_->UpdateDefaultLimit(25));
 }
 
+TEST_F(BlockIoControllerTest, UpdateDefaultLimitUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::IO::kWeight);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("default 2425", kResFile,
+                                              NotNull(), NotNull()))
+      .WillOnce(Return(0));
+
+  EXPECT_OK(controller_->UpdateDefaultLimit(25));
+}
+
 TEST_F(BlockIoControllerTest, UpdateDefaultLimitOutOfRange) {
   const string kResFile = JoinPath(kMountPoint, KernelFiles::BlockIO::kWeight);
 
@@ -125,6 +137,18 @@ TEST_F(BlockIoControllerTest, GetDefaultLimitSuccess) {
   EXPECT_EQ(25, statusor.ValueOrDie());
 }
 
+TEST_F(BlockIoControllerTest, GetDefaultLimitUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::IO::kWeight);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK)).WillRepeatedly(Return(0));
+  mock_file_lines_.ExpectFileLines(kResFile, {"default 2425\n", "8:0 100\n"});
+
+  StatusOr<uint32> statusor = controller_->GetDefaultLimit();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(25, statusor.ValueOrDie());
+}
+
 TEST_F(BlockIoControllerTest, GetDefaultLimitNotFound) {
   const string kResFile = JoinPath(kMountPoint, KernelFiles::BlockIO::kWeight);
   EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK)).WillRepeatedly(Return(1));
@@ -319,6 +343,27 @@ TEST_F(BlockIoControllerTest, UpdateMaxLimitSuccess) {
   EXPECT_OK(controller_->UpdateMaxLimit(limits_set));
 }
 
+TEST_F(BlockIoControllerTest, UpdateMaxLimitUnified) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::IO::kMax);
+  controller_->set_unified(true);
+  BlockIoSpec::MaxLimitSet limits_set;
+  BlockIoSpec::MaxLimit *max_limit = limits_set.add_max_limits();
+  SetThrottlingType(max_limit, BlockIoSpec::READ,
+                    BlockIoSpec::BYTES_PER_SECOND);
+  SetDeviceLimit(max_limit->add_limits(), 8, 0, 300);
+  max_limit = limits_set.add_max_limits();
+  SetThrottlingType(max_limit, BlockIoSpec::WRITE, BlockIoSpec::IO_PER_SECOND);
+  SetDeviceLimit(max_limit->add_limits(), 8, 16, 100);
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("8:0 rbps=300", kResFile,
+                                              NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("8:16 wiops=100", kResFile,
+                                              NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->UpdateMaxLimit(limits_set));
+}
+
 TEST_F(BlockIoControllerTest, UpdateMaxLimitMalformed) {
   BlockIoSpec::MaxLimitSet limits_set;
   BlockIoSpec::MaxLimit *max_limit = limits_set.add_max_limits();
@@ -370,6 +415,97 @@ TEST_F(BlockIoControllerTest, UpdateMaxLimitFail) {
   EXPECT_NOT_OK(controller_->UpdateMaxLimit(limits_set));
 }
 
+TEST_F(BlockIoControllerTest, ResetDefaultLimit) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::BlockIO::kWeight);
+
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("500", kResFile, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->ResetDefaultLimit());
+}
+
+TEST_F(BlockIoControllerTest, ResetDefaultLimitUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::IO::kWeight);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("default 100", kResFile, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->ResetDefaultLimit());
+}
+
+TEST_F(BlockIoControllerTest, ClearPerDeviceLimit) {
+  const string kResFile = JoinPath(kMountPoint,
+                                   KernelFiles::BlockIO::kPerDeviceWeight);
+  BlockIoSpec::DeviceLimitSet limits_set;
+  SetDeviceLimit(limits_set.add_device_limits(), 8, 0, 20);
+
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("8:0 0", kResFile, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->ClearPerDeviceLimit(limits_set));
+}
+
+TEST_F(BlockIoControllerTest, ClearPerDeviceLimitUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::IO::kWeight);
+  controller_->set_unified(true);
+  BlockIoSpec::DeviceLimitSet limits_set;
+  SetDeviceLimit(limits_set.add_device_limits(), 8, 0, 20);
+
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("8:0 default", kResFile, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->ClearPerDeviceLimit(limits_set));
+}
+
+TEST_F(BlockIoControllerTest, ClearPerDeviceLimitMalformed) {
+  BlockIoSpec::DeviceLimitSet limits_set;
+  // Missing major number.
+  limits_set.add_device_limits()->mutable_device()->set_minor(0);
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    controller_->ClearPerDeviceLimit(limits_set));
+}
+
+TEST_F(BlockIoControllerTest, ClearMaxLimit) {
+  const string kResFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kMaxWriteIoPerSecond);
+  BlockIoSpec::MaxLimitSet limits_set;
+  BlockIoSpec::MaxLimit *max_limit = limits_set.add_max_limits();
+  SetThrottlingType(max_limit, BlockIoSpec::WRITE, BlockIoSpec::IO_PER_SECOND);
+  SetDeviceLimit(max_limit->add_limits(), 8, 16, 100);
+
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("8:16 0", kResFile, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->ClearMaxLimit(limits_set));
+}
+
+TEST_F(BlockIoControllerTest, ClearMaxLimitUnified) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::IO::kMax);
+  controller_->set_unified(true);
+  BlockIoSpec::MaxLimitSet limits_set;
+  BlockIoSpec::MaxLimit *max_limit = limits_set.add_max_limits();
+  SetThrottlingType(max_limit, BlockIoSpec::WRITE, BlockIoSpec::IO_PER_SECOND);
+  SetDeviceLimit(max_limit->add_limits(), 8, 16, 100);
+
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("8:16 wiops=max", kResFile, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->ClearMaxLimit(limits_set));
+}
+
+TEST_F(BlockIoControllerTest, ClearMaxLimitMalformed) {
+  BlockIoSpec::MaxLimitSet limits_set;
+  // Missing op type.
+  BlockIoSpec::MaxLimit *max_limit = limits_set.add_max_limits();
+  max_limit->set_limit_type(BlockIoSpec::IO_PER_SECOND);
+  SetDeviceLimit(max_limit->add_limits(), 8, 16, 100);
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    controller_->ClearMaxLimit(limits_set));
+}
+
 TEST_F(BlockIoControllerTest, GetMaxLimitSuccess) {
   const string kReadBpsFile = JoinPath(
       kMountPoint, KernelFiles::BlockIO::kMaxReadBytesPerSecond);
@@ -428,6 +564,28 @@ TEST_F(BlockIoControllerTest, GetMaxLimitSuccess) {
   EXPECT_PROTOBUF_EQ(expected_limits_set, statusor.ValueOrDie());
 }
 
+TEST_F(BlockIoControllerTest, GetMaxLimitUnified) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::IO::kMax);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK)).WillRepeatedly(Return(0));
+  mock_file_lines_.ExpectFileLines(
+      kResFile, {"8:0 rbps=300 wbps=max riops=max wiops=100\n",
+                 "8:16 rbps=200 wbps=max riops=max wiops=max\n"});
+
+  BlockIoSpec::MaxLimitSet expected_limits_set;
+  BlockIoSpec::MaxLimit *max_limit = expected_limits_set.add_max_limits();
+  SetThrottlingType(max_limit, BlockIoSpec::READ,
+                    BlockIoSpec::BYTES_PER_SECOND);
+  SetDeviceLimit(max_limit->add_limits(), 8, 0, 300);
+  SetDeviceLimit(max_limit->add_limits(), 8, 16, 200);
+  max_limit = expected_limits_set.add_max_limits();
+  SetThrottlingType(max_limit, BlockIoSpec::WRITE, BlockIoSpec::IO_PER_SECOND);
+  SetDeviceLimit(max_limit->add_limits(), 8, 0, 100);
+  StatusOr<BlockIoSpec::MaxLimitSet> statusor = controller_->GetMaxLimit();
+  ASSERT_OK(statusor);
+  EXPECT_PROTOBUF_EQ(expected_limits_set, statusor.ValueOrDie());
+}
+
 TEST_F(BlockIoControllerTest, GetMaxLimitsNotFound) {
   const string kReadBpsFile = JoinPath(
       kMountPoint, KernelFiles::BlockIO::kMaxReadBytesPerSecond);
@@ -465,5 +623,207 @@ TEST_F(BlockIoControllerTest, GetMaxLimitsNotFound) {
   EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetMaxLimit());
 }
 
+TEST_F(BlockIoControllerTest, GetStatsSummary) {
+  const string kBytesFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kThrottledIoServiceBytes);
+  const string kServicedFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kThrottledIoServiced);
+  EXPECT_CALL(*mock_kernel_, Access(kBytesFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, Access(kServicedFile, F_OK))
+      .WillRepeatedly(Return(0));
+  mock_file_lines_.ExpectFileLines(
+      kBytesFile, {"8:0 Read 4096\n", "8:0 Write 8192\n", "8:0 Sync 0\n",
+                   "8:0 Async 12288\n", "8:0 Total 12288\n",
+                   "8:16 Read 512\n", "Total 12800\n"});
+  mock_file_lines_.ExpectFileLines(
+      kServicedFile, {"8:16 Read 1\n", "8:0 Read 1\n", "8:0 Write 2\n",
+                      "Total 4\n"});
+
+  BlockIoStats expected;
+  BlockIoStats::DeviceStats *device = expected.add_devices();
+  device->mutable_device()->set_major(8);
+  device->mutable_device()->set_minor(0);
+  BlockIoStats::OpStats *op_stats =
+      device->mutable_throttle_io_service_bytes();
+  op_stats->set_read(4096);
+  op_stats->set_write(8192);
+  op_stats->set_sync(0);
+  op_stats->set_async(12288);
+  op_stats->set_total(12288);
+  op_stats = device->mutable_throttle_io_serviced();
+  op_stats->set_read(1);
+  op_stats->set_write(2);
+  device = expected.add_devices();
+  device->mutable_device()->set_major(8);
+  device->mutable_device()->set_minor(16);
+  device->mutable_throttle_io_service_bytes()->set_read(512);
+  device->mutable_throttle_io_serviced()->set_read(1);
+
+  // The CFQ accounting is not read.
+  StatusOr<BlockIoStats> statusor =
+      controller_->GetStats(Container::STATS_SUMMARY);
+  ASSERT_OK(statusor);
+  EXPECT_PROTOBUF_EQ(expected, statusor.ValueOrDie());
+}
+
+TEST_F(BlockIoControllerTest, GetStatsFull) {
+  const string kThrottledBytesFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kThrottledIoServiceBytes);
+  const string kThrottledServicedFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kThrottledIoServiced);
+  const string kBytesFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kServiceBytes);
+  const string kServicedFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kServiced);
+  const string kWaitTimeFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kWaitTime);
+  const string kServiceTimeFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kServiceTime);
+  const string kQueuedFile = JoinPath(
+      kMountPoint, KernelFiles::BlockIO::kQueued);
+  for (const string &file : {kThrottledBytesFile, kThrottledServicedFile,
+                             kBytesFile, kServicedFile, kWaitTimeFile}) {
+    EXPECT_CALL(*mock_kernel_, Access(file, F_OK)).WillRepeatedly(Return(0));
+  }
+  // Kernels without CFQ don't have the times and the queued IOs.
+  EXPECT_CALL(*mock_kernel_, Access(kServiceTimeFile, F_OK))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(*mock_kernel_, Access(kQueuedFile, F_OK))
+      .WillRepeatedly(Return(-1));
+  mock_file_lines_.ExpectFileLines(kThrottledBytesFile,
+                                   {"8:0 Read 4096\n", "Total 4096\n"});
+  mock_file_lines_.ExpectFileLines(kThrottledServicedFile,
+                                   {"8:0 Read 1\n", "Total 1\n"});
+  mock_file_lines_.ExpectFileLines(kBytesFile,
+                                   {"8:0 Read 8192\n", "8:0 Discard 0\n",
+                                    "8:0 Unknown 3\n", "Total 8192\n"});
+  mock_file_lines_.ExpectFileLines(kServicedFile,
+                                   {"8:0 Read 2\n", "Total 2\n"});
+  mock_file_lines_.ExpectFileLines(kWaitTimeFile,
+                                   {"8:0 Read 1000\n", "Total 1000\n"});
+
+  BlockIoStats expected;
+  BlockIoStats::DeviceStats *device = expected.add_devices();
+  device->mutable_device()->set_major(8);
+  device->mutable_device()->set_minor(0);
+  device->mutable_throttle_io_service_bytes()->set_read(4096);
+  device->mutable_throttle_io_serviced()->set_read(1);
+  device->mutable_io_service_bytes()->set_read(8192);
+  device->mutable_io_service_bytes()->set_discard(0);
+  device->mutable_io_serviced()->set_read(2);
+  device->mutable_io_wait_time()->set_read(1000);
+
+  StatusOr<BlockIoStats> statusor =
+      controller_->GetStats(Container::STATS_FULL);
+  ASSERT_OK(statusor);
+  EXPECT_PROTOBUF_EQ(expected, statusor.ValueOrDie());
+}
+
+TEST_F(BlockIoControllerTest, GetStatsUnified) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::IO::kStat);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK)).WillRepeatedly(Return(0));
+  mock_file_lines_.ExpectFileLines(
+      kResFile,
+      {"8:0 rbytes=4096 wbytes=8192 rios=1 wios=2 dbytes=0 dios=0\n",
+       "8:16 rbytes=512 wbytes=0 rios=1 wios=0 dbytes=1024 dios=1\n",
+       "malformed\n"});
+
+  BlockIoStats expected;
+  BlockIoStats::DeviceStats *device = expected.add_devices();
+  device->mutable_device()->set_major(8);
+  device->mutable_device()->set_minor(0);
+  BlockIoStats::OpStats *op_stats = device->mutable_io_service_bytes();
+  op_stats->set_read(4096);
+  op_stats->set_write(8192);
+  op_stats->set_discard(0);
+  op_stats->set_total(12288);
+  op_stats = device->mutable_io_serviced();
+  op_stats->set_read(1);
+  op_stats->set_write(2);
+  op_stats->set_discard(0);
+  op_stats->set_total(3);
+  device = expected.add_devices();
+  device->mutable_device()->set_major(8);
+  device->mutable_device()->set_minor(16);
+  op_stats = device->mutable_io_service_bytes();
+  op_stats->set_read(512);
+  op_stats->set_write(0);
+  op_stats->set_discard(1024);
+  op_stats->set_total(1536);
+  op_stats = device->mutable_io_serviced();
+  op_stats->set_read(1);
+  op_stats->set_write(0);
+  op_stats->set_discard(1);
+  op_stats->set_total(2);
+
+  // The summary reads the same file.
+  StatusOr<BlockIoStats> statusor =
+      controller_->GetStats(Container::STATS_SUMMARY);
+  ASSERT_OK(statusor);
+  EXPECT_PROTOBUF_EQ(expected, statusor.ValueOrDie());
+}
+
+TEST_F(BlockIoControllerTest, GetStatsUnifiedNotFound) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::IO::kStat);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(-1));
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    controller_->GetStats(Container::STATS_FULL));
+}
+
+void NoOpCallback(Status status) {}
+
+TEST_F(BlockIoControllerTest, GetPressure) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::IO::kPressure);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(
+          SetArgPointee<1>("some avg10=2.00 avg60=1.00 avg300=0.50 total=42\n"
+                           "full avg10=0.00 avg60=0.00 avg300=0.00 total=7\n"),
+          Return(true)));
+
+  StatusOr<PressureData> statusor = controller_->GetPressure();
+  ASSERT_OK(statusor);
+  EXPECT_DOUBLE_EQ(2.0, statusor.ValueOrDie().some().avg10());
+  EXPECT_EQ(42, statusor.ValueOrDie().some().total());
+  EXPECT_EQ(7, statusor.ValueOrDie().full().total());
+}
+
+TEST_F(BlockIoControllerTest, GetPressureNotFound) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::IO::kPressure);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(-1));
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetPressure());
+}
+
+TEST_F(BlockIoControllerTest, RegisterPressureNotification) {
+  controller_->set_unified(true);
+  EventSpec::PressureThreshold threshold;
+  threshold.set_resource(EventSpec::PressureThreshold::IO);
+  threshold.set_threshold(100000);
+  threshold.set_window(1000000);
+
+  // Normally RegisterTriggerNotification() takes ownership, but we are mocking
+  // it out.
+  unique_ptr<CgroupController::EventCallback> cb(
+      NewPermanentCallback(&NoOpCallback));
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterTriggerNotification(kMountPoint, KernelFiles::Unified::IO::kPressure,
+                                          "some 100000 1000000", NotNull()))
+      .WillOnce(Return(1));
+
+  StatusOr<ActiveNotifications::Handle> statusor =
+      controller_->RegisterPressureNotification(threshold, cb.get());
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
 }  // namespace lmctfy
 }  // namespace containers
@@ -14,28 +14,40 @@
 
 #include "lmctfy/controllers/cgroup_controller.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <limits>
+
+#include "gflags/gflags.h"
 #include "file/base/file.h"
 #include "file/base/path.h"
+#include "lmctfy/controllers/cgroup_write_batch.h"
 #include "lmctfy/kernel_files.h"
 #include "global_utils/fs_utils.h"
 #include "util/errors.h"
 #include "util/scoped_cleanup.h"
-#include "system_api/libc_fs_api.h"
 #include "strings/numbers.h"
 #include "strings/split.h"
 #include "strings/stringpiece.h"
+#include "strings/strip.h"
 #include "strings/substitute.h"
 #include "util/task/codes.pb.h"
 #include "util/task/status.h"
 
+DEFINE_string(lmctfy_release_agent, "/usr/local/bin/lmctfy-release-agent",
+              "The release agent to set on cgroup v1 hierarchies to be "
+              "notified of containers becoming empty.");
+
 using ::file::Basename;
 using ::file::JoinPath;
 using ::util::FileLines;
 using ::util::GlobalFsUtils;
-using ::system_api::GlobalLibcFsApi;
 using ::util::UnixGid;
 using ::util::UnixUid;
 using ::util::ScopedCleanup;
+using ::std::map;
+using ::std::sort;
 using ::std::unique_ptr;
 using ::std::vector;
 using ::strings::SkipEmpty;
@@ -50,6 +62,12 @@ using ::util::StatusOr;
 namespace containers {
 namespace lmctfy {
 
+// Size of the buffer PID files are read into.
+static const int kPidReadBufferSize = 4096;
+
+// Value of the limits of the unified hierarchy for no limit.
+static const char kUnifiedNoLimit[] = "max";
+
 CgroupController::CgroupController(CgroupHierarchy type,
                                    const string &hierarchy_path,
                                    const string &cgroup_path, bool owns_cgroup,
@@ -60,7 +78,11 @@ CgroupController::CgroupController(CgroupHierarchy type,
       cgroup_path_(cgroup_path),
       owns_cgroup_(owns_cgroup),
       kernel_(CHECK_NOTNULL(kernel)),
-      eventfd_notifications_(CHECK_NOTNULL(eventfd_notifications)) {}
+      eventfd_notifications_(CHECK_NOTNULL(eventfd_notifications)),
+      file_cache_(nullptr),
+      kernel_features_(nullptr),
+      tree_index_(nullptr),
+      unified_(false) {}
 
 CgroupController::~CgroupController() {
 }
@@ -81,7 +103,48 @@ Status CgroupController::Enter(pid_t tid) {
     return Status::OK;
   }
 
-  return SetParamInt(KernelFiles::CGroup::kTasks, tid);
+  if (!unified_) {
+    return SetParamInt(KernelFiles::CGroup::kTasks, tid);
+  }
+
+  // The unified hierarchy has no tasks file: cgroup.procs moves all the threads
+  // of a process, so it only takes thread group leaders. A single thread (0
+  // being the calling one) can only move through cgroup.threads, which the
+  // kernel only allows within a threaded subtree.
+  if (tid != 0 && RETURN_IF_ERROR(IsThreadGroupLeader(tid))) {
+    return SetParamInt(KernelFiles::CGroup::kProcesses, tid);
+  }
+  string type = RETURN_IF_ERROR(GetParamString(KernelFiles::Unified::kType));
+  StripTrailingWhitespace(&type);
+  if (type != KernelFiles::Unified::Types::kThreaded) {
+    return Status(::util::error::UNIMPLEMENTED,
+                  Substitute("Cannot enter TID $0 alone into \"$1\", only "
+                             "threaded cgroups take single threads",
+                             tid, cgroup_path_));
+  }
+  return SetParamInt(KernelFiles::Unified::kThreads, tid);
+}
+
+StatusOr<bool> CgroupController::IsThreadGroupLeader(pid_t tid) const {
+  static const char kTgid[] = "Tgid:";
+  const string proc_status = Substitute("/proc/$0/status", tid);
+  const string contents = RETURN_IF_ERROR(ReadStringFromFile(proc_status));
+
+  for (StringPiece line : Split(contents, "\n", SkipEmpty())) {
+    if (line.starts_with(kTgid)) {
+      line.remove_prefix(strlen(kTgid));
+      pid_t tgid;
+      if (!SimpleAtoi(line.ToString(), &tgid)) {
+        return Status(INTERNAL,
+                      Substitute("Cannot parse TGID from line \"$0\" of \"$1\"",
+                                 line, proc_status));
+      }
+      return tgid == tid;
+    }
+  }
+
+  return Status(::util::error::NOT_FOUND,
+                Substitute("Failed to find $0 in \"$1\"", kTgid, proc_status));
 }
 
 Status CgroupController::Delegate(UnixUid uid, UnixGid gid) {
@@ -97,25 +160,54 @@ Status CgroupController::Delegate(UnixUid uid, UnixGid gid) {
         "with error: $3", cgroup_path_, uid.value(), gid.value(), errno));
   }
 
-  // Chown the tasks file so that the user/group can enter the container.
-  const string kTasksFile = CgroupFilePath(KernelFiles::CGroup::kTasks);
-  if (kernel_->Chown(kTasksFile, uid.value(), gid.value()) != 0) {
-    return Status(FAILED_PRECONDITION, Substitute(
-        "Failed to chown tasks file \"$0\" to UID $1 and GID $2 "
-        "with error: $3", kTasksFile, uid.value(), gid.value(), errno));
+  // Chown the tasks file so that the user/group can enter the container. In
+  // the unified hierarchy these are the files listed as delegatable by the
+  // kernel documentation.
+  vector<string> files;
+  if (unified_) {
+    files = {KernelFiles::CGroup::kProcesses, KernelFiles::Unified::kThreads,
+             KernelFiles::Unified::kSubtreeControl};
+  } else {
+    files = {KernelFiles::CGroup::kTasks};
+  }
+  for (const string &file : files) {
+    const string file_path = CgroupFilePath(file);
+    if (kernel_->Chown(file_path, uid.value(), gid.value()) != 0) {
+      return Status(FAILED_PRECONDITION, Substitute(
+          "Failed to chown tasks file \"$0\" to UID $1 and GID $2 "
+          "with error: $3", file_path, uid.value(), gid.value(), errno));
+    }
   }
 
   return Status::OK;
 }
 
 StatusOr<vector<pid_t>> CgroupController::GetThreads() const {
-  return GetPids(KernelFiles::CGroup::kTasks);
+  return GetPids(ThreadsFile());
 }
 
 StatusOr<vector<pid_t>> CgroupController::GetProcesses() const {
   return GetPids(KernelFiles::CGroup::kProcesses);
 }
 
+Status CgroupController::VisitThreads(const PidVisitor &visitor) const {
+  return VisitPids(ThreadsFile(), visitor);
+}
+
+Status CgroupController::VisitProcesses(const PidVisitor &visitor) const {
+  return VisitPids(KernelFiles::CGroup::kProcesses, visitor);
+}
+
+Status CgroupController::VisitThreadsRecursive(
+    const PidVisitor &visitor) const {
+  return VisitPidsRecursive(ThreadsFile(), visitor);
+}
+
+Status CgroupController::VisitProcessesRecursive(
+    const PidVisitor &visitor) const {
+  return VisitPidsRecursive(KernelFiles::CGroup::kProcesses, visitor);
+}
+
 StatusOr<vector<string>> CgroupController::GetSubcontainers() const {
   vector<string> subdirs;
   RETURN_IF_ERROR(GetSubdirectories(cgroup_path_, &subdirs));
@@ -124,9 +216,49 @@ StatusOr<vector<string>> CgroupController::GetSubcontainers() const {
   }
   return subdirs;
 }
+
+StatusOr<vector<string>> CgroupController::GetSubcontainersRecursive() const {
+  if (tree_index_ != nullptr) {
+    return tree_index_->ListDescendants(cgroup_path_);
+  }
+
+  vector<string> subcontainers;
+  Status status = GlobalFsUtils()->WalkDirectoryTree(
+      cgroup_path_, [&subcontainers](const string &relative_path) {
+        subcontainers.emplace_back(relative_path);
+      });
+  if (!status.ok()) {
+    return Status(FAILED_PRECONDITION, status.error_message());
+  }
+
+  sort(subcontainers.begin(), subcontainers.end());
+  return subcontainers;
+}
+
+StatusOr<bool> CgroupController::IsPopulated() const {
+  if (!unified_) {
+    return Status(FAILED_PRECONDITION,
+                  Substitute("Cgroup \"$0\" is not in the unified hierarchy",
+                             cgroup_path_));
+  }
+
+  const map<string, int64> events =
+      RETURN_IF_ERROR(GetParamKeyed(KernelFiles::Unified::kEvents));
+  auto it = events.find(KernelFiles::Unified::Events::kPopulated);
+  if (it == events.end()) {
+    return Status(INTERNAL, Substitute("Failed to find \"$0\" in \"$1\"",
+                                       KernelFiles::Unified::Events::kPopulated,
+                                       CgroupFilePath(
+                                           KernelFiles::Unified::kEvents)));
+  }
+  return it->second != 0;
+}
+
+// Children inherit the configuration of their parent in the unified hierarchy,
+// there is nothing to enable or disable.
 Status CgroupController::EnableCloneChildren() {
   // No-op if the underlying cgroup is not owned by this controller.
-  if (!owns_cgroup_) {
+  if (!owns_cgroup_ || unified_) {
     return Status::OK;
   }
 
@@ -135,7 +267,7 @@ Status CgroupController::EnableCloneChildren() {
 
 Status CgroupController::DisableCloneChildren() {
   // No-op if the underlying cgroup is not owned by this controller.
-  if (!owns_cgroup_) {
+  if (!owns_cgroup_ || unified_) {
     return Status::OK;
   }
 
@@ -154,7 +286,25 @@ Status CgroupController::SetParamInt(const string &cgroup_file,
 
 Status CgroupController::SetParamString(const string &cgroup_file,
                                         const string &value) {
+  RETURN_IF_ERROR(CheckSupported(cgroup_file));
+
   const string file_path = CgroupFilePath(cgroup_file);
+
+  // Writes made while a batch is open on this thread are applied by the batch.
+  // With a file cache the current value is read from the cached file
+  // descriptor with a single pread(), the batch would open the file.
+  CgroupWriteBatch *batch = CgroupWriteBatch::Current();
+  if (batch != nullptr) {
+    string current;
+    if (file_cache_ != nullptr && !batch->Lookup(file_path, &current)) {
+      StatusOr<string> statusor = file_cache_->Read(file_path);
+      if (statusor.ok()) {
+        batch->RecordRead(file_path, statusor.ValueOrDie());
+      }
+    }
+    return batch->Add(file_path, value);
+  }
+
   return WriteStringToFile(file_path, value);
 }
 
@@ -164,6 +314,9 @@ Status CgroupController::SetChildrenLimit(int64 value) {
     return Status::OK;
   }
 
+  if (unified_) {
+    return SetParamLimit(KernelFiles::Unified::kMaxDescendants, value);
+  }
   return SetParamInt(KernelFiles::CGroup::Children::kLimit, value);
 }
 
@@ -205,34 +358,233 @@ StatusOr<int64> CgroupController::GetParamInt(
 
 StatusOr<string> CgroupController::GetParamString(
     const string &cgroup_file) const {
-  return ReadStringFromFile(CgroupFilePath(cgroup_file));
+  RETURN_IF_ERROR(CheckSupported(cgroup_file));
+
+  const string file_path = CgroupFilePath(cgroup_file);
+
+  // Files written by the open batch of this thread read as they will be once
+  // it is committed, those already read are not read again.
+  CgroupWriteBatch *batch = CgroupWriteBatch::Current();
+  string value;
+  if (batch != nullptr && batch->Lookup(file_path, &value)) {
+    return value;
+  }
+
+  StatusOr<string> statusor;
+  if (file_cache_ != nullptr && CgroupFileCache::IsCacheable(cgroup_file)) {
+    statusor = file_cache_->Read(file_path);
+  } else {
+    statusor = ReadStringFromFile(file_path);
+  }
+
+  if (kernel_features_ != nullptr &&
+      kernel_features_->IsUndetected(type_, cgroup_file)) {
+    DetectSupport(cgroup_file, statusor.status());
+  }
+  if (batch != nullptr && statusor.ok()) {
+    batch->RecordRead(file_path, statusor.ValueOrDie());
+  }
+  return statusor;
 }
 
-// TODO(vmarmol): Implement this iteratively.
-StatusOr<vector<pid_t>> CgroupController::GetPids(
+StatusOr<map<string, int64>> CgroupController::GetParamKeyed(
     const string &cgroup_file) const {
-  string all_pids = RETURN_IF_ERROR(GetParamString(cgroup_file));
-  const vector<string> pid_strings = Split(all_pids, "\n", SkipEmpty());
+  const string contents = RETURN_IF_ERROR(GetParamString(cgroup_file));
+
+  map<string, int64> values;
+  for (StringPiece line : Split(contents, "\n", SkipEmpty())) {
+    const vector<string> key_value = Split(line, " ", SkipEmpty());
+    int64 value = 0;
+    if (key_value.size() != 2 || !SimpleAtoi(key_value[1], &value)) {
+      return Status(INTERNAL,
+                    Substitute("Failed to parse key and value from line "
+                               "\"$0\" of \"$1\"",
+                               line, CgroupFilePath(cgroup_file)));
+    }
+    values[key_value[0]] = value;
+  }
+  return values;
+}
 
-  // Parse all the PIDs.
-  vector<pid_t> pids;
-  pids.reserve(pid_strings.size());
-  for (const string &pid_string : pid_strings) {
-    pid_t pid;
-    if (!SimpleAtoi(pid_string, &pid)) {
-      return Status(::util::error::FAILED_PRECONDITION,
-                    Substitute("Unknown PID \"$0\" found in cgroup file \"$1\"",
-                               pid_string, cgroup_file));
+Status CgroupController::SetParamLimit(const string &cgroup_file,
+                                       int64 value) {
+  if (value < 0 || value == ::std::numeric_limits<int64>::max()) {
+    return SetParamString(cgroup_file, kUnifiedNoLimit);
+  }
+  return SetParamInt(cgroup_file, value);
+}
+
+StatusOr<int64> CgroupController::GetParamLimit(
+    const string &cgroup_file) const {
+  string value = RETURN_IF_ERROR(GetParamString(cgroup_file));
+  StripTrailingWhitespace(&value);
+  if (value == kUnifiedNoLimit) {
+    return ::std::numeric_limits<int64>::max();
+  }
+
+  int64 limit = 0;
+  if (!SimpleAtoi(value, &limit)) {
+    return Status(FAILED_PRECONDITION,
+                  Substitute("Failed to parse limit from string \"$0\"",
+                             value));
+  }
+  return limit;
+}
+
+StatusOr<PressureData> CgroupController::GetParamPressure(
+    const string &cgroup_file) const {
+  const string contents = RETURN_IF_ERROR(GetParamString(cgroup_file));
+
+  PressureData pressure;
+  for (StringPiece line : Split(contents, "\n", SkipEmpty())) {
+    const vector<string> fields = Split(line, " ", SkipEmpty());
+    PressureData::Stall *stall = nullptr;
+    if (!fields.empty() && fields[0] == KernelFiles::Unified::Pressure::kSome) {
+      stall = pressure.mutable_some();
+    } else if (!fields.empty() &&
+               fields[0] == KernelFiles::Unified::Pressure::kFull) {
+      stall = pressure.mutable_full();
+    } else {
+      return Status(INTERNAL,
+                    Substitute("Unknown pressure line \"$0\" in \"$1\"", line,
+                               CgroupFilePath(cgroup_file)));
     }
 
-    pids.push_back(pid);
+    for (int i = 1; i < fields.size(); ++i) {
+      const vector<string> key_value = Split(fields[i], "=");
+      bool parsed = key_value.size() == 2;
+      if (parsed) {
+        const string &key = key_value[0];
+        const string &value = key_value[1];
+        double avg = 0;
+        uint64 total = 0;
+        if (key == KernelFiles::Unified::Pressure::kAvg10) {
+          parsed = safe_strtod(value, &avg);
+          stall->set_avg10(avg);
+        } else if (key == KernelFiles::Unified::Pressure::kAvg60) {
+          parsed = safe_strtod(value, &avg);
+          stall->set_avg60(avg);
+        } else if (key == KernelFiles::Unified::Pressure::kAvg300) {
+          parsed = safe_strtod(value, &avg);
+          stall->set_avg300(avg);
+        } else if (key == KernelFiles::Unified::Pressure::kTotal) {
+          parsed = safe_strtou64(value, &total);
+          stall->set_total(total);
+        }
+      }
+      if (!parsed) {
+        return Status(INTERNAL,
+                      Substitute("Failed to parse \"$0\" from line \"$1\" of "
+                                 "\"$2\"",
+                                 fields[i], line, CgroupFilePath(cgroup_file)));
+      }
+    }
   }
+  return pressure;
+}
 
+StatusOr<vector<pid_t>> CgroupController::GetPids(
+    const string &cgroup_file) const {
+  vector<pid_t> pids;
+  RETURN_IF_ERROR(
+      VisitPids(cgroup_file, [&pids](pid_t pid) { pids.push_back(pid); }));
   return pids;
 }
 
+Status CgroupController::VisitPids(const string &cgroup_file,
+                                   const PidVisitor &visitor) const {
+  return VisitPidsAtPath(CgroupFilePath(cgroup_file), visitor);
+}
+
+Status CgroupController::VisitPidsRecursive(const string &cgroup_file,
+                                            const PidVisitor &visitor) const {
+  RETURN_IF_ERROR(VisitPids(cgroup_file, visitor));
+
+  const vector<string> subcontainers =
+      RETURN_IF_ERROR(GetSubcontainersRecursive());
+  for (const string &subcontainer : subcontainers) {
+    Status status = VisitPidsAtPath(
+        JoinPath(cgroup_path_, subcontainer, cgroup_file), visitor);
+
+    // The subcontainer was removed since it was listed.
+    if (!status.ok() && status.error_code() != ::util::error::NOT_FOUND) {
+      return status;
+    }
+  }
+
+  return Status::OK;
+}
+
+Status CgroupController::VisitPidsAtPath(const string &file_path,
+                                         const PidVisitor &visitor) const {
+  const int fd = kernel_->Open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return Status(::util::error::NOT_FOUND,
+                    Substitute("File \"$0\" not found", file_path));
+    }
+    return Status(FAILED_PRECONDITION,
+                  Substitute("Failed to open file \"$0\" with error \"$1\"",
+                             file_path, StrError(errno)));
+  }
+  ScopedCleanup close_fd([this, fd]() { kernel_->Close(fd); });
+
+  // PIDs are accumulated digit by digit so that one may span two reads.
+  char buffer[kPidReadBufferSize];
+  int64 pid = 0;
+  bool in_pid = false;
+  while (true) {
+    const ssize_t bytes_read = kernel_->Read(fd, buffer, sizeof(buffer));
+    if (bytes_read < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status(FAILED_PRECONDITION,
+                    Substitute("Failed to read contents of file \"$0\" with "
+                               "error \"$1\"",
+                               file_path, StrError(errno)));
+    } else if (bytes_read == 0) {
+      break;
+    }
+
+    for (ssize_t i = 0; i < bytes_read; ++i) {
+      const char c = buffer[i];
+      if (c >= '0' && c <= '9') {
+        pid = pid * 10 + (c - '0');
+        if (pid > ::std::numeric_limits<pid_t>::max()) {
+          return Status(FAILED_PRECONDITION,
+                        Substitute("PID out of range found in cgroup file "
+                                   "\"$0\"",
+                                   file_path));
+        }
+        in_pid = true;
+      } else if (c == '\n') {
+        if (in_pid) {
+          visitor(static_cast<pid_t>(pid));
+        }
+        pid = 0;
+        in_pid = false;
+      } else {
+        return Status(FAILED_PRECONDITION,
+                      Substitute("Unexpected character \"$0\" in PID found "
+                                 "in cgroup file \"$1\"",
+                                 StringPiece(&buffer[i], 1), file_path));
+      }
+    }
+  }
+
+  // The last PID may not be newline-terminated.
+  if (in_pid) {
+    visitor(static_cast<pid_t>(pid));
+  }
+
+  return Status::OK;
+}
+
 StatusOr<FileLines> CgroupController::GetParamLines(
     const string &cgroup_file) const {
+  RETURN_IF_ERROR(CheckSupported(cgroup_file));
+
   const string file_path = CgroupFilePath(cgroup_file);
 
   // Ensure the file exists.
@@ -248,48 +600,35 @@ StatusOr<FileLines> CgroupController::GetParamLines(
 // of the provided vector.
 Status CgroupController::GetSubdirectories(const string &path,
                                            vector<string> *entries) const {
-  DIR *dir = GlobalLibcFsApi()->OpenDir(path.c_str());
-  if (dir == nullptr) {
-    return Status(FAILED_PRECONDITION, Substitute(
-        "Unable to open directory \"$0\" with error \"$1\"",
-        path, StrError(errno)));
+  StatusOr<vector<string>> statusor =
+      GlobalFsUtils()->ListSubdirectories(path);
+  if (!statusor.ok()) {
+    return Status(FAILED_PRECONDITION, statusor.status().error_message());
   }
-  ScopedCleanup cleanup([dir]() {
-    GlobalLibcFsApi()->CloseDir(dir);
-  });
-  struct dirent readdir_buf, *de = nullptr;
-  while (GlobalLibcFsApi()->ReadDirR(dir, &readdir_buf, &de) == 0 &&
-         de != nullptr) {
-    if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0) {
-      string full_path = file::JoinPath(path, de->d_name);
-      Status status = GlobalFsUtils()->DirExists(full_path);
-      if (status.ok()) {
-        entries->emplace_back(full_path);
-      } else if (status.error_code() != INVALID_ARGUMENT) {
-        return status;
-      }
-    }
+  for (const string &name : statusor.ValueOrDie()) {
+    entries->emplace_back(file::JoinPath(path, name));
   }
   return Status::OK;
 }
 
 Status CgroupController::DeleteCgroupHierarchy(const string &path) const {
-  vector<string> dirs_to_delete;
-  vector<string> dirs_to_check;
-
-  dirs_to_check.push_back(path);
-  while (!dirs_to_check.empty()) {
-    // Get the last element from dirs_to_check
-    const string current_path = dirs_to_check.back();
-    dirs_to_check.pop_back();
-
-    RETURN_IF_ERROR(GetSubdirectories(current_path, &dirs_to_check));
+  // Close any cached files so they don't outlive the cgroups.
+  if (file_cache_ != nullptr) {
+    file_cache_->Invalidate(path);
+  }
 
-    dirs_to_delete.emplace_back(current_path);
+  // Parents are visited before their subdirectories, delete in reverse.
+  vector<string> dirs_to_delete;
+  Status status = GlobalFsUtils()->WalkDirectoryTree(
+      path, [&dirs_to_delete](const string &relative_path) {
+        dirs_to_delete.emplace_back(relative_path);
+      });
+  if (!status.ok()) {
+    return Status(FAILED_PRECONDITION, status.error_message());
   }
 
   while (!dirs_to_delete.empty()) {
-    const string current_path = dirs_to_delete.back();
+    const string current_path = JoinPath(path, dirs_to_delete.back());
     if (kernel_->RmDir(current_path) < 0) {
       return Status(FAILED_PRECONDITION, Substitute(
           "Unable to delete directory \"$0\" with error \"$1\"",
@@ -297,10 +636,18 @@ Status CgroupController::DeleteCgroupHierarchy(const string &path) const {
     }
     dirs_to_delete.pop_back();
   }
+  if (kernel_->RmDir(path) < 0) {
+    return Status(FAILED_PRECONDITION, Substitute(
+        "Unable to delete directory \"$0\" with error \"$1\"",
+        path, StrError(errno)));
+  }
   return Status::OK;
 }
 
 StatusOr<int64> CgroupController::GetChildrenLimit() const {
+  if (unified_) {
+    return GetParamLimit(KernelFiles::Unified::kMaxDescendants);
+  }
   return GetParamInt(KernelFiles::CGroup::Children::kLimit);
 }
 
@@ -314,9 +661,92 @@ StatusOr<ActiveNotifications::Handle> CgroupController::RegisterNotification(
                                                       arguments, callback);
 }
 
-// TODO(vmarmol): We currently do feature detection on each read/write, this is
-// very time consuming and prone to flakyness. We should move towards feature
-// detection in init (existing bug).
+StatusOr<ActiveNotifications::Handle>
+CgroupController::RegisterPressureNotification(
+    const string &cgroup_file, const EventSpec::PressureThreshold &threshold,
+    EventCallback *callback) {
+  CHECK_NOTNULL(callback);
+  callback->CheckIsRepeatable();
+  unique_ptr<EventCallback> callback_owner(callback);
+
+  if (!unified_) {
+    return Status(FAILED_PRECONDITION,
+                  Substitute("Pressure notifications require the unified "
+                             "hierarchy, cgroup \"$0\" is not in it",
+                             cgroup_path_));
+  }
+  if (!threshold.has_threshold() || !threshold.has_window()) {
+    return Status(INVALID_ARGUMENT,
+                  "Pressure notifications require a threshold and a window");
+  }
+
+  const string trigger =
+      Substitute("$0 $1 $2",
+                 threshold.type() == EventSpec::PressureThreshold::FULL
+                     ? KernelFiles::Unified::Pressure::kFull
+                     : KernelFiles::Unified::Pressure::kSome,
+                 threshold.threshold(), threshold.window());
+  return eventfd_notifications_->RegisterTriggerNotification(
+      cgroup_path_, cgroup_file, trigger, callback_owner.release());
+}
+
+StatusOr<ActiveNotifications::Handle>
+CgroupController::RegisterEmptyNotification(EventCallback *callback) {
+  CHECK_NOTNULL(callback);
+  callback->CheckIsRepeatable();
+  unique_ptr<EventCallback> callback_owner(callback);
+
+  if (unified_) {
+    return eventfd_notifications_->RegisterWatchNotification(
+        cgroup_path_, KernelFiles::Unified::kEvents,
+        Substitute("$0 0", KernelFiles::Unified::Events::kPopulated),
+        callback_owner.release());
+  }
+
+  // The release agent is set on the root of the hierarchy and run with the
+  // path of the released cgroup relative to it.
+  if (hierarchy_path_.empty() || hierarchy_path_ == "/" ||
+      !StringPiece(cgroup_path_).ends_with(hierarchy_path_)) {
+    return Status(FAILED_PRECONDITION,
+                  Substitute("Cannot find the root of the hierarchy of cgroup "
+                             "\"$0\"", cgroup_path_));
+  }
+  const string release_agent_path = JoinPath(
+      cgroup_path_.substr(0, cgroup_path_.size() - hierarchy_path_.size()),
+      KernelFiles::CGroup::kReleaseAgent);
+  string release_agent =
+      RETURN_IF_ERROR(ReadStringFromFile(release_agent_path));
+  StripTrailingWhitespace(&release_agent);
+  if (release_agent.empty()) {
+    RETURN_IF_ERROR(
+        WriteStringToFile(release_agent_path, FLAGS_lmctfy_release_agent));
+  } else if (release_agent != FLAGS_lmctfy_release_agent) {
+    return Status(FAILED_PRECONDITION,
+                  Substitute("Release agent of \"$0\" is \"$1\", expected "
+                             "\"$2\"", release_agent_path, release_agent,
+                             FLAGS_lmctfy_release_agent));
+  }
+
+  RETURN_IF_ERROR(SetParamBool(KernelFiles::CGroup::kNotifyOnRelease, true));
+  return eventfd_notifications_->RegisterReleaseNotification(
+      hierarchy_path_, callback_owner.release());
+}
+
+Status CgroupController::ClearReleaseNotification() {
+  if (!owns_cgroup_ || unified_) {
+    return Status::OK;
+  }
+
+  // Only write when it was inherited, which is rare.
+  if (!RETURN_IF_ERROR(GetParamBool(KernelFiles::CGroup::kNotifyOnRelease))) {
+    return Status::OK;
+  }
+  return SetParamBool(KernelFiles::CGroup::kNotifyOnRelease, false);
+}
+
+// Optional files known to be missing are rejected before getting here (see
+// CheckSupported()), the check below only tells a missing cgroup apart from a
+// failed read.
 // TODO(vmarmol): Use GetFileContents().
 StatusOr<string> CgroupController::ReadStringFromFile(
     const string &file_path) const {
@@ -359,10 +789,37 @@ Status CgroupController::WriteStringToFile(const string &file_path,
   return Status::OK;
 }
 
+Status CgroupController::CheckSupported(const string &cgroup_file) const {
+  if (kernel_features_ != nullptr &&
+      kernel_features_->IsMissing(type_, cgroup_file)) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("File \"$0\" is not supported by the kernel",
+                             CgroupFilePath(cgroup_file)));
+  }
+
+  return Status::OK;
+}
+
+void CgroupController::DetectSupport(const string &cgroup_file,
+                                     const Status &read_status) const {
+  if (read_status.ok()) {
+    kernel_features_->Record(type_, cgroup_file, true);
+  } else if (read_status.error_code() == ::util::error::NOT_FOUND &&
+             kernel_->Access(cgroup_path_, F_OK) == 0) {
+    // The cgroup exists but the file does not.
+    kernel_features_->Record(type_, cgroup_file, false);
+  }
+}
+
 string CgroupController::CgroupFilePath(const string &cgroup_file) const {
   return JoinPath(cgroup_path_, cgroup_file);
 }
 
+const char *CgroupController::ThreadsFile() const {
+  return unified_ ? KernelFiles::Unified::kThreads
+                  : KernelFiles::CGroup::kTasks;
+}
+
 Status CgroupController::PopulateMachineSpec(MachineSpec *spec) const {
   auto *virt_root = spec->mutable_virtual_root()->add_cgroup_virtual_root();
   virt_root->set_root(hierarchy_path_);
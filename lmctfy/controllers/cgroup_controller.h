@@ -16,6 +16,8 @@
 #define SRC_CONTROLLERS_CGROUP_CONTROLLER_H_
 
 #include <sys/types.h>
+#include <functional>
+#include <map>
 #include <string>
 using ::std::string;
 #include <vector>
@@ -25,7 +27,10 @@ using ::std::string;
 #include "base/macros.h"
 #include "system_api/kernel_api.h"
 #include "lmctfy/controllers/cgroup_factory.h"
+#include "lmctfy/controllers/cgroup_file_cache.h"
+#include "lmctfy/controllers/cgroup_tree_index.h"
 #include "lmctfy/controllers/eventfd_notifications.h"
+#include "lmctfy/controllers/kernel_features.h"
 #include "include/lmctfy.pb.h"
 #include "util/safe_types/unix_gid.h"
 #include "util/safe_types/unix_uid.h"
@@ -148,8 +153,14 @@ class CgroupControllerFactory
       return statusor.status();
     }
 
-    return new ControllerType(hierarchy_path, statusor.ValueOrDie(),
-                              owns_cgroup_, kernel_, eventfd_notifications_);
+    ControllerType *controller =
+        new ControllerType(hierarchy_path, statusor.ValueOrDie(), owns_cgroup_,
+                           kernel_, eventfd_notifications_);
+    controller->set_file_cache(cgroup_factory_->file_cache());
+    controller->set_kernel_features(cgroup_factory_->kernel_features());
+    controller->set_tree_index(cgroup_factory_->tree_index());
+    controller->set_unified(cgroup_factory_->IsUnified(hierarchy_type));
+    return controller;
   }
 
   ::util::StatusOr<ControllerType *> Create(const string &hierarchy_path)
@@ -164,8 +175,14 @@ class CgroupControllerFactory
           cgroup_factory_->Get(hierarchy_type, hierarchy_path));
     }
 
-    return new ControllerType(hierarchy_path, cgroup_path, owns_cgroup_,
-                              kernel_, eventfd_notifications_);
+    ControllerType *controller =
+        new ControllerType(hierarchy_path, cgroup_path, owns_cgroup_, kernel_,
+                           eventfd_notifications_);
+    controller->set_file_cache(cgroup_factory_->file_cache());
+    controller->set_kernel_features(cgroup_factory_->kernel_features());
+    controller->set_tree_index(cgroup_factory_->tree_index());
+    controller->set_unified(cgroup_factory_->IsUnified(hierarchy_type));
+    return controller;
   }
 
   bool Exists(const string &hierarchy_path) const override {
@@ -223,6 +240,9 @@ class CgroupController {
   // value if an error occured.
   typedef Callback1< ::util::Status> EventCallback;
 
+  // Visitor of the PIDs/TIDs in a cgroup, called once per PID/TID.
+  typedef ::std::function<void(pid_t pid)> PidVisitor;
+
   virtual ~CgroupController();
 
   // Destroys the underlying cgroup_path (if this controller owns it) and
@@ -233,11 +253,16 @@ class CgroupController {
   virtual ::util::Status Destroy();
 
   // Enters the specified TID into this controller (if this controller owns it).
+  // In the unified hierarchy a thread group leader is entered with all its
+  // threads, any other thread (including 0, the calling thread) is entered
+  // alone, which the kernel only allows into threaded cgroups.
   //
   // Arguments:
   //   tid: The TID to enter into this controller.
   // Return:
   //   Status: Status of the operation. Iff OK, the operation was successful.
+  //       UNIMPLEMENTED if a single thread is entered into a unified cgroup
+  //       that is not threaded.
   virtual ::util::Status Enter(pid_t tid);
 
   // Delegates the controller to the specified user and group. This user/group
@@ -273,6 +298,41 @@ class CgroupController {
   //       process PIDs is provided.
   virtual ::util::StatusOr< ::std::vector<pid_t>> GetProcesses() const;
 
+  // Calls visitor with each of the threads in this cgroup. Unlike GetThreads()
+  // the PIDs are parsed as the file is read, the full list is never held in
+  // memory.
+  //
+  // Arguments:
+  //   visitor: Called with each thread PID, in the order the kernel lists them.
+  // Return:
+  //   Status: Status of the operation. Iff OK, all threads were visited.
+  virtual ::util::Status VisitThreads(const PidVisitor &visitor) const;
+
+  // Calls visitor with each of the processes in this cgroup. Unlike
+  // GetProcesses() the full list is never held in memory.
+  //
+  // Arguments:
+  //   visitor: Called with each process PID, in the order the kernel lists
+  //       them.
+  // Return:
+  //   Status: Status of the operation. Iff OK, all processes were visited.
+  virtual ::util::Status VisitProcesses(const PidVisitor &visitor) const;
+
+  // Calls visitor with each of the threads in this cgroup and in all of its
+  // descendants. Descendants removed while they are visited are skipped.
+  //
+  // Arguments:
+  //   visitor: Called with each thread PID. A PID that moves between cgroups
+  //       while they are visited may be visited more than once.
+  // Return:
+  //   Status: Status of the operation. Iff OK, all threads were visited.
+  virtual ::util::Status VisitThreadsRecursive(const PidVisitor &visitor) const;
+
+  // Calls visitor with each of the processes in this cgroup and in all of its
+  // descendants. See VisitThreadsRecursive().
+  virtual ::util::Status VisitProcessesRecursive(
+      const PidVisitor &visitor) const;
+
   // Gets the subcontainers of this cgroup. By default this is considered the
   // subdirectories of this cgroup.
   //
@@ -282,6 +342,51 @@ class CgroupController {
   //       container.
   virtual ::util::StatusOr< ::std::vector<string>> GetSubcontainers() const;
 
+  // Gets all subcontainers of this cgroup, recursively. Served from the tree
+  // index if one is set.
+  //
+  // Return:
+  //   StatusOr<vector<string>>: Status of the operation. Iff OK, the sorted
+  //       list of subcontainers is populated. These names are relative to the
+  //       current container (e.g.: "sub", "sub/subsub").
+  virtual ::util::StatusOr< ::std::vector<string>> GetSubcontainersRecursive()
+      const;
+
+  // Determines whether there are any processes in this cgroup or in any of its
+  // descendants. Only supported in the unified hierarchy, where the kernel
+  // keeps track of it in cgroup.events.
+  //
+  // Return:
+  //   StatusOr<bool>: Status of the operation. Iff OK, whether the cgroup is
+  //       populated. FAILED_PRECONDITION if the cgroup is not in the unified
+  //       hierarchy.
+  virtual ::util::StatusOr<bool> IsPopulated() const;
+
+  // Registers a notification for when there are no longer any processes in
+  // this cgroup or in any of its descendants. It is delivered each time the
+  // cgroup becomes empty, not when it already is. In the unified hierarchy
+  // cgroup.events is watched. Elsewhere notify_on_release is set and the
+  // release agent of the hierarchy is set to --lmctfy_release_agent, which
+  // must not be set to another agent already.
+  //
+  // Arguments:
+  //   callback: The permanent callback to use when the cgroup becomes empty.
+  //       Must not be a nullptr. Takes ownership.
+  // Return:
+  //   StatusOr: Status of the operation. Iff OK, the Handle of the registered
+  //       notification. FAILED_PRECONDITION if the release agent of the
+  //       hierarchy can't be used.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+  RegisterEmptyNotification(EventCallback *callback);
+
+  // Clears notify_on_release on this cgroup (if this controller owns it and it
+  // is not in the unified hierarchy). The kernel copies it from the parent on
+  // creation, and the release agent is run for every cgroup that has it set.
+  //
+  // Return:
+  //   Status: Status of the operation. Iff OK, the operation was successful.
+  virtual ::util::Status ClearReleaseNotification();
+
   // Gets the number of children allowed for this cgroup
   //
   // Return:
@@ -303,11 +408,34 @@ class CgroupController {
 
   bool owns_cgroup() const { return owns_cgroup_; }
 
+  // Whether the cgroup is in the cgroup v2 unified hierarchy.
+  bool unified() const { return unified_; }
+
   CgroupHierarchy type() const { return type_; }
 
   // Relative path to the container in this cgroup hierarchy.
   const string &hierarchy_path() const { return hierarchy_path_; }
 
+  // Sets the cache used for reads of frequently read cgroup files. A nullptr
+  // (the default) reads all files directly. Does not take ownership.
+  void set_file_cache(CgroupFileCache *file_cache) { file_cache_ = file_cache; }
+
+  // Sets the registry of optional cgroup files supported by the kernel. Files
+  // known to be missing fail with NOT_FOUND without touching the kernel. A
+  // nullptr (the default) accesses all files. Does not take ownership.
+  void set_kernel_features(KernelFeatures *kernel_features) {
+    kernel_features_ = kernel_features;
+  }
+
+  // Sets the index used for recursive listings of subcontainers. A nullptr
+  // (the default) walks the hierarchy on every listing. Does not take
+  // ownership.
+  void set_tree_index(CgroupTreeIndex *tree_index) { tree_index_ = tree_index; }
+
+  // Sets whether the cgroup is in the cgroup v2 unified hierarchy, whose
+  // interface files differ from those of the v1 hierarchies. False by default.
+  void set_unified(bool unified) { unified_ = unified; }
+
  protected:
   // Arguments:
   //   type: The type of hierarchy this controller affects.
@@ -329,6 +457,9 @@ class CgroupController {
   // e.g.:
   // SetParamInt("tasks", 42) will write 42 to: cgroup_path + "/tasks"
   //
+  // If a CgroupWriteBatch is open on the current thread, the write is added to
+  // it instead and only happens when the batch is committed.
+  //
   // Arguments:
   //   cgroup_file: The cgroup file to write to, e.g. "memory.limit_in_bytes"
   //   value: The value to write to the file.
@@ -345,6 +476,9 @@ class CgroupController {
   //
   // GetParamLines() gets an iterator to the lines of a file.
   //
+  // If a CgroupWriteBatch is open on the current thread, files it writes read
+  // as they will be once it is committed (except with GetParamLines()).
+  //
   // e.g.:
   // GetParamString("tasks") will read "42\n43\n" from: cgroup_path + "/tasks"
   //
@@ -361,6 +495,36 @@ class CgroupController {
   virtual ::util::StatusOr< ::util::FileLines> GetParamLines(
       const string &cgroup_file) const;
 
+  // Reads a flat keyed file of the unified hierarchy (e.g.: cpu.stat,
+  // cgroup.events) where each line is a space-separated key and integer value.
+  //
+  // Arguments:
+  //   cgroup_file: The cgroup file to read from, e.g. "cpu.stat"
+  // Return:
+  //   StatusOr: Status of the operation. Iff OK, the map of key to value.
+  //       INTERNAL if a line could not be parsed.
+  virtual ::util::StatusOr< ::std::map<string, int64>> GetParamKeyed(
+      const string &cgroup_file) const;
+
+  // Writes and reads limits of the unified hierarchy (e.g.: memory.max), where
+  // "max" is written and read for no limit. No limit is represented by -1 when
+  // writing and by kint64max when reading, like in the v1 hierarchies.
+  virtual ::util::Status SetParamLimit(const string &cgroup_file, int64 value);
+  virtual ::util::StatusOr<int64> GetParamLimit(
+      const string &cgroup_file) const;
+
+  // Reads a pressure stall information file of the unified hierarchy (e.g.:
+  // memory.pressure). The "full" line is optional since older kernels don't
+  // provide it for CPU pressure.
+  //
+  // Arguments:
+  //   cgroup_file: The cgroup file to read from, e.g. "cpu.pressure"
+  // Return:
+  //   StatusOr: Status of the operation. Iff OK, the pressure read from the
+  //       file. INTERNAL if a line could not be parsed.
+  virtual ::util::StatusOr<PressureData> GetParamPressure(
+      const string &cgroup_file) const;
+
   // Gets the subdirectories of this controller. This function adds the
   // directories to the end of the provided vector.
   //
@@ -395,6 +559,24 @@ class CgroupController {
       const string &cgroup_file, const string &arguments,
       EventCallback *callback);
 
+  // Registers a trigger on the specified pressure stall information file. The
+  // resource of the threshold is not checked, it is given by cgroup_file.
+  //
+  // Arguments:
+  //   cgroup_file: The pressure file to register the trigger on, e.g.
+  //       "memory.pressure"
+  //   threshold: The stall threshold and time window of the trigger.
+  //   callback: The permanent callback to use when the event is triggered. Must
+  //       not be a nullptr. Takes ownership.
+  // Return:
+  //   Status: Status of the operation. Iff OK, the registration was successful.
+  //       FAILED_PRECONDITION if the cgroup is not in the unified hierarchy.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+  RegisterPressureNotification(
+      const string &cgroup_file,
+      const EventSpec::PressureThreshold &threshold,
+      EventCallback *callback);
+
   // Helper function to write a string to a file.
   //
   // Arguments:
@@ -419,6 +601,16 @@ class CgroupController {
   virtual ::util::StatusOr<string> ReadStringFromFile(
       const string &file_path) const;
 
+  // Returns NOT_FOUND if the specified cgroup_file is known not to be supported
+  // by the kernel, OK otherwise.
+  ::util::Status CheckSupported(const string &cgroup_file) const;
+
+  // Records whether the optional cgroup_file is supported given the status of
+  // its first read. Only a missing file in an existing cgroup is recorded as
+  // not supported.
+  void DetectSupport(const string &cgroup_file,
+                     const ::util::Status &read_status) const;
+
   // Returns the absolute path to the specified cgroup_file.
   // ParentCgroupFilePath returns the same path but on the parent. The result of
   // ParentCgroupFilaPath on / or non-hierarchical resource hierarchies is
@@ -434,6 +626,12 @@ class CgroupController {
   //       "/dev/cgroup/memory/test/memory.limit_in_bytes"
   string CgroupFilePath(const string &cgroup_file) const;
 
+  // Returns the file that lists the threads of the cgroup.
+  const char *ThreadsFile() const;
+
+  // Returns whether tid is the leader of its thread group, i.e.: a process.
+  ::util::StatusOr<bool> IsThreadGroupLeader(pid_t tid) const;
+
   // Parses a PID on each line of the specified file and returns them.
   //
   // Arguments:
@@ -445,6 +643,26 @@ class CgroupController {
   ::util::StatusOr< ::std::vector<pid_t>> GetPids(
       const string &cgroup_file) const;
 
+  // Parses a PID on each line of the specified file and calls visitor with
+  // each. The file is read in fixed-size chunks and parsed in place.
+  //
+  // Arguments:
+  //   cgroup_file: The cgroup file to read PIDs from, e.g. "tasks"
+  //   visitor: Called with each PID read.
+  // Return:
+  //   Status: Status of the operation. NOT_FOUND if the file does not exist.
+  ::util::Status VisitPids(const string &cgroup_file,
+                           const PidVisitor &visitor) const;
+
+  // Same as VisitPids(), for the file at the absolute file_path.
+  ::util::Status VisitPidsAtPath(const string &file_path,
+                                 const PidVisitor &visitor) const;
+
+  // Calls VisitPids() on this cgroup and on the cgroup_file of all of its
+  // descendants, skipping the ones that no longer exist.
+  ::util::Status VisitPidsRecursive(const string &cgroup_file,
+                                    const PidVisitor &visitor) const;
+
   // The cgroup hierarchy type controlled by this controller.
   const CgroupHierarchy type_;
 
@@ -470,6 +688,18 @@ class CgroupController {
   // EventFd-based notifications.
   EventFdNotifications *eventfd_notifications_;
 
+  // Cache of open cgroup files, nullptr if reads are not cached.
+  CgroupFileCache *file_cache_;
+
+  // Optional cgroup files supported by the kernel, nullptr if unknown.
+  KernelFeatures *kernel_features_;
+
+  // Index of cgroup directories, nullptr if the hierarchy is walked instead.
+  CgroupTreeIndex *tree_index_;
+
+  // Whether the cgroup is in the cgroup v2 unified hierarchy.
+  bool unified_;
+
   friend class CgroupControllerTest;
   friend class GetParamLinesTest;
   friend class CgroupControllerRealTest;
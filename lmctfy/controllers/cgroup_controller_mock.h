@@ -40,8 +40,23 @@ class MockCgroupController : public CgroupController {
   MOCK_METHOD1(SetChildrenLimit, ::util::Status(int64 limit));
   MOCK_CONST_METHOD0(GetThreads, ::util::StatusOr< ::std::vector<pid_t>>());
   MOCK_CONST_METHOD0(GetProcesses, ::util::StatusOr< ::std::vector<pid_t>>());
+  MOCK_CONST_METHOD1(VisitThreads,
+                     ::util::Status(const PidVisitor &visitor));
+  MOCK_CONST_METHOD1(VisitProcesses,
+                     ::util::Status(const PidVisitor &visitor));
+  MOCK_CONST_METHOD1(VisitThreadsRecursive,
+                     ::util::Status(const PidVisitor &visitor));
+  MOCK_CONST_METHOD1(VisitProcessesRecursive,
+                     ::util::Status(const PidVisitor &visitor));
   MOCK_CONST_METHOD0(GetSubcontainers,
                      ::util::StatusOr< ::std::vector<string>>());
+  MOCK_CONST_METHOD0(GetSubcontainersRecursive,
+                     ::util::StatusOr< ::std::vector<string>>());
+  MOCK_CONST_METHOD0(IsPopulated, ::util::StatusOr<bool>());
+  MOCK_METHOD1(RegisterEmptyNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   EventCallback *callback));
+  MOCK_METHOD0(ClearReleaseNotification, ::util::Status());
   MOCK_CONST_METHOD0(GetChildrenLimit, ::util::StatusOr<int64>());
   MOCK_METHOD0(EnableCloneChildren, ::util::Status());
   MOCK_METHOD0(DisableCloneChildren, ::util::Status());
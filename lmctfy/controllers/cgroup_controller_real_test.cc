@@ -14,10 +14,15 @@
 
 #include "lmctfy/controllers/cgroup_controller.h"
 
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <memory>
 #include <vector>
 
 #include "gflags/gflags.h"
+#include "base/timer.h"
+#include "global_utils/fs_utils.h"
 #include "system_api/kernel_api.h"
 #include "file/base/path.h"
 #include "lmctfy/controllers/cgroup_factory_mock.h"
@@ -38,6 +43,7 @@ using ::strings::Substitute;
 using ::testing::Contains;
 using ::testing::Return;
 using ::testing::StrictMock;
+using ::util::GlobalFsUtils;
 using ::testing::_;
 using ::util::Status;
 using ::util::StatusOr;
@@ -154,6 +160,41 @@ TEST_F(CgroupControllerRealTest, GetSubdirectories_Fails) {
 }
 
 
+TEST_F(CgroupControllerRealTest, GetSubcontainersRecursive) {
+  MakeDirectory(JoinPath(test_dir_, "sub2"));
+  MakeDirectory(JoinPath(test_dir_, "sub1"));
+  MakeDirectory(JoinPath(test_dir_, "sub1", "subsub"));
+  MakeFile(JoinPath(test_dir_, "sub1", "tasks"));
+
+  StatusOr<vector<string>> statusor = controller_->GetSubcontainersRecursive();
+  ASSERT_OK(statusor);
+  EXPECT_EQ((vector<string>{"sub1", "sub1/subsub", "sub2"}),
+            statusor.ValueOrDie());
+
+  RemoveFile(JoinPath(test_dir_, "sub1", "tasks"));
+  RemoveDirectory(JoinPath(test_dir_, "sub1", "subsub"));
+  RemoveDirectory(JoinPath(test_dir_, "sub1"));
+  RemoveDirectory(JoinPath(test_dir_, "sub2"));
+}
+
+TEST_F(CgroupControllerRealTest, GetSubcontainersRecursiveFromTreeIndex) {
+  CgroupTreeIndex tree_index(kernel_.get());
+  controller_->set_tree_index(&tree_index);
+  MakeDirectory(JoinPath(test_dir_, "sub1"));
+  MakeDirectory(JoinPath(test_dir_, "sub1", "subsub"));
+
+  StatusOr<vector<string>> statusor = controller_->GetSubcontainersRecursive();
+  ASSERT_OK(statusor);
+  EXPECT_EQ((vector<string>{"sub1", "sub1/subsub"}), statusor.ValueOrDie());
+
+  RemoveDirectory(JoinPath(test_dir_, "sub1", "subsub"));
+  statusor = controller_->GetSubcontainersRecursive();
+  ASSERT_OK(statusor);
+  EXPECT_EQ((vector<string>{"sub1"}), statusor.ValueOrDie());
+
+  RemoveDirectory(JoinPath(test_dir_, "sub1"));
+}
+
 typedef CgroupControllerRealTest DeleteCgroupHierarchyTest;
 
 const char *kDirs[] = { "d1", "d2", "d3", "d4", "d5" };
@@ -230,6 +271,82 @@ TEST_F(DeleteCgroupHierarchyTest, LargeTest) {
   EXPECT_OK(CallDeleteCgroupHierarchy(new_base));
 }
 
+// Microbenchmark of listing a synthetic tree of 10100 cgroup directories, 100
+// with 100 subdirectories each and a few cgroup files in every one. Run with
+// --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*.
+
+static const int kBenchmarkFanout = 100;
+static const int kBenchmarkIterations = 20;
+static const char *kBenchmarkFiles[] = {"tasks", "cgroup.procs", "notify"};
+
+// Lists the directories under path the way GetSubdirectories() used to: with
+// readdir_r() and an lstat() of the absolute path of every entry.
+static void ReadDirAndStatWalk(const string &path, vector<string> *entries) {
+  DIR *dir = opendir(path.c_str());
+  CHECK(dir != nullptr);
+  struct dirent readdir_buf, *de = nullptr;
+  while (readdir_r(dir, &readdir_buf, &de) == 0 && de != nullptr) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+      continue;
+    }
+    const string full_path = JoinPath(path, de->d_name);
+    struct stat statbuf;
+    if (lstat(full_path.c_str(), &statbuf) == 0 && S_ISDIR(statbuf.st_mode)) {
+      entries->emplace_back(full_path);
+      ReadDirAndStatWalk(full_path, entries);
+    }
+  }
+  closedir(dir);
+}
+
+TEST_F(CgroupControllerRealTest, DISABLED_BenchmarkListTenThousandDirectories) {
+  const string base = JoinPath(test_dir_, "base");
+  MakeDirectory(base);
+  for (int i = 0; i < kBenchmarkFanout; ++i) {
+    const string dir = JoinPath(base, Substitute("d$0", i));
+    MakeDirectory(dir);
+    for (int j = 0; j < kBenchmarkFanout; ++j) {
+      MakeDirectory(JoinPath(dir, Substitute("d$0", j)));
+    }
+    for (const char *file : kBenchmarkFiles) {
+      MakeFile(JoinPath(dir, file));
+    }
+  }
+  const int kExpectedDirectories = kBenchmarkFanout * (kBenchmarkFanout + 1);
+
+  CycleTimer timer;
+  timer.Start();
+  for (int i = 0; i < kBenchmarkIterations; ++i) {
+    vector<string> entries;
+    ReadDirAndStatWalk(base, &entries);
+    EXPECT_EQ(kExpectedDirectories, entries.size());
+  }
+  timer.Stop();
+  const int64 readdir_usec = timer.GetInUsec() / kBenchmarkIterations;
+
+  timer.Reset();
+  timer.Start();
+  for (int i = 0; i < kBenchmarkIterations; ++i) {
+    int directories = 0;
+    ASSERT_OK(GlobalFsUtils()->WalkDirectoryTree(
+        base, [&directories](const string &relative_path) { ++directories; }));
+    EXPECT_EQ(kExpectedDirectories, directories);
+  }
+  timer.Stop();
+  const int64 walk_usec = timer.GetInUsec() / kBenchmarkIterations;
+
+  printf("readdir_r + lstat: %lld us/walk\n"
+         "WalkDirectoryTree: %lld us/walk\n",
+         static_cast<long long>(readdir_usec),  // NOLINT(runtime/int)
+         static_cast<long long>(walk_usec));  // NOLINT(runtime/int)
+
+  for (int i = 0; i < kBenchmarkFanout; ++i) {
+    for (const char *file : kBenchmarkFiles) {
+      RemoveFile(JoinPath(base, Substitute("d$0", i), file));
+    }
+  }
+  EXPECT_OK(CallDeleteCgroupHierarchy(base));
+}
 
 }  // namespace lmctfy
 }  // namespace containers
@@ -14,9 +14,12 @@
 
 #include "lmctfy/controllers/cgroup_controller.h"
 
-#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -24,14 +27,16 @@
 #include "system_api/kernel_api_mock.h"
 #include "file/base/path.h"
 #include "lmctfy/controllers/cgroup_factory_mock.h"
+#include "lmctfy/controllers/cgroup_tree_index_mock.h"
+#include "lmctfy/controllers/cgroup_write_batch.h"
 #include "lmctfy/controllers/eventfd_notifications_mock.h"
 #include "lmctfy/kernel_files.h"
+#include "strings/substitute.h"
 #include "global_utils/fs_utils_test_util.h"
 #include "util/safe_types/unix_gid.h"
 #include "util/safe_types/unix_uid.h"
 #include "util/errors_test_util.h"
 #include "util/file_lines_test_util.h"
-#include "system_api/libc_fs_api_test_util.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "util/task/codes.pb.h"
@@ -42,21 +47,26 @@ using ::file::JoinPath;
 using ::util::FileLines;
 using ::util::FileLinesTestUtil;
 using ::util::MockFsUtilsOverride;
-using ::system_api::MockLibcFsApiOverride;
 using ::util::UnixGid;
 using ::util::UnixGidValue;
 using ::util::UnixUid;
 using ::util::UnixUidValue;
+using ::std::map;
+using ::std::min;
+using ::std::shared_ptr;
 using ::std::unique_ptr;
 using ::std::vector;
+using ::strings::Substitute;
 using ::testing::ContainerEq;
 using ::testing::Contains;
 using ::testing::DoAll;
 #include "util/testing/equals_initialized_proto.h"
 using ::testing::EqualsInitializedProto;
+using ::testing::Invoke;
 using ::testing::NotNull;
 using ::testing::Return;
 using ::testing::SetArgPointee;
+using ::testing::SetErrnoAndReturn;
 using ::testing::StrEq;
 using ::testing::StrictMock;
 using ::testing::_;
@@ -100,6 +110,9 @@ static const char kCgroupTasksPath[] = "/dev/cgroup/memory/test/tasks";
 static const char kCgroupClonePath[] =
     "/dev/cgroup/memory/test/cgroup.clone_children";
 static const char kCgroupProcsPath[] = "/dev/cgroup/memory/test/cgroup.procs";
+static const char kCgroupThreadsPath[] =
+    "/dev/cgroup/memory/test/cgroup.threads";
+static const char kCgroupTypePath[] = "/dev/cgroup/memory/test/cgroup.type";
 static const char kMemoryLimit[] = "memory.limit_in_bytes";
 static const char kCgroupMemoryLimitPath[] =
     "/dev/cgroup/memory/test/memory.limit_in_bytes";
@@ -286,6 +299,50 @@ class CgroupControllerTest : public ::testing::Test {
                                 kernel, eventfd_notifications);
   }
 
+  // Expect the PID file at path to be opened, read in chunks of at most
+  // chunk_size bytes returning contents, and closed. Each file gets its own
+  // file descriptor.
+  void ExpectReadPidFile(const string &path, const string &contents,
+                         size_t chunk_size) {
+    static int next_fd = 42;
+    const int kFd = next_fd++;
+    EXPECT_CALL(*mock_kernel_, Open(StrEq(path), O_RDONLY | O_CLOEXEC))
+        .WillOnce(Return(kFd));
+    shared_ptr<size_t> offset(new size_t(0));
+    EXPECT_CALL(*mock_kernel_, Read(kFd, NotNull(), _))
+        .WillRepeatedly(Invoke([contents, chunk_size, offset](
+            int fd, void *buf, int count) -> ssize_t {
+          const size_t bytes = min(min(static_cast<size_t>(count), chunk_size),
+                                   contents.size() - *offset);
+          memcpy(buf, contents.data() + *offset, bytes);
+          *offset += bytes;
+          return bytes;
+        }));
+    EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+  }
+
+  void ExpectReadPidFile(const string &path, const string &contents) {
+    ExpectReadPidFile(path, contents, contents.size());
+  }
+
+  // Expect /proc/<tid>/status to be read and to report tgid.
+  void ExpectProcStatus(pid_t tid, pid_t tgid) {
+    const string path = Substitute("/proc/$0/status", tid);
+    EXPECT_CALL(*mock_kernel_, Access(path, F_OK)).WillOnce(Return(0));
+    EXPECT_CALL(*mock_kernel_, ReadFileToString(path, NotNull()))
+        .WillOnce(DoAll(
+            SetArgPointee<1>(Substitute("Name:\tbash\nTgid:\t$0\n", tgid)),
+            Return(true)));
+  }
+
+  // Expect the cgroup.type of the cgroup to be read and to be type.
+  void ExpectCgroupType(const string &type) {
+    EXPECT_CALL(*mock_kernel_, Access(kCgroupTypePath, F_OK))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupTypePath, NotNull()))
+        .WillOnce(DoAll(SetArgPointee<1>(type), Return(true)));
+  }
+
   // Wrappers for protected methods.
 
   Status CallSetParamBool(const string &hierarchy_file, int64 value) {
@@ -316,35 +373,83 @@ class CgroupControllerTest : public ::testing::Test {
     return controller_->GetParamLines(hierarchy_file);
   }
 
+  StatusOr<map<string, int64>> CallGetParamKeyed(
+      const string &hierarchy_file) const {
+    return controller_->GetParamKeyed(hierarchy_file);
+  }
+
+  Status CallSetParamLimit(const string &hierarchy_file, int64 value) {
+    return controller_->SetParamLimit(hierarchy_file, value);
+  }
+
+  StatusOr<int64> CallGetParamLimit(const string &hierarchy_file) const {
+    return controller_->GetParamLimit(hierarchy_file);
+  }
+
+  StatusOr<PressureData> CallGetParamPressure(
+      const string &hierarchy_file) const {
+    return controller_->GetParamPressure(hierarchy_file);
+  }
+
   StatusOr<ActiveNotifications::Handle> CallRegisterNotification(
       const string &cgroup_file, const string &arguments,
       CgroupController::EventCallback *callback) {
     return controller_->RegisterNotification(cgroup_file, arguments, callback);
   }
 
+  StatusOr<ActiveNotifications::Handle> CallRegisterPressureNotification(
+      const string &cgroup_file, const EventSpec::PressureThreshold &threshold,
+      CgroupController::EventCallback *callback) {
+    return controller_->RegisterPressureNotification(cgroup_file, threshold,
+                                                     callback);
+  }
+
  protected:
   FileLinesTestUtil mock_file_lines_;
   unique_ptr<MockEventFdNotifications> mock_eventfd_notifications_;
   unique_ptr<KernelAPIMock> mock_kernel_;
   unique_ptr<CgroupController> controller_;
   MockFsUtilsOverride mock_fs_utils_;
-  MockLibcFsApiOverride mock_libc_fs_api_;
 };
 
 TEST_F(CgroupControllerTest, DestroySuccess) {
-  // Need a DIR * just for mocking, this is not actually used.
-  DIR *dir = reinterpret_cast<DIR *>(3);
-  EXPECT_CALL(mock_libc_fs_api_.Mock(), OpenDir(StrEq(kCgroupPath)))
-      .WillOnce(Return(dir));
-  EXPECT_CALL(mock_libc_fs_api_.Mock(), ReadDirR(dir, _, _))
-      .WillOnce(Return(0));
-  EXPECT_CALL(mock_libc_fs_api_.Mock(), CloseDir(dir));
+  EXPECT_CALL(mock_fs_utils_.Mock(), WalkDirectoryTree(kCgroupPath, _))
+      .WillOnce(Return(Status::OK));
 
   EXPECT_CALL(*mock_kernel_, RmDir(kCgroupPath)).WillRepeatedly(Return(0));
 
   EXPECT_TRUE(controller_.release()->Destroy().ok());
 }
 
+// Calls visitor with a directory and its subdirectory.
+static Status VisitSubdirectories(
+    const string &dirpath, const ::util::FsUtils::DirectoryVisitor &visitor) {
+  visitor("sub");
+  visitor("sub/subsub");
+  return Status::OK;
+}
+
+TEST_F(CgroupControllerTest, DestroyDeletesSubdirectoriesFirst) {
+  EXPECT_CALL(mock_fs_utils_.Mock(), WalkDirectoryTree(kCgroupPath, _))
+      .WillOnce(Invoke(&VisitSubdirectories));
+
+  ::testing::InSequence s;
+  EXPECT_CALL(*mock_kernel_, RmDir(JoinPath(kCgroupPath, "sub/subsub")))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, RmDir(JoinPath(kCgroupPath, "sub")))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, RmDir(kCgroupPath)).WillOnce(Return(0));
+
+  EXPECT_OK(controller_.release()->Destroy());
+}
+
+TEST_F(CgroupControllerTest, DestroyWalkFails) {
+  EXPECT_CALL(mock_fs_utils_.Mock(), WalkDirectoryTree(kCgroupPath, _))
+      .WillOnce(Return(Status(::util::error::INTERNAL, "")));
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION, controller_->Destroy());
+}
+
 TEST_F(CgroupControllerTest, DestroySuccessDoesNotOwnCgroup) {
   unique_ptr<CgroupController> controller(
       NewCgroupController(kType, kHierarchyPath, kCgroupPath, false,
@@ -356,14 +461,8 @@ TEST_F(CgroupControllerTest, DestroySuccessDoesNotOwnCgroup) {
 }
 
 TEST_F(CgroupControllerTest, DestroyRmDirFails) {
-  // Need a DIR * just for mocking, this is not actually used.
-  DIR *dir = reinterpret_cast<DIR *>(3);
-  EXPECT_CALL(mock_libc_fs_api_.Mock(), OpenDir(StrEq(kCgroupPath)))
-      .WillOnce(Return(dir));
-  EXPECT_CALL(mock_libc_fs_api_.Mock(), ReadDirR(dir, _, _))
-      .WillOnce(DoAll(SetArgPointee<2>(nullptr), Return(0)));
-  EXPECT_CALL(mock_libc_fs_api_.Mock(), CloseDir(dir))
-      .WillOnce(Return(0));
+  EXPECT_CALL(mock_fs_utils_.Mock(), WalkDirectoryTree(kCgroupPath, _))
+      .WillOnce(Return(Status::OK));
 
   EXPECT_CALL(*mock_kernel_, RmDir(kCgroupPath)).WillRepeatedly(Return(-1));
 
@@ -407,6 +506,63 @@ TEST_F(CgroupControllerTest, EnterWriteError) {
   EXPECT_EQ(::util::error::UNAVAILABLE, status.error_code());
 }
 
+TEST_F(CgroupControllerTest, EnterUnifiedWritesProcesses) {
+  controller_->set_unified(true);
+  ExpectProcStatus(42, 42);
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("42", kCgroupProcsPath, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+
+  EXPECT_OK(controller_->Enter(42));
+}
+
+TEST_F(CgroupControllerTest, EnterUnifiedThreadWritesThreads) {
+  controller_->set_unified(true);
+  ExpectProcStatus(43, 42);
+  ExpectCgroupType("threaded\n");
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("43", kCgroupThreadsPath, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+
+  EXPECT_OK(controller_->Enter(43));
+}
+
+TEST_F(CgroupControllerTest, EnterUnifiedCallingThreadWritesThreads) {
+  controller_->set_unified(true);
+  ExpectCgroupType("threaded\n");
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("0", kCgroupThreadsPath, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+
+  EXPECT_OK(controller_->Enter(0));
+}
+
+TEST_F(CgroupControllerTest, EnterUnifiedCallingThreadNotThreaded) {
+  controller_->set_unified(true);
+  ExpectCgroupType("domain\n");
+
+  EXPECT_ERROR_CODE(::util::error::UNIMPLEMENTED, controller_->Enter(0));
+}
+
+TEST_F(CgroupControllerTest, EnterUnifiedProcStatusFails) {
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access("/proc/42/status", F_OK))
+      .WillOnce(Return(-1));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, controller_->Enter(42));
+}
+
+TEST_F(CgroupControllerTest, EnterUnifiedNoTgid) {
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access("/proc/42/status", F_OK))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString("/proc/42/status", NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(string("Name:\tbash\n")),
+                      Return(true)));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, controller_->Enter(42));
+}
+
 // Tests for Delegate().
 
 TEST_F(CgroupControllerTest, DelegateSuccess) {
@@ -421,6 +577,22 @@ TEST_F(CgroupControllerTest, DelegateSuccess) {
   EXPECT_OK(controller_->Delegate(kUid, kGid));
 }
 
+TEST_F(CgroupControllerTest, DelegateUnified) {
+  const UnixUid kUid(2);
+  const UnixGid kGid(3);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Chown(kCgroupPath, kUid.value(), kGid.value()))
+      .WillOnce(Return(0));
+  for (const char *file : {"cgroup.procs", "cgroup.threads",
+                           "cgroup.subtree_control"}) {
+    EXPECT_CALL(*mock_kernel_, Chown(JoinPath(kCgroupPath, file), kUid.value(),
+                                     kGid.value())).WillOnce(Return(0));
+  }
+
+  EXPECT_OK(controller_->Delegate(kUid, kGid));
+}
+
 TEST_F(CgroupControllerTest, DelegateIgnoredWithUnownedCgroup) {
   ReSetUpWithUnownedResource();
   const UnixUid kUid(2);
@@ -476,11 +648,7 @@ TEST_F(CgroupControllerTest, PopulateMachineSpecSuccess) {
 
 TEST_F(CgroupControllerTest, GetThreadsSuccess) {
   const vector<pid_t> kPids = {1, 2, 3, 4};
-  const string kPidStrings = "1\n2\n3\n4\n";
-  EXPECT_CALL(*mock_kernel_, Access(kCgroupTasksPath, F_OK))
-      .WillRepeatedly(Return(0));
-  EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupTasksPath, NotNull()))
-      .WillRepeatedly(DoAll(SetArgPointee<1>(kPidStrings), Return(true)));
+  ExpectReadPidFile(kCgroupTasksPath, "1\n2\n3\n4\n");
 
   StatusOr<vector<pid_t>> statusor = controller_->GetThreads();
   ASSERT_TRUE(statusor.ok());
@@ -488,32 +656,68 @@ TEST_F(CgroupControllerTest, GetThreadsSuccess) {
 }
 
 TEST_F(CgroupControllerTest, GetThreadsEmpty) {
-  EXPECT_CALL(*mock_kernel_, Access(kCgroupTasksPath, F_OK))
-      .WillRepeatedly(Return(0));
-  EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupTasksPath, NotNull()))
-      .WillRepeatedly(DoAll(SetArgPointee<1>(""), Return(true)));
+  ExpectReadPidFile(kCgroupTasksPath, "");
 
   StatusOr<vector<pid_t>> statusor = controller_->GetThreads();
   ASSERT_TRUE(statusor.ok());
   EXPECT_TRUE(statusor.ValueOrDie().empty());
 }
 
+TEST_F(CgroupControllerTest, GetThreadsPidsSpanReads) {
+  const vector<pid_t> kPids = {1234, 56789, 1};
+
+  // The last PID is not newline-terminated.
+  ExpectReadPidFile(kCgroupTasksPath, "1234\n56789\n1", 3);
+
+  StatusOr<vector<pid_t>> statusor = controller_->GetThreads();
+  ASSERT_OK(statusor);
+  EXPECT_THAT(statusor.ValueOrDie(), ContainerEq(kPids));
+}
+
+TEST_F(CgroupControllerTest, GetThreadsFileNotFound) {
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kCgroupTasksPath), _))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, controller_->GetThreads());
+}
+
+TEST_F(CgroupControllerTest, GetThreadsOpenFails) {
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kCgroupTasksPath), _))
+      .WillOnce(SetErrnoAndReturn(EACCES, -1));
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->GetThreads());
+}
+
 TEST_F(CgroupControllerTest, GetThreadsFails) {
-  EXPECT_CALL(*mock_kernel_, Access(kCgroupTasksPath, F_OK))
-      .WillRepeatedly(Return(0));
-  EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupTasksPath, NotNull()))
-      .WillRepeatedly(Return(false));
+  static const int kFd = 42;
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kCgroupTasksPath), _))
+      .WillOnce(Return(kFd));
+  EXPECT_CALL(*mock_kernel_, Read(kFd, NotNull(), _))
+      .WillOnce(SetErrnoAndReturn(EIO, -1));
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->GetThreads());
+}
+
+TEST_F(CgroupControllerTest, GetThreadsBadPid) {
+  ExpectReadPidFile(kCgroupTasksPath, "1\nabc\n3\n");
 
-  EXPECT_FALSE(controller_->GetThreads().ok());
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->GetThreads());
+}
+
+TEST_F(CgroupControllerTest, GetThreadsPidOutOfRange) {
+  ExpectReadPidFile(kCgroupTasksPath, "1\n99999999999\n");
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->GetThreads());
 }
 
 TEST_F(CgroupControllerTest, GetProcessesSuccess) {
   const vector<pid_t> kPids = {1, 2, 3, 4};
-  const string kPidStrings = "1\n2\n3\n4\n";
-  EXPECT_CALL(*mock_kernel_, Access(kCgroupProcsPath, F_OK))
-      .WillRepeatedly(Return(0));
-  EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupProcsPath, NotNull()))
-      .WillRepeatedly(DoAll(SetArgPointee<1>(kPidStrings), Return(true)));
+  ExpectReadPidFile(kCgroupProcsPath, "1\n2\n3\n4\n");
 
   StatusOr<vector<pid_t>> statusor = controller_->GetProcesses();
   ASSERT_TRUE(statusor.ok());
@@ -521,10 +725,7 @@ TEST_F(CgroupControllerTest, GetProcessesSuccess) {
 }
 
 TEST_F(CgroupControllerTest, GetProcessesEmpty) {
-  EXPECT_CALL(*mock_kernel_, Access(kCgroupProcsPath, F_OK))
-      .WillRepeatedly(Return(0));
-  EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupProcsPath, NotNull()))
-      .WillRepeatedly(DoAll(SetArgPointee<1>(""), Return(true)));
+  ExpectReadPidFile(kCgroupProcsPath, "");
 
   StatusOr<vector<pid_t>> statusor = controller_->GetProcesses();
   ASSERT_TRUE(statusor.ok());
@@ -532,14 +733,120 @@ TEST_F(CgroupControllerTest, GetProcessesEmpty) {
 }
 
 TEST_F(CgroupControllerTest, GetProcessesFails) {
-  EXPECT_CALL(*mock_kernel_, Access(kCgroupProcsPath, F_OK))
-      .WillRepeatedly(Return(0));
-  EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupProcsPath, NotNull()))
-      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kCgroupProcsPath), _))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
 
   EXPECT_FALSE(controller_->GetProcesses().ok());
 }
 
+// Tests for VisitThreads() and VisitProcesses().
+
+TEST_F(CgroupControllerTest, VisitThreadsSuccess) {
+  ExpectReadPidFile(kCgroupTasksPath, "1\n2\n3\n", 2);
+
+  vector<pid_t> tids;
+  ASSERT_OK(controller_->VisitThreads(
+      [&tids](pid_t tid) { tids.push_back(tid); }));
+  EXPECT_THAT(tids, ContainerEq(vector<pid_t>{1, 2, 3}));
+}
+
+TEST_F(CgroupControllerTest, VisitThreadsStopsOnBadPid) {
+  ExpectReadPidFile(kCgroupTasksPath, "1\n2\n-3\n4\n");
+
+  // PIDs before the bad one are visited.
+  vector<pid_t> tids;
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->VisitThreads(
+                        [&tids](pid_t tid) { tids.push_back(tid); }));
+  EXPECT_THAT(tids, ContainerEq(vector<pid_t>{1, 2}));
+}
+
+TEST_F(CgroupControllerTest, VisitProcessesSuccess) {
+  ExpectReadPidFile(kCgroupProcsPath, "10\n20\n");
+
+  vector<pid_t> pids;
+  ASSERT_OK(controller_->VisitProcesses(
+      [&pids](pid_t pid) { pids.push_back(pid); }));
+  EXPECT_THAT(pids, ContainerEq(vector<pid_t>{10, 20}));
+}
+
+// Tests for GetSubcontainersRecursive(), VisitThreadsRecursive() and
+// VisitProcessesRecursive().
+
+TEST_F(CgroupControllerTest, GetSubcontainersRecursiveFromTreeIndex) {
+  StrictMockCgroupTreeIndex mock_tree_index;
+  controller_->set_tree_index(&mock_tree_index);
+  EXPECT_CALL(mock_tree_index, ListDescendants(kCgroupPath))
+      .WillOnce(Return(vector<string>{"sub1", "sub1/sub2"}));
+
+  StatusOr<vector<string>> statusor = controller_->GetSubcontainersRecursive();
+  ASSERT_OK(statusor);
+  EXPECT_THAT(statusor.ValueOrDie(),
+              ContainerEq(vector<string>{"sub1", "sub1/sub2"}));
+}
+
+TEST_F(CgroupControllerTest, GetSubcontainersRecursiveFromTreeIndexFails) {
+  StrictMockCgroupTreeIndex mock_tree_index;
+  controller_->set_tree_index(&mock_tree_index);
+  EXPECT_CALL(mock_tree_index, ListDescendants(kCgroupPath))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED,
+            controller_->GetSubcontainersRecursive().status());
+}
+
+TEST_F(CgroupControllerTest, VisitThreadsRecursiveSuccess) {
+  StrictMockCgroupTreeIndex mock_tree_index;
+  controller_->set_tree_index(&mock_tree_index);
+  EXPECT_CALL(mock_tree_index, ListDescendants(kCgroupPath))
+      .WillOnce(Return(vector<string>{"sub1", "sub1/sub2"}));
+  ExpectReadPidFile(kCgroupTasksPath, "1\n2\n");
+  ExpectReadPidFile(JoinPath(kCgroupPath, "sub1/sub2/tasks"), "3\n");
+
+  // sub1 was removed after it was listed.
+  EXPECT_CALL(*mock_kernel_,
+              Open(StrEq(JoinPath(kCgroupPath, "sub1/tasks")), _))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
+
+  vector<pid_t> tids;
+  ASSERT_OK(controller_->VisitThreadsRecursive(
+      [&tids](pid_t tid) { tids.push_back(tid); }));
+  EXPECT_THAT(tids, ContainerEq(vector<pid_t>{1, 2, 3}));
+}
+
+TEST_F(CgroupControllerTest, VisitThreadsRecursiveSelfNotFound) {
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kCgroupTasksPath), _))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
+
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    controller_->VisitThreadsRecursive([](pid_t tid) {}));
+}
+
+TEST_F(CgroupControllerTest, VisitThreadsRecursiveListFails) {
+  StrictMockCgroupTreeIndex mock_tree_index;
+  controller_->set_tree_index(&mock_tree_index);
+  EXPECT_CALL(mock_tree_index, ListDescendants(kCgroupPath))
+      .WillOnce(Return(Status::CANCELLED));
+  ExpectReadPidFile(kCgroupTasksPath, "1\n");
+
+  EXPECT_EQ(Status::CANCELLED,
+            controller_->VisitThreadsRecursive([](pid_t tid) {}));
+}
+
+TEST_F(CgroupControllerTest, VisitProcessesRecursiveSuccess) {
+  StrictMockCgroupTreeIndex mock_tree_index;
+  controller_->set_tree_index(&mock_tree_index);
+  EXPECT_CALL(mock_tree_index, ListDescendants(kCgroupPath))
+      .WillOnce(Return(vector<string>{"sub1"}));
+  ExpectReadPidFile(kCgroupProcsPath, "10\n");
+  ExpectReadPidFile(JoinPath(kCgroupPath, "sub1/cgroup.procs"), "20\n");
+
+  vector<pid_t> pids;
+  ASSERT_OK(controller_->VisitProcessesRecursive(
+      [&pids](pid_t pid) { pids.push_back(pid); }));
+  EXPECT_THAT(pids, ContainerEq(vector<pid_t>{10, 20}));
+}
+
 TEST_F(CgroupControllerTest, SetParamStringSuccess) {
   EXPECT_CALL(*mock_kernel_,
               SafeWriteResFile("42", kCgroupTasksPath, NotNull(), NotNull()))
@@ -568,6 +875,81 @@ TEST_F(CgroupControllerTest, SetParamStringWriteError) {
   EXPECT_EQ(::util::error::UNAVAILABLE, status.error_code());
 }
 
+TEST_F(CgroupControllerTest, SetParamStringInWriteBatch) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  // The write is only added to the batch.
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kCgroupTasksPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(string("1\n")), Return(true)));
+  EXPECT_OK(CallSetParamString("tasks", "42"));
+  EXPECT_EQ(1, batch.num_writes());
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFileWithoutTimer(
+                                 "42", kCgroupTasksPath, NotNull(), NotNull()))
+      .WillOnce(Return(2));
+  EXPECT_OK(batch.Commit());
+}
+
+TEST_F(CgroupControllerTest, SetParamStringInWriteBatchUsesFileCache) {
+  const int kFd = 42;
+  CgroupFileCache file_cache(mock_kernel_.get(), 10);
+  controller_->set_file_cache(&file_cache);
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  // The current value is read from the cached file descriptor, the batch does
+  // not read the file itself.
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kCgroupMemoryLimitPath), _))
+      .WillOnce(Return(kFd));
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, NotNull(), _, 0))
+      .WillOnce(Invoke([](int fd, void *buf, size_t count, off_t offset) {
+        memcpy(buf, "1\n", 2);
+        return 2;
+      }));
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, NotNull(), _, 2)).WillOnce(Return(0));
+  EXPECT_OK(CallSetParamString(kMemoryLimit, "42"));
+  EXPECT_EQ(1, batch.num_writes());
+
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFileWithoutTimer("42", kCgroupMemoryLimitPath,
+                                           NotNull(), NotNull()))
+      .WillOnce(Return(2));
+  EXPECT_OK(batch.Commit());
+
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+  controller_->set_file_cache(nullptr);
+}
+
+TEST_F(CgroupControllerTest, GetParamStringInWriteBatchSeesPendingWrite) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(string("1\n")), Return(true)));
+  EXPECT_OK(CallSetParamString(kMemoryLimit, "42"));
+
+  // The file reads as it will be once the batch is committed.
+  StatusOr<string> statusor = CallGetParamString(kMemoryLimit);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("42", statusor.ValueOrDie());
+}
+
+TEST_F(CgroupControllerTest, GetParamStringInWriteBatchRecordsRead) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(string("1\n")), Return(true)));
+  ASSERT_OK(CallGetParamString(kMemoryLimit));
+
+  // Neither a second read nor a write of the value read reach the file.
+  ASSERT_OK(CallGetParamString(kMemoryLimit));
+  EXPECT_OK(CallSetParamString(kMemoryLimit, "1"));
+  EXPECT_EQ(0, batch.num_writes());
+  EXPECT_EQ(1, batch.num_skipped());
+}
+
 TEST_F(CgroupControllerTest, SetParamIntSuccess) {
   EXPECT_CALL(*mock_kernel_,
               SafeWriteResFile("42", kCgroupTasksPath, NotNull(), NotNull()))
@@ -662,6 +1044,128 @@ TEST_F(CgroupControllerTest, GetParamStringReadFails) {
   EXPECT_EQ(::util::error::FAILED_PRECONDITION, statusor.status().error_code());
 }
 
+TEST_F(CgroupControllerTest, GetParamStringUsesFileCache) {
+  const string kStatPath = JoinPath(kCgroupPath, "memory.stat");
+  const int kFd = 42;
+  CgroupFileCache file_cache(mock_kernel_.get(), 10);
+  controller_->set_file_cache(&file_cache);
+
+  // Cacheable files are opened once and read with pread().
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kStatPath), _)).WillOnce(Return(kFd));
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, NotNull(), _, 0))
+      .WillRepeatedly(Invoke([](int fd, void *buf, size_t count,
+                                off_t offset) {
+        memcpy(buf, "cache 1\n", 8);
+        return 8;
+      }));
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, NotNull(), _, 8))
+      .WillRepeatedly(Return(0));
+  for (int i = 0; i < 2; ++i) {
+    StatusOr<string> statusor = CallGetParamString("memory.stat");
+    ASSERT_OK(statusor);
+    EXPECT_EQ("cache 1\n", statusor.ValueOrDie());
+  }
+  EXPECT_EQ(1, file_cache.hits());
+
+  // Other files are read directly.
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("42"), Return(true)));
+  StatusOr<string> statusor = CallGetParamString(kMemoryLimit);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("42", statusor.ValueOrDie());
+
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+  controller_->set_file_cache(nullptr);
+}
+
+TEST_F(CgroupControllerTest, DestroyInvalidatesFileCache) {
+  const int kFd = 42;
+  CgroupFileCache file_cache(mock_kernel_.get(), 10);
+  controller_->set_file_cache(&file_cache);
+
+  EXPECT_CALL(*mock_kernel_, Open(_, _)).WillOnce(Return(kFd));
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, NotNull(), _, _))
+      .WillRepeatedly(Return(0));
+  ASSERT_OK(CallGetParamString("memory.stat"));
+  ASSERT_EQ(1, file_cache.Size());
+
+  EXPECT_CALL(mock_fs_utils_.Mock(), WalkDirectoryTree(kCgroupPath, _))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, RmDir(kCgroupPath)).WillRepeatedly(Return(0));
+
+  EXPECT_OK(controller_.release()->Destroy());
+  EXPECT_EQ(0, file_cache.Size());
+}
+
+TEST_F(CgroupControllerTest, KnownMissingFileIsNotAccessed) {
+  KernelFeatures kernel_features;
+  kernel_features.Record(kType, KernelFiles::Memory::kIdlePageStats, false);
+  controller_->set_kernel_features(&kernel_features);
+
+  // No kernel calls are expected.
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    CallGetParamString(KernelFiles::Memory::kIdlePageStats));
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    CallGetParamLines(KernelFiles::Memory::kIdlePageStats));
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    CallSetParamString(KernelFiles::Memory::kIdlePageStats,
+                                       "1"));
+}
+
+TEST_F(CgroupControllerTest, UndetectedFileIsRecordedSupported) {
+  const string kPath =
+      JoinPath(kCgroupPath, KernelFiles::Memory::kIdlePageStats);
+  KernelFeatures kernel_features;
+  controller_->set_kernel_features(&kernel_features);
+
+  EXPECT_CALL(*mock_kernel_, Access(kPath, F_OK)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("stale 0"), Return(true)));
+
+  EXPECT_OK(CallGetParamString(KernelFiles::Memory::kIdlePageStats));
+  EXPECT_FALSE(
+      kernel_features.IsUndetected(kType, KernelFiles::Memory::kIdlePageStats));
+  EXPECT_FALSE(
+      kernel_features.IsMissing(kType, KernelFiles::Memory::kIdlePageStats));
+}
+
+TEST_F(CgroupControllerTest, UndetectedFileIsRecordedMissing) {
+  const string kPath =
+      JoinPath(kCgroupPath, KernelFiles::Memory::kIdlePageStats);
+  KernelFeatures kernel_features;
+  controller_->set_kernel_features(&kernel_features);
+
+  // The file is only accessed the first time.
+  EXPECT_CALL(*mock_kernel_, Access(kPath, F_OK)).WillOnce(Return(-1));
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPath, F_OK)).WillOnce(Return(0));
+
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    CallGetParamString(KernelFiles::Memory::kIdlePageStats));
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    CallGetParamString(KernelFiles::Memory::kIdlePageStats));
+  EXPECT_TRUE(
+      kernel_features.IsMissing(kType, KernelFiles::Memory::kIdlePageStats));
+}
+
+TEST_F(CgroupControllerTest, UndetectedFileInMissingCgroupIsNotRecorded) {
+  const string kPath =
+      JoinPath(kCgroupPath, KernelFiles::Memory::kIdlePageStats);
+  KernelFeatures kernel_features;
+  controller_->set_kernel_features(&kernel_features);
+
+  EXPECT_CALL(*mock_kernel_, Access(kPath, F_OK)).WillOnce(Return(-1));
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPath, F_OK)).WillOnce(Return(-1));
+
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    CallGetParamString(KernelFiles::Memory::kIdlePageStats));
+  EXPECT_TRUE(
+      kernel_features.IsUndetected(kType, KernelFiles::Memory::kIdlePageStats));
+}
+
 TEST_F(CgroupControllerTest, GetParamBoolSuccess) {
   const string kContents = "1";
 
@@ -720,6 +1224,152 @@ TEST_F(CgroupControllerTest, GetParamBoolInvalidBoolValue) {
                     CallGetParamBool(kMemoryLimit).status());
 }
 
+TEST_F(CgroupControllerTest, GetParamKeyedSuccess) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("usage_usec 42\nnr_periods 7\n\n"),
+                      Return(true)));
+
+  StatusOr<map<string, int64>> statusor = CallGetParamKeyed(kMemoryLimit);
+  ASSERT_OK(statusor);
+  const map<string, int64> expected = {{"usage_usec", 42}, {"nr_periods", 7}};
+  EXPECT_EQ(expected, statusor.ValueOrDie());
+}
+
+TEST_F(CgroupControllerTest, GetParamKeyedBadLine) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("usage_usec 42\nnr_periods\n"),
+                      Return(true)));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, CallGetParamKeyed(kMemoryLimit));
+}
+
+TEST_F(CgroupControllerTest, GetParamPressureSuccess) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(
+          SetArgPointee<1>(
+              "some avg10=1.50 avg60=0.25 avg300=0.00 total=4200\n"
+              "full avg10=0.50 avg60=0.00 avg300=0.00 total=100\n"),
+          Return(true)));
+
+  StatusOr<PressureData> statusor = CallGetParamPressure(kMemoryLimit);
+  ASSERT_OK(statusor);
+  const PressureData &pressure = statusor.ValueOrDie();
+  EXPECT_DOUBLE_EQ(1.5, pressure.some().avg10());
+  EXPECT_DOUBLE_EQ(0.25, pressure.some().avg60());
+  EXPECT_DOUBLE_EQ(0.0, pressure.some().avg300());
+  EXPECT_EQ(4200, pressure.some().total());
+  EXPECT_DOUBLE_EQ(0.5, pressure.full().avg10());
+  EXPECT_EQ(100, pressure.full().total());
+}
+
+TEST_F(CgroupControllerTest, GetParamPressureNoFull) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(
+          SetArgPointee<1>("some avg10=0.00 avg60=0.00 avg300=0.00 total=7\n"),
+          Return(true)));
+
+  StatusOr<PressureData> statusor = CallGetParamPressure(kMemoryLimit);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(7, statusor.ValueOrDie().some().total());
+  EXPECT_FALSE(statusor.ValueOrDie().has_full());
+}
+
+TEST_F(CgroupControllerTest, GetParamPressureBadLine) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(
+          SetArgPointee<1>("most avg10=0.00 avg60=0.00 avg300=0.00 total=7\n"),
+          Return(true)));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    CallGetParamPressure(kMemoryLimit));
+}
+
+TEST_F(CgroupControllerTest, GetParamPressureBadValue) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(
+          SetArgPointee<1>("some avg10=0.00 avg60=0.00 avg300=0.00 total=x\n"),
+          Return(true)));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    CallGetParamPressure(kMemoryLimit));
+}
+
+TEST_F(CgroupControllerTest, SetParamLimitSuccess) {
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("42", kCgroupMemoryLimitPath,
+                                              NotNull(), NotNull()))
+      .WillOnce(Return(0));
+
+  EXPECT_OK(CallSetParamLimit(kMemoryLimit, 42));
+}
+
+TEST_F(CgroupControllerTest, SetParamLimitNoLimit) {
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("max", kCgroupMemoryLimitPath,
+                                              NotNull(), NotNull()))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+
+  EXPECT_OK(CallSetParamLimit(kMemoryLimit, -1));
+  EXPECT_OK(CallSetParamLimit(kMemoryLimit, kint64max));
+}
+
+TEST_F(CgroupControllerTest, GetParamLimitSuccess) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupMemoryLimitPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString(kCgroupMemoryLimitPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("42\n"), Return(true)))
+      .WillOnce(DoAll(SetArgPointee<1>("max\n"), Return(true)));
+
+  StatusOr<int64> statusor = CallGetParamLimit(kMemoryLimit);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(42, statusor.ValueOrDie());
+  statusor = CallGetParamLimit(kMemoryLimit);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(kint64max, statusor.ValueOrDie());
+}
+
+TEST_F(CgroupControllerTest, IsPopulatedSuccess) {
+  const string kEventsPath = JoinPath(kCgroupPath, "cgroup.events");
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kEventsPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kEventsPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("populated 1\nfrozen 0\n"),
+                      Return(true)))
+      .WillOnce(DoAll(SetArgPointee<1>("populated 0\nfrozen 0\n"),
+                      Return(true)));
+
+  StatusOr<bool> statusor = controller_->IsPopulated();
+  ASSERT_OK(statusor);
+  EXPECT_TRUE(statusor.ValueOrDie());
+  statusor = controller_->IsPopulated();
+  ASSERT_OK(statusor);
+  EXPECT_FALSE(statusor.ValueOrDie());
+}
+
+TEST_F(CgroupControllerTest, IsPopulatedNotUnified) {
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->IsPopulated());
+}
+
 TEST_F(CgroupControllerTest, GetParamIntSuccess) {
   const string kContents = "42";
 
@@ -847,6 +1497,183 @@ TEST_F(CgroupControllerTest, RegisterNotificationBadCallback) {
       "not a repeatable callback");
 }
 
+// Tests for RegisterPressureNotification().
+
+TEST_F(CgroupControllerTest, RegisterPressureNotificationSuccess) {
+  controller_->set_unified(true);
+  EventSpec::PressureThreshold threshold;
+  threshold.set_type(EventSpec::PressureThreshold::FULL);
+  threshold.set_threshold(150000);
+  threshold.set_window(1000000);
+
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterTriggerNotification(kCgroupPath, "memory.pressure",
+                                          "full 150000 1000000", NotNull()))
+      .WillOnce(Return(1));
+
+  unique_ptr<EventFdNotifications::EventCallback> cb(
+      NewPermanentCallback(&EventCallback));
+  EXPECT_OK(CallRegisterPressureNotification("memory.pressure", threshold,
+                                             cb.get()));
+}
+
+TEST_F(CgroupControllerTest, RegisterPressureNotificationDefaultsToSome) {
+  controller_->set_unified(true);
+  EventSpec::PressureThreshold threshold;
+  threshold.set_threshold(150000);
+  threshold.set_window(1000000);
+
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterTriggerNotification(kCgroupPath, "cpu.pressure",
+                                          "some 150000 1000000", NotNull()))
+      .WillOnce(Return(Status::CANCELLED));
+
+  unique_ptr<EventFdNotifications::EventCallback> cb(
+      NewPermanentCallback(&EventCallback));
+  EXPECT_ERROR_CODE(
+      ::util::error::CANCELLED,
+      CallRegisterPressureNotification("cpu.pressure", threshold, cb.get()));
+}
+
+TEST_F(CgroupControllerTest, RegisterPressureNotificationNotUnified) {
+  EventSpec::PressureThreshold threshold;
+  threshold.set_threshold(150000);
+  threshold.set_window(1000000);
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    CallRegisterPressureNotification(
+                        "cpu.pressure", threshold,
+                        NewPermanentCallback(&EventCallback)));
+}
+
+TEST_F(CgroupControllerTest, RegisterPressureNotificationNoWindow) {
+  controller_->set_unified(true);
+  EventSpec::PressureThreshold threshold;
+  threshold.set_threshold(150000);
+
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    CallRegisterPressureNotification(
+                        "cpu.pressure", threshold,
+                        NewPermanentCallback(&EventCallback)));
+}
+
+// Tests for RegisterEmptyNotification().
+
+TEST_F(CgroupControllerTest, RegisterEmptyNotificationUnified) {
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterWatchNotification(kCgroupPath, "cgroup.events",
+                                        "populated 0", NotNull()))
+      .WillOnce(Return(1));
+
+  unique_ptr<EventFdNotifications::EventCallback> cb(
+      NewPermanentCallback(&EventCallback));
+  EXPECT_OK(controller_->RegisterEmptyNotification(cb.release()));
+}
+
+TEST_F(CgroupControllerTest, RegisterEmptyNotificationSetsReleaseAgent) {
+  const string kReleaseAgentPath = "/dev/cgroup/memory/release_agent";
+  EXPECT_CALL(*mock_kernel_, Access(kReleaseAgentPath, F_OK))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kReleaseAgentPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("\n"), Return(true)));
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("/usr/local/bin/lmctfy-release-agent",
+                               kReleaseAgentPath, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("1", JoinPath(kCgroupPath, "notify_on_release"),
+                               NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterReleaseNotification(kHierarchyPath, NotNull()))
+      .WillOnce(Return(1));
+
+  unique_ptr<EventFdNotifications::EventCallback> cb(
+      NewPermanentCallback(&EventCallback));
+  EXPECT_OK(controller_->RegisterEmptyNotification(cb.release()));
+}
+
+TEST_F(CgroupControllerTest, RegisterEmptyNotificationKeepsReleaseAgent) {
+  const string kReleaseAgentPath = "/dev/cgroup/memory/release_agent";
+  EXPECT_CALL(*mock_kernel_, Access(kReleaseAgentPath, F_OK))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kReleaseAgentPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("/usr/local/bin/lmctfy-release-agent\n"),
+                      Return(true)));
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("1", JoinPath(kCgroupPath, "notify_on_release"),
+                               NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterReleaseNotification(kHierarchyPath, NotNull()))
+      .WillOnce(Return(Status::CANCELLED));
+
+  unique_ptr<EventFdNotifications::EventCallback> cb(
+      NewPermanentCallback(&EventCallback));
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    controller_->RegisterEmptyNotification(cb.release()));
+}
+
+TEST_F(CgroupControllerTest, RegisterEmptyNotificationOtherReleaseAgent) {
+  const string kReleaseAgentPath = "/dev/cgroup/memory/release_agent";
+  EXPECT_CALL(*mock_kernel_, Access(kReleaseAgentPath, F_OK))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kReleaseAgentPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("/sbin/other-agent\n"), Return(true)));
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->RegisterEmptyNotification(
+                        NewPermanentCallback(&EventCallback)));
+}
+
+TEST_F(CgroupControllerTest, RegisterEmptyNotificationUnknownRoot) {
+  controller_.reset(NewCgroupController(kType, "/other", kCgroupPath, true,
+                                        mock_kernel_.get(),
+                                        mock_eventfd_notifications_.get()));
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->RegisterEmptyNotification(
+                        NewPermanentCallback(&EventCallback)));
+}
+
+// Tests for ClearReleaseNotification().
+
+TEST_F(CgroupControllerTest, ClearReleaseNotificationInherited) {
+  const string kNotifyPath = JoinPath(kCgroupPath, "notify_on_release");
+  EXPECT_CALL(*mock_kernel_, Access(kNotifyPath, F_OK)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kNotifyPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("1\n"), Return(true)));
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("0", kNotifyPath, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+
+  EXPECT_OK(controller_->ClearReleaseNotification());
+}
+
+TEST_F(CgroupControllerTest, ClearReleaseNotificationNotSet) {
+  const string kNotifyPath = JoinPath(kCgroupPath, "notify_on_release");
+  EXPECT_CALL(*mock_kernel_, Access(kNotifyPath, F_OK)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kNotifyPath, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("0\n"), Return(true)));
+
+  EXPECT_OK(controller_->ClearReleaseNotification());
+}
+
+TEST_F(CgroupControllerTest, ClearReleaseNotificationUnified) {
+  controller_->set_unified(true);
+
+  EXPECT_OK(controller_->ClearReleaseNotification());
+}
+
+TEST_F(CgroupControllerTest, ClearReleaseNotificationReadFails) {
+  const string kNotifyPath = JoinPath(kCgroupPath, "notify_on_release");
+  EXPECT_CALL(*mock_kernel_, Access(kNotifyPath, F_OK)).WillOnce(Return(-1));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, controller_->ClearReleaseNotification());
+}
+
 TEST_F(CgroupControllerTest, SetLimit) {
   const string kResFile =
       JoinPath(kCgroupPath, KernelFiles::CGroup::Children::kLimit);
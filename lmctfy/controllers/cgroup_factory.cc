@@ -20,20 +20,35 @@
 #include <set>
 #include <vector>
 
+#include "gflags/gflags.h"
+#include "base/logging.h"
 #include "base/macros.h"
 #include "base/mutex.h"
 #include "file/base/path.h"
+#include "lmctfy/kernel_files.h"
 #include "lmctfy/util/proc_cgroup.h"
 #include "lmctfy/util/proc_cgroups.h"
 #include "util/errors.h"
 #include "util/proc_mounts.h"
 #include "strings/join.h"
+#include "strings/split.h"
 #include "strings/stringpiece.h"
 #include "strings/substitute.h"
 #include "util/gtl/lazy_static_ptr.h"
 #include "util/task/codes.pb.h"
 #include "util/task/status.h"
 
+DEFINE_int32(lmctfy_cgroup_file_cache_size, 0,
+             "The maximum number of frequently read cgroup files (i.e.: "
+             "statistics) to keep open across reads. 0 disables the cache.");
+DEFINE_bool(lmctfy_detect_kernel_features, true,
+            "Whether to detect the optional cgroup files supported by the "
+            "kernel at initialization and skip the ones that are missing.");
+DEFINE_bool(lmctfy_cgroup_tree_index, false,
+            "Whether to keep an inotify-backed index of cgroup directories to "
+            "answer recursive listings instead of walking the hierarchy. Only "
+            "worth it in long-lived processes that list containers often.");
+
 using ::file::JoinPath;
 using ::util::ProcMounts;
 using ::util::ProcMountsData;
@@ -43,7 +58,10 @@ using ::std::max;
 using ::std::set;
 using ::std::vector;
 using ::strings::Join;
+using ::strings::SkipEmpty;
+using ::strings::Split;
 using ::strings::Substitute;
+using ::strings::delimiter::AnyOf;
 using ::util::Status;
 using ::util::StatusOr;
 using ::util::gtl::LazyStaticPtr;
@@ -51,9 +69,58 @@ using ::util::gtl::LazyStaticPtr;
 namespace containers {
 namespace lmctfy {
 
+// Innermost open lookup batch of each thread.
+static __thread CgroupLookupBatch *current_lookup_batch = nullptr;
+
+CgroupLookupBatch::CgroupLookupBatch()
+    : num_lookups_(0), previous_(current_lookup_batch) {
+  current_lookup_batch = this;
+}
+
+CgroupLookupBatch::~CgroupLookupBatch() {
+  CHECK_EQ(this, current_lookup_batch)
+      << "Lookup batches must be closed in order";
+  current_lookup_batch = previous_;
+}
+
+CgroupLookupBatch *CgroupLookupBatch::Current() {
+  return current_lookup_batch;
+}
+
+bool CgroupLookupBatch::Exists(const KernelApi *kernel,
+                               const string &cgroup_path) {
+  auto it = exists_.find(cgroup_path);
+  if (it != exists_.end()) {
+    return it->second;
+  }
+
+  ++num_lookups_;
+  const bool exists = kernel->Access(cgroup_path, F_OK) == 0;
+  exists_[cgroup_path] = exists;
+  return exists;
+}
+
 // The type of mount for cgroup hierarchies.
 static const char kCgroupMountType[] = "cgroup";
 
+// The type of mount for the cgroup v2 unified hierarchy.
+static const char kUnifiedMountType[] = "cgroup2";
+
+// The hierarchies that can be backed by the unified hierarchy, and the name of
+// the controller of the unified hierarchy that backs them. An empty name is a
+// feature of the core, always available.
+static const struct {
+  const char *controller;
+  CgroupHierarchy hierarchy;
+} kUnifiedHierarchies[] = {
+  {"cpu", CGROUP_CPU},
+  {"cpu", CGROUP_CPUACCT},
+  {"cpuset", CGROUP_CPUSET},
+  {"", CGROUP_FREEZER},
+  {"memory", CGROUP_MEMORY},
+  {"io", CGROUP_BLOCKIO},
+};
+
 // Map from hierarchy name to CgroupHierarchy for all supported hierarchies.
 static LazyStaticPtr<map<string, CgroupHierarchy>>
     g_supported_hierarchies;
@@ -112,9 +179,20 @@ StatusOr<CgroupFactory *> CgroupFactory::New(const KernelApi *kernel) {
 
   // Auto-detect mount points for the cgroup hierarchies.
   map<CgroupHierarchy, string> detected_mounts;
+  string unified_mount;
   for (const ProcMountsData &mount : ProcMounts()) {
+    // Keep the first accessible mount of the unified hierarchy, its
+    // hierarchies are only used if they are not mounted as v1 hierarchies.
+    if (mount.type == kUnifiedMountType) {
+      if (unified_mount.empty() &&
+          kernel->Access(mount.mountpoint, R_OK) == 0) {
+        unified_mount = mount.mountpoint;
+      }
+      continue;
+    }
+
     // We only care about cgroups.
-    if (mount.type != "cgroup") {
+    if (mount.type != kCgroupMountType) {
       continue;
     }
 
@@ -135,12 +213,71 @@ StatusOr<CgroupFactory *> CgroupFactory::New(const KernelApi *kernel) {
     }
   }
 
-  return new CgroupFactory(detected_mounts, kernel);
+  // Back the hierarchies that are not mounted as v1 hierarchies with the
+  // controllers available in the unified hierarchy.
+  set<CgroupHierarchy> unified_hierarchies;
+  if (!unified_mount.empty()) {
+    const string controllers_path =
+        JoinPath(unified_mount, KernelFiles::Unified::kControllers);
+    string controllers_contents;
+    if (!kernel->ReadFileToString(controllers_path, &controllers_contents)) {
+      return Status(::util::error::FAILED_PRECONDITION,
+                    Substitute("Failed to read the controllers of the unified "
+                               "hierarchy from \"$0\"",
+                               controllers_path));
+    }
+    const vector<string> controllers_list =
+        Split(controllers_contents, AnyOf(" \n"), SkipEmpty());
+    const set<string> controllers(controllers_list.begin(),
+                                  controllers_list.end());
+
+    for (const auto &unified_hierarchy : kUnifiedHierarchies) {
+      const string controller = unified_hierarchy.controller;
+      if (detected_mounts.find(unified_hierarchy.hierarchy) !=
+              detected_mounts.end() ||
+          (!controller.empty() &&
+           controllers.find(controller) == controllers.end())) {
+        continue;
+      }
+
+      detected_mounts.insert(
+          make_pair(unified_hierarchy.hierarchy, unified_mount));
+      unified_hierarchies.insert(unified_hierarchy.hierarchy);
+    }
+  }
+
+  CgroupFactory *factory =
+      new CgroupFactory(detected_mounts, unified_hierarchies, kernel);
+
+  // Detect the optional files of each hierarchy once, rather than on every
+  // access.
+  if (FLAGS_lmctfy_detect_kernel_features) {
+    factory->kernel_features_.reset(new KernelFeatures());
+    for (const auto &hierarchy_path_pair : detected_mounts) {
+      factory->kernel_features_->Detect(kernel, hierarchy_path_pair.first,
+                                        hierarchy_path_pair.second);
+    }
+  }
+
+  return factory;
 }
 
 CgroupFactory::CgroupFactory(const map<CgroupHierarchy, string> &cgroup_mounts,
                              const KernelApi *kernel)
+    : CgroupFactory(cgroup_mounts, {}, kernel) {}
+
+CgroupFactory::CgroupFactory(const map<CgroupHierarchy, string> &cgroup_mounts,
+                             const set<CgroupHierarchy> &unified_hierarchies,
+                             const KernelApi *kernel)
     : kernel_(kernel) {
+  if (FLAGS_lmctfy_cgroup_file_cache_size > 0) {
+    file_cache_.reset(
+        new CgroupFileCache(kernel, FLAGS_lmctfy_cgroup_file_cache_size));
+  }
+  if (FLAGS_lmctfy_cgroup_tree_index) {
+    tree_index_.reset(new CgroupTreeIndex(kernel));
+  }
+
   // Create the mounted paths from the specified cgroup_mounts.
   set<string> mounted_paths;
   for (const auto &hierarchy_path_pair : cgroup_mounts) {
@@ -154,9 +291,19 @@ CgroupFactory::CgroupFactory(const map<CgroupHierarchy, string> &cgroup_mounts,
       mounted_paths.insert(hierarchy_path_pair.second);
     }
 
+    const bool unified = unified_hierarchies.find(hierarchy_path_pair.first) !=
+                         unified_hierarchies.end();
     mount_paths_.insert(
         make_pair(hierarchy_path_pair.first,
-                  MountPoint(hierarchy_path_pair.second, owns_mount)));
+                  MountPoint(hierarchy_path_pair.second, owns_mount, unified)));
+  }
+
+  for (const auto &unified_hierarchy : kUnifiedHierarchies) {
+    if (*unified_hierarchy.controller != '\0' &&
+        unified_hierarchies.find(unified_hierarchy.hierarchy) !=
+            unified_hierarchies.end()) {
+      unified_controllers_.insert(unified_hierarchy.controller);
+    }
   }
 }
 
@@ -170,7 +317,11 @@ StatusOr<string> CgroupFactory::Get(CgroupHierarchy type,
   const string cgroup_path = statusor.ValueOrDie();
 
   // Ensure the cgroup already exists.
-  if (kernel_->Access(cgroup_path, F_OK) != 0) {
+  CgroupLookupBatch *batch = CgroupLookupBatch::Current();
+  const bool exists = batch != nullptr
+                          ? batch->Exists(kernel_, cgroup_path)
+                          : kernel_->Access(cgroup_path, F_OK) == 0;
+  if (!exists) {
     return Status(::util::error::NOT_FOUND,
                   Substitute("Expected cgroup \"$0\" to exist.", cgroup_path));
   }
@@ -199,6 +350,12 @@ StatusOr<string> CgroupFactory::Create(CgroupHierarchy type,
         Substitute("Expected cgroup \"$0\" to not exist.", cgroup_path));
   }
 
+  // Children only have the files of the controllers enabled in their parent.
+  if (IsUnified(type)) {
+    RETURN_IF_ERROR(
+        EnableUnifiedControllers(file::Dirname(cgroup_path).ToString()));
+  }
+
   // Make the actual cgroup if we own the cgroup.
   if (kernel_->MkDir(cgroup_path) != 0) {
     return Status(::util::error::FAILED_PRECONDITION,
@@ -208,6 +365,64 @@ StatusOr<string> CgroupFactory::Create(CgroupHierarchy type,
   return cgroup_path;
 }
 
+Status CgroupFactory::EnableUnifiedControllers(
+    const string &cgroup_path) const {
+  if (unified_controllers_.empty()) {
+    return Status::OK;
+  }
+
+  const string subtree_control_path =
+      JoinPath(cgroup_path, KernelFiles::Unified::kSubtreeControl);
+  string contents;
+  if (!kernel_->ReadFileToString(subtree_control_path, &contents)) {
+    return Status(::util::error::FAILED_PRECONDITION,
+                  Substitute("Failed to read the enabled controllers from "
+                             "\"$0\"",
+                             subtree_control_path));
+  }
+  const vector<string> enabled_list =
+      Split(contents, AnyOf(" \n"), SkipEmpty());
+  const set<string> enabled(enabled_list.begin(), enabled_list.end());
+
+  vector<string> to_enable;
+  for (const string &controller : unified_controllers_) {
+    if (enabled.find(controller) == enabled.end()) {
+      to_enable.push_back("+" + controller);
+    }
+  }
+  if (to_enable.empty()) {
+    return Status::OK;
+  }
+
+  // All controllers are enabled in a single write.
+  const string controllers = Join(to_enable, " ");
+  bool open_error = false;
+  bool write_error = false;
+  kernel_->SafeWriteResFile(controllers, subtree_control_path, &open_error,
+                            &write_error);
+  if (!open_error && !write_error) {
+    return Status::OK;
+  }
+
+  // The kernel refuses to enable controllers in a non-root cgroup that has
+  // processes of its own (the "no internal processes" rule). Their processes
+  // are not moved for them since they belong to the parent container, the
+  // caller has to move them into a child first.
+  string procs;
+  if (kernel_->ReadFileToString(
+          JoinPath(cgroup_path, KernelFiles::CGroup::kProcesses), &procs) &&
+      !procs.empty()) {
+    return Status(::util::error::FAILED_PRECONDITION,
+                  Substitute("Failed to enable controllers \"$0\" in \"$1\", "
+                             "it has processes of its own which must be moved "
+                             "into a child cgroup first",
+                             controllers, cgroup_path));
+  }
+  return Status(::util::error::FAILED_PRECONDITION,
+                Substitute("Failed to enable controllers \"$0\" in \"$1\"",
+                           controllers, subtree_control_path));
+}
+
 bool CgroupFactory::OwnsCgroup(CgroupHierarchy type) const {
   auto it = mount_paths_.find(type);
   if (it == mount_paths_.end()) {
@@ -220,6 +435,45 @@ bool CgroupFactory::OwnsCgroup(CgroupHierarchy type) const {
 // TODO(vmarmol): Allow the use of remount. This will faill if the hierarchies
 // are already in use (with subcontainers), but it will gain us more flexibility
 // at initialization time.
+Status CgroupFactory::Rename(CgroupHierarchy type,
+                             const string &hierarchy_path,
+                             const string &new_hierarchy_path) const {
+  if (!OwnsCgroup(type)) {
+    return Status::OK;
+  }
+
+  if (file::Dirname(hierarchy_path) != file::Dirname(new_hierarchy_path)) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  Substitute("Can't rename cgroup \"$0\" to \"$1\" under a "
+                             "different parent",
+                             hierarchy_path, new_hierarchy_path));
+  }
+
+  const string cgroup_path = RETURN_IF_ERROR(Get(type, hierarchy_path));
+  const string new_cgroup_path =
+      RETURN_IF_ERROR(GetCgroupPath(type, new_hierarchy_path));
+
+  // Ensure the new cgroup does not already exist.
+  if (kernel_->Access(new_cgroup_path, F_OK) == 0) {
+    return Status(
+        ::util::error::ALREADY_EXISTS,
+        Substitute("Expected cgroup \"$0\" to not exist.", new_cgroup_path));
+  }
+
+  if (kernel_->Rename(cgroup_path, new_cgroup_path) != 0) {
+    return Status(::util::error::FAILED_PRECONDITION,
+                  Substitute("Failed to rename cgroup \"$0\" to \"$1\".",
+                             cgroup_path, new_cgroup_path));
+  }
+
+  // Files opened under the old path now belong to the renamed cgroup.
+  if (file_cache_ != nullptr) {
+    file_cache_->Invalidate(cgroup_path);
+  }
+
+  return Status::OK;
+}
+
 Status CgroupFactory::Mount(const CgroupMount &cgroup) {
   // Get number of existing mounts in the specified mount point.
   int existing_mounts_missing = 0;
@@ -300,8 +554,8 @@ Status CgroupFactory::Mount(const CgroupMount &cgroup) {
   bool owns_mount = true;
   for (int i = 0; i < cgroup.hierarchy_size(); ++i) {
     CgroupHierarchy hierarchy = cgroup.hierarchy(i);
-    mount_paths_.insert(
-        make_pair(hierarchy, MountPoint(cgroup.mount_path(), owns_mount)));
+    mount_paths_.insert(make_pair(
+        hierarchy, MountPoint(cgroup.mount_path(), owns_mount, false)));
     owns_mount = false;
   }
 
@@ -312,6 +566,24 @@ bool CgroupFactory::IsMounted(CgroupHierarchy type) const {
   return mount_paths_.find(type) != mount_paths_.end();
 }
 
+bool CgroupFactory::IsUnified(CgroupHierarchy type) const {
+  auto it = mount_paths_.find(type);
+  if (it == mount_paths_.end()) {
+    return false;
+  }
+
+  return it->second.unified;
+}
+
+bool CgroupFactory::HasUnified() const {
+  for (const auto &type_mount_pair : mount_paths_) {
+    if (type_mount_pair.second.unified) {
+      return true;
+    }
+  }
+  return false;
+}
+
 StatusOr<string> CgroupFactory::GetCgroupPath(
     CgroupHierarchy hierarchy, const string &hierarchy_path) const {
   auto mount_path_it = mount_paths_.find(hierarchy);
@@ -334,8 +606,17 @@ StatusOr<string> CgroupFactory::DetectCgroupPath(
                              hierarchy));
   }
 
-  // Find path for the specified subsystem.
+  // Find path for the specified subsystem. The unified hierarchy is listed with
+  // ID 0 and no subsystems.
+  const bool unified = IsUnified(hierarchy);
   for (const ProcCgroupData &cgroup : ProcCgroup(tid)) {
+    if (unified) {
+      if (cgroup.hierarchy_id == 0) {
+        return cgroup.hierarchy_path;
+      }
+      continue;
+    }
+
     // Check all co-mounted subsystems.
     auto it = ::std::find(cgroup.subsystems.begin(), cgroup.subsystems.end(),
                           subsystem_name);
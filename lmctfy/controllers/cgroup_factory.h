@@ -16,11 +16,16 @@
 #define SRC_CONTROLLERS_CGROUP_FACTORY_H_
 
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
 using ::std::string;
 
 #include "base/macros.h"
 #include "system_api/kernel_api.h"
+#include "lmctfy/controllers/cgroup_file_cache.h"
+#include "lmctfy/controllers/cgroup_tree_index.h"
+#include "lmctfy/controllers/kernel_features.h"
 #include "include/config.pb.h"
 #include "include/lmctfy.pb.h"
 #include "util/task/statusor.h"
@@ -30,24 +35,79 @@ namespace lmctfy {
 
 typedef ::system_api::KernelAPI KernelApi;
 
+// Remembers which cgroups exist for the duration of an operation that looks up
+// the cgroups of many containers (e.g.: ContainerApi::StatsMany()).
+//
+// While a batch is open, CgroupFactory::Get() on the thread that opened it
+// checks each cgroup directory at most once. Co-mounted hierarchies, and all
+// the controllers of the unified hierarchy, share their cgroup directories so
+// the resources of a container otherwise check the same directory over and
+// over. Cgroups created or removed while the batch is open are reported as
+// they were when first checked.
+//
+// Batches can be nested, lookups go to the innermost batch.
+//
+// Class is not thread-safe, it must be used by the thread that created it.
+class CgroupLookupBatch {
+ public:
+  // Opens the batch on the current thread.
+  CgroupLookupBatch();
+
+  // Closes the batch.
+  ~CgroupLookupBatch();
+
+  // Gets the innermost open batch of the current thread, nullptr if there is
+  // none.
+  static CgroupLookupBatch *Current();
+
+  // Whether the cgroup at cgroup_path exists. Only the first check of each
+  // cgroup reaches the kernel. Does not take ownership of kernel.
+  bool Exists(const KernelApi *kernel, const string &cgroup_path);
+
+  // Number of checks that reached the kernel.
+  int num_lookups() const { return num_lookups_; }
+
+ private:
+  // Map of absolute cgroup path to whether it exists.
+  ::std::map<string, bool> exists_;
+
+  int num_lookups_;
+
+  // The batch that was current when this one was opened.
+  CgroupLookupBatch *previous_;
+
+  DISALLOW_COPY_AND_ASSIGN(CgroupLookupBatch);
+};
+
 // Factory for creating valid cgroup paths of a specified resource.
 //
+// Hierarchies are either v1 hierarchies, each mounted on their own or
+// co-mounted, or controllers of the cgroup v2 unified hierarchy. The unified
+// hierarchy is handled like one mount with all of its hierarchies co-mounted:
+// only one of them owns the cgroups. A hierarchy mounted as v1 is never taken
+// from the unified hierarchy.
+//
 // Class is thread-safe.
 class CgroupFactory {
  public:
   // Creates a new instance of CgroupFactory and detects the mounted and
-  // accessible cgroup hierarchies. Does not take ownership of kernel.
+  // accessible cgroup hierarchies, and the optional cgroup files they support.
+  // Does not take ownership of kernel.
   static ::util::StatusOr<CgroupFactory *> New(const KernelApi *kernel);
 
   virtual ~CgroupFactory() {}
 
   // Gets the full cgroup path of the specified type and hierarchy_path. Returns
-  // OK with the path iff the path now exists and is ready for use.
+  // OK with the path iff the path now exists and is ready for use. Existence
+  // is taken from the current CgroupLookupBatch, if any.
   virtual ::util::StatusOr<string> Get(CgroupHierarchy type,
                                        const string &hierarchy_path) const;
 
   // Creates and returns the full cgroup path of the specified type and
-  // hierarchy_path.
+  // hierarchy_path. In the unified hierarchy the controllers of the unified
+  // hierarchies are enabled in the parent first, if they are not already. The
+  // kernel does not allow that while the parent (other than the root) has
+  // processes of its own, and they are not moved out of it here.
   //
   // Arguments:
   //   type: The cgroup hierarchy to create a hierarchy in.
@@ -56,9 +116,26 @@ class CgroupFactory {
   // Return:
   //   Status or the operation. On success returns OK and populates the full
   //       cgroup path which now exists and is ready for use.
+  //       FAILED_PRECONDITION if the controllers could not be enabled in the
+  //       parent, e.g.: because it has processes.
   virtual ::util::StatusOr<string> Create(CgroupHierarchy type,
                                           const string &hierarchy_path) const;
 
+  // Renames the cgroup at hierarchy_path of the specified type to
+  // new_hierarchy_path. The kernel only renames cgroups within their parent so
+  // both paths must have the same parent. Renaming a cgroup in a hierarchy that
+  // is not owned is a no-op.
+  //
+  // Arguments:
+  //   type: The cgroup hierarchy the cgroup is in.
+  //   hierarchy_path: The path inside the cgroup hierarchy to rename.
+  //   new_hierarchy_path: The new path inside the cgroup hierarchy.
+  // Return:
+  //   Status: OK iff the cgroup now exists at new_hierarchy_path.
+  virtual ::util::Status Rename(CgroupHierarchy type,
+                                const string &hierarchy_path,
+                                const string &new_hierarchy_path) const;
+
   // Mounts the specified cgroup hierarchies to the specified mount path.
   virtual ::util::Status Mount(const CgroupMount &cgroup);
 
@@ -71,6 +148,14 @@ class CgroupFactory {
   // true.
   virtual bool OwnsCgroup(CgroupHierarchy type) const;
 
+  // Determines whether the specified hierarchy is a controller of the cgroup v2
+  // unified hierarchy. Return false if the hierarchy is not mounted.
+  bool IsUnified(CgroupHierarchy type) const;
+
+  // Determines whether any mounted hierarchy is a controller of the cgroup v2
+  // unified hierarchy.
+  bool HasUnified() const;
+
   // Detect the cgroup path of the specified TID in the specified hierarchy.
   //
   // Arguments:
@@ -94,6 +179,19 @@ class CgroupFactory {
   //  Populates the machine spec with information about the current mounts.
   virtual ::util::Status PopulateMachineSpec(MachineSpec *spec) const;
 
+  // Gets the cache of open cgroup files shared by all controllers, nullptr if
+  // file caching is disabled. The cache is owned by this factory.
+  CgroupFileCache *file_cache() const { return file_cache_.get(); }
+
+  // Gets the optional cgroup files supported by the kernel, shared by all
+  // controllers. nullptr if feature detection is disabled. The registry is
+  // owned by this factory.
+  KernelFeatures *kernel_features() const { return kernel_features_.get(); }
+
+  // Gets the index of cgroup directories shared by all controllers, nullptr if
+  // indexing is disabled. The index is owned by this factory.
+  CgroupTreeIndex *tree_index() const { return tree_index_.get(); }
+
  protected:
   // Arguments:
   //   cgroup_mounts: Map of hierarchy type to its mount path.
@@ -101,30 +199,61 @@ class CgroupFactory {
   CgroupFactory(const ::std::map<CgroupHierarchy, string> &cgroup_mounts,
                 const KernelApi *kernel);
 
+  // Arguments:
+  //   cgroup_mounts: Map of hierarchy type to its mount path.
+  //   unified_hierarchies: The hierarchies of cgroup_mounts that are
+  //       controllers of the unified hierarchy.
+  //   kernel: Wrapper for all kernel calls. Does not take ownership.
+  CgroupFactory(const ::std::map<CgroupHierarchy, string> &cgroup_mounts,
+                const ::std::set<CgroupHierarchy> &unified_hierarchies,
+                const KernelApi *kernel);
+
  private:
   // Get the cgroup path for the specified cgroup hierarchy and hierarchy_path.
   ::util::StatusOr<string> GetCgroupPath(CgroupHierarchy hierarchy,
                                          const string &hierarchy_path) const;
 
+  // Enables the controllers of the unified hierarchies in the cgroup at
+  // cgroup_path for its children, the ones already enabled are skipped.
+  ::util::Status EnableUnifiedControllers(const string &cgroup_path) const;
+
   // Data object for a mount point path and whether it is owned.
   class MountPoint {
    public:
-    MountPoint(const string &path, bool owns) : path(path), owns(owns) {}
+    MountPoint(const string &path, bool owns, bool unified)
+        : path(path), owns(owns), unified(unified) {}
 
     // The absolute mount to the mount point.
     const string path;
 
     // Whether this mount path is owned.
     const bool owns;
+
+    // Whether this mount is the unified hierarchy.
+    const bool unified;
   };
 
   // Map of hierarchy type to its mount point (a path and whether the hierarchy
   // owns that mount path).
   ::std::map<CgroupHierarchy, MountPoint> mount_paths_;
 
+  // Names of the controllers of the unified hierarchy used by the unified
+  // hierarchies (e.g.: "cpu", "io"). Controllers that are part of the core
+  // (e.g.: the freezer) are not included.
+  ::std::set<string> unified_controllers_;
+
   // Wrapper for all calls to the kernel.
   const KernelApi *kernel_;
 
+  // Cache of open cgroup files, nullptr if disabled.
+  ::std::unique_ptr<CgroupFileCache> file_cache_;
+
+  // Optional cgroup files supported by the kernel, nullptr if not detected.
+  ::std::unique_ptr<KernelFeatures> kernel_features_;
+
+  // Index of cgroup directories, nullptr if disabled.
+  ::std::unique_ptr<CgroupTreeIndex> tree_index_;
+
   friend class CgroupFactoryTest;
 
   DISALLOW_COPY_AND_ASSIGN(CgroupFactory);
@@ -34,12 +34,22 @@ class MockCgroupFactory : public CgroupFactory {
                        {CGROUP_NET, "/dev/cgroup/net"}},
                       reinterpret_cast<KernelApi *>(0xFFFFFFFF)) {}
 
+  // Mock whose hierarchies are all controllers of the unified hierarchy.
+  explicit MockCgroupFactory(
+      const ::std::set<CgroupHierarchy> &unified_hierarchies)
+      : CgroupFactory(UnifiedMounts(unified_hierarchies), unified_hierarchies,
+                      reinterpret_cast<KernelApi *>(0xFFFFFFFF)) {}
+
   MOCK_CONST_METHOD2(Get,
                      ::util::StatusOr<string>(CgroupHierarchy type,
                                               const string &hierarchy_path));
   MOCK_CONST_METHOD2(Create,
                      ::util::StatusOr<string>(CgroupHierarchy type,
                                               const string &hierarchy_path));
+  MOCK_CONST_METHOD3(Rename,
+                     ::util::Status(CgroupHierarchy type,
+                                    const string &hierarchy_path,
+                                    const string &new_hierarchy_path));
   MOCK_CONST_METHOD1(OwnsCgroup, bool(CgroupHierarchy type));
   MOCK_METHOD1(Mount, ::util::Status(const CgroupMount &cgroup));
   MOCK_CONST_METHOD1(IsMounted, bool(CgroupHierarchy type));
@@ -51,6 +61,16 @@ class MockCgroupFactory : public CgroupFactory {
   MOCK_CONST_METHOD1(PopulateMachineSpec, ::util::Status(MachineSpec *spec));
 
  private:
+  // Mounts the specified hierarchies at the unified hierarchy mount.
+  static ::std::map<CgroupHierarchy, string> UnifiedMounts(
+      const ::std::set<CgroupHierarchy> &unified_hierarchies) {
+    ::std::map<CgroupHierarchy, string> mounts;
+    for (CgroupHierarchy hierarchy : unified_hierarchies) {
+      mounts[hierarchy] = "/sys/fs/cgroup";
+    }
+    return mounts;
+  }
+
   DISALLOW_COPY_AND_ASSIGN(MockCgroupFactory);
 };
 
@@ -17,6 +17,7 @@
 #include <unistd.h>
 #include <memory>
 
+#include "gflags/gflags.h"
 #include "base/callback.h"
 #include "system_api/kernel_api_mock.h"
 #include "util/errors_test_util.h"
@@ -34,6 +35,7 @@ using ::testing::Contains;
 using ::testing::DoAll;
 #include "util/testing/equals_initialized_proto.h"
 using ::testing::EqualsInitializedProto;
+using ::testing::HasSubstr;
 using ::testing::InSequence;
 using ::testing::Invoke;
 using ::testing::NotNull;
@@ -41,9 +43,12 @@ using ::testing::Return;
 using ::testing::SetArgPointee;
 using ::testing::StrEq;
 using ::testing::StrictMock;
+using ::testing::_;
 using ::util::Status;
 using ::util::StatusOr;
 
+DECLARE_bool(lmctfy_detect_kernel_features);
+
 namespace containers {
 namespace lmctfy {
 
@@ -64,6 +69,10 @@ static const char kNetMount[] = "/dev/cgroup/net";
 static const char kDevCgroup[] = "/dev/cgroup";
 static const char kDev[] = "/dev";
 static const char kProcCgroups[] = "/proc/cgroups";
+static const char kUnifiedMount[] = "/sys/fs/cgroup";
+static const char kUnifiedCgroupPath[] = "/sys/fs/cgroup/test";
+static const char kSubtreeControl[] = "/sys/fs/cgroup/cgroup.subtree_control";
+static const char kUnifiedProcs[] = "/sys/fs/cgroup/cgroup.procs";
 
 // Expect the mounted hierarchy to be of type net.
 static void CheckNet(const string &name, const string &path,
@@ -91,6 +100,19 @@ class CgroupFactoryTest : public ::testing::Test {
                           mock_kernel_.get()));
   }
 
+  // Replaces the factory with one where CPU, CPU accounting, the freezer, and
+  // block IO are in the unified hierarchy, and memory is a v1 hierarchy.
+  void UseUnifiedHierarchy() {
+    factory_.reset(new CgroupFactory(
+        {{CGROUP_CPU, kUnifiedMount},
+         {CGROUP_CPUACCT, kUnifiedMount},
+         {CGROUP_FREEZER, kUnifiedMount},
+         {CGROUP_MEMORY, kMemoryMount},
+         {CGROUP_BLOCKIO, kUnifiedMount}},
+        {CGROUP_CPU, CGROUP_CPUACCT, CGROUP_FREEZER, CGROUP_BLOCKIO},
+        mock_kernel_.get()));
+  }
+
   // Checks that the specified mount exists in the factory's internal map.
   void CheckMount(CgroupHierarchy hierarchy, const string &path, bool owns) {
     auto path_mount_it = factory_->mount_paths_.find(hierarchy);
@@ -138,6 +160,13 @@ TEST_F(CgroupFactoryTest, New) {
        "proc /proc proc rw,nosuid,nodev,noexec,relatime 0 0",
        "none /fs/another/net cgroup rw,relatime,net 0 0", });
 
+  // The optional files of the detected hierarchies are probed once. The memory
+  // hierarchy has no idle page stats.
+  EXPECT_CALL(*mock_kernel_, Access(_, F_OK)).WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              Access("/dev/cgroup/memory/memory.idle_page_stats", F_OK))
+      .WillOnce(Return(-1));
+
   // CPU, memory, and net are accessible, rlimit is not.
   EXPECT_CALL(*mock_kernel_, Access("/dev/cgroup/cpu", R_OK))
       .WillRepeatedly(Return(0));
@@ -167,6 +196,89 @@ TEST_F(CgroupFactoryTest, New) {
 
   EXPECT_EQ("/fs/another/net", mount_paths.at(CGROUP_NET).path);
   EXPECT_TRUE(mount_paths.at(CGROUP_NET).owns);
+
+  KernelFeatures *kernel_features = factory->kernel_features();
+  ASSERT_NE(nullptr, kernel_features);
+  EXPECT_TRUE(kernel_features->IsMissing(CGROUP_MEMORY,
+                                         "memory.idle_page_stats"));
+  EXPECT_FALSE(kernel_features->IsMissing(CGROUP_MEMORY,
+                                          "memory.stale_page_age"));
+  EXPECT_FALSE(kernel_features->IsUndetected(CGROUP_CPUACCT,
+                                             "cpuacct.histogram"));
+}
+
+TEST_F(CgroupFactoryTest, NewWithoutKernelFeatureDetection) {
+  FLAGS_lmctfy_detect_kernel_features = false;
+  mock_lines_.ExpectFileLines(
+      "/proc/mounts",
+      {"none /dev/cgroup/memory cgroup rw,relatime,memory 0 0", });
+  EXPECT_CALL(*mock_kernel_, Access("/dev/cgroup/memory", R_OK))
+      .WillRepeatedly(Return(0));
+
+  StatusOr<CgroupFactory *> statusor = CgroupFactory::New(mock_kernel_.get());
+  FLAGS_lmctfy_detect_kernel_features = true;
+  ASSERT_OK(statusor);
+  unique_ptr<CgroupFactory> factory(statusor.ValueOrDie());
+
+  EXPECT_EQ(nullptr, factory->kernel_features());
+}
+
+TEST_F(CgroupFactoryTest, NewWithUnifiedHierarchy) {
+  FLAGS_lmctfy_detect_kernel_features = false;
+  mock_lines_.ExpectFileLines(
+      "/proc/mounts",
+      {"cgroup2 /sys/fs/cgroup cgroup2 rw,nosuid,nodev,noexec 0 0",
+       "none /dev/cgroup/memory cgroup rw,relatime,memory 0 0", });
+  EXPECT_CALL(*mock_kernel_, Access(kUnifiedMount, R_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, Access(kMemoryMount, R_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString("/sys/fs/cgroup/cgroup.controllers", NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("cpuset cpu io memory pids\n"),
+                      Return(true)));
+
+  StatusOr<CgroupFactory *> statusor = CgroupFactory::New(mock_kernel_.get());
+  FLAGS_lmctfy_detect_kernel_features = true;
+  ASSERT_OK(statusor);
+  unique_ptr<CgroupFactory> factory(statusor.ValueOrDie());
+
+  // Memory is mounted as a v1 hierarchy, the rest come from the unified
+  // hierarchy where only CPU owns the cgroups.
+  const auto &mount_paths = GetMountPaths(factory.get());
+  ASSERT_EQ(6, mount_paths.size());
+  EXPECT_EQ(kUnifiedMount, mount_paths.at(CGROUP_CPU).path);
+  EXPECT_TRUE(mount_paths.at(CGROUP_CPU).owns);
+  for (CgroupHierarchy hierarchy :
+       {CGROUP_CPUACCT, CGROUP_CPUSET, CGROUP_FREEZER, CGROUP_BLOCKIO}) {
+    EXPECT_EQ(kUnifiedMount, mount_paths.at(hierarchy).path);
+    EXPECT_FALSE(mount_paths.at(hierarchy).owns);
+    EXPECT_TRUE(factory->IsUnified(hierarchy));
+  }
+  EXPECT_TRUE(factory->IsUnified(CGROUP_CPU));
+  EXPECT_EQ(kMemoryMount, mount_paths.at(CGROUP_MEMORY).path);
+  EXPECT_TRUE(mount_paths.at(CGROUP_MEMORY).owns);
+  EXPECT_FALSE(factory->IsUnified(CGROUP_MEMORY));
+  EXPECT_FALSE(factory->IsUnified(CGROUP_JOB));
+  EXPECT_TRUE(factory->HasUnified());
+}
+
+TEST_F(CgroupFactoryTest, HasUnifiedWithoutUnifiedHierarchy) {
+  EXPECT_FALSE(factory_->HasUnified());
+}
+
+TEST_F(CgroupFactoryTest, NewUnifiedControllersReadFails) {
+  mock_lines_.ExpectFileLines(
+      "/proc/mounts",
+      {"cgroup2 /sys/fs/cgroup cgroup2 rw,nosuid,nodev,noexec 0 0", });
+  EXPECT_CALL(*mock_kernel_, Access(kUnifiedMount, R_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              ReadFileToString("/sys/fs/cgroup/cgroup.controllers", NotNull()))
+      .WillOnce(Return(false));
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    CgroupFactory::New(mock_kernel_.get()));
 }
 
 // Tests for supported hierarchy mapping.
@@ -206,6 +318,42 @@ TEST_F(CgroupFactoryTest, GetCgroupDoesNotExist) {
   EXPECT_EQ(::util::error::NOT_FOUND, statusor.status().error_code());
 }
 
+TEST_F(CgroupFactoryTest, GetInLookupBatch) {
+  // CPU and CPU accounting are co-mounted, their cgroup is only checked once.
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPathNotOwns, F_OK))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPath, F_OK)).WillOnce(Return(-1));
+
+  CgroupLookupBatch batch;
+  EXPECT_OK(factory_->Get(CGROUP_CPU, kContainerName));
+  EXPECT_OK(factory_->Get(CGROUP_CPUACCT, kContainerName));
+  EXPECT_OK(factory_->Get(CGROUP_CPU, kContainerName));
+
+  // Missing cgroups are remembered too.
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    factory_->Get(kType, kContainerName));
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    factory_->Get(kType, kContainerName));
+  EXPECT_EQ(2, batch.num_lookups());
+}
+
+TEST_F(CgroupFactoryTest, GetAfterLookupBatch) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPath, F_OK))
+      .WillOnce(Return(0))
+      .WillOnce(Return(-1));
+
+  {
+    CgroupLookupBatch batch;
+    EXPECT_EQ(&batch, CgroupLookupBatch::Current());
+    EXPECT_OK(factory_->Get(kType, kContainerName));
+  }
+
+  // Once closed, cgroups are checked again.
+  EXPECT_EQ(nullptr, CgroupLookupBatch::Current());
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    factory_->Get(kType, kContainerName));
+}
+
 // Tests for Create().
 
 TEST_F(CgroupFactoryTest, CreateSuccess) {
@@ -256,6 +404,117 @@ TEST_F(CgroupFactoryTest, CreateMkdirFails) {
   EXPECT_EQ(::util::error::FAILED_PRECONDITION, statusor.status().error_code());
 }
 
+TEST_F(CgroupFactoryTest, CreateUnifiedEnablesControllers) {
+  UseUnifiedHierarchy();
+  EXPECT_CALL(*mock_kernel_, Access(kUnifiedCgroupPath, F_OK))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kSubtreeControl, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("cpu memory\n"), Return(true)));
+  EXPECT_CALL(*mock_kernel_,
+              SafeWriteResFile("+io", kSubtreeControl, NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, MkDir(kUnifiedCgroupPath)).WillOnce(Return(0));
+
+  StatusOr<string> statusor = factory_->Create(CGROUP_CPU, kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(kUnifiedCgroupPath, statusor.ValueOrDie());
+}
+
+TEST_F(CgroupFactoryTest, CreateUnifiedControllersAlreadyEnabled) {
+  UseUnifiedHierarchy();
+  EXPECT_CALL(*mock_kernel_, Access(kUnifiedCgroupPath, F_OK))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kSubtreeControl, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("cpu io\n"), Return(true)));
+  EXPECT_CALL(*mock_kernel_, MkDir(kUnifiedCgroupPath)).WillOnce(Return(0));
+
+  ASSERT_OK(factory_->Create(CGROUP_CPU, kContainerName));
+}
+
+TEST_F(CgroupFactoryTest, CreateUnifiedEnableControllersFails) {
+  UseUnifiedHierarchy();
+  EXPECT_CALL(*mock_kernel_, Access(kUnifiedCgroupPath, F_OK))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kSubtreeControl, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(""), Return(true)));
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("+cpu +io", kSubtreeControl,
+                                              NotNull(), NotNull()))
+      .WillOnce(DoAll(SetArgPointee<3>(true), Return(0)));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kUnifiedProcs, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(""), Return(true)));
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    factory_->Create(CGROUP_CPU, kContainerName));
+}
+
+TEST_F(CgroupFactoryTest, CreateUnifiedParentHasProcesses) {
+  UseUnifiedHierarchy();
+  EXPECT_CALL(*mock_kernel_, Access(kUnifiedCgroupPath, F_OK))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kSubtreeControl, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(""), Return(true)));
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("+cpu +io", kSubtreeControl,
+                                              NotNull(), NotNull()))
+      .WillOnce(DoAll(SetArgPointee<3>(true), Return(0)));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kUnifiedProcs, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("42\n"), Return(true)));
+
+  // The processes are left in the parent, and the child is not created.
+  StatusOr<string> statusor = factory_->Create(CGROUP_CPU, kContainerName);
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION, statusor);
+  EXPECT_THAT(statusor.status().error_message(),
+              HasSubstr("has processes of its own"));
+}
+
+// Tests for Rename().
+
+TEST_F(CgroupFactoryTest, RenameSuccess) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, Access("/dev/cgroup/memory/renamed", F_OK))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(*mock_kernel_, Rename(kCgroupPath, "/dev/cgroup/memory/renamed"))
+      .WillOnce(Return(0));
+
+  EXPECT_TRUE(factory_->Rename(kType, kContainerName, "/renamed").ok());
+}
+
+TEST_F(CgroupFactoryTest, RenameDoesNotOwnCgroup) {
+  EXPECT_TRUE(factory_->Rename(kTypeNotOwns, kContainerName, "/renamed").ok());
+}
+
+TEST_F(CgroupFactoryTest, RenameToDifferentParent) {
+  Status status = factory_->Rename(kType, kContainerName, "/other/renamed");
+  EXPECT_EQ(::util::error::INVALID_ARGUMENT, status.error_code());
+}
+
+TEST_F(CgroupFactoryTest, RenameCgroupDoesNotExist) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPath, F_OK))
+      .WillRepeatedly(Return(-1));
+
+  Status status = factory_->Rename(kType, kContainerName, "/renamed");
+  EXPECT_EQ(::util::error::NOT_FOUND, status.error_code());
+}
+
+TEST_F(CgroupFactoryTest, RenameNewCgroupAlreadyExists) {
+  EXPECT_CALL(*mock_kernel_, Access(_, F_OK)).WillRepeatedly(Return(0));
+
+  Status status = factory_->Rename(kType, kContainerName, "/renamed");
+  EXPECT_EQ(::util::error::ALREADY_EXISTS, status.error_code());
+}
+
+TEST_F(CgroupFactoryTest, RenameFails) {
+  EXPECT_CALL(*mock_kernel_, Access(kCgroupPath, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, Access("/dev/cgroup/memory/renamed", F_OK))
+      .WillRepeatedly(Return(-1));
+  EXPECT_CALL(*mock_kernel_, Rename(kCgroupPath, "/dev/cgroup/memory/renamed"))
+      .WillOnce(Return(-1));
+
+  Status status = factory_->Rename(kType, kContainerName, "/renamed");
+  EXPECT_EQ(::util::error::FAILED_PRECONDITION, status.error_code());
+}
+
 // Tests for IsMounted().
 
 TEST_F(CgroupFactoryTest, IsMounted) {
@@ -452,6 +711,16 @@ TEST_F(CgroupFactoryTest, DetectCgroupPathSubsystemNotFound) {
                     factory_->DetectCgroupPath(0, CGROUP_MEMORY));
 }
 
+TEST_F(CgroupFactoryTest, DetectCgroupPathUnified) {
+  UseUnifiedHierarchy();
+  mock_lines_.ExpectFileLines("/proc/self/cgroup",
+                              {"6:memory:/sys\n", "0::/sys/subcont\n"});
+
+  StatusOr<string> statusor = factory_->DetectCgroupPath(0, CGROUP_CPU);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("/sys/subcont", statusor.ValueOrDie());
+}
+
 typedef CgroupFactoryTest GetSupportedHierarchiesTest;
 
 TEST_F(GetSupportedHierarchiesTest, Success) {
@@ -0,0 +1,239 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/cgroup_file_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "base/logging.h"
+#include "lmctfy/kernel_files.h"
+#include "util/errors.h"
+#include "strings/stringpiece.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+#include "util/task/status.h"
+
+using ::std::shared_ptr;
+using ::strings::Substitute;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+// Size of the buffer each pread() reads into. Most statistics files fit in one
+// read.
+static const int kReadBufferSize = 4096;
+
+// Statistics files that are read often enough to keep open. Only read-only
+// files whose contents are regenerated on each read from offset 0 belong here.
+static const char *const kCacheableFiles[] = {
+    KernelFiles::Cpu::kNumRunning,
+    KernelFiles::Cpu::kThrottlingStats,
+    KernelFiles::CPUAcct::kStat,
+    KernelFiles::CPUAcct::kUsage,
+    KernelFiles::CPUAcct::kUsagePerCPU,
+    KernelFiles::Memory::kFailCount,
+    KernelFiles::Memory::kMaxUsageInBytes,
+    KernelFiles::Memory::kNumaStat,
+    KernelFiles::Memory::kStat,
+    KernelFiles::Memory::kUsageInBytes,
+};
+
+// An open file descriptor which is closed when the last reference goes away.
+class CgroupFileCache::OpenFile {
+ public:
+  // Does not take ownership of kernel. Takes ownership of fd.
+  OpenFile(const KernelApi *kernel, int fd) : kernel_(kernel), fd_(fd) {}
+  ~OpenFile() { kernel_->Close(fd_); }
+
+  int fd() const { return fd_; }
+
+ private:
+  const KernelApi *kernel_;
+  const int fd_;
+
+  DISALLOW_COPY_AND_ASSIGN(OpenFile);
+};
+
+CgroupFileCache::CgroupFileCache(const KernelApi *kernel, int max_open_files)
+    : kernel_(CHECK_NOTNULL(kernel)),
+      max_open_files_(max_open_files > 0 ? max_open_files : 0),
+      hits_(0),
+      misses_(0),
+      invalidations_(0),
+      evictions_(0) {}
+
+CgroupFileCache::~CgroupFileCache() {}
+
+bool CgroupFileCache::IsCacheable(const string &cgroup_file) {
+  for (const char *cacheable_file : kCacheableFiles) {
+    if (cgroup_file == cacheable_file) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+StatusOr<string> CgroupFileCache::Read(const string &file_path) {
+  // A cached file descriptor goes stale when its cgroup is removed (and
+  // possibly re-created under the same name). Retry once with a fresh one.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    shared_ptr<OpenFile> open_file = RETURN_IF_ERROR(GetOpenFile(file_path));
+
+    string output;
+    const int error = ReadAll(*open_file, &output);
+    if (error == 0) {
+      return output;
+    } else if (error != ENODEV && error != ESTALE) {
+      return Status(::util::error::FAILED_PRECONDITION,
+                    Substitute("Failed to read contents of file \"$0\" with "
+                               "error \"$1\"",
+                               file_path, StrError(error)));
+    }
+
+    Evict(file_path, open_file);
+  }
+
+  return Status(::util::error::NOT_FOUND,
+                Substitute("File \"$0\" not found", file_path));
+}
+
+void CgroupFileCache::Invalidate(const string &cgroup_path) {
+  string prefix = cgroup_path;
+  if (prefix.empty() || prefix.back() != '/') {
+    prefix.push_back('/');
+  }
+
+  MutexLock l(&lock_);
+  auto it = files_.lower_bound(prefix);
+  while (it != files_.end() && StringPiece(it->first).starts_with(prefix)) {
+    it = EraseLocked(it);
+    ++invalidations_;
+  }
+}
+
+int64 CgroupFileCache::hits() const {
+  MutexLock l(&lock_);
+  return hits_;
+}
+
+int64 CgroupFileCache::misses() const {
+  MutexLock l(&lock_);
+  return misses_;
+}
+
+int64 CgroupFileCache::invalidations() const {
+  MutexLock l(&lock_);
+  return invalidations_;
+}
+
+int64 CgroupFileCache::evictions() const {
+  MutexLock l(&lock_);
+  return evictions_;
+}
+
+size_t CgroupFileCache::Size() const {
+  MutexLock l(&lock_);
+  return files_.size();
+}
+
+StatusOr<shared_ptr<CgroupFileCache::OpenFile>> CgroupFileCache::GetOpenFile(
+    const string &file_path) {
+  {
+    MutexLock l(&lock_);
+    auto it = files_.find(file_path);
+    if (it != files_.end()) {
+      ++hits_;
+      lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+      return it->second.open_file;
+    }
+    ++misses_;
+  }
+
+  // Open outside of the lock so that other reads are not held up.
+  const int fd = kernel_->Open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return Status(::util::error::NOT_FOUND,
+                    Substitute("File \"$0\" not found", file_path));
+    }
+    return Status(::util::error::FAILED_PRECONDITION,
+                  Substitute("Failed to open file \"$0\" with error \"$1\"",
+                             file_path, StrError(errno)));
+  }
+  shared_ptr<OpenFile> open_file(new OpenFile(kernel_, fd));
+
+  // If another reader raced us to open the same file, use theirs and close
+  // ours.
+  MutexLock l(&lock_);
+  auto it = files_.find(file_path);
+  if (it != files_.end()) {
+    return it->second.open_file;
+  }
+  if (max_open_files_ == 0) {
+    return open_file;
+  }
+
+  // Make room by closing the least recently read file.
+  if (files_.size() >= max_open_files_) {
+    EraseLocked(files_.find(lru_.back()));
+    ++evictions_;
+  }
+  lru_.push_front(file_path);
+  files_[file_path] = {open_file, lru_.begin()};
+  return open_file;
+}
+
+void CgroupFileCache::Evict(const string &file_path,
+                            const shared_ptr<OpenFile> &open_file) {
+  MutexLock l(&lock_);
+  auto it = files_.find(file_path);
+  if (it != files_.end() && it->second.open_file == open_file) {
+    EraseLocked(it);
+    ++invalidations_;
+  }
+}
+
+CgroupFileCache::FileMap::iterator CgroupFileCache::EraseLocked(
+    FileMap::iterator it) {
+  lru_.erase(it->second.lru_position);
+  return files_.erase(it);
+}
+
+int CgroupFileCache::ReadAll(const OpenFile &open_file, string *output) const {
+  char buffer[kReadBufferSize];
+  off_t offset = 0;
+  while (true) {
+    const ssize_t bytes_read =
+        kernel_->Pread(open_file.fd(), buffer, sizeof(buffer), offset);
+    if (bytes_read < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    } else if (bytes_read == 0) {
+      return 0;
+    }
+
+    output->append(buffer, bytes_read);
+    offset += bytes_read;
+  }
+}
+
+}  // namespace lmctfy
+}  // namespace containers
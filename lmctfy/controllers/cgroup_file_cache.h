@@ -0,0 +1,154 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_CONTROLLERS_CGROUP_FILE_CACHE_H_
+#define SRC_CONTROLLERS_CGROUP_FILE_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+using ::std::string;
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "system_api/kernel_api.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace lmctfy {
+
+typedef ::system_api::KernelAPI KernelApi;
+
+// Cache of open file descriptors for frequently read cgroup files.
+//
+// Reading a cgroup file normally costs an access(), open(), read() and close().
+// For the handful of statistics files that are polled constantly (e.g.:
+// memory.usage_in_bytes, memory.stat, cpuacct.usage) this cache keeps the file
+// open and reads it with pread() from offset 0 instead.
+//
+// Entries are dropped when a read reports that the underlying cgroup is gone
+// (ENODEV or ESTALE) and when the cgroup is explicitly invalidated (i.e.: on
+// cgroup removal). At most max_open_files are kept open. When the cache is full
+// the least recently read file is closed to make room, so the descriptors of
+// cgroups removed by other processes (which pin the dying cgroup in the kernel)
+// are eventually released even if they are never read again.
+//
+// Class is thread-safe.
+class CgroupFileCache {
+ public:
+  // Does not take ownership of kernel.
+  CgroupFileCache(const KernelApi *kernel, int max_open_files);
+  virtual ~CgroupFileCache();
+
+  // Whether the specified cgroup file (e.g.: "memory.stat") is one whose file
+  // descriptor should be cached.
+  static bool IsCacheable(const string &cgroup_file);
+
+  // Reads the full contents of the specified file.
+  //
+  // Arguments:
+  //   file_path: Absolute path of the file to read. e.g.:
+  //       /dev/cgroup/memory/test/memory.stat
+  // Return:
+  //   StatusOr<string>: Status of the operation. Iff OK, the contents of the
+  //       file. NOT_FOUND is returned if the file does not exist and
+  //       FAILED_PRECONDITION if it can't be opened or read for any other
+  //       reason (e.g.: no file descriptors left).
+  virtual ::util::StatusOr<string> Read(const string &file_path)
+      LOCKS_EXCLUDED(lock_);
+
+  // Closes and forgets all cached files in the specified cgroup and its
+  // children. This should be called when the cgroup is removed.
+  //
+  // Arguments:
+  //   cgroup_path: Absolute path of the cgroup. e.g.: /dev/cgroup/memory/test
+  virtual void Invalidate(const string &cgroup_path) LOCKS_EXCLUDED(lock_);
+
+  // Number of reads served from an already open file descriptor.
+  int64 hits() const LOCKS_EXCLUDED(lock_);
+
+  // Number of reads that had to open the file.
+  int64 misses() const LOCKS_EXCLUDED(lock_);
+
+  // Number of cached file descriptors that were dropped because their cgroup
+  // went away.
+  int64 invalidations() const LOCKS_EXCLUDED(lock_);
+
+  // Number of cached file descriptors that were closed to make room for
+  // another file.
+  int64 evictions() const LOCKS_EXCLUDED(lock_);
+
+  // Number of file descriptors currently cached.
+  size_t Size() const LOCKS_EXCLUDED(lock_);
+
+ private:
+  class OpenFile;
+
+  // A cached file and its position in the recently used list.
+  struct Entry {
+    ::std::shared_ptr<OpenFile> open_file;
+    ::std::list<string>::iterator lru_position;
+  };
+  typedef ::std::map<string, Entry> FileMap;
+
+  // Gets the open file for file_path, opening it if it is not cached.
+  ::util::StatusOr< ::std::shared_ptr<OpenFile>> GetOpenFile(
+      const string &file_path) LOCKS_EXCLUDED(lock_);
+
+  // Drops open_file from the cache if it is still the cached entry for
+  // file_path.
+  void Evict(const string &file_path,
+             const ::std::shared_ptr<OpenFile> &open_file)
+      LOCKS_EXCLUDED(lock_);
+
+  // Removes the entry from the cache, closing its file once no read is using
+  // it. Returns the entry following it.
+  FileMap::iterator EraseLocked(FileMap::iterator it)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads all of the contents of the open file into output. Returns the errno
+  // of the failed read, or 0 on success.
+  int ReadAll(const OpenFile &open_file, string *output) const;
+
+  // Wrapper for all calls to the kernel.
+  const KernelApi *kernel_;
+
+  // Maximum number of file descriptors to keep open.
+  const size_t max_open_files_;
+
+  // Map of absolute file path to its open file. Files are shared so that a
+  // read can proceed outside of the lock while the entry is being evicted.
+  FileMap files_ GUARDED_BY(lock_);
+
+  // Paths of the cached files, most recently read first.
+  ::std::list<string> lru_ GUARDED_BY(lock_);
+
+  int64 hits_ GUARDED_BY(lock_);
+  int64 misses_ GUARDED_BY(lock_);
+  int64 invalidations_ GUARDED_BY(lock_);
+  int64 evictions_ GUARDED_BY(lock_);
+
+  // Lock for the cached files and the counters.
+  mutable Mutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(CgroupFileCache);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_CONTROLLERS_CGROUP_FILE_CACHE_H_
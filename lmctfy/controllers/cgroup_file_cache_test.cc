@@ -0,0 +1,273 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/cgroup_file_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "system_api/kernel_api_mock.h"
+#include "util/errors_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+
+using ::system_api::KernelAPIMock;
+using ::std::min;
+using ::std::unique_ptr;
+using ::testing::InSequence;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetErrnoAndReturn;
+using ::testing::StrEq;
+using ::testing::StrictMock;
+using ::testing::_;
+using ::util::StatusOr;
+using ::util::error::FAILED_PRECONDITION;
+using ::util::error::NOT_FOUND;
+
+namespace containers {
+namespace lmctfy {
+
+static const char kCgroupPath[] = "/dev/cgroup/memory/test";
+static const char kUsagePath[] =
+    "/dev/cgroup/memory/test/memory.usage_in_bytes";
+static const char kStatPath[] = "/dev/cgroup/memory/test/memory.stat";
+static const char kChildStatPath[] =
+    "/dev/cgroup/memory/test/sub/memory.stat";
+static const char kSiblingStatPath[] =
+    "/dev/cgroup/memory/test2/memory.stat";
+static const int kFd = 42;
+static const int kMaxOpenFiles = 10;
+
+class CgroupFileCacheTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    mock_kernel_.reset(new StrictMock<KernelAPIMock>());
+    cache_.reset(new CgroupFileCache(mock_kernel_.get(), kMaxOpenFiles));
+  }
+
+  void TearDown() override {
+    // Cached files are closed on destruction.
+    EXPECT_CALL(*mock_kernel_, Close(_)).WillRepeatedly(Return(0));
+    cache_.reset();
+  }
+
+  // Expect the file at path to be opened, returning fd.
+  void ExpectOpen(const string &path, int fd) {
+    EXPECT_CALL(*mock_kernel_, Open(StrEq(path), O_RDONLY | O_CLOEXEC))
+        .WillOnce(Return(fd));
+  }
+
+  // Expect pread()s on fd to return contents.
+  void ExpectPread(int fd, const string &contents) {
+    EXPECT_CALL(*mock_kernel_, Pread(fd, _, _, _))
+        .WillRepeatedly(Invoke([contents](int fd, void *buf, size_t count,
+                                          off_t offset) -> ssize_t {
+          if (static_cast<size_t>(offset) >= contents.size()) {
+            return 0;
+          }
+          const size_t bytes = min(count, contents.size() - offset);
+          memcpy(buf, contents.data() + offset, bytes);
+          return bytes;
+        }));
+  }
+
+ protected:
+  unique_ptr<KernelAPIMock> mock_kernel_;
+  unique_ptr<CgroupFileCache> cache_;
+};
+
+TEST_F(CgroupFileCacheTest, IsCacheable) {
+  EXPECT_TRUE(CgroupFileCache::IsCacheable("memory.usage_in_bytes"));
+  EXPECT_TRUE(CgroupFileCache::IsCacheable("memory.stat"));
+  EXPECT_TRUE(CgroupFileCache::IsCacheable("cpuacct.usage"));
+  EXPECT_TRUE(CgroupFileCache::IsCacheable("cpu.stat"));
+  EXPECT_FALSE(CgroupFileCache::IsCacheable("memory.limit_in_bytes"));
+  EXPECT_FALSE(CgroupFileCache::IsCacheable("tasks"));
+}
+
+TEST_F(CgroupFileCacheTest, ReadMissThenHit) {
+  ExpectOpen(kUsagePath, kFd);
+  ExpectPread(kFd, "1024\n");
+
+  StatusOr<string> statusor = cache_->Read(kUsagePath);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("1024\n", statusor.ValueOrDie());
+
+  // The second read does not open the file again.
+  statusor = cache_->Read(kUsagePath);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("1024\n", statusor.ValueOrDie());
+
+  EXPECT_EQ(1, cache_->misses());
+  EXPECT_EQ(1, cache_->hits());
+  EXPECT_EQ(1, cache_->Size());
+}
+
+TEST_F(CgroupFileCacheTest, ReadLargerThanBuffer) {
+  const string kContents(10000, 'a');
+  ExpectOpen(kStatPath, kFd);
+  ExpectPread(kFd, kContents);
+
+  StatusOr<string> statusor = cache_->Read(kStatPath);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(kContents, statusor.ValueOrDie());
+}
+
+TEST_F(CgroupFileCacheTest, ReadFileNotFound) {
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kUsagePath), _))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, cache_->Read(kUsagePath));
+  EXPECT_EQ(0, cache_->Size());
+}
+
+TEST_F(CgroupFileCacheTest, ReadOpenFails) {
+  // Running out of file descriptors is not a missing file.
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kUsagePath), _))
+      .WillOnce(SetErrnoAndReturn(EMFILE, -1));
+
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION, cache_->Read(kUsagePath));
+  EXPECT_EQ(0, cache_->Size());
+}
+
+TEST_F(CgroupFileCacheTest, ReadFails) {
+  ExpectOpen(kUsagePath, kFd);
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, _, _, 0))
+      .WillOnce(SetErrnoAndReturn(EIO, -1));
+
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION, cache_->Read(kUsagePath));
+
+  // The file stays cached.
+  EXPECT_EQ(1, cache_->Size());
+}
+
+TEST_F(CgroupFileCacheTest, ReadStaleFileIsReopened) {
+  const int kNewFd = kFd + 1;
+
+  // The cgroup was removed and re-created, the first fd reports ENODEV.
+  InSequence sequence;
+  ExpectOpen(kUsagePath, kFd);
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, _, _, 0))
+      .WillOnce(SetErrnoAndReturn(ENODEV, -1));
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+  ExpectOpen(kUsagePath, kNewFd);
+  ExpectPread(kNewFd, "1024\n");
+
+  StatusOr<string> statusor = cache_->Read(kUsagePath);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("1024\n", statusor.ValueOrDie());
+  EXPECT_EQ(1, cache_->invalidations());
+  EXPECT_EQ(1, cache_->Size());
+}
+
+TEST_F(CgroupFileCacheTest, ReadCgroupRemoved) {
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kUsagePath), _))
+      .WillOnce(Return(kFd))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
+  EXPECT_CALL(*mock_kernel_, Pread(kFd, _, _, 0))
+      .WillOnce(SetErrnoAndReturn(ESTALE, -1));
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, cache_->Read(kUsagePath));
+  EXPECT_EQ(0, cache_->Size());
+}
+
+TEST_F(CgroupFileCacheTest, ReadCacheFullEvictsLeastRecentlyUsed) {
+  cache_.reset(new CgroupFileCache(mock_kernel_.get(), 1));
+
+  ExpectOpen(kUsagePath, kFd);
+  ExpectPread(kFd, "1024\n");
+  ASSERT_OK(cache_->Read(kUsagePath));
+
+  // No more room, the least recently read file is closed to make space.
+  const int kOtherFd = kFd + 1;
+  ExpectOpen(kStatPath, kOtherFd);
+  ExpectPread(kOtherFd, "cache 0\n");
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+
+  StatusOr<string> statusor = cache_->Read(kStatPath);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("cache 0\n", statusor.ValueOrDie());
+  EXPECT_EQ(1, cache_->Size());
+  EXPECT_EQ(1, cache_->evictions());
+
+  // The new file stays cached.
+  ASSERT_OK(cache_->Read(kStatPath));
+  EXPECT_EQ(1, cache_->hits());
+}
+
+TEST_F(CgroupFileCacheTest, ReadRefreshesRecency) {
+  cache_.reset(new CgroupFileCache(mock_kernel_.get(), 2));
+
+  ExpectOpen(kUsagePath, kFd);
+  ExpectPread(kFd, "");
+  ExpectOpen(kStatPath, kFd + 1);
+  ExpectPread(kFd + 1, "");
+  ASSERT_OK(cache_->Read(kUsagePath));
+  ASSERT_OK(cache_->Read(kStatPath));
+
+  // Reading the usage file again makes the stat file the least recently used.
+  ASSERT_OK(cache_->Read(kUsagePath));
+
+  ExpectOpen(kChildStatPath, kFd + 2);
+  ExpectPread(kFd + 2, "");
+  EXPECT_CALL(*mock_kernel_, Close(kFd + 1)).WillOnce(Return(0));
+  ASSERT_OK(cache_->Read(kChildStatPath));
+
+  EXPECT_EQ(2, cache_->Size());
+  EXPECT_EQ(1, cache_->evictions());
+}
+
+TEST_F(CgroupFileCacheTest, ReadCacheDisabled) {
+  cache_.reset(new CgroupFileCache(mock_kernel_.get(), 0));
+
+  // The file is closed right after the read.
+  ExpectOpen(kUsagePath, kFd);
+  ExpectPread(kFd, "1024\n");
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+
+  ASSERT_OK(cache_->Read(kUsagePath));
+  EXPECT_EQ(0, cache_->Size());
+  EXPECT_EQ(0, cache_->evictions());
+}
+
+TEST_F(CgroupFileCacheTest, Invalidate) {
+  ExpectOpen(kStatPath, kFd);
+  ExpectPread(kFd, "");
+  ExpectOpen(kChildStatPath, kFd + 1);
+  ExpectPread(kFd + 1, "");
+  ExpectOpen(kSiblingStatPath, kFd + 2);
+  ExpectPread(kFd + 2, "");
+  ASSERT_OK(cache_->Read(kStatPath));
+  ASSERT_OK(cache_->Read(kChildStatPath));
+  ASSERT_OK(cache_->Read(kSiblingStatPath));
+  ASSERT_EQ(3, cache_->Size());
+
+  // Only the cgroup and its children are closed.
+  EXPECT_CALL(*mock_kernel_, Close(kFd)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, Close(kFd + 1)).WillOnce(Return(0));
+  cache_->Invalidate(kCgroupPath);
+
+  EXPECT_EQ(1, cache_->Size());
+  EXPECT_EQ(2, cache_->invalidations());
+}
+
+}  // namespace lmctfy
+}  // namespace containers
@@ -0,0 +1,390 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/cgroup_tree_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "base/logging.h"
+#include "file/base/path.h"
+#include "global_utils/fs_utils.h"
+#include "system_api/libc_fs_api.h"
+#include "util/errors.h"
+#include "strings/stringpiece.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+#include "util/task/status.h"
+
+using ::file::JoinPath;
+using ::std::set;
+using ::std::vector;
+using ::strings::Substitute;
+using ::system_api::GlobalLibcFsApi;
+using ::util::GlobalFsUtils;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+// Size of the buffer inotify events are read into.
+static const int kReadBufferSize = 16384;
+
+// Events that change the subdirectories of a watched directory, or the watched
+// directory itself.
+static const uint32 kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                 IN_ONLYDIR;
+
+// Opens the directory at path, or the entry name of the directory dirfd if
+// name is not null.
+static StatusOr<int> OpenDirectory(int dirfd, const char *name,
+                                   const string &path) {
+  const int fd =
+      name == nullptr
+          ? GlobalLibcFsApi()->Open(path.c_str(),
+                                    O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+          : GlobalLibcFsApi()->OpenAt(dirfd, name,
+                                      O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return Status(::util::error::NOT_FOUND,
+                    Substitute("Directory \"$0\" not found", path));
+    }
+    return Status(::util::error::FAILED_PRECONDITION,
+                  Substitute("Unable to open directory \"$0\" with error "
+                             "\"$1\"",
+                             path, StrError(errno)));
+  }
+  return fd;
+}
+
+CgroupTreeIndex::CgroupTreeIndex(const KernelApi *kernel)
+    : kernel_(CHECK_NOTNULL(kernel)),
+      inotify_fd_(-1),
+      watching_started_(false),
+      directory_reads_(0),
+      watch_failure_logged_(false) {}
+
+CgroupTreeIndex::~CgroupTreeIndex() {
+  if (inotify_fd_ >= 0) {
+    kernel_->Close(inotify_fd_);
+  }
+}
+
+StatusOr<vector<string>> CgroupTreeIndex::ListDescendants(
+    const string &path) {
+  // Index each directory under a single path.
+  string cgroup_path = path;
+  while (cgroup_path.size() > 1 && cgroup_path.back() == '/') {
+    cgroup_path.pop_back();
+  }
+
+  MutexLock l(&lock_);
+  StartWatching();
+  ApplyEvents();
+
+  if (directories_.find(cgroup_path) == directories_.end()) {
+    const int fd =
+        RETURN_IF_ERROR(OpenDirectory(-1, nullptr, cgroup_path));
+    Status status = IndexDirectory(fd, cgroup_path);
+    GlobalLibcFsApi()->Close(fd);
+    if (!status.ok()) {
+      Forget(cgroup_path);
+      return status;
+    }
+  }
+
+  vector<string> descendants;
+  Status status = AppendDescendants(cgroup_path, "", &descendants);
+  if (!status.ok()) {
+    Forget(cgroup_path);
+    return status;
+  }
+
+  sort(descendants.begin(), descendants.end());
+  return descendants;
+}
+
+int64 CgroupTreeIndex::directory_reads() const {
+  MutexLock l(&lock_);
+  return directory_reads_;
+}
+
+size_t CgroupTreeIndex::Size() const {
+  MutexLock l(&lock_);
+  return directories_.size();
+}
+
+void CgroupTreeIndex::StartWatching() {
+  if (watching_started_) {
+    return;
+  }
+  watching_started_ = true;
+
+  inotify_fd_ = kernel_->InotifyInit1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    LOG(WARNING) << "Failed to create an inotify instance, cgroup directories "
+                 << "will be read on every listing: " << StrError(errno);
+  }
+}
+
+void CgroupTreeIndex::ApplyEvents() {
+  if (inotify_fd_ < 0) {
+    return;
+  }
+
+  char buffer[kReadBufferSize]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  while (true) {
+    const ssize_t bytes_read =
+        kernel_->Read(inotify_fd_, buffer, sizeof(buffer));
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_read < 0 && errno != EAGAIN) {
+      // Events may have been lost.
+      LOG(WARNING) << "Failed to read cgroup directory events: "
+                   << StrError(errno);
+      for (auto &path_directory_pair : directories_) {
+        path_directory_pair.second.stale = true;
+      }
+    }
+    if (bytes_read <= 0) {
+      return;
+    }
+
+    for (ssize_t offset = 0; offset < bytes_read;) {
+      const struct inotify_event *event =
+          reinterpret_cast<const struct inotify_event *>(buffer + offset);
+      offset += sizeof(*event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        for (auto &path_directory_pair : directories_) {
+          path_directory_pair.second.stale = true;
+        }
+        continue;
+      }
+
+      auto watched_it = watched_paths_.find(event->wd);
+      if (watched_it == watched_paths_.end()) {
+        continue;
+      }
+      const string path = watched_it->second;
+
+      // The watched directory itself was removed or renamed, what is at its
+      // path now is indexed again when listed.
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+        Forget(path);
+        continue;
+      }
+
+      if (event->mask & IN_ISDIR) {
+        auto it = directories_.find(path);
+        if (it != directories_.end()) {
+          it->second.stale = true;
+        }
+      }
+    }
+  }
+}
+
+Status CgroupTreeIndex::IndexDirectory(int fd, const string &path) {
+  // Watch before reading so that no change is missed.
+  Directory &directory = directories_[path];
+  directory.wd = Watch(path);
+  directory.stale = directory.wd < 0;
+  directory.subdirectories.clear();
+  RETURN_IF_ERROR(ReadSubdirectories(fd, path, &directory.subdirectories));
+
+  const set<string> subdirectories = directory.subdirectories;
+  for (const string &name : subdirectories) {
+    const string subdirectory_path = JoinPath(path, name);
+    if (directories_.find(subdirectory_path) != directories_.end()) {
+      continue;
+    }
+
+    StatusOr<int> statusor = OpenDirectory(fd, name.c_str(), subdirectory_path);
+    if (!statusor.ok()) {
+      // Removed since it was read.
+      if (statusor.status().error_code() == ::util::error::NOT_FOUND) {
+        directories_[path].subdirectories.erase(name);
+        continue;
+      }
+      return statusor.status();
+    }
+
+    Status status = IndexDirectory(statusor.ValueOrDie(), subdirectory_path);
+    GlobalLibcFsApi()->Close(statusor.ValueOrDie());
+    RETURN_IF_ERROR(status);
+  }
+
+  return Status::OK;
+}
+
+Status CgroupTreeIndex::Refresh(const string &path, Directory *directory) {
+  const int fd = RETURN_IF_ERROR(OpenDirectory(-1, nullptr, path));
+  set<string> subdirectories;
+  Status status = ReadSubdirectories(fd, path, &subdirectories);
+  if (!status.ok()) {
+    GlobalLibcFsApi()->Close(fd);
+    return status;
+  }
+  directory->stale = directory->wd < 0;
+
+  for (const string &name : directory->subdirectories) {
+    if (subdirectories.find(name) == subdirectories.end()) {
+      Forget(JoinPath(path, name));
+    }
+  }
+  directory->subdirectories = subdirectories;
+
+  for (const string &name : subdirectories) {
+    const string subdirectory_path = JoinPath(path, name);
+    if (directories_.find(subdirectory_path) != directories_.end()) {
+      continue;
+    }
+
+    StatusOr<int> statusor = OpenDirectory(fd, name.c_str(), subdirectory_path);
+    if (!statusor.ok()) {
+      if (statusor.status().error_code() == ::util::error::NOT_FOUND) {
+        directory->subdirectories.erase(name);
+        continue;
+      }
+      status = statusor.status();
+      break;
+    }
+
+    status = IndexDirectory(statusor.ValueOrDie(), subdirectory_path);
+    GlobalLibcFsApi()->Close(statusor.ValueOrDie());
+    if (!status.ok()) {
+      Forget(subdirectory_path);
+      break;
+    }
+  }
+
+  GlobalLibcFsApi()->Close(fd);
+  if (!status.ok()) {
+    // Read it again on the next listing.
+    directory->stale = true;
+  }
+  return status;
+}
+
+Status CgroupTreeIndex::AppendDescendants(const string &path,
+                                          const string &relative_path,
+                                          vector<string> *descendants) {
+  auto it = directories_.find(path);
+  if (it == directories_.end()) {
+    return Status::OK;
+  }
+
+  Directory *directory = &it->second;
+  if (directory->stale) {
+    Status status = Refresh(path, directory);
+    if (!status.ok()) {
+      // A subdirectory removed since its parent was read is skipped.
+      if (status.error_code() == ::util::error::NOT_FOUND &&
+          !relative_path.empty()) {
+        Forget(path);
+        return Status::OK;
+      }
+      return status;
+    }
+  }
+
+  if (!relative_path.empty()) {
+    descendants->push_back(relative_path);
+  }
+
+  // Refreshing subdirectories may forget some, iterate over a copy.
+  const set<string> subdirectories = directory->subdirectories;
+  for (const string &name : subdirectories) {
+    RETURN_IF_ERROR(AppendDescendants(
+        JoinPath(path, name),
+        relative_path.empty() ? name : JoinPath(relative_path, name),
+        descendants));
+  }
+
+  return Status::OK;
+}
+
+Status CgroupTreeIndex::ReadSubdirectories(int fd, const string &path,
+                                           set<string> *subdirectories) {
+  ++directory_reads_;
+
+  const vector<string> names =
+      RETURN_IF_ERROR(GlobalFsUtils()->ListSubdirectoriesAt(fd, path));
+  subdirectories->insert(names.begin(), names.end());
+  return Status::OK;
+}
+
+int CgroupTreeIndex::Watch(const string &path) {
+  if (inotify_fd_ < 0) {
+    return -1;
+  }
+
+  const int wd =
+      kernel_->InotifyAddWatch(inotify_fd_, path.c_str(), kWatchMask);
+  if (wd < 0) {
+    if (!watch_failure_logged_) {
+      LOG(WARNING) << "Failed to watch cgroup directory \"" << path
+                   << "\", it will be read on every listing: "
+                   << StrError(errno);
+      watch_failure_logged_ = true;
+    }
+    return -1;
+  }
+
+  // The same directory reached through another path shares the watch, that
+  // path is not watched.
+  auto it = watched_paths_.find(wd);
+  if (it != watched_paths_.end() && it->second != path) {
+    return -1;
+  }
+
+  watched_paths_[wd] = path;
+  return wd;
+}
+
+void CgroupTreeIndex::Forget(const string &path) {
+  auto forget = [this](::std::map<string, Directory>::iterator it) {
+    if (it->second.wd >= 0) {
+      // The watch is already gone if the directory was removed.
+      kernel_->InotifyRmWatch(inotify_fd_, it->second.wd);
+      watched_paths_.erase(it->second.wd);
+    }
+    return directories_.erase(it);
+  };
+
+  auto it = directories_.find(path);
+  if (it != directories_.end()) {
+    forget(it);
+  }
+
+  const string prefix = path + "/";
+  it = directories_.lower_bound(prefix);
+  while (it != directories_.end() &&
+         StringPiece(it->first).starts_with(prefix)) {
+    it = forget(it);
+  }
+}
+
+}  // namespace lmctfy
+}  // namespace containers
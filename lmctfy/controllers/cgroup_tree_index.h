@@ -0,0 +1,155 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_CONTROLLERS_CGROUP_TREE_INDEX_H_
+#define SRC_CONTROLLERS_CGROUP_TREE_INDEX_H_
+
+#include <map>
+#include <set>
+#include <string>
+using ::std::string;
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "system_api/kernel_api.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace lmctfy {
+
+typedef ::system_api::KernelAPI KernelApi;
+
+// In-memory index of the directories of cgroup hierarchies, used to answer
+// recursive listings without walking the hierarchy every time.
+//
+// A subtree is indexed the first time it is listed, in a single walk that reads
+// each directory with FsUtils::ListSubdirectoriesAt() relative to its parent.
+// Every indexed directory is watched with inotify, and the pending events are
+// applied before each listing: the directories that had subdirectories
+// created, removed or renamed are read again, the rest are served from the
+// index. Directory mtimes can't be used instead since cgroupfs
+// does not update them.
+//
+// The inotify instance is only created by the first listing. If it or a watch
+// can't be created (e.g.: the watch limit was reached) the affected
+// directories are read on every listing.
+//
+// The index only pays off in long-lived processes that list the same subtrees
+// again, it is enabled with --lmctfy_cgroup_tree_index.
+//
+// Class is thread-safe.
+class CgroupTreeIndex {
+ public:
+  // Does not take ownership of kernel.
+  explicit CgroupTreeIndex(const KernelApi *kernel);
+  virtual ~CgroupTreeIndex();
+
+  // Lists all directories under the specified directory, recursively.
+  //
+  // Arguments:
+  //   cgroup_path: Absolute path of the cgroup. e.g.: /dev/cgroup/memory/test
+  // Return:
+  //   StatusOr<vector<string>>: Status of the operation. Iff OK, the paths of
+  //       the directories relative to cgroup_path (e.g.: "sub", "sub/subsub"),
+  //       sorted. NOT_FOUND if cgroup_path does not exist.
+  virtual ::util::StatusOr< ::std::vector<string>> ListDescendants(
+      const string &cgroup_path) LOCKS_EXCLUDED(lock_);
+
+  // Number of directories read since the index was created.
+  int64 directory_reads() const LOCKS_EXCLUDED(lock_);
+
+  // Number of directories currently indexed.
+  size_t Size() const LOCKS_EXCLUDED(lock_);
+
+ private:
+  // An indexed directory.
+  struct Directory {
+    // Names of the subdirectories.
+    ::std::set<string> subdirectories;
+
+    // inotify watch on the directory, -1 if it is not watched.
+    int wd;
+
+    // Whether the subdirectories must be read again.
+    bool stale;
+  };
+
+  // Creates the inotify instance, unless it was already attempted.
+  void StartWatching() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads the pending inotify events and marks the directories they happened
+  // in as stale.
+  void ApplyEvents() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Indexes the directory at path, whose file descriptor is fd, and all of its
+  // subdirectories. Does not take ownership of fd.
+  ::util::Status IndexDirectory(int fd, const string &path)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads the subdirectories of the stale directory at path again, indexing
+  // new ones and forgetting removed ones.
+  ::util::Status Refresh(const string &path, Directory *directory)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Appends the descendants of the indexed directory at path to descendants,
+  // relative_path is prepended to each. Stale directories are refreshed.
+  ::util::Status AppendDescendants(const string &path,
+                                   const string &relative_path,
+                                   ::std::vector<string> *descendants)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads the names of the subdirectories of the directory fd.
+  ::util::Status ReadSubdirectories(int fd, const string &path,
+                                    ::std::set<string> *subdirectories)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Starts watching the directory at path. Returns the watch, or -1 if it
+  // can't be watched.
+  int Watch(const string &path) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Forgets the directory at path and all of its subdirectories.
+  void Forget(const string &path) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Wrapper for all calls to the kernel.
+  const KernelApi *kernel_;
+
+  // inotify instance, -1 if directories are not watched.
+  int inotify_fd_ GUARDED_BY(lock_);
+
+  // Whether the inotify instance was created, or failed to be.
+  bool watching_started_ GUARDED_BY(lock_);
+
+  // Map of absolute path to indexed directory.
+  ::std::map<string, Directory> directories_ GUARDED_BY(lock_);
+
+  // Map of inotify watch to the absolute path of the watched directory.
+  ::std::map<int, string> watched_paths_ GUARDED_BY(lock_);
+
+  int64 directory_reads_ GUARDED_BY(lock_);
+
+  // Whether a failure to watch a directory was logged.
+  bool watch_failure_logged_ GUARDED_BY(lock_);
+
+  mutable Mutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(CgroupTreeIndex);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_CONTROLLERS_CGROUP_TREE_INDEX_H_
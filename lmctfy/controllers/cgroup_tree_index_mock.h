@@ -0,0 +1,47 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_CONTROLLERS_CGROUP_TREE_INDEX_MOCK_H_
+#define SRC_CONTROLLERS_CGROUP_TREE_INDEX_MOCK_H_
+
+#include "lmctfy/controllers/cgroup_tree_index.h"
+
+#include "system_api/kernel_api_mock.h"
+#include "gmock/gmock.h"
+
+namespace containers {
+namespace lmctfy {
+
+class MockCgroupTreeIndex : public CgroupTreeIndex {
+ public:
+  MockCgroupTreeIndex() : CgroupTreeIndex(UnusedKernel()) {}
+
+  MOCK_METHOD1(ListDescendants, ::util::StatusOr< ::std::vector<string>>(
+                                    const string &cgroup_path));
+
+ private:
+  // The mocked listing never reaches the kernel.
+  static const KernelApi *UnusedKernel() {
+    static const KernelApi *kernel =
+        new ::testing::StrictMock< ::system_api::KernelAPIMock>();
+    return kernel;
+  }
+};
+
+typedef ::testing::StrictMock<MockCgroupTreeIndex> StrictMockCgroupTreeIndex;
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_CONTROLLERS_CGROUP_TREE_INDEX_MOCK_H_
@@ -0,0 +1,226 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/cgroup_tree_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "base/logging.h"
+#include "file/base/path.h"
+#include "system_api/kernel_api.h"
+#include "system_api/kernel_api_mock.h"
+#include "util/errors.h"
+#include "util/errors_test_util.h"
+#include "strings/substitute.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+
+using ::file::JoinPath;
+using ::system_api::KernelAPI;
+using ::system_api::KernelAPIMock;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::testing::Return;
+using ::testing::SetErrnoAndReturn;
+using ::testing::StrictMock;
+using ::testing::_;
+using ::util::StatusOr;
+
+DECLARE_string(test_tmpdir);
+
+namespace containers {
+namespace lmctfy {
+namespace {
+
+class CgroupTreeIndexTest : public ::testing::Test {
+ protected:
+  CgroupTreeIndexTest()
+      : test_dir_(JoinPath(FLAGS_test_tmpdir, "cgroup_tree_index_test")) {}
+
+  void SetUp() override {
+    MakeDirectory("");
+    index_.reset(new CgroupTreeIndex(&kernel_));
+  }
+
+  void TearDown() override {
+    index_.reset();
+    CHECK_EQ(0, system(Substitute("rm -rf $0", test_dir_).c_str()));
+  }
+
+  // Path of the directory relative to the test directory.
+  string Path(const string &relative_path) const {
+    return JoinPath(test_dir_, relative_path);
+  }
+
+  void MakeDirectory(const string &relative_path) {
+    CHECK_EQ(0, mkdir(Path(relative_path).c_str(), 0755))
+        << Substitute("Test failed to mkdir at '$0' with error '$1'",
+                      Path(relative_path), StrError(errno));
+  }
+
+  void RemoveDirectory(const string &relative_path) {
+    CHECK_EQ(0, rmdir(Path(relative_path).c_str()))
+        << Substitute("Test failed to rmdir at '$0' with error '$1'",
+                      Path(relative_path), StrError(errno));
+  }
+
+  void MakeFile(const string &relative_path) {
+    const int fd = open(Path(relative_path).c_str(), O_CREAT | O_WRONLY, 0644);
+    CHECK_LE(0, fd) << Substitute("Test failed to create '$0' with error '$1'",
+                                  Path(relative_path), StrError(errno));
+    close(fd);
+  }
+
+  vector<string> ListDescendants() {
+    StatusOr<vector<string>> statusor = index_->ListDescendants(test_dir_);
+    CHECK(statusor.ok()) << statusor.status().ToString();
+    return statusor.ValueOrDie();
+  }
+
+  const string test_dir_;
+  const KernelAPI kernel_;
+  unique_ptr<CgroupTreeIndex> index_;
+};
+
+TEST_F(CgroupTreeIndexTest, ListsDescendantsSorted) {
+  MakeDirectory("b");
+  MakeDirectory("a");
+  MakeDirectory("a/sub");
+  MakeDirectory("a/sub/subsub");
+
+  EXPECT_EQ((vector<string>{"a", "a/sub", "a/sub/subsub", "b"}),
+            ListDescendants());
+  EXPECT_EQ(5, index_->Size());
+}
+
+TEST_F(CgroupTreeIndexTest, NoDescendants) {
+  EXPECT_TRUE(ListDescendants().empty());
+}
+
+TEST_F(CgroupTreeIndexTest, IgnoresFiles) {
+  MakeDirectory("a");
+  MakeFile("tasks");
+  MakeFile("a/tasks");
+
+  EXPECT_EQ((vector<string>{"a"}), ListDescendants());
+}
+
+TEST_F(CgroupTreeIndexTest, UnchangedTreeIsNotRead) {
+  MakeDirectory("a");
+  MakeDirectory("a/sub");
+  MakeDirectory("b");
+
+  ListDescendants();
+  const int64 reads = index_->directory_reads();
+  EXPECT_EQ(4, reads);
+
+  EXPECT_EQ((vector<string>{"a", "a/sub", "b"}), ListDescendants());
+  EXPECT_EQ(reads, index_->directory_reads());
+}
+
+TEST_F(CgroupTreeIndexTest, NewDirectoriesAreListed) {
+  MakeDirectory("a");
+  ListDescendants();
+  const int64 reads = index_->directory_reads();
+
+  MakeDirectory("a/sub");
+  MakeDirectory("a/sub/subsub");
+  EXPECT_EQ((vector<string>{"a", "a/sub", "a/sub/subsub"}), ListDescendants());
+
+  // Only the changed directory and the new ones are read.
+  EXPECT_EQ(reads + 3, index_->directory_reads());
+}
+
+TEST_F(CgroupTreeIndexTest, RemovedDirectoriesAreForgotten) {
+  MakeDirectory("a");
+  MakeDirectory("a/sub");
+  MakeDirectory("b");
+  ListDescendants();
+
+  RemoveDirectory("a/sub");
+  RemoveDirectory("b");
+  EXPECT_EQ((vector<string>{"a"}), ListDescendants());
+  EXPECT_EQ(2, index_->Size());
+}
+
+TEST_F(CgroupTreeIndexTest, RenamedDirectoriesAreListed) {
+  MakeDirectory("a");
+  MakeDirectory("a/sub");
+  ListDescendants();
+
+  ASSERT_EQ(0, rename(Path("a").c_str(), Path("b").c_str()));
+  EXPECT_EQ((vector<string>{"b", "b/sub"}), ListDescendants());
+}
+
+TEST_F(CgroupTreeIndexTest, ListsSubtree) {
+  MakeDirectory("a");
+  MakeDirectory("a/sub");
+  MakeDirectory("b");
+  ListDescendants();
+  const int64 reads = index_->directory_reads();
+
+  // The subtree is already indexed.
+  StatusOr<vector<string>> statusor = index_->ListDescendants(Path("a"));
+  ASSERT_OK(statusor);
+  EXPECT_EQ((vector<string>{"sub"}), statusor.ValueOrDie());
+  EXPECT_EQ(reads, index_->directory_reads());
+}
+
+TEST_F(CgroupTreeIndexTest, RemovedRoot) {
+  MakeDirectory("a");
+  ASSERT_OK(index_->ListDescendants(Path("a")));
+
+  RemoveDirectory("a");
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    index_->ListDescendants(Path("a")));
+  EXPECT_EQ(0, index_->Size());
+}
+
+TEST_F(CgroupTreeIndexTest, NotFound) {
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    index_->ListDescendants(Path("missing")));
+  EXPECT_EQ(0, index_->Size());
+}
+
+TEST_F(CgroupTreeIndexTest, WatchesOnlyOnceListed) {
+  StrictMock<KernelAPIMock> mock_kernel;
+
+  // Nothing is watched until the first listing.
+  index_.reset(new CgroupTreeIndex(&mock_kernel));
+
+  EXPECT_CALL(mock_kernel, InotifyInit1(_))
+      .WillOnce(SetErrnoAndReturn(EMFILE, -1));
+  MakeDirectory("a");
+  ListDescendants();
+  const int64 reads = index_->directory_reads();
+
+  // Without inotify the directories are read on every listing, and creating
+  // the instance is not attempted again.
+  EXPECT_EQ((vector<string>{"a"}), ListDescendants());
+  EXPECT_EQ(2 * reads, index_->directory_reads());
+  index_.reset();
+}
+
+}  // namespace
+}  // namespace lmctfy
+}  // namespace containers
@@ -0,0 +1,194 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/cgroup_write_batch.h"
+
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "strings/stringpiece.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+using ::strings::Substitute;
+using ::util::Status;
+
+namespace containers {
+namespace lmctfy {
+
+// Innermost open batch of each thread.
+static __thread CgroupWriteBatch *current_batch = nullptr;
+
+// Strips the trailing newlines the kernel adds when a file is read.
+static StringPiece StripTrailingNewlines(const string &value) {
+  StringPiece stripped(value);
+  while (stripped.ends_with("\n")) {
+    stripped.remove_suffix(1);
+  }
+  return stripped;
+}
+
+CgroupWriteBatch::CgroupWriteBatch(const KernelApi *kernel)
+    : kernel_(CHECK_NOTNULL(kernel)),
+      num_skipped_(0),
+      open_(true),
+      previous_(current_batch) {
+  current_batch = this;
+}
+
+CgroupWriteBatch::~CgroupWriteBatch() {
+  Close();
+}
+
+CgroupWriteBatch *CgroupWriteBatch::Current() {
+  return current_batch;
+}
+
+void CgroupWriteBatch::Close() {
+  if (!open_) {
+    return;
+  }
+
+  CHECK_EQ(this, current_batch) << "Write batches must be closed in order";
+  current_batch = previous_;
+  open_ = false;
+}
+
+Status CgroupWriteBatch::Add(const string &file_path, const string &value) {
+  Write write;
+  write.file_path = file_path;
+  write.value = value;
+  write.restorable = false;
+
+  // A file written earlier in the batch will have the value of that write.
+  for (auto it = writes_.rbegin(); it != writes_.rend(); ++it) {
+    if (it->file_path == file_path) {
+      if (StripTrailingNewlines(it->value) == StripTrailingNewlines(value)) {
+        ++num_skipped_;
+        return Status::OK;
+      }
+      write.restorable = it->restorable;
+      write.pre_image = it->pre_image;
+      writes_.push_back(write);
+      return Status::OK;
+    }
+  }
+
+  // Diff against the contents the file was read with, if it was.
+  string current;
+  bool readable = true;
+  auto read_it = read_contents_.find(file_path);
+  if (read_it != read_contents_.end()) {
+    current = read_it->second;
+  } else {
+    readable = kernel_->ReadFileToString(file_path, &current);
+    if (readable) {
+      read_contents_[file_path] = current;
+    }
+  }
+  if (readable) {
+    const StringPiece current_value = StripTrailingNewlines(current);
+    if (current_value == StripTrailingNewlines(value)) {
+      ++num_skipped_;
+      return Status::OK;
+    }
+
+    write.restorable = !current_value.empty() &&
+                      current_value.find('\n') == StringPiece::npos;
+    write.pre_image = current_value.ToString();
+  } else if (kernel_->Access(file_path, F_OK) != 0) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("Failed to open file \"$0\"", file_path));
+  }
+
+  // Files that can't be read (e.g.: write-only files) are always written.
+  writes_.push_back(write);
+  return Status::OK;
+}
+
+void CgroupWriteBatch::RecordRead(const string &file_path,
+                                  const string &contents) {
+  read_contents_[file_path] = contents;
+}
+
+bool CgroupWriteBatch::Lookup(const string &file_path, string *value) const {
+  for (auto it = writes_.rbegin(); it != writes_.rend(); ++it) {
+    if (it->file_path == file_path) {
+      *value = it->value;
+      return true;
+    }
+  }
+
+  auto read_it = read_contents_.find(file_path);
+  if (read_it == read_contents_.end()) {
+    return false;
+  }
+  *value = read_it->second;
+  return true;
+}
+
+Status CgroupWriteBatch::Commit() {
+  Close();
+
+  for (int i = 0; i < writes_.size(); ++i) {
+    Status status = WriteFile(writes_[i].file_path, writes_[i].value);
+    if (!status.ok()) {
+      Undo(i);
+      return status;
+    }
+  }
+
+  return Status::OK;
+}
+
+Status CgroupWriteBatch::WriteFile(const string &file_path,
+                                   const string &value) const {
+  // Unlike CgroupController, writes are not timed one by one.
+  bool open_error = false;
+  bool write_error = false;
+  kernel_->SafeWriteResFileWithoutTimer(value, file_path, &open_error,
+                                        &write_error);
+
+  if (open_error) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("Failed to open file \"$0\"", file_path));
+  }
+  if (write_error) {
+    return Status(::util::error::UNAVAILABLE,
+                  Substitute("Failed to write \"$0\" to file \"$1\"", value,
+                             file_path));
+  }
+
+  return Status::OK;
+}
+
+void CgroupWriteBatch::Undo(int num_applied) const {
+  for (int i = num_applied - 1; i >= 0; --i) {
+    const Write &write = writes_[i];
+    if (!write.restorable) {
+      LOG(WARNING) << "Can't undo write of \"" << write.value << "\" to \""
+                   << write.file_path << "\"";
+      continue;
+    }
+
+    Status status = WriteFile(write.file_path, write.pre_image);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to undo write to \"" << write.file_path
+                   << "\": " << status.ToString();
+    }
+  }
+}
+
+}  // namespace lmctfy
+}  // namespace containers
@@ -0,0 +1,153 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_CONTROLLERS_CGROUP_WRITE_BATCH_H_
+#define SRC_CONTROLLERS_CGROUP_WRITE_BATCH_H_
+
+#include <map>
+#include <string>
+using ::std::string;
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "system_api/kernel_api.h"
+#include "util/task/status.h"
+
+namespace containers {
+namespace lmctfy {
+
+typedef ::system_api::KernelAPI KernelApi;
+
+// Collects the cgroup file writes of an operation (e.g.: an Update()) and
+// applies them all at once, or none of them.
+//
+// While a batch is open, the writes of all CgroupControllers on the thread
+// that created it are added to the batch instead of being written. Each write
+// is diffed against the current value of its file: writes of the value the
+// file already has are dropped, and the current value is kept as the pre-image
+// of the file. The current value is the one the file was read with while the
+// batch was open (see RecordRead()), and the file is only read when the write
+// is added if it was not. Commit() then applies the writes in the order they
+// were added. If one fails, the writes already applied are undone (newest
+// first) by writing back their pre-images.
+//
+// Writes only reach the files on Commit(). Reads of a file the batch writes
+// must go through Lookup() to see the value it will have, CgroupController
+// does so for the files it reads while the batch is open.
+//
+// Only single-line pre-images are written back, files that read back as a list
+// (e.g.: devices.list) can't be restored from what they read.
+//
+// A batch discarded without a Commit() writes nothing. Batches can be nested,
+// writes go to the innermost batch.
+//
+// Class is not thread-safe, it must be used by the thread that created it.
+class CgroupWriteBatch {
+ public:
+  // Opens the batch on the current thread. Does not take ownership of kernel.
+  explicit CgroupWriteBatch(const KernelApi *kernel);
+
+  // Closes the batch if it is still open. Writes that were not committed are
+  // discarded.
+  ~CgroupWriteBatch();
+
+  // Gets the innermost open batch of the current thread, nullptr if there is
+  // none.
+  static CgroupWriteBatch *Current();
+
+  // Adds a write of value to the specified file, unless the file already has
+  // that value.
+  //
+  // Arguments:
+  //   file_path: Absolute path of the cgroup file to write.
+  //   value: The value to write to the file.
+  // Return:
+  //   Status: OK iff the write will be applied on Commit() or was not needed.
+  //       NOT_FOUND if the file does not exist.
+  ::util::Status Add(const string &file_path, const string &value);
+
+  // Records the contents of the specified file, read while the batch is open.
+  // Writes added later are diffed against them instead of reading the file
+  // again.
+  void RecordRead(const string &file_path, const string &contents);
+
+  // Gets the value the specified file will have once the batch is committed:
+  // that of its last write in the batch if any, or else the contents it was
+  // recorded with. Values are returned as written, the kernel may report them
+  // differently (e.g.: -1 for no limit).
+  //
+  // Arguments:
+  //   file_path: Absolute path of the cgroup file.
+  //   value: Set to the value of the file, iff it is known.
+  // Return:
+  //   bool: Whether the value of the file is known.
+  bool Lookup(const string &file_path, string *value) const;
+
+  // Closes the batch and applies its writes. On failure, applied writes are
+  // undone. Must be called at most once.
+  //
+  // Return:
+  //   Status: OK iff all writes were applied.
+  ::util::Status Commit();
+
+  // Number of writes that will be applied.
+  int num_writes() const { return writes_.size(); }
+
+  // Number of writes dropped because the file already had the value.
+  int num_skipped() const { return num_skipped_; }
+
+ private:
+  struct Write {
+    string file_path;
+    string value;
+
+    // Whether the file could be read and had a single-line value.
+    bool restorable;
+    string pre_image;
+  };
+
+  // Writes value to the file.
+  ::util::Status WriteFile(const string &file_path, const string &value) const;
+
+  // Writes back the pre-images of the writes in [0, num_applied), newest first.
+  void Undo(int num_applied) const;
+
+  // Stops adding the writes of the current thread to this batch.
+  void Close();
+
+  // Wrapper for all calls to the kernel.
+  const KernelApi *kernel_;
+
+  // Writes to apply, in order.
+  ::std::vector<Write> writes_;
+
+  // Map of absolute file path to the contents it was read with.
+  ::std::map<string, string> read_contents_;
+
+  int num_skipped_;
+
+  // Whether writes are being added to this batch.
+  bool open_;
+
+  // The batch that was current when this one was opened.
+  CgroupWriteBatch *previous_;
+
+  DISALLOW_COPY_AND_ASSIGN(CgroupWriteBatch);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_CONTROLLERS_CGROUP_WRITE_BATCH_H_
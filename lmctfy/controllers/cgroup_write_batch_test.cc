@@ -0,0 +1,272 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/cgroup_write_batch.h"
+
+#include <unistd.h>
+
+#include <memory>
+
+#include "system_api/kernel_api_mock.h"
+#include "util/errors_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+
+using ::system_api::KernelAPIMock;
+using ::std::unique_ptr;
+using ::testing::DoAll;
+using ::testing::InSequence;
+using ::testing::NotNull;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+using ::testing::StrictMock;
+using ::util::Status;
+using ::util::error::NOT_FOUND;
+using ::util::error::UNAVAILABLE;
+
+namespace containers {
+namespace lmctfy {
+namespace {
+
+static const char kLimitPath[] = "/dev/cgroup/memory/test/memory.limit_in_bytes";
+static const char kSoftLimitPath[] =
+    "/dev/cgroup/memory/test/memory.soft_limit_in_bytes";
+static const char kListPath[] = "/dev/cgroup/devices/test/devices.allow";
+
+class CgroupWriteBatchTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    mock_kernel_.reset(new StrictMock<KernelAPIMock>());
+  }
+
+  // Expects the file to be read and have the specified value.
+  void ExpectRead(const string &file_path, const string &value) {
+    EXPECT_CALL(*mock_kernel_, ReadFileToString(file_path, NotNull()))
+        .WillOnce(DoAll(SetArgPointee<1>(value), Return(true)));
+  }
+
+  // Expects the value to be written to the file, with the specified outcome.
+  void ExpectWrite(const string &file_path, const string &value,
+                   bool open_error, bool write_error) {
+    EXPECT_CALL(*mock_kernel_, SafeWriteResFileWithoutTimer(
+                                   value, file_path, NotNull(), NotNull()))
+        .WillOnce(DoAll(SetArgPointee<2>(open_error),
+                        SetArgPointee<3>(write_error), Return(value.size())));
+  }
+
+ protected:
+  unique_ptr<KernelAPIMock> mock_kernel_;
+};
+
+TEST_F(CgroupWriteBatchTest, Current) {
+  EXPECT_EQ(nullptr, CgroupWriteBatch::Current());
+  {
+    CgroupWriteBatch batch(mock_kernel_.get());
+    EXPECT_EQ(&batch, CgroupWriteBatch::Current());
+    {
+      CgroupWriteBatch inner_batch(mock_kernel_.get());
+      EXPECT_EQ(&inner_batch, CgroupWriteBatch::Current());
+    }
+    EXPECT_EQ(&batch, CgroupWriteBatch::Current());
+
+    EXPECT_OK(batch.Commit());
+    EXPECT_EQ(nullptr, CgroupWriteBatch::Current());
+  }
+  EXPECT_EQ(nullptr, CgroupWriteBatch::Current());
+}
+
+TEST_F(CgroupWriteBatchTest, CommitEmpty) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+  EXPECT_OK(batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, SkipsWritesOfCurrentValue) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  ExpectRead(kLimitPath, "100\n");
+  EXPECT_OK(batch.Add(kLimitPath, "100"));
+  EXPECT_EQ(0, batch.num_writes());
+  EXPECT_EQ(1, batch.num_skipped());
+
+  EXPECT_OK(batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, DiffsAgainstRecordedRead) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  // Files read while the batch is open are not read again.
+  batch.RecordRead(kLimitPath, "100\n");
+  EXPECT_OK(batch.Add(kLimitPath, "100"));
+  EXPECT_EQ(1, batch.num_skipped());
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  EXPECT_EQ(1, batch.num_writes());
+
+  ExpectWrite(kLimitPath, "200", false, false);
+  EXPECT_OK(batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, Lookup) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+  string value;
+  EXPECT_FALSE(batch.Lookup(kLimitPath, &value));
+
+  // Files the batch read have the value they were read with.
+  ExpectRead(kLimitPath, "100\n");
+  EXPECT_OK(batch.Add(kLimitPath, "100"));
+  ASSERT_TRUE(batch.Lookup(kLimitPath, &value));
+  EXPECT_EQ("100\n", value);
+
+  // Until they are written.
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  ASSERT_TRUE(batch.Lookup(kLimitPath, &value));
+  EXPECT_EQ("200", value);
+  EXPECT_OK(batch.Add(kLimitPath, "300"));
+  ASSERT_TRUE(batch.Lookup(kLimitPath, &value));
+  EXPECT_EQ("300", value);
+
+  batch.RecordRead(kSoftLimitPath, "50\n");
+  ASSERT_TRUE(batch.Lookup(kSoftLimitPath, &value));
+  EXPECT_EQ("50\n", value);
+}
+
+TEST_F(CgroupWriteBatchTest, WritesChangedValues) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  ExpectRead(kLimitPath, "100\n");
+  ExpectRead(kSoftLimitPath, "50\n");
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  EXPECT_OK(batch.Add(kSoftLimitPath, "100"));
+  EXPECT_EQ(2, batch.num_writes());
+
+  // Nothing is written until the batch is committed.
+  InSequence s;
+  ExpectWrite(kLimitPath, "200", false, false);
+  ExpectWrite(kSoftLimitPath, "100", false, false);
+  EXPECT_OK(batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, RepeatedWritesToFile) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  // The file is only read once, later writes compare to the pending value.
+  ExpectRead(kLimitPath, "100\n");
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  EXPECT_OK(batch.Add(kLimitPath, "300"));
+  EXPECT_EQ(2, batch.num_writes());
+  EXPECT_EQ(1, batch.num_skipped());
+
+  InSequence s;
+  ExpectWrite(kLimitPath, "200", false, false);
+  ExpectWrite(kLimitPath, "300", false, false);
+  EXPECT_OK(batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, UnreadableFileIsWritten) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kListPath, NotNull()))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*mock_kernel_, Access(kListPath, F_OK)).WillOnce(Return(0));
+  EXPECT_OK(batch.Add(kListPath, "a *:* rwm"));
+
+  ExpectWrite(kListPath, "a *:* rwm", false, false);
+  EXPECT_OK(batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, AddMissingFile) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kLimitPath, NotNull()))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*mock_kernel_, Access(kLimitPath, F_OK)).WillOnce(Return(-1));
+  EXPECT_ERROR_CODE(NOT_FOUND, batch.Add(kLimitPath, "200"));
+  EXPECT_EQ(0, batch.num_writes());
+}
+
+TEST_F(CgroupWriteBatchTest, DiscardedBatchWritesNothing) {
+  {
+    CgroupWriteBatch batch(mock_kernel_.get());
+    ExpectRead(kLimitPath, "100\n");
+    EXPECT_OK(batch.Add(kLimitPath, "200"));
+  }
+  EXPECT_EQ(nullptr, CgroupWriteBatch::Current());
+}
+
+TEST_F(CgroupWriteBatchTest, FailedWriteIsRolledBack) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  ExpectRead(kLimitPath, "100\n");
+  ExpectRead(kSoftLimitPath, "50\n");
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  EXPECT_OK(batch.Add(kSoftLimitPath, "100"));
+
+  InSequence s;
+  ExpectWrite(kLimitPath, "200", false, false);
+  ExpectWrite(kSoftLimitPath, "100", false, true);
+  ExpectWrite(kLimitPath, "100", false, false);
+  EXPECT_ERROR_CODE(UNAVAILABLE, batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, FailedOpenIsRolledBack) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  ExpectRead(kLimitPath, "100\n");
+  ExpectRead(kSoftLimitPath, "50\n");
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  EXPECT_OK(batch.Add(kSoftLimitPath, "100"));
+
+  InSequence s;
+  ExpectWrite(kLimitPath, "200", false, false);
+  ExpectWrite(kSoftLimitPath, "100", true, false);
+  ExpectWrite(kLimitPath, "100", false, false);
+  EXPECT_ERROR_CODE(NOT_FOUND, batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, RepeatedWritesAreRolledBackToFirstValue) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  ExpectRead(kLimitPath, "100\n");
+  ExpectRead(kSoftLimitPath, "50\n");
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+  EXPECT_OK(batch.Add(kLimitPath, "300"));
+  EXPECT_OK(batch.Add(kSoftLimitPath, "100"));
+
+  InSequence s;
+  ExpectWrite(kLimitPath, "200", false, false);
+  ExpectWrite(kLimitPath, "300", false, false);
+  ExpectWrite(kSoftLimitPath, "100", false, true);
+  ExpectWrite(kLimitPath, "100", false, false);
+  ExpectWrite(kLimitPath, "100", false, false);
+  EXPECT_ERROR_CODE(UNAVAILABLE, batch.Commit());
+}
+
+TEST_F(CgroupWriteBatchTest, MultiLineValuesAreNotRolledBack) {
+  CgroupWriteBatch batch(mock_kernel_.get());
+
+  ExpectRead(kListPath, "a *:* rwm\nc 1:3 r\n");
+  ExpectRead(kLimitPath, "100\n");
+  EXPECT_OK(batch.Add(kListPath, "c 1:5 r"));
+  EXPECT_OK(batch.Add(kLimitPath, "200"));
+
+  InSequence s;
+  ExpectWrite(kListPath, "c 1:5 r", false, false);
+  ExpectWrite(kLimitPath, "200", false, true);
+  EXPECT_ERROR_CODE(UNAVAILABLE, batch.Commit());
+}
+
+}  // namespace
+}  // namespace lmctfy
+}  // namespace containers
@@ -14,12 +14,15 @@
 
 #include "lmctfy/controllers/cpu_controller.h"
 
+#include <map>
+
 #include "lmctfy/kernel_files.h"
 #include "include/lmctfy.pb.h"
 #include "util/errors.h"
 #include "strings/split.h"
 #include "strings/substitute.h"
 
+using ::std::map;
 using ::strings::SkipEmpty;
 using ::strings::Split;
 using ::strings::Substitute;
@@ -36,6 +39,12 @@ static const int64 kMinShares = 2;
 static const int kPerCpuShares = 1024;
 static const int kCpusToMilliCpus = 1000;
 
+// Range of CFS shares, and of the weights that replace them in the unified
+// hierarchy.
+static const int64 kMaxShares = 262144;
+static const int64 kMinWeight = 1;
+static const int64 kMaxWeight = 10000;
+
 // Throttling settings.
 // Use a default throttling period of 250ms. New quota is issued every period
 // when a container is being throttled. Setting a period that's too large can
@@ -43,6 +52,10 @@ static const int kCpusToMilliCpus = 1000;
 // overhead. 250ms seems to work fine for most jobs.
 static const int kHardcapPeriodUsecs = 250000;
 static const int kUsecsPerMilliSecs = 1000;
+static const int kNsecsPerUsec = 1000;
+
+// Value of the quota in cpu.max when the container is not throttled.
+static const char kNoQuota[] = "max";
 
 // Latency settings.
 static const int kPremierLatency = 25;
@@ -68,8 +81,25 @@ int64 CpuController::SharesToMilliCpus(int64 shares) const {
   return (kCpusToMilliCpus * shares) / kPerCpuShares;
 }
 
+// Maps the range of shares linearly onto the range of weights, like container
+// runtimes do, so that both hierarchies split the CPU in the same proportions.
+static int64 SharesToWeight(int64 shares) {
+  shares = max(kMinShares, min(kMaxShares, shares));
+  return kMinWeight + ((shares - kMinShares) * (kMaxWeight - kMinWeight)) /
+                          (kMaxShares - kMinShares);
+}
+
+static int64 WeightToShares(int64 weight) {
+  return kMinShares + ((weight - kMinWeight) * (kMaxShares - kMinShares)) /
+                          (kMaxWeight - kMinWeight);
+}
+
 Status CpuController::SetMilliCpus(int64 milli_cpus) {
   int shares = MilliCpusToShares(milli_cpus);
+  if (unified()) {
+    return SetParamInt(KernelFiles::Unified::Cpu::kWeight,
+                       SharesToWeight(shares));
+  }
   return SetParamInt(KernelFiles::Cpu::kShares, shares);
 }
 
@@ -84,6 +114,13 @@ Status CpuController::SetMaxMilliCpus(int64 max_milli_cpus) {
                              max_milli_cpus));
   }
 
+  // The unified hierarchy sets the quota and period in a single write.
+  if (unified()) {
+    return SetParamString(
+        KernelFiles::Unified::Cpu::kMax,
+        Substitute("$0 $1", quota_usecs, kHardcapPeriodUsecs));
+  }
+
   RETURN_IF_ERROR(SetParamInt(KernelFiles::Cpu::kHardcapPeriod,
                               kHardcapPeriodUsecs));
   return SetParamInt(KernelFiles::Cpu::kHardcapQuota, quota_usecs);
@@ -124,12 +161,41 @@ StatusOr<int> CpuController::GetNumRunnable() const {
 }
 
 StatusOr<int64> CpuController::GetMilliCpus() const {
+  if (unified()) {
+    const int64 weight =
+        RETURN_IF_ERROR(GetParamInt(KernelFiles::Unified::Cpu::kWeight));
+    return SharesToMilliCpus(WeightToShares(weight));
+  }
+
   int64 shares = RETURN_IF_ERROR(GetParamInt(KernelFiles::Cpu::kShares));
 
   return SharesToMilliCpus(shares);
 }
 
 StatusOr<int64> CpuController::GetMaxMilliCpus() const {
+  if (unified()) {
+    // Expected format is: <quota or "max"> <period>
+    const string cpu_max =
+        RETURN_IF_ERROR(GetParamString(KernelFiles::Unified::Cpu::kMax));
+    const vector<string> values = Split(cpu_max, " ", SkipEmpty());
+    int64 quota_usecs = 0;
+    int64 period_usecs = 0;
+    if (values.size() != 2 || !SimpleAtoi(values[1], &period_usecs) ||
+        period_usecs <= 0 ||
+        (values[0] != kNoQuota && !SimpleAtoi(values[0], &quota_usecs))) {
+      return Status(::util::error::INTERNAL,
+                    Substitute("Invalid throttling limit returned by kernel: "
+                               "\"$0\"",
+                               cpu_max));
+    }
+
+    if (values[0] == kNoQuota) {
+      // Unthrottled container.
+      return -1;
+    }
+    return (quota_usecs * kUsecsPerMilliSecs) / period_usecs;
+  }
+
   int64 quota_usecs =
       RETURN_IF_ERROR(GetParamInt(KernelFiles::Cpu::kHardcapQuota));
 
@@ -166,6 +232,26 @@ StatusOr<SchedulingLatency> CpuController::GetLatency() const {
 }
 
 StatusOr<ThrottlingStats> CpuController::GetThrottlingStats() const {
+  if (unified()) {
+    const map<string, int64> values =
+        RETURN_IF_ERROR(GetParamKeyed(KernelFiles::Unified::Cpu::kStat));
+    auto nr_periods = values.find("nr_periods");
+    auto nr_throttled = values.find("nr_throttled");
+    auto throttled_usec = values.find("throttled_usec");
+    if (nr_periods == values.end() || nr_throttled == values.end() ||
+        throttled_usec == values.end()) {
+      return Status(::util::error::INTERNAL,
+                    "Missing throttling stat fields in cpu.stat");
+    }
+
+    ThrottlingStats stats;
+    stats.nr_periods = nr_periods->second;
+    stats.nr_throttled = nr_throttled->second;
+    // Throttled time is reported in microseconds by the unified hierarchy.
+    stats.throttled_time = throttled_usec->second * kNsecsPerUsec;
+    return stats;
+  }
+
   string stats_str =
       RETURN_IF_ERROR(GetParamString(KernelFiles::Cpu::kThrottlingStats));
   const int kNumThrottlingStats = 3;
@@ -222,5 +308,17 @@ StatusOr<int64> CpuController::GetThrottlingPeriodInMs() const {
   return kHardcapPeriodUsecs / kUsecsPerMilliSecs;
 }
 
+StatusOr<PressureData> CpuController::GetPressure() const {
+  return GetParamPressure(KernelFiles::Unified::Cpu::kPressure);
+}
+
+StatusOr<ActiveNotifications::Handle>
+CpuController::RegisterPressureNotification(
+    const EventSpec::PressureThreshold &threshold,
+    CgroupController::EventCallback *callback) {
+  return CgroupController::RegisterPressureNotification(
+      KernelFiles::Unified::Cpu::kPressure, threshold, callback);
+}
+
 }  // namespace lmctfy
 }  // namespace containers
@@ -112,6 +112,17 @@ class CpuController : public CgroupController {
   // Get default throttling period in milliseconds.
   virtual ::util::StatusOr<int64> GetThrottlingPeriodInMs() const;
 
+  // Gets the CPU pressure stall information of this cgroup. Only available in
+  // the unified hierarchy.
+  virtual ::util::StatusOr<PressureData> GetPressure() const;
+
+  // Registers a notification for when the CPU stall time of this cgroup goes
+  // above the threshold. The handler for the event is returned on success.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+      RegisterPressureNotification(
+          const EventSpec::PressureThreshold &threshold,
+          CgroupController::EventCallback *callback);
+
  private:
   int64 MilliCpusToShares(int64 milli_cpus) const;
   int64 SharesToMilliCpus(int64 shares) const;
@@ -60,6 +60,11 @@ class MockCpuController : public CpuController {
   MOCK_CONST_METHOD0(GetPlacementStrategy, ::util::StatusOr<int64>());
   MOCK_CONST_METHOD0(GetThrottlingStats, ::util::StatusOr<ThrottlingStats>());
   MOCK_CONST_METHOD0(GetThrottlingPeriodInMs, ::util::StatusOr<int64>());
+  MOCK_CONST_METHOD0(GetPressure, ::util::StatusOr<PressureData>());
+  MOCK_METHOD2(RegisterPressureNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   const EventSpec::PressureThreshold &threshold,
+                   CgroupController::EventCallback *callback));
 };
 
 typedef ::testing::StrictMock<MockCpuController> StrictMockCpuController;
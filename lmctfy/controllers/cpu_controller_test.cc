@@ -71,6 +71,16 @@ TEST_F(CpuControllerTest, SetMilliCpus) {
   EXPECT_TRUE(controller_->SetMilliCpus(1000).ok());
 }
 
+TEST_F(CpuControllerTest, SetMilliCpusUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kWeight);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("39", kResFile, NotNull(),
+                                              NotNull())).WillOnce(Return(0));
+  EXPECT_OK(controller_->SetMilliCpus(1000));
+}
+
 TEST_F(CpuControllerTest, SetMilliCpusTooLow) {
   const string kResFile = JoinPath(kMountPoint, KernelFiles::Cpu::kShares);
 
@@ -111,6 +121,16 @@ TEST_F(CpuControllerTest, SetMaxMilliCpus) {
 }
 
 
+TEST_F(CpuControllerTest, SetMaxMilliCpusUnified) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kMax);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("500000 250000", kResFile,
+                                              NotNull(), NotNull()))
+      .WillOnce(Return(0));
+  EXPECT_OK(controller_->SetMaxMilliCpus(2000));
+}
+
 TEST_F(CpuControllerTest, SetMaxMilliCpusTooLow) {
   const string kQuotaFile = JoinPath(kMountPoint,
                                      KernelFiles::Cpu::kHardcapQuota);
@@ -248,6 +268,20 @@ TEST_F(CpuControllerTest, GetMilliCpus) {
   EXPECT_EQ(1000, statusor.ValueOrDie());
 }
 
+TEST_F(CpuControllerTest, GetMilliCpusUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kWeight);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("10000\n"), Return(true)));
+
+  StatusOr<int64> statusor = controller_->GetMilliCpus();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(256000, statusor.ValueOrDie());
+}
+
 TEST_F(CpuControllerTest, GetMilliCpusNotFound) {
   const string kResFile = JoinPath(kMountPoint,
                                    KernelFiles::Cpu::kShares);
@@ -292,6 +326,43 @@ TEST_F(CpuControllerTest, GetMaxMilliCpusUncapped) {
   EXPECT_EQ(-1, statusor.ValueOrDie());
 }
 
+TEST_F(CpuControllerTest, GetMaxMilliCpusUnified) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kMax);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("500000 250000\n"), Return(true)));
+
+  StatusOr<int64> statusor = controller_->GetMaxMilliCpus();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(2000, statusor.ValueOrDie());
+}
+
+TEST_F(CpuControllerTest, GetMaxMilliCpusUnifiedUncapped) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kMax);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("max 100000\n"), Return(true)));
+
+  StatusOr<int64> statusor = controller_->GetMaxMilliCpus();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(-1, statusor.ValueOrDie());
+}
+
+TEST_F(CpuControllerTest, GetMaxMilliCpusUnifiedMalformed) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kMax);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("500000\n"), Return(true)));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, controller_->GetMaxMilliCpus());
+}
+
 TEST_F(CpuControllerTest, GetMaxMilliCpusNotFound) {
   const string kResFile = JoinPath(kMountPoint,
                                    KernelFiles::Cpu::kHardcapQuota);
@@ -389,6 +460,37 @@ TEST_F(CpuControllerTest, GetThrottlingStats) {
 }
 
 
+TEST_F(CpuControllerTest, GetThrottlingStatsUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kStat);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("usage_usec 42\nnr_periods 2\n"
+                                       "nr_throttled 1\nthrottled_usec 200000\n"),
+                      Return(true)));
+
+  StatusOr<ThrottlingStats> statusor = controller_->GetThrottlingStats();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(2, statusor.ValueOrDie().nr_periods);
+  EXPECT_EQ(1, statusor.ValueOrDie().nr_throttled);
+  EXPECT_EQ(200000000, statusor.ValueOrDie().throttled_time);
+}
+
+TEST_F(CpuControllerTest, GetThrottlingStatsUnifiedMissingField) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kStat);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("usage_usec 42\n"), Return(true)));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    controller_->GetThrottlingStats());
+}
+
 TEST_F(CpuControllerTest, GetThrottlingStatsIgnoresMalformedLines) {
   const string kResFile = JoinPath(kMountPoint,
                                    KernelFiles::Cpu::kThrottlingStats);
@@ -456,5 +558,55 @@ TEST_F(CpuControllerTest, GetThrottlingStatsFailWithKernelReadFailure) {
   EXPECT_FALSE(controller_->GetThrottlingStats().ok());
 }
 
+void NoOpCallback(Status status) {}
+
+TEST_F(CpuControllerTest, GetPressure) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kPressure);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(
+          SetArgPointee<1>("some avg10=2.00 avg60=1.00 avg300=0.50 total=42\n"
+                           "full avg10=0.00 avg60=0.00 avg300=0.00 total=7\n"),
+          Return(true)));
+
+  StatusOr<PressureData> statusor = controller_->GetPressure();
+  ASSERT_OK(statusor);
+  EXPECT_DOUBLE_EQ(2.0, statusor.ValueOrDie().some().avg10());
+  EXPECT_EQ(42, statusor.ValueOrDie().some().total());
+  EXPECT_EQ(7, statusor.ValueOrDie().full().total());
+}
+
+TEST_F(CpuControllerTest, GetPressureNotFound) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kPressure);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(-1));
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetPressure());
+}
+
+TEST_F(CpuControllerTest, RegisterPressureNotification) {
+  controller_->set_unified(true);
+  EventSpec::PressureThreshold threshold;
+  threshold.set_resource(EventSpec::PressureThreshold::CPU);
+  threshold.set_threshold(100000);
+  threshold.set_window(1000000);
+
+  // Normally RegisterTriggerNotification() takes ownership, but we are mocking
+  // it out.
+  unique_ptr<CgroupController::EventCallback> cb(
+      NewPermanentCallback(&NoOpCallback));
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterTriggerNotification(kMountPoint, KernelFiles::Unified::Cpu::kPressure,
+                                          "some 100000 1000000", NotNull()))
+      .WillOnce(Return(1));
+
+  StatusOr<ActiveNotifications::Handle> statusor =
+      controller_->RegisterPressureNotification(threshold, cb.get());
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
 }  // namespace lmctfy
 }  // namespace containers
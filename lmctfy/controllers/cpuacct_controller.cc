@@ -69,7 +69,27 @@ CpuAcctController::CpuAcctController(
     : CgroupController(CGROUP_CPUACCT, hierarchy_path, cgroup_path, owns_cgroup,
                        kernel, eventfd_notifications) {}
 
+// The unified hierarchy reports CPU usage in microseconds in cpu.stat.
+static const int64 kNanosecondsInMicrosecond = 1000;
+
+StatusOr<int64> CpuAcctController::GetUnifiedCpuStat(
+    const string &field) const {
+  const map<string, int64> values =
+      RETURN_IF_ERROR(GetParamKeyed(KernelFiles::Unified::Cpu::kStat));
+  auto it = values.find(field);
+  if (it == values.end()) {
+    return Status(::util::error::INTERNAL,
+                  Substitute("Missing field \"$0\" in $1", field,
+                             KernelFiles::Unified::Cpu::kStat));
+  }
+  return it->second;
+}
+
 StatusOr<int64> CpuAcctController::GetCpuUsageInNs() const {
+  if (unified()) {
+    return RETURN_IF_ERROR(GetUnifiedCpuStat("usage_usec")) *
+           kNanosecondsInMicrosecond;
+  }
   return GetParamInt(KernelFiles::CPUAcct::kUsage);
 }
 
@@ -120,6 +140,14 @@ Nanoseconds TicksToNanoseconds(int64 ticks) {
 }  // namespace
 
 StatusOr<CpuTime> CpuAcctController::GetCpuTime() const {
+  if (unified()) {
+    const int64 user_usecs = RETURN_IF_ERROR(GetUnifiedCpuStat("user_usec"));
+    const int64 system_usecs =
+        RETURN_IF_ERROR(GetUnifiedCpuStat("system_usec"));
+    return CpuTime{Nanoseconds(user_usecs * kNanosecondsInMicrosecond),
+                   Nanoseconds(system_usecs * kNanosecondsInMicrosecond)};
+  }
+
   string cpu_time_data =
       RETURN_IF_ERROR(GetParamString(KernelFiles::CPUAcct::kStat));
   int64 user_ticks;
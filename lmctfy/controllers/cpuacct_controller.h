@@ -100,6 +100,9 @@ class CpuAcctController : public CgroupController {
       GetSchedulerHistograms() const;
 
  private:
+  // Gets the specified field of cpu.stat in the unified hierarchy.
+  ::util::StatusOr<int64> GetUnifiedCpuStat(const string &field) const;
+
   ::util::Status ConfigureHistogramBucket(const string &histogram_path,
                                           const string &buckets);
 
@@ -84,6 +84,34 @@ TEST_F(CpuAcctControllerTest, GetCpuUsageInNs) {
   EXPECT_EQ(1000000000, statusor.ValueOrDie());
 }
 
+TEST_F(CpuAcctControllerTest, GetCpuUsageInNsUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kStat);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("usage_usec 1000000\nuser_usec 600000\n"
+                                       "system_usec 400000\n"),
+                      Return(true)));
+  StatusOr<int64> statusor = controller_->GetCpuUsageInNs();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1000000000, statusor.ValueOrDie());
+}
+
+TEST_F(CpuAcctControllerTest, GetCpuUsageInNsUnifiedMissingField) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kStat);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("user_usec 600000\n"), Return(true)));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, controller_->GetCpuUsageInNs());
+}
+
 TEST_F(CpuAcctControllerTest, GetCpuUsageInNsNotFound) {
   const string kResFile = JoinPath(kMountPoint, KernelFiles::CPUAcct::kUsage);
 
@@ -153,6 +181,24 @@ TEST_F(CpuAcctControllerTest, GetCpuTime) {
   EXPECT_EQ(121902102000000000 / user_hz, cpu_time.system.value());
 }
 
+TEST_F(CpuAcctControllerTest, GetCpuTimeUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Cpu::kStat);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillRepeatedly(DoAll(
+          SetArgPointee<1>("usage_usec 1000000\nuser_usec 600000\n"
+                           "system_usec 400000\n"),
+          Return(true)));
+  StatusOr<CpuTime> statusor = controller_->GetCpuTime();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(600000000, statusor.ValueOrDie().user.value());
+  EXPECT_EQ(400000000, statusor.ValueOrDie().system.value());
+}
+
 TEST_F(CpuAcctControllerTest, GetCpuTimeNotFound) {
   const string kResFile = JoinPath(kMountPoint,
                                    KernelFiles::CPUAcct::kStat);
@@ -14,14 +14,32 @@
 
 #include "lmctfy/controllers/eventfd_notifications.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+
+#include "file/base/path.h"
 #include "util/eventfd_listener.h"
+#include "lmctfy/release_agent/release_agent.h"
+#include "strings/split.h"
 #include "strings/substitute.h"
+#include "util/errors.h"
 #include "util/gtl/stl_util.h"
 
+using ::file::JoinPath;
+using ::util::EventInfo;
 using ::util::EventReceiverInterface;
 using ::util::EventfdListener;
+using ::std::multimap;
 using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Split;
 using ::strings::Substitute;
+using ::system_api::KernelAPI;
 using ::util::Status;
 using ::util::StatusOr;
 
@@ -35,12 +53,16 @@ namespace lmctfy {
 class EventReceiver : public EventReceiverInterface {
  public:
   // Does not take ownership of active_notificaitons. Takes ownership of
-  // notification_callback which must be a repeatable callback.
+  // notification_callback which must be a repeatable callback. If match is not
+  // empty, only the events whose arguments include a line equal to it are
+  // delivered.
   EventReceiver(ActiveNotifications::Handle id,
                 const ActiveNotifications *active_notifications,
+                const string &match,
                 Callback1<Status> *notification_callback)
       : id_(id),
         active_notifications_(CHECK_NOTNULL(active_notifications)),
+        match_(match),
         notification_callback_(CHECK_NOTNULL(notification_callback)) {
     notification_callback_->IsRepeatable();
   }
@@ -54,6 +76,13 @@ class EventReceiver : public EventReceiverInterface {
       return false;
     }
 
+    if (!match_.empty()) {
+      const vector<string> lines = Split(args, "\n");
+      if (find(lines.begin(), lines.end(), match_) == lines.end()) {
+        return true;
+      }
+    }
+
     // Deliver event to the user.
     notification_callback_->Run(Status::OK);
     return true;
@@ -84,21 +113,95 @@ class EventReceiver : public EventReceiverInterface {
   // Notifications active in the system.
   const ActiveNotifications *active_notifications_;
 
+  // Line the arguments of delivered events must include, if not empty.
+  const string match_;
+
   // The callback used to deliver notificaitons to the user.
   unique_ptr<Callback1<Status>> notification_callback_;
 
   DISALLOW_COPY_AND_ASSIGN(EventReceiver);
 };
 
+// Receiver of the releases read from the release agent FIFO. Each release is
+// a line with the path of the released cgroup and is delivered to the
+// receivers registered for that path.
+//
+// Class is thread-safe.
+class ReleaseDispatcher : public EventReceiverInterface {
+ public:
+  ReleaseDispatcher() {}
+  ~ReleaseDispatcher() {}
+
+  // Does not take ownership of receiver.
+  void Add(const string &release_path, EventReceiver *receiver) {
+    MutexLock l(&lock_);
+    receivers_.insert(make_pair(release_path, receiver));
+  }
+
+  // Deliver the releases to the receivers of the released cgroups. Receivers
+  // of notifications that were unregistered are dropped.
+  bool ReportEvent(const string &name, const string &args) {
+    MutexLock l(&lock_);
+    partial_line_.append(args);
+    size_t end;
+    while ((end = partial_line_.find('\n')) != string::npos) {
+      const string release_path = partial_line_.substr(0, end);
+      partial_line_.erase(0, end + 1);
+
+      auto range = receivers_.equal_range(release_path);
+      for (auto it = range.first; it != range.second;) {
+        if (it->second->ReportEvent(release_path, "")) {
+          ++it;
+        } else {
+          receivers_.erase(it++);
+        }
+      }
+    }
+    return true;
+  }
+
+  // Report the error to all receivers.
+  void ReportError(const string &name, EventfdListener *listener) {
+    MutexLock l(&lock_);
+    LOG(WARNING) << "Stopped reading from the release agent FIFO due to error";
+    for (const auto &path_receiver : receivers_) {
+      path_receiver.second->ReportError(path_receiver.first, listener);
+    }
+    receivers_.clear();
+  }
+
+  // Log the exit.
+  void ReportExit(const string &name, EventfdListener *listener) {
+    LOG(INFO) << "Stopped reading from the release agent FIFO";
+  }
+
+ private:
+  // Map of the path of a cgroup to the receivers of its release.
+  multimap<string, EventReceiver *> receivers_ GUARDED_BY(lock_);
+
+  // Data read after the last complete line.
+  string partial_line_ GUARDED_BY(lock_);
+
+  Mutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReleaseDispatcher);
+};
+
 EventFdNotifications::EventFdNotifications(
     ActiveNotifications *active_notifications,
-    ::util::EventfdListener *event_listener)
+    ::util::EventfdListener *event_listener,
+    const KernelAPI *kernel)
     : active_notifications_(CHECK_NOTNULL(active_notifications)),
-      event_listener_(CHECK_NOTNULL(event_listener)) {}
+      event_listener_(CHECK_NOTNULL(event_listener)),
+      kernel_(CHECK_NOTNULL(kernel)) {}
 
 EventFdNotifications::~EventFdNotifications() {
   event_listener_->Stop();
   event_listener_.reset();
+  release_dispatcher_.reset();
+  if (!release_fifo_.empty()) {
+    kernel_->Unlink(JoinPath(kReleaseAgentDir, release_fifo_).c_str());
+  }
 
   // TODO(vmarmol): Use something that doesn't require us to keep track of the
   // receivers since they're staying around for longer than they need to be.
@@ -110,6 +213,94 @@ EventFdNotifications::RegisterNotification(const string &cgroup_basepath,
                                            const string &cgroup_file,
                                            const string &args,
                                            EventCallback *callback) {
+  return Register(cgroup_basepath, cgroup_file, args, EventInfo::EVENTFD, "",
+                  callback);
+}
+
+StatusOr<ActiveNotifications::Handle>
+EventFdNotifications::RegisterTriggerNotification(const string &cgroup_basepath,
+                                                  const string &cgroup_file,
+                                                  const string &trigger,
+                                                  EventCallback *callback) {
+  return Register(cgroup_basepath, cgroup_file, trigger, EventInfo::TRIGGER,
+                  "", callback);
+}
+
+StatusOr<ActiveNotifications::Handle>
+EventFdNotifications::RegisterWatchNotification(const string &cgroup_basepath,
+                                                const string &cgroup_file,
+                                                const string &match,
+                                                EventCallback *callback) {
+  return Register(cgroup_basepath, cgroup_file, "", EventInfo::WATCH, match,
+                  callback);
+}
+
+StatusOr<ActiveNotifications::Handle>
+EventFdNotifications::RegisterReleaseNotification(const string &release_path,
+                                                  EventCallback *callback) {
+  CHECK_NOTNULL(callback);
+  callback->CheckIsRepeatable();
+  unique_ptr<EventCallback> callback_deleter(callback);
+
+  MutexLock l(&release_lock_);
+  RETURN_IF_ERROR(SetUpReleaseAgentFifo());
+
+  ActiveNotifications::Handle id = active_notifications_->Add();
+  EventReceiver *receiver = new EventReceiver(id, active_notifications_, "",
+                                              callback_deleter.release());
+  event_receivers_.push_back(receiver);
+  release_dispatcher_->Add(release_path, receiver);
+  return id;
+}
+
+Status EventFdNotifications::SetUpReleaseAgentFifo() {
+  if (release_dispatcher_ != nullptr) {
+    return Status::OK;
+  }
+
+  if (kernel_->MkDirRecursive(kReleaseAgentDir) != 0) {
+    return Status(::util::error::INTERNAL,
+                  Substitute("Failed to create \"$0\": $1", kReleaseAgentDir,
+                             StrError(errno)));
+  }
+
+  // A line read from a FIFO is gone for its other readers, so each instance
+  // reads from a FIFO of its own and the release agent writes to all of them.
+  if (release_fifo_.empty()) {
+    static ::std::atomic<int> next_fifo_id(0);
+    const string name =
+        Substitute("$0.$1.$2", kReleaseAgentFifo, getpid(), next_fifo_id++);
+    const string fifo = JoinPath(kReleaseAgentDir, name);
+    // One left by a dead process with the same PID is reused.
+    if (kernel_->MkFifo(fifo.c_str(), 0600) != 0 && errno != EEXIST) {
+      return Status(::util::error::INTERNAL,
+                    Substitute("Failed to create FIFO \"$0\": $1", fifo,
+                               StrError(errno)));
+    }
+    release_fifo_ = name;
+  }
+
+  unique_ptr<ReleaseDispatcher> dispatcher(new ReleaseDispatcher());
+  if (!event_listener_->AddStream(kReleaseAgentDir, release_fifo_, "",
+                                  dispatcher.get())) {
+    return Status(::util::error::INTERNAL,
+                  Substitute("Failed to read from FIFO \"$0\"",
+                             JoinPath(kReleaseAgentDir, release_fifo_)));
+  }
+  release_dispatcher_ = ::std::move(dispatcher);
+
+  // Start listener thread if it was not already running.
+  if (event_listener_->IsNotRunning()) {
+    event_listener_->Start();
+  }
+
+  return Status::OK;
+}
+
+StatusOr<ActiveNotifications::Handle> EventFdNotifications::Register(
+    const string &cgroup_basepath, const string &cgroup_file,
+    const string &args, EventInfo::Type type, const string &match,
+    EventCallback *callback) {
   CHECK_NOTNULL(callback);
   callback->CheckIsRepeatable();
 
@@ -118,9 +309,26 @@ EventFdNotifications::RegisterNotification(const string &cgroup_basepath,
 
   // Register the event with the eventfd-based listener.
   unique_ptr<EventReceiver> receiver(
-      new EventReceiver(id, active_notifications_, callback));
-  if (!event_listener_->Add(cgroup_basepath, cgroup_file, args, "",
-                            receiver.get())) {
+      new EventReceiver(id, active_notifications_, match, callback));
+  bool added = false;
+  switch (type) {
+    case EventInfo::EVENTFD:
+      added = event_listener_->Add(cgroup_basepath, cgroup_file, args, "",
+                                   receiver.get());
+      break;
+    case EventInfo::TRIGGER:
+      added = event_listener_->AddTrigger(cgroup_basepath, cgroup_file, args,
+                                          "", receiver.get());
+      break;
+    case EventInfo::WATCH:
+      added = event_listener_->AddWatch(cgroup_basepath, cgroup_file, "",
+                                        receiver.get());
+      break;
+    case EventInfo::STREAM:
+      LOG(DFATAL) << "Streams are not registered through Register()";
+      break;
+  }
+  if (!added) {
     return Status(::util::error::INTERNAL,
                   "Failed to register listener for the event");
   }
@@ -22,8 +22,11 @@ using ::std::string;
 
 #include "base/callback.h"
 #include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
 #include "util/eventfd_listener.h"
 #include "lmctfy/active_notifications.h"
+#include "system_api/kernel_api.h"
 #include "util/task/status.h"
 #include "util/task/statusor.h"
 
@@ -31,6 +34,7 @@ namespace containers {
 namespace lmctfy {
 
 class EventReceiver;
+class ReleaseDispatcher;
 
 // Registers and handles eventfd-based notifications. Specifically, those build
 // around the cgroups interface.
@@ -41,9 +45,10 @@ class EventFdNotifications {
   typedef Callback1< ::util::Status> EventCallback;
 
   // Takes ownersip of event_listener. Does not take ownership of
-  // active_notifications.
+  // active_notifications or kernel.
   EventFdNotifications(ActiveNotifications *active_notifications,
-                       ::util::EventfdListener *event_listener);
+                       ::util::EventfdListener *event_listener,
+                       const ::system_api::KernelAPI *kernel);
   virtual ~EventFdNotifications();
 
   // Registers an eventfd-based notification for the specified cgroup control
@@ -64,7 +69,77 @@ class EventFdNotifications {
       const string &cgroup_basepath, const string &cgroup_file,
       const string &args, EventCallback *callback);
 
+  // Registers a notification for a cgroup file that takes triggers (e.g.: the
+  // pressure stall information files). The trigger file is kept open and an
+  // event is delivered each time the kernel signals the trigger.
+  //
+  // Arguments:
+  //   cgroup_basepath: The base path to the cgroup_file specified (e.g.:
+  //       /dev/cgroup/unified/test).
+  //   cgroup_file: The cgroup file to write the trigger to (e.g.:
+  //       memory.pressure).
+  //   trigger: The trigger to write (e.g.: "some 150000 1000000").
+  //   callback: The callback to use for event notifications. Must not be a
+  //       nullptr and must be a permanent callback.
+  // Return:
+  //   StatusOr: The status of the operations. Iff OK, it is populated with the
+  //       Handler of the registered notification.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+  RegisterTriggerNotification(const string &cgroup_basepath,
+                              const string &cgroup_file,
+                              const string &trigger, EventCallback *callback);
+
+  // Registers a notification for a cgroup file that signals changes to its
+  // contents (e.g.: cgroup.events). An event is delivered each time the
+  // contents change and include a line equal to match.
+  //
+  // Arguments:
+  //   cgroup_basepath: The base path to the cgroup_file specified (e.g.:
+  //       /dev/cgroup/unified/test).
+  //   cgroup_file: The cgroup file to watch (e.g.: cgroup.events).
+  //   match: The line the contents must include (e.g.: "populated 0").
+  //   callback: The callback to use for event notifications. Must not be a
+  //       nullptr and must be a permanent callback.
+  // Return:
+  //   StatusOr: The status of the operations. Iff OK, it is populated with the
+  //       Handler of the registered notification.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+  RegisterWatchNotification(const string &cgroup_basepath,
+                            const string &cgroup_file, const string &match,
+                            EventCallback *callback);
+
+  // Registers a notification for the release of a cgroup v1 cgroup, which the
+  // kernel reports through the lmctfy release agent once the cgroup is empty
+  // (see lmctfy/release_agent/release_agent.h). The releases are read from a
+  // release agent FIFO of this instance, which is created the first time a
+  // notification is registered and removed when this instance is destroyed.
+  //
+  // Arguments:
+  //   release_path: The path of the cgroup relative to the root of its
+  //       hierarchy, as reported by the release agent (e.g.: /test).
+  //   callback: The callback to use for event notifications. Must not be a
+  //       nullptr and must be a permanent callback.
+  // Return:
+  //   StatusOr: The status of the operations. Iff OK, it is populated with the
+  //       Handler of the registered notification.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+  RegisterReleaseNotification(const string &release_path,
+                              EventCallback *callback)
+      LOCKS_EXCLUDED(release_lock_);
+
  private:
+  // Common implementation of RegisterNotification(),
+  // RegisterTriggerNotification() and RegisterWatchNotification().
+  ::util::StatusOr<ActiveNotifications::Handle> Register(
+      const string &cgroup_basepath, const string &cgroup_file,
+      const string &args, ::util::EventInfo::Type type, const string &match,
+      EventCallback *callback);
+
+  // Creates the release agent FIFO and starts reading from it, if not already
+  // done.
+  ::util::Status SetUpReleaseAgentFifo()
+      EXCLUSIVE_LOCKS_REQUIRED(release_lock_);
+
   // Active notifications.
   ActiveNotifications *active_notifications_;
 
@@ -74,6 +149,19 @@ class EventFdNotifications {
   // Created event receivers.
   ::std::vector<EventReceiver *> event_receivers_;
 
+  const ::system_api::KernelAPI *kernel_;
+
+  // Dispatches the releases read from the release agent FIFO, nullptr until the
+  // FIFO is read from.
+  ::std::unique_ptr<ReleaseDispatcher> release_dispatcher_
+      GUARDED_BY(release_lock_);
+
+  // Name of the release agent FIFO of this instance in kReleaseAgentDir, empty
+  // until it is created.
+  string release_fifo_ GUARDED_BY(release_lock_);
+
+  Mutex release_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(EventFdNotifications);
 };
 
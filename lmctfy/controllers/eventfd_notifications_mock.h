@@ -46,6 +46,17 @@ class MockEventFdNotifications : public EventFdNotifications {
                ::util::StatusOr<ActiveNotifications::Handle>(
                    const string &cgroup_basepath, const string &cgroup_file,
                    const string &args, EventCallback *callback));
+  MOCK_METHOD4(RegisterTriggerNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   const string &cgroup_basepath, const string &cgroup_file,
+                   const string &trigger, EventCallback *callback));
+  MOCK_METHOD4(RegisterWatchNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   const string &cgroup_basepath, const string &cgroup_file,
+                   const string &match, EventCallback *callback));
+  MOCK_METHOD2(RegisterReleaseNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   const string &release_path, EventCallback *callback));
 
  protected:
   // It is okay to use a fake active_notifications since it is unused by the
@@ -54,7 +65,7 @@ class MockEventFdNotifications : public EventFdNotifications {
                            ::util::EventfdListener *event_listener)
       : EventFdNotifications(
             reinterpret_cast<ActiveNotifications *>(0xFFFFFFFF),
-            event_listener),
+            event_listener, mock_kernel),
         mock_kernel_(mock_kernel) {}
 
  private:
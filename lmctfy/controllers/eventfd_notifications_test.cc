@@ -14,6 +14,9 @@
 
 #include "lmctfy/controllers/eventfd_notifications.h"
 
+#include <errno.h>
+#include <unistd.h>
+
 #include <memory>
 #include <string>
 using ::std::string;
@@ -22,15 +25,23 @@ using ::std::string;
 #include "system_api/kernel_api_mock.h"
 #include "lmctfy/active_notifications.h"
 #include "util/errors_test_util.h"
+#include "strings/substitute.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+using ::util::EventReceiverInterface;
 using ::util::EventfdListener;
 using ::util::MockEventfdListener;
 using ::system_api::KernelAPIMock;
 using ::std::unique_ptr;
+using ::strings::Substitute;
+using ::testing::DoAll;
 using ::testing::NotNull;
 using ::testing::Return;
+using ::testing::SaveArg;
+using ::testing::SetErrnoAndReturn;
+using ::testing::StartsWith;
+using ::testing::StrEq;
 using ::testing::StrictMock;
 using ::testing::_;
 using ::util::Status;
@@ -59,7 +70,8 @@ class EventfdNotificationsTest : public ::testing::Test {
         .WillRepeatedly(Return(true));
 
     notifications_.reset(new EventFdNotifications(active_notifications_.get(),
-                                                  mock_eventfd_listener_));
+                                                  mock_eventfd_listener_,
+                                                  mock_kernel_.get()));
   }
 
  protected:
@@ -74,6 +86,12 @@ void EventCallback(Status status) {
   CHECK(false) << "Should never be called";
 }
 
+// Callback that counts the events delivered to it.
+void CountingEventCallback(int *count, Status status) {
+  EXPECT_TRUE(status.ok());
+  ++*count;
+}
+
 TEST_F(EventfdNotificationsTest, RegisterNotificationSuccess) {
   EXPECT_CALL(*mock_eventfd_listener_, Add(kCgroupPath, kCgroupFile, kArg, "",
                                            NotNull())).WillOnce(Return(true));
@@ -105,6 +123,173 @@ TEST_F(EventfdNotificationsTest, RegisterNotificationBadCallback) {
                "not a repeatable callback");
 }
 
+TEST_F(EventfdNotificationsTest, RegisterTriggerNotificationSuccess) {
+  EXPECT_CALL(*mock_eventfd_listener_,
+              AddTrigger(kCgroupPath, "memory.pressure", "some 1000 500000", "",
+                         NotNull())).WillOnce(Return(true));
+  EXPECT_CALL(*mock_eventfd_listener_, Start())
+      .WillOnce(Return());
+
+  StatusOr<ActiveNotifications::Handle> statusor =
+      notifications_->RegisterTriggerNotification(
+          kCgroupPath, "memory.pressure", "some 1000 500000",
+          NewPermanentCallback(&EventCallback));
+  ASSERT_OK(statusor);
+  EXPECT_LT(0, statusor.ValueOrDie());
+}
+
+TEST_F(EventfdNotificationsTest, RegisterTriggerNotificationFails) {
+  EXPECT_CALL(*mock_eventfd_listener_,
+              AddTrigger(kCgroupPath, "memory.pressure", "some 1000 500000", "",
+                         NotNull())).WillOnce(Return(false));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    notifications_->RegisterTriggerNotification(
+                        kCgroupPath, "memory.pressure", "some 1000 500000",
+                        NewPermanentCallback(&EventCallback)));
+}
+
+TEST_F(EventfdNotificationsTest, RegisterWatchNotificationSuccess) {
+  EventReceiverInterface *receiver = nullptr;
+  EXPECT_CALL(*mock_eventfd_listener_,
+              AddWatch(kCgroupPath, "cgroup.events", "", NotNull()))
+      .WillOnce(DoAll(SaveArg<3>(&receiver), Return(true)));
+  EXPECT_CALL(*mock_eventfd_listener_, Start())
+      .WillOnce(Return());
+
+  int count = 0;
+  StatusOr<ActiveNotifications::Handle> statusor =
+      notifications_->RegisterWatchNotification(
+          kCgroupPath, "cgroup.events", "populated 0",
+          NewPermanentCallback(&CountingEventCallback, &count));
+  ASSERT_OK(statusor);
+  ASSERT_NE(nullptr, receiver);
+
+  // Only the events with a matching line are delivered.
+  EXPECT_TRUE(receiver->ReportEvent("", "populated 1\nfrozen 0\n"));
+  EXPECT_EQ(0, count);
+  EXPECT_TRUE(receiver->ReportEvent("", "populated 0\nfrozen 0\n"));
+  EXPECT_EQ(1, count);
+
+  // Unregistered notifications are no longer delivered.
+  active_notifications_->Remove(statusor.ValueOrDie());
+  EXPECT_FALSE(receiver->ReportEvent("", "populated 0\nfrozen 0\n"));
+  EXPECT_EQ(1, count);
+}
+
+TEST_F(EventfdNotificationsTest, RegisterWatchNotificationFails) {
+  EXPECT_CALL(*mock_eventfd_listener_,
+              AddWatch(kCgroupPath, "cgroup.events", "", NotNull()))
+      .WillOnce(Return(false));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    notifications_->RegisterWatchNotification(
+                        kCgroupPath, "cgroup.events", "populated 0",
+                        NewPermanentCallback(&EventCallback)));
+}
+
+TEST_F(EventfdNotificationsTest, RegisterReleaseNotificationSuccess) {
+  EventReceiverInterface *receiver = nullptr;
+  const string fifo_prefix = Substitute("release_agent.$0.", getpid());
+  string fifo;
+  EXPECT_CALL(*mock_kernel_, MkDirRecursive("/run/lmctfy"))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              MkFifo(StartsWith("/run/lmctfy/" + fifo_prefix), 0600))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_eventfd_listener_,
+              AddStream("/run/lmctfy", StartsWith(fifo_prefix), "", NotNull()))
+      .WillOnce(DoAll(SaveArg<1>(&fifo), SaveArg<3>(&receiver),
+                      Return(true)));
+  EXPECT_CALL(*mock_eventfd_listener_, Start())
+      .WillOnce(Return());
+
+  int test_count = 0;
+  int other_count = 0;
+  ASSERT_OK(notifications_->RegisterReleaseNotification(
+      "/test", NewPermanentCallback(&CountingEventCallback, &test_count)));
+  // The FIFO is only set up once.
+  ASSERT_OK(notifications_->RegisterReleaseNotification(
+      "/other", NewPermanentCallback(&CountingEventCallback, &other_count)));
+  ASSERT_NE(nullptr, receiver);
+
+  // Releases are delivered by path, even when split across reads.
+  EXPECT_TRUE(receiver->ReportEvent("", "/test\n/ot"));
+  EXPECT_EQ(1, test_count);
+  EXPECT_EQ(0, other_count);
+  EXPECT_TRUE(receiver->ReportEvent("", "her\n/unknown\n"));
+  EXPECT_EQ(1, test_count);
+  EXPECT_EQ(1, other_count);
+
+  // The FIFO is removed with the notifications.
+  EXPECT_CALL(*mock_kernel_, Unlink(StrEq("/run/lmctfy/" + fifo)))
+      .WillOnce(Return(0));
+  notifications_.reset();
+}
+
+TEST_F(EventfdNotificationsTest, RegisterReleaseNotificationFifoPerInstance) {
+  MockEventfdListener *other_listener = new StrictMock<MockEventfdListener>(
+      *mock_kernel_, "other", nullptr, true, 0);
+  EXPECT_CALL(*other_listener, Stop()).WillRepeatedly(Return());
+  EXPECT_CALL(*other_listener, IsNotRunning()).WillRepeatedly(Return(true));
+  unique_ptr<EventFdNotifications> other(new EventFdNotifications(
+      active_notifications_.get(), other_listener, mock_kernel_.get()));
+
+  string fifo;
+  string other_fifo;
+  EXPECT_CALL(*mock_kernel_, MkDirRecursive("/run/lmctfy"))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, MkFifo(NotNull(), 0600))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_eventfd_listener_, AddStream("/run/lmctfy", _, "", _))
+      .WillOnce(DoAll(SaveArg<1>(&fifo), Return(true)));
+  EXPECT_CALL(*mock_eventfd_listener_, Start()).WillOnce(Return());
+  EXPECT_CALL(*other_listener, AddStream("/run/lmctfy", _, "", _))
+      .WillOnce(DoAll(SaveArg<1>(&other_fifo), Return(true)));
+  EXPECT_CALL(*other_listener, Start()).WillOnce(Return());
+
+  // Each instance reads all releases from a FIFO of its own.
+  ASSERT_OK(notifications_->RegisterReleaseNotification(
+      "/test", NewPermanentCallback(&EventCallback)));
+  ASSERT_OK(other->RegisterReleaseNotification(
+      "/test", NewPermanentCallback(&EventCallback)));
+  EXPECT_NE(fifo, other_fifo);
+
+  EXPECT_CALL(*mock_kernel_, Unlink(StrEq("/run/lmctfy/" + fifo)))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, Unlink(StrEq("/run/lmctfy/" + other_fifo)))
+      .WillOnce(Return(0));
+  notifications_.reset();
+  other.reset();
+}
+
+TEST_F(EventfdNotificationsTest, RegisterReleaseNotificationMkFifoFails) {
+  EXPECT_CALL(*mock_kernel_, MkDirRecursive("/run/lmctfy"))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, MkFifo(NotNull(), 0600))
+      .WillOnce(SetErrnoAndReturn(EACCES, -1));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    notifications_->RegisterReleaseNotification(
+                        "/test", NewPermanentCallback(&EventCallback)));
+}
+
+TEST_F(EventfdNotificationsTest, RegisterReleaseNotificationStreamFails) {
+  EXPECT_CALL(*mock_kernel_, MkDirRecursive("/run/lmctfy"))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, MkFifo(NotNull(), 0600))
+      .WillOnce(Return(0));
+  EXPECT_CALL(*mock_eventfd_listener_, AddStream("/run/lmctfy", _, "", _))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*mock_kernel_, Unlink(NotNull()))
+      .WillOnce(Return(0));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    notifications_->RegisterReleaseNotification(
+                        "/test", NewPermanentCallback(&EventCallback)));
+  notifications_.reset();
+}
+
 }  // namespace
 }  // namespace lmctfy
 }  // namespace containers
@@ -14,10 +14,13 @@
 
 #include "lmctfy/controllers/freezer_controller.h"
 
+#include <map>
+
 #include "lmctfy/kernel_files.h"
 #include "util/errors.h"
 #include "strings/substitute.h"
 
+using ::std::map;
 using ::strings::Substitute;
 using ::util::Status;
 using ::util::StatusOr;
@@ -30,6 +33,11 @@ const char kThawed[] = "THAWED";
 const char kFreezing[] = "FREEZING";
 
 bool FreezerController::IsHierarchicalFreezingSupported() const {
+  // Freezing is always hierarchical in the unified hierarchy.
+  if (unified()) {
+    return true;
+  }
+
   StatusOr<int64> statusor =
       GetParamInt(KernelFiles::Freezer::kFreezerParentFreezing);
   if (!statusor.ok() &&
@@ -53,15 +61,35 @@ Status FreezerController::SafeToUpdate() const {
 
 Status FreezerController::Freeze() {
   RETURN_IF_ERROR(SafeToUpdate());
+  if (unified()) {
+    return SetParamBool(KernelFiles::Unified::kFreeze, true);
+  }
   return SetParamString(KernelFiles::Freezer::kFreezerState, kFrozen);
 }
 
 Status FreezerController::Unfreeze() {
   RETURN_IF_ERROR(SafeToUpdate());
+  if (unified()) {
+    return SetParamBool(KernelFiles::Unified::kFreeze, false);
+  }
   return SetParamString(KernelFiles::Freezer::kFreezerState, kThawed);
 }
 
 StatusOr<FreezerState> FreezerController::State() const {
+  // In the unified hierarchy cgroup.freeze is the requested state and the
+  // "frozen" event whether it was reached.
+  if (unified()) {
+    const map<string, int64> events =
+        RETURN_IF_ERROR(GetParamKeyed(KernelFiles::Unified::kEvents));
+    auto it = events.find(KernelFiles::Unified::Events::kFrozen);
+    if (it != events.end() && it->second != 0) {
+      return FreezerState::FROZEN;
+    }
+    const bool freeze =
+        RETURN_IF_ERROR(GetParamBool(KernelFiles::Unified::kFreeze));
+    return freeze ? FreezerState::FREEZING : FreezerState::THAWED;
+  }
+
   string state =
       RETURN_IF_ERROR(GetParamString(KernelFiles::Freezer::kFreezerState));
   if (state == kFrozen) {
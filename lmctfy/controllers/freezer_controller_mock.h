@@ -50,6 +50,12 @@ class MockFreezerController : public FreezerController {
             "", "", false, reinterpret_cast<KernelApi *>(0xFFFFFFFF),
             reinterpret_cast<EventFdNotifications *>(0xFFFFFFFF)) {}
 
+  explicit MockFreezerController(const string &hierarchy_path)
+      : FreezerController(
+            hierarchy_path, "", false,
+            reinterpret_cast<KernelApi *>(0xFFFFFFFF),
+            reinterpret_cast<EventFdNotifications *>(0xFFFFFFFF)) {}
+
   MOCK_METHOD0(Destroy, ::util::Status());
   MOCK_METHOD1(Enter, ::util::Status(pid_t tid));
   MOCK_METHOD2(Delegate, ::util::Status(::util::UnixUid uid,
@@ -57,6 +63,10 @@ class MockFreezerController : public FreezerController {
   MOCK_CONST_METHOD1(PopulateMachineSpec, ::util::Status(MachineSpec *spec));
   MOCK_CONST_METHOD0(GetThreads, ::util::StatusOr< ::std::vector<pid_t>>());
   MOCK_CONST_METHOD0(GetProcesses, ::util::StatusOr< ::std::vector<pid_t>>());
+  MOCK_CONST_METHOD1(VisitThreads,
+                     ::util::Status(const PidVisitor &visitor));
+  MOCK_CONST_METHOD1(VisitProcesses,
+                     ::util::Status(const PidVisitor &visitor));
   MOCK_CONST_METHOD0(GetSubcontainers,
                      ::util::StatusOr< ::std::vector<string>>());
 
@@ -57,6 +57,17 @@ class FreezerControllerStub : public FreezerController {
     return {};
   }
 
+  ::util::Status VisitThreads(const PidVisitor &visitor) const override final {
+    LOG(DFATAL) << "Stub does not expect this method to be called.";
+    return ::util::Status::OK;
+  }
+
+  ::util::Status VisitProcesses(
+      const PidVisitor &visitor) const override final {
+    LOG(DFATAL) << "Stub does not expect this method to be called.";
+    return ::util::Status::OK;
+  }
+
   ::util::StatusOr< ::std::vector<string>> GetSubcontainers() const override
   final {
     LOG(DFATAL) << "Stub does not expect this method to be called.";
@@ -135,6 +135,15 @@ TEST_F(FreezerControllerTest, Freeze_HierarchicalSupported) {
   EXPECT_OK(controller_->Freeze());
 }
 
+TEST_F(FreezerControllerTest, FreezeUnified) {
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*controller_,
+              SetParamString(StrEq(KernelFiles::Unified::kFreeze), "1"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_OK(controller_->Freeze());
+}
+
 TEST_F(FreezerControllerTest, FreezeFails) {
   ExpectNoSubcontainers();
   ExpectHierarchicalFreezeNotSupported();
@@ -170,6 +179,15 @@ TEST_F(FreezerControllerTest, Unfreeze_HierarchicalSupported) {
   EXPECT_OK(controller_->Unfreeze());
 }
 
+TEST_F(FreezerControllerTest, UnfreezeUnified) {
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*controller_,
+              SetParamString(StrEq(KernelFiles::Unified::kFreeze), "0"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_OK(controller_->Unfreeze());
+}
+
 TEST_F(FreezerControllerTest, UnfreezeFails) {
   ExpectNoSubcontainers();
   ExpectHierarchicalFreezeNotSupported();
@@ -211,6 +229,40 @@ TEST_F(FreezerControllerTest, GetFreezerStateFreezing) {
   EXPECT_EQ(FreezerState::FREEZING, statusor.ValueOrDie());
 }
 
+TEST_F(FreezerControllerTest, GetFreezerStateUnifiedFrozen) {
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*controller_, GetParamString(StrEq(KernelFiles::Unified::kEvents)))
+      .WillOnce(Return(string("populated 1\nfrozen 1\n")));
+  StatusOr<FreezerState> statusor = controller_->State();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(FreezerState::FROZEN, statusor.ValueOrDie());
+}
+
+TEST_F(FreezerControllerTest, GetFreezerStateUnifiedFreezing) {
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*controller_, GetParamString(StrEq(KernelFiles::Unified::kEvents)))
+      .WillOnce(Return(string("populated 1\nfrozen 0\n")));
+  EXPECT_CALL(*controller_, GetParamInt(StrEq(KernelFiles::Unified::kFreeze)))
+      .WillOnce(Return(1));
+  StatusOr<FreezerState> statusor = controller_->State();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(FreezerState::FREEZING, statusor.ValueOrDie());
+}
+
+TEST_F(FreezerControllerTest, GetFreezerStateUnifiedThawed) {
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*controller_, GetParamString(StrEq(KernelFiles::Unified::kEvents)))
+      .WillOnce(Return(string("populated 1\nfrozen 0\n")));
+  EXPECT_CALL(*controller_, GetParamInt(StrEq(KernelFiles::Unified::kFreeze)))
+      .WillOnce(Return(0));
+  StatusOr<FreezerState> statusor = controller_->State();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(FreezerState::THAWED, statusor.ValueOrDie());
+}
+
 TEST_F(FreezerControllerTest, GetFreezerStateNotFound) {
   EXPECT_CALL(*controller_, GetParamString(StrEq(kFreezerStatusFile)))
       .WillOnce(Return(Status(NOT_FOUND, "Errrrr")));
@@ -56,8 +56,13 @@ class MockJobController : public JobController {
 
   MOCK_CONST_METHOD0(GetThreads, ::util::StatusOr< ::std::vector<pid_t>>());
   MOCK_CONST_METHOD0(GetProcesses, ::util::StatusOr< ::std::vector<pid_t>>());
+  MOCK_CONST_METHOD1(VisitThreads,
+                     ::util::Status(const PidVisitor &visitor));
+  MOCK_CONST_METHOD1(VisitProcesses,
+                     ::util::Status(const PidVisitor &visitor));
   MOCK_CONST_METHOD0(GetSubcontainers,
                      ::util::StatusOr< ::std::vector<string>>());
+  MOCK_METHOD0(ClearReleaseNotification, ::util::Status());
 };
 
 typedef ::testing::StrictMock<MockJobController> StrictMockJobController;
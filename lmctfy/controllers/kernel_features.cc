@@ -0,0 +1,125 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/kernel_features.h"
+
+#include <unistd.h>
+
+#include "file/base/path.h"
+#include "lmctfy/kernel_files.h"
+
+using ::file::JoinPath;
+using ::std::make_pair;
+
+namespace containers {
+namespace lmctfy {
+
+namespace {
+
+// A cgroup file that only exists in some kernels.
+struct OptionalFile {
+  CgroupHierarchy hierarchy;
+  const char *cgroup_file;
+
+  // Whether the kernel creates the file in the root cgroup of the hierarchy.
+  bool in_root;
+};
+
+const OptionalFile kOptionalFiles[] = {
+    {CGROUP_CPU, KernelFiles::Cpu::kLatency, true},
+    {CGROUP_CPU, KernelFiles::Cpu::kPlacementStrategy, true},
+    {CGROUP_CPU, KernelFiles::Cpu::kThrottlingStats, true},
+    {CGROUP_CPUACCT, KernelFiles::CPUAcct::kHistogram, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::Memsw::kLimitInBytes, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::Memsw::kMaxUsageInBytes, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::Memsw::kUsageInBytes, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kCompressionEnabled, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kCompressionSamplingRatio, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kCompressionSamplingStats, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kCompressionThrashingStats, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kDirtyRatio, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kDirtyBackgroundRatio, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kDirtyLimitInBytes, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kDirtyBackgroundLimitInBytes, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kIdlePageStats, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kOomScoreBadness, true},
+    {CGROUP_MEMORY, KernelFiles::Memory::kStalePageAge, true},
+    {CGROUP_MEMORY, KernelFiles::kOOMDelay, true},
+    // The kernel does not create freezer files in the root cgroup.
+    {CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing, false},
+};
+
+}  // namespace
+
+bool KernelFeatures::IsOptional(CgroupHierarchy hierarchy,
+                                const string &cgroup_file) {
+  for (const OptionalFile &optional_file : kOptionalFiles) {
+    if (optional_file.hierarchy == hierarchy &&
+        cgroup_file == optional_file.cgroup_file) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void KernelFeatures::Detect(const KernelApi *kernel, CgroupHierarchy hierarchy,
+                            const string &mount_path) {
+  for (const OptionalFile &optional_file : kOptionalFiles) {
+    if (optional_file.hierarchy != hierarchy || !optional_file.in_root) {
+      continue;
+    }
+
+    const bool supported =
+        kernel->Access(JoinPath(mount_path, optional_file.cgroup_file),
+                       F_OK) == 0;
+    Record(hierarchy, optional_file.cgroup_file, supported);
+  }
+}
+
+void KernelFeatures::Record(CgroupHierarchy hierarchy,
+                            const string &cgroup_file, bool supported) {
+  if (!IsOptional(hierarchy, cgroup_file)) {
+    return;
+  }
+
+  MutexLock l(&lock_);
+  supported_[make_pair(hierarchy, cgroup_file)] = supported;
+}
+
+bool KernelFeatures::IsMissing(CgroupHierarchy hierarchy,
+                               const string &cgroup_file) const {
+  // Only optional files are recorded, don't take the lock for the others.
+  if (!IsOptional(hierarchy, cgroup_file)) {
+    return false;
+  }
+
+  MutexLock l(&lock_);
+  auto it = supported_.find(make_pair(hierarchy, cgroup_file));
+  return it != supported_.end() && !it->second;
+}
+
+bool KernelFeatures::IsUndetected(CgroupHierarchy hierarchy,
+                                  const string &cgroup_file) const {
+  if (!IsOptional(hierarchy, cgroup_file)) {
+    return false;
+  }
+
+  MutexLock l(&lock_);
+  return supported_.find(make_pair(hierarchy, cgroup_file)) ==
+         supported_.end();
+}
+
+}  // namespace lmctfy
+}  // namespace containers
@@ -0,0 +1,95 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_CONTROLLERS_KERNEL_FEATURES_H_
+#define SRC_CONTROLLERS_KERNEL_FEATURES_H_
+
+#include <map>
+#include <string>
+#include <utility>
+using ::std::string;
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "system_api/kernel_api.h"
+#include "include/config.pb.h"
+
+namespace containers {
+namespace lmctfy {
+
+typedef ::system_api::KernelAPI KernelApi;
+
+// Registry of the optional cgroup files supported by the running kernel.
+//
+// Some cgroup files (e.g.: memory.idle_page_stats, cpuacct.histogram,
+// freezer.parent_freezing) only exist in some kernels. Instead of probing for
+// them on every read or write, their support is detected once per hierarchy and
+// controllers skip the files known to be missing.
+//
+// Optional files that the kernel creates in the root cgroup are detected when
+// the hierarchies are detected (see Detect()). The rest are detected the first
+// time they are used in a container (see Record()). Files that are not
+// optional, or have not been detected yet, are assumed to be supported.
+//
+// Class is thread-safe.
+class KernelFeatures {
+ public:
+  KernelFeatures() {}
+  virtual ~KernelFeatures() {}
+
+  // Whether the specified cgroup file (e.g.: "memory.idle_page_stats") of the
+  // hierarchy is one that may not be supported by the kernel.
+  static bool IsOptional(CgroupHierarchy hierarchy, const string &cgroup_file);
+
+  // Detects which of the optional files of the hierarchy are supported by
+  // looking at its root cgroup.
+  //
+  // Arguments:
+  //   kernel: Wrapper for all kernel calls. Does not take ownership.
+  //   hierarchy: The hierarchy to detect the files of.
+  //   mount_path: The mount point of the hierarchy. e.g.: /dev/cgroup/memory
+  virtual void Detect(const KernelApi *kernel, CgroupHierarchy hierarchy,
+                      const string &mount_path) LOCKS_EXCLUDED(lock_);
+
+  // Records whether an optional file of the hierarchy is supported. No-op for
+  // files that are not optional.
+  virtual void Record(CgroupHierarchy hierarchy, const string &cgroup_file,
+                      bool supported) LOCKS_EXCLUDED(lock_);
+
+  // Whether the specified file of the hierarchy is known not to be supported.
+  virtual bool IsMissing(CgroupHierarchy hierarchy,
+                         const string &cgroup_file) const LOCKS_EXCLUDED(lock_);
+
+  // Whether the specified file of the hierarchy is optional and its support
+  // has not been detected yet.
+  virtual bool IsUndetected(CgroupHierarchy hierarchy,
+                            const string &cgroup_file) const
+      LOCKS_EXCLUDED(lock_);
+
+ private:
+  // Map of hierarchy and optional file to whether the file is supported. Files
+  // not in the map have not been detected.
+  ::std::map< ::std::pair<CgroupHierarchy, string>, bool> supported_
+      GUARDED_BY(lock_);
+
+  mutable Mutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(KernelFeatures);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_CONTROLLERS_KERNEL_FEATURES_H_
@@ -0,0 +1,121 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/kernel_features.h"
+
+#include <unistd.h>
+
+#include <memory>
+
+#include "system_api/kernel_api_mock.h"
+#include "lmctfy/kernel_files.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::system_api::KernelAPIMock;
+using ::std::unique_ptr;
+using ::testing::Return;
+using ::testing::StrictMock;
+using ::testing::_;
+
+namespace containers {
+namespace lmctfy {
+
+static const char kMemoryMount[] = "/dev/cgroup/memory";
+static const char kFreezerMount[] = "/dev/cgroup/freezer";
+
+class KernelFeaturesTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    mock_kernel_.reset(new StrictMock<KernelAPIMock>());
+  }
+
+ protected:
+  unique_ptr<KernelAPIMock> mock_kernel_;
+  KernelFeatures features_;
+};
+
+TEST_F(KernelFeaturesTest, IsOptional) {
+  EXPECT_TRUE(KernelFeatures::IsOptional(
+      CGROUP_MEMORY, KernelFiles::Memory::kIdlePageStats));
+  EXPECT_TRUE(KernelFeatures::IsOptional(
+      CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing));
+  EXPECT_FALSE(KernelFeatures::IsOptional(
+      CGROUP_MEMORY, KernelFiles::Memory::kLimitInBytes));
+
+  // Files are optional in their own hierarchy only.
+  EXPECT_FALSE(KernelFeatures::IsOptional(
+      CGROUP_CPU, KernelFiles::Memory::kIdlePageStats));
+}
+
+TEST_F(KernelFeaturesTest, Detect) {
+  EXPECT_CALL(*mock_kernel_, Access(_, F_OK)).WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_,
+              Access("/dev/cgroup/memory/memory.idle_page_stats", F_OK))
+      .WillOnce(Return(-1));
+
+  features_.Detect(mock_kernel_.get(), CGROUP_MEMORY, kMemoryMount);
+
+  EXPECT_TRUE(
+      features_.IsMissing(CGROUP_MEMORY, KernelFiles::Memory::kIdlePageStats));
+  EXPECT_FALSE(features_.IsUndetected(CGROUP_MEMORY,
+                                      KernelFiles::Memory::kIdlePageStats));
+  EXPECT_FALSE(
+      features_.IsMissing(CGROUP_MEMORY, KernelFiles::Memory::kStalePageAge));
+  EXPECT_FALSE(features_.IsUndetected(CGROUP_MEMORY,
+                                      KernelFiles::Memory::kStalePageAge));
+
+  // Other hierarchies are not detected.
+  EXPECT_TRUE(features_.IsUndetected(CGROUP_CPUACCT,
+                                     KernelFiles::CPUAcct::kHistogram));
+}
+
+TEST_F(KernelFeaturesTest, DetectSkipsFilesNotInRoot) {
+  // Nothing is accessed.
+  features_.Detect(mock_kernel_.get(), CGROUP_FREEZER, kFreezerMount);
+
+  EXPECT_TRUE(features_.IsUndetected(
+      CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing));
+  EXPECT_FALSE(features_.IsMissing(
+      CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing));
+}
+
+TEST_F(KernelFeaturesTest, Record) {
+  EXPECT_TRUE(features_.IsUndetected(
+      CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing));
+
+  features_.Record(CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing,
+                   false);
+  EXPECT_TRUE(features_.IsMissing(
+      CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing));
+  EXPECT_FALSE(features_.IsUndetected(
+      CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing));
+
+  features_.Record(CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing,
+                   true);
+  EXPECT_FALSE(features_.IsMissing(
+      CGROUP_FREEZER, KernelFiles::Freezer::kFreezerParentFreezing));
+}
+
+TEST_F(KernelFeaturesTest, RecordIgnoresFilesThatAreNotOptional) {
+  features_.Record(CGROUP_MEMORY, KernelFiles::Memory::kLimitInBytes, false);
+
+  EXPECT_FALSE(
+      features_.IsMissing(CGROUP_MEMORY, KernelFiles::Memory::kLimitInBytes));
+  EXPECT_FALSE(features_.IsUndetected(CGROUP_MEMORY,
+                                      KernelFiles::Memory::kLimitInBytes));
+}
+
+}  // namespace lmctfy
+}  // namespace containers
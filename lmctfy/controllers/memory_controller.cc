@@ -68,11 +68,22 @@ static Bytes ModifyLimit(Bytes limit) {
   return limit;
 }
 
+// In the unified hierarchy the soft limit is memory.low: like the v1 soft
+// limit, usage above it is reclaimed first under memory pressure. memory.high
+// is not used since it throttles the container even without pressure.
 Status MemoryController::SetLimit(Bytes limit) {
+  if (unified()) {
+    return SetParamLimit(KernelFiles::Unified::Memory::kMax,
+                         ModifyLimit(limit).value());
+  }
   return SetParamBytes(KernelFiles::Memory::kLimitInBytes, ModifyLimit(limit));
 }
 
 Status MemoryController::SetSoftLimit(Bytes limit) {
+  if (unified()) {
+    return SetParamLimit(KernelFiles::Unified::Memory::kLow,
+                         ModifyLimit(limit).value());
+  }
   return SetParamBytes(KernelFiles::Memory::kSoftLimitInBytes,
                        ModifyLimit(limit));
 }
@@ -123,113 +134,130 @@ StatusOr<Bytes> MemoryController::GetStaleBytes() const {
   return Bytes(stale);
 }
 
-StatusOr<Bytes> MemoryController::GetInactiveBytes() const {
-  map<string, int64> stats =
-      RETURN_IF_ERROR(GetStats(KernelFiles::Memory::kStat));
-  int64 inactive_anon = RETURN_IF_ERROR(GetValueFromStats(stats,
-      KernelFiles::Memory::Stat::kTotalInactiveAnon));
-
-  int64 inactive_file = RETURN_IF_ERROR(GetValueFromStats(stats,
-      KernelFiles::Memory::Stat::kTotalInactiveFile));
+StatusOr<Bytes> MemoryController::GetInactiveBytes(
+    const MemoryStatSnapshot &snapshot) const {
+  int64 inactive_anon = RETURN_IF_ERROR(
+      snapshot.Get(MemoryStatSnapshot::HIERARCHICAL,
+                   MemoryStatSnapshot::STAT_inactive_anon));
+  int64 inactive_file = RETURN_IF_ERROR(
+      snapshot.Get(MemoryStatSnapshot::HIERARCHICAL,
+                   MemoryStatSnapshot::STAT_inactive_file));
   return Bytes(inactive_anon + inactive_file);
 }
 
+Status MemoryController::GetMemoryStatSnapshot(
+    MemoryStatSnapshot *snapshot) const {
+  string contents =
+      RETURN_IF_ERROR(GetParamString(KernelFiles::Memory::kStat));
+  if (unified()) {
+    return snapshot->ParseUnified(contents);
+  }
+  return snapshot->Parse(contents);
+}
+
 // POPULATE_STAT requires the proto buffer field name to match the post-prefix
 // part of the stat name.
-#define POPULATE_STAT(stats, prefix, output, name)         \
-{                                                          \
-  int64 val;                                               \
-  if (GetStatFromMap(stats, prefix + #name, &val)) {  \
-    output->set_##name(val);                               \
-  }                                                        \
+#define POPULATE_STAT(snapshot, scope, output, prefix, name)                \
+{                                                                           \
+  int64 val;                                                                \
+  if (snapshot.Get(scope, MemoryStatSnapshot::STAT_##prefix##name, &val)) { \
+    output->set_##name(val);                                                \
+  }                                                                         \
+}
+
+#define POPULATE_KERNEL_STATS(snapshot, scope, output, prefix)          \
+{                                                                       \
+  POPULATE_STAT(snapshot, scope, output, prefix, memory);               \
+  POPULATE_STAT(snapshot, scope, output, prefix, slab_memory);          \
+  POPULATE_STAT(snapshot, scope, output, prefix, stack_memory);         \
+  POPULATE_STAT(snapshot, scope, output, prefix, pgtable_memory);       \
+  POPULATE_STAT(snapshot, scope, output, prefix, vmalloc_memory);       \
+  POPULATE_STAT(snapshot, scope, output, prefix, misc_memory);          \
+  POPULATE_STAT(snapshot, scope, output, prefix, targeted_slab_memory); \
+  POPULATE_STAT(snapshot, scope, output, prefix, compressed_memory);    \
 }
 
 namespace {
-bool GetStatFromMap(const map<string, int64> &stats, const string &key,
-                    int64 *val) {
-  const auto it = stats.find(key);
-  if (it == stats.end()) return false;
-  *val = it->second;
-  return true;
-}
-
-void ProcessKernelStats(const map<string, int64> &stats,
-                        const string &prefix,
-                        MemoryStats_MemoryData_Kernel *output) {
-  POPULATE_STAT(stats, prefix, output, memory);
-  POPULATE_STAT(stats, prefix, output, slab_memory);
-  POPULATE_STAT(stats, prefix, output, stack_memory);
-  POPULATE_STAT(stats, prefix, output, pgtable_memory);
-  POPULATE_STAT(stats, prefix, output, vmalloc_memory);
-  POPULATE_STAT(stats, prefix, output, misc_memory);
-  POPULATE_STAT(stats, prefix, output, targeted_slab_memory);
-  POPULATE_STAT(stats, prefix, output, compressed_memory);
-}
-
-void ProcessThpStats(const map<string, int64> &stats,
-                     const string &prefix,
+void ProcessThpStats(const MemoryStatSnapshot &snapshot,
+                     MemoryStatSnapshot::Scope scope,
                      MemoryStats_MemoryData_THP *output) {
-  POPULATE_STAT(stats, prefix, output, fault_alloc);
-  POPULATE_STAT(stats, prefix, output, fault_fallback);
-  POPULATE_STAT(stats, prefix, output, collapse_alloc);
-  POPULATE_STAT(stats, prefix, output, collapse_alloc_failed);
-  POPULATE_STAT(stats, prefix, output, split);
+  POPULATE_STAT(snapshot, scope, output, thp_, fault_alloc);
+  POPULATE_STAT(snapshot, scope, output, thp_, fault_fallback);
+  POPULATE_STAT(snapshot, scope, output, thp_, collapse_alloc);
+  POPULATE_STAT(snapshot, scope, output, thp_, collapse_alloc_failed);
+  POPULATE_STAT(snapshot, scope, output, thp_, split);
 }
 
-void ProcessMemoryStats(const map<string, int64> &stats,
-                        const string &prefix,
+void ProcessMemoryStats(const MemoryStatSnapshot &snapshot,
+                        MemoryStatSnapshot::Scope scope,
                         MemoryStats_MemoryData *output) {
-  POPULATE_STAT(stats, prefix, output, cache);
-  POPULATE_STAT(stats, prefix, output, rss);
-  POPULATE_STAT(stats, prefix, output, rss_huge);
-  POPULATE_STAT(stats, prefix, output, mapped_file);
-  POPULATE_STAT(stats, prefix, output, pgpgin);
-  POPULATE_STAT(stats, prefix, output, pgfault);
-  POPULATE_STAT(stats, prefix, output, pgmajfault);
-  POPULATE_STAT(stats, prefix, output, dirty);
-  POPULATE_STAT(stats, prefix, output, writeback);
-  POPULATE_STAT(stats, prefix, output, inactive_anon);
-  POPULATE_STAT(stats, prefix, output, active_anon);
-  POPULATE_STAT(stats, prefix, output, inactive_file);
-  POPULATE_STAT(stats, prefix, output, active_file);
-  POPULATE_STAT(stats, prefix, output, unevictable);
-
-  ProcessThpStats(stats, prefix + "thp_", output->mutable_thp());
-
-  ProcessKernelStats(stats, prefix + "kernel_", output->mutable_kernel());
-  ProcessKernelStats(stats, prefix + "kernel_noncharged_",
-                     output->mutable_kernel_noncharged());
-
-  POPULATE_STAT(stats, prefix, output, compressed_pool_pages);
-  POPULATE_STAT(stats, prefix, output, compressed_stored_pages);
-  POPULATE_STAT(stats, prefix, output, compressed_reject_compress_poor);
-  POPULATE_STAT(stats, prefix, output, zswap_zsmalloc_fail);
-  POPULATE_STAT(stats, prefix, output, zswap_kmemcache_fail);
-  POPULATE_STAT(stats, prefix, output, zswap_duplicate_entry);
-  POPULATE_STAT(stats, prefix, output, zswap_compressed_pages);
-  POPULATE_STAT(stats, prefix, output, zswap_decompressed_pages);
-  POPULATE_STAT(stats, prefix, output, zswap_compression_nsec);
-  POPULATE_STAT(stats, prefix, output, zswap_decompression_nsec);
-  POPULATE_STAT(stats, prefix, output, cache);
+  POPULATE_STAT(snapshot, scope, output, , cache);
+  POPULATE_STAT(snapshot, scope, output, , rss);
+  POPULATE_STAT(snapshot, scope, output, , rss_huge);
+  POPULATE_STAT(snapshot, scope, output, , mapped_file);
+  POPULATE_STAT(snapshot, scope, output, , pgpgin);
+  POPULATE_STAT(snapshot, scope, output, , pgfault);
+  POPULATE_STAT(snapshot, scope, output, , pgmajfault);
+  POPULATE_STAT(snapshot, scope, output, , dirty);
+  POPULATE_STAT(snapshot, scope, output, , writeback);
+  POPULATE_STAT(snapshot, scope, output, , inactive_anon);
+  POPULATE_STAT(snapshot, scope, output, , active_anon);
+  POPULATE_STAT(snapshot, scope, output, , inactive_file);
+  POPULATE_STAT(snapshot, scope, output, , active_file);
+  POPULATE_STAT(snapshot, scope, output, , unevictable);
+
+  ProcessThpStats(snapshot, scope, output->mutable_thp());
+
+  POPULATE_KERNEL_STATS(snapshot, scope, output->mutable_kernel(), kernel_);
+  POPULATE_KERNEL_STATS(snapshot, scope, output->mutable_kernel_noncharged(),
+                        kernel_noncharged_);
+
+  POPULATE_STAT(snapshot, scope, output, , compressed_pool_pages);
+  POPULATE_STAT(snapshot, scope, output, , compressed_stored_pages);
+  POPULATE_STAT(snapshot, scope, output, , compressed_reject_compress_poor);
+  POPULATE_STAT(snapshot, scope, output, , zswap_zsmalloc_fail);
+  POPULATE_STAT(snapshot, scope, output, , zswap_kmemcache_fail);
+  POPULATE_STAT(snapshot, scope, output, , zswap_duplicate_entry);
+  POPULATE_STAT(snapshot, scope, output, , zswap_compressed_pages);
+  POPULATE_STAT(snapshot, scope, output, , zswap_decompressed_pages);
+  POPULATE_STAT(snapshot, scope, output, , zswap_compression_nsec);
+  POPULATE_STAT(snapshot, scope, output, , zswap_decompression_nsec);
 }
 
 }  // namespace
 
 Status MemoryController::GetMemoryStats(MemoryStats *memory_stats) const {
-  map<string, int64> stats =
-      RETURN_IF_ERROR(GetStats(KernelFiles::Memory::kStat));
-  ProcessMemoryStats(stats, "", memory_stats->mutable_container_data());
-  ProcessMemoryStats(stats, "total_",
+  MemoryStatSnapshot snapshot;
+  RETURN_IF_ERROR(GetMemoryStatSnapshot(&snapshot));
+  return GetMemoryStats(snapshot, memory_stats);
+}
+
+Status MemoryController::GetMemoryStats(const MemoryStatSnapshot &snapshot,
+                                        MemoryStats *memory_stats) const {
+  ProcessMemoryStats(snapshot, MemoryStatSnapshot::CONTAINER,
+                     memory_stats->mutable_container_data());
+  ProcessMemoryStats(snapshot, MemoryStatSnapshot::HIERARCHICAL,
                      memory_stats->mutable_hierarchical_data());
-  POPULATE_STAT(stats, , memory_stats, hierarchical_memory_limit);
+  POPULATE_STAT(snapshot, MemoryStatSnapshot::CONTAINER, memory_stats, ,
+                hierarchical_memory_limit);
   return Status::OK;
 }
+#undef POPULATE_KERNEL_STATS
 #undef POPULATE_STAT
 
 StatusOr<Bytes> MemoryController::GetWorkingSet() const {
+  return ComputeWorkingSet(nullptr);
+}
+
+StatusOr<Bytes> MemoryController::GetWorkingSet(
+    const MemoryStatSnapshot &snapshot) const {
+  return ComputeWorkingSet(&snapshot);
+}
+
+StatusOr<Bytes> MemoryController::ComputeWorkingSet(
+    const MemoryStatSnapshot *snapshot) const {
   // Get usage in bytes.
-  Bytes usage_in_bytes =
-      RETURN_IF_ERROR(GetParamBytes(KernelFiles::Memory::kUsageInBytes));
+  Bytes usage_in_bytes = RETURN_IF_ERROR(GetUsage());
 
   // Get stale bytes
   StatusOr<Bytes> statusor_stale = GetStaleBytes();
@@ -239,7 +267,12 @@ StatusOr<Bytes> MemoryController::GetWorkingSet() const {
     } else {
       // Either the idle page stat file is not found, or entry for stale pages
       // in the file is not found. Use total inactive bytes.
-      statusor_stale = RETURN_IF_ERROR(GetInactiveBytes());
+      MemoryStatSnapshot read_snapshot;
+      if (snapshot == nullptr) {
+        RETURN_IF_ERROR(GetMemoryStatSnapshot(&read_snapshot));
+        snapshot = &read_snapshot;
+      }
+      statusor_stale = RETURN_IF_ERROR(GetInactiveBytes(*snapshot));
     }
   }
   Bytes stale = Bytes(statusor_stale.ValueOrDie());
@@ -249,10 +282,16 @@ StatusOr<Bytes> MemoryController::GetWorkingSet() const {
 }
 
 StatusOr<Bytes> MemoryController::GetUsage() const {
+  if (unified()) {
+    return GetParamBytes(KernelFiles::Unified::Memory::kCurrent);
+  }
   return GetParamBytes(KernelFiles::Memory::kUsageInBytes);
 }
 
 StatusOr<Bytes> MemoryController::GetMaxUsage() const {
+  if (unified()) {
+    return GetParamBytes(KernelFiles::Unified::Memory::kPeak);
+  }
   return GetParamBytes(KernelFiles::Memory::kMaxUsageInBytes);
 }
 
@@ -265,27 +304,43 @@ StatusOr<Bytes> MemoryController::GetSwapLimit() const {
 }
 
 StatusOr<Bytes> MemoryController::GetLimit() const {
+  if (unified()) {
+    return Bytes(
+        RETURN_IF_ERROR(GetParamLimit(KernelFiles::Unified::Memory::kMax)));
+  }
   return GetParamBytes(KernelFiles::Memory::kLimitInBytes);
 }
 
 StatusOr<Bytes> MemoryController::GetEffectiveLimit() const {
-  StatusOr<map<string, int64>> statusor = GetStats(KernelFiles::Memory::kStat);
-  if (!statusor.ok()) {
-    return statusor.status();
+  // The memory.stat of the unified hierarchy has no hierarchical limit, only
+  // the container's own limit is reported.
+  if (unified()) {
+    return GetLimit();
   }
 
-  // Get the hierarchical memory limit from the memory stats.
-  StatusOr<int64> statusor_stat =
-      GetValueFromStats(statusor.ValueOrDie(),
-                        KernelFiles::Memory::Stat::kHierarchicalMemoryLimit);
-  if (!statusor_stat.ok()) {
-    return statusor_stat.status();
+  MemoryStatSnapshot snapshot;
+  RETURN_IF_ERROR(GetMemoryStatSnapshot(&snapshot));
+  return GetEffectiveLimit(snapshot);
+}
+
+StatusOr<Bytes> MemoryController::GetEffectiveLimit(
+    const MemoryStatSnapshot &snapshot) const {
+  if (unified()) {
+    return GetLimit();
   }
 
-  return Bytes(statusor_stat.ValueOrDie());
+  // Get the hierarchical memory limit from the memory stats.
+  int64 limit = RETURN_IF_ERROR(
+      snapshot.Get(MemoryStatSnapshot::CONTAINER,
+                   MemoryStatSnapshot::STAT_hierarchical_memory_limit));
+  return Bytes(limit);
 }
 
 StatusOr<Bytes> MemoryController::GetSoftLimit() const {
+  if (unified()) {
+    return Bytes(
+        RETURN_IF_ERROR(GetParamLimit(KernelFiles::Unified::Memory::kLow)));
+  }
   return GetParamBytes(KernelFiles::Memory::kSoftLimitInBytes);
 }
 
@@ -580,9 +635,28 @@ Status MemoryController::GetCompressionSamplingStats(
 }
 
 StatusOr<int64> MemoryController::GetFailCount() const {
+  // The unified hierarchy counts the times the limit was hit in the "max"
+  // event.
+  if (unified()) {
+    const map<string, int64> events =
+        RETURN_IF_ERROR(GetParamKeyed(KernelFiles::Unified::Memory::kEvents));
+    return GetValueFromStats(events, "max");
+  }
   return GetParamInt(KernelFiles::Memory::kFailCount);
 }
 
+StatusOr<PressureData> MemoryController::GetPressure() const {
+  return GetParamPressure(KernelFiles::Unified::Memory::kPressure);
+}
+
+StatusOr<ActiveNotifications::Handle>
+MemoryController::RegisterPressureNotification(
+    const EventSpec::PressureThreshold &threshold,
+    CgroupController::EventCallback *callback) {
+  return CgroupController::RegisterPressureNotification(
+      KernelFiles::Unified::Memory::kPressure, threshold, callback);
+}
+
 StatusOr<int64> MemoryController::GetValueFromStats(
     const map<string, int64> &stats, const string &value) const {
   auto it = stats.find(value);
@@ -22,6 +22,7 @@ using ::std::string;
 #include "base/integral_types.h"
 #include "base/macros.h"
 #include "lmctfy/controllers/cgroup_controller.h"
+#include "lmctfy/controllers/memory_stat_snapshot.h"
 #include "include/lmctfy.pb.h"
 #include "util/safe_types/bytes.h"
 #include "util/task/statusor.h"
@@ -95,6 +96,10 @@ class MemoryController : public CgroupController {
   // Gets the working set of this cgroup. This is the currently hot memory.
   virtual ::util::StatusOr<::util::Bytes> GetWorkingSet() const;
 
+  // Same as GetWorkingSet(), but takes any memory.stat values from snapshot.
+  virtual ::util::StatusOr<::util::Bytes> GetWorkingSet(
+      const MemoryStatSnapshot &snapshot) const;
+
   // Gets the raw usage of this cgroup.
   virtual ::util::StatusOr<::util::Bytes> GetUsage() const;
 
@@ -117,6 +122,10 @@ class MemoryController : public CgroupController {
   // of the effective memory limit.
   virtual ::util::StatusOr<::util::Bytes> GetEffectiveLimit() const;
 
+  // Same as GetEffectiveLimit(), but takes the limit from snapshot.
+  virtual ::util::StatusOr<::util::Bytes> GetEffectiveLimit(
+      const MemoryStatSnapshot &snapshot) const;
+
   // Gets the reserved memory or "soft limit" for this cgroup.
   virtual ::util::StatusOr<::util::Bytes> GetSoftLimit() const;
 
@@ -153,9 +162,19 @@ class MemoryController : public CgroupController {
           ::util::Bytes usage_threshold,
           CgroupController::EventCallback *callback);
 
+  // Reads the memory.stat file into snapshot. Statistics derived from
+  // memory.stat can then share the snapshot instead of each re-reading the
+  // file.
+  virtual ::util::Status GetMemoryStatSnapshot(
+      MemoryStatSnapshot *snapshot) const;
+
   // Get all stats from the memory.stat file
   virtual ::util::Status GetMemoryStats(MemoryStats *memory_stats) const;
 
+  // Same as GetMemoryStats(), but takes the stats from snapshot.
+  virtual ::util::Status GetMemoryStats(const MemoryStatSnapshot &snapshot,
+                                        MemoryStats *memory_stats) const;
+
   // Get all stats from the memory.numa_stat file
   virtual ::util::Status GetNumaStats(MemoryStats_NumaStats *numa_stats) const;
 
@@ -168,6 +187,18 @@ class MemoryController : public CgroupController {
 
   virtual ::util::StatusOr<int64> GetFailCount() const;
 
+  // Gets the memory pressure stall information of this cgroup. Only available
+  // in the unified hierarchy.
+  virtual ::util::StatusOr<PressureData> GetPressure() const;
+
+  // Registers a notification for when the memory stall time of this cgroup
+  // goes above the threshold. The handler for the event is returned on
+  // success.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+      RegisterPressureNotification(
+          const EventSpec::PressureThreshold &threshold,
+          CgroupController::EventCallback *callback);
+
  private:
   // Gets a mapping of field_name to integer value of the specified stats file.
   //
@@ -192,7 +223,13 @@ class MemoryController : public CgroupController {
   ::util::StatusOr<::util::Bytes> GetStaleBytes() const;
 
   // Gets the total inactive bytes (file and anonymous).
-  ::util::StatusOr<::util::Bytes> GetInactiveBytes() const;
+  ::util::StatusOr<::util::Bytes> GetInactiveBytes(
+      const MemoryStatSnapshot &snapshot) const;
+
+  // Implementation of GetWorkingSet(). If snapshot is nullptr, memory.stat is
+  // only read if it is needed.
+  ::util::StatusOr<::util::Bytes> ComputeWorkingSet(
+      const MemoryStatSnapshot *snapshot) const;
 
   // Gets the specified value from the specified stats if it is available.
   ::util::StatusOr<int64> GetValueFromStats(
@@ -65,6 +65,9 @@ class MockMemoryController : public MemoryController {
 
   MOCK_CONST_METHOD0(GetWorkingSet,
                      ::util::StatusOr<::util::Bytes>());
+  MOCK_CONST_METHOD1(GetWorkingSet,
+                     ::util::StatusOr<::util::Bytes>(
+                         const MemoryStatSnapshot &snapshot));
   MOCK_CONST_METHOD0(GetUsage, ::util::StatusOr<::util::Bytes>());
   MOCK_CONST_METHOD0(GetMaxUsage,
                      ::util::StatusOr<::util::Bytes>());
@@ -75,6 +78,9 @@ class MockMemoryController : public MemoryController {
   MOCK_CONST_METHOD0(GetLimit, ::util::StatusOr<::util::Bytes>());
   MOCK_CONST_METHOD0(GetEffectiveLimit,
                      ::util::StatusOr<::util::Bytes>());
+  MOCK_CONST_METHOD1(GetEffectiveLimit,
+                     ::util::StatusOr<::util::Bytes>(
+                         const MemoryStatSnapshot &snapshot));
   MOCK_CONST_METHOD0(GetSoftLimit,
                      ::util::StatusOr<::util::Bytes>());
   MOCK_CONST_METHOD0(GetSwapLimit,
@@ -96,7 +102,12 @@ class MockMemoryController : public MemoryController {
   MOCK_METHOD1(RegisterOomNotification,
                ::util::StatusOr<ActiveNotifications::Handle>(
                    CgroupController::EventCallback *callback));
+  MOCK_CONST_METHOD1(GetMemoryStatSnapshot,
+                     ::util::Status(MemoryStatSnapshot *snapshot));
   MOCK_CONST_METHOD1(GetMemoryStats, ::util::Status(MemoryStats *stats));
+  MOCK_CONST_METHOD2(GetMemoryStats,
+                     ::util::Status(const MemoryStatSnapshot &snapshot,
+                                    MemoryStats *stats));
   MOCK_CONST_METHOD1(GetNumaStats,
                      ::util::Status(MemoryStats_NumaStats *numa_stats));
   MOCK_CONST_METHOD1(GetIdlePageStats,
@@ -106,6 +117,11 @@ class MockMemoryController : public MemoryController {
                      ::util::Status(MemoryStats_CompressionSamplingStats
                                         *compression_sampling_stats));
   MOCK_CONST_METHOD0(GetFailCount, ::util::StatusOr<int64>());
+  MOCK_CONST_METHOD0(GetPressure, ::util::StatusOr<PressureData>());
+  MOCK_METHOD2(RegisterPressureNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   const EventSpec::PressureThreshold &threshold,
+                   CgroupController::EventCallback *callback));
 };
 
 typedef ::testing::StrictMock<MockMemoryController> StrictMockMemoryController;
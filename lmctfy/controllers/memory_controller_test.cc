@@ -104,6 +104,28 @@ TEST_F(MemoryControllerTest, SetInfiniteLimit) {
   EXPECT_TRUE(controller_->SetLimit(Bytes(kint64max)).ok());
 }
 
+TEST_F(MemoryControllerTest, SetLimitUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Memory::kMax);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("42", kResFile, NotNull(),
+                                              NotNull())).WillOnce(Return(0));
+
+  EXPECT_OK(controller_->SetLimit(Bytes(42)));
+}
+
+TEST_F(MemoryControllerTest, SetInfiniteLimitUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Memory::kMax);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("max", kResFile, NotNull(),
+                                              NotNull())).WillOnce(Return(0));
+
+  EXPECT_OK(controller_->SetLimit(Bytes(kint64max)));
+}
+
 TEST_F(MemoryControllerTest, SetLimitFails) {
   const string kResFile =
       JoinPath(kMountPoint, KernelFiles::Memory::kLimitInBytes);
@@ -135,6 +157,17 @@ TEST_F(MemoryControllerTest, SetInfiniteSoftLimit) {
   EXPECT_TRUE(controller_->SetSoftLimit(Bytes(kint64max)).ok());
 }
 
+TEST_F(MemoryControllerTest, SetSoftLimitUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Memory::kLow);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, SafeWriteResFile("42", kResFile, NotNull(),
+                                              NotNull())).WillOnce(Return(0));
+
+  EXPECT_OK(controller_->SetSoftLimit(Bytes(42)));
+}
+
 TEST_F(MemoryControllerTest, SetSoftLimitFails) {
   const string kResFile =
       JoinPath(kMountPoint, KernelFiles::Memory::kSoftLimitInBytes);
@@ -344,6 +377,21 @@ TEST_F(MemoryControllerTest, GetLimit) {
   EXPECT_EQ(Bytes(42), statusor.ValueOrDie());
 }
 
+TEST_F(MemoryControllerTest, GetLimitUnifiedNoLimit) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Memory::kMax);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("max\n"), Return(true)));
+
+  StatusOr<Bytes> statusor = controller_->GetLimit();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(Bytes(kint64max), statusor.ValueOrDie());
+}
+
 TEST_F(MemoryControllerTest, GetLimitNotFound) {
   const string kResFile =
       JoinPath(kMountPoint, KernelFiles::Memory::kLimitInBytes);
@@ -560,6 +608,21 @@ TEST_F(MemoryControllerTest, GetUsage) {
   EXPECT_EQ(Bytes(42), statusor.ValueOrDie());
 }
 
+TEST_F(MemoryControllerTest, GetUsageUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Memory::kCurrent);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("42\n"), Return(true)));
+
+  StatusOr<Bytes> statusor = controller_->GetUsage();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(Bytes(42), statusor.ValueOrDie());
+}
+
 TEST_F(MemoryControllerTest, GetUsageNotFound) {
   const string kResFile =
       JoinPath(kMountPoint, KernelFiles::Memory::kUsageInBytes);
@@ -1250,6 +1313,119 @@ TEST_F(MemoryControllerTest, GetMemoryStatsFileNotFound) {
   EXPECT_FALSE(controller_->GetMemoryStats(&stats).ok());
 }
 
+TEST_F(MemoryControllerTest, GetMemoryStatSnapshot) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Memory::kStat);
+  const string kStats =
+      "cache 30806016\n"
+      "thp_split 1536\n"
+      "total_cache 397692928\n"
+      "hierarchical_memory_limit 1234\n";
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>(kStats), Return(true)));
+
+  MemoryStatSnapshot snapshot;
+  ASSERT_OK(controller_->GetMemoryStatSnapshot(&snapshot));
+  int64 value;
+  ASSERT_TRUE(snapshot.Get(MemoryStatSnapshot::CONTAINER,
+                           MemoryStatSnapshot::STAT_cache, &value));
+  EXPECT_EQ(30806016, value);
+  ASSERT_TRUE(snapshot.Get(MemoryStatSnapshot::HIERARCHICAL,
+                           MemoryStatSnapshot::STAT_cache, &value));
+  EXPECT_EQ(397692928, value);
+}
+
+TEST_F(MemoryControllerTest, GetMemoryStatSnapshotUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Memory::kStat);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("anon 1024\nfile 2048\n"),
+                      Return(true)));
+
+  MemoryStatSnapshot snapshot;
+  ASSERT_OK(controller_->GetMemoryStatSnapshot(&snapshot));
+  int64 value;
+  ASSERT_TRUE(snapshot.Get(MemoryStatSnapshot::HIERARCHICAL,
+                           MemoryStatSnapshot::STAT_rss, &value));
+  EXPECT_EQ(1024, value);
+  ASSERT_TRUE(snapshot.Get(MemoryStatSnapshot::HIERARCHICAL,
+                           MemoryStatSnapshot::STAT_cache, &value));
+  EXPECT_EQ(2048, value);
+}
+
+TEST_F(MemoryControllerTest, GetMemoryStatSnapshotFileNotFound) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Memory::kStat);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(1));
+
+  MemoryStatSnapshot snapshot;
+  EXPECT_ERROR_CODE(NOT_FOUND, controller_->GetMemoryStatSnapshot(&snapshot));
+}
+
+TEST_F(MemoryControllerTest, GetMemoryStatsFromSnapshot) {
+  MemoryStatSnapshot snapshot;
+  ASSERT_OK(snapshot.Parse("thp_split 1536\n"
+                           "kernel_noncharged_slab_memory 12\n"
+                           "total_cache 397692928\n"
+                           "hierarchical_memory_limit 1234\n"));
+
+  // Stats come from the snapshot, memory.stat is not read.
+  MemoryStats stats;
+  ASSERT_OK(controller_->GetMemoryStats(snapshot, &stats));
+  EXPECT_EQ(1536, stats.container_data().thp().split());
+  EXPECT_EQ(12, stats.container_data().kernel_noncharged().slab_memory());
+  EXPECT_FALSE(stats.container_data().kernel().has_slab_memory());
+  EXPECT_FALSE(stats.container_data().has_cache());
+  EXPECT_EQ(397692928, stats.hierarchical_data().cache());
+  EXPECT_EQ(1234, stats.hierarchical_memory_limit());
+}
+
+TEST_F(MemoryControllerTest, GetEffectiveLimitFromSnapshot) {
+  MemoryStatSnapshot snapshot;
+  ASSERT_OK(snapshot.Parse("hierarchical_memory_limit 42\n"));
+
+  StatusOr<Bytes> statusor = controller_->GetEffectiveLimit(snapshot);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(Bytes(42), statusor.ValueOrDie());
+}
+
+TEST_F(MemoryControllerTest, GetEffectiveLimitFromEmptySnapshot) {
+  MemoryStatSnapshot snapshot;
+  EXPECT_ERROR_CODE(NOT_FOUND, controller_->GetEffectiveLimit(snapshot));
+}
+
+TEST_F(MemoryControllerTest, GetWorkingSetFromSnapshot) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Memory::kUsageInBytes);
+  const string kIdleFile =
+      JoinPath(kMountPoint, KernelFiles::Memory::kIdlePageStats);
+
+  MemoryStatSnapshot snapshot;
+  ASSERT_OK(snapshot.Parse("total_inactive_anon 14\n"
+                           "total_inactive_file 10\n"));
+
+  // The inactive bytes come from the snapshot, memory.stat is not read.
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, Access(kIdleFile, F_OK))
+      .WillRepeatedly(Return(1));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillRepeatedly(DoAll(SetArgPointee<1>("1024"), Return(true)));
+
+  StatusOr<Bytes> statusor = controller_->GetWorkingSet(snapshot);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(Bytes(1000), statusor.ValueOrDie());
+}
+
 TEST_F(MemoryControllerTest, GetIdlePageStatsSuccess) {
   const string kResFile =
       JoinPath(kMountPoint, KernelFiles::Memory::kIdlePageStats);
@@ -1533,6 +1709,23 @@ TEST_F(MemoryControllerTest, GetFailCount) {
   EXPECT_EQ(42, statusor.ValueOrDie());
 }
 
+TEST_F(MemoryControllerTest, GetFailCountUnified) {
+  const string kResFile =
+      JoinPath(kMountPoint, KernelFiles::Unified::Memory::kEvents);
+  controller_->set_unified(true);
+
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(SetArgPointee<1>("low 0\nhigh 0\nmax 42\noom 1\n"
+                                       "oom_kill 1\n"),
+                      Return(true)));
+
+  StatusOr<int64> statusor = controller_->GetFailCount();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(42, statusor.ValueOrDie());
+}
+
 TEST_F(MemoryControllerTest, GetFailCountNotFound) {
   const string kResFile =
       JoinPath(kMountPoint, KernelFiles::Memory::kFailCount);
@@ -1812,5 +2005,53 @@ TEST_F(NumaStatTest, DuplicateLevel) {
             controller_->GetNumaStats(stats_.mutable_numa()).error_code());
 }
 
+TEST_F(MemoryControllerTest, GetPressure) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Memory::kPressure);
+  controller_->set_unified(true);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*mock_kernel_, ReadFileToString(kResFile, NotNull()))
+      .WillOnce(DoAll(
+          SetArgPointee<1>("some avg10=2.00 avg60=1.00 avg300=0.50 total=42\n"
+                           "full avg10=0.00 avg60=0.00 avg300=0.00 total=7\n"),
+          Return(true)));
+
+  StatusOr<PressureData> statusor = controller_->GetPressure();
+  ASSERT_OK(statusor);
+  EXPECT_DOUBLE_EQ(2.0, statusor.ValueOrDie().some().avg10());
+  EXPECT_EQ(42, statusor.ValueOrDie().some().total());
+  EXPECT_EQ(7, statusor.ValueOrDie().full().total());
+}
+
+TEST_F(MemoryControllerTest, GetPressureNotFound) {
+  const string kResFile = JoinPath(kMountPoint, KernelFiles::Unified::Memory::kPressure);
+  EXPECT_CALL(*mock_kernel_, Access(kResFile, F_OK))
+      .WillRepeatedly(Return(-1));
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetPressure());
+}
+
+TEST_F(MemoryControllerTest, RegisterPressureNotification) {
+  controller_->set_unified(true);
+  EventSpec::PressureThreshold threshold;
+  threshold.set_resource(EventSpec::PressureThreshold::MEMORY);
+  threshold.set_threshold(100000);
+  threshold.set_window(1000000);
+
+  // Normally RegisterTriggerNotification() takes ownership, but we are mocking
+  // it out.
+  unique_ptr<CgroupController::EventCallback> cb(
+      NewPermanentCallback(&NoOpCallback));
+  EXPECT_CALL(*mock_eventfd_notifications_,
+              RegisterTriggerNotification(kMountPoint, KernelFiles::Unified::Memory::kPressure,
+                                          "some 100000 1000000", NotNull()))
+      .WillOnce(Return(1));
+
+  StatusOr<ActiveNotifications::Handle> statusor =
+      controller_->RegisterPressureNotification(threshold, cb.get());
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
 }  // namespace lmctfy
 }  // namespace containers
@@ -0,0 +1,249 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/memory_stat_snapshot.h"
+
+#include <string.h>
+
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+using ::strings::Substitute;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+namespace {
+
+// Name of a memory.stat field and its length, so that lookups do not need to
+// strlen() every candidate.
+struct FieldKey {
+  const char *name;
+  size_t length;
+};
+
+const FieldKey kFieldKeys[] = {
+#define MEMORY_STAT_FIELD_KEY(name) {#name, sizeof(#name) - 1},
+  MEMORY_STAT_FIELDS(MEMORY_STAT_FIELD_KEY)
+#undef MEMORY_STAT_FIELD_KEY
+};
+
+static_assert(sizeof(kFieldKeys) / sizeof(kFieldKeys[0]) ==
+                  MemoryStatSnapshot::NUM_FIELDS,
+              "Every memory.stat field must have a key");
+
+// Prefix of the hierarchical version of a field.
+const char kHierarchicalPrefix[] = "total_";
+
+// Name of a field in the memory.stat of the unified hierarchy and the field of
+// its v1 equivalent.
+struct UnifiedFieldKey {
+  const char *name;
+  MemoryStatSnapshot::Field field;
+};
+
+const UnifiedFieldKey kUnifiedFieldKeys[] = {
+  {"anon", MemoryStatSnapshot::STAT_rss},
+  {"file", MemoryStatSnapshot::STAT_cache},
+  {"kernel", MemoryStatSnapshot::STAT_kernel_memory},
+  {"kernel_stack", MemoryStatSnapshot::STAT_kernel_stack_memory},
+  {"pagetables", MemoryStatSnapshot::STAT_kernel_pgtable_memory},
+  {"slab", MemoryStatSnapshot::STAT_kernel_slab_memory},
+  {"anon_thp", MemoryStatSnapshot::STAT_rss_huge},
+  {"file_mapped", MemoryStatSnapshot::STAT_mapped_file},
+  {"file_dirty", MemoryStatSnapshot::STAT_dirty},
+  {"file_writeback", MemoryStatSnapshot::STAT_writeback},
+  {"inactive_anon", MemoryStatSnapshot::STAT_inactive_anon},
+  {"active_anon", MemoryStatSnapshot::STAT_active_anon},
+  {"inactive_file", MemoryStatSnapshot::STAT_inactive_file},
+  {"active_file", MemoryStatSnapshot::STAT_active_file},
+  {"unevictable", MemoryStatSnapshot::STAT_unevictable},
+  {"pgfault", MemoryStatSnapshot::STAT_pgfault},
+  {"pgmajfault", MemoryStatSnapshot::STAT_pgmajfault},
+  {"thp_fault_alloc", MemoryStatSnapshot::STAT_thp_fault_alloc},
+  {"thp_collapse_alloc", MemoryStatSnapshot::STAT_thp_collapse_alloc},
+};
+
+bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+// Parses an integer from text. Unsigned values too large for an int64 are
+// saturated to kint64max. Returns false if text is not an integer that fits in
+// a uint64 or an int64.
+bool ParseWithSaturation(StringPiece text, int64 *value) {
+  bool negative = false;
+  if (!text.empty() && (text[0] == '-' || text[0] == '+')) {
+    negative = text[0] == '-';
+    text.remove_prefix(1);
+  }
+  if (text.empty()) {
+    return false;
+  }
+
+  uint64 result = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    const uint64 digit = c - '0';
+    if (result > (kuint64max - digit) / 10) {
+      return false;
+    }
+    result = result * 10 + digit;
+  }
+
+  if (negative) {
+    // The magnitude of kint64min is one more than kint64max.
+    if (result > static_cast<uint64>(kint64max) + 1) {
+      return false;
+    }
+    *value = static_cast<int64>(-result);
+  } else {
+    *value = result > static_cast<uint64>(kint64max)
+                 ? kint64max
+                 : static_cast<int64>(result);
+  }
+  return true;
+}
+
+}  // namespace
+
+MemoryStatSnapshot::MemoryStatSnapshot() { Clear(); }
+
+void MemoryStatSnapshot::Clear() {
+  memset(present_, 0, sizeof(present_));
+}
+
+Status MemoryStatSnapshot::Parse(StringPiece contents) {
+  return ParseContents(contents, false);
+}
+
+Status MemoryStatSnapshot::ParseUnified(StringPiece contents) {
+  return ParseContents(contents, true);
+}
+
+Status MemoryStatSnapshot::ParseContents(StringPiece contents, bool unified) {
+  Clear();
+
+  // memory.stat lists fields in the same order on every read, so the field
+  // after the last one found is almost always the next one.
+  int hint = 0;
+  const char *pos = contents.data();
+  const char *const end = pos + contents.size();
+  while (pos < end) {
+    const char *line_end =
+        static_cast<const char *>(memchr(pos, '\n', end - pos));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+    const StringPiece line(pos, line_end - pos);
+    pos = line_end + 1;
+
+    // Each line should be a space-separated key value pair.
+    StringPiece tokens[2];
+    int num_tokens = 0;
+    const char *token = line.data();
+    const char *const token_end = line.data() + line.size();
+    while (token < token_end) {
+      while (token < token_end && IsSpace(*token)) {
+        ++token;
+      }
+      if (token == token_end) {
+        break;
+      }
+      const char *token_start = token;
+      while (token < token_end && !IsSpace(*token)) {
+        ++token;
+      }
+      if (num_tokens == 2) {
+        num_tokens = 3;
+        break;
+      }
+      tokens[num_tokens++] = StringPiece(token_start, token - token_start);
+    }
+    if (num_tokens == 0) {
+      continue;
+    }
+    if (num_tokens != 2) {
+      Clear();
+      return Status(::util::error::FAILED_PRECONDITION,
+                    Substitute("Failed to parse pair from line \"$0\"", line));
+    }
+
+    int64 value;
+    if (!ParseWithSaturation(tokens[1], &value)) {
+      Clear();
+      return Status(::util::error::FAILED_PRECONDITION,
+                    Substitute("Failed to parse int from \"$0\"", tokens[1]));
+    }
+
+    if (unified) {
+      SetUnified(tokens[0], value);
+    } else {
+      Set(tokens[0], value, &hint);
+    }
+  }
+
+  return Status::OK;
+}
+
+StatusOr<int64> MemoryStatSnapshot::Get(Scope scope, Field field) const {
+  int64 value;
+  if (!Get(scope, field, &value)) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("Failed to find \"$0$1\" in memory statistics",
+                             scope == HIERARCHICAL ? kHierarchicalPrefix : "",
+                             FieldName(field)));
+  }
+
+  return value;
+}
+
+const char *MemoryStatSnapshot::FieldName(Field field) {
+  return kFieldKeys[field].name;
+}
+
+void MemoryStatSnapshot::Set(StringPiece key, int64 value, int *hint) {
+  Scope scope = CONTAINER;
+  if (key.starts_with(kHierarchicalPrefix)) {
+    scope = HIERARCHICAL;
+    key.remove_prefix(sizeof(kHierarchicalPrefix) - 1);
+  }
+
+  for (int i = 0; i < NUM_FIELDS; ++i) {
+    const int field = (*hint + i) % NUM_FIELDS;
+    const FieldKey &field_key = kFieldKeys[field];
+    if (key.size() == field_key.length &&
+        memcmp(key.data(), field_key.name, field_key.length) == 0) {
+      values_[scope][field] = value;
+      present_[scope][field] = true;
+      *hint = (field + 1) % NUM_FIELDS;
+      return;
+    }
+  }
+}
+
+void MemoryStatSnapshot::SetUnified(StringPiece key, int64 value) {
+  for (const UnifiedFieldKey &field_key : kUnifiedFieldKeys) {
+    if (key == field_key.name) {
+      values_[HIERARCHICAL][field_key.field] = value;
+      present_[HIERARCHICAL][field_key.field] = true;
+      return;
+    }
+  }
+}
+
+}  // namespace lmctfy
+}  // namespace containers
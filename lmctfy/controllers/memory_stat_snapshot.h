@@ -0,0 +1,164 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_CONTROLLERS_MEMORY_STAT_SNAPSHOT_H_
+#define SRC_CONTROLLERS_MEMORY_STAT_SNAPSHOT_H_
+
+#include "base/integral_types.h"
+#include "strings/stringpiece.h"
+#include "util/task/status.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace lmctfy {
+
+// The memory.stat fields lmctfy consumes. Names are as they appear in the file
+// (without the "total_" prefix of hierarchical values).
+#define MEMORY_STAT_FIELDS(X)               \
+  X(cache)                                  \
+  X(rss)                                    \
+  X(rss_huge)                               \
+  X(mapped_file)                            \
+  X(pgpgin)                                 \
+  X(pgfault)                                \
+  X(pgmajfault)                             \
+  X(dirty)                                  \
+  X(writeback)                              \
+  X(inactive_anon)                          \
+  X(active_anon)                            \
+  X(inactive_file)                          \
+  X(active_file)                            \
+  X(unevictable)                            \
+  X(thp_fault_alloc)                        \
+  X(thp_fault_fallback)                     \
+  X(thp_collapse_alloc)                     \
+  X(thp_collapse_alloc_failed)              \
+  X(thp_split)                              \
+  X(kernel_memory)                          \
+  X(kernel_slab_memory)                     \
+  X(kernel_stack_memory)                    \
+  X(kernel_pgtable_memory)                  \
+  X(kernel_vmalloc_memory)                  \
+  X(kernel_misc_memory)                     \
+  X(kernel_targeted_slab_memory)            \
+  X(kernel_compressed_memory)               \
+  X(kernel_noncharged_memory)               \
+  X(kernel_noncharged_slab_memory)          \
+  X(kernel_noncharged_stack_memory)         \
+  X(kernel_noncharged_pgtable_memory)       \
+  X(kernel_noncharged_vmalloc_memory)       \
+  X(kernel_noncharged_misc_memory)          \
+  X(kernel_noncharged_targeted_slab_memory) \
+  X(kernel_noncharged_compressed_memory)    \
+  X(compressed_pool_pages)                  \
+  X(compressed_stored_pages)                \
+  X(compressed_reject_compress_poor)        \
+  X(zswap_zsmalloc_fail)                    \
+  X(zswap_kmemcache_fail)                   \
+  X(zswap_duplicate_entry)                  \
+  X(zswap_compressed_pages)                 \
+  X(zswap_decompressed_pages)               \
+  X(zswap_compression_nsec)                 \
+  X(zswap_decompression_nsec)               \
+  X(hierarchical_memory_limit)
+
+// A parsed copy of a cgroup's memory.stat file.
+//
+// memory.stat is the most expensive statistic lmctfy reads for a container and
+// several statistics are derived from it. A snapshot is read once and shared
+// by all of them. Parsing does not allocate: values are stored in fixed slots
+// indexed by Field, unknown fields are skipped.
+//
+// Class is thread-compatible.
+class MemoryStatSnapshot {
+ public:
+  enum Field {
+#define MEMORY_STAT_FIELD_ENUM(name) STAT_##name,
+    MEMORY_STAT_FIELDS(MEMORY_STAT_FIELD_ENUM)
+#undef MEMORY_STAT_FIELD_ENUM
+    NUM_FIELDS
+  };
+
+  // Which cgroups a value accounts for.
+  enum Scope {
+    // Only the cgroup itself (e.g.: "cache").
+    CONTAINER,
+    // The cgroup and all of its children (e.g.: "total_cache").
+    HIERARCHICAL,
+    NUM_SCOPES
+  };
+
+  // Creates an empty snapshot, all fields are missing.
+  MemoryStatSnapshot();
+
+  // Replaces the contents of the snapshot with those parsed from contents.
+  //
+  // Expected format is space-separated key value pairs, one per line. The
+  // values are expected to be integers, unsigned values too large for an int64
+  // are saturated.
+  //
+  // Arguments:
+  //   contents: The contents of a memory.stat file.
+  // Return:
+  //   Status: Status of the operation. FAILED_PRECONDITION if a line could not
+  //       be parsed, in which case the snapshot is left empty.
+  ::util::Status Parse(StringPiece contents);
+
+  // Same as Parse(), for the memory.stat file of the unified hierarchy. Its
+  // values account for the cgroup and all of its descendants, they are stored
+  // in the HIERARCHICAL scope under the field of their v1 equivalent (e.g.:
+  // "anon" is STAT_rss). Fields without a v1 equivalent are skipped.
+  ::util::Status ParseUnified(StringPiece contents);
+
+  // Marks all fields as missing.
+  void Clear();
+
+  // Gets the value of the specified field. Returns false if the field was not
+  // present in the file.
+  bool Get(Scope scope, Field field, int64 *value) const {
+    if (!present_[scope][field]) {
+      return false;
+    }
+    *value = values_[scope][field];
+    return true;
+  }
+
+  // Gets the value of the specified field. Returns NOT_FOUND if the field was
+  // not present in the file.
+  ::util::StatusOr<int64> Get(Scope scope, Field field) const;
+
+  // Name of the specified field as it appears in memory.stat (for the
+  // CONTAINER scope).
+  static const char *FieldName(Field field);
+
+ private:
+  // Parses contents with the format of the unified hierarchy iff unified.
+  ::util::Status ParseContents(StringPiece contents, bool unified);
+
+  // Sets the specified key's value, where key is a field of the unified
+  // hierarchy. Unknown keys are ignored.
+  void SetUnified(StringPiece key, int64 value);
+
+  // Sets the specified key's value. Unknown keys are ignored. hint is the field
+  // to try first and is updated to the field after the one that was found.
+  void Set(StringPiece key, int64 value, int *hint);
+
+  int64 values_[NUM_SCOPES][NUM_FIELDS];
+  bool present_[NUM_SCOPES][NUM_FIELDS];
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_CONTROLLERS_MEMORY_STAT_SNAPSHOT_H_
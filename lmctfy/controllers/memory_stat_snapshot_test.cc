@@ -0,0 +1,207 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/controllers/memory_stat_snapshot.h"
+
+#include "util/errors_test_util.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+
+using ::util::StatusOr;
+using ::util::error::FAILED_PRECONDITION;
+using ::util::error::NOT_FOUND;
+
+namespace containers {
+namespace lmctfy {
+
+static const char kStats[] =
+    "cache 30806016\n"
+    "rss 770048\n"
+    "thp_split 1536\n"
+    "kernel_slab_memory 12\n"
+    "kernel_noncharged_slab_memory 13\n"
+    "unknown_stat 99\n"
+    "hierarchical_memory_limit 9223372036854775807\n"
+    "total_cache 397692928\n"
+    "total_rss 287440896\n"
+    "total_unknown_stat 99\n";
+
+class MemoryStatSnapshotTest : public ::testing::Test {
+ protected:
+  // Expects the specified field to be present with value.
+  void ExpectValue(MemoryStatSnapshot::Scope scope,
+                   MemoryStatSnapshot::Field field, int64 expected) {
+    int64 value;
+    ASSERT_TRUE(snapshot_.Get(scope, field, &value))
+        << MemoryStatSnapshot::FieldName(field);
+    EXPECT_EQ(expected, value) << MemoryStatSnapshot::FieldName(field);
+  }
+
+  MemoryStatSnapshot snapshot_;
+};
+
+TEST_F(MemoryStatSnapshotTest, Empty) {
+  int64 value;
+  for (int i = 0; i < MemoryStatSnapshot::NUM_FIELDS; ++i) {
+    const MemoryStatSnapshot::Field field =
+        static_cast<MemoryStatSnapshot::Field>(i);
+    EXPECT_FALSE(snapshot_.Get(MemoryStatSnapshot::CONTAINER, field, &value));
+    EXPECT_FALSE(
+        snapshot_.Get(MemoryStatSnapshot::HIERARCHICAL, field, &value));
+  }
+}
+
+TEST_F(MemoryStatSnapshotTest, Parse) {
+  ASSERT_OK(snapshot_.Parse(kStats));
+
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_cache,
+              30806016);
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_rss,
+              770048);
+  ExpectValue(MemoryStatSnapshot::CONTAINER,
+              MemoryStatSnapshot::STAT_thp_split, 1536);
+  ExpectValue(MemoryStatSnapshot::CONTAINER,
+              MemoryStatSnapshot::STAT_kernel_slab_memory, 12);
+  ExpectValue(MemoryStatSnapshot::CONTAINER,
+              MemoryStatSnapshot::STAT_kernel_noncharged_slab_memory, 13);
+  ExpectValue(MemoryStatSnapshot::CONTAINER,
+              MemoryStatSnapshot::STAT_hierarchical_memory_limit, kint64max);
+  ExpectValue(MemoryStatSnapshot::HIERARCHICAL,
+              MemoryStatSnapshot::STAT_cache, 397692928);
+  ExpectValue(MemoryStatSnapshot::HIERARCHICAL, MemoryStatSnapshot::STAT_rss,
+              287440896);
+
+  int64 value;
+  EXPECT_FALSE(snapshot_.Get(MemoryStatSnapshot::HIERARCHICAL,
+                             MemoryStatSnapshot::STAT_thp_split, &value));
+  EXPECT_FALSE(snapshot_.Get(MemoryStatSnapshot::CONTAINER,
+                             MemoryStatSnapshot::STAT_dirty, &value));
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseOutOfOrder) {
+  ASSERT_OK(snapshot_.Parse("total_rss 2\n"
+                            "rss 1\n"
+                            "cache 3\n"));
+
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_rss, 1);
+  ExpectValue(MemoryStatSnapshot::HIERARCHICAL, MemoryStatSnapshot::STAT_rss,
+              2);
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_cache,
+              3);
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseSkipsEmptyLinesAndExtraSpaces) {
+  ASSERT_OK(snapshot_.Parse("\n  cache   42\n\nrss 7"));
+
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_cache,
+              42);
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_rss, 7);
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseNegativeValue) {
+  ASSERT_OK(snapshot_.Parse("cache -42\n"));
+
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_cache,
+              -42);
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseSaturatesLargeValues) {
+  ASSERT_OK(
+      snapshot_.Parse("hierarchical_memory_limit 18446744073709551615\n"));
+
+  ExpectValue(MemoryStatSnapshot::CONTAINER,
+              MemoryStatSnapshot::STAT_hierarchical_memory_limit, kint64max);
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseValueTooLarge) {
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION,
+                    snapshot_.Parse("cache 18446744073709551616\n"));
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseBadLineFormat) {
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION, snapshot_.Parse("cache 1 2\n"));
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION, snapshot_.Parse("cache\n"));
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseValueNotAnInteger) {
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION, snapshot_.Parse("cache abc\n"));
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION, snapshot_.Parse("cache -\n"));
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseFailureLeavesSnapshotEmpty) {
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION,
+                    snapshot_.Parse("cache 1\nrss abc\n"));
+
+  int64 value;
+  EXPECT_FALSE(snapshot_.Get(MemoryStatSnapshot::CONTAINER,
+                             MemoryStatSnapshot::STAT_cache, &value));
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseReplacesContents) {
+  ASSERT_OK(snapshot_.Parse("cache 1\n"));
+  ASSERT_OK(snapshot_.Parse("rss 2\n"));
+
+  int64 value;
+  EXPECT_FALSE(snapshot_.Get(MemoryStatSnapshot::CONTAINER,
+                             MemoryStatSnapshot::STAT_cache, &value));
+  ExpectValue(MemoryStatSnapshot::CONTAINER, MemoryStatSnapshot::STAT_rss, 2);
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseUnified) {
+  ASSERT_OK(snapshot_.ParseUnified("anon 1\n"
+                                   "file 2\n"
+                                   "file_mapped 3\n"
+                                   "pgmajfault 4\n"
+                                   "sock 5\n"));
+
+  ExpectValue(MemoryStatSnapshot::HIERARCHICAL, MemoryStatSnapshot::STAT_rss,
+              1);
+  ExpectValue(MemoryStatSnapshot::HIERARCHICAL, MemoryStatSnapshot::STAT_cache,
+              2);
+  ExpectValue(MemoryStatSnapshot::HIERARCHICAL,
+              MemoryStatSnapshot::STAT_mapped_file, 3);
+  ExpectValue(MemoryStatSnapshot::HIERARCHICAL,
+              MemoryStatSnapshot::STAT_pgmajfault, 4);
+  // The unified hierarchy only reports hierarchical values.
+  int64 value;
+  EXPECT_FALSE(snapshot_.Get(MemoryStatSnapshot::CONTAINER,
+                             MemoryStatSnapshot::STAT_rss, &value));
+}
+
+TEST_F(MemoryStatSnapshotTest, ParseUnifiedBadLine) {
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION, snapshot_.ParseUnified("anon abc\n"));
+}
+
+TEST_F(MemoryStatSnapshotTest, GetStatusOr) {
+  ASSERT_OK(snapshot_.Parse(kStats));
+
+  StatusOr<int64> statusor = snapshot_.Get(MemoryStatSnapshot::HIERARCHICAL,
+                                           MemoryStatSnapshot::STAT_cache);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(397692928, statusor.ValueOrDie());
+
+  EXPECT_ERROR_CODE(NOT_FOUND, snapshot_.Get(MemoryStatSnapshot::CONTAINER,
+                                             MemoryStatSnapshot::STAT_dirty));
+}
+
+TEST_F(MemoryStatSnapshotTest, FieldName) {
+  EXPECT_STREQ("cache", MemoryStatSnapshot::FieldName(
+                            MemoryStatSnapshot::STAT_cache));
+  EXPECT_STREQ("thp_fault_alloc",
+               MemoryStatSnapshot::FieldName(
+                   MemoryStatSnapshot::STAT_thp_fault_alloc));
+}
+
+}  // namespace lmctfy
+}  // namespace containers
@@ -14,15 +14,428 @@
 
 #include "lmctfy/controllers/perf_controller.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <utility>
+
+#include "gflags/gflags.h"
+#include "file/base/path.h"
+#include "util/errors.h"
+#include "util/scoped_cleanup.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+DEFINE_string(lmctfy_perf_counters_dir, "/run/lmctfy/perf_counters",
+              "Directory where the cgroups whose perf counters are enabled are "
+              "recorded, so that every process counts them.");
+DEFINE_bool(lmctfy_perf_open_enabled_counters, false,
+            "Whether reading the perf counters of a cgroup opens them when "
+            "they were enabled by another process. Counters only count from "
+            "when they are opened, so this is only useful in long-lived "
+            "processes that read them again (e.g.: \"stats publish\").");
+
+using ::file::JoinPath;
+using ::std::make_pair;
+using ::std::shared_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::util::ScopedCleanup;
+using ::util::Status;
+using ::util::StatusOr;
+
 namespace containers {
 namespace lmctfy {
 
+namespace {
+
+struct PerfEvent {
+  uint32 type;
+  uint64 config;
+};
+
+// Events counted with a hardware PMU. The first one leads the group.
+const PerfEvent kHardwareEvents[] = {
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+// Events counted without a hardware PMU.
+const PerfEvent kSoftwareEvents[] = {
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK},
+  {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+const int kMaxGroupEvents = arraysize(kHardwareEvents);
+
+// Layout of a read() of a group leader with the read format below.
+struct GroupReadFormat {
+  uint64 nr;
+  uint64 time_enabled;
+  uint64 time_running;
+  uint64 values[kMaxGroupEvents];
+};
+
+const uint64 kReadFormat = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+}  // namespace
+
+// The open groups of the counters of a cgroup.
+class PerfCounterRegistry::CounterGroups {
+ public:
+  CounterGroups(const KernelApi *kernel, bool hardware)
+      : kernel_(kernel), hardware_(hardware) {}
+
+  ~CounterGroups() {
+    for (int fd : fds_) {
+      kernel_->Close(fd);
+    }
+  }
+
+  // Adds the fd of an event. The first fd added for each CPU is the leader.
+  void AddFd(int fd, bool leader) {
+    fds_.push_back(fd);
+    if (leader) {
+      leaders_.push_back(fd);
+    }
+  }
+
+  // Closes the fds added after the first num_fds.
+  void CloseFdsAfter(size_t num_fds) {
+    while (fds_.size() > num_fds) {
+      if (!leaders_.empty() && leaders_.back() == fds_.back()) {
+        leaders_.pop_back();
+      }
+      kernel_->Close(fds_.back());
+      fds_.pop_back();
+    }
+  }
+
+  size_t num_fds() const { return fds_.size(); }
+  const vector<int> &leaders() const { return leaders_; }
+  bool hardware() const { return hardware_; }
+
+ private:
+  const KernelApi *kernel_;
+
+  // Whether the groups count the hardware events.
+  const bool hardware_;
+
+  // All the open fds, and those of the group leaders.
+  vector<int> fds_;
+  vector<int> leaders_;
+
+  DISALLOW_COPY_AND_ASSIGN(CounterGroups);
+};
+
+PerfCounterRegistry::PerfCounterRegistry(const KernelApi *kernel)
+    : kernel_(CHECK_NOTNULL(kernel)) {}
+
+PerfCounterRegistry::~PerfCounterRegistry() {}
+
+int PerfCounterRegistry::OpenGroup(int cgroup_fd, int cpu, bool hardware,
+                                   CounterGroups *groups) const {
+  const PerfEvent *events = hardware ? kHardwareEvents : kSoftwareEvents;
+  const int num_events =
+      hardware ? arraysize(kHardwareEvents) : arraysize(kSoftwareEvents);
+
+  const size_t num_fds = groups->num_fds();
+  int leader_fd = -1;
+  for (int i = 0; i < num_events; ++i) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.read_format = kReadFormat;
+
+    const int fd = kernel_->PerfEventOpen(
+        &attr, cgroup_fd, cpu, leader_fd,
+        PERF_FLAG_PID_CGROUP | PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) {
+      const int open_errno = errno;
+      groups->CloseFdsAfter(num_fds);
+      return open_errno;
+    }
+    groups->AddFd(fd, leader_fd < 0);
+    if (leader_fd < 0) {
+      leader_fd = fd;
+    }
+  }
+  return 0;
+}
+
+StatusOr<PerfCounterRegistry::CounterGroups *> PerfCounterRegistry::OpenGroups(
+    int cgroup_fd, bool hardware) const {
+  ::std::unique_ptr<CounterGroups> groups(new CounterGroups(kernel_, hardware));
+  const int num_cpus = kernel_->GetNumConfiguredCpus();
+  for (int cpu = 0; cpu < num_cpus; ++cpu) {
+    const int open_errno = OpenGroup(cgroup_fd, cpu, hardware, groups.get());
+    // Offline CPUs can't be counted on.
+    if (open_errno == 0 || open_errno == ENODEV) {
+      continue;
+    }
+    // ENOENT and EOPNOTSUPP mean the events are not supported here.
+    return Status(open_errno == ENOENT || open_errno == EOPNOTSUPP
+                      ? ::util::error::UNIMPLEMENTED
+                      : ::util::error::INTERNAL,
+                  Substitute("perf_event_open() on CPU $0 failed: $1", cpu,
+                             StrError(open_errno)));
+  }
+  if (groups->leaders().empty()) {
+    return Status(::util::error::INTERNAL,
+                  "No online CPU to count perf events on");
+  }
+  return groups.release();
+}
+
+Status PerfCounterRegistry::Open(const string &cgroup_path) {
+  if (IsOpen(cgroup_path)) {
+    return Status::OK;
+  }
+
+  const int cgroup_fd =
+      kernel_->Open(cgroup_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (cgroup_fd < 0) {
+    return Status(errno == ENOENT ? ::util::error::NOT_FOUND
+                                  : ::util::error::INTERNAL,
+                  Substitute("Failed to open cgroup \"$0\": $1", cgroup_path,
+                             StrError(errno)));
+  }
+  // The events keep their own reference to the cgroup.
+  ScopedCleanup close_cgroup([this, cgroup_fd]() {
+    kernel_->Close(cgroup_fd);
+  });
+
+  // Fall back to the software events where there is no hardware PMU.
+  StatusOr<CounterGroups *> statusor = OpenGroups(cgroup_fd, true);
+  if (statusor.status().error_code() == ::util::error::UNIMPLEMENTED) {
+    statusor = OpenGroups(cgroup_fd, false);
+  }
+  shared_ptr<const CounterGroups> groups(RETURN_IF_ERROR(statusor));
+
+  MutexLock l(&lock_);
+  // Keep the counters of a concurrent Open(), they started counting first.
+  counters_.insert(make_pair(cgroup_path, groups));
+  return Status::OK;
+}
+
+void PerfCounterRegistry::Close(const string &cgroup_path) {
+  shared_ptr<const CounterGroups> groups;
+  {
+    MutexLock l(&lock_);
+    auto it = counters_.find(cgroup_path);
+    if (it == counters_.end()) {
+      return;
+    }
+    groups = it->second;
+    counters_.erase(it);
+  }
+  // The fds are closed once the last reader is done with them.
+}
+
+bool PerfCounterRegistry::IsOpen(const string &cgroup_path) const {
+  MutexLock l(&lock_);
+  return counters_.find(cgroup_path) != counters_.end();
+}
+
+StatusOr<MonitoringStats::PerfCounters> PerfCounterRegistry::Read(
+    const string &cgroup_path) const {
+  shared_ptr<const CounterGroups> groups;
+  {
+    MutexLock l(&lock_);
+    auto it = counters_.find(cgroup_path);
+    if (it == counters_.end()) {
+      return Status(::util::error::NOT_FOUND,
+                    Substitute("Perf counters of cgroup \"$0\" are not open",
+                               cgroup_path));
+    }
+    groups = it->second;
+  }
+
+  const uint64 num_events = groups->hardware() ? arraysize(kHardwareEvents)
+                                               : arraysize(kSoftwareEvents);
+  double totals[kMaxGroupEvents] = {0};
+  for (int leader_fd : groups->leaders()) {
+    GroupReadFormat data;
+    const ssize_t bytes = kernel_->Read(leader_fd, &data, sizeof(data));
+    if (bytes < 0) {
+      return Status(::util::error::INTERNAL,
+                    Substitute("Failed to read perf counters of \"$0\": $1",
+                               cgroup_path, StrError(errno)));
+    }
+    if (bytes < offsetof(GroupReadFormat, values) ||
+        data.nr != num_events ||
+        bytes < offsetof(GroupReadFormat, values) + num_events * sizeof(uint64)) {
+      return Status(::util::error::INTERNAL,
+                    Substitute("Short read of perf counters of \"$0\"",
+                               cgroup_path));
+    }
+
+    // The group never ran on this CPU.
+    if (data.time_running == 0) {
+      continue;
+    }
+    const double scale =
+        static_cast<double>(data.time_enabled) / data.time_running;
+    for (int i = 0; i < num_events; ++i) {
+      totals[i] += data.values[i] * scale;
+    }
+  }
+
+  MonitoringStats::PerfCounters counters;
+  counters.set_hardware(groups->hardware());
+  if (groups->hardware()) {
+    counters.set_cycles(totals[0]);
+    counters.set_instructions(totals[1]);
+    counters.set_llc_misses(totals[2]);
+    counters.set_context_switches(totals[3]);
+  } else {
+    counters.set_cpu_clock(totals[0]);
+    counters.set_context_switches(totals[1]);
+  }
+  return counters;
+}
+
+StatusOr<PerfController *> PerfControllerFactory::Get(
+    const string &hierarchy_path) const {
+  PerfController *controller = RETURN_IF_ERROR(
+      (CgroupControllerFactory<PerfController, CGROUP_PERF_EVENT>::Get(
+          hierarchy_path)));
+  controller->set_counter_registry(counter_registry_.get());
+  return controller;
+}
+
+StatusOr<PerfController *> PerfControllerFactory::Create(
+    const string &hierarchy_path) const {
+  PerfController *controller = RETURN_IF_ERROR(
+      (CgroupControllerFactory<PerfController, CGROUP_PERF_EVENT>::Create(
+          hierarchy_path)));
+  controller->set_counter_registry(counter_registry_.get());
+  return controller;
+}
+
 PerfController::PerfController(const string &hierarchy_path,
                                const string &cgroup_path, bool owns_cgroup,
                                const KernelApi *kernel,
                                EventFdNotifications *eventfd_notifications)
     : CgroupController(CGROUP_PERF_EVENT, hierarchy_path, cgroup_path,
-                       owns_cgroup, kernel, eventfd_notifications) {}
+                       owns_cgroup, kernel, eventfd_notifications),
+      kernel_(kernel),
+      counter_registry_(nullptr) {}
+
+Status PerfController::Destroy() {
+  // Open events would keep the cgroup around after it is removed.
+  DisableCounters();
+  return CgroupController::Destroy();
+}
+
+Status PerfController::EnableCounters() {
+  if (counter_registry_ == nullptr) {
+    return Status(::util::error::FAILED_PRECONDITION,
+                  "Perf counters are not available");
+  }
+  RETURN_IF_ERROR(counter_registry_->Open(cgroup_name()));
+
+  // Record that the counters are enabled for other processes.
+  const string marker_path = GetMarkerPath();
+  if (kernel_->MkDirRecursive(FLAGS_lmctfy_perf_counters_dir) != 0) {
+    const int mkdir_errno = errno;
+    counter_registry_->Close(cgroup_name());
+    return Status(::util::error::INTERNAL,
+                  Substitute("Failed to create the perf counters directory "
+                             "\"$0\": $1",
+                             FLAGS_lmctfy_perf_counters_dir,
+                             strerror(mkdir_errno)));
+  }
+  const int fd = kernel_->OpenWithMode(marker_path.c_str(),
+                                       O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    const int open_errno = errno;
+    counter_registry_->Close(cgroup_name());
+    return Status(::util::error::INTERNAL,
+                  Substitute("Failed to record the perf counters of \"$0\" "
+                             "as enabled in \"$1\": $2",
+                             cgroup_name(), marker_path, strerror(open_errno)));
+  }
+  kernel_->Close(fd);
+  return Status::OK;
+}
+
+void PerfController::DisableCounters() {
+  if (counter_registry_ != nullptr) {
+    counter_registry_->Close(cgroup_name());
+  }
+  kernel_->Unlink(GetMarkerPath().c_str());
+}
+
+bool PerfController::CountersEnabled() const {
+  return counter_registry_ != nullptr &&
+         (counter_registry_->IsOpen(cgroup_name()) ||
+          kernel_->Access(GetMarkerPath(), F_OK) == 0);
+}
+
+StatusOr<MonitoringStats::PerfCounters> PerfController::GetCounters() const {
+  if (counter_registry_ == nullptr) {
+    return Status(::util::error::NOT_FOUND, "Perf counters are not available");
+  }
+
+  // Counters enabled by another process are opened on their first read, they
+  // count from then on. Reading them right away would report next to nothing
+  // as if it were real. Opening them is only worth it if this process reads
+  // them again.
+  if (!counter_registry_->IsOpen(cgroup_name())) {
+    if (kernel_->Access(GetMarkerPath(), F_OK) != 0) {
+      return Status(::util::error::NOT_FOUND,
+                    Substitute("Perf counters of \"$0\" are not enabled",
+                               cgroup_name()));
+    }
+    if (!FLAGS_lmctfy_perf_open_enabled_counters) {
+      return Status(::util::error::NOT_FOUND,
+                    Substitute("Perf counters of \"$0\" are not counting in "
+                               "this process",
+                               cgroup_name()));
+    }
+    RETURN_IF_ERROR(counter_registry_->Open(cgroup_name()));
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("Perf counters of \"$0\" were not counting in "
+                             "this process, they count from now on",
+                             cgroup_name()));
+  }
+  MonitoringStats::PerfCounters counters =
+      RETURN_IF_ERROR(counter_registry_->Read(cgroup_name()));
+
+  // Derive the rates, only with hardware counters.
+  if (counters.cycles() != 0 && counters.instructions() != 0) {
+    counters.set_ipc(static_cast<double>(counters.instructions()) /
+                     counters.cycles());
+    counters.set_cpi(static_cast<double>(counters.cycles()) /
+                     counters.instructions());
+  }
+  return counters;
+}
+
+string PerfController::GetMarkerPath() const {
+  // The markers of nested cgroups are all files in the same directory, so '/'
+  // is escaped (and '%' so that the escaping is unambiguous).
+  string marker_name;
+  for (const char c : cgroup_name()) {
+    if (c == '%') {
+      marker_name += "%25";
+    } else if (c == '/') {
+      marker_name += "%2F";
+    } else {
+      marker_name += c;
+    }
+  }
+  return JoinPath(FLAGS_lmctfy_perf_counters_dir, marker_name);
+}
 
 }  // namespace lmctfy
 }  // namespace containers
@@ -15,7 +15,19 @@
 #ifndef SRC_CONTROLLERS_PERF_CONTROLLER_H_
 #define SRC_CONTROLLERS_PERF_CONTROLLER_H_
 
+#include <map>
+#include <memory>
+#include <string>
+using ::std::string;
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
 #include "lmctfy/controllers/cgroup_controller.h"
+#include "include/lmctfy.pb.h"
+#include "util/task/status.h"
+#include "util/task/statusor.h"
 
 namespace containers {
 namespace lmctfy {
@@ -23,6 +35,74 @@ namespace lmctfy {
 class CgroupFactory;
 class PerfController;
 
+// Perf counters of cgroups, kept open across the PerfControllers of a cgroup.
+//
+// The counters of a cgroup are one group per CPU, opened in cgroup mode
+// (PERF_FLAG_PID_CGROUP) so that they only count while a task of the cgroup
+// runs on that CPU. Each group counts cycles, instructions, LLC misses and
+// context switches, and is read with a single read() of its leader
+// (PERF_FORMAT_GROUP). Where there is no hardware PMU (e.g.: in VMs) the groups
+// count the cpu-clock and context switches software events instead.
+//
+// Counters only count from when they are opened, so they are kept open until
+// they are closed or the registry is destroyed.
+//
+// Class is thread-safe.
+class PerfCounterRegistry {
+ public:
+  // Does not take ownership of kernel.
+  explicit PerfCounterRegistry(const KernelApi *kernel);
+  virtual ~PerfCounterRegistry();
+
+  // Opens the counters of the cgroup. No-op if they are already open.
+  //
+  // Arguments:
+  //   cgroup_path: Absolute path of the cgroup. e.g.: /dev/cgroup/perf/test
+  // Return:
+  //   Status: Status of the operation.
+  virtual ::util::Status Open(const string &cgroup_path) LOCKS_EXCLUDED(lock_);
+
+  // Closes the counters of the cgroup, if they are open.
+  virtual void Close(const string &cgroup_path) LOCKS_EXCLUDED(lock_);
+
+  // Whether the counters of the cgroup are open.
+  virtual bool IsOpen(const string &cgroup_path) const LOCKS_EXCLUDED(lock_);
+
+  // Reads the counters of the cgroup, summed over all CPUs. Counts are scaled
+  // up for the time the counters were not scheduled because of multiplexing.
+  //
+  // Return:
+  //   StatusOr<MonitoringStats::PerfCounters>: Status of the operation. Iff OK,
+  //       the counts. NOT_FOUND if the counters of the cgroup are not open.
+  virtual ::util::StatusOr<MonitoringStats::PerfCounters> Read(
+      const string &cgroup_path) const LOCKS_EXCLUDED(lock_);
+
+ private:
+  class CounterGroups;
+
+  // Opens a group of events on cpu for the cgroup open at cgroup_fd. The fds
+  // of the group are added to groups. Returns the errno of the failed open, or
+  // 0 on success.
+  int OpenGroup(int cgroup_fd, int cpu, bool hardware,
+                CounterGroups *groups) const;
+
+  // Opens the groups of all CPUs for the cgroup open at cgroup_fd.
+  ::util::StatusOr<CounterGroups *> OpenGroups(int cgroup_fd,
+                                               bool hardware) const;
+
+  // Wrapper for all calls to the kernel.
+  const KernelApi *kernel_;
+
+  // Map of cgroup path to its open counters. Counters are shared so that they
+  // can be read outside of the lock while being closed.
+  ::std::map<string, ::std::shared_ptr<const CounterGroups>> counters_
+      GUARDED_BY(lock_);
+
+  mutable Mutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(PerfCounterRegistry);
+};
+
 // Factory for PerfControllers.
 //
 // Class is thread-safe.
@@ -34,10 +114,20 @@ class PerfControllerFactory
                         const KernelApi *kernel,
                         EventFdNotifications *eventfd_notifications)
       : CgroupControllerFactory<PerfController, CGROUP_PERF_EVENT>(
-            cgroup_factory, kernel, eventfd_notifications) {}
+            cgroup_factory, kernel, eventfd_notifications),
+        counter_registry_(new PerfCounterRegistry(kernel)) {}
   virtual ~PerfControllerFactory() {}
 
+  // The controllers share the counters of the factory.
+  ::util::StatusOr<PerfController *> Get(
+      const string &hierarchy_path) const override;
+  ::util::StatusOr<PerfController *> Create(
+      const string &hierarchy_path) const override;
+
  private:
+  // Counters of all the cgroups of this hierarchy.
+  const ::std::unique_ptr<PerfCounterRegistry> counter_registry_;
+
   DISALLOW_COPY_AND_ASSIGN(PerfControllerFactory);
 };
 
@@ -52,7 +142,51 @@ class PerfController : public CgroupController {
                  EventFdNotifications *eventfd_notifications);
   virtual ~PerfController() {}
 
+  // Closes the counters of this cgroup before destroying it.
+  ::util::Status Destroy() override;
+
+  // Starts counting perf events in this cgroup. The counters are kept open
+  // until DisableCounters() or Destroy(). No-op if they are already enabled.
+  //
+  // Enabled counters are recorded in a marker file under
+  // --lmctfy_perf_counters_dir, so that other processes see them as enabled.
+  virtual ::util::Status EnableCounters();
+
+  // Stops counting perf events in this cgroup, in all processes.
+  virtual void DisableCounters();
+
+  // Whether perf events are being counted in this cgroup, by any process.
+  virtual bool CountersEnabled() const;
+
+  // Gets the perf counters of this cgroup since they were enabled. Only the
+  // process that enabled them has them open. With
+  // --lmctfy_perf_open_enabled_counters a long-lived process (e.g.: the stats
+  // publisher) opens them on its first read and counts from then on, so that
+  // read has nothing to report. Other processes never open them.
+  //
+  // Return:
+  //   StatusOr<MonitoringStats::PerfCounters>: Status of the operation. Iff OK,
+  //       the counts and the rates derived from them. NOT_FOUND if the
+  //       counters are not enabled, are not open in this process or if this
+  //       read opened them.
+  virtual ::util::StatusOr<MonitoringStats::PerfCounters> GetCounters() const;
+
+  // Sets the registry of the counters. Does not take ownership of registry.
+  void set_counter_registry(PerfCounterRegistry *counter_registry) {
+    counter_registry_ = counter_registry;
+  }
+
  private:
+  // Gets the path of the marker that records the counters as enabled.
+  string GetMarkerPath() const;
+
+  // Wrapper for all calls to the kernel. Not owned.
+  const KernelApi *kernel_;
+
+  // Registry of the open counters. Not owned. Counters are unavailable if it
+  // is not set.
+  PerfCounterRegistry *counter_registry_;
+
   DISALLOW_COPY_AND_ASSIGN(PerfController);
 };
 
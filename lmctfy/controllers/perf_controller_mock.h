@@ -47,6 +47,12 @@ class MockPerfController : public PerfController {
   MockPerfController()
       : PerfController("", "", false, reinterpret_cast<KernelApi *>(0xFFFFFFFF),
                        reinterpret_cast<EventFdNotifications *>(0xFFFFFFFF)) {}
+
+  MOCK_METHOD0(EnableCounters, ::util::Status());
+  MOCK_METHOD0(DisableCounters, void());
+  MOCK_CONST_METHOD0(CountersEnabled, bool());
+  MOCK_CONST_METHOD0(GetCounters,
+                     ::util::StatusOr<MonitoringStats::PerfCounters>());
 };
 
 typedef ::testing::StrictMock<MockPerfController> StrictMockPerfController;
@@ -14,21 +14,39 @@
 
 #include "lmctfy/controllers/perf_controller.h"
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
 #include <memory>
 
+#include "gflags/gflags.h"
 #include "system_api/kernel_api_mock.h"
 #include "lmctfy/controllers/eventfd_notifications_mock.h"
 #include "lmctfy/kernel_files.h"
+#include "util/errors_test_util.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
 
+DECLARE_bool(lmctfy_perf_open_enabled_counters);
+
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetErrnoAndReturn;
+using ::testing::StrEq;
 using ::testing::StrictMock;
+using ::testing::_;
+using ::util::StatusOr;
 
 namespace containers {
 namespace lmctfy {
 
 static const char kMountPoint[] = "/dev/cgroup/perf_event/test";
 static const char kHierarchyPath[] = "/test";
+static const char kMarkerPath[] =
+    "/run/lmctfy/perf_counters/%2Fdev%2Fcgroup%2Fperf_event%2Ftest";
+static const char kMarkerDir[] = "/run/lmctfy/perf_counters";
+static const int kMarkerFd = 4;
 
 class PerfControllerTest : public ::testing::Test {
  public:
@@ -41,6 +59,26 @@ class PerfControllerTest : public ::testing::Test {
   }
 
  protected:
+  // Expects the counters to be recorded as enabled.
+  void ExpectWriteMarker() {
+    EXPECT_CALL(*mock_kernel_, MkDirRecursive(kMarkerDir)).WillOnce(Return(0));
+    EXPECT_CALL(*mock_kernel_, OpenWithMode(StrEq(kMarkerPath), _, _))
+        .WillOnce(Return(kMarkerFd));
+    EXPECT_CALL(*mock_kernel_, Close(kMarkerFd)).WillOnce(Return(0));
+  }
+
+  // Expects the marker of the counters to be checked, and to exist or not.
+  void ExpectMarkerExists(bool exists) {
+    EXPECT_CALL(*mock_kernel_, Access(kMarkerPath, F_OK))
+        .WillOnce(Return(exists ? 0 : -1));
+  }
+
+  // Expects the counters to be recorded as disabled.
+  void ExpectRemoveMarker() {
+    EXPECT_CALL(*mock_kernel_, Unlink(StrEq(kMarkerPath)))
+        .WillOnce(Return(0));
+  }
+
   ::std::unique_ptr< ::system_api::KernelAPIMock> mock_kernel_;
   ::std::unique_ptr<PerfController> controller_;
   ::std::unique_ptr<MockEventFdNotifications> mock_eventfd_notifications_;
@@ -54,5 +92,309 @@ TEST_F(PerfControllerTest, CreatesController) {
   EXPECT_TRUE(controller_.get() != NULL);
 }
 
+TEST_F(PerfControllerTest, CountersWithoutRegistry) {
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    controller_->EnableCounters());
+  EXPECT_FALSE(controller_->CountersEnabled());
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetCounters());
+  ExpectRemoveMarker();
+  controller_->DisableCounters();
+}
+
+static const int kCgroupFd = 3;
+
+// Returns a read() of a group leader with the specified times and values.
+static ::std::function<ssize_t(int, void *, int)> GroupRead(
+    uint64 time_enabled, uint64 time_running,
+    const ::std::vector<uint64> &values) {
+  return [time_enabled, time_running, values](int fd, void *buf, int count) {
+    ::std::vector<uint64> data = {values.size(), time_enabled, time_running};
+    data.insert(data.end(), values.begin(), values.end());
+    const int bytes = data.size() * sizeof(uint64);
+    EXPECT_GE(count, bytes);
+    memcpy(buf, data.data(), bytes);
+    return bytes;
+  };
+}
+
+class PerfCounterRegistryTest : public PerfControllerTest {
+ public:
+  virtual void SetUp() {
+    PerfControllerTest::SetUp();
+    registry_.reset(new PerfCounterRegistry(mock_kernel_.get()));
+    controller_->set_counter_registry(registry_.get());
+  }
+
+  // Expects the cgroup to be opened and closed once its events are open.
+  void ExpectOpenCgroup() {
+    EXPECT_CALL(*mock_kernel_, Open(::testing::StrEq(kMountPoint), _))
+        .WillOnce(Return(kCgroupFd));
+    EXPECT_CALL(*mock_kernel_, Close(kCgroupFd)).WillOnce(Return(0));
+  }
+
+  // Expects the num_events events of the group on cpu to be opened on fds
+  // starting at first_fd.
+  void ExpectOpenGroup(int cpu, int first_fd, int num_events) {
+    for (int i = 0; i < num_events; ++i) {
+      EXPECT_CALL(*mock_kernel_,
+                  PerfEventOpen(_, kCgroupFd, cpu, i == 0 ? -1 : first_fd, _))
+          .WillOnce(Return(first_fd + i))
+          .RetiresOnSaturation();
+    }
+  }
+
+  // Expects the fds from first_fd to be closed.
+  void ExpectCloseFds(int first_fd, int num_fds) {
+    for (int fd = first_fd; fd < first_fd + num_fds; ++fd) {
+      EXPECT_CALL(*mock_kernel_, Close(fd)).WillOnce(Return(0));
+    }
+  }
+
+ protected:
+  ::std::unique_ptr<PerfCounterRegistry> registry_;
+};
+
+TEST_F(PerfCounterRegistryTest, HardwareCounters) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(2));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  ExpectOpenGroup(1, 20, 4);
+  ExpectWriteMarker();
+
+  ASSERT_OK(controller_->EnableCounters());
+  EXPECT_TRUE(controller_->CountersEnabled());
+
+  // CPU 1 was multiplexed half of the time.
+  EXPECT_CALL(*mock_kernel_, Read(10, _, _))
+      .WillOnce(Invoke(GroupRead(100, 100, {1000, 2000, 10, 5})));
+  EXPECT_CALL(*mock_kernel_, Read(20, _, _))
+      .WillOnce(Invoke(GroupRead(100, 50, {500, 500, 5, 1})));
+
+  StatusOr<MonitoringStats::PerfCounters> statusor =
+      controller_->GetCounters();
+  ASSERT_OK(statusor);
+  const MonitoringStats::PerfCounters &counters = statusor.ValueOrDie();
+  EXPECT_TRUE(counters.hardware());
+  EXPECT_EQ(2000, counters.cycles());
+  EXPECT_EQ(3000, counters.instructions());
+  EXPECT_EQ(20, counters.llc_misses());
+  EXPECT_EQ(7, counters.context_switches());
+  EXPECT_FALSE(counters.has_cpu_clock());
+  EXPECT_DOUBLE_EQ(1.5, counters.ipc());
+  EXPECT_DOUBLE_EQ(2.0 / 3, counters.cpi());
+
+  ExpectCloseFds(10, 4);
+  ExpectCloseFds(20, 4);
+  ExpectRemoveMarker();
+  controller_->DisableCounters();
+  ExpectMarkerExists(false);
+  EXPECT_FALSE(controller_->CountersEnabled());
+  ExpectMarkerExists(false);
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetCounters());
+}
+
+TEST_F(PerfCounterRegistryTest, SkipsOfflineCpus) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(2));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  EXPECT_CALL(*mock_kernel_, PerfEventOpen(_, kCgroupFd, 1, -1, _))
+      .WillOnce(SetErrnoAndReturn(ENODEV, -1));
+  ExpectWriteMarker();
+
+  ASSERT_OK(controller_->EnableCounters());
+
+  EXPECT_CALL(*mock_kernel_, Read(10, _, _))
+      .WillOnce(Invoke(GroupRead(100, 100, {1000, 2000, 10, 5})));
+  StatusOr<MonitoringStats::PerfCounters> statusor =
+      controller_->GetCounters();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1000, statusor.ValueOrDie().cycles());
+
+  ExpectCloseFds(10, 4);
+}
+
+TEST_F(PerfCounterRegistryTest, FallsBackToSoftwareCounters) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillRepeatedly(Return(1));
+  ExpectOpenCgroup();
+
+  // The hardware group fails after its leader was opened.
+  EXPECT_CALL(*mock_kernel_, PerfEventOpen(_, kCgroupFd, 0, -1, _))
+      .WillOnce(Return(10))
+      .WillOnce(Return(20));
+  EXPECT_CALL(*mock_kernel_, PerfEventOpen(_, kCgroupFd, 0, 10, _))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
+  EXPECT_CALL(*mock_kernel_, Close(10)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, PerfEventOpen(_, kCgroupFd, 0, 20, _))
+      .WillOnce(Return(21));
+  ExpectWriteMarker();
+
+  ASSERT_OK(controller_->EnableCounters());
+
+  EXPECT_CALL(*mock_kernel_, Read(20, _, _))
+      .WillOnce(Invoke(GroupRead(100, 100, {123456, 7})));
+  StatusOr<MonitoringStats::PerfCounters> statusor =
+      controller_->GetCounters();
+  ASSERT_OK(statusor);
+  const MonitoringStats::PerfCounters &counters = statusor.ValueOrDie();
+  EXPECT_FALSE(counters.hardware());
+  EXPECT_EQ(123456, counters.cpu_clock());
+  EXPECT_EQ(7, counters.context_switches());
+  EXPECT_FALSE(counters.has_cycles());
+  EXPECT_FALSE(counters.has_ipc());
+
+  ExpectCloseFds(20, 2);
+}
+
+TEST_F(PerfCounterRegistryTest, OpenFails) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(1));
+  ExpectOpenCgroup();
+  EXPECT_CALL(*mock_kernel_, PerfEventOpen(_, kCgroupFd, 0, -1, _))
+      .WillOnce(SetErrnoAndReturn(EMFILE, -1));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, controller_->EnableCounters());
+  ExpectMarkerExists(false);
+  EXPECT_FALSE(controller_->CountersEnabled());
+}
+
+TEST_F(PerfCounterRegistryTest, CgroupNotFound) {
+  EXPECT_CALL(*mock_kernel_, Open(::testing::StrEq(kMountPoint), _))
+      .WillOnce(SetErrnoAndReturn(ENOENT, -1));
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->EnableCounters());
+}
+
+TEST_F(PerfCounterRegistryTest, EnableTwiceKeepsCounters) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(1));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  ExpectWriteMarker();
+  ASSERT_OK(controller_->EnableCounters());
+
+  // The marker is written again in case another process removed it.
+  ExpectWriteMarker();
+  ASSERT_OK(controller_->EnableCounters());
+
+  ExpectCloseFds(10, 4);
+}
+
+TEST_F(PerfCounterRegistryTest, MarkerFails) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(1));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  EXPECT_CALL(*mock_kernel_, MkDirRecursive(kMarkerDir)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, OpenWithMode(StrEq(kMarkerPath), _, _))
+      .WillOnce(SetErrnoAndReturn(EACCES, -1));
+
+  // The counters are closed again.
+  ExpectCloseFds(10, 4);
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, controller_->EnableCounters());
+  ExpectMarkerExists(false);
+  EXPECT_FALSE(controller_->CountersEnabled());
+}
+
+TEST_F(PerfCounterRegistryTest, MarkerDirFails) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(1));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  EXPECT_CALL(*mock_kernel_, MkDirRecursive(kMarkerDir))
+      .WillOnce(SetErrnoAndReturn(EACCES, -1));
+
+  ExpectCloseFds(10, 4);
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, controller_->EnableCounters());
+}
+
+TEST_F(PerfCounterRegistryTest, EnableParentAndChild) {
+  static const char kChildMountPoint[] = "/dev/cgroup/perf_event/test/sub";
+  static const char kChildMarkerPath[] =
+      "/run/lmctfy/perf_counters/%2Fdev%2Fcgroup%2Fperf_event%2Ftest%2Fsub";
+  PerfController child("/test/sub", kChildMountPoint, true, mock_kernel_.get(),
+                       mock_eventfd_notifications_.get());
+  child.set_counter_registry(registry_.get());
+
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus())
+      .WillRepeatedly(Return(1));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  ExpectWriteMarker();
+  ASSERT_OK(controller_->EnableCounters());
+
+  // The marker of the child is a file next to that of the parent, not inside
+  // it.
+  EXPECT_CALL(*mock_kernel_, Open(StrEq(kChildMountPoint), _))
+      .WillOnce(Return(kCgroupFd + 1));
+  EXPECT_CALL(*mock_kernel_, Close(kCgroupFd + 1)).WillOnce(Return(0));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_CALL(*mock_kernel_,
+                PerfEventOpen(_, kCgroupFd + 1, 0, i == 0 ? -1 : 20, _))
+        .WillOnce(Return(20 + i));
+  }
+  EXPECT_CALL(*mock_kernel_, MkDirRecursive(kMarkerDir)).WillOnce(Return(0));
+  EXPECT_CALL(*mock_kernel_, OpenWithMode(StrEq(kChildMarkerPath), _, _))
+      .WillOnce(Return(kMarkerFd + 1));
+  EXPECT_CALL(*mock_kernel_, Close(kMarkerFd + 1)).WillOnce(Return(0));
+  ASSERT_OK(child.EnableCounters());
+
+  // Disabling the child leaves the parent enabled.
+  ExpectCloseFds(20, 4);
+  EXPECT_CALL(*mock_kernel_, Unlink(StrEq(kChildMarkerPath)))
+      .WillOnce(Return(0));
+  child.DisableCounters();
+  EXPECT_TRUE(controller_->CountersEnabled());
+
+  ExpectCloseFds(10, 4);
+}
+
+TEST_F(PerfCounterRegistryTest, EnabledByAnotherProcessNotOpened) {
+  ExpectMarkerExists(true);
+  EXPECT_TRUE(controller_->CountersEnabled());
+
+  // Without opting in the counters are not opened.
+  ExpectMarkerExists(true);
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetCounters());
+}
+
+TEST_F(PerfCounterRegistryTest, EnabledByAnotherProcess) {
+  ::google::FlagSaver flag_saver;
+  FLAGS_lmctfy_perf_open_enabled_counters = true;
+
+  ExpectMarkerExists(true);
+  EXPECT_TRUE(controller_->CountersEnabled());
+
+  // The counters are opened on the first read, which has nothing to report.
+  ExpectMarkerExists(true);
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(1));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, controller_->GetCounters());
+
+  // And kept open.
+  EXPECT_CALL(*mock_kernel_, Read(10, _, _))
+      .WillOnce(Invoke(GroupRead(100, 100, {1000, 2000, 10, 5})))
+      .WillOnce(Invoke(GroupRead(200, 200, {3000, 4000, 20, 6})));
+  StatusOr<MonitoringStats::PerfCounters> statusor =
+      controller_->GetCounters();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1000, statusor.ValueOrDie().cycles());
+  statusor = controller_->GetCounters();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(3000, statusor.ValueOrDie().cycles());
+
+  ExpectCloseFds(10, 4);
+}
+
+TEST_F(PerfCounterRegistryTest, ReadFails) {
+  EXPECT_CALL(*mock_kernel_, GetNumConfiguredCpus()).WillOnce(Return(1));
+  ExpectOpenCgroup();
+  ExpectOpenGroup(0, 10, 4);
+  ExpectWriteMarker();
+  ASSERT_OK(controller_->EnableCounters());
+
+  EXPECT_CALL(*mock_kernel_, Read(10, _, _))
+      .WillOnce(SetErrnoAndReturn(EIO, -1));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, controller_->GetCounters());
+
+  ExpectCloseFds(10, 4);
+}
+
 }  // namespace lmctfy
 }  // namespace containers
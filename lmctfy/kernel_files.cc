@@ -154,6 +154,39 @@ const char KernelFiles::CGroup::kProcesses[] = "cgroup.procs";
 const char KernelFiles::CGroup::kEventfdInterface[] = "cgroup.event_control";
 const char KernelFiles::CGroup::kTasks[] = "tasks";
 const char KernelFiles::CGroup::kTracingEnabled[] = "tracing_enabled";
+const char KernelFiles::CGroup::kNotifyOnRelease[] = "notify_on_release";
+const char KernelFiles::CGroup::kReleaseAgent[] = "release_agent";
+
+const char KernelFiles::Unified::kControllers[] = "cgroup.controllers";
+const char KernelFiles::Unified::kSubtreeControl[] = "cgroup.subtree_control";
+const char KernelFiles::Unified::kEvents[] = "cgroup.events";
+const char KernelFiles::Unified::kThreads[] = "cgroup.threads";
+const char KernelFiles::Unified::kType[] = "cgroup.type";
+const char KernelFiles::Unified::kMaxDescendants[] = "cgroup.max.descendants";
+const char KernelFiles::Unified::kFreeze[] = "cgroup.freeze";
+const char KernelFiles::Unified::Types::kThreaded[] = "threaded";
+const char KernelFiles::Unified::Events::kPopulated[] = "populated";
+const char KernelFiles::Unified::Events::kFrozen[] = "frozen";
+const char KernelFiles::Unified::Cpu::kWeight[] = "cpu.weight";
+const char KernelFiles::Unified::Cpu::kMax[] = "cpu.max";
+const char KernelFiles::Unified::Cpu::kStat[] = "cpu.stat";
+const char KernelFiles::Unified::Cpu::kPressure[] = "cpu.pressure";
+const char KernelFiles::Unified::Memory::kCurrent[] = "memory.current";
+const char KernelFiles::Unified::Memory::kPeak[] = "memory.peak";
+const char KernelFiles::Unified::Memory::kMax[] = "memory.max";
+const char KernelFiles::Unified::Memory::kLow[] = "memory.low";
+const char KernelFiles::Unified::Memory::kEvents[] = "memory.events";
+const char KernelFiles::Unified::Memory::kPressure[] = "memory.pressure";
+const char KernelFiles::Unified::IO::kMax[] = "io.max";
+const char KernelFiles::Unified::IO::kWeight[] = "io.weight";
+const char KernelFiles::Unified::IO::kStat[] = "io.stat";
+const char KernelFiles::Unified::IO::kPressure[] = "io.pressure";
+const char KernelFiles::Unified::Pressure::kSome[] = "some";
+const char KernelFiles::Unified::Pressure::kFull[] = "full";
+const char KernelFiles::Unified::Pressure::kAvg10[] = "avg10";
+const char KernelFiles::Unified::Pressure::kAvg60[] = "avg60";
+const char KernelFiles::Unified::Pressure::kAvg300[] = "avg300";
+const char KernelFiles::Unified::Pressure::kTotal[] = "total";
 
 const char KernelFiles::kJobId[] = "job.id";
 const char KernelFiles::kOOMDelay[] = "memory.oom_delay_millisecs";
@@ -211,6 +211,94 @@ struct KernelFiles {
     static const char kEventfdInterface[];
     static const char kTasks[];
     static const char kTracingEnabled[];
+    // Whether to run the release agent once the cgroup is empty.
+    static const char kNotifyOnRelease[];
+    // Release agent of a hierarchy, only in its root cgroup.
+    static const char kReleaseAgent[];
+  };
+
+  // Files of the cgroup v2 unified hierarchy. Where v2 keeps the v1 name
+  // (e.g.: cgroup.procs, cpuset.cpus, memory.stat) the v1 constant is used.
+  struct Unified {
+   public:
+    // Controllers available to the children of a cgroup.
+    static const char kControllers[];
+    // Controllers enabled for the children of a cgroup.
+    static const char kSubtreeControl[];
+    // Keyed events of a cgroup, see Events below.
+    static const char kEvents[];
+    // Threads in a cgroup.
+    static const char kThreads[];
+    // Type of a cgroup, see Types below.
+    static const char kType[];
+    // Maximum number of descendants of a cgroup.
+    static const char kMaxDescendants[];
+    // Whether a cgroup and its descendants are frozen.
+    static const char kFreeze[];
+
+    // Values of the kType file.
+    struct Types {
+     public:
+      static const char kThreaded[];
+    };
+
+    // Fields in kEvents file.
+    struct Events {
+     public:
+      static const char kPopulated[];
+      static const char kFrozen[];
+    };
+
+    struct Cpu {
+     public:
+      // CPU throughput, the replacement of cpu.shares. Range 1 to 10000.
+      static const char kWeight[];
+      // Quota and period for throttling, as "$QUOTA $PERIOD".
+      static const char kMax[];
+      // CPU usage and throttling stats.
+      static const char kStat[];
+      // Pressure stall information, see Pressure below.
+      static const char kPressure[];
+    };
+
+    struct Memory {
+     public:
+      static const char kCurrent[];
+      static const char kPeak[];
+      static const char kMax[];
+      static const char kLow[];
+      // Number of times the limits were hit, keyed by limit.
+      static const char kEvents[];
+      static const char kPressure[];
+    };
+
+    struct IO {
+     public:
+      // Per-device throttling limits, as "$MAJ:$MIN rbps= wbps= riops= wiops=".
+      static const char kMax[];
+      // Default and per-device weights. Range 1 to 10000.
+      static const char kWeight[];
+      // Per-device IO accounting, as "$MAJ:$MIN rbytes= wbytes= rios= wios=
+      // dbytes= dios=".
+      static const char kStat[];
+      static const char kPressure[];
+    };
+
+    // Lines and fields of the pressure stall information files, e.g.:
+    //   some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    //   full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    // Writing a trigger, as "$LINE $THRESHOLD_USECS $WINDOW_USECS", to an open
+    // file makes the kernel signal POLLPRI on it when the threshold is
+    // exceeded.
+    struct Pressure {
+     public:
+      static const char kSome[];
+      static const char kFull[];
+      static const char kAvg10[];
+      static const char kAvg60[];
+      static const char kAvg300[];
+      static const char kTotal[];
+    };
   };
 
   // TODO(jonathanw): Describe (and organize?) these properly
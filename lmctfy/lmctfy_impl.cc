@@ -14,6 +14,7 @@
 
 #include "lmctfy/lmctfy_impl.h"
 
+#include <fcntl.h>
 #include <sys/time.h>
 
 #include <algorithm>
@@ -26,57 +27,116 @@
 #include "gflags/gflags.h"
 #include "base/integral_types.h"
 #include "base/logging.h"
+#include "base/mutex.h"
 #include "util/eventfd_listener.h"
+#include "util/sharded_eventfd_listener.h"
 #include "file/base/file.h"
 #include "file/base/path.h"
 #include "lmctfy/active_notifications.h"
 #include "lmctfy/cgroup_tasks_handler.h"
 #include "lmctfy/controllers/cgroup_factory.h"
+#include "lmctfy/controllers/cgroup_write_batch.h"
 #include "lmctfy/controllers/eventfd_notifications.h"
 #include "lmctfy/controllers/freezer_controller.h"
 #include "lmctfy/controllers/freezer_controller_stub.h"
 #include "lmctfy/controllers/job_controller.h"
 #include "lmctfy/namespace_handler.h"
 #include "lmctfy/tasks_handler.h"
+#include "lmctfy/warm_pool.h"
 #include "include/lmctfy.pb.h"
 #include "util/safe_types/unix_gid.h"
 #include "util/safe_types/unix_uid.h"
 #include "util/errors.h"
+#include "util/process/subprocess.h"
 #include "util/scoped_cleanup.h"
 #include "strings/split.h"
 #include "strings/substitute.h"
 #include "thread/thread.h"
 #include "thread/thread_options.h"
+#include "thread/thread_pool.h"
 #include "util/gtl/stl_util.h"
 #include "re2/re2.h"
 #include "util/task/codes.pb.h"
 
 DEFINE_int32(lmctfy_num_tries_for_unkillable, 3,
-             "The number of times to try to kill a PID/TID before considering "
-             "the PID/TID unkillable. See flag "
-             "\"lmctfy_ms_delay_between_kills\" for the duration of the "
-             "delay between tries.");
+             "Bounds how long to wait for PIDs/TIDs to die before considering "
+             "them unkillable, as a multiple of "
+             "\"lmctfy_ms_delay_between_kills\".");
 
 DEFINE_int32(lmctfy_ms_delay_between_kills, 250,
-             "The number of milliseconds to wait between kill attempts.");
+             "The maximum number of milliseconds to wait between kill "
+             "attempts.");
 
+DEFINE_int32(lmctfy_us_initial_delay_between_kills, 100,
+             "The number of microseconds to wait after the first kill "
+             "attempt. The delay doubles on every attempt up to "
+             "\"lmctfy_ms_delay_between_kills\".");
+
+
+DEFINE_int32(lmctfy_destroy_threads, 4,
+             "The maximum number of subcontainers to destroy concurrently. "
+             "1 destroys them one at a time.");
+
+DEFINE_int32(lmctfy_eventfd_listener_shards, 1,
+             "The number of threads that listen for eventfd-based "
+             "notifications. With more than one, notification callbacks run "
+             "on a separate pool of "
+             "\"lmctfy_eventfd_callback_threads\" threads.");
+
+DEFINE_int32(lmctfy_eventfd_callback_threads, 4,
+             "The number of threads that run eventfd-based notification "
+             "callbacks when \"lmctfy_eventfd_listener_shards\" is more than "
+             "one.");
+
+DEFINE_bool(lmctfy_cache_resource_handlers, true,
+            "Whether a container keeps its resource handlers between "
+            "operations instead of creating them for every operation.");
+
+DEFINE_int32(lmctfy_stats_sample_interval_ms, 1000,
+             "The number of milliseconds between samples of the containers "
+             "whose stats rates are requested.");
+
+DEFINE_int32(lmctfy_stats_samples, 60,
+             "The number of samples of each container that its stats rates "
+             "are computed over.");
+
+DEFINE_int32(lmctfy_stats_max_idle_samples, 300,
+             "Containers whose stats rates are not requested for this many "
+             "samples stop being sampled. 0 samples them until they are "
+             "destroyed.");
+
+DEFINE_int32(lmctfy_warm_pool_size, 0,
+             "The number of warm containers kept ready to be claimed by "
+             "Create() for each kind of container. 0 disables the warm "
+             "container pool.");
+
+DEFINE_int32(lmctfy_warm_pool_max_pools, 16,
+             "The maximum number of kinds of containers (parent and isolated "
+             "resources) that warm containers are kept for.");
 
 DEFINE_bool(lmctfy_use_namespaces,
             true,
             "Whether lmctfy uses namespaces.");
 
 using ::util::EventfdListener;
+using ::util::EventfdListenerFactory;
+using ::util::ShardedEventfdListener;
 using ::containers::InitSpec;
 using ::util::UnixGid;
 using ::util::UnixGidValue;
 using ::util::UnixUid;
 using ::util::UnixUidValue;
 using ::util::ScopedCleanup;
+using ::std::function;
 using ::std::make_pair;
 using ::std::map;
+using ::std::max;
+using ::std::min;
 using ::std::move;
+using ::std::pair;
 using ::std::queue;
 using ::std::set;
+using ::std::shared_ptr;
 using ::std::unique_ptr;
 using ::std::vector;
 using ::strings::Split;
@@ -158,6 +218,53 @@ StatusOr<T> EnterThreadAndDo(
   return statusor;
 }
 
+// Runs the callback on the calling thread with the processes it starts cloned
+// straight into the cgroup at cgroup_path. Kernel is borrowed. |action|
+// doesn't have to be repeatable.
+template <typename T>
+StatusOr<T> CloneIntoCgroupAndDo(const KernelApi *kernel,
+                                 const string &cgroup_path,
+                                 ResultCallback<StatusOr<T>> *action) {
+  const int cgroup_fd =
+      kernel->Open(cgroup_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (cgroup_fd < 0) {
+    return Status(::util::error::INTERNAL,
+                  Substitute("Failed to open cgroup \"$0\": $1", cgroup_path,
+                             StrError(errno)));
+  }
+
+  StatusOr<T> statusor;
+  {
+    ScopedCloneIntoCgroup clone_into_cgroup(cgroup_fd);
+    statusor = action->Run();
+  }
+  kernel->Close(cgroup_fd);
+
+  return statusor;
+}
+
+// Runs the callback with the processes it starts in the container of these
+// handlers. When the container's cgroups are all in the unified hierarchy, the
+// processes are cloned into its cgroup. Otherwise the callback runs on a
+// thread entered into the handlers. All arguments are borrowed. |action|
+// doesn't have to be repeatable.
+template <typename T>
+StatusOr<T> DoInContainer(const ContainerApiImpl *lmctfy,
+                          const KernelApi *kernel,
+                          const vector<ResourceHandler *> &resource_handlers,
+                          TasksHandler *tasks_handler,
+                          FreezerController *freezer_controller,
+                          ResultCallback<StatusOr<T>> *action) {
+  const string clone_cgroup_path = RETURN_IF_ERROR(lmctfy->GetCloneCgroupPath(
+      resource_handlers, *tasks_handler, *freezer_controller));
+  if (!clone_cgroup_path.empty()) {
+    return CloneIntoCgroupAndDo(kernel, clone_cgroup_path, action);
+  }
+
+  return EnterThreadAndDo(resource_handlers, tasks_handler,
+                          freezer_controller, action);
+}
+
 template<typename T, typename U>
 StatusOr<T *> GetHandler(const string &name, U resource_handler_factory) {
   // Try to progressively attach to the parent container's resource if the
@@ -259,11 +366,20 @@ StatusOr<ContainerApiImpl *> ContainerApiImpl::NewContainerApiImpl(
   // Create the notifications subsystem.
   unique_ptr<ActiveNotifications> active_notifications(
       new ActiveNotifications());
+  EventfdListener *event_listener;
+  if (FLAGS_lmctfy_eventfd_listener_shards > 1) {
+    EventfdListenerFactory listener_factory;
+    event_listener = new ShardedEventfdListener(
+        *kernel, "lmctfy_eventfd_listener", nullptr, false, 20,
+        FLAGS_lmctfy_eventfd_listener_shards,
+        FLAGS_lmctfy_eventfd_callback_threads, &listener_factory);
+  } else {
+    event_listener = new EventfdListener(*kernel, "lmctfy_eventfd_listener",
+                                         nullptr, false, 20);
+  }
   unique_ptr<EventFdNotifications> eventfd_notifications(
-      new EventFdNotifications(
-          active_notifications.get(),
-          new EventfdListener(*kernel, "lmctfy_eventfd_listener", nullptr,
-                              false, 20)));
+      new EventFdNotifications(active_notifications.get(), event_listener,
+                               kernel));
 
   // Create the resource handler factories.
   vector<ResourceHandlerFactory *> resource_factories;
@@ -352,6 +468,19 @@ Status ContainerApiImpl::InitMachineImpl(const KernelApi *kernel,
   return lmctfy->InitMachine(spec);
 }
 
+// Determines whether the cgroups of containers can be renamed. The unified
+// hierarchy does not support it.
+static bool CanRenameCgroups(const CgroupFactory &cgroup_factory) {
+  for (CgroupHierarchy hierarchy : cgroup_factory.GetSupportedHierarchies()) {
+    if (cgroup_factory.IsMounted(hierarchy) &&
+        cgroup_factory.OwnsCgroup(hierarchy) &&
+        cgroup_factory.IsUnified(hierarchy)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 ContainerApiImpl::ContainerApiImpl(
     TasksHandlerFactory *tasks_handler_factory,
     unique_ptr<CgroupFactory> cgroup_factory,
@@ -371,15 +500,44 @@ ContainerApiImpl::ContainerApiImpl(
   for (const auto &handler : resource_factories) {
     resource_factories_[handler->type()] = handler;
   }
+
+  // Warm containers are claimed by renaming their cgroups.
+  if (FLAGS_lmctfy_warm_pool_size > 0 && CanRenameCgroups(*cgroup_factory_)) {
+    warm_pool_.reset(new WarmPool(this, FLAGS_lmctfy_warm_pool_size,
+                                  FLAGS_lmctfy_warm_pool_max_pools));
+    warm_pool_->Start();
+  }
 }
 
-ContainerApiImpl::~ContainerApiImpl() { STLDeleteValues(&resource_factories_); }
+ContainerApiImpl::~ContainerApiImpl() {
+  // Stop sampling before the resource factories go away.
+  {
+    MutexLock l(&stats_sampler_lock_);
+    stats_sampler_.reset();
+  }
+
+  // Warm containers are only useful to this instance.
+  if (warm_pool_ != nullptr) {
+    Status status = warm_pool_->Drain("/");
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to destroy warm containers: "
+                   << status.ToString();
+    }
+    warm_pool_.reset();
+  }
+  STLDeleteValues(&resource_factories_);
+}
 
 StatusOr<Container *> ContainerApiImpl::Get(StringPiece container_name) const {
   // Resolve the container name.
   const string resolved_name =
       RETURN_IF_ERROR(ResolveContainerName(container_name));
 
+  return GetResolved(resolved_name);
+}
+
+StatusOr<Container *> ContainerApiImpl::GetResolved(
+    const string &resolved_name) const {
   // Ensure it exists.
   if (!Exists(resolved_name)) {
     return Status(
@@ -438,10 +596,6 @@ StatusOr<Container *> ContainerApiImpl::Create(StringPiece container_name,
     return Status(::util::error::INVALID_ARGUMENT, "Container name is missing");
   }
 
-  // Get which ResourceHandlerFactories are being used by the spec.
-  set<ResourceHandlerFactory *> used_handler_factories;
-  GetUsedResourceHandlers(spec, resource_factories_, &used_handler_factories);
-
   // Resolve the container name.
   const string resolved_name =
       RETURN_IF_ERROR(ResolveContainerName(container_name));
@@ -453,6 +607,64 @@ StatusOr<Container *> ContainerApiImpl::Create(StringPiece container_name,
         Substitute("Can't create existing container \"$0\"", resolved_name));
   }
 
+  // Claim a warm container if there is one, else create it from scratch.
+  if (warm_pool_ != nullptr && WarmPool::CanClaim(spec)) {
+    Status status = warm_pool_->Claim(resolved_name, spec);
+    if (status.ok()) {
+      return SetUpClaimedContainer(resolved_name, spec);
+    }
+    if (status.error_code() != ::util::error::NOT_FOUND) {
+      LOG(WARNING) << "Failed to claim a warm container for \""
+                   << resolved_name << "\": " << status.ToString();
+    }
+  }
+
+  StatusOr<Container *> statusor = CreateResolved(resolved_name, spec);
+  if (statusor.ok() || warm_pool_ == nullptr) {
+    return statusor;
+  }
+
+  // Warm siblings count against the children limit of the parent. Stop
+  // keeping them there and retry if that gave back any places.
+  StatusOr<int> evicted_statusor =
+      warm_pool_->Evict(file::Dirname(resolved_name).ToString());
+  if (!evicted_statusor.ok()) {
+    LOG(WARNING) << "Failed to evict the warm containers next to \""
+                 << resolved_name << "\": "
+                 << evicted_statusor.status().ToString();
+    return statusor;
+  }
+  if (evicted_statusor.ValueOrDie() == 0) {
+    return statusor;
+  }
+  return CreateResolved(resolved_name, spec);
+}
+
+StatusOr<Container *> ContainerApiImpl::SetUpClaimedContainer(
+    const string &resolved_name, const ContainerSpec &spec) const {
+  unique_ptr<Container> container(RETURN_IF_ERROR(GetResolved(resolved_name)));
+
+  // The warm container has the default settings, only apply what the spec
+  // changes.
+  Status status = container->Update(spec, Container::UPDATE_DIFF);
+  if (!status.ok()) {
+    Status destroy_status = container->Destroy();
+    if (!destroy_status.ok()) {
+      LOG(WARNING) << "Failed to destroy claimed container \""
+                   << resolved_name << "\": " << destroy_status.ToString();
+    }
+    return status;
+  }
+
+  return container.release();
+}
+
+StatusOr<Container *> ContainerApiImpl::CreateResolved(
+    const string &resolved_name, const ContainerSpec &spec) const {
+  // Get which ResourceHandlerFactories are being used by the spec.
+  set<ResourceHandlerFactory *> used_handler_factories;
+  GetUsedResourceHandlers(spec, resource_factories_, &used_handler_factories);
+
   // Create Freezer Cgroup before creating the tasks handler since tasks handler
   // can use Freezer internally.
   UniqueDestroyPtr<FreezerController> freezer_controller(
@@ -517,7 +729,9 @@ StatusOr<Container *> ContainerApiImpl::Create(StringPiece container_name,
                              machine_spec_ptr));
     unique_ptr<NamespaceHandler> namespace_handler(
         RETURN_IF_ERROR(
-            EnterThreadAndDo(
+            DoInContainer(
+                this,
+                kernel_,
                 all_resource_handlers,
                 tasks_handler.get(),
                 freezer_controller.get(),
@@ -536,14 +750,51 @@ StatusOr<Container *> ContainerApiImpl::Create(StringPiece container_name,
 }
 
 Status ContainerApiImpl::Destroy(Container *container) const {
-  // Get all subcontainers to destroy them.
-  vector<Container *> subcontainers =
-      RETURN_IF_ERROR(container->ListSubcontainers(Container::LIST_RECURSIVE));
+  if (warm_pool_ != nullptr) {
+    RETURN_IF_ERROR(warm_pool_->Drain(container->name()));
+  }
+
+  // Walk the tree under the container once, it has both the subcontainers and
+  // the warm containers.
+  unique_ptr<TasksHandler> tasks_handler(
+      RETURN_IF_ERROR(tasks_handler_factory_->Get(container->name())));
+  vector<string> subcontainer_names = RETURN_IF_ERROR(
+      tasks_handler->ListSubcontainers(TasksHandler::ListType::RECURSIVE));
+
+  // Warm containers are not subcontainers, destroy them first. Those of other
+  // processes (which may not keep a pool) are destroyed too: their cgroups are
+  // not all under the container's.
+  auto warm_end =
+      stable_partition(subcontainer_names.begin(), subcontainer_names.end(),
+                       &WarmPool::IsWarmName);
+  for (auto it = subcontainer_names.begin(); it != warm_end; ++it) {
+    Status status = DestroyWarm(*it);
+    if (!status.ok() && status.error_code() != ::util::error::NOT_FOUND) {
+      return status;
+    }
+  }
+  subcontainer_names.erase(subcontainer_names.begin(), warm_end);
+
+  // Get all subcontainers to destroy them. Sorted by name, the children of a
+  // container are always after their parent.
+  sort(subcontainer_names.begin(), subcontainer_names.end());
+  vector<Container *> subcontainers;
+  ScopedCleanup cleanup([&subcontainers]() {
+    STLDeleteElements(&subcontainers);
+  });
+  for (const string &subcontainer_name : subcontainer_names) {
+    subcontainers.emplace_back(RETURN_IF_ERROR(Get(subcontainer_name)));
+  }
+  cleanup.Cancel();
+
+  if (FLAGS_lmctfy_destroy_threads > 1 && subcontainers.size() > 1) {
+    RETURN_IF_ERROR(DestroySubcontainersInParallel(subcontainers));
+    return DestroyDeleteContainer(container);
+  }
 
   // Destroy the subcontainers
-  // Subcontainers are sorted by container name so that the children of a
-  // container are always after their parent. We iterate backwards so that all
-  // children are destroyed before their parent.
+  // We iterate backwards so that all children are destroyed before their
+  // parent.
   Status status;
   for (auto it = subcontainers.rbegin(); it != subcontainers.rend(); ++it) {
     status = DestroyDeleteContainer(*it);
@@ -557,6 +808,69 @@ Status ContainerApiImpl::Destroy(Container *container) const {
   return DestroyDeleteContainer(container);
 }
 
+Status ContainerApiImpl::DestroySubcontainersInParallel(
+    const vector<Container *> &subcontainers) const {
+  // Build the tree: the parent of each subcontainer is either another
+  // subcontainer or the container being destroyed (which has no index).
+  const int kNoParent = -1;
+  map<string, int> index_by_name;
+  for (int i = 0; i < subcontainers.size(); ++i) {
+    index_by_name[subcontainers[i]->name()] = i;
+  }
+  vector<int> parent(subcontainers.size(), kNoParent);
+  vector<int> num_children(subcontainers.size(), 0);
+  for (int i = 0; i < subcontainers.size(); ++i) {
+    auto it = index_by_name.find(
+        ::file::Dirname(subcontainers[i]->name()).ToString());
+    if (it != index_by_name.end()) {
+      parent[i] = it->second;
+      ++num_children[it->second];
+    }
+  }
+
+  // Destroy the leaves first. Each destroyed subcontainer schedules its parent
+  // once all of the parent's children are gone. The first failure stops
+  // scheduling new work.
+  ThreadPool pool(min(static_cast<size_t>(FLAGS_lmctfy_destroy_threads),
+                      subcontainers.size()));
+  Mutex lock;
+  Status status;
+  function<void(int)> destroy = [&](int i) {
+    {
+      MutexLock l(&lock);
+      if (!status.ok()) {
+        return;
+      }
+    }
+
+    Status destroy_status = subcontainers[i]->Destroy();
+
+    MutexLock l(&lock);
+    if (!destroy_status.ok()) {
+      if (status.ok()) {
+        status = destroy_status;
+      }
+      return;
+    }
+    const int parent_index = parent[i];
+    if (parent_index != kNoParent && --num_children[parent_index] == 0) {
+      pool.Schedule([&destroy, parent_index]() { destroy(parent_index); });
+    }
+  };
+
+  pool.StartWorkers();
+  for (int i = 0; i < subcontainers.size(); ++i) {
+    if (num_children[i] == 0) {
+      pool.Schedule([&destroy, i]() { destroy(i); });
+    }
+  }
+  pool.Wait();
+
+  // Destroyed or not, we are done with the subcontainers.
+  STLDeleteContainerPointers(subcontainers.begin(), subcontainers.end());
+  return status;
+}
+
 Status ContainerApiImpl::DestroyDeleteContainer(Container *container) const {
   // Destroy all resources.
   RETURN_IF_ERROR(container->Destroy());
@@ -565,14 +879,241 @@ Status ContainerApiImpl::DestroyDeleteContainer(Container *container) const {
   return Status::OK;
 }
 
+Status ContainerApiImpl::CreateWarm(const string &warm_name,
+                                    const ContainerSpec &spec) const {
+  unique_ptr<Container> container(
+      RETURN_IF_ERROR(CreateResolved(warm_name, spec)));
+  return Status::OK;
+}
+
+Status ContainerApiImpl::RenameWarm(const string &warm_name,
+                                    const string &new_name) const {
+  // Find where the cgroups of the warm container are from its handlers.
+  MachineSpec machine_spec;
+  {
+    vector<ResourceHandler *> resource_handlers = RETURN_IF_ERROR(
+        GetResourceHandlersFor(warm_name, resource_factories_));
+    ElementDeleter d(&resource_handlers);
+    for (const ResourceHandler *handler : resource_handlers) {
+      RETURN_IF_ERROR(handler->PopulateMachineSpec(&machine_spec));
+    }
+  }
+  unique_ptr<FreezerController> freezer_controller(
+      RETURN_IF_ERROR(freezer_controller_factory_->Get(warm_name)));
+  RETURN_IF_ERROR(freezer_controller->PopulateMachineSpec(&machine_spec));
+  unique_ptr<TasksHandler> tasks_handler(
+      RETURN_IF_ERROR(tasks_handler_factory_->Get(warm_name)));
+  RETURN_IF_ERROR(tasks_handler->PopulateMachineSpec(&machine_spec));
+
+  // Rename the cgroups the warm container owns. Handlers of resources it does
+  // not isolate are those of an ancestor, whose cgroups have another name.
+  // Hierarchies that are co-mounted or share a controller have the cgroup
+  // renamed already by the time they are reached.
+  const StringPiece warm_basename = ::file::Basename(warm_name);
+  const string new_basename = ::file::Basename(new_name).ToString();
+  vector<pair<CgroupHierarchy, pair<string, string>>> renamed;
+  Status status;
+  for (const auto &virtual_root :
+       machine_spec.virtual_root().cgroup_virtual_root()) {
+    const CgroupHierarchy hierarchy = virtual_root.hierarchy();
+    const string &path = virtual_root.root();
+    if (::file::Basename(path) != warm_basename ||
+        !cgroup_factory_->OwnsCgroup(hierarchy) ||
+        !cgroup_factory_->Get(hierarchy, path).ok()) {
+      continue;
+    }
+
+    const string new_path =
+        ::file::JoinPath(::file::Dirname(path).ToString(), new_basename);
+    status = cgroup_factory_->Rename(hierarchy, path, new_path);
+    if (!status.ok()) {
+      break;
+    }
+    renamed.emplace_back(hierarchy, make_pair(path, new_path));
+  }
+
+  if (!status.ok()) {
+    for (auto it = renamed.rbegin(); it != renamed.rend(); ++it) {
+      Status undo_status = cgroup_factory_->Rename(it->first, it->second.second,
+                                                   it->second.first);
+      if (!undo_status.ok()) {
+        LOG(WARNING) << "Failed to undo rename of warm container \""
+                     << warm_name << "\": " << undo_status.ToString();
+      }
+    }
+    return status;
+  }
+
+  return Status::OK;
+}
+
+StatusOr<string> ContainerApiImpl::GetCloneCgroupPath(
+    const vector<ResourceHandler *> &resource_handlers,
+    const TasksHandler &tasks_handler,
+    const FreezerController &freezer_controller) const {
+  if (!cgroup_factory_->HasUnified()) {
+    return string();
+  }
+
+  // The tasks handler goes last so that its cgroup is the last virtual root.
+  MachineSpec machine_spec;
+  for (const ResourceHandler *handler : resource_handlers) {
+    RETURN_IF_ERROR(handler->PopulateMachineSpec(&machine_spec));
+  }
+  RETURN_IF_ERROR(freezer_controller.PopulateMachineSpec(&machine_spec));
+  RETURN_IF_ERROR(tasks_handler.PopulateMachineSpec(&machine_spec));
+
+  const auto &virtual_roots = machine_spec.virtual_root().cgroup_virtual_root();
+  if (virtual_roots.size() == 0) {
+    return string();
+  }
+  for (const auto &virtual_root : virtual_roots) {
+    if (!cgroup_factory_->IsUnified(virtual_root.hierarchy())) {
+      return string();
+    }
+  }
+
+  // A process is in a single cgroup of the unified hierarchy, the one its
+  // tasks are tracked in. Handlers inherited from an ancestor apply to it
+  // there too.
+  const auto &tasks_root = virtual_roots.Get(virtual_roots.size() - 1);
+  return cgroup_factory_->Get(tasks_root.hierarchy(), tasks_root.root());
+}
+
+Status ContainerApiImpl::DestroyWarm(const string &warm_name) const {
+  unique_ptr<Container> container(RETURN_IF_ERROR(GetResolved(warm_name)));
+  return container->Destroy();
+}
+
+StatusOr<vector<string>> ContainerApiImpl::ListWarm(
+    const string &container_name) const {
+  unique_ptr<TasksHandler> tasks_handler(
+      RETURN_IF_ERROR(tasks_handler_factory_->Get(container_name)));
+  const vector<string> subcontainer_names = RETURN_IF_ERROR(
+      tasks_handler->ListSubcontainers(TasksHandler::ListType::RECURSIVE));
+
+  vector<string> warm_names;
+  for (const string &subcontainer_name : subcontainer_names) {
+    if (WarmPool::IsWarmName(subcontainer_name)) {
+      warm_names.emplace_back(subcontainer_name);
+    }
+  }
+  return warm_names;
+}
+
 bool ContainerApiImpl::Exists(const string &resolved_container_name) const {
   return tasks_handler_factory_->Exists(resolved_container_name);
 }
 
+StatusOr<string> ContainerApiImpl::DetectFreezerCgroup(pid_t tid) const {
+  return cgroup_factory_->DetectCgroupPath(tid, CGROUP_FREEZER);
+}
+
 StatusOr<string> ContainerApiImpl::Detect(pid_t tid) const {
   return tasks_handler_factory_->Detect(tid);
 }
 
+StatusOr<map<string, ContainerStats>> ContainerApiImpl::StatsMany(
+    const vector<string> &container_names, Container::StatsType type,
+    map<string, Status> *errors) const {
+  // Let the namespace handlers share their reads between the containers.
+  namespace_handler_factory_->BeginStatsSweep();
+  ScopedCleanup end_sweep([this]() {
+    namespace_handler_factory_->EndStatsSweep();
+  });
+
+  // The resources of a container share cgroup directories, check each one
+  // once.
+  unique_ptr<CgroupLookupBatch> lookup_batch(new CgroupLookupBatch());
+
+  map<string, ContainerStats> output;
+  for (const string &container_name : container_names) {
+    StatusOr<string> statusor = ResolveContainerName(container_name);
+    if (!statusor.ok()) {
+      if (errors == nullptr) {
+        return statusor.status();
+      }
+      (*errors)[container_name] = statusor.status();
+      continue;
+    }
+    const string &resolved_name = statusor.ValueOrDie();
+
+    // Skip containers we already have stats for and those that don't exist.
+    if (output.find(resolved_name) != output.end() || !Exists(resolved_name)) {
+      continue;
+    }
+
+    ContainerStats stats;
+    Status status = StatsFor(resolved_name, type, &stats);
+    if (!status.ok()) {
+      // The container may have been destroyed while we were reading its stats.
+      // The batch remembers it as it was, check again without it.
+      lookup_batch.reset();
+      const bool exists = Exists(resolved_name);
+      lookup_batch.reset(new CgroupLookupBatch());
+      if (!exists) {
+        continue;
+      }
+      if (errors == nullptr) {
+        return status;
+      }
+      (*errors)[resolved_name] = status;
+      continue;
+    }
+    output[resolved_name].Swap(&stats);
+  }
+
+  return output;
+}
+
+StatusOr<ContainerStatsRates> ContainerApiImpl::StatsRates(
+    StringPiece container_name) const {
+  const string resolved_name =
+      RETURN_IF_ERROR(ResolveContainerName(container_name));
+
+  StatsSampler *sampler;
+  {
+    MutexLock l(&stats_sampler_lock_);
+    if (stats_sampler_ == nullptr) {
+      stats_sampler_.reset(new StatsSampler(
+          this, FLAGS_lmctfy_stats_samples,
+          FLAGS_lmctfy_stats_sample_interval_ms,
+          FLAGS_lmctfy_stats_max_idle_samples));
+      stats_sampler_->Start();
+    }
+    sampler = stats_sampler_.get();
+  }
+
+  RETURN_IF_ERROR(sampler->AddContainer(resolved_name));
+  return sampler->GetRates(resolved_name);
+}
+
+Status ContainerApiImpl::StatsFor(const string &container_name,
+                                  Container::StatsType type,
+                                  ContainerStats *output) const {
+  // Attach directly to the container's handlers rather than walking up to the
+  // parent on NOT_FOUND. A NOT_FOUND means this container shares that resource
+  // with an ancestor, and Stats() ignores inherited handlers anyway.
+  for (const auto &type_factory_pair : resource_factories_) {
+    StatusOr<ResourceHandler *> statusor =
+        type_factory_pair.second->Get(container_name);
+    if (statusor.status().error_code() == ::util::error::NOT_FOUND) {
+      continue;
+    }
+    unique_ptr<ResourceHandler> handler(RETURN_IF_ERROR(statusor));
+    RETURN_IF_ERROR(handler->Stats(type, output));
+  }
+
+  StatusOr<NamespaceHandler *> statusor =
+      namespace_handler_factory_->GetNamespaceHandler(container_name);
+  if (statusor.status().error_code() != ::util::error::NOT_FOUND) {
+    unique_ptr<NamespaceHandler> handler(RETURN_IF_ERROR(statusor));
+    RETURN_IF_ERROR(handler->Stats(type, output));
+  }
+
+  return Status::OK;
+}
+
 Status ContainerApiImpl::InitMachine(const InitSpec &spec) const {
   // Initialize the resource handlers.
   for (auto type_handler_pair : resource_factories_) {
@@ -635,11 +1176,12 @@ Status ContainerImpl::Update(const ContainerSpec &spec, UpdatePolicy policy) {
   RETURN_IF_ERROR(Exists());
 
   // Get all resources and map them by type.
+  shared_ptr<const CachedHandlers> handlers =
+      RETURN_IF_ERROR(GetCachedGeneralResourceHandlers());
   map<ResourceType, GeneralResourceHandler *> all_handlers;
-  for (auto *handler : RETURN_IF_ERROR(GetGeneralResourceHandlers())) {
-    all_handlers[handler->type()] = handler;
+  for (const auto &handler : *handlers) {
+    all_handlers[handler->type()] = handler.get();
   }
-  ValueDeleter d(&all_handlers);
 
   // Get resources used in the spec.
   set<GeneralResourceHandler *> used_handlers;
@@ -677,12 +1219,15 @@ Status ContainerImpl::Update(const ContainerSpec &spec, UpdatePolicy policy) {
         "A replace update must specify all resources being isolated.");
   }
 
-  // Apply the update to all specified handlers.
+  // Apply the update to all specified handlers. Their writes are batched so
+  // that a failed update leaves the container as it was.
+  CgroupWriteBatch batch(kernel_);
   for (GeneralResourceHandler *handler : used_handlers) {
-    RETURN_IF_ERROR(handler->Update(spec, policy));
+    RETURN_IF_ERROR(
+        InvalidateHandlerCacheOnError(handler->Update(spec, policy)));
   }
 
-  return Status::OK;
+  return InvalidateHandlerCacheOnError(batch.Commit());
 }
 
 Status ContainerImpl::Destroy() {
@@ -691,6 +1236,9 @@ Status ContainerImpl::Destroy() {
   // Ensure the container is empty (no tasks).
   RETURN_IF_ERROR(KillAll());
 
+  // The cached handlers are of no use once the container is gone.
+  InvalidateHandlerCache();
+
   // Get and destroy all resources.
   vector<GeneralResourceHandler *> handlers =
       RETURN_IF_ERROR(GetGeneralResourceHandlers());
@@ -769,7 +1317,8 @@ StatusOr<pid_t> ContainerImpl::Run(const vector<string> &command,
 
 
   // Create a thread, enter the thread into this container, and run the
-  // command. This is so that all accounting is properly done without having
+  // command (or clone the command into the container's cgroup in the unified
+  // hierarchy). This is so that all accounting is properly done without having
   // to move the user's thread into this container or doing some work between
   // fork and exec.
   vector<ResourceHandler *> handlers = RETURN_IF_ERROR(GetResourceHandlers());
@@ -779,10 +1328,12 @@ StatusOr<pid_t> ContainerImpl::Run(const vector<string> &command,
                            &ContainerImpl::RunInNamespace,
                            &command,
                            &spec));
-  return EnterThreadAndDo(handlers,
-                          tasks_handler_.get(),
-                          freezer_controller_.get(),
-                          action.get());
+  return DoInContainer(lmctfy_,
+                       kernel_,
+                       handlers,
+                       tasks_handler_.get(),
+                       freezer_controller_.get(),
+                       action.get());
 }
 
 StatusOr<ContainerSpec> ContainerImpl::Spec() const {
@@ -790,16 +1341,15 @@ StatusOr<ContainerSpec> ContainerImpl::Spec() const {
 
   // TODO(vmarmol): Fill in the non-resource-specific parts of the spec.
 
-  // Generate resource handlers.
-  vector<GeneralResourceHandler *> handlers =
-      RETURN_IF_ERROR(GetGeneralResourceHandlers());
-  ElementDeleter d(&handlers);
+  // Get resource handlers.
+  shared_ptr<const CachedHandlers> handlers =
+      RETURN_IF_ERROR(GetCachedGeneralResourceHandlers());
 
   // Get the spec from each ResourceHandler attached to this container..
   ContainerSpec spec;
-  for (GeneralResourceHandler *handler : handlers) {
+  for (const auto &handler : *handlers) {
     if (name_ == handler->container_name()) {
-      RETURN_IF_ERROR(handler->Spec(&spec));
+      RETURN_IF_ERROR(InvalidateHandlerCacheOnError(handler->Spec(&spec)));
     }
   }
 
@@ -855,6 +1405,10 @@ StatusOr<vector<Container *>> ContainerImpl::ListSubcontainers(
     STLDeleteElements(&subcontainers);
   });
   for (const string &subcontainer_name : subcontainer_names) {
+    // Warm containers are not visible until they are claimed.
+    if (WarmPool::IsWarmName(subcontainer_name)) {
+      continue;
+    }
     subcontainers.emplace_back(
         RETURN_IF_ERROR(lmctfy_->Get(subcontainer_name)));
   }
@@ -900,15 +1454,15 @@ StatusOr<ContainerStats> ContainerImpl::Stats(StatsType stats_type) const {
   ContainerStats stats;
 
   // Get all resource handlers.
-  vector<GeneralResourceHandler *> handlers =
-      RETURN_IF_ERROR(GetGeneralResourceHandlers());
-  ElementDeleter d(&handlers);
+  shared_ptr<const CachedHandlers> handlers =
+      RETURN_IF_ERROR(GetCachedGeneralResourceHandlers());
 
   // Get stats from each resource.
-  for (GeneralResourceHandler *handler : handlers) {
+  for (const auto &handler : *handlers) {
     // Only get stats for the resources attached to this container.
     if (name_ == handler->container_name()) {
-      RETURN_IF_ERROR(handler->Stats(stats_type, &stats));
+      RETURN_IF_ERROR(
+          InvalidateHandlerCacheOnError(handler->Stats(stats_type, &stats)));
     }
   }
 
@@ -932,14 +1486,20 @@ StatusOr<Container::NotificationId> ContainerImpl::RegisterNotification(
 
   RETURN_IF_ERROR(Exists());
 
+  // The TasksHandler is the one that knows whether the container has tasks.
+  if (spec.has_container_empty()) {
+    return tasks_handler_->RegisterEmptyNotification(
+        NewPermanentCallback(this, &ContainerImpl::HandleNotification,
+                             user_callback));
+  }
+
   // Get all resource handlers.
-  vector<GeneralResourceHandler *> handlers =
-      RETURN_IF_ERROR(GetGeneralResourceHandlers());
-  ElementDeleter d(&handlers);
+  shared_ptr<const CachedHandlers> handlers =
+      RETURN_IF_ERROR(GetCachedGeneralResourceHandlers());
 
   // Register notification (only one notification is specified per request).
   StatusOr<Container::NotificationId> statusor;
-  for (GeneralResourceHandler *handler : handlers) {
+  for (const auto &handler : *handlers) {
     statusor = handler->RegisterNotification(
         spec, NewPermanentCallback(this, &ContainerImpl::HandleNotification,
                                    user_callback));
@@ -949,6 +1509,7 @@ StatusOr<Container::NotificationId> ContainerImpl::RegisterNotification(
     // OK result is taken. An error code of NOT_FOUND means the ResourceHandler
     // does not handle the specified event.
     if (statusor.status().error_code() != ::util::error::NOT_FOUND) {
+      InvalidateHandlerCacheOnError(statusor.status()).IgnoreError();
       return statusor;
     }
   }
@@ -972,10 +1533,22 @@ Status ContainerImpl::UnregisterNotification(NotificationId notification_id) {
   return Status::OK;
 }
 
-// TODO(vmarmol): Use Pause()/Resume() when that is available.
 Status ContainerImpl::KillAll() {
   RETURN_IF_ERROR(Exists());
 
+  // Freeze the container while the existing processes are being signalled, so
+  // that they stop forking sooner. The signals are delivered once the
+  // container is thawed. The freeze may still be in progress when the
+  // processes are listed. Freezing is an optimization, if the freezer is not
+  // available the processes are killed while running. The caller is not
+  // frozen: nothing would thaw it.
+  if (!CallerInFreezerCgroup() && freezer_controller_->Freeze().ok()) {
+    Status status = VisitProcessesOrThreads(
+        LIST_PROCESSES, [this](pid_t pid) { kernel_->Kill(pid); });
+    RETURN_IF_ERROR(freezer_controller_->Unfreeze());
+    RETURN_IF_ERROR(status);
+  }
+
   // Send a SIGKILL to all processes.
   RETURN_IF_ERROR(KillTasks(LIST_PROCESSES));
 
@@ -986,6 +1559,18 @@ Status ContainerImpl::KillAll() {
   return Status::OK;
 }
 
+bool ContainerImpl::CallerInFreezerCgroup() const {
+  StatusOr<string> statusor = lmctfy_->DetectFreezerCgroup(0);
+  if (!statusor.ok()) {
+    // Not in a freezer cgroup we know of, or no freezer at all.
+    return false;
+  }
+  const string &caller_cgroup = statusor.ValueOrDie();
+  const string &cgroup = freezer_controller_->hierarchy_path();
+  return cgroup == "/" || caller_cgroup == cgroup ||
+         caller_cgroup.compare(0, cgroup.size() + 1, cgroup + "/") == 0;
+}
+
 StatusOr<pid_t> ContainerImpl::GetInitPid() const {
   unique_ptr<NamespaceHandler> namespace_handler(
       RETURN_IF_ERROR(GetNamespaceHandler(name_)));
@@ -1012,51 +1597,105 @@ StatusOr<vector<ResourceHandler *>> ContainerImpl::GetResourceHandlers() const {
   return GetResourceHandlersFor(name_, resource_factories_);
 }
 
-StatusOr<vector<pid_t>> ContainerImpl::ListProcessesOrThreads(
-    ListType type) const {
+StatusOr<shared_ptr<const ContainerImpl::CachedHandlers>>
+ContainerImpl::GetCachedGeneralResourceHandlers() const {
+  if (FLAGS_lmctfy_cache_resource_handlers) {
+    MutexLock l(&handler_cache_lock_);
+    if (handler_cache_ != nullptr) {
+      return handler_cache_;
+    }
+  }
+
+  // Build the handlers without holding the lock, this touches the filesystem.
+  vector<GeneralResourceHandler *> handlers =
+      RETURN_IF_ERROR(GetGeneralResourceHandlers());
+  shared_ptr<CachedHandlers> built(new CachedHandlers());
+  for (GeneralResourceHandler *handler : handlers) {
+    built->emplace_back(handler);
+  }
+
+  if (!FLAGS_lmctfy_cache_resource_handlers) {
+    return shared_ptr<const CachedHandlers>(built);
+  }
+
+  // Another thread may have built them too, keep only one copy.
+  MutexLock l(&handler_cache_lock_);
+  if (handler_cache_ == nullptr) {
+    handler_cache_ = built;
+  }
+  return handler_cache_;
+}
+
+void ContainerImpl::InvalidateHandlerCache() const {
+  MutexLock l(&handler_cache_lock_);
+  handler_cache_.reset();
+}
+
+Status ContainerImpl::InvalidateHandlerCacheOnError(Status status) const {
+  if (!status.ok()) {
+    InvalidateHandlerCache();
+  }
+  return status;
+}
+
+Status ContainerImpl::VisitProcessesOrThreads(
+    ListType type, const TasksHandler::PidVisitor &visitor) const {
   if (type == LIST_PROCESSES) {
-    return tasks_handler_->ListProcesses(TasksHandler::ListType::SELF);
+    return tasks_handler_->VisitProcesses(visitor);
   }
 
-  return tasks_handler_->ListThreads(TasksHandler::ListType::SELF);
+  return tasks_handler_->VisitThreads(visitor);
 }
 
 Status ContainerImpl::KillTasks(ListType type) const {
-  StatusOr<vector<pid_t>> statusor;
-
-  // Send signal until there are no more PIDs/TIDs or until num_tries times.
-  int32 num_tries = FLAGS_lmctfy_num_tries_for_unkillable;
-  while (num_tries > 0) {
-    statusor = ListProcessesOrThreads(type);
-    if (!statusor.ok()) {
-      return statusor.status();
-    }
+  // Kill the PIDs/TIDs as they are read instead of listing them all first,
+  // containers may have a very large number of threads.
+  int64 num_killed = 0;
+  const TasksHandler::PidVisitor kill = [this, &num_killed](pid_t pid) {
+    kernel_->Kill(pid);
+    ++num_killed;
+  };
+
+  // Send signal until there are no more PIDs/TIDs or until we have waited
+  // num_tries times the maximum delay. Most tasks die within microseconds of
+  // the signal so start with a short delay and back off exponentially.
+  const int64 max_delay_us =
+      static_cast<int64>(FLAGS_lmctfy_ms_delay_between_kills) * 1000;
+  int64 remaining_us =
+      max_delay_us * max(FLAGS_lmctfy_num_tries_for_unkillable, 1);
+  int64 delay_us = min(
+      static_cast<int64>(max(FLAGS_lmctfy_us_initial_delay_between_kills, 1)),
+      max_delay_us);
+  while (true) {
+    num_killed = 0;
+    RETURN_IF_ERROR(VisitProcessesOrThreads(type, kill));
 
     // If no PIDs/TIDs, we are done.
-    if (statusor.ValueOrDie().empty()) {
+    if (num_killed == 0) {
       return Status::OK;
     }
 
-    for (pid_t pid : statusor.ValueOrDie()) {
-      kernel_->Kill(pid);
+    if (remaining_us <= 0) {
+      break;
     }
-
-    --num_tries;
-    kernel_->Usleep(FLAGS_lmctfy_ms_delay_between_kills * 1000);
+    delay_us = min(delay_us, remaining_us);
+    kernel_->Usleep(delay_us);
+    remaining_us -= delay_us;
+    delay_us = min(delay_us * 2, max_delay_us);
   }
 
   // Ensure that no PIDs/TIDs remain.
-  statusor = ListProcessesOrThreads(type);
-  if (!statusor.ok()) {
-    return statusor.status();
-  } else if (!statusor.ValueOrDie().empty()) {
+  int64 num_remaining = 0;
+  RETURN_IF_ERROR(VisitProcessesOrThreads(
+      type, [&num_remaining](pid_t pid) { ++num_remaining; }));
+  if (num_remaining != 0) {
     return Status(
         ::util::error::FAILED_PRECONDITION,
         Substitute(
             "Expected container \"$0\" to have no $1, has $2. Some may "
             "be unkillable",
             name_, type == LIST_PROCESSES ? "processes" : "threads",
-            statusor.ValueOrDie().size()));
+            num_remaining));
   }
 
   return Status::OK;
@@ -25,10 +25,13 @@ using ::std::string;
 
 #include "base/callback.h"
 #include "base/macros.h"
+#include "base/mutex.h"
 #include "base/thread_annotations.h"
 #include "system_api/kernel_api.h"
 #include "lmctfy/namespace_handler.h"
 #include "lmctfy/resource_handler.h"
+#include "lmctfy/stats_sampler.h"
+#include "lmctfy/warm_pool.h"
 #include "include/lmctfy.h"
 #include "strings/stringpiece.h"
 #include "util/task/statusor.h"
@@ -60,7 +63,7 @@ typedef ::std::map<ResourceType, ResourceHandlerFactory *> ResourceFactoryMap;
 // InitMachine()). InitMachine() must be called after machine boot before any
 // containers are created. Doing otherwise will likely fail as the resources are
 // not initialized.
-class ContainerApiImpl : public ContainerApi {
+class ContainerApiImpl : public ContainerApi, private WarmPool::Backend {
  public:
   // Exposed for use in testing.
   static ::util::StatusOr<ContainerApiImpl *> NewContainerApiImpl(
@@ -92,6 +95,12 @@ class ContainerApiImpl : public ContainerApi {
       StringPiece container_name, const ContainerSpec &spec) const override;
   ::util::Status Destroy(Container *container) const override;
   ::util::StatusOr<string> Detect(pid_t tid) const override;
+  using ContainerApi::StatsMany;
+  ::util::StatusOr< ::std::map<string, ContainerStats>> StatsMany(
+      const ::std::vector<string> &container_names, Container::StatsType type,
+      ::std::map<string, ::util::Status> *errors) const override;
+  ::util::StatusOr<ContainerStatsRates> StatsRates(
+      StringPiece container_name) const override;
 
   // Initialize lmctfy on this machine. This should only be called once at
   // machine boot and MUST be done before any container is returned. At this
@@ -107,16 +116,74 @@ class ContainerApiImpl : public ContainerApi {
   // Determines whether the specified container exists. Name must be resolved.
   virtual bool Exists(const string &container_name) const;
 
+  // Gets the path of the freezer cgroup the specified TID is in, relative to
+  // the freezer hierarchy (e.g.: /test).
+  virtual ::util::StatusOr<string> DetectFreezerCgroup(pid_t tid) const;
+
+  // Gets the full path of the cgroup that the processes started in a container
+  // are cloned into. That is the container's cgroup when all of its handlers
+  // are in the cgroup v2 unified hierarchy. Returns an empty path when the
+  // processes have to be started from a thread entered into the handlers
+  // instead (e.g.: in cgroup v1 hierarchies). All arguments are borrowed.
+  ::util::StatusOr<string> GetCloneCgroupPath(
+      const ::std::vector<ResourceHandler *> &resource_handlers,
+      const TasksHandler &tasks_handler,
+      const FreezerController &freezer_controller) const;
+
  private:
   // Resolves the container name to its absolute canonical form. For details
   // about this form look at the public lmctfy.proto.
   ::util::StatusOr<string> ResolveContainerName(
       StringPiece container_name) const;
 
+  // Gets the specified existing container. Name must be resolved.
+  ::util::StatusOr<Container *> GetResolved(const string &resolved_name) const;
+
+  // Creates the specified container from scratch. Name must be resolved.
+  ::util::StatusOr<Container *> CreateResolved(const string &resolved_name,
+                                               const ContainerSpec &spec) const;
+
+  // Applies the spec to a container that was just claimed from the warm pool.
+  // The container is destroyed if this fails. Name must be resolved.
+  ::util::StatusOr<Container *> SetUpClaimedContainer(
+      const string &resolved_name, const ContainerSpec &spec) const;
+
+  // WarmPool::Backend implementation, documented in //lmctfy/warm_pool.h
+  ::util::Status CreateWarm(const string &warm_name,
+                            const ContainerSpec &spec) const override;
+  ::util::Status RenameWarm(const string &warm_name,
+                            const string &new_name) const override;
+  ::util::Status DestroyWarm(const string &warm_name) const override;
+  ::util::StatusOr<::std::vector<string>> ListWarm(
+      const string &container_name) const override;
+
+  // Gets the stats of the specified container into output. Only the handlers
+  // attached to this container are used, handlers inherited from a parent are
+  // skipped (as in ContainerImpl::Stats()). Name must be resolved.
+  ::util::Status StatsFor(const string &container_name,
+                          Container::StatsType type,
+                          ContainerStats *output) const;
+
   // Destroys the specified container and deletes it iff the destruction
   // succeeded. Returns OK in this case.
   ::util::Status DestroyDeleteContainer(Container *container) const;
 
+  // Destroys and deletes the specified subcontainers of a container on up to
+  // FLAGS_lmctfy_destroy_threads threads. Sibling subtrees are destroyed
+  // concurrently, a subcontainer is only destroyed after all of its children.
+  // On failure, no more subcontainers are destroyed. All subcontainers are
+  // deleted regardless of the outcome. The state that sibling destructions
+  // share (e.g.: the kernel features, the cgroup file cache and tree index,
+  // the notifications) is thread-safe.
+  //
+  // Arguments:
+  //   subcontainers: All the recursive subcontainers of a container. Takes
+  //       ownership of the pointers.
+  // Return:
+  //   Status: OK iff all subcontainers were destroyed.
+  ::util::Status DestroySubcontainersInParallel(
+      const ::std::vector<Container *> &subcontainers) const;
+
   // Factory for TasksHandler in use.
   ::std::unique_ptr<TasksHandlerFactory> tasks_handler_factory_;
 
@@ -139,6 +206,16 @@ class ContainerApiImpl : public ContainerApi {
 
   ::std::unique_ptr<FreezerControllerFactory> freezer_controller_factory_;
 
+  // Samples the stats of the containers whose rates are requested. Created on
+  // the first StatsRates() call.
+  mutable ::std::unique_ptr<StatsSampler> stats_sampler_
+      GUARDED_BY(stats_sampler_lock_);
+  mutable Mutex stats_sampler_lock_;
+
+  // Containers created ahead of time for Create() to claim. nullptr if
+  // disabled.
+  ::std::unique_ptr<WarmPool> warm_pool_;
+
   friend class ContainerApiImplTest;
 
   DISALLOW_COPY_AND_ASSIGN(ContainerApiImpl);
@@ -214,20 +291,49 @@ class ContainerImpl : public Container {
   ::util::StatusOr< ::std::vector<GeneralResourceHandler *>>
   GetGeneralResourceHandlers() const;
 
-  // Lists processes or threads as specified in the list type. Lists
-  // non-recursively by default.
+  // The GeneralResourceHandlers of a container, owned.
+  typedef ::std::vector< ::std::unique_ptr<GeneralResourceHandler>>
+      CachedHandlers;
+
+  // Gets the GeneralResourceHandlers of the container from the handler cache,
+  // building them if they are not cached. The handlers remain valid for as
+  // long as the returned pointer is held, even if the cache is invalidated.
+  // Caching can be disabled with FLAGS_lmctfy_cache_resource_handlers.
+  //
+  // Return:
+  //   StatusOr: The status of the action. Iff OK, the handlers.
+  ::util::StatusOr< ::std::shared_ptr<const CachedHandlers>>
+  GetCachedGeneralResourceHandlers() const LOCKS_EXCLUDED(handler_cache_lock_);
+
+  // Drops the cached handlers, the next GetCachedGeneralResourceHandlers()
+  // builds them again.
+  void InvalidateHandlerCache() const LOCKS_EXCLUDED(handler_cache_lock_);
+
+  // Returns status, invalidating the handler cache if it is not OK. An error
+  // from a cached handler may mean the container changed under us (e.g.: it was
+  // destroyed and re-created).
+  ::util::Status InvalidateHandlerCacheOnError(::util::Status status) const;
+
+  // Calls visitor with each of the processes or threads, as specified in the
+  // list type, of this container. Subcontainers are not visited.
   //
   // Arguments:
-  //   type: The type of resource to list, either processes or threads.
+  //   type: The type of resource to visit, either processes or threads.
+  //   visitor: Called with each PID/TID.
   // Return:
-  //   StatusOr<vector<pid_t>>: The status of the action. Iff OK, vector is
-  //       populated with the PIDs/TIDs that were requested.
-  ::util::StatusOr< ::std::vector<pid_t>> ListProcessesOrThreads(
-      ListType type) const;
+  //   Status: The status of the action. Iff OK, all PIDs/TIDs were visited.
+  ::util::Status VisitProcessesOrThreads(
+      ListType type, const TasksHandler::PidVisitor &visitor) const;
+
+  // Whether the calling process is in the freezer cgroup of this container or
+  // of one of its subcontainers, and would be frozen with it.
+  bool CallerInFreezerCgroup() const;
 
   // Send a SIGKILL signal to the PIDs/TIDs in the container until the container
-  // is empty or FLAGS_lmctfy_num_tries_for_unkillable attempts have been
-  // made.
+  // is empty or we run out of time. The delay between attempts starts at
+  // FLAGS_lmctfy_us_initial_delay_between_kills and doubles up to
+  // FLAGS_lmctfy_ms_delay_between_kills. In total we wait for at most
+  // FLAGS_lmctfy_num_tries_for_unkillable times the maximum delay.
   //
   // Arguments:
   //   type: Whether to send the signal to the PIDs or TIDs in the container.
@@ -267,6 +373,11 @@ class ContainerImpl : public Container {
 
   ::std::unique_ptr<FreezerController> freezer_controller_;
 
+  // Lazily built handlers of this container. nullptr if not built.
+  mutable ::std::shared_ptr<const CachedHandlers> handler_cache_
+      GUARDED_BY(handler_cache_lock_);
+  mutable Mutex handler_cache_lock_;
+
   friend class ContainerImplTest;
 
   DISALLOW_COPY_AND_ASSIGN(ContainerImpl);
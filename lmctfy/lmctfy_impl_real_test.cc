@@ -0,0 +1,162 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/lmctfy_impl.h"
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "base/timer.h"
+#include "include/lmctfy.h"
+#include "include/lmctfy.pb.h"
+#include "util/errors_test_util.h"
+#include "strings/substitute.h"
+#include "gtest/gtest.h"
+
+DECLARE_int32(lmctfy_warm_pool_size);
+
+using ::std::sort;
+using ::std::string;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+
+namespace containers {
+namespace lmctfy {
+
+// Number of containers created in each run of the benchmark.
+static const int kBenchmarkCreates = 200;
+
+// Time given to the warm pool to refill between creates.
+static const int kBenchmarkRefillUsec = 5000;
+
+// Number of commands run in each run of the Run() benchmark.
+static const int kBenchmarkRuns = 1000;
+
+// Prints the 50th and 99th percentiles of the specified latencies.
+static void PrintPercentiles(const string &what,
+                             vector<int64> *latencies_usec) {
+  sort(latencies_usec->begin(), latencies_usec->end());
+  printf("%s: p50 %lld us, p99 %lld us\n", what.c_str(),
+         static_cast<long long>(  // NOLINT(runtime/int)
+             (*latencies_usec)[latencies_usec->size() / 2]),
+         static_cast<long long>(  // NOLINT(runtime/int)
+             (*latencies_usec)[latencies_usec->size() * 99 / 100]));
+}
+
+class ContainerApiImplRealTest : public ::testing::Test {
+ public:
+  // Creates and destroys kBenchmarkCreates containers, one at a time, and
+  // prints the 50th and 99th percentiles of the Create() latency. The warm
+  // pool is used if warm_pool_size is not 0. Virtual hosts start their init
+  // in the container, on a thread entered into its cgroups or cloned into its
+  // cgroup if it is in the cgroup v2 unified hierarchy.
+  void BenchmarkCreate(int warm_pool_size, bool virtual_host) {
+    ::google::FlagSaver flag_saver;
+    FLAGS_lmctfy_warm_pool_size = warm_pool_size;
+    unique_ptr<ContainerApi> lmctfy(ContainerApi::New().ValueOrDie());
+
+    ContainerSpec spec;
+    spec.mutable_cpu()->set_limit(1000);
+    spec.mutable_memory()->set_limit(100 << 20);
+    if (virtual_host) {
+      spec.mutable_virtual_host();
+    }
+
+    vector<int64> latencies_usec;
+    CycleTimer timer;
+    for (int i = 0; i < kBenchmarkCreates; ++i) {
+      // Let the pool refill as it would between the creates of a real user.
+      usleep(kBenchmarkRefillUsec);
+
+      timer.Reset();
+      timer.Start();
+      unique_ptr<Container> container(
+          lmctfy->Create(Substitute("/lmctfy_real_test_$0_$1", getpid(), i),
+                         spec).ValueOrDie());
+      timer.Stop();
+      latencies_usec.push_back(timer.GetInUsec());
+
+      ASSERT_OK(lmctfy->Destroy(container.release()));
+    }
+
+    PrintPercentiles(Substitute("Create$0 with warm pool size $1",
+                                virtual_host ? " virtual host" : "",
+                                warm_pool_size),
+                     &latencies_usec);
+  }
+
+  // Creates a container and runs kBenchmarkRuns commands in it, one at a
+  // time, then prints the 50th and 99th percentiles of the Run() latency. The
+  // commands are started from a thread entered into the container's cgroups,
+  // or cloned into its cgroup if it is in the cgroup v2 unified hierarchy.
+  void BenchmarkRun() {
+    unique_ptr<ContainerApi> lmctfy(ContainerApi::New().ValueOrDie());
+
+    ContainerSpec spec;
+    spec.mutable_cpu()->set_limit(1000);
+    spec.mutable_memory()->set_limit(100 << 20);
+    unique_ptr<Container> container(
+        lmctfy->Create(Substitute("/lmctfy_real_test_$0", getpid()), spec)
+            .ValueOrDie());
+
+    vector<int64> latencies_usec;
+    CycleTimer timer;
+    for (int i = 0; i < kBenchmarkRuns; ++i) {
+      timer.Reset();
+      timer.Start();
+      const pid_t pid = container->Run({"/bin/true"}, RunSpec()).ValueOrDie();
+      timer.Stop();
+      latencies_usec.push_back(timer.GetInUsec());
+
+      ASSERT_EQ(pid, waitpid(pid, nullptr, 0));
+    }
+
+    ASSERT_OK(lmctfy->Destroy(container.release()));
+    PrintPercentiles("Run", &latencies_usec);
+  }
+};
+
+// Compares the latency of Create() with and without a warm pool. Needs root
+// and a machine set up with InitMachine().
+TEST_F(ContainerApiImplRealTest, DISABLED_BenchmarkCreate) {
+  BenchmarkCreate(0, false);
+  BenchmarkCreate(4, false);
+}
+
+// Compares the latency of Create() without and with a virtual host, the
+// difference is the cost of starting its init in the container. A machine only
+// takes one path: compare the results of a cgroup v1 machine (entered scratch
+// thread) and of a cgroup v2 machine (clone into the cgroup). Needs root and a
+// machine set up with InitMachine().
+TEST_F(ContainerApiImplRealTest, DISABLED_BenchmarkCreateVirtualHost) {
+  BenchmarkCreate(0, false);
+  BenchmarkCreate(0, true);
+}
+
+// Measures the latency of Run(). Compare the results of a cgroup v1 machine
+// (entered scratch thread) and of a cgroup v2 machine (clone into the cgroup).
+// Needs root and a machine set up with InitMachine().
+TEST_F(ContainerApiImplRealTest, DISABLED_BenchmarkRun) {
+  BenchmarkRun();
+}
+
+}  // namespace lmctfy
+}  // namespace containers
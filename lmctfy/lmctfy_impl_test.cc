@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <set>
 #include <utility>
 
 #include "base/callback.h"
@@ -32,6 +33,7 @@
 #include "lmctfy/namespace_handler_mock.h"
 #include "lmctfy/resource_handler_mock.h"
 #include "lmctfy/tasks_handler_mock.h"
+#include "lmctfy/warm_pool.h"
 #include "include/lmctfy.pb.h"
 #include "include/lmctfy_mock.h"
 #include "util/safe_types/unix_gid.h"
@@ -51,7 +53,12 @@ class TasksHandler;
 }  // namespace lmctfy
 }  // namespace containers
 
+DECLARE_bool(lmctfy_cache_resource_handlers);
+DECLARE_int32(lmctfy_destroy_threads);
 DECLARE_int32(lmctfy_ms_delay_between_kills);
+DECLARE_int32(lmctfy_num_tries_for_unkillable);
+DECLARE_int32(lmctfy_us_initial_delay_between_kills);
+DECLARE_int32(lmctfy_stats_sample_interval_ms);
 
 using ::system_api::MockKernelApiOverride;
 using ::file::JoinPath;
@@ -63,6 +70,8 @@ using ::util::UnixUid;
 using ::util::UnixUidValue;
 using ::std::make_pair;
 using ::std::map;
+using ::std::pair;
+using ::std::set;
 using ::std::sort;
 using ::std::unique_ptr;
 using ::std::unique_ptr;
@@ -119,6 +128,7 @@ class MockContainerApiImpl : public ContainerApiImpl {
   MOCK_CONST_METHOD1(Destroy, Status(Container *container));
   MOCK_CONST_METHOD1(Exists, bool(const string &container_name));
   MOCK_CONST_METHOD1(Detect, StatusOr<string>(pid_t pid));
+  MOCK_CONST_METHOD1(DetectFreezerCgroup, StatusOr<string>(pid_t tid));
   MOCK_CONST_METHOD1(InitMachine, Status(const InitSpec &spec));
 };
 
@@ -192,6 +202,79 @@ class ContainerApiImplTest : public ::testing::Test {
     return lmctfy_->ResolveContainerName(container_name);
   }
 
+  // Makes Create() claim containers from a warm pool that is refilled manually.
+  WarmPool *EnableWarmPool() {
+    lmctfy_->warm_pool_.reset(new WarmPool(lmctfy_.get(), 1, 1));
+    return lmctfy_->warm_pool_.get();
+  }
+
+  Status CallRenameWarm(const string &warm_name, const string &new_name) {
+    return lmctfy_->RenameWarm(warm_name, new_name);
+  }
+
+  // Expects the handlers of the warm container to be fetched. Each adds the
+  // specified cgroup virtual root to the machine spec, resource handlers of
+  // resources without one add none.
+  void ExpectWarmVirtualRoots(
+      const string &warm_name,
+      const map<ResourceType, pair<CgroupHierarchy, string>> &resource_roots,
+      const pair<CgroupHierarchy, string> &freezer_root,
+      const pair<CgroupHierarchy, string> &tasks_root) {
+    for (ResourceHandlerFactory *factory : resource_factories_) {
+      StrictMockResourceHandler *handler =
+          new StrictMockResourceHandler(warm_name, factory->type());
+      auto it = resource_roots.find(factory->type());
+      if (it == resource_roots.end()) {
+        EXPECT_CALL(*handler, PopulateMachineSpec(NotNull()))
+            .WillOnce(Return(Status::OK));
+      } else {
+        EXPECT_CALL(*handler, PopulateMachineSpec(NotNull()))
+            .WillOnce(AddVirtualRoot(it->second));
+      }
+      EXPECT_CALL(*reinterpret_cast<MockResourceHandlerFactory *>(factory),
+                  Get(warm_name))
+          .WillOnce(Return(StatusOr<ResourceHandler *>(handler)));
+    }
+
+    StrictMockFreezerController *freezer_controller =
+        new StrictMockFreezerController();
+    EXPECT_CALL(*freezer_controller, PopulateMachineSpec(NotNull()))
+        .WillOnce(AddVirtualRoot(freezer_root));
+    EXPECT_CALL(*mock_freezer_controller_factory_, Get(warm_name))
+        .WillOnce(Return(freezer_controller));
+
+    StrictMockTasksHandler *tasks_handler =
+        new StrictMockTasksHandler(warm_name);
+    EXPECT_CALL(*tasks_handler, PopulateMachineSpec(NotNull()))
+        .WillOnce(AddVirtualRoot(tasks_root));
+    EXPECT_CALL(*mock_tasks_handler_factory_, Get(warm_name))
+        .WillOnce(Return(StatusOr<TasksHandler *>(tasks_handler)));
+  }
+
+  static ::testing::Action<Status(MachineSpec *)> AddVirtualRoot(
+      const pair<CgroupHierarchy, string> &root) {
+    return Invoke([root](MachineSpec *spec) {
+      auto *virtual_root =
+          spec->mutable_virtual_root()->add_cgroup_virtual_root();
+      virtual_root->set_hierarchy(root.first);
+      virtual_root->set_root(root.second);
+      return Status::OK;
+    });
+  }
+
+  // Expects the container to be listed and to have the specified
+  // subcontainers.
+  void ExpectListSubcontainers(const string &container_name,
+                               const vector<string> &subcontainer_names) {
+    StrictMockTasksHandler *tasks_handler =
+        new StrictMockTasksHandler(container_name);
+    EXPECT_CALL(*tasks_handler,
+                ListSubcontainers(TasksHandler::ListType::RECURSIVE))
+        .WillOnce(Return(subcontainer_names));
+    EXPECT_CALL(*mock_tasks_handler_factory_, Get(container_name))
+        .WillOnce(Return(StatusOr<TasksHandler *>(tasks_handler)));
+  }
+
  protected:
   unique_ptr<ContainerApiImpl> lmctfy_;
   MockTasksHandlerFactory *mock_tasks_handler_factory_;
@@ -728,6 +811,120 @@ TEST_F(ContainerApiImplTest, CreateNoResourcesSpecified) {
   delete status.ValueOrDie();
 }
 
+TEST_F(ContainerApiImplTest, CreateWithEmptyWarmPool) {
+  const string kName = "/test";
+  WarmPool *warm_pool = EnableWarmPool();
+
+  ContainerSpec spec;
+  spec.mutable_cpu();
+
+  EXPECT_CALL(*mock_freezer_controller_factory_, Create(kName))
+      .WillRepeatedly(Return(new StrictMockFreezerController()));
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists(kName))
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*mock_handler_factory1_, Create(kName, _))
+      .WillRepeatedly(Return(StatusOr<ResourceHandler *>(
+          new StrictMockResourceHandler(kName, RESOURCE_CPU))));
+  EXPECT_CALL(*mock_tasks_handler_factory_,
+              Create(kName, EqualsInitializedProto(spec)))
+      .WillRepeatedly(
+           Return(StatusOr<TasksHandler *>(new StrictMockTasksHandler(kName))));
+
+  // There is nothing to claim so the container is created from scratch.
+  StatusOr<Container *> status = lmctfy_->Create(kName, spec);
+  ASSERT_OK(status);
+  delete status.ValueOrDie();
+  EXPECT_EQ(0, warm_pool->Size());
+}
+
+TEST_F(ContainerApiImplTest, CreateFailsWithWarmPool) {
+  const string kName = "/test";
+  EnableWarmPool();
+
+  ContainerSpec spec;
+  spec.set_children_limit(1);
+
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists(kName))
+      .WillRepeatedly(Return(false));
+
+  // There are no warm containers next to it to evict, so it is not retried.
+  EXPECT_CALL(*mock_freezer_controller_factory_, Create(kName))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED, lmctfy_->Create(kName, spec));
+}
+
+TEST_F(ContainerApiImplTest, RenameWarm) {
+  const string kWarmName = "/_warm.1.0";
+
+  // Batch containers are under the batch subsystem in the cpu hierarchy. The
+  // tasks handler shares the freezer cgroup. The device handler is that of the
+  // parent.
+  ExpectWarmVirtualRoots(
+      kWarmName,
+      {{RESOURCE_CPU, {CGROUP_CPU, "/batch/_warm.1.0"}},
+       {RESOURCE_MEMORY, {CGROUP_MEMORY, kWarmName}},
+       {RESOURCE_FILESYSTEM, {CGROUP_CPUACCT, "/batch/_warm.1.0"}},
+       {RESOURCE_DEVICE, {CGROUP_DEVICE, "/"}}},
+      {CGROUP_FREEZER, kWarmName}, {CGROUP_FREEZER, kWarmName});
+
+  EXPECT_CALL(*mock_cgroup_factory_, OwnsCgroup(_))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_cgroup_factory_, OwnsCgroup(CGROUP_CPUACCT))
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*mock_cgroup_factory_, Get(CGROUP_CPU, "/batch/_warm.1.0"))
+      .WillOnce(Return(string("/dev/cgroup/cpu/batch/_warm.1.0")));
+  EXPECT_CALL(*mock_cgroup_factory_, Get(CGROUP_MEMORY, kWarmName))
+      .WillOnce(Return(string("/dev/cgroup/memory/_warm.1.0")));
+  EXPECT_CALL(*mock_cgroup_factory_, Get(CGROUP_FREEZER, kWarmName))
+      .WillOnce(Return(string("/dev/cgroup/freezer/_warm.1.0")))
+      .WillOnce(Return(StatusOr<string>(Status(NOT_FOUND, ""))));
+  EXPECT_CALL(*mock_cgroup_factory_,
+              Rename(CGROUP_CPU, "/batch/_warm.1.0", "/batch/test"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_cgroup_factory_, Rename(CGROUP_MEMORY, kWarmName, "/test"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_cgroup_factory_,
+              Rename(CGROUP_FREEZER, kWarmName, "/test"))
+      .WillOnce(Return(Status::OK));
+
+  EXPECT_OK(CallRenameWarm(kWarmName, "/test"));
+}
+
+TEST_F(ContainerApiImplTest, RenameWarmGetHandlersFails) {
+  const string kWarmName = "/_warm.1.0";
+
+  EXPECT_CALL(*mock_handler_factory1_, Get(kWarmName))
+      .WillOnce(Return(StatusOr<ResourceHandler *>(Status(INTERNAL, ""))));
+
+  EXPECT_ERROR_CODE(INTERNAL, CallRenameWarm(kWarmName, "/test"));
+}
+
+TEST_F(ContainerApiImplTest, RenameWarmFailureIsUndone) {
+  const string kWarmName = "/_warm.1.0";
+
+  ExpectWarmVirtualRoots(kWarmName,
+                         {{RESOURCE_CPU, {CGROUP_CPU, kWarmName}},
+                          {RESOURCE_MEMORY, {CGROUP_MEMORY, kWarmName}}},
+                         {CGROUP_FREEZER, kWarmName},
+                         {CGROUP_FREEZER, kWarmName});
+
+  EXPECT_CALL(*mock_cgroup_factory_, OwnsCgroup(_))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_cgroup_factory_, Get(_, kWarmName))
+      .WillRepeatedly(Return(string("/dev/cgroup/_warm.1.0")));
+  EXPECT_CALL(*mock_cgroup_factory_, Rename(CGROUP_CPU, kWarmName, "/test"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_cgroup_factory_, Rename(CGROUP_MEMORY, kWarmName, "/test"))
+      .WillOnce(Return(Status(INTERNAL, "")));
+
+  // The cpu cgroup is renamed back.
+  EXPECT_CALL(*mock_cgroup_factory_, Rename(CGROUP_CPU, "/test", kWarmName))
+      .WillOnce(Return(Status::OK));
+
+  EXPECT_ERROR_CODE(INTERNAL, CallRenameWarm(kWarmName, "/test"));
+}
+
 TEST_F(ContainerApiImplTest, CreateTasksHandlerCreationFails) {
   const string kName = "/test";
 
@@ -1031,12 +1228,10 @@ TEST_F(ContainerApiImplDelegateTest,
 
 TEST_F(ContainerApiImplTest, DestroyNoSubcontainersSuccess) {
   MockContainer *mock_container = new StrictMock<MockContainer>("/test");
+  ExpectListSubcontainers("/test", {});
 
   EXPECT_CALL(*mock_container, Destroy())
       .WillRepeatedly(Return(Status::OK));
-  EXPECT_CALL(*mock_container, ListSubcontainers(Container::LIST_RECURSIVE))
-      .WillRepeatedly(
-          Return(StatusOr<vector<Container *>>(vector<Container *>())));
 
   // Destroy() deletes the container on success.
   EXPECT_EQ(Status::OK, lmctfy_->Destroy(mock_container));
@@ -1045,26 +1240,33 @@ TEST_F(ContainerApiImplTest, DestroyNoSubcontainersSuccess) {
 TEST_F(ContainerApiImplTest, DestroyGetSubcontainersFails) {
   unique_ptr<MockContainer> mock_container(
       new StrictMock<MockContainer>("/test"));
+  StrictMockTasksHandler *tasks_handler = new StrictMockTasksHandler("/test");
+  EXPECT_CALL(*tasks_handler,
+              ListSubcontainers(TasksHandler::ListType::RECURSIVE))
+      .WillOnce(Return(StatusOr<vector<string>>(Status::CANCELLED)));
+  EXPECT_CALL(*mock_tasks_handler_factory_, Get("/test"))
+      .WillOnce(Return(StatusOr<TasksHandler *>(tasks_handler)));
 
-  EXPECT_CALL(*mock_container, Destroy())
-      .WillRepeatedly(Return(Status::OK));
-  EXPECT_CALL(*mock_container, ListSubcontainers(Container::LIST_RECURSIVE))
-      .WillRepeatedly(
-          Return(StatusOr<vector<Container *>>(Status::CANCELLED)));
-
-  // Destroy() deletes the container on success.
   EXPECT_EQ(Status::CANCELLED, lmctfy_->Destroy(mock_container.get()));
 }
 
 TEST_F(ContainerApiImplTest, DestroyContainerDestroyFails) {
   unique_ptr<MockContainer> mock_container(
       new StrictMock<MockContainer>("/test"));
+  ExpectListSubcontainers("/test", {});
 
   EXPECT_CALL(*mock_container, Destroy())
       .WillRepeatedly(Return(Status::CANCELLED));
-  EXPECT_CALL(*mock_container, ListSubcontainers(Container::LIST_RECURSIVE))
-      .WillRepeatedly(
-          Return(StatusOr<vector<Container *>>(vector<Container *>())));
+
+  EXPECT_EQ(Status::CANCELLED, lmctfy_->Destroy(mock_container.get()));
+}
+
+TEST_F(ContainerApiImplTest, DestroyGetTasksHandlerFails) {
+  unique_ptr<MockContainer> mock_container(
+      new StrictMock<MockContainer>("/test"));
+
+  EXPECT_CALL(*mock_tasks_handler_factory_, Get("/test"))
+      .WillOnce(Return(StatusOr<TasksHandler *>(Status::CANCELLED)));
 
   EXPECT_EQ(Status::CANCELLED, lmctfy_->Destroy(mock_container.get()));
 }
@@ -1094,6 +1296,30 @@ class ContainerApiImplDestroyTest : public ::testing::Test {
     mock_container_ = new StrictMock<MockContainer>("/test");
   }
 
+  // Expects the container to be listed and to have the specified
+  // subcontainers.
+  void ExpectListSubcontainers(const string &container_name,
+                               const vector<string> &subcontainer_names) {
+    StrictMockTasksHandler *tasks_handler =
+        new StrictMockTasksHandler(container_name);
+    EXPECT_CALL(*tasks_handler,
+                ListSubcontainers(TasksHandler::ListType::RECURSIVE))
+        .WillOnce(Return(subcontainer_names));
+    EXPECT_CALL(*mock_tasks_handler_factory_, Get(container_name))
+        .WillOnce(Return(StatusOr<TasksHandler *>(tasks_handler)));
+  }
+
+  // Expects the container to be listed and the subcontainers to be gotten.
+  void ExpectSubcontainers(const vector<Container *> &subcontainers) {
+    vector<string> subcontainer_names;
+    for (Container *subcontainer : subcontainers) {
+      subcontainer_names.push_back(subcontainer->name());
+      EXPECT_CALL(*mock_lmctfy_, Get(subcontainer->name()))
+          .WillOnce(Return(StatusOr<Container *>(subcontainer)));
+    }
+    ExpectListSubcontainers("/test", subcontainer_names);
+  }
+
  protected:
   unique_ptr<MockContainerApiImpl> mock_lmctfy_;
   MockTasksHandlerFactory *mock_tasks_handler_factory_;
@@ -1105,13 +1331,52 @@ class ContainerApiImplDestroyTest : public ::testing::Test {
   MockKernelApiOverride mock_kernel_;
 };
 
+TEST_F(ContainerApiImplDestroyTest, DestroyWarmSubcontainers) {
+  MockContainer *mock_sub = new StrictMock<MockContainer>("/test/sub");
+  ExpectListSubcontainers("/test", {"/test/_warm.100.0", "/test/sub",
+                                    "/test/sub/_warm.100.1"});
+
+  // The warm containers of other processes are destroyed, even if they were
+  // already gone. They are not subcontainers.
+  EXPECT_CALL(*mock_lmctfy_, Exists("/test/_warm.100.0"))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*mock_lmctfy_, Exists("/test/sub/_warm.100.1"))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*mock_lmctfy_, Get("/test/sub"))
+      .WillOnce(Return(StatusOr<Container *>(mock_sub)));
+
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_sub, Destroy())
+        .WillOnce(Return(Status::OK));
+    EXPECT_CALL(*mock_container_, Destroy())
+        .WillOnce(Return(Status::OK));
+  }
+
+  EXPECT_OK(mock_lmctfy_->ContainerApiImpl::Destroy(mock_container_));
+}
+
+TEST_F(ContainerApiImplDestroyTest, DestroyGetSubcontainerFails) {
+  MockContainer *mock_sub1 = new StrictMock<MockContainer>("/test/sub1");
+  ExpectListSubcontainers("/test", {"/test/sub2", "/test/sub1"});
+
+  // Subcontainers are gotten in order, those already gotten are deleted.
+  EXPECT_CALL(*mock_lmctfy_, Get("/test/sub1"))
+      .WillOnce(Return(StatusOr<Container *>(mock_sub1)));
+  EXPECT_CALL(*mock_lmctfy_, Get("/test/sub2"))
+      .WillOnce(Return(StatusOr<Container *>(Status::CANCELLED)));
+
+  EXPECT_EQ(Status::CANCELLED,
+            mock_lmctfy_->ContainerApiImpl::Destroy(mock_container_));
+  delete mock_container_;
+}
+
 TEST_F(ContainerApiImplDestroyTest, DestroyOnlyChildrenContainersSuccess) {
   MockContainer *mock_sub = new StrictMock<MockContainer>("/test/sub");
   vector<Container *> subcontainers = {mock_sub};
 
   // Return two children subcontainers with no children
-  EXPECT_CALL(*mock_container_, ListSubcontainers(Container::LIST_RECURSIVE))
-      .WillRepeatedly(Return(StatusOr<vector<Container *>>(subcontainers)));
+  ExpectSubcontainers(subcontainers);
 
   // Call to Destroy() for all containers, children destroyed first
   {
@@ -1133,8 +1398,7 @@ TEST_F(ContainerApiImplDestroyTest, DestroyOnlyMultipleChildrenContainersSuccess
   vector<Container *> subcontainers = {mock_sub1, mock_sub2};
 
   // Return two children subcontainers with no children
-  EXPECT_CALL(*mock_container_, ListSubcontainers(Container::LIST_RECURSIVE))
-      .WillRepeatedly(Return(StatusOr<vector<Container *>>(subcontainers)));
+  ExpectSubcontainers(subcontainers);
 
   // Call to Destroy() for all containers
   EXPECT_CALL(*mock_container_, Destroy())
@@ -1155,8 +1419,7 @@ TEST_F(ContainerApiImplDestroyTest, DestroyOnlyChildrenContainersDestroyFails) {
   vector<Container *> subcontainers = {mock_sub1, mock_sub2};
 
   // Return two children subcontainers with no children
-  EXPECT_CALL(*mock_container_, ListSubcontainers(Container::LIST_RECURSIVE))
-      .WillRepeatedly(Return(StatusOr<vector<Container *>>(subcontainers)));
+  ExpectSubcontainers(subcontainers);
 
   // Call to Destroy() for all containers
   EXPECT_CALL(*mock_container_, Destroy())
@@ -1172,6 +1435,8 @@ TEST_F(ContainerApiImplDestroyTest, DestroyOnlyChildrenContainersDestroyFails) {
 }
 
 TEST_F(ContainerApiImplDestroyTest, DestroyChildrenContainersWithChildrenSuccess) {
+  ::google::FlagSaver flag_saver;
+  FLAGS_lmctfy_destroy_threads = 8;
   vector<ResourceHandler *> empty_handlers;
   MockContainer *mock_sub1 = new StrictMock<MockContainer>("/test/sub1");
   MockContainer *mock_sub2 = new StrictMock<MockContainer>("/test/sub2");
@@ -1181,8 +1446,7 @@ TEST_F(ContainerApiImplDestroyTest, DestroyChildrenContainersWithChildrenSuccess
                                        mock_sub2_1};
 
   // Return two children subcontainers with no children
-  EXPECT_CALL(*mock_container_, ListSubcontainers(Container::LIST_RECURSIVE))
-      .WillRepeatedly(Return(StatusOr<vector<Container *>>(subcontainers)));
+  ExpectSubcontainers(subcontainers);
 
   // Call to Destroy() for all containers, children killed before parents
   EXPECT_CALL(*mock_container_, Destroy())
@@ -1206,6 +1470,57 @@ TEST_F(ContainerApiImplDestroyTest, DestroyChildrenContainersWithChildrenSuccess
             mock_lmctfy_->ContainerApiImpl::Destroy(mock_container_));
 }
 
+TEST_F(ContainerApiImplDestroyTest, DestroyChildFailsParentNotDestroyed) {
+  ::google::FlagSaver flag_saver;
+  FLAGS_lmctfy_destroy_threads = 8;
+  MockContainer *mock_sub1 = new StrictMock<MockContainer>("/test/sub1");
+  MockContainer *mock_sub2 = new StrictMock<MockContainer>("/test/sub2");
+  MockContainer *mock_sub1_1 = new StrictMock<MockContainer>("/test/sub1/sub1");
+  vector<Container *> subcontainers = {mock_sub1, mock_sub2, mock_sub1_1};
+
+  ExpectSubcontainers(subcontainers);
+
+  // The parent of the failed container and the container itself are never
+  // destroyed. The sibling subtree may or may not be.
+  EXPECT_CALL(*mock_sub1_1, Destroy())
+      .WillOnce(Return(Status::CANCELLED));
+  EXPECT_CALL(*mock_sub1, Destroy())
+      .Times(0);
+  EXPECT_CALL(*mock_sub2, Destroy())
+      .Times(AtMost(1))
+      .WillRepeatedly(Return(Status::OK));
+  EXPECT_CALL(*mock_container_, Destroy())
+      .Times(0);
+
+  EXPECT_EQ(Status::CANCELLED,
+            mock_lmctfy_->ContainerApiImpl::Destroy(mock_container_));
+  delete mock_container_;
+}
+
+TEST_F(ContainerApiImplDestroyTest, DestroyOneAtATime) {
+  ::google::FlagSaver flag_saver;
+  FLAGS_lmctfy_destroy_threads = 1;
+  MockContainer *mock_sub1 = new StrictMock<MockContainer>("/test/sub1");
+  MockContainer *mock_sub2 = new StrictMock<MockContainer>("/test/sub2");
+  vector<Container *> subcontainers = {mock_sub1, mock_sub2};
+
+  ExpectSubcontainers(subcontainers);
+
+  // Subcontainers are destroyed in reverse order.
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_sub2, Destroy())
+        .WillOnce(Return(Status::OK));
+    EXPECT_CALL(*mock_sub1, Destroy())
+        .WillOnce(Return(Status::OK));
+    EXPECT_CALL(*mock_container_, Destroy())
+        .WillOnce(Return(Status::OK));
+  }
+
+  EXPECT_EQ(Status::OK,
+            mock_lmctfy_->ContainerApiImpl::Destroy(mock_container_));
+}
+
 // Tests for ResolveContainer
 
 TEST_F(ContainerApiImplTest, ResolveContainerName) {
@@ -1346,6 +1661,312 @@ TEST_F(ContainerApiImplTest, DetectNoSuchContainer) {
   EXPECT_EQ(Status::CANCELLED, statusor.status());
 }
 
+// Tests for GetCloneCgroupPath()
+
+TEST_F(ContainerApiImplTest, GetCloneCgroupPathWithoutUnified) {
+  StrictMockTasksHandler tasks_handler("/test");
+  StrictMockFreezerController freezer_controller;
+
+  // Processes are started from an entered thread without looking at the
+  // handlers.
+  StatusOr<string> statusor = lmctfy_->GetCloneCgroupPath(
+      vector<ResourceHandler *>(), tasks_handler, freezer_controller);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("", statusor.ValueOrDie());
+}
+
+TEST_F(ContainerApiImplTest, GetCloneCgroupPathUnified) {
+  MockCgroupFactory *cgroup_factory = new StrictMockCgroupFactory(
+      set<CgroupHierarchy>({CGROUP_CPU, CGROUP_FREEZER, CGROUP_JOB}));
+  ContainerApiImpl lmctfy(
+      new StrictMockTasksHandlerFactory(),
+      unique_ptr<CgroupFactory>(cgroup_factory),
+      vector<ResourceHandlerFactory *>(), &mock_kernel_.Mock(),
+      new ActiveNotifications(),
+      new StrictMockNamespaceHandlerFactory(),
+      MockEventFdNotifications::NewStrict(),
+      unique_ptr<FreezerControllerFactory>(nullptr));
+
+  // The CPU handler is inherited from the root.
+  StrictMockResourceHandler resource_handler("/", RESOURCE_CPU);
+  EXPECT_CALL(resource_handler, PopulateMachineSpec(NotNull()))
+      .WillOnce(AddVirtualRoot({CGROUP_CPU, "/"}));
+  StrictMockFreezerController freezer_controller;
+  EXPECT_CALL(freezer_controller, PopulateMachineSpec(NotNull()))
+      .WillOnce(AddVirtualRoot({CGROUP_FREEZER, "/test"}));
+  StrictMockTasksHandler tasks_handler("/test");
+  EXPECT_CALL(tasks_handler, PopulateMachineSpec(NotNull()))
+      .WillOnce(AddVirtualRoot({CGROUP_JOB, "/test"}));
+  EXPECT_CALL(*cgroup_factory, Get(CGROUP_JOB, "/test"))
+      .WillOnce(Return(string("/sys/fs/cgroup/test")));
+
+  StatusOr<string> statusor = lmctfy.GetCloneCgroupPath(
+      {&resource_handler}, tasks_handler, freezer_controller);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("/sys/fs/cgroup/test", statusor.ValueOrDie());
+}
+
+TEST_F(ContainerApiImplTest, GetCloneCgroupPathNotAllUnified) {
+  MockCgroupFactory *cgroup_factory = new StrictMockCgroupFactory(
+      set<CgroupHierarchy>({CGROUP_FREEZER, CGROUP_JOB}));
+  ContainerApiImpl lmctfy(
+      new StrictMockTasksHandlerFactory(),
+      unique_ptr<CgroupFactory>(cgroup_factory),
+      vector<ResourceHandlerFactory *>(), &mock_kernel_.Mock(),
+      new ActiveNotifications(),
+      new StrictMockNamespaceHandlerFactory(),
+      MockEventFdNotifications::NewStrict(),
+      unique_ptr<FreezerControllerFactory>(nullptr));
+
+  // Memory is in a v1 hierarchy, a cloned process could only be in one of the
+  // cgroups.
+  StrictMockResourceHandler resource_handler("/test", RESOURCE_MEMORY);
+  EXPECT_CALL(resource_handler, PopulateMachineSpec(NotNull()))
+      .WillOnce(AddVirtualRoot({CGROUP_MEMORY, "/test"}));
+  StrictMockFreezerController freezer_controller;
+  EXPECT_CALL(freezer_controller, PopulateMachineSpec(NotNull()))
+      .WillOnce(AddVirtualRoot({CGROUP_FREEZER, "/test"}));
+  StrictMockTasksHandler tasks_handler("/test");
+  EXPECT_CALL(tasks_handler, PopulateMachineSpec(NotNull()))
+      .WillOnce(AddVirtualRoot({CGROUP_JOB, "/test"}));
+
+  StatusOr<string> statusor = lmctfy.GetCloneCgroupPath(
+      {&resource_handler}, tasks_handler, freezer_controller);
+  ASSERT_OK(statusor);
+  EXPECT_EQ("", statusor.ValueOrDie());
+}
+
+// Tests for StatsMany()
+
+// Returns a handler for the specified resource whose Stats() returns status and
+// adds an empty entry for that resource to the output.
+static ResourceHandler *NewStatsHandler(const string &container_name,
+                                        ResourceType type,
+                                        Container::StatsType stats_type,
+                                        Status status) {
+  MockResourceHandler *handler =
+      new StrictMockResourceHandler(container_name, type);
+  EXPECT_CALL(*handler, Stats(stats_type, NotNull()))
+      .WillOnce(Invoke([type, status](Container::StatsType stats_type,
+                                      ContainerStats *output) {
+        if (type == RESOURCE_CPU) {
+          output->mutable_cpu();
+        } else if (type == RESOURCE_MEMORY) {
+          output->mutable_memory();
+        }
+        return status;
+      }));
+  return handler;
+}
+
+TEST_F(ContainerApiImplTest, StatsManySuccess) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists(_))
+      .WillRepeatedly(Return(true));
+
+  // /a isolates CPU and memory, /b only isolates memory.
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Return(NewStatsHandler("/a", RESOURCE_CPU,
+                                       Container::STATS_FULL, Status::OK)));
+  EXPECT_CALL(*mock_handler_factory1_, Get("/b"))
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory2_, Get("/a"))
+      .WillOnce(Return(NewStatsHandler("/a", RESOURCE_MEMORY,
+                                       Container::STATS_FULL, Status::OK)));
+  EXPECT_CALL(*mock_handler_factory2_, Get("/b"))
+      .WillOnce(Return(NewStatsHandler("/b", RESOURCE_MEMORY,
+                                       Container::STATS_FULL, Status::OK)));
+  EXPECT_CALL(*mock_handler_factory3_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory4_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_namespace_handler_factory_, GetNamespaceHandler(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+
+  StatusOr<map<string, ContainerStats>> statusor =
+      lmctfy_->StatsMany({"/a", "/b/", "/a"}, Container::STATS_FULL);
+  ASSERT_OK(statusor);
+  const map<string, ContainerStats> &stats = statusor.ValueOrDie();
+  ASSERT_EQ(2, stats.size());
+  ASSERT_EQ(1, stats.count("/a"));
+  EXPECT_TRUE(stats.at("/a").has_cpu());
+  EXPECT_TRUE(stats.at("/a").has_memory());
+  ASSERT_EQ(1, stats.count("/b"));
+  EXPECT_FALSE(stats.at("/b").has_cpu());
+  EXPECT_TRUE(stats.at("/b").has_memory());
+}
+
+TEST_F(ContainerApiImplTest, StatsManySweepsNamespaceHandlers) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Return(Status::CANCELLED));
+
+  // The sweep ends even when the stats fail.
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_namespace_handler_factory_, BeginStatsSweep());
+    EXPECT_CALL(*mock_namespace_handler_factory_, EndStatsSweep());
+  }
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    lmctfy_->StatsMany({"/a"}, Container::STATS_SUMMARY));
+}
+
+TEST_F(ContainerApiImplTest, StatsManyNoContainers) {
+  StatusOr<map<string, ContainerStats>> statusor =
+      lmctfy_->StatsMany({}, Container::STATS_SUMMARY);
+  ASSERT_OK(statusor);
+  EXPECT_TRUE(statusor.ValueOrDie().empty());
+}
+
+TEST_F(ContainerApiImplTest, StatsManySkipsNonExistentContainers) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillRepeatedly(Return(false));
+
+  StatusOr<map<string, ContainerStats>> statusor =
+      lmctfy_->StatsMany({"/a"}, Container::STATS_SUMMARY);
+  ASSERT_OK(statusor);
+  EXPECT_TRUE(statusor.ValueOrDie().empty());
+}
+
+TEST_F(ContainerApiImplTest, StatsManyBadContainerName) {
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    lmctfy_->StatsMany({"*"}, Container::STATS_SUMMARY));
+}
+
+TEST_F(ContainerApiImplTest, StatsManyGetHandlerFails) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    lmctfy_->StatsMany({"/a"}, Container::STATS_SUMMARY));
+}
+
+TEST_F(ContainerApiImplTest, StatsManyStatsFails) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Return(NewStatsHandler("/a", RESOURCE_CPU,
+                                       Container::STATS_SUMMARY,
+                                       Status::CANCELLED)));
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    lmctfy_->StatsMany({"/a"}, Container::STATS_SUMMARY));
+}
+
+TEST_F(ContainerApiImplTest, StatsManyReportsErrorsPerContainer) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists(_))
+      .WillRepeatedly(Return(true));
+
+  // The stats of /a can't be read, those of /b can.
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Return(NewStatsHandler("/a", RESOURCE_CPU,
+                                       Container::STATS_SUMMARY,
+                                       Status::CANCELLED)));
+  EXPECT_CALL(*mock_handler_factory1_, Get("/b"))
+      .WillOnce(Return(NewStatsHandler("/b", RESOURCE_CPU,
+                                       Container::STATS_SUMMARY, Status::OK)));
+  EXPECT_CALL(*mock_handler_factory2_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory3_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory4_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_namespace_handler_factory_, GetNamespaceHandler(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+
+  map<string, Status> errors;
+  StatusOr<map<string, ContainerStats>> statusor =
+      lmctfy_->StatsMany({"*", "/a", "/b"}, Container::STATS_SUMMARY, &errors);
+  ASSERT_OK(statusor);
+  const map<string, ContainerStats> &stats = statusor.ValueOrDie();
+  ASSERT_EQ(1, stats.size());
+  EXPECT_TRUE(stats.at("/b").has_cpu());
+  ASSERT_EQ(2, errors.size());
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT, errors.at("*"));
+  EXPECT_ERROR_CODE(::util::error::CANCELLED, errors.at("/a"));
+}
+
+TEST_F(ContainerApiImplTest, StatsManyBatchesCgroupLookups) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillOnce(Return(true));
+
+  // The handlers are looked up inside a batch, which is closed afterwards.
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Invoke([](const string &name) -> StatusOr<ResourceHandler *> {
+        EXPECT_NE(nullptr, CgroupLookupBatch::Current());
+        return Status(NOT_FOUND, "");
+      }));
+  EXPECT_CALL(*mock_handler_factory2_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory3_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory4_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_namespace_handler_factory_, GetNamespaceHandler(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+
+  ASSERT_OK(lmctfy_->StatsMany({"/a"}, Container::STATS_SUMMARY));
+  EXPECT_EQ(nullptr, CgroupLookupBatch::Current());
+}
+
+TEST_F(ContainerApiImplTest, StatsManyContainerDestroyedDuringStats) {
+  // Whether the container still exists is checked outside of the batch.
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillOnce(Return(true))
+      .WillRepeatedly(Invoke([](const string &name) {
+        EXPECT_EQ(nullptr, CgroupLookupBatch::Current());
+        return false;
+      }));
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Return(NewStatsHandler("/a", RESOURCE_CPU,
+                                       Container::STATS_SUMMARY,
+                                       Status(NOT_FOUND, ""))));
+
+  StatusOr<map<string, ContainerStats>> statusor =
+      lmctfy_->StatsMany({"/a"}, Container::STATS_SUMMARY);
+  ASSERT_OK(statusor);
+  EXPECT_TRUE(statusor.ValueOrDie().empty());
+}
+
+// Tests for StatsRates()
+
+TEST_F(ContainerApiImplTest, StatsRatesFirstCallIsUnavailable) {
+  // Don't sample in the background during the test.
+  FLAGS_lmctfy_stats_sample_interval_ms = 3600 * 1000;
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_handler_factory1_, Get("/a"))
+      .WillOnce(Return(NewStatsHandler("/a", RESOURCE_CPU,
+                                       Container::STATS_FULL, Status::OK)));
+  EXPECT_CALL(*mock_handler_factory2_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory3_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_handler_factory4_, Get(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_namespace_handler_factory_, GetNamespaceHandler(_))
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+
+  // The first call takes the first sample, two are needed.
+  EXPECT_ERROR_CODE(::util::error::UNAVAILABLE, lmctfy_->StatsRates("/a"));
+  FLAGS_lmctfy_stats_sample_interval_ms = 1000;
+}
+
+TEST_F(ContainerApiImplTest, StatsRatesNonExistentContainer) {
+  EXPECT_CALL(*mock_tasks_handler_factory_, Exists("/a"))
+      .WillRepeatedly(Return(false));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, lmctfy_->StatsRates("/a"));
+}
+
+TEST_F(ContainerApiImplTest, StatsRatesBadContainerName) {
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    lmctfy_->StatsRates("*"));
+}
+
 static bool CompareByName(Container *c1, Container *c2) {
   return c1->name() < c2->name();
 }
@@ -1390,7 +2011,7 @@ class ContainerImplTest : public ::testing::Test {
       {RESOURCE_FILESYSTEM, mock_resource_factory3_.get()},
     };
 
-    mock_freezer_controller_ = new StrictMockFreezerController();
+    mock_freezer_controller_ = new StrictMockFreezerController(container_name);
 
     container_.reset(new ContainerImpl(
         container_name,
@@ -1558,9 +2179,26 @@ class ContainerImplTest : public ::testing::Test {
           .WillRepeatedly(Return(status));
     }
 
-    EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-        FLAGS_lmctfy_ms_delay_between_kills * 1000))
+    EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
         .WillRepeatedly(Return(0));
+    ExpectFreezeForKillAll(true);
+  }
+
+  // Expect KillAll() to try to freeze the container. If frozen is false, the
+  // freezer is unavailable.
+  void ExpectFreezeForKillAll(bool frozen) {
+    // The caller is outside of the container.
+    EXPECT_CALL(*mock_lmctfy_, DetectFreezerCgroup(0))
+        .WillRepeatedly(Return(StatusOr<string>("/")));
+    if (frozen) {
+      EXPECT_CALL(*mock_freezer_controller_, Freeze())
+          .WillRepeatedly(Return(Status::OK));
+      EXPECT_CALL(*mock_freezer_controller_, Unfreeze())
+          .WillRepeatedly(Return(Status::OK));
+    } else {
+      EXPECT_CALL(*mock_freezer_controller_, Freeze())
+          .WillRepeatedly(Return(Status(::util::error::NOT_FOUND, "")));
+    }
   }
 
   void ExpectEnterInto(pid_t pid, Status status) {
@@ -1608,6 +2246,10 @@ class ContainerImplTest : public ::testing::Test {
     return container_->KillTasks(type);
   }
 
+  void CallInvalidateHandlerCache() {
+    container_->InvalidateHandlerCache();
+  }
+
  protected:
   // Map of created mock containers (from their names to the mock object).
   map<string, MockContainer *> container_map_;
@@ -1669,6 +2311,27 @@ TEST_F(ListSubcontainersTest, OneLevel) {
   }
 }
 
+TEST_F(ListSubcontainersTest, WarmContainersAreSkipped) {
+  const string kSub = JoinPath(kContainerName, "sub1");
+  const string kWarm = JoinPath(kContainerName, "_warm.1.0");
+
+  // Call for self and recursive
+  for (const auto &policy : list_policies_) {
+    ExpectSubcontainers({kSub}, policy);
+    EXPECT_CALL(*mock_tasks_handler_,
+                ListSubcontainers(ToTasksHandlerListType(policy)))
+        .WillRepeatedly(Return(vector<string>({kWarm, kSub})));
+
+    StatusOr<vector<Container *>> statusor = container_->ListSubcontainers(
+        policy);
+    ASSERT_OK(statusor);
+    vector<Container *> subcontainers = statusor.ValueOrDie();
+    EXPECT_EQ(1, subcontainers.size());
+    ExpectContainers(subcontainers);
+    STLDeleteElements(&subcontainers);
+  }
+}
+
 TEST_F(ListSubcontainersTest, ListFails) {
   // Call for self and recursive
   for (const auto &policy : list_policies_) {
@@ -2063,6 +2726,9 @@ TEST_F(ContainerImplTest, StatsSuccess) {
     EXPECT_FALSE(stats.has_network());
     EXPECT_FALSE(stats.has_monitoring());
     EXPECT_FALSE(stats.has_filesystem());
+
+    // Handlers are cached, get new ones for the next stats type.
+    CallInvalidateHandlerCache();
   }
 }
 
@@ -2088,6 +2754,9 @@ TEST_F(ContainerImplTest, StatsEmpty) {
     EXPECT_FALSE(stats.has_network());
     EXPECT_FALSE(stats.has_monitoring());
     EXPECT_FALSE(stats.has_filesystem());
+
+    // Handlers are cached, get new ones for the next stats type.
+    CallInvalidateHandlerCache();
   }
 }
 
@@ -2116,6 +2785,77 @@ TEST_F(ContainerImplTest, StatsResourceStatsFails) {
   }
 }
 
+TEST_F(ContainerImplTest, StatsHandlersAreCached) {
+  vector<MockResourceHandler *> mock_handlers = ExpectGetResourceHandlers(
+      Status::OK);
+  // The namespace handler is only created once.
+  MockNamespaceHandler *mock_namespace_handler = ExpectGetNamespaceHandler();
+
+  for (MockResourceHandler *mock_handler : mock_handlers) {
+    EXPECT_CALL(*mock_handler, Stats(Container::STATS_SUMMARY, NotNull()))
+        .Times(AtMost(2))
+        .WillRepeatedly(Return(Status::OK));
+  }
+  EXPECT_CALL(*mock_namespace_handler,
+              Stats(Container::STATS_SUMMARY, NotNull()))
+      .Times(2)
+      .WillRepeatedly(Return(Status::OK));
+
+  EXPECT_OK(container_->Stats(Container::STATS_SUMMARY));
+  EXPECT_OK(container_->Stats(Container::STATS_SUMMARY));
+}
+
+TEST_F(ContainerImplTest, StatsFailureInvalidatesHandlerCache) {
+  // The first handlers fail.
+  vector<MockResourceHandler *> mock_handlers = ExpectGetResourceHandlers(
+      Status::OK);
+  MockNamespaceHandler *mock_namespace_handler = ExpectGetNamespaceHandler();
+  for (MockResourceHandler *mock_handler : mock_handlers) {
+    EXPECT_CALL(*mock_handler, Stats(Container::STATS_SUMMARY, NotNull()))
+        .WillRepeatedly(Return(Status::OK));
+  }
+  EXPECT_CALL(*mock_namespace_handler,
+              Stats(Container::STATS_SUMMARY, NotNull()))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED,
+            container_->Stats(Container::STATS_SUMMARY).status());
+
+  // The failure dropped the cached handlers, they are created again.
+  mock_handlers = ExpectGetResourceHandlers(Status::OK);
+  mock_namespace_handler = ExpectGetNamespaceHandler();
+  for (MockResourceHandler *mock_handler : mock_handlers) {
+    EXPECT_CALL(*mock_handler, Stats(Container::STATS_SUMMARY, NotNull()))
+        .WillRepeatedly(Return(Status::OK));
+  }
+  EXPECT_CALL(*mock_namespace_handler,
+              Stats(Container::STATS_SUMMARY, NotNull()))
+      .WillOnce(Return(Status::OK));
+
+  EXPECT_OK(container_->Stats(Container::STATS_SUMMARY));
+}
+
+TEST_F(ContainerImplTest, StatsHandlerCacheDisabled) {
+  ::google::FlagSaver flag_saver;
+  FLAGS_lmctfy_cache_resource_handlers = false;
+
+  // Handlers are created for each call.
+  for (int i = 0; i < 2; ++i) {
+    vector<MockResourceHandler *> mock_handlers = ExpectGetResourceHandlers(
+        Status::OK);
+    MockNamespaceHandler *mock_namespace_handler = ExpectGetNamespaceHandler();
+    for (MockResourceHandler *mock_handler : mock_handlers) {
+      EXPECT_CALL(*mock_handler, Stats(Container::STATS_SUMMARY, NotNull()))
+          .WillRepeatedly(Return(Status::OK));
+    }
+    EXPECT_CALL(*mock_namespace_handler,
+                Stats(Container::STATS_SUMMARY, NotNull()))
+        .WillOnce(Return(Status::OK));
+
+    EXPECT_OK(container_->Stats(Container::STATS_SUMMARY));
+  }
+}
+
 // Tests for KillAll().
 
 TEST_F(ContainerImplTest, KillAllNoContainer) {
@@ -2125,20 +2865,58 @@ TEST_F(ContainerImplTest, KillAllNoContainer) {
 }
 
 TEST_F(ContainerImplTest, KillAllAlreadyEmpty) {
+  ExpectFreezeForKillAll(false);
+
   // No processes or threads.
   EXPECT_CALL(*mock_tasks_handler_, ListProcesses(TasksHandler::ListType::SELF))
       .WillRepeatedly(Return(vector<pid_t>()));
   EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
       .WillRepeatedly(Return(vector<pid_t>()));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(container_->KillAll().ok());
 }
 
+TEST_F(ContainerImplTest, KillAllCallerInSubcontainerNotFrozen) {
+  // Freezing the container would freeze the caller too, with nothing left to
+  // thaw it.
+  EXPECT_CALL(*mock_lmctfy_, DetectFreezerCgroup(0))
+      .WillRepeatedly(
+          Return(StatusOr<string>(JoinPath(kContainerName, "sub"))));
+
+  EXPECT_CALL(*mock_tasks_handler_, ListProcesses(TasksHandler::ListType::SELF))
+      .WillRepeatedly(Return(vector<pid_t>()));
+  EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
+      .WillRepeatedly(Return(vector<pid_t>()));
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
+      .WillRepeatedly(Return(0));
+
+  EXPECT_OK(container_->KillAll());
+}
+
+TEST_F(ContainerImplTest, KillAllCallerInSiblingFrozen) {
+  EXPECT_CALL(*mock_lmctfy_, DetectFreezerCgroup(0))
+      .WillRepeatedly(Return(StatusOr<string>(string(kContainerName) + "2")));
+  EXPECT_CALL(*mock_freezer_controller_, Freeze())
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_freezer_controller_, Unfreeze())
+      .WillOnce(Return(Status::OK));
+
+  EXPECT_CALL(*mock_tasks_handler_, ListProcesses(TasksHandler::ListType::SELF))
+      .WillRepeatedly(Return(vector<pid_t>()));
+  EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
+      .WillRepeatedly(Return(vector<pid_t>()));
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
+      .WillRepeatedly(Return(0));
+
+  EXPECT_OK(container_->KillAll());
+}
+
 TEST_F(ContainerImplTest, KillAllDieOnFirstKill) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
 
   // Processes are killed on the first SIGKILL.
@@ -2151,14 +2929,15 @@ TEST_F(ContainerImplTest, KillAllDieOnFirstKill) {
   EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
       .WillRepeatedly(Return(vector<pid_t>()));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(container_->KillAll().ok());
 }
 
 TEST_F(ContainerImplTest, KillAllSigkillFails) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
 
   // Processes are killed on the first SIGTERM.
@@ -2171,8 +2950,7 @@ TEST_F(ContainerImplTest, KillAllSigkillFails) {
   EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
       .WillRepeatedly(Return(vector<pid_t>()));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   // We ignore KillTasks failing.
@@ -2180,6 +2958,8 @@ TEST_F(ContainerImplTest, KillAllSigkillFails) {
 }
 
 TEST_F(ContainerImplTest, KillAllDoNotDieOnFirstKill) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
 
   // Processes are killed after the second SIGKILL.
@@ -2193,14 +2973,15 @@ TEST_F(ContainerImplTest, KillAllDoNotDieOnFirstKill) {
   EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
       .WillRepeatedly(Return(vector<pid_t>()));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(container_->KillAll().ok());
 }
 
 TEST_F(ContainerImplTest, KillAllUsleepFails) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
 
   // Processes are killed after the second SIGKILL.
@@ -2214,8 +2995,7 @@ TEST_F(ContainerImplTest, KillAllUsleepFails) {
   EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
       .WillRepeatedly(Return(vector<pid_t>()));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(-1));
 
   // We ignore Usleep failing.
@@ -2223,6 +3003,8 @@ TEST_F(ContainerImplTest, KillAllUsleepFails) {
 }
 
 TEST_F(ContainerImplTest, KillAllUnkillableProcesses) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
 
   // Processes are never killed.
@@ -2234,8 +3016,7 @@ TEST_F(ContainerImplTest, KillAllUnkillableProcesses) {
   EXPECT_CALL(*mock_tasks_handler_, ListThreads(TasksHandler::ListType::SELF))
       .WillRepeatedly(Return(vector<pid_t>()));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   Status status = container_->KillAll();
@@ -2244,6 +3025,8 @@ TEST_F(ContainerImplTest, KillAllUnkillableProcesses) {
 }
 
 TEST_F(ContainerImplTest, KillAllWithTouristThreads) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
   const vector<pid_t> kTids = {4, 5, 6};
 
@@ -2259,14 +3042,15 @@ TEST_F(ContainerImplTest, KillAllWithTouristThreads) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kTids, 0, Exactly(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(container_->KillAll().ok());
 }
 
 TEST_F(ContainerImplTest, KillAllWithTouristThreadsSigkillFails) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
   const vector<pid_t> kTids = {4, 5, 6};
 
@@ -2282,8 +3066,7 @@ TEST_F(ContainerImplTest, KillAllWithTouristThreadsSigkillFails) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kTids, -1, Exactly(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   // We ignore signal failing.
@@ -2291,6 +3074,8 @@ TEST_F(ContainerImplTest, KillAllWithTouristThreadsSigkillFails) {
 }
 
 TEST_F(ContainerImplTest, KillAllUnkillableTouristThreads) {
+  ExpectFreezeForKillAll(false);
+
   const vector<pid_t> kPids = {1, 2, 3};
   const vector<pid_t> kTids = {4, 5, 6};
 
@@ -2305,8 +3090,7 @@ TEST_F(ContainerImplTest, KillAllUnkillableTouristThreads) {
       .WillRepeatedly(Return(kTids));
   ExpectKill(kTids, 0, AtLeast(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   Status status = container_->KillAll();
@@ -2314,8 +3098,95 @@ TEST_F(ContainerImplTest, KillAllUnkillableTouristThreads) {
   EXPECT_EQ(::util::error::FAILED_PRECONDITION, status.error_code());
 }
 
+TEST_F(ContainerImplTest, KillAllFrozen) {
+  const vector<pid_t> kPids = {1, 2, 3};
+
+  {
+    // Processes are signalled while the container is frozen.
+    InSequence s;
+    EXPECT_CALL(*mock_freezer_controller_, Freeze())
+        .WillOnce(Return(Status::OK));
+    EXPECT_CALL(*mock_tasks_handler_,
+                ListProcesses(TasksHandler::ListType::SELF))
+        .WillOnce(Return(kPids));
+    ExpectKill(kPids, 0, Exactly(1));
+    EXPECT_CALL(*mock_freezer_controller_, Unfreeze())
+        .WillOnce(Return(Status::OK));
+
+    // Processes died when thawed.
+    EXPECT_CALL(*mock_tasks_handler_,
+                ListProcesses(TasksHandler::ListType::SELF))
+        .WillOnce(Return(vector<pid_t>()));
+    EXPECT_CALL(*mock_tasks_handler_,
+                ListThreads(TasksHandler::ListType::SELF))
+        .WillOnce(Return(vector<pid_t>()));
+  }
+
+  EXPECT_OK(container_->KillAll());
+}
+
+TEST_F(ContainerImplTest, KillAllFrozenListFails) {
+  EXPECT_CALL(*mock_freezer_controller_, Freeze())
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_tasks_handler_, ListProcesses(TasksHandler::ListType::SELF))
+      .WillOnce(Return(Status::CANCELLED));
+
+  // The container is thawed even if the processes could not be listed.
+  EXPECT_CALL(*mock_freezer_controller_, Unfreeze())
+      .WillOnce(Return(Status::OK));
+
+  EXPECT_EQ(Status::CANCELLED, container_->KillAll());
+}
+
+TEST_F(ContainerImplTest, KillAllUnfreezeFails) {
+  const vector<pid_t> kPids = {1, 2, 3};
+
+  EXPECT_CALL(*mock_freezer_controller_, Freeze())
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_tasks_handler_, ListProcesses(TasksHandler::ListType::SELF))
+      .WillOnce(Return(kPids));
+  ExpectKill(kPids, 0, Exactly(1));
+  EXPECT_CALL(*mock_freezer_controller_, Unfreeze())
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED, container_->KillAll());
+}
+
 // Tests for KillTasks().
 
+TEST_F(ContainerImplTest, KillTasksBacksOffExponentially) {
+  const int32 saved_num_tries = FLAGS_lmctfy_num_tries_for_unkillable;
+  const int32 saved_max_delay_ms = FLAGS_lmctfy_ms_delay_between_kills;
+  const int32 saved_initial_delay_us =
+      FLAGS_lmctfy_us_initial_delay_between_kills;
+  FLAGS_lmctfy_num_tries_for_unkillable = 2;
+  FLAGS_lmctfy_ms_delay_between_kills = 1;
+  FLAGS_lmctfy_us_initial_delay_between_kills = 100;
+  const vector<pid_t> kPids = {1, 2, 3};
+
+  EXPECT_CALL(*mock_tasks_handler_, ListProcesses(TasksHandler::ListType::SELF))
+      .WillRepeatedly(Return(kPids));
+  ExpectKill(kPids, 0, Exactly(6));
+
+  // The delay doubles up to 1ms and we wait 2ms in total.
+  {
+    InSequence s;
+    EXPECT_CALL(mock_kernel_.Mock(), Usleep(100)).WillOnce(Return(0));
+    EXPECT_CALL(mock_kernel_.Mock(), Usleep(200)).WillOnce(Return(0));
+    EXPECT_CALL(mock_kernel_.Mock(), Usleep(400)).WillOnce(Return(0));
+    EXPECT_CALL(mock_kernel_.Mock(), Usleep(800)).WillOnce(Return(0));
+    EXPECT_CALL(mock_kernel_.Mock(), Usleep(500)).WillOnce(Return(0));
+  }
+
+  EXPECT_ERROR_CODE(FAILED_PRECONDITION,
+                    CallKillTasks(ContainerImpl::LIST_PROCESSES));
+
+  FLAGS_lmctfy_num_tries_for_unkillable = saved_num_tries;
+  FLAGS_lmctfy_ms_delay_between_kills = saved_max_delay_ms;
+  FLAGS_lmctfy_us_initial_delay_between_kills = saved_initial_delay_us;
+}
+
+
 TEST_F(ContainerImplTest, KillTasksThreadsSuccess) {
   const vector<pid_t> kPids = {1, 2, 3};
 
@@ -2324,8 +3195,7 @@ TEST_F(ContainerImplTest, KillTasksThreadsSuccess) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kPids, 0, Exactly(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(CallKillTasks(ContainerImpl::LIST_THREADS).ok());
@@ -2340,8 +3210,7 @@ TEST_F(ContainerImplTest, KillTasksThreadsOneFailure) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kPids, 0, Exactly(2));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(CallKillTasks(ContainerImpl::LIST_THREADS).ok());
@@ -2354,8 +3223,7 @@ TEST_F(ContainerImplTest, KillTasksThreadsTriesRunOut) {
       .WillRepeatedly(Return(kPids));
   ExpectKill(kPids, 0, AtLeast(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   Status status = CallKillTasks(ContainerImpl::LIST_THREADS);
@@ -2373,8 +3241,7 @@ TEST_F(ContainerImplTest, KillTasksThreadsTriesRunOutListFails) {
       .WillOnce(Return(Status::CANCELLED));
   ExpectKill(kPids, 0, Exactly(3));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_EQ(Status::CANCELLED, CallKillTasks(ContainerImpl::LIST_THREADS));
@@ -2397,8 +3264,7 @@ TEST_F(ContainerImplTest, KillTasksThreadsKillFails) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kPids, -1, Exactly(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   // We ignore kill failing
@@ -2413,8 +3279,7 @@ TEST_F(ContainerImplTest, KillTasksProcessesSuccess) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kPids, 0, Exactly(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(CallKillTasks(ContainerImpl::LIST_PROCESSES).ok());
@@ -2429,8 +3294,7 @@ TEST_F(ContainerImplTest, KillTasksProcessesOneFailure) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kPids, 0, Exactly(2));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_TRUE(CallKillTasks(ContainerImpl::LIST_PROCESSES).ok());
@@ -2443,8 +3307,7 @@ TEST_F(ContainerImplTest, KillTasksProcessesTriesRunOut) {
       .WillRepeatedly(Return(kPids));
   ExpectKill(kPids, 0, AtLeast(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   Status status = CallKillTasks(ContainerImpl::LIST_PROCESSES);
@@ -2462,8 +3325,7 @@ TEST_F(ContainerImplTest, KillTasksProcessesTriesRunOutListFails) {
       .WillOnce(Return(Status::CANCELLED));
   ExpectKill(kPids, 0, Exactly(3));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   EXPECT_EQ(Status::CANCELLED, CallKillTasks(ContainerImpl::LIST_PROCESSES));
@@ -2486,8 +3348,7 @@ TEST_F(ContainerImplTest, KillTasksProcessesKillFails) {
       .WillRepeatedly(Return(vector<pid_t>()));
   ExpectKill(kPids, -1, Exactly(1));
 
-  EXPECT_CALL(mock_kernel_.Mock(), Usleep(
-      FLAGS_lmctfy_ms_delay_between_kills * 1000))
+  EXPECT_CALL(mock_kernel_.Mock(), Usleep(_))
       .WillRepeatedly(Return(0));
 
   // We ignore kill failing
@@ -3304,6 +4165,40 @@ TEST_F(ContainerImplTest, RegisterNotificationNoHandlerForEvent) {
                         spec, NewPermanentCallback(&NotificationCallback)));
 }
 
+// Deletes the specified callback.
+void DeleteEmptyCallback(Callback1<Status> *callback) {
+  delete callback;
+}
+
+TEST_F(ContainerImplTest, RegisterNotificationContainerEmpty) {
+  EventSpec spec;
+  spec.mutable_container_empty();
+
+  ExpectExists(true);
+  EXPECT_CALL(*mock_tasks_handler_, RegisterEmptyNotification(NotNull()))
+      .WillOnce(DoAll(Invoke(&DeleteEmptyCallback), Return(1)));
+
+  StatusOr<Container::NotificationId> statusor =
+      container_->RegisterNotification(
+          spec, NewPermanentCallback(&NotificationCallback));
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
+TEST_F(ContainerImplTest, RegisterNotificationContainerEmptyFails) {
+  EventSpec spec;
+  spec.mutable_container_empty();
+
+  ExpectExists(true);
+  EXPECT_CALL(*mock_tasks_handler_, RegisterEmptyNotification(NotNull()))
+      .WillOnce(DoAll(Invoke(&DeleteEmptyCallback),
+                      Return(Status::CANCELLED)));
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    container_->RegisterNotification(
+                        spec, NewPermanentCallback(&NotificationCallback)));
+}
+
 // Tests for UnregisterNotification().
 
 TEST_F(ContainerImplTest, UnregisterNotificationNoContainer) {
@@ -16,6 +16,7 @@
 #include "lmctfy/controllers/cgroup_factory.h"
 #include "lmctfy/controllers/eventfd_notifications.h"
 #include "lmctfy/resource_handler.h"
+#include "lmctfy/resources/blockio_resource_handler.h"
 #include "lmctfy/resources/cpu_resource_handler.h"
 #include "lmctfy/resources/device_resource_handler.h"
 #include "lmctfy/resources/memory_resource_handler.h"
@@ -58,6 +59,10 @@ StatusOr<vector<ResourceHandlerFactory *>> CreateSupportedResources(
       AppendIfAvailable(MemoryResourceHandlerFactory::New(
                             cgroup_factory, kernel, eventfd_notifications),
                         &resource_factories));
+  RETURN_IF_ERROR(
+      AppendIfAvailable(BlockIoResourceHandlerFactory::New(
+                            cgroup_factory, kernel, eventfd_notifications),
+                        &resource_factories));
   RETURN_IF_ERROR(
       AppendIfAvailable(DeviceResourceHandlerFactory::New(
                             cgroup_factory, kernel, eventfd_notifications),
@@ -84,6 +84,12 @@ class NamespaceHandlerFactory {
   // needs to be done once at machine bootup.
   virtual ::util::Status InitMachine(const InitSpec &spec) = 0;
 
+  // Starts and ends a sweep of Stats() over many containers. Handlers may
+  // share the work of reading their stats between the containers of a sweep.
+  // Calls must be paired, sweeps may overlap.
+  virtual void BeginStatsSweep() {}
+  virtual void EndStatsSweep() {}
+
  protected:
   NamespaceHandlerFactory() {}
 
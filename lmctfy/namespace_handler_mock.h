@@ -36,6 +36,8 @@ class MockNamespaceHandlerFactory : public NamespaceHandlerFactory {
                                            const ContainerSpec &spec,
                                            const MachineSpec &machine_spec));
   MOCK_METHOD1(InitMachine, ::util::Status(const InitSpec &spec));
+  MOCK_METHOD0(BeginStatsSweep, void());
+  MOCK_METHOD0(EndStatsSweep, void());
 };
 
 typedef ::testing::NiceMock<MockNamespaceHandlerFactory>
@@ -0,0 +1,38 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Shared between lmctfy and the release agent the kernel runs for cgroup v1
+// hierarchies when a cgroup with notify_on_release set becomes empty. The
+// agent forwards the path of the released cgroup, relative to the root of its
+// hierarchy, as a line written to every release agent FIFO. Each lmctfy
+// instance that registers release notifications reads from a FIFO of its own,
+// named kReleaseAgentFifo.<pid>.<id> after the reading process.
+
+#ifndef SRC_RELEASE_AGENT_RELEASE_AGENT_H_
+#define SRC_RELEASE_AGENT_RELEASE_AGENT_H_
+
+namespace containers {
+namespace lmctfy {
+
+// Directory of the release agent FIFO.
+static const char kReleaseAgentDir[] = "/run/lmctfy";
+
+// Prefix of the names of the release agent FIFOs in kReleaseAgentDir.
+static const char kReleaseAgentFifo[] = "release_agent";
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_RELEASE_AGENT_RELEASE_AGENT_H_
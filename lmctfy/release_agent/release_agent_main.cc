@@ -0,0 +1,86 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// release_agent_main.cc
+//
+// main() for the cgroup v1 release agent. The kernel runs it with the path of
+// the released cgroup as the only argument. The path is written to each release
+// agent FIFO in a single write so that lines of concurrent agents never
+// interleave. FIFOs nobody reads from are skipped, and removed if the process
+// they were created for is gone.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "lmctfy/release_agent/release_agent.h"
+
+using ::containers::lmctfy::kReleaseAgentDir;
+using ::containers::lmctfy::kReleaseAgentFifo;
+using ::std::string;
+
+// Writes line to the FIFO at path, whose name ends with pid_suffix (i.e.:
+// "<pid>.<id>"). Returns false iff the write failed.
+static bool WriteToFifo(const string &path, const char *pid_suffix,
+                        const string &line) {
+  // Opening fails with ENXIO when there is no reader.
+  const int fd = open(path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    const pid_t pid = atoi(pid_suffix);
+    if (errno == ENXIO && pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+      unlink(path.c_str());
+    }
+    return true;
+  }
+  const ssize_t written = write(fd, line.data(), line.size());
+  close(fd);
+  return written == static_cast<ssize_t>(line.size());
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    return 1;
+  }
+
+  const string line = string(argv[1]) + "\n";
+  if (line.size() > PIPE_BUF) {
+    return 1;
+  }
+
+  DIR *dir = opendir(kReleaseAgentDir);
+  if (dir == nullptr) {
+    return 0;
+  }
+  const string prefix = string(kReleaseAgentFifo) + ".";
+  bool ok = true;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (strncmp(entry->d_name, prefix.c_str(), prefix.size()) != 0) {
+      continue;
+    }
+    ok &= WriteToFifo(string(kReleaseAgentDir) + "/" + entry->d_name,
+                      entry->d_name + prefix.size(), line);
+  }
+  closedir(dir);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/resources/blockio_resource_handler.h"
+
+#include "util/errors.h"
+#include "util/task/codes.pb.h"
+
+using ::std::unique_ptr;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+StatusOr<BlockIoResourceHandlerFactory *>
+BlockIoResourceHandlerFactory::New(
+    CgroupFactory *cgroup_factory, const KernelApi *kernel,
+    EventFdNotifications *eventfd_notifications) {
+  // BlockIo hierarchy must be mounted.
+  if (!cgroup_factory->IsMounted(BlockIoControllerFactory::HierarchyType())) {
+    return Status(::util::error::NOT_FOUND,
+                  "BlockIo resource depends on the blockio cgroup hierarchy");
+  }
+
+  // Create blockio controller.
+  BlockIoControllerFactory *blockio_controller = new BlockIoControllerFactory(
+      cgroup_factory, kernel, eventfd_notifications);
+
+  return new BlockIoResourceHandlerFactory(blockio_controller, cgroup_factory,
+                                           kernel);
+}
+
+BlockIoResourceHandlerFactory::BlockIoResourceHandlerFactory(
+    const BlockIoControllerFactory *blockio_controller_factory,
+    CgroupFactory *cgroup_factory, const KernelApi *kernel)
+  : CgroupResourceHandlerFactory(RESOURCE_BLOCKIO, cgroup_factory, kernel),
+  blockio_controller_factory_(blockio_controller_factory) {}
+
+StatusOr<ResourceHandler *>
+BlockIoResourceHandlerFactory::GetResourceHandler(
+    const string &container_name) const {
+  BlockIoController *controller = RETURN_IF_ERROR(
+      blockio_controller_factory_->Get(container_name));
+  return new BlockIoResourceHandler(container_name, kernel_, controller);
+}
+
+StatusOr<ResourceHandler *>
+BlockIoResourceHandlerFactory::CreateResourceHandler(
+    const string &container_name, const ContainerSpec &spec) const {
+  BlockIoController *controller = RETURN_IF_ERROR(
+      blockio_controller_factory_->Create(container_name));
+
+  return new BlockIoResourceHandler(container_name, kernel_, controller);
+}
+
+BlockIoResourceHandler::BlockIoResourceHandler(
+    const string &container_name, const KernelApi *kernel,
+    BlockIoController *blockio_controller)
+  : CgroupResourceHandler(container_name, RESOURCE_BLOCKIO, kernel,
+                          {blockio_controller}),
+  blockio_controller_(blockio_controller) {}
+
+Status BlockIoResourceHandler::Stats(Container::StatsType type,
+                                     ContainerStats *output) const {
+  BlockIoStats *blockio_stats = output->mutable_blockio();
+
+  // The controller only reads the CFQ accounting for STATS_FULL.
+  SET_IF_PRESENT(blockio_controller_->GetStats(type),
+                 blockio_stats->MergeFrom);
+
+  // IO pressure, only available in the unified hierarchy.
+  SET_IF_PRESENT(blockio_controller_->GetPressure(),
+                 blockio_stats->mutable_pressure()->CopyFrom);
+  return Status::OK;
+}
+
+Status BlockIoResourceHandler::Spec(ContainerSpec *spec) const {
+  BlockIoSpec *blockio = spec->mutable_blockio();
+  BlockIoSpec::DeviceLimitSet *device_limit_set =
+      blockio->mutable_device_limit_set();
+  // Limits the kernel does not have are left out of the spec.
+  SET_IF_PRESENT(blockio_controller_->GetDeviceLimits(),
+                 device_limit_set->CopyFrom);
+  SET_IF_PRESENT(blockio_controller_->GetDefaultLimit(),
+                 device_limit_set->set_default_limit);
+  SET_IF_PRESENT(blockio_controller_->GetMaxLimit(),
+                 blockio->mutable_max_device_limit_set()->CopyFrom);
+  return Status::OK;
+}
+
+StatusOr<Container::NotificationId>
+BlockIoResourceHandler::RegisterNotification(
+    const EventSpec &spec, Callback1<Status> *callback) {
+  unique_ptr<Callback1<Status>> d(callback);
+
+  // IO pressure threshold event.
+  if (spec.has_pressure_threshold() &&
+      spec.pressure_threshold().resource() ==
+          EventSpec::PressureThreshold::IO) {
+    return blockio_controller_->RegisterPressureNotification(
+        spec.pressure_threshold(), d.release());
+  }
+
+  return Status(::util::error::NOT_FOUND,
+                "No supported notifications for BlockIo");
+}
+
+Status BlockIoResourceHandler::Update(const ContainerSpec &spec,
+                                      Container::UpdatePolicy policy) {
+  if (policy != Container::UPDATE_REPLACE) {
+    return CgroupResourceHandler::Update(spec, policy);
+  }
+
+  // The limits to reset are those set before the update.
+  ContainerSpec current_spec;
+  RETURN_IF_ERROR(Spec(&current_spec));
+  RETURN_IF_ERROR(CgroupResourceHandler::Update(spec, policy));
+  return ResetLimits(current_spec.blockio(), spec.blockio());
+}
+
+// Whether the limits have a limit for device.
+static bool HasDevice(
+    const ::google::protobuf::RepeatedPtrField<BlockIoSpec::DeviceLimit> &limits,
+    const BlockIoSpec::Device &device) {
+  for (const BlockIoSpec::DeviceLimit &limit : limits) {
+    if (limit.device().major() == device.major() &&
+        limit.device().minor() == device.minor()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Status BlockIoResourceHandler::ResetLimits(const BlockIoSpec &current,
+                                           const BlockIoSpec &spec) {
+  const BlockIoSpec::DeviceLimitSet &device_limit_set =
+      spec.device_limit_set();
+  if (current.device_limit_set().has_default_limit() &&
+      !device_limit_set.has_default_limit()) {
+    RETURN_IF_ERROR(blockio_controller_->ResetDefaultLimit());
+  }
+
+  BlockIoSpec::DeviceLimitSet stale_device_limits;
+  for (const BlockIoSpec::DeviceLimit &limit :
+       current.device_limit_set().device_limits()) {
+    if (!HasDevice(device_limit_set.device_limits(), limit.device())) {
+      *stale_device_limits.add_device_limits() = limit;
+    }
+  }
+  if (stale_device_limits.device_limits_size() != 0) {
+    RETURN_IF_ERROR(
+        blockio_controller_->ClearPerDeviceLimit(stale_device_limits));
+  }
+
+  BlockIoSpec::MaxLimitSet stale_max_limits;
+  for (const BlockIoSpec::MaxLimit &current_max_limit :
+       current.max_device_limit_set().max_limits()) {
+    // Devices of the current limit that no limit of the same type in the spec
+    // has.
+    BlockIoSpec::MaxLimit stale_max_limit;
+    stale_max_limit.set_op_type(current_max_limit.op_type());
+    stale_max_limit.set_limit_type(current_max_limit.limit_type());
+    for (const BlockIoSpec::DeviceLimit &limit : current_max_limit.limits()) {
+      bool in_spec = false;
+      for (const BlockIoSpec::MaxLimit &max_limit :
+           spec.max_device_limit_set().max_limits()) {
+        if (max_limit.op_type() == current_max_limit.op_type() &&
+            max_limit.limit_type() == current_max_limit.limit_type() &&
+            HasDevice(max_limit.limits(), limit.device())) {
+          in_spec = true;
+          break;
+        }
+      }
+      if (!in_spec) {
+        *stale_max_limit.add_limits() = limit;
+      }
+    }
+    if (stale_max_limit.limits_size() != 0) {
+      *stale_max_limits.add_max_limits() = stale_max_limit;
+    }
+  }
+  if (stale_max_limits.max_limits_size() != 0) {
+    RETURN_IF_ERROR(blockio_controller_->ClearMaxLimit(stale_max_limits));
+  }
+
+  return Status::OK;
+}
+
+Status BlockIoResourceHandler::DoUpdate(const ContainerSpec &spec) {
+  const BlockIoSpec &blockio = spec.blockio();
+  if (blockio.has_device_limit_set()) {
+    const BlockIoSpec::DeviceLimitSet &device_limit_set =
+        blockio.device_limit_set();
+    if (device_limit_set.has_default_limit()) {
+      RETURN_IF_ERROR(blockio_controller_->UpdateDefaultLimit(
+          device_limit_set.default_limit()));
+    }
+    if (device_limit_set.device_limits_size() != 0) {
+      RETURN_IF_ERROR(
+          blockio_controller_->UpdatePerDeviceLimit(device_limit_set));
+    }
+  }
+  if (blockio.has_max_device_limit_set()) {
+    RETURN_IF_ERROR(blockio_controller_->UpdateMaxLimit(
+        blockio.max_device_limit_set()));
+  }
+  return Status::OK;
+}
+
+void BlockIoResourceHandler::RecursiveFillDefaults(ContainerSpec *spec) const {
+  // There are no default settings. On UPDATE_REPLACE, Update() resets the
+  // limits that are not specified to those of the kernel.
+}
+
+Status BlockIoResourceHandler::VerifyFullSpec(const ContainerSpec &spec) const {
+  // Limits are validated by the controller when they are written.
+  return Status::OK;
+}
+
+}  // namespace lmctfy
+}  // namespace containers
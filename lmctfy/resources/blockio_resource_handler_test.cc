@@ -0,0 +1,456 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/resources/blockio_resource_handler.h"
+
+#include <memory>
+
+#include "base/callback.h"
+#include "system_api/kernel_api_mock.h"
+#include "lmctfy/controllers/blockio_controller_mock.h"
+#include "lmctfy/controllers/cgroup_factory_mock.h"
+#include "lmctfy/controllers/eventfd_notifications_mock.h"
+#include "util/errors_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::system_api::KernelAPIMock;
+using ::std::unique_ptr;
+#include "util/testing/equals_initialized_proto.h"
+using ::testing::EqualsInitializedProto;
+using ::testing::NotNull;
+using ::testing::Return;
+using ::testing::StrictMock;
+using ::testing::_;
+using ::util::Status;
+using ::util::StatusOr;
+using ::util::error::INVALID_ARGUMENT;
+using ::util::error::NOT_FOUND;
+
+namespace containers {
+namespace lmctfy {
+
+static const char kContainerName[] = "/test";
+
+class BlockIoResourceHandlerFactoryTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    mock_kernel_.reset(new StrictMock<KernelAPIMock>());
+    mock_controller_ = new StrictMockBlockIoController();
+    mock_cgroup_factory_.reset(new NiceMockCgroupFactory());
+    mock_controller_factory_ =
+        new StrictMockBlockIoControllerFactory(mock_cgroup_factory_.get());
+    factory_.reset(new BlockIoResourceHandlerFactory(
+        mock_controller_factory_, mock_cgroup_factory_.get(),
+        mock_kernel_.get()));
+  }
+
+  // Wrappers over private methods for testing.
+
+  StatusOr<ResourceHandler *> CallGetResourceHandler(
+      const string &container_name) {
+    return factory_->GetResourceHandler(container_name);
+  }
+
+  StatusOr<ResourceHandler *> CallCreateResourceHandler(
+      const string &container_name, const ContainerSpec &spec) {
+    return factory_->CreateResourceHandler(container_name, spec);
+  }
+
+ protected:
+  MockBlockIoController *mock_controller_;
+  MockBlockIoControllerFactory *mock_controller_factory_;
+  unique_ptr<MockCgroupFactory> mock_cgroup_factory_;
+  unique_ptr<KernelAPIMock> mock_kernel_;
+  unique_ptr<BlockIoResourceHandlerFactory> factory_;
+};
+
+// Tests for New().
+
+TEST_F(BlockIoResourceHandlerFactoryTest, NewSuccess) {
+  unique_ptr<MockEventFdNotifications> mock_notifications(
+      MockEventFdNotifications::NewStrict());
+
+  EXPECT_CALL(*mock_cgroup_factory_, IsMounted(CGROUP_BLOCKIO))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_cgroup_factory_, OwnsCgroup(_))
+      .WillRepeatedly(Return(true));
+
+  StatusOr<ResourceHandlerFactory *> statusor =
+      BlockIoResourceHandlerFactory::New(mock_cgroup_factory_.get(),
+                                         mock_kernel_.get(),
+                                         mock_notifications.get());
+  ASSERT_OK(statusor);
+  EXPECT_NE(nullptr, statusor.ValueOrDie());
+  delete statusor.ValueOrDie();
+  delete mock_controller_;
+}
+
+TEST_F(BlockIoResourceHandlerFactoryTest, NewNotMounted) {
+  unique_ptr<MockEventFdNotifications> mock_notifications(
+      MockEventFdNotifications::NewStrict());
+
+  EXPECT_CALL(*mock_cgroup_factory_, IsMounted(CGROUP_BLOCKIO))
+      .WillRepeatedly(Return(false));
+
+  StatusOr<ResourceHandlerFactory *> statusor =
+      BlockIoResourceHandlerFactory::New(mock_cgroup_factory_.get(),
+                                         mock_kernel_.get(),
+                                         mock_notifications.get());
+  EXPECT_ERROR_CODE(NOT_FOUND, statusor);
+  delete mock_controller_;
+}
+
+// Tests for Get().
+
+TEST_F(BlockIoResourceHandlerFactoryTest, GetSuccess) {
+  EXPECT_CALL(*mock_controller_factory_, Get(kContainerName))
+      .WillRepeatedly(Return(mock_controller_));
+
+  StatusOr<ResourceHandler *> statusor = CallGetResourceHandler(kContainerName);
+  ASSERT_OK(statusor);
+  unique_ptr<ResourceHandler> handler(statusor.ValueOrDie());
+  EXPECT_EQ(RESOURCE_BLOCKIO, handler->type());
+  EXPECT_EQ(kContainerName, handler->container_name());
+}
+
+TEST_F(BlockIoResourceHandlerFactoryTest, GetFails) {
+  EXPECT_CALL(*mock_controller_factory_, Get(kContainerName))
+      .WillRepeatedly(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED, CallGetResourceHandler(kContainerName).status());
+
+  // Mock controller was not used.
+  delete mock_controller_;
+}
+
+// Tests for Create().
+
+TEST_F(BlockIoResourceHandlerFactoryTest, CreateSuccess) {
+  ContainerSpec spec;
+
+  EXPECT_CALL(*mock_controller_factory_, Create(kContainerName))
+      .WillRepeatedly(Return(mock_controller_));
+
+  StatusOr<ResourceHandler *> statusor =
+      CallCreateResourceHandler(kContainerName, spec);
+  ASSERT_OK(statusor);
+  unique_ptr<ResourceHandler> handler(statusor.ValueOrDie());
+  EXPECT_EQ(RESOURCE_BLOCKIO, handler->type());
+  EXPECT_EQ(kContainerName, handler->container_name());
+}
+
+TEST_F(BlockIoResourceHandlerFactoryTest, CreateFails) {
+  ContainerSpec spec;
+
+  EXPECT_CALL(*mock_controller_factory_, Create(kContainerName))
+      .WillRepeatedly(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED,
+            CallCreateResourceHandler(kContainerName, spec).status());
+
+  // Mock controller was not used.
+  delete mock_controller_;
+}
+
+class BlockIoResourceHandlerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    mock_kernel_.reset(new StrictMock<KernelAPIMock>());
+    mock_blockio_controller_ = new StrictMockBlockIoController();
+    handler_.reset(new BlockIoResourceHandler(
+        kContainerName, mock_kernel_.get(), mock_blockio_controller_));
+
+    BlockIoStats::DeviceStats *device = device_stats_.add_devices();
+    device->mutable_device()->set_major(8);
+    device->mutable_device()->set_minor(0);
+    device->mutable_throttle_io_service_bytes()->set_read(4096);
+
+    BlockIoSpec::DeviceLimit *limit = device_limits_.add_device_limits();
+    limit->mutable_device()->set_major(8);
+    limit->mutable_device()->set_minor(0);
+    limit->set_limit(50);
+
+    BlockIoSpec::MaxLimit *max_limit = max_limits_.add_max_limits();
+    max_limit->set_op_type(BlockIoSpec::READ);
+    max_limit->set_limit_type(BlockIoSpec::BYTES_PER_SECOND);
+    *max_limit->add_limits() = *limit;
+  }
+
+  MockBlockIoController *mock_blockio_controller_;
+  unique_ptr<KernelAPIMock> mock_kernel_;
+  unique_ptr<BlockIoResourceHandler> handler_;
+  BlockIoStats device_stats_;
+  BlockIoSpec::DeviceLimitSet device_limits_;
+  BlockIoSpec::MaxLimitSet max_limits_;
+};
+
+TEST_F(BlockIoResourceHandlerTest, StatsSuccess) {
+  PressureData pressure;
+  pressure.mutable_some()->set_total(42);
+
+  for (Container::StatsType type :
+       {Container::STATS_SUMMARY, Container::STATS_FULL}) {
+    EXPECT_CALL(*mock_blockio_controller_, GetStats(type))
+        .WillOnce(Return(device_stats_));
+    EXPECT_CALL(*mock_blockio_controller_, GetPressure())
+        .WillOnce(Return(pressure));
+
+    ContainerStats stats;
+    ASSERT_OK(handler_->Stats(type, &stats));
+    EXPECT_EQ(1, stats.blockio().devices_size());
+    EXPECT_THAT(stats.blockio().devices(0),
+                EqualsInitializedProto(device_stats_.devices(0)));
+    EXPECT_EQ(42, stats.blockio().pressure().some().total());
+  }
+}
+
+TEST_F(BlockIoResourceHandlerTest, StatsNotFound) {
+  EXPECT_CALL(*mock_blockio_controller_, GetStats(Container::STATS_FULL))
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_blockio_controller_, GetPressure())
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+
+  ContainerStats stats;
+  ASSERT_OK(handler_->Stats(Container::STATS_FULL, &stats));
+  EXPECT_EQ(0, stats.blockio().devices_size());
+  EXPECT_FALSE(stats.blockio().has_pressure());
+}
+
+TEST_F(BlockIoResourceHandlerTest, StatsFails) {
+  EXPECT_CALL(*mock_blockio_controller_, GetStats(Container::STATS_FULL))
+      .WillOnce(Return(Status::CANCELLED));
+
+  ContainerStats stats;
+  EXPECT_EQ(Status::CANCELLED,
+            handler_->Stats(Container::STATS_FULL, &stats));
+}
+
+TEST_F(BlockIoResourceHandlerTest, SpecSuccess) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillOnce(Return(device_limits_));
+  EXPECT_CALL(*mock_blockio_controller_, GetDefaultLimit())
+      .WillOnce(Return(20));
+  EXPECT_CALL(*mock_blockio_controller_, GetMaxLimit())
+      .WillOnce(Return(max_limits_));
+
+  ContainerSpec spec;
+  ASSERT_OK(handler_->Spec(&spec));
+  BlockIoSpec::DeviceLimitSet expected_limits = device_limits_;
+  expected_limits.set_default_limit(20);
+  EXPECT_THAT(spec.blockio().device_limit_set(),
+              EqualsInitializedProto(expected_limits));
+  EXPECT_THAT(spec.blockio().max_device_limit_set(),
+              EqualsInitializedProto(max_limits_));
+}
+
+TEST_F(BlockIoResourceHandlerTest, SpecNotFound) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_blockio_controller_, GetDefaultLimit())
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_blockio_controller_, GetMaxLimit())
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+
+  ContainerSpec spec;
+  ASSERT_OK(handler_->Spec(&spec));
+  EXPECT_FALSE(spec.blockio().device_limit_set().has_default_limit());
+  EXPECT_EQ(0, spec.blockio().device_limit_set().device_limits_size());
+  EXPECT_EQ(0, spec.blockio().max_device_limit_set().max_limits_size());
+}
+
+TEST_F(BlockIoResourceHandlerTest, SpecDefaultLimitNotFound) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillOnce(Return(device_limits_));
+  EXPECT_CALL(*mock_blockio_controller_, GetDefaultLimit())
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_blockio_controller_, GetMaxLimit())
+      .WillOnce(Return(max_limits_));
+
+  ContainerSpec spec;
+  ASSERT_OK(handler_->Spec(&spec));
+  EXPECT_THAT(spec.blockio().device_limit_set(),
+              EqualsInitializedProto(device_limits_));
+  EXPECT_THAT(spec.blockio().max_device_limit_set(),
+              EqualsInitializedProto(max_limits_));
+}
+
+TEST_F(BlockIoResourceHandlerTest, SpecFails) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillOnce(Return(Status::CANCELLED));
+
+  ContainerSpec spec;
+  EXPECT_EQ(Status::CANCELLED, handler_->Spec(&spec));
+}
+
+TEST_F(BlockIoResourceHandlerTest, DoUpdate) {
+  ContainerSpec spec;
+  BlockIoSpec::DeviceLimitSet *device_limit_set =
+      spec.mutable_blockio()->mutable_device_limit_set();
+  *device_limit_set = device_limits_;
+  device_limit_set->set_default_limit(20);
+  *spec.mutable_blockio()->mutable_max_device_limit_set() = max_limits_;
+
+  EXPECT_CALL(*mock_blockio_controller_, UpdateDefaultLimit(20))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_blockio_controller_,
+              UpdatePerDeviceLimit(EqualsInitializedProto(*device_limit_set)))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_blockio_controller_,
+              UpdateMaxLimit(EqualsInitializedProto(max_limits_)))
+      .WillOnce(Return(Status::OK));
+  ASSERT_OK(handler_->DoUpdate(spec));
+}
+
+TEST_F(BlockIoResourceHandlerTest, DoUpdateEmptySuccess) {
+  ContainerSpec spec;
+  spec.mutable_blockio();
+  ASSERT_OK(handler_->DoUpdate(spec));
+}
+
+TEST_F(BlockIoResourceHandlerTest, DoUpdateFails) {
+  ContainerSpec spec;
+  spec.mutable_blockio()->mutable_device_limit_set()->set_default_limit(200);
+
+  EXPECT_CALL(*mock_blockio_controller_, UpdateDefaultLimit(200))
+      .WillOnce(Return(Status(INVALID_ARGUMENT, "")));
+  EXPECT_ERROR_CODE(INVALID_ARGUMENT, handler_->DoUpdate(spec));
+}
+
+TEST_F(BlockIoResourceHandlerTest, UpdateReplaceResetsLimits) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillRepeatedly(Return(device_limits_));
+  EXPECT_CALL(*mock_blockio_controller_, GetDefaultLimit())
+      .WillRepeatedly(Return(20));
+  EXPECT_CALL(*mock_blockio_controller_, GetMaxLimit())
+      .WillRepeatedly(Return(max_limits_));
+
+  // Only sets a limit for another device.
+  ContainerSpec spec;
+  BlockIoSpec::DeviceLimitSet *device_limit_set =
+      spec.mutable_blockio()->mutable_device_limit_set();
+  BlockIoSpec::DeviceLimit *limit = device_limit_set->add_device_limits();
+  limit->mutable_device()->set_major(8);
+  limit->mutable_device()->set_minor(16);
+  limit->set_limit(30);
+
+  EXPECT_CALL(*mock_blockio_controller_,
+              UpdatePerDeviceLimit(EqualsInitializedProto(*device_limit_set)))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_blockio_controller_, ResetDefaultLimit())
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_blockio_controller_,
+              ClearPerDeviceLimit(EqualsInitializedProto(device_limits_)))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_blockio_controller_,
+              ClearMaxLimit(EqualsInitializedProto(max_limits_)))
+      .WillOnce(Return(Status::OK));
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_REPLACE));
+}
+
+TEST_F(BlockIoResourceHandlerTest, UpdateReplaceKeepsLimitsInSpec) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillRepeatedly(Return(device_limits_));
+  EXPECT_CALL(*mock_blockio_controller_, GetDefaultLimit())
+      .WillRepeatedly(Return(20));
+  EXPECT_CALL(*mock_blockio_controller_, GetMaxLimit())
+      .WillRepeatedly(Return(max_limits_));
+
+  ContainerSpec spec;
+  BlockIoSpec::DeviceLimitSet *device_limit_set =
+      spec.mutable_blockio()->mutable_device_limit_set();
+  *device_limit_set = device_limits_;
+  device_limit_set->set_default_limit(30);
+  *spec.mutable_blockio()->mutable_max_device_limit_set() = max_limits_;
+
+  EXPECT_CALL(*mock_blockio_controller_, UpdateDefaultLimit(30))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_blockio_controller_,
+              UpdatePerDeviceLimit(EqualsInitializedProto(*device_limit_set)))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_blockio_controller_,
+              UpdateMaxLimit(EqualsInitializedProto(max_limits_)))
+      .WillOnce(Return(Status::OK));
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_REPLACE));
+}
+
+TEST_F(BlockIoResourceHandlerTest, UpdateReplaceResetFails) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_blockio_controller_, GetDefaultLimit())
+      .WillRepeatedly(Return(20));
+  EXPECT_CALL(*mock_blockio_controller_, GetMaxLimit())
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(*mock_blockio_controller_, ResetDefaultLimit())
+      .WillOnce(Return(Status::CANCELLED));
+
+  ContainerSpec spec;
+  spec.mutable_blockio();
+  EXPECT_EQ(Status::CANCELLED,
+            handler_->Update(spec, Container::UPDATE_REPLACE));
+}
+
+TEST_F(BlockIoResourceHandlerTest, UpdateDiffKeepsLimits) {
+  EXPECT_CALL(*mock_blockio_controller_, GetDeviceLimits())
+      .WillRepeatedly(Return(device_limits_));
+  EXPECT_CALL(*mock_blockio_controller_, GetDefaultLimit())
+      .WillRepeatedly(Return(20));
+  EXPECT_CALL(*mock_blockio_controller_, GetMaxLimit())
+      .WillRepeatedly(Return(max_limits_));
+
+  ContainerSpec spec;
+  spec.mutable_blockio();
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_DIFF));
+}
+
+void DoNothingTakeStatus(Status) {}
+
+TEST_F(BlockIoResourceHandlerTest, RegisterPressureNotification) {
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::IO);
+
+  // RegisterPressureNotification takes ownership, but we're mocking it out.
+  unique_ptr<Callback1<Status>> cb(NewPermanentCallback(&DoNothingTakeStatus));
+
+  EXPECT_CALL(*mock_blockio_controller_,
+              RegisterPressureNotification(
+                  EqualsInitializedProto(spec.pressure_threshold()),
+                  NotNull()))
+      .WillOnce(Return(1));
+
+  StatusOr<Container::NotificationId> statusor =
+      handler_->RegisterNotification(spec, cb.get());
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
+TEST_F(BlockIoResourceHandlerTest, RegisterNotificationNotSupported) {
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::CPU);
+
+  EXPECT_ERROR_CODE(
+      NOT_FOUND,
+      handler_->RegisterNotification(
+          spec, NewPermanentCallback(&DoNothingTakeStatus)));
+}
+
+TEST_F(BlockIoResourceHandlerTest, VerifyFullSpecOk) {
+  ContainerSpec spec;
+  ASSERT_OK(handler_->VerifyFullSpec(spec));
+}
+
+}  // namespace lmctfy
+}  // namespace containers
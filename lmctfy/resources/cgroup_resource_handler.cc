@@ -24,6 +24,7 @@ using ::std::string;
 #include "file/base/path.h"
 #include "lmctfy/controllers/cgroup_controller.h"
 #include "lmctfy/controllers/cgroup_factory.h"
+#include "lmctfy/controllers/cgroup_write_batch.h"
 #include "util/errors.h"
 #include "strings/strcat.h"
 #include "strings/substitute.h"
@@ -63,11 +64,14 @@ StatusOr<ResourceHandler *> CgroupResourceHandlerFactory::Create(
   // Run the create action before applying the update.
   RETURN_IF_ERROR(handler->CreateResource(spec));
 
-  // Prepare the container by doing a replace update.
+  // Prepare the container by doing a replace update. Its writes are batched
+  // so that files already at their value are not written.
+  CgroupWriteBatch batch(kernel_);
   Status status = handler->Update(spec, Container::UPDATE_REPLACE);
   if (!status.ok()) {
     return status;
   }
+  RETURN_IF_ERROR(batch.Commit());
 
   return handler.release();
 }
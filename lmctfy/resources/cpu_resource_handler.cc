@@ -448,6 +448,10 @@ Status CpuResourceHandler::Stats(Container::StatsType type,
                    set_per_cpu);
   }
 
+  // Cpu pressure, only available in the unified hierarchy.
+  SET_IF_PRESENT(cpu_controller_->GetPressure(),
+                 cpu_stats->mutable_pressure()->CopyFrom);
+
   // Stats below this check are only returned for STATS_FULL.
   if (type == Container::STATS_SUMMARY) {
     return Status::OK;
@@ -515,9 +519,17 @@ Status CpuResourceHandler::Spec(ContainerSpec *spec) const {
 
 StatusOr<Container::NotificationId> CpuResourceHandler::RegisterNotification(
     const EventSpec &spec, Callback1<Status> *callback) {
-  // TODO(jnagal): Evaluate if we need kernel notifications for cpu.
-  // Most of the notifications can be handled in userspace.
   unique_ptr<Callback1<Status>> d(callback);
+
+  // CPU pressure threshold event. Other notifications can be handled in
+  // userspace.
+  if (spec.has_pressure_threshold() &&
+      spec.pressure_threshold().resource() ==
+          EventSpec::PressureThreshold::CPU) {
+    return cpu_controller_->RegisterPressureNotification(
+        spec.pressure_threshold(), d.release());
+  }
+
   return Status(::util::error::NOT_FOUND, "No supported notifications for CPU");
 }
 }  // namespace lmctfy
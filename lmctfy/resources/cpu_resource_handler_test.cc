@@ -47,6 +47,7 @@ using ::testing::Eq;
 using ::testing::EqualsInitializedProto;
 using ::testing::Invoke;
 using ::testing::NiceMock;
+using ::testing::NotNull;
 using ::testing::Pointwise;
 using ::testing::Return;
 using ::testing::StrictMock;
@@ -1377,6 +1378,13 @@ class CpuStatsTest : public CpuResourceHandlerTest {
     EXPECT_CALL(*mock_cpu_controller_, GetNumRunnable())
         .WillRepeatedly(Return(expected_load_));
     expected_stats_.set_load(expected_load_);
+
+    PressureData pressure;
+    pressure.mutable_some()->set_avg10(1.5);
+    pressure.mutable_some()->set_total(4200);
+    EXPECT_CALL(*mock_cpu_controller_, GetPressure())
+        .WillRepeatedly(Return(pressure));
+    expected_stats_.mutable_pressure()->CopyFrom(pressure);
   }
 
   void ExpectFullGets() {
@@ -1499,6 +1507,28 @@ TEST_F(CpuStatsTest, StatsThrottlingFails) {
   EXPECT_EQ(Status::CANCELLED, handler_->Stats(type, &stats));
 }
 
+TEST_F(CpuStatsTest, StatsPressureFails) {
+  Container::StatsType type = Container::STATS_SUMMARY;
+  ExpectSummaryGets();
+  EXPECT_CALL(*mock_cpu_controller_, GetPressure())
+      .WillRepeatedly(Return(Status::CANCELLED));
+
+  ContainerStats stats;
+  EXPECT_EQ(Status::CANCELLED, handler_->Stats(type, &stats));
+}
+
+TEST_F(CpuStatsTest, StatsPressureNotFound) {
+  Container::StatsType type = Container::STATS_FULL;
+  ExpectFullGets();
+  EXPECT_CALL(*mock_cpu_controller_, GetPressure())
+      .WillRepeatedly(Return(Status(NOT_FOUND, "")));
+  expected_stats_.clear_pressure();
+
+  ContainerStats stats;
+  EXPECT_OK(handler_->Stats(type, &stats));
+  EXPECT_THAT(stats.cpu(), EqualsInitializedProto(expected_stats_));
+}
+
 TEST_F(CpuStatsTest, StatsUsageNotFound) {
   Container::StatsType type = Container::STATS_FULL;
   ExpectFullGets();
@@ -1765,6 +1795,43 @@ TEST_F(CpuResourceHandlerTest, NotificationsUnimplemented) {
   EXPECT_EQ(NOT_FOUND, statusor.status().error_code());
 }
 
+// Dummy callback used for testing.
+void NoOpCallback(Status status) {
+  EXPECT_TRUE(false) << "Should never be called";
+}
+
+TEST_F(CpuResourceHandlerTest, RegisterNotificationPressureSuccess) {
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::CPU);
+  spec.mutable_pressure_threshold()->set_threshold(100000);
+  spec.mutable_pressure_threshold()->set_window(1000000);
+
+  // RegisterPressureNotification takes ownership, but we're mocking it out.
+  unique_ptr<Callback1<Status>> cb(NewPermanentCallback(&NoOpCallback));
+
+  EXPECT_CALL(*mock_cpu_controller_,
+              RegisterPressureNotification(
+                  EqualsInitializedProto(spec.pressure_threshold()),
+                  NotNull()))
+      .WillOnce(Return(1));
+
+  StatusOr<Container::NotificationId> statusor =
+      handler_->RegisterNotification(spec, cb.get());
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
+TEST_F(CpuResourceHandlerTest, RegisterNotificationPressureOtherResource) {
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::MEMORY);
+
+  EXPECT_ERROR_CODE(NOT_FOUND,
+                    handler_->RegisterNotification(
+                        spec, NewPermanentCallback(&NoOpCallback)));
+}
+
 class CpuResourceHandlerSpecTest : public CpuResourceHandlerTest {
  public:
   virtual void SetUp() {
@@ -0,0 +1,156 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/resources/link_stats_reader.h"
+
+#include <time.h>
+#include <vector>
+
+#include "base/hash.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "util/errors.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+using ::containers::nscon::RtNetlink;
+using ::containers::nscon::RtNetlinkFactory;
+using ::std::vector;
+using ::strings::Substitute;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+// Prefix of the alias of the links tagged with the name of a container.
+static const char kAliasPrefix[] = "lmctfy:";
+
+// Maximum length of a link alias, IFALIASZ without its terminating NUL. The
+// kernel rejects longer aliases.
+static const size_t kMaxAliasLength = 255;
+
+static const int64 kNanosPerSecond = 1000000000;
+
+// Age after which the dump of the sweeps in progress is not used anymore.
+static const int64 kMaxDumpAgeNs = kNanosPerSecond;
+
+// Gets the alias of the link tagged with the name of the container. Aliases
+// that would be too long keep the beginning of the name and end with a
+// fingerprint of the whole name, e.g.: "lmctfy:/a/very/long/na#0123456789abcdef"
+static string AliasOf(const string &container_name) {
+  const string alias = kAliasPrefix + container_name;
+  if (alias.size() <= kMaxAliasLength) {
+    return alias;
+  }
+  const string suffix = StringPrintf(
+      "#%016llx", static_cast<unsigned long long>(Fingerprint(  // NOLINT
+                      container_name.data(), container_name.size())));
+  return alias.substr(0, kMaxAliasLength - suffix.size()) + suffix;
+}
+
+LinkStatsReader::LinkStatsReader(const RtNetlinkFactory *rtnetlink_factory)
+    : rtnetlink_factory_(CHECK_NOTNULL(rtnetlink_factory)),
+      sweeps_(0),
+      have_dump_(false),
+      dump_time_ns_(0) {}
+
+Status LinkStatsReader::TagLink(const string &interface,
+                                const string &container_name) {
+  MutexLock l(&lock_);
+  RtNetlink *rtnetlink = RETURN_IF_ERROR(GetRtNetlink());
+  rtnetlink->SetAlias(interface, AliasOf(container_name));
+  return rtnetlink->Commit();
+}
+
+StatusOr<NetworkStats> LinkStatsReader::GetStats(
+    const string &container_name) {
+  const int64 now = NowNs();
+
+  MutexLock l(&lock_);
+  if (!have_dump_ || now - dump_time_ns_ > kMaxDumpAgeNs) {
+    RETURN_IF_ERROR(DumpLinks());
+    dump_time_ns_ = now;
+
+    // Only keep the dump for the sweep.
+    have_dump_ = sweeps_ > 0;
+  }
+
+  auto it = stats_.find(AliasOf(container_name));
+  if (it == stats_.end()) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("No network link tagged for container \"$0\"",
+                             container_name));
+  }
+  return it->second;
+}
+
+void LinkStatsReader::BeginSweep() {
+  MutexLock l(&lock_);
+  ++sweeps_;
+}
+
+void LinkStatsReader::EndSweep() {
+  MutexLock l(&lock_);
+  CHECK_GT(sweeps_, 0);
+  if (--sweeps_ == 0) {
+    have_dump_ = false;
+    stats_.clear();
+  }
+}
+
+Status LinkStatsReader::DumpLinks() {
+  RtNetlink *rtnetlink = RETURN_IF_ERROR(GetRtNetlink());
+  StatusOr<vector<RtNetlink::Link>> statusor = rtnetlink->GetLinks();
+  if (!statusor.ok()) {
+    rtnetlink_.reset();
+    return statusor.status();
+  }
+
+  stats_.clear();
+  const string prefix(kAliasPrefix);
+  for (const RtNetlink::Link &link : statusor.ValueOrDie()) {
+    if (link.alias.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+
+    // The host side link transmits what the Virtual Host receives.
+    NetworkStats *stats = &stats_[link.alias];
+    stats->set_rx_bytes(link.tx_bytes);
+    stats->set_rx_packets(link.tx_packets);
+    stats->set_rx_errors(link.tx_errors);
+    stats->set_rx_dropped(link.tx_dropped);
+    stats->set_tx_bytes(link.rx_bytes);
+    stats->set_tx_packets(link.rx_packets);
+    stats->set_tx_errors(link.rx_errors);
+    stats->set_tx_dropped(link.rx_dropped);
+  }
+  return Status::OK;
+}
+
+int64 LinkStatsReader::NowNs() const {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * kNanosPerSecond + now.tv_nsec;
+}
+
+StatusOr<RtNetlink *> LinkStatsReader::GetRtNetlink() {
+  if (rtnetlink_ == nullptr) {
+    rtnetlink_.reset(RETURN_IF_ERROR(rtnetlink_factory_->Create()));
+  }
+  return rtnetlink_.get();
+}
+
+}  // namespace lmctfy
+}  // namespace containers
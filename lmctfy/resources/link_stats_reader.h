@@ -0,0 +1,123 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_RESOURCES_LINK_STATS_READER_H_
+#define SRC_RESOURCES_LINK_STATS_READER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+using ::std::string;
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "nscon/configurator/rtnetlink.h"
+#include "include/lmctfy.pb.h"
+#include "util/task/status.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace lmctfy {
+
+// Reads the network counters of Virtual Hosts from the host side of their veth
+// pair.
+//
+// The host side link of a Virtual Host is tagged with the name of the container
+// in its alias when the Virtual Host is created. Names too long for an alias are
+// truncated and made unique with a fingerprint. The counters of all the links
+// are then read with a single RTM_GETLINK dump over a persistent rtnetlink
+// socket, without entering the network namespace of any container.
+//
+// Between BeginSweep() and EndSweep() a single dump serves the GetStats() of
+// all containers, so that stats of many containers cost one dump. Outside of a
+// sweep every GetStats() dumps the links. Sweeps may overlap, the dump is kept
+// until the last one ends or until it is older than a second. Overlapping
+// sweeps thus never serve a dump older than that.
+//
+// Class is thread-safe.
+class LinkStatsReader {
+ public:
+  // Takes ownership of rtnetlink_factory.
+  explicit LinkStatsReader(
+      const nscon::RtNetlinkFactory *rtnetlink_factory);
+  virtual ~LinkStatsReader() {}
+
+  // Tags the host side link of the Virtual Host so that GetStats() finds it.
+  //
+  // Arguments:
+  //   interface: Name of the host side link. e.g.: "veth12345"
+  //   container_name: Absolute name of the Virtual Host.
+  // Return:
+  //   Status: Status of the operation.
+  ::util::Status TagLink(const string &interface,
+                         const string &container_name) LOCKS_EXCLUDED(lock_);
+
+  // Gets the network counters of the Virtual Host. They are from the point of
+  // view of the Virtual Host: what the host side link transmits is received by
+  // the Virtual Host.
+  //
+  // Arguments:
+  //   container_name: Absolute name of the Virtual Host.
+  // Return:
+  //   StatusOr<NetworkStats>: Status of the operation. Iff OK, the counters.
+  //       NOT_FOUND if the Virtual Host has no tagged link.
+  ::util::StatusOr<NetworkStats> GetStats(const string &container_name)
+      LOCKS_EXCLUDED(lock_);
+
+  // Starts and ends a sweep of GetStats() calls that share a dump.
+  void BeginSweep() LOCKS_EXCLUDED(lock_);
+  void EndSweep() LOCKS_EXCLUDED(lock_);
+
+ protected:
+  // Gets the current time in nanoseconds. Virtual for testing.
+  virtual int64 NowNs() const;
+
+ private:
+  // Dumps the links into stats_.
+  ::util::Status DumpLinks() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Gets the persistent rtnetlink socket, opening it if needed.
+  ::util::StatusOr<nscon::RtNetlink *> GetRtNetlink()
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const ::std::unique_ptr<const nscon::RtNetlinkFactory> rtnetlink_factory_;
+
+  // Persistent rtnetlink socket. Dropped when a dump fails so that the next
+  // one starts on a clean socket.
+  ::std::unique_ptr<nscon::RtNetlink> rtnetlink_ GUARDED_BY(lock_);
+
+  // Number of sweeps in progress.
+  int sweeps_ GUARDED_BY(lock_);
+
+  // Whether stats_ holds the dump of the sweeps in progress.
+  bool have_dump_ GUARDED_BY(lock_);
+
+  // Time of the dump in stats_, in nanoseconds.
+  int64 dump_time_ns_ GUARDED_BY(lock_);
+
+  // Map of the alias of the tagged links to their counters, from the last
+  // dump.
+  ::std::map<string, NetworkStats> stats_ GUARDED_BY(lock_);
+
+  Mutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(LinkStatsReader);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_RESOURCES_LINK_STATS_READER_H_
@@ -0,0 +1,276 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/resources/link_stats_reader.h"
+
+#include <memory>
+#include <vector>
+
+#include "nscon/configurator/rtnetlink_mock.h"
+#include "util/errors_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+
+using ::containers::nscon::MockRtNetlink;
+using ::containers::nscon::MockRtNetlinkFactory;
+using ::containers::nscon::RtNetlink;
+using ::containers::nscon::RtNetlinkFactory;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::testing::Ne;
+using ::testing::Return;
+using ::testing::SaveArg;
+using ::testing::StrictMock;
+using ::testing::_;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+static const char kContainerName[] = "/test";
+
+// Returns a link named name with alias whose counters are all value.
+static RtNetlink::Link MakeLink(const string &name, const string &alias,
+                                uint64 value) {
+  RtNetlink::Link link;
+  link.name = name;
+  link.alias = alias;
+  link.rx_bytes = value;
+  link.rx_packets = value + 1;
+  link.rx_errors = value + 2;
+  link.rx_dropped = value + 3;
+  link.tx_bytes = value + 4;
+  link.tx_packets = value + 5;
+  link.tx_errors = value + 6;
+  link.tx_dropped = value + 7;
+  return link;
+}
+
+// LinkStatsReader whose clock only moves when told to.
+class TestLinkStatsReader : public LinkStatsReader {
+ public:
+  explicit TestLinkStatsReader(const RtNetlinkFactory *rtnetlink_factory)
+      : LinkStatsReader(rtnetlink_factory), now_(0) {}
+
+  void AdvanceNs(int64 ns) { now_ += ns; }
+
+ protected:
+  int64 NowNs() const override { return now_; }
+
+ private:
+  int64 now_;
+};
+
+class LinkStatsReaderTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    mock_rtnetlink_factory_ = new StrictMock<MockRtNetlinkFactory>();
+    mock_rtnetlink_ = new StrictMock<MockRtNetlink>();
+    reader_.reset(new TestLinkStatsReader(mock_rtnetlink_factory_));
+  }
+
+  void TearDown() override {
+    // The reader owns the rtnetlink once it is created.
+    if (!created_) {
+      delete mock_rtnetlink_;
+    }
+  }
+
+  // Expects the persistent socket to be created once.
+  void ExpectCreate() {
+    EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+        .WillOnce(Return(mock_rtnetlink_));
+    created_ = true;
+  }
+
+ protected:
+  MockRtNetlinkFactory *mock_rtnetlink_factory_;
+  MockRtNetlink *mock_rtnetlink_;
+  unique_ptr<TestLinkStatsReader> reader_;
+  bool created_ = false;
+};
+
+TEST_F(LinkStatsReaderTest, TagLink) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, SetAlias("veth0", "lmctfy:/test"));
+  EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+
+  EXPECT_OK(reader_->TagLink("veth0", kContainerName));
+}
+
+TEST_F(LinkStatsReaderTest, TagLinkLongName) {
+  const string long_name = "/" + string(300, 'a');
+  string alias;
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, SetAlias("veth0", _))
+      .WillOnce(SaveArg<1>(&alias));
+  EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+  EXPECT_OK(reader_->TagLink("veth0", long_name));
+
+  // The alias fits in IFALIASZ and is different for another long name.
+  EXPECT_EQ(255, alias.size());
+  EXPECT_EQ(0, alias.find("lmctfy:/aaaa"));
+  EXPECT_CALL(*mock_rtnetlink_, SetAlias("veth1", Ne(alias)));
+  EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+  EXPECT_OK(reader_->TagLink("veth1", long_name + "b"));
+
+  // The stats of the container are found on its link.
+  EXPECT_CALL(*mock_rtnetlink_, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{MakeLink("veth0", alias, 20)}));
+  StatusOr<NetworkStats> statusor = reader_->GetStats(long_name);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(20, statusor.ValueOrDie().tx_bytes());
+}
+
+TEST_F(LinkStatsReaderTest, TagLinkFails) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, SetAlias("veth0", "lmctfy:/test"));
+  EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    reader_->TagLink("veth0", kContainerName));
+}
+
+TEST_F(LinkStatsReaderTest, CreateFails) {
+  EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    reader_->GetStats(kContainerName));
+}
+
+TEST_F(LinkStatsReaderTest, GetStats) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("lo", "", 10), MakeLink("veth0", "lmctfy:/test", 20),
+          MakeLink("veth1", "lmctfy:/other", 30),
+          MakeLink("eth0", "uplink", 40)}));
+
+  StatusOr<NetworkStats> statusor = reader_->GetStats(kContainerName);
+  ASSERT_OK(statusor);
+  const NetworkStats &stats = statusor.ValueOrDie();
+
+  // Counters are from the point of view of the Virtual Host.
+  EXPECT_EQ(24, stats.rx_bytes());
+  EXPECT_EQ(25, stats.rx_packets());
+  EXPECT_EQ(26, stats.rx_errors());
+  EXPECT_EQ(27, stats.rx_dropped());
+  EXPECT_EQ(20, stats.tx_bytes());
+  EXPECT_EQ(21, stats.tx_packets());
+  EXPECT_EQ(22, stats.tx_errors());
+  EXPECT_EQ(23, stats.tx_dropped());
+}
+
+TEST_F(LinkStatsReaderTest, GetStatsNotTagged) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{MakeLink("lo", "", 10)}));
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    reader_->GetStats(kContainerName));
+}
+
+TEST_F(LinkStatsReaderTest, GetStatsDumpsEveryCallOutsideSweep) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("veth0", "lmctfy:/test", 20)}))
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("veth0", "lmctfy:/test", 50)}));
+
+  StatusOr<NetworkStats> statusor = reader_->GetStats(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(20, statusor.ValueOrDie().tx_bytes());
+  statusor = reader_->GetStats(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(50, statusor.ValueOrDie().tx_bytes());
+}
+
+TEST_F(LinkStatsReaderTest, GetStatsSharesDumpInSweep) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("veth0", "lmctfy:/test", 20),
+          MakeLink("veth1", "lmctfy:/other", 30)}))
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("veth0", "lmctfy:/test", 50)}));
+
+  // Overlapping sweeps share the dump until the last one ends.
+  reader_->BeginSweep();
+  reader_->BeginSweep();
+  EXPECT_OK(reader_->GetStats(kContainerName));
+  reader_->EndSweep();
+  StatusOr<NetworkStats> statusor = reader_->GetStats("/other");
+  ASSERT_OK(statusor);
+  EXPECT_EQ(30, statusor.ValueOrDie().tx_bytes());
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, reader_->GetStats("/missing"));
+  reader_->EndSweep();
+
+  reader_->BeginSweep();
+  statusor = reader_->GetStats(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(50, statusor.ValueOrDie().tx_bytes());
+  reader_->EndSweep();
+}
+
+TEST_F(LinkStatsReaderTest, GetStatsRedumpsStaleDumpInSweep) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("veth0", "lmctfy:/test", 20)}))
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("veth0", "lmctfy:/test", 50)}));
+
+  // Sweeps that keep overlapping do not keep the dump forever.
+  reader_->BeginSweep();
+  EXPECT_OK(reader_->GetStats(kContainerName));
+  reader_->BeginSweep();
+  reader_->EndSweep();
+  reader_->AdvanceNs(1000000000);
+  StatusOr<NetworkStats> statusor = reader_->GetStats(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(20, statusor.ValueOrDie().tx_bytes());
+
+  reader_->AdvanceNs(1);
+  statusor = reader_->GetStats(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(50, statusor.ValueOrDie().tx_bytes());
+  reader_->EndSweep();
+}
+
+TEST_F(LinkStatsReaderTest, GetStatsDumpFailsReopensSocket) {
+  ExpectCreate();
+  EXPECT_CALL(*mock_rtnetlink_, GetLinks())
+      .WillOnce(Return(Status::CANCELLED));
+
+  reader_->BeginSweep();
+  EXPECT_ERROR_CODE(::util::error::CANCELLED,
+                    reader_->GetStats(kContainerName));
+
+  // The failed socket is dropped and the dump retried on a new one.
+  MockRtNetlink *new_rtnetlink = new StrictMock<MockRtNetlink>();
+  EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+      .WillOnce(Return(new_rtnetlink));
+  EXPECT_CALL(*new_rtnetlink, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{
+          MakeLink("veth0", "lmctfy:/test", 20)}));
+  EXPECT_OK(reader_->GetStats(kContainerName));
+  reader_->EndSweep();
+}
+
+}  // namespace lmctfy
+}  // namespace containers
@@ -299,10 +299,17 @@ Status MemoryResourceHandler::Stats(Container::StatsType type,
   MemoryStats *stats = output->mutable_memory();
   Status any_failure = Status::OK;
 
+  // Several of the statistics below come from memory.stat, read it only once.
+  // If it could not be read the snapshot is empty and those are skipped.
+  MemoryStatSnapshot snapshot;
+  SAVE_IF_ERROR(memory_controller_->GetMemoryStatSnapshot(&snapshot),
+                any_failure);
+
   // TODO(jonathanw): limit and reservation are spec, not stats; remove them
   // from Stats since they're returned in Spec.
   SET_IF_PRESENT_VAL_SAVE_FAILURE(
-      memory_controller_->GetWorkingSet(), stats->set_working_set, any_failure);
+      memory_controller_->GetWorkingSet(snapshot), stats->set_working_set,
+      any_failure);
   SET_IF_PRESENT_VAL_SAVE_FAILURE(
       memory_controller_->GetUsage(), stats->set_usage, any_failure);
   SET_IF_PRESENT_VAL_SAVE_FAILURE(
@@ -310,14 +317,18 @@ Status MemoryResourceHandler::Stats(Container::StatsType type,
   SET_IF_PRESENT_VAL_SAVE_FAILURE(
       memory_controller_->GetLimit(), stats->set_limit, any_failure);
   SET_IF_PRESENT_VAL_SAVE_FAILURE(
-      memory_controller_->GetEffectiveLimit(),
+      memory_controller_->GetEffectiveLimit(snapshot),
       stats->set_effective_limit, any_failure);
   SET_IF_PRESENT_VAL_SAVE_FAILURE(
       memory_controller_->GetSoftLimit(), stats->set_reservation, any_failure);
   SET_IF_PRESENT_SAVE_FAILURE(
       memory_controller_->GetFailCount(), stats->set_fail_count, any_failure);
+  SET_IF_PRESENT_SAVE_FAILURE(memory_controller_->GetPressure(),
+                              stats->mutable_pressure()->CopyFrom,
+                              any_failure);
 
-  SAVE_IF_ERROR(memory_controller_->GetMemoryStats(stats), any_failure);
+  SAVE_IF_ERROR(memory_controller_->GetMemoryStats(snapshot, stats),
+                any_failure);
   SAVE_IF_ERROR(memory_controller_->GetNumaStats(stats->mutable_numa()),
                 any_failure);
   SAVE_IF_ERROR(IgnoreNotFound(
@@ -384,7 +395,13 @@ StatusOr<Container::NotificationId> MemoryResourceHandler::RegisterNotification(
     const EventSpec &spec, Callback1<Status> *callback) {
   unique_ptr<Callback1<Status>> callback_deleter(callback);
 
-  if (spec.has_oom() && spec.has_memory_threshold()) {
+  // Pressure thresholds on other resources are handled by their handlers.
+  const bool has_pressure_threshold =
+      spec.has_pressure_threshold() &&
+      spec.pressure_threshold().resource() ==
+          EventSpec::PressureThreshold::MEMORY;
+  if (spec.has_oom() + spec.has_memory_threshold() + has_pressure_threshold >
+      1) {
     // TODO(vmarmol): Consider doing this check in ContainerImpl with proto
     // introspection.
     return Status(::util::error::INVALID_ARGUMENT,
@@ -409,6 +426,12 @@ StatusOr<Container::NotificationId> MemoryResourceHandler::RegisterNotification(
         Bytes(spec.memory_threshold().usage()), callback_deleter.release());
   }
 
+  // Memory pressure threshold event.
+  if (has_pressure_threshold) {
+    return memory_controller_->RegisterPressureNotification(
+        spec.pressure_threshold(), callback_deleter.release());
+  }
+
   // No known event found.
   return Status(::util::error::NOT_FOUND, "No handled event found");
 }
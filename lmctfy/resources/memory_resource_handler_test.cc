@@ -26,6 +26,7 @@
 #include "include/lmctfy.pb.h"
 #include "util/safe_types/bytes.h"
 #include "util/errors_test_util.h"
+#include "util/testing/equals_initialized_proto.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "util/task/codes.pb.h"
@@ -35,6 +36,7 @@ using ::system_api::KernelAPIMock;
 using ::util::Bytes;
 using ::std::unique_ptr;
 using ::std::vector;
+using ::testing::EqualsInitializedProto;
 using ::testing::NiceMock;
 using ::testing::NotNull;
 using ::testing::Return;
@@ -184,7 +186,9 @@ class MemoryResourceHandlerTest : public ::testing::Test {
         kContainerName, mock_kernel_.get(),
         mock_memory_controller_));
 
-    EXPECT_CALL(*mock_memory_controller_, GetWorkingSet())
+    EXPECT_CALL(*mock_memory_controller_, GetMemoryStatSnapshot(NotNull()))
+        .WillRepeatedly(Return(Status::OK));
+    EXPECT_CALL(*mock_memory_controller_, GetWorkingSet(_))
         .WillRepeatedly(Return(Bytes(1)));
     EXPECT_CALL(*mock_memory_controller_, GetUsage())
         .WillRepeatedly(Return(Bytes(2)));
@@ -192,15 +196,16 @@ class MemoryResourceHandlerTest : public ::testing::Test {
         .WillRepeatedly(Return(Bytes(3)));
     EXPECT_CALL(*mock_memory_controller_, GetLimit())
         .WillRepeatedly(Return(Bytes(4)));
-    EXPECT_CALL(*mock_memory_controller_, GetEffectiveLimit())
+    EXPECT_CALL(*mock_memory_controller_, GetEffectiveLimit(_))
         .WillRepeatedly(Return(Bytes(5)));
     EXPECT_CALL(*mock_memory_controller_, GetSoftLimit())
         .WillRepeatedly(Return(Bytes(6)));
     memory_stats_status_ = Status::OK;
     memory_stats_.reset(new MemoryStats());
     memory_stats_->mutable_container_data()->set_cache(7);
-    EXPECT_CALL(*mock_memory_controller_, GetMemoryStats(_)).WillRepeatedly(
-        testing::Invoke(this, &MemoryResourceHandlerTest::PopulateMemoryStats));
+    EXPECT_CALL(*mock_memory_controller_, GetMemoryStats(_, _))
+        .WillRepeatedly(testing::Invoke(
+            this, &MemoryResourceHandlerTest::PopulateMemoryStats));
 
     numa_stats_status_ = Status::OK;
     numa_stats_.reset(new MemoryStats_NumaStats());
@@ -227,6 +232,10 @@ class MemoryResourceHandlerTest : public ::testing::Test {
                             PopulateCompressionSamplingStats));
     EXPECT_CALL(*mock_memory_controller_, GetFailCount())
         .WillRepeatedly(Return(11));
+    PressureData pressure;
+    pressure.mutable_full()->set_total(12);
+    EXPECT_CALL(*mock_memory_controller_, GetPressure())
+        .WillRepeatedly(Return(pressure));
   }
 
   Status memory_stats_status_;
@@ -242,7 +251,8 @@ class MemoryResourceHandlerTest : public ::testing::Test {
   unique_ptr<MemoryStats_CompressionSamplingStats> compression_sampling_stats_;
 
  protected:
-  Status PopulateMemoryStats(MemoryStats *stats) const {
+  Status PopulateMemoryStats(const MemoryStatSnapshot &snapshot,
+                             MemoryStats *stats) const {
     if (memory_stats_status_.ok()) {
       stats->mutable_container_data()->CopyFrom(
           memory_stats_->container_data());
@@ -333,6 +343,7 @@ TEST_F(MemoryResourceHandlerTest, StatsSuccess) {
     EXPECT_EQ(9, stats.memory().idle_page().scans());
     EXPECT_EQ(10, stats.memory().compression_sampling().raw_size());
     EXPECT_EQ(11, stats.memory().fail_count());
+    EXPECT_EQ(12, stats.memory().pressure().full().total());
   }
 }
 
@@ -340,7 +351,7 @@ TEST_F(MemoryResourceHandlerTest, StatsGetWorkingSetFails) {
   for (Container::StatsType type : kStatTypes) {
     ContainerStats stats;
 
-    EXPECT_CALL(*mock_memory_controller_, GetWorkingSet())
+    EXPECT_CALL(*mock_memory_controller_, GetWorkingSet(_))
         .WillRepeatedly(Return(Status::CANCELLED));
 
     EXPECT_EQ(Status::CANCELLED, handler_->Stats(type, &stats));
@@ -384,7 +395,7 @@ TEST_F(MemoryResourceHandlerTest, StatsGetEffectiveLimitFails) {
   for (Container::StatsType type : kStatTypes) {
     ContainerStats stats;
 
-    EXPECT_CALL(*mock_memory_controller_, GetEffectiveLimit())
+    EXPECT_CALL(*mock_memory_controller_, GetEffectiveLimit(_))
         .WillRepeatedly(Return(Status::CANCELLED));
 
     EXPECT_EQ(Status::CANCELLED, handler_->Stats(type, &stats));
@@ -402,6 +413,29 @@ TEST_F(MemoryResourceHandlerTest, StatsGetSoftLimitFails) {
   }
 }
 
+TEST_F(MemoryResourceHandlerTest, StatsGetMemoryStatSnapshotFails) {
+  for (Container::StatsType type : kStatTypes) {
+    ContainerStats stats;
+
+    EXPECT_CALL(*mock_memory_controller_, GetMemoryStatSnapshot(NotNull()))
+        .WillRepeatedly(Return(Status::CANCELLED));
+
+    EXPECT_EQ(Status::CANCELLED, handler_->Stats(type, &stats));
+  }
+}
+
+TEST_F(MemoryResourceHandlerTest, StatsMemoryStatSnapshotNotFound) {
+  for (Container::StatsType type : kStatTypes) {
+    ContainerStats stats;
+
+    // memory.stat is required, its absence is reported.
+    EXPECT_CALL(*mock_memory_controller_, GetMemoryStatSnapshot(NotNull()))
+        .WillRepeatedly(Return(Status(::util::error::NOT_FOUND, "")));
+
+    EXPECT_ERROR_CODE(NOT_FOUND, handler_->Stats(type, &stats));
+  }
+}
+
 TEST_F(MemoryResourceHandlerTest, StatsGetMemoryStatsFails) {
   memory_stats_status_ = Status::CANCELLED;
   for (Container::StatsType type : kStatTypes) {
@@ -431,6 +465,29 @@ TEST_F(MemoryResourceHandlerTest, StatsGetFailCountFails) {
   }
 }
 
+TEST_F(MemoryResourceHandlerTest, StatsGetPressureFails) {
+  for (Container::StatsType type : kStatTypes) {
+    ContainerStats stats;
+
+    EXPECT_CALL(*mock_memory_controller_, GetPressure())
+        .WillRepeatedly(Return(Status::CANCELLED));
+
+    EXPECT_EQ(Status::CANCELLED, handler_->Stats(type, &stats));
+  }
+}
+
+TEST_F(MemoryResourceHandlerTest, StatsGetPressureNotFound) {
+  for (Container::StatsType type : kStatTypes) {
+    ContainerStats stats;
+
+    EXPECT_CALL(*mock_memory_controller_, GetPressure())
+        .WillRepeatedly(Return(Status(::util::error::NOT_FOUND, "")));
+
+    EXPECT_OK(handler_->Stats(type, &stats));
+    EXPECT_FALSE(stats.memory().has_pressure());
+  }
+}
+
 // Tests for Update().
 
 TEST_F(MemoryResourceHandlerTest, UpdateDiffEmpty) {
@@ -1132,6 +1189,38 @@ TEST_F(MemoryResourceHandlerTest,
                         spec, NewPermanentCallback(&NoOpCallback)));
 }
 
+TEST_F(MemoryResourceHandlerTest, RegisterNotificationPressureSuccess) {
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::MEMORY);
+  spec.mutable_pressure_threshold()->set_threshold(100000);
+  spec.mutable_pressure_threshold()->set_window(1000000);
+
+  // RegisterPressureNotification takes ownership, but we're mocking it out.
+  unique_ptr<Callback1<Status>> cb(NewPermanentCallback(&NoOpCallback));
+
+  EXPECT_CALL(*mock_memory_controller_,
+              RegisterPressureNotification(
+                  EqualsInitializedProto(spec.pressure_threshold()),
+                  NotNull()))
+      .WillOnce(Return(1));
+
+  StatusOr<ActiveNotifications::Handle> statusor =
+      handler_->RegisterNotification(spec, cb.get());
+  ASSERT_OK(statusor);
+  EXPECT_EQ(1, statusor.ValueOrDie());
+}
+
+TEST_F(MemoryResourceHandlerTest, RegisterNotificationPressureOtherResource) {
+  EventSpec spec;
+  spec.mutable_pressure_threshold()->set_resource(
+      EventSpec::PressureThreshold::CPU);
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    handler_->RegisterNotification(
+                        spec, NewPermanentCallback(&NoOpCallback)));
+}
+
 TEST_F(MemoryResourceHandlerTest, RegisterNotificationNoneSpecified) {
   EventSpec spec;
 
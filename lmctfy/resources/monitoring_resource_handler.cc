@@ -84,19 +84,36 @@ MonitoringResourceHandler::MonitoringResourceHandler(
     const string &container_name, const KernelApi *kernel,
     PerfController *perf_controller)
     : CgroupResourceHandler(container_name, RESOURCE_MONITORING, kernel,
-                            vector<CgroupController *>({perf_controller})) {}
+                            vector<CgroupController *>({perf_controller})),
+      perf_controller_(perf_controller) {}
 
 util::Status MonitoringResourceHandler::Update(const ContainerSpec &spec,
                                                Container::UpdatePolicy policy) {
+  // A diff update only changes what is specified.
+  if (policy == Container::UPDATE_DIFF &&
+      !spec.monitoring().has_enable_perf_counters()) {
+    return util::Status::OK;
+  }
+
+  if (spec.monitoring().enable_perf_counters()) {
+    return perf_controller_->EnableCounters();
+  }
+  perf_controller_->DisableCounters();
   return util::Status::OK;
 }
 
 util::Status MonitoringResourceHandler::Stats(Container::StatsType type,
                                               ContainerStats *output) const {
+  SET_IF_PRESENT(
+      perf_controller_->GetCounters(),
+      output->mutable_monitoring()->mutable_perf_counters()->CopyFrom);
   return util::Status::OK;
 }
 
 util::Status MonitoringResourceHandler::Spec(ContainerSpec *spec) const {
+  if (perf_controller_->CountersEnabled()) {
+    spec->mutable_monitoring()->set_enable_perf_counters(true);
+  }
   return util::Status::OK;
 }
 
@@ -77,6 +77,8 @@ class MonitoringResourceHandler : public CgroupResourceHandler {
       const EventSpec &spec, Callback1< ::util::Status> *callback);
 
  private:
+  PerfController *perf_controller_;
+
   DISALLOW_COPY_AND_ASSIGN(MonitoringResourceHandler);
 };
 
@@ -22,6 +22,7 @@
 #include "lmctfy/controllers/eventfd_notifications_mock.h"
 #include "lmctfy/controllers/perf_controller_mock.h"
 #include "util/errors_test_util.h"
+#include "util/task/codes.pb.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -217,5 +218,113 @@ TEST_F(MonitoringResourceHandlerTest, CreatesTest) {
   EXPECT_TRUE(handler_.get() != NULL);
 }
 
+// Tests for Update().
+
+TEST_F(MonitoringResourceHandlerTest, UpdateEnablesCounters) {
+  ContainerSpec spec;
+  spec.mutable_monitoring()->set_enable_perf_counters(true);
+
+  EXPECT_CALL(*mock_memory_controller_, EnableCounters())
+      .Times(2)
+      .WillRepeatedly(Return(Status::OK));
+
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_DIFF));
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_REPLACE));
+}
+
+TEST_F(MonitoringResourceHandlerTest, UpdateEnableFails) {
+  ContainerSpec spec;
+  spec.mutable_monitoring()->set_enable_perf_counters(true);
+
+  EXPECT_CALL(*mock_memory_controller_, EnableCounters())
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED,
+            handler_->Update(spec, Container::UPDATE_REPLACE));
+}
+
+TEST_F(MonitoringResourceHandlerTest, UpdateDisablesCounters) {
+  ContainerSpec spec;
+  spec.mutable_monitoring()->set_enable_perf_counters(false);
+
+  EXPECT_CALL(*mock_memory_controller_, DisableCounters());
+
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_DIFF));
+}
+
+TEST_F(MonitoringResourceHandlerTest, UpdateReplaceUnspecifiedDisables) {
+  ContainerSpec spec;
+
+  EXPECT_CALL(*mock_memory_controller_, DisableCounters());
+
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_REPLACE));
+}
+
+TEST_F(MonitoringResourceHandlerTest, UpdateDiffUnspecifiedIsNoop) {
+  ContainerSpec spec;
+
+  EXPECT_OK(handler_->Update(spec, Container::UPDATE_DIFF));
+}
+
+// Tests for Stats().
+
+TEST_F(MonitoringResourceHandlerTest, StatsSuccess) {
+  MonitoringStats::PerfCounters counters;
+  counters.set_hardware(true);
+  counters.set_cycles(2000);
+  counters.set_instructions(3000);
+
+  for (Container::StatsType type : kStatTypes) {
+    EXPECT_CALL(*mock_memory_controller_, GetCounters())
+        .WillOnce(Return(counters));
+
+    ContainerStats stats;
+    EXPECT_OK(handler_->Stats(type, &stats));
+    EXPECT_TRUE(stats.monitoring().perf_counters().hardware());
+    EXPECT_EQ(2000, stats.monitoring().perf_counters().cycles());
+    EXPECT_EQ(3000, stats.monitoring().perf_counters().instructions());
+  }
+}
+
+TEST_F(MonitoringResourceHandlerTest, StatsNotEnabled) {
+  for (Container::StatsType type : kStatTypes) {
+    EXPECT_CALL(*mock_memory_controller_, GetCounters())
+        .WillOnce(Return(Status(::util::error::NOT_FOUND, "")));
+
+    ContainerStats stats;
+    EXPECT_OK(handler_->Stats(type, &stats));
+    EXPECT_FALSE(stats.has_monitoring());
+  }
+}
+
+TEST_F(MonitoringResourceHandlerTest, StatsFails) {
+  EXPECT_CALL(*mock_memory_controller_, GetCounters())
+      .WillOnce(Return(Status::CANCELLED));
+
+  ContainerStats stats;
+  EXPECT_EQ(Status::CANCELLED,
+            handler_->Stats(Container::STATS_FULL, &stats));
+}
+
+// Tests for Spec().
+
+TEST_F(MonitoringResourceHandlerTest, SpecEnabled) {
+  EXPECT_CALL(*mock_memory_controller_, CountersEnabled())
+      .WillOnce(Return(true));
+
+  ContainerSpec spec;
+  EXPECT_OK(handler_->Spec(&spec));
+  EXPECT_TRUE(spec.monitoring().enable_perf_counters());
+}
+
+TEST_F(MonitoringResourceHandlerTest, SpecNotEnabled) {
+  EXPECT_CALL(*mock_memory_controller_, CountersEnabled())
+      .WillOnce(Return(false));
+
+  ContainerSpec spec;
+  EXPECT_OK(handler_->Spec(&spec));
+  EXPECT_FALSE(spec.has_monitoring());
+}
+
 }  // namespace lmctfy
 }  // namespace containers
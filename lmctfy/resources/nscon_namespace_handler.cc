@@ -58,9 +58,9 @@ StatusOr<NamespaceHandlerFactory *> NamespaceHandlerFactory::New(
     const TasksHandlerFactory *tasks_handler_factory) {
   NamespaceControllerFactory *namespace_controller_factory =
       RETURN_IF_ERROR(NamespaceControllerFactory::New());
-  return new NsconNamespaceHandlerFactory(tasks_handler_factory,
-                                          namespace_controller_factory,
-                                          new ConsoleUtil());
+  return new NsconNamespaceHandlerFactory(
+      tasks_handler_factory, namespace_controller_factory, new ConsoleUtil(),
+      new LinkStatsReader(new nscon::RtNetlinkFactory()));
 }
 
 StatusOr<NamespaceHandler *> NsconNamespaceHandlerFactory::GetNamespaceHandler(
@@ -80,7 +80,8 @@ StatusOr<NamespaceHandler *> NsconNamespaceHandlerFactory::GetNamespaceHandler(
   NamespaceController *namespace_controller =
       RETURN_IF_ERROR(namespace_controller_factory_->Get(init_pid));
   return new NsconNamespaceHandler(container_name, namespace_controller,
-                                   namespace_controller_factory_.get());
+                                   namespace_controller_factory_.get(),
+                                   link_stats_reader_.get());
 }
 
 StatusOr<NamespaceHandler *>
@@ -134,9 +135,23 @@ NsconNamespaceHandlerFactory::CreateNamespaceHandler(
   unique_ptr<NamespaceController> namespace_controller(
       RETURN_IF_ERROR(namespace_controller_factory_->Create(namespace_spec,
                                                             init_argv)));
+
+  // Tag the host side of the veth pair so its counters can be found. The
+  // Virtual Host is usable without them, so failing to do so is not fatal.
+  const Network &network = spec.virtual_host().network();
+  if (network.connection().veth_pair().has_outside()) {
+    const Status status = link_stats_reader_->TagLink(
+        network.connection().veth_pair().outside(), container_name);
+    if (!status.ok()) {
+      LOG(WARNING) << "No network stats for Virtual Host \"" << container_name
+                   << "\": " << status.error_message();
+    }
+  }
+
   return new NsconNamespaceHandler(container_name,
                                    namespace_controller.release(),
-                                   namespace_controller_factory_.get());
+                                   namespace_controller_factory_.get(),
+                                   link_stats_reader_.get());
 }
 
 // Gets a list of processes directly in the container, or in its subcontainers
@@ -308,6 +323,14 @@ Status NsconNamespaceHandlerFactory::InitMachine(const InitSpec &spec) {
   return console_util_->EnableDevPtsNamespaceSupport();
 }
 
+void NsconNamespaceHandlerFactory::BeginStatsSweep() {
+  link_stats_reader_->BeginSweep();
+}
+
+void NsconNamespaceHandlerFactory::EndStatsSweep() {
+  link_stats_reader_->EndSweep();
+}
+
 Status NsconNamespaceHandler::Update(const ContainerSpec &spec,
                                      Container::UpdatePolicy policy) {
   // TODO(jnagal): Namespaces cannot be updated yet.
@@ -355,6 +378,20 @@ StatusOr<pid_t> NsconNamespaceHandler::Run(const vector<string> &command,
 
 Status NsconNamespaceHandler::Stats(Container::StatsType type,
                                    ContainerStats *output) const {
+  // Virtual Hosts without a veth pair have no network stats. Failing to read
+  // them only loses the network stats, the rest of the stats are still
+  // reported.
+  StatusOr<NetworkStats> statusor =
+      link_stats_reader_->GetStats(container_name());
+  if (!statusor.ok()) {
+    if (statusor.status().error_code() != NOT_FOUND) {
+      LOG(WARNING) << "No network stats for Virtual Host \""
+                   << container_name() << "\": "
+                   << statusor.status().error_message();
+    }
+    return Status::OK;
+  }
+  *output->mutable_network() = statusor.ValueOrDie();
   return Status::OK;
 }
 
@@ -23,6 +23,7 @@ using ::std::string;
 #include "base/macros.h"
 #include "base/logging.h"
 #include "lmctfy/namespace_handler.h"
+#include "lmctfy/resources/link_stats_reader.h"
 #include "lmctfy/tasks_handler.h"
 #include "include/namespace_controller.h"
 #include "include/lmctfy.h"
@@ -35,16 +36,18 @@ namespace lmctfy {
 
 class NsconNamespaceHandlerFactory : public NamespaceHandlerFactory {
  public:
-  // Takes ownership of namespace_controller_factory.
+  // Takes ownership of namespace_controller_factory and link_stats_reader.
   // Does not own task_handlers_factory.
   NsconNamespaceHandlerFactory(
       const TasksHandlerFactory *tasks_handler_factory,
       const nscon::NamespaceControllerFactory *namespace_controller_factory,
-      const ConsoleUtil *console_util)
+      const ConsoleUtil *console_util,
+      LinkStatsReader *link_stats_reader)
       : tasks_handler_factory_(CHECK_NOTNULL(tasks_handler_factory)),
         namespace_controller_factory_(
             CHECK_NOTNULL(namespace_controller_factory)),
-        console_util_(console_util) {}
+        console_util_(console_util),
+        link_stats_reader_(CHECK_NOTNULL(link_stats_reader)) {}
 
   ~NsconNamespaceHandlerFactory() override {}
 
@@ -57,6 +60,11 @@ class NsconNamespaceHandlerFactory : public NamespaceHandlerFactory {
 
   ::util::Status InitMachine(const InitSpec &spec) override;
 
+  // The network counters of all Virtual Hosts are read with a single dump of
+  // the links during a stats sweep.
+  void BeginStatsSweep() override;
+  void EndStatsSweep() override;
+
  private:
   // Checks whether the specified container is a VirtualHost.
   ::util::StatusOr<bool> IsVirtualHost(const string &container_name) const;
@@ -82,6 +90,9 @@ class NsconNamespaceHandlerFactory : public NamespaceHandlerFactory {
 
   const ::std::unique_ptr<const ConsoleUtil> console_util_;
 
+  // Reader of the network counters of the Virtual Hosts.
+  const ::std::unique_ptr<LinkStatsReader> link_stats_reader_;
+
   friend class NsconNamespaceHandlerFactoryTest;
 
   DISALLOW_COPY_AND_ASSIGN(NsconNamespaceHandlerFactory);
@@ -90,15 +101,17 @@ class NsconNamespaceHandlerFactory : public NamespaceHandlerFactory {
 class NsconNamespaceHandler : public NamespaceHandler {
  public:
   // Takes ownership of namespace_controller, borrows
-  // namespace_controller_factory.
+  // namespace_controller_factory and link_stats_reader.
   NsconNamespaceHandler(
       const string &container_name,
       nscon::NamespaceController *namespace_controller,
-      const nscon::NamespaceControllerFactory *namespace_controller_factory)
+      const nscon::NamespaceControllerFactory *namespace_controller_factory,
+      LinkStatsReader *link_stats_reader)
       : NamespaceHandler(container_name, RESOURCE_VIRTUALHOST),
         namespace_controller_(CHECK_NOTNULL(namespace_controller)),
         namespace_controller_factory_(
-            CHECK_NOTNULL(namespace_controller_factory)) {}
+            CHECK_NOTNULL(namespace_controller_factory)),
+        link_stats_reader_(CHECK_NOTNULL(link_stats_reader)) {}
   ~NsconNamespaceHandler() override {}
 
   ::util::Status CreateResource(const ContainerSpec &spec) override {
@@ -125,6 +138,7 @@ class NsconNamespaceHandler : public NamespaceHandler {
  private:
   ::std::unique_ptr<nscon::NamespaceController> namespace_controller_;
   const nscon::NamespaceControllerFactory *namespace_controller_factory_;
+  LinkStatsReader *link_stats_reader_;
 
   DISALLOW_COPY_AND_ASSIGN(NsconNamespaceHandler);
 };
@@ -23,6 +23,7 @@
 #include "include/lmctfy.pb.h"
 #include "include/namespace_controller_mock.h"
 #include "include/namespaces.pb.h"
+#include "nscon/configurator/rtnetlink_mock.h"
 #include "util/errors_test_util.h"
 #include "util/file_lines_test_util.h"
 #include "strings/substitute.h"
@@ -31,6 +32,9 @@
 #include "util/task/codes.pb.h"
 #include "util/task/status.h"
 
+using ::containers::nscon::MockRtNetlink;
+using ::containers::nscon::MockRtNetlinkFactory;
+using ::containers::nscon::RtNetlink;
 using ::util::FileLinesTestUtil;
 using ::util::UnixGid;
 using ::util::UnixUid;
@@ -67,10 +71,12 @@ class NsconNamespaceHandlerFactoryTest : public ::testing::Test {
         new nscon::StrictMockNamespaceControllerFactory();
     mock_tasks_handler_factory_.reset(new StrictMockTasksHandlerFactory());
     mock_console_util_ = new StrictMock<MockConsoleUtil>();
+    mock_rtnetlink_factory_ = new StrictMock<MockRtNetlinkFactory>();
     factory_.reset(new NsconNamespaceHandlerFactory(
         mock_tasks_handler_factory_.get(),
         mock_controller_factory_,
-        mock_console_util_));
+        mock_console_util_,
+        new LinkStatsReader(mock_rtnetlink_factory_)));
   }
 
   // Expect the child to have the specified parent.
@@ -171,8 +177,14 @@ class NsconNamespaceHandlerFactoryTest : public ::testing::Test {
     return factory_->DetectInit(container_name);
   }
 
+  // Wrapper over private members for testing.
+  LinkStatsReader *link_stats_reader() {
+    return factory_->link_stats_reader_.get();
+  }
+
  protected:
   StrictMock<MockConsoleUtil> *mock_console_util_;
+  MockRtNetlinkFactory *mock_rtnetlink_factory_;
   nscon::MockNamespaceControllerFactory *mock_controller_factory_;
   unique_ptr<MockTasksHandlerFactory> mock_tasks_handler_factory_;
   unique_ptr<NsconNamespaceHandlerFactory> factory_;
@@ -279,6 +291,75 @@ TEST_F(NsconNamespaceHandlerFactoryTest, CreateNamespaceHandlerSuccess) {
   EXPECT_EQ(kContainerName, handler->container_name());
 }
 
+TEST_F(NsconNamespaceHandlerFactoryTest, CreateNamespaceHandlerTagsVeth) {
+  ContainerSpec spec;
+  Network::VethPair *veth_pair = spec.mutable_virtual_host()
+                                     ->mutable_network()
+                                     ->mutable_connection()
+                                     ->mutable_veth_pair();
+  veth_pair->set_outside("veth0");
+  veth_pair->set_inside("eth0");
+  nscon::MockNamespaceController *mock_controller =
+      new nscon::StrictMockNamespaceController();
+  EXPECT_CALL(*mock_controller_factory_, Create(_, IsEmpty()))
+      .WillRepeatedly(Return(mock_controller));
+  MockRtNetlink *mock_rtnetlink = new StrictMock<MockRtNetlink>();
+  EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+      .WillOnce(Return(mock_rtnetlink));
+  EXPECT_CALL(*mock_rtnetlink, SetAlias("veth0", "lmctfy:/test"));
+  EXPECT_CALL(*mock_rtnetlink, Commit()).WillOnce(Return(Status::OK));
+
+  StatusOr<NamespaceHandler *> statusor =
+      factory_->CreateNamespaceHandler(kContainerName, spec, {});
+  ASSERT_OK(statusor);
+  unique_ptr<NamespaceHandler> handler(statusor.ValueOrDie());
+}
+
+TEST_F(NsconNamespaceHandlerFactoryTest, CreateNamespaceHandlerTagVethFails) {
+  ContainerSpec spec;
+  spec.mutable_virtual_host()
+      ->mutable_network()
+      ->mutable_connection()
+      ->mutable_veth_pair()
+      ->set_outside("veth0");
+  nscon::MockNamespaceController *mock_controller =
+      new nscon::StrictMockNamespaceController();
+  EXPECT_CALL(*mock_controller_factory_, Create(_, IsEmpty()))
+      .WillRepeatedly(Return(mock_controller));
+  EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+      .WillOnce(Return(Status::CANCELLED));
+
+  // The Virtual Host is still created, only without network stats.
+  StatusOr<NamespaceHandler *> statusor =
+      factory_->CreateNamespaceHandler(kContainerName, spec, {});
+  ASSERT_OK(statusor);
+  unique_ptr<NamespaceHandler> handler(statusor.ValueOrDie());
+}
+
+TEST_F(NsconNamespaceHandlerFactoryTest, StatsSweep) {
+  MockRtNetlink *mock_rtnetlink = new StrictMock<MockRtNetlink>();
+  EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+      .WillOnce(Return(mock_rtnetlink));
+  RtNetlink::Link link;
+  link.alias = "lmctfy:/test";
+  EXPECT_CALL(*mock_rtnetlink, GetLinks())
+      .WillOnce(Return(vector<RtNetlink::Link>{link}));
+  nscon::MockNamespaceController *mock_controller =
+      new nscon::StrictMockNamespaceController();
+  EXPECT_CALL(*mock_controller, GetPid()).WillRepeatedly(Return(kInit));
+  NsconNamespaceHandler handler(kContainerName, mock_controller,
+                                mock_controller_factory_,
+                                link_stats_reader());
+
+  // One dump serves all the Stats() of the sweep.
+  factory_->BeginStatsSweep();
+  ContainerStats stats;
+  EXPECT_OK(handler.Stats(Container::STATS_SUMMARY, &stats));
+  EXPECT_OK(handler.Stats(Container::STATS_FULL, &stats));
+  EXPECT_TRUE(stats.has_network());
+  factory_->EndStatsSweep();
+}
+
 TEST_F(NsconNamespaceHandlerFactoryTest, CreateNamespaceHandlerInvalidSpec) {
   ContainerSpec spec;
   EXPECT_ERROR_CODE(INVALID_ARGUMENT,
@@ -921,12 +1002,25 @@ class NsconNamespaceHandlerTest : public ::testing::Test {
         .WillRepeatedly(Return(kInit));
     mock_namespace_controller_factory_.reset(
         new nscon::StrictMockNamespaceControllerFactory());
+    mock_rtnetlink_factory_ = new StrictMock<MockRtNetlinkFactory>();
+    link_stats_reader_.reset(new LinkStatsReader(mock_rtnetlink_factory_));
     handler_.reset(
         new NsconNamespaceHandler(kContainerName, mock_namespace_controller_,
-                                  mock_namespace_controller_factory_.get()));
+                                  mock_namespace_controller_factory_.get(),
+                                  link_stats_reader_.get()));
+  }
+
+  // Expects the links to be dumped once with the specified result.
+  void ExpectGetLinks(const StatusOr<vector<RtNetlink::Link>> &links) {
+    MockRtNetlink *mock_rtnetlink = new StrictMock<MockRtNetlink>();
+    EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+        .WillOnce(Return(mock_rtnetlink));
+    EXPECT_CALL(*mock_rtnetlink, GetLinks()).WillOnce(Return(links));
   }
 
  protected:
+  MockRtNetlinkFactory *mock_rtnetlink_factory_;
+  unique_ptr<LinkStatsReader> link_stats_reader_;
   unique_ptr<NsconNamespaceHandler> handler_;
   nscon::MockNamespaceController *mock_namespace_controller_;
   unique_ptr<nscon::MockNamespaceControllerFactory>
@@ -961,15 +1055,48 @@ TEST_F(NsconNamespaceHandlerTest, CreateResource) {
 }
 
 TEST_F(NsconNamespaceHandlerTest, StatsSummary) {
+  RtNetlink::Link link;
+  link.alias = "lmctfy:/test";
+  link.rx_bytes = 10;
+  link.tx_bytes = 20;
+  ExpectGetLinks(vector<RtNetlink::Link>{link});
+
   Container::StatsType type = Container::STATS_SUMMARY;
   ContainerStats stats;
   EXPECT_OK(handler_->Stats(type, &stats));
+  ASSERT_TRUE(stats.has_network());
+  EXPECT_EQ(20, stats.network().rx_bytes());
+  EXPECT_EQ(10, stats.network().tx_bytes());
 }
 
 TEST_F(NsconNamespaceHandlerTest, StatsFull) {
+  RtNetlink::Link link;
+  link.alias = "lmctfy:/test";
+  link.rx_bytes = 10;
+  ExpectGetLinks(vector<RtNetlink::Link>{link});
+
   Container::StatsType type = Container::STATS_FULL;
   ContainerStats stats;
   EXPECT_OK(handler_->Stats(type, &stats));
+  ASSERT_TRUE(stats.has_network());
+  EXPECT_EQ(10, stats.network().tx_bytes());
+}
+
+TEST_F(NsconNamespaceHandlerTest, StatsNoVethPair) {
+  ExpectGetLinks(vector<RtNetlink::Link>{});
+
+  ContainerStats stats;
+  EXPECT_OK(handler_->Stats(Container::STATS_FULL, &stats));
+  EXPECT_FALSE(stats.has_network());
+}
+
+TEST_F(NsconNamespaceHandlerTest, StatsDumpFails) {
+  ExpectGetLinks(Status::CANCELLED);
+
+  // Network stats are skipped.
+  ContainerStats stats;
+  EXPECT_OK(handler_->Stats(Container::STATS_FULL, &stats));
+  EXPECT_FALSE(stats.has_network());
 }
 
 TEST_F(NsconNamespaceHandlerTest, ExecSuccess) {
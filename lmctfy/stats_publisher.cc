@@ -0,0 +1,95 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/stats_publisher.h"
+
+#include <time.h>
+#include <map>
+#include <string>
+using ::std::string;
+#include <vector>
+
+#include "base/logging.h"
+#include "util/errors.h"
+
+using ::std::map;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::util::Status;
+
+namespace containers {
+namespace lmctfy {
+
+static const int64 kNanosPerSecond = 1000000000;
+
+StatsPublisher::StatsPublisher(const ContainerApi *lmctfy,
+                               StatsShmWriter *writer,
+                               Container::StatsType type)
+    : lmctfy_(CHECK_NOTNULL(lmctfy)),
+      writer_(CHECK_NOTNULL(writer)),
+      type_(type) {}
+
+int64 StatsPublisher::NowNs() const {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec * kNanosPerSecond + now.tv_nsec;
+}
+
+Status StatsPublisher::Publish() {
+  // List all containers.
+  vector<string> container_names = {"/"};
+  {
+    unique_ptr<Container> root(RETURN_IF_ERROR(lmctfy_->Get("/")));
+    vector<Container *> subcontainers =
+        RETURN_IF_ERROR(root->ListSubcontainers(Container::LIST_RECURSIVE));
+    for (Container *subcontainer : subcontainers) {
+      container_names.push_back(subcontainer->name());
+      delete subcontainer;
+    }
+  }
+
+  map<string, Status> errors;
+  const map<string, ContainerStats> stats =
+      RETURN_IF_ERROR(lmctfy_->StatsMany(container_names, type_, &errors));
+  const int64 now = NowNs();
+
+  // Containers whose stats can't be read this round keep their last record.
+  for (const auto &name_status : errors) {
+    LOG(WARNING) << "Failed to get the stats of container \""
+                 << name_status.first << "\": "
+                 << name_status.second.ToString();
+  }
+
+  // Free the slots of the containers that are gone before adding new ones.
+  for (const string &container_name : writer_->ContainerNames()) {
+    if (stats.find(container_name) == stats.end() &&
+        errors.find(container_name) == errors.end()) {
+      writer_->Remove(container_name);
+    }
+  }
+
+  for (const auto &name_stats : stats) {
+    Status status = writer_->Write(name_stats.first, name_stats.second, now);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to publish the stats of container \""
+                   << name_stats.first << "\": " << status.ToString();
+    }
+  }
+
+  writer_->FinishRound(now);
+  return Status::OK;
+}
+
+}  // namespace lmctfy
+}  // namespace containers
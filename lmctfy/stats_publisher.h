@@ -0,0 +1,70 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_STATS_PUBLISHER_H_
+#define SRC_STATS_PUBLISHER_H_
+
+#include <memory>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "include/lmctfy.h"
+#include "lmctfy/stats_shm.h"
+#include "util/task/status.h"
+
+namespace containers {
+namespace lmctfy {
+
+// Publishes the stats of all containers to a stats file (see stats_shm.h) so
+// that local consumers read them without each gathering them from the kernel.
+//
+// Each round lists all containers and gets their stats with a single
+// ContainerApi::StatsMany() call, writes them to the file and removes the
+// containers that are gone. Containers whose stats fail keep their last record.
+//
+// Class is thread-compatible.
+class StatsPublisher {
+ public:
+  // Arguments:
+  //   lmctfy: Used to get the stats of the containers. Does not take
+  //       ownership.
+  //   writer: The stats file written to. Takes ownership.
+  //   type: The type of stats to publish.
+  StatsPublisher(const ContainerApi *lmctfy, StatsShmWriter *writer,
+                 Container::StatsType type);
+  virtual ~StatsPublisher() {}
+
+  // Publishes the current stats of all containers. Containers whose stats
+  // can't be written are skipped.
+  //
+  // Return:
+  //   Status: Status of the operation. OK iff the round was published.
+  ::util::Status Publish();
+
+ protected:
+  // Gets the current wall time in nanoseconds. Virtual for testing.
+  virtual int64 NowNs() const;
+
+ private:
+  const ContainerApi *lmctfy_;
+  const ::std::unique_ptr<StatsShmWriter> writer_;
+  const Container::StatsType type_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatsPublisher);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_STATS_PUBLISHER_H_
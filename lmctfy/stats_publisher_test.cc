@@ -0,0 +1,201 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/stats_publisher.h"
+
+#include <stdlib.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "base/logging.h"
+#include "file/base/path.h"
+#include "include/lmctfy_mock.h"
+#include "util/errors_test_util.h"
+#include "strings/substitute.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+#include "util/testing/equals_initialized_proto.h"
+
+using ::file::JoinPath;
+using ::std::map;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::testing::ElementsAre;
+using ::testing::EqualsInitializedProto;
+using ::testing::DoAll;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+using ::testing::_;
+using ::util::Status;
+using ::util::StatusOr;
+
+DECLARE_string(test_tmpdir);
+
+namespace containers {
+namespace lmctfy {
+namespace {
+
+static const int64 kNow = 1000;
+
+// StatsPublisher with a fixed clock.
+class TestStatsPublisher : public StatsPublisher {
+ public:
+  TestStatsPublisher(const ContainerApi *lmctfy, StatsShmWriter *writer)
+      : StatsPublisher(lmctfy, writer, Container::STATS_FULL) {}
+
+ protected:
+  int64 NowNs() const override { return kNow; }
+};
+
+// Returns stats with the specified CPU usage.
+ContainerStats MakeStats(uint64 cpu_usage) {
+  ContainerStats stats;
+  stats.mutable_cpu()->mutable_usage()->set_total(cpu_usage);
+  return stats;
+}
+
+class StatsPublisherTest : public ::testing::Test {
+ protected:
+  StatsPublisherTest()
+      : test_dir_(JoinPath(FLAGS_test_tmpdir, "stats_publisher_test")),
+        path_(JoinPath(test_dir_, "stats")) {}
+
+  void SetUp() override {
+    StatusOr<StatsShmWriter *> writer_statusor =
+        StatsShmWriter::New(path_, 16, 1024, Container::STATS_FULL);
+    ASSERT_OK(writer_statusor);
+    publisher_.reset(
+        new TestStatsPublisher(&mock_lmctfy_, writer_statusor.ValueOrDie()));
+
+    StatusOr<StatsShmReader *> reader_statusor = StatsShmReader::Open(path_);
+    ASSERT_OK(reader_statusor);
+    reader_.reset(reader_statusor.ValueOrDie());
+  }
+
+  void TearDown() override {
+    reader_.reset();
+    publisher_.reset();
+    CHECK_EQ(0, system(Substitute("rm -rf $0", test_dir_).c_str()));
+  }
+
+  // Expects the listed containers to be the subcontainers of the root.
+  void ExpectList(const vector<string> &subcontainer_names) {
+    StrictMockContainer *root = new StrictMockContainer("/");
+    vector<Container *> subcontainers;
+    for (const string &name : subcontainer_names) {
+      subcontainers.push_back(new StrictMockContainer(name));
+    }
+    EXPECT_CALL(mock_lmctfy_, Get(StringPiece("/")))
+        .WillOnce(Return(root));
+    EXPECT_CALL(*root, ListSubcontainers(Container::LIST_RECURSIVE))
+        .WillOnce(Return(subcontainers));
+  }
+
+  StatsShmReader::Record Read(const string &container_name) {
+    StatusOr<StatsShmReader::Record> statusor = reader_->Read(container_name);
+    CHECK(statusor.ok()) << statusor.status().ToString();
+    return statusor.ValueOrDie();
+  }
+
+  const string test_dir_;
+  const string path_;
+  StrictMockContainerApi mock_lmctfy_;
+  unique_ptr<StatsPublisher> publisher_;
+  unique_ptr<StatsShmReader> reader_;
+};
+
+TEST_F(StatsPublisherTest, PublishesAllContainers) {
+  ExpectList({"/a", "/a/b"});
+  const map<string, ContainerStats> stats = {
+      {"/", MakeStats(1)}, {"/a", MakeStats(2)}, {"/a/b", MakeStats(3)}};
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre("/", "/a", "/a/b"),
+                                      Container::STATS_FULL, _))
+      .WillOnce(Return(stats));
+
+  ASSERT_OK(publisher_->Publish());
+
+  EXPECT_EQ(1, reader_->generation());
+  EXPECT_EQ(kNow, reader_->publish_time_ns());
+  for (const auto &name_stats : stats) {
+    const StatsShmReader::Record record = Read(name_stats.first);
+    EXPECT_THAT(record.stats, EqualsInitializedProto(name_stats.second));
+    EXPECT_EQ(kNow, record.time_ns);
+  }
+}
+
+TEST_F(StatsPublisherTest, RemovesContainersThatAreGone) {
+  ExpectList({"/a"});
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre("/", "/a"), _, _))
+      .WillOnce(Return(map<string, ContainerStats>(
+          {{"/", MakeStats(1)}, {"/a", MakeStats(2)}})));
+  ASSERT_OK(publisher_->Publish());
+
+  // "/a" is destroyed between the listing and the stats.
+  ExpectList({"/a"});
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre("/", "/a"), _, _))
+      .WillOnce(Return(map<string, ContainerStats>({{"/", MakeStats(3)}})));
+  ASSERT_OK(publisher_->Publish());
+
+  EXPECT_EQ(2, reader_->generation());
+  EXPECT_THAT(Read("/").stats, EqualsInitializedProto(MakeStats(3)));
+  EXPECT_EQ(2, Read("/").version);
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, reader_->Read("/a"));
+}
+
+TEST_F(StatsPublisherTest, KeepsContainersWhoseStatsFail) {
+  ExpectList({"/a"});
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre("/", "/a"), _, _))
+      .WillOnce(Return(map<string, ContainerStats>(
+          {{"/", MakeStats(1)}, {"/a", MakeStats(2)}})));
+  ASSERT_OK(publisher_->Publish());
+
+  // The stats of "/a" can't be read this round.
+  ExpectList({"/a"});
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre("/", "/a"), _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(map<string, Status>(
+                          {{"/a", Status::CANCELLED}})),
+                      Return(map<string, ContainerStats>(
+                          {{"/", MakeStats(3)}}))));
+  ASSERT_OK(publisher_->Publish());
+
+  EXPECT_EQ(2, reader_->generation());
+  EXPECT_THAT(Read("/").stats, EqualsInitializedProto(MakeStats(3)));
+  EXPECT_THAT(Read("/a").stats, EqualsInitializedProto(MakeStats(2)));
+  EXPECT_EQ(1, Read("/a").version);
+}
+
+TEST_F(StatsPublisherTest, GetRootFails) {
+  EXPECT_CALL(mock_lmctfy_, Get(StringPiece("/")))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED, publisher_->Publish());
+  EXPECT_EQ(0, reader_->generation());
+}
+
+TEST_F(StatsPublisherTest, StatsManyFails) {
+  ExpectList({});
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre("/"), _, _))
+      .WillOnce(Return(Status::CANCELLED));
+
+  EXPECT_EQ(Status::CANCELLED, publisher_->Publish());
+  EXPECT_EQ(0, reader_->generation());
+}
+
+}  // namespace
+}  // namespace lmctfy
+}  // namespace containers
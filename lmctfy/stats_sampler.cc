@@ -0,0 +1,383 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/stats_sampler.h"
+
+#include <errno.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+
+#include "base/callback.h"
+#include "base/logging.h"
+#include "thread/thread_options.h"
+#include "util/errors.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+using ::std::map;
+using ::std::sort;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+static const int64 kNanosPerSecond = 1000000000;
+
+StatsSampler::StatsSampler(const ContainerApi *lmctfy, int ring_size,
+                           int64 sample_interval_ms, int max_idle_samples)
+    : lmctfy_(CHECK_NOTNULL(lmctfy)),
+      ring_size_(ring_size),
+      sample_interval_ms_(sample_interval_ms),
+      max_idle_samples_(max_idle_samples),
+      stopping_(false) {
+  CHECK_GE(ring_size_, 2);
+  CHECK_EQ(0, pthread_mutex_init(&stop_mutex_, nullptr));
+  CHECK_EQ(0, pthread_cond_init(&stop_cond_, nullptr));
+}
+
+StatsSampler::~StatsSampler() {
+  pthread_mutex_lock(&stop_mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&stop_cond_);
+  pthread_mutex_unlock(&stop_mutex_);
+
+  if (thread_ != nullptr) {
+    thread_->Join();
+  }
+
+  pthread_cond_destroy(&stop_cond_);
+  pthread_mutex_destroy(&stop_mutex_);
+}
+
+void StatsSampler::Start() {
+  CHECK(thread_ == nullptr) << "Sampler already started";
+
+  ::thread::Options options;
+  options.set_joinable(true);
+  thread_.reset(new ClosureThread(
+      options, "StatsSampler", NewPermanentCallback(this, &StatsSampler::Run)));
+  thread_->Start();
+}
+
+void StatsSampler::Run() {
+  pthread_mutex_lock(&stop_mutex_);
+  while (!stopping_) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    const int64 deadline_ns = deadline.tv_nsec +
+                              sample_interval_ms_ * (kNanosPerSecond / 1000);
+    deadline.tv_sec += deadline_ns / kNanosPerSecond;
+    deadline.tv_nsec = deadline_ns % kNanosPerSecond;
+
+    int ret = 0;
+    while (!stopping_ && ret != ETIMEDOUT) {
+      ret = pthread_cond_timedwait(&stop_cond_, &stop_mutex_, &deadline);
+    }
+    if (stopping_) {
+      break;
+    }
+    pthread_mutex_unlock(&stop_mutex_);
+
+    Status status = SampleAll();
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to sample container stats: "
+                   << status.ToString();
+    }
+
+    pthread_mutex_lock(&stop_mutex_);
+  }
+  pthread_mutex_unlock(&stop_mutex_);
+}
+
+Status StatsSampler::AddContainer(const string &container_name) {
+  {
+    MutexLock l(&lock_);
+    if (rings_.find(container_name) != rings_.end()) {
+      return Status::OK;
+    }
+  }
+
+  // Take the first sample outside of the lock.
+  map<string, ContainerStats> stats = RETURN_IF_ERROR(
+      lmctfy_->StatsMany({container_name}, Container::STATS_FULL));
+  auto stats_it = stats.find(container_name);
+  if (stats_it == stats.end()) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("Can't sample non-existent container \"$0\"",
+                             container_name));
+  }
+  const Sample sample = ToSample(stats_it->second, NowNs());
+
+  MutexLock l(&lock_);
+  unique_ptr<SampleRing> &ring = rings_[container_name];
+  if (ring == nullptr) {
+    ring.reset(new SampleRing(ring_size_));
+    AddSample(sample, ring.get());
+  }
+  return Status::OK;
+}
+
+void StatsSampler::RemoveContainer(const string &container_name) {
+  MutexLock l(&lock_);
+  rings_.erase(container_name);
+}
+
+Status StatsSampler::SampleAll() {
+  vector<string> container_names;
+  {
+    MutexLock l(&lock_);
+    for (const auto &name_ring_pair : rings_) {
+      container_names.push_back(name_ring_pair.first);
+    }
+  }
+  if (container_names.empty()) {
+    return Status::OK;
+  }
+
+  // Get the stats of all containers outside of the lock.
+  map<string, Status> errors;
+  map<string, ContainerStats> stats = RETURN_IF_ERROR(
+      lmctfy_->StatsMany(container_names, Container::STATS_FULL, &errors));
+  const int64 now = NowNs();
+
+  MutexLock l(&lock_);
+  for (const string &container_name : container_names) {
+    auto ring_it = rings_.find(container_name);
+    if (ring_it == rings_.end()) {
+      // Removed while we were sampling.
+      continue;
+    }
+    SampleRing *ring = ring_it->second.get();
+
+    // Containers whose stats can't be read this time miss a sample.
+    auto stats_it = stats.find(container_name);
+    if (stats_it == stats.end() &&
+        errors.find(container_name) != errors.end()) {
+      continue;
+    }
+
+    // Stop sampling containers that are gone or that nobody is reading.
+    if (stats_it == stats.end() ||
+        (max_idle_samples_ > 0 && ring->idle_samples >= max_idle_samples_)) {
+      rings_.erase(ring_it);
+      continue;
+    }
+
+    AddSample(ToSample(stats_it->second, now), ring);
+  }
+
+  return Status::OK;
+}
+
+StatusOr<ContainerStatsRates> StatsSampler::GetRates(
+    const string &container_name) {
+  vector<Sample> samples;
+  {
+    MutexLock l(&lock_);
+    auto ring_it = rings_.find(container_name);
+    if (ring_it == rings_.end()) {
+      return Status(::util::error::NOT_FOUND,
+                    Substitute("Container \"$0\" is not being sampled",
+                               container_name));
+    }
+    SampleRing *ring = ring_it->second.get();
+    ring->idle_samples = 0;
+
+    // Copy the samples out oldest first.
+    const int size = ring->samples.size();
+    for (int i = 0; i < ring->count; ++i) {
+      samples.push_back(
+          ring->samples[(ring->next - ring->count + i + size) % size]);
+    }
+  }
+
+  if (samples.size() < 2) {
+    return Status(
+        ::util::error::UNAVAILABLE,
+        Substitute("Not enough samples of container \"$0\" yet, try again "
+                   "after $1ms",
+                   container_name, sample_interval_ms_));
+  }
+
+  return ComputeRates(samples);
+}
+
+void StatsSampler::AddSample(const Sample &sample, SampleRing *ring) {
+  ring->samples[ring->next] = sample;
+  ring->next = (ring->next + 1) % ring->samples.size();
+  if (ring->count < ring->samples.size()) {
+    ++ring->count;
+  }
+  ++ring->idle_samples;
+}
+
+int64 StatsSampler::NowNs() const {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * kNanosPerSecond + now.tv_nsec;
+}
+
+StatsSampler::Sample StatsSampler::ToSample(const ContainerStats &stats,
+                                            int64 time) {
+  Sample sample;
+  sample.time = time;
+
+  if (stats.has_cpu()) {
+    const CpuStats &cpu = stats.cpu();
+    sample.has_cpu = true;
+    sample.cpu_usage = cpu.usage().total();
+    sample.per_cpu_usage.assign(cpu.usage().per_cpu().begin(),
+                                cpu.usage().per_cpu().end());
+    sample.throttling_periods = cpu.throttling_data().periods();
+    sample.throttled_periods = cpu.throttling_data().throttled_periods();
+    sample.throttled_time = cpu.throttling_data().throttled_time();
+  }
+
+  if (stats.has_memory()) {
+    const MemoryStats &memory = stats.memory();
+    // Prefer the data of the whole subtree, like the CPU usage.
+    const MemoryStats::MemoryData &data = memory.has_hierarchical_data()
+                                              ? memory.hierarchical_data()
+                                              : memory.container_data();
+    sample.has_memory = true;
+    sample.page_faults = data.pgfault();
+    sample.major_page_faults = data.pgmajfault();
+    sample.memory_fail_count = memory.fail_count();
+  }
+
+  return sample;
+}
+
+// Returns how much the counter increased, 0 if it went backwards (e.g.: it was
+// reset).
+template <typename T>
+static T Increase(T before, T after) {
+  return after > before ? after - before : 0;
+}
+
+// Fills percentiles with the nearest-rank percentiles of values.
+static void SetPercentiles(vector<double> values,
+                           RatePercentiles *percentiles) {
+  if (values.empty()) {
+    return;
+  }
+
+  sort(values.begin(), values.end());
+  auto percentile = [&values](double p) {
+    const int rank = static_cast<int>(::std::ceil(p * values.size()));
+    return values[::std::max(rank, 1) - 1];
+  };
+  percentiles->set_p50(percentile(0.50));
+  percentiles->set_p90(percentile(0.90));
+  percentiles->set_p99(percentile(0.99));
+  percentiles->set_max(values.back());
+}
+
+ContainerStatsRates StatsSampler::ComputeRates(const vector<Sample> &samples) {
+  ContainerStatsRates rates;
+  rates.set_num_samples(samples.size());
+  if (samples.size() < 2) {
+    return rates;
+  }
+
+  const Sample &first = samples.front();
+  const Sample &last = samples.back();
+  const int64 window = last.time - first.time;
+  rates.set_window(window);
+  if (window <= 0) {
+    return rates;
+  }
+  const double window_secs = static_cast<double>(window) / kNanosPerSecond;
+
+  // Sum the increases of each interval so that counter resets in the middle of
+  // the window are skipped.
+  uint64 cpu_usage = 0;
+  int64 throttling_periods = 0;
+  int64 throttled_periods = 0;
+  int64 throttled_time = 0;
+  int64 page_faults = 0;
+  int64 major_page_faults = 0;
+  int64 memory_fail_count = 0;
+  vector<double> cores_used;
+  vector<double> page_fault_rates;
+  for (int i = 1; i < samples.size(); ++i) {
+    const Sample &before = samples[i - 1];
+    const Sample &after = samples[i];
+    const int64 interval = after.time - before.time;
+    if (interval <= 0) {
+      continue;
+    }
+
+    if (before.has_cpu && after.has_cpu) {
+      const uint64 usage = Increase(before.cpu_usage, after.cpu_usage);
+      cpu_usage += usage;
+      cores_used.push_back(static_cast<double>(usage) / interval);
+      throttling_periods +=
+          Increase(before.throttling_periods, after.throttling_periods);
+      throttled_periods +=
+          Increase(before.throttled_periods, after.throttled_periods);
+      throttled_time += Increase(before.throttled_time, after.throttled_time);
+    }
+
+    if (before.has_memory && after.has_memory) {
+      const int64 faults = Increase(before.page_faults, after.page_faults);
+      page_faults += faults;
+      page_fault_rates.push_back(faults * static_cast<double>(kNanosPerSecond) /
+                                 interval);
+      major_page_faults +=
+          Increase(before.major_page_faults, after.major_page_faults);
+      memory_fail_count +=
+          Increase(before.memory_fail_count, after.memory_fail_count);
+    }
+  }
+
+  if (last.has_cpu) {
+    ContainerStatsRates::CpuRates *cpu = rates.mutable_cpu();
+    cpu->set_cores_used(static_cast<double>(cpu_usage) / window);
+    SetPercentiles(cores_used, cpu->mutable_cores_used_percentiles());
+    if (first.per_cpu_usage.size() == last.per_cpu_usage.size()) {
+      for (int i = 0; i < last.per_cpu_usage.size(); ++i) {
+        cpu->add_per_cpu_cores_used(
+            static_cast<double>(
+                Increase(first.per_cpu_usage[i], last.per_cpu_usage[i])) /
+            window);
+      }
+    }
+    if (throttling_periods > 0) {
+      cpu->set_throttle_ratio(static_cast<double>(throttled_periods) /
+                              throttling_periods);
+    }
+    cpu->set_throttled_time_ratio(static_cast<double>(throttled_time) /
+                                  window);
+  }
+
+  if (last.has_memory) {
+    ContainerStatsRates::MemoryRates *memory = rates.mutable_memory();
+    memory->set_page_fault_rate(page_faults / window_secs);
+    SetPercentiles(page_fault_rates,
+                   memory->mutable_page_fault_rate_percentiles());
+    memory->set_major_page_fault_rate(major_page_faults / window_secs);
+    memory->set_fail_count_rate(memory_fail_count / window_secs);
+  }
+
+  return rates;
+}
+
+}  // namespace lmctfy
+}  // namespace containers
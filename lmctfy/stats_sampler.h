@@ -0,0 +1,181 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_STATS_SAMPLER_H_
+#define SRC_STATS_SAMPLER_H_
+
+#include <pthread.h>
+#include <map>
+#include <memory>
+#include <string>
+using ::std::string;
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "include/lmctfy.h"
+#include "include/lmctfy.pb.h"
+#include "thread/thread.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace lmctfy {
+
+// Periodically samples the stats of selected containers and computes rates
+// from them (e.g.: CPU cores used, throttle ratio, page fault rate).
+//
+// Each container keeps its latest samples in a fixed-size ring buffer and its
+// rates are computed over all the samples in it. All containers are sampled
+// with a single ContainerApi::StatsMany() call, containers whose stats fail miss
+// that sample. Containers stop being sampled when they no longer exist or when
+// their rates have not been read in a while.
+//
+// Class is thread-safe.
+class StatsSampler {
+ public:
+  // The counters of a container at one point in time.
+  struct Sample {
+    Sample()
+        : time(0),
+          has_cpu(false),
+          cpu_usage(0),
+          throttling_periods(0),
+          throttled_periods(0),
+          throttled_time(0),
+          has_memory(false),
+          page_faults(0),
+          major_page_faults(0),
+          memory_fail_count(0) {}
+
+    // Units: nanoseconds, on a monotonic clock.
+    int64 time;
+
+    bool has_cpu;
+    // Units: nanoseconds.
+    uint64 cpu_usage;
+    ::std::vector<int64> per_cpu_usage;
+    int64 throttling_periods;
+    int64 throttled_periods;
+    // Units: nanoseconds.
+    int64 throttled_time;
+
+    bool has_memory;
+    int64 page_faults;
+    int64 major_page_faults;
+    int64 memory_fail_count;
+  };
+
+  // Arguments:
+  //   lmctfy: Used to get the stats of the containers. Does not take
+  //       ownership.
+  //   ring_size: Number of samples kept for each container. At least 2.
+  //   sample_interval_ms: Time between samples taken in the background.
+  //   max_idle_samples: Containers whose rates are not read for this many
+  //       samples stop being sampled. 0 samples them until they are gone.
+  StatsSampler(const ContainerApi *lmctfy, int ring_size,
+               int64 sample_interval_ms, int max_idle_samples);
+  virtual ~StatsSampler();
+
+  // Starts taking a sample every sample_interval_ms in a background thread.
+  // Must be called at most once. Sampling stops on destruction.
+  void Start();
+
+  // Starts sampling the specified container and takes its first sample. No-op
+  // if the container is already being sampled.
+  //
+  // Arguments:
+  //   container_name: The absolute name of the container.
+  // Return:
+  //   Status: OK iff the container is being sampled.
+  ::util::Status AddContainer(const string &container_name)
+      LOCKS_EXCLUDED(lock_);
+
+  // Stops sampling the specified container.
+  void RemoveContainer(const string &container_name) LOCKS_EXCLUDED(lock_);
+
+  // Takes a sample of all the sampled containers.
+  ::util::Status SampleAll() LOCKS_EXCLUDED(lock_);
+
+  // Gets the rates of the specified container over its samples.
+  //
+  // Arguments:
+  //   container_name: The absolute name of the container.
+  // Return:
+  //   StatusOr: OK iff the rates were computed. NOT_FOUND if the container
+  //       is not being sampled and UNAVAILABLE if it has less than two
+  //       samples.
+  ::util::StatusOr<ContainerStatsRates> GetRates(const string &container_name)
+      LOCKS_EXCLUDED(lock_);
+
+  // Extracts the counters rates are computed from out of the stats.
+  static Sample ToSample(const ContainerStats &stats, int64 time);
+
+  // Computes the rates over the samples, ordered oldest first. Intervals in
+  // which a counter went backwards are not counted for that counter.
+  static ContainerStatsRates ComputeRates(const ::std::vector<Sample> &samples);
+
+ protected:
+  // Gets the current time in nanoseconds. Virtual for testing.
+  virtual int64 NowNs() const;
+
+ private:
+  // Fixed-size ring buffer of the samples of a container.
+  struct SampleRing {
+    explicit SampleRing(int size)
+        : samples(size), next(0), count(0), idle_samples(0) {}
+
+    ::std::vector<Sample> samples;
+    // Index of the slot the next sample is written to.
+    int next;
+    // Number of valid samples.
+    int count;
+    // Samples taken since the rates were last read.
+    int idle_samples;
+  };
+
+  // Adds the sample to the ring, overwriting the oldest sample if it is full.
+  static void AddSample(const Sample &sample, SampleRing *ring);
+
+  // Body of the background thread.
+  void Run();
+
+  const ContainerApi *lmctfy_;
+  const int ring_size_;
+  const int64 sample_interval_ms_;
+  const int max_idle_samples_;
+
+  // Map of absolute container name to its samples.
+  ::std::map<string, ::std::unique_ptr<SampleRing>> rings_ GUARDED_BY(lock_);
+  Mutex lock_;
+
+  ::std::unique_ptr<ClosureThread> thread_;
+
+  // Whether the background thread should exit.
+  bool stopping_;
+
+  // Protects stopping_.
+  pthread_mutex_t stop_mutex_;
+
+  // Signalled when the background thread should exit.
+  pthread_cond_t stop_cond_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatsSampler);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_STATS_SAMPLER_H_
@@ -0,0 +1,277 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/stats_sampler.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "include/lmctfy_mock.h"
+#include "util/errors_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+
+using ::std::map;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::testing::ElementsAre;
+using ::testing::DoAll;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+using ::testing::_;
+using ::util::Status;
+using ::util::StatusOr;
+using ::util::error::NOT_FOUND;
+using ::util::error::UNAVAILABLE;
+
+namespace containers {
+namespace lmctfy {
+namespace {
+
+static const char kContainerName[] = "/test";
+static const int kRingSize = 3;
+static const int kMaxIdleSamples = 5;
+static const int64 kSecond = 1000000000;
+
+// StatsSampler whose clock advances one second on every sample.
+class TestStatsSampler : public StatsSampler {
+ public:
+  TestStatsSampler(const ContainerApi *lmctfy, int max_idle_samples)
+      : StatsSampler(lmctfy, kRingSize, 1000, max_idle_samples), now_(0) {}
+
+ protected:
+  int64 NowNs() const override {
+    now_ += kSecond;
+    return now_;
+  }
+
+ private:
+  mutable int64 now_;
+};
+
+// Returns stats with the specified CPU usage (in seconds) and page faults.
+ContainerStats MakeStats(int64 cpu_usage_secs, int64 page_faults) {
+  ContainerStats stats;
+  stats.mutable_cpu()->mutable_usage()->set_total(cpu_usage_secs * kSecond);
+  stats.mutable_memory()->mutable_container_data()->set_pgfault(page_faults);
+  return stats;
+}
+
+class StatsSamplerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    sampler_.reset(new TestStatsSampler(&mock_lmctfy_, kMaxIdleSamples));
+  }
+
+  // Expect the next sample of the container to return stats.
+  void ExpectSample(const ContainerStats &stats) {
+    const map<string, ContainerStats> output = {{kContainerName, stats}};
+    EXPECT_CALL(mock_lmctfy_,
+                StatsMany(ElementsAre(kContainerName),
+                          Container::STATS_FULL, _))
+        .WillOnce(Return(output))
+        .RetiresOnSaturation();
+  }
+
+ protected:
+  StrictMockContainerApi mock_lmctfy_;
+  unique_ptr<StatsSampler> sampler_;
+};
+
+// Creates a sample at the specified time (in seconds) with the specified CPU
+// usage (in seconds).
+StatsSampler::Sample MakeSample(int64 time_secs, int64 cpu_usage_secs) {
+  StatsSampler::Sample sample;
+  sample.time = time_secs * kSecond;
+  sample.has_cpu = true;
+  sample.cpu_usage = cpu_usage_secs * kSecond;
+  return sample;
+}
+
+TEST(ComputeRatesTest, CpuRates) {
+  vector<StatsSampler::Sample> samples = {MakeSample(0, 0), MakeSample(1, 1),
+                                          MakeSample(2, 4)};
+  samples[0].per_cpu_usage = {0, 0};
+  samples[2].per_cpu_usage = {2 * kSecond, 2 * kSecond};
+  samples[0].throttling_periods = 10;
+  samples[1].throttling_periods = 20;
+  samples[2].throttling_periods = 30;
+  samples[2].throttled_periods = 5;
+  samples[2].throttled_time = kSecond / 2;
+
+  ContainerStatsRates rates = StatsSampler::ComputeRates(samples);
+  EXPECT_EQ(2 * kSecond, rates.window());
+  EXPECT_EQ(3, rates.num_samples());
+  EXPECT_DOUBLE_EQ(2.0, rates.cpu().cores_used());
+  EXPECT_DOUBLE_EQ(1.0, rates.cpu().cores_used_percentiles().p50());
+  EXPECT_DOUBLE_EQ(3.0, rates.cpu().cores_used_percentiles().p99());
+  EXPECT_DOUBLE_EQ(3.0, rates.cpu().cores_used_percentiles().max());
+  ASSERT_EQ(2, rates.cpu().per_cpu_cores_used_size());
+  EXPECT_DOUBLE_EQ(1.0, rates.cpu().per_cpu_cores_used(0));
+  EXPECT_DOUBLE_EQ(0.25, rates.cpu().throttle_ratio());
+  EXPECT_DOUBLE_EQ(0.25, rates.cpu().throttled_time_ratio());
+  EXPECT_FALSE(rates.has_memory());
+}
+
+TEST(ComputeRatesTest, CounterResetIsSkipped) {
+  const vector<StatsSampler::Sample> samples = {
+      MakeSample(0, 10), MakeSample(1, 0), MakeSample(2, 1)};
+
+  ContainerStatsRates rates = StatsSampler::ComputeRates(samples);
+  EXPECT_DOUBLE_EQ(0.5, rates.cpu().cores_used());
+  EXPECT_DOUBLE_EQ(0.0, rates.cpu().cores_used_percentiles().p50());
+}
+
+TEST(ComputeRatesTest, MemoryRates) {
+  vector<StatsSampler::Sample> samples(3);
+  for (int i = 0; i < samples.size(); ++i) {
+    samples[i].time = i * 2 * kSecond;
+    samples[i].has_memory = true;
+    samples[i].page_faults = i * 100;
+    samples[i].major_page_faults = i * 10;
+    samples[i].memory_fail_count = i;
+  }
+
+  ContainerStatsRates rates = StatsSampler::ComputeRates(samples);
+  EXPECT_FALSE(rates.has_cpu());
+  EXPECT_DOUBLE_EQ(50.0, rates.memory().page_fault_rate());
+  EXPECT_DOUBLE_EQ(50.0, rates.memory().page_fault_rate_percentiles().max());
+  EXPECT_DOUBLE_EQ(5.0, rates.memory().major_page_fault_rate());
+  EXPECT_DOUBLE_EQ(0.5, rates.memory().fail_count_rate());
+}
+
+TEST(ComputeRatesTest, NotEnoughSamples) {
+  ContainerStatsRates rates =
+      StatsSampler::ComputeRates({MakeSample(0, 0)});
+  EXPECT_EQ(1, rates.num_samples());
+  EXPECT_FALSE(rates.has_window());
+  EXPECT_FALSE(rates.has_cpu());
+}
+
+TEST_F(StatsSamplerTest, GetRates) {
+  ExpectSample(MakeStats(0, 0));
+  ASSERT_OK(sampler_->AddContainer(kContainerName));
+
+  // One sample is not enough.
+  EXPECT_ERROR_CODE(UNAVAILABLE, sampler_->GetRates(kContainerName));
+
+  ExpectSample(MakeStats(2, 100));
+  ASSERT_OK(sampler_->SampleAll());
+
+  StatusOr<ContainerStatsRates> statusor = sampler_->GetRates(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(kSecond, statusor.ValueOrDie().window());
+  EXPECT_DOUBLE_EQ(2.0, statusor.ValueOrDie().cpu().cores_used());
+  EXPECT_DOUBLE_EQ(100.0, statusor.ValueOrDie().memory().page_fault_rate());
+}
+
+TEST_F(StatsSamplerTest, AddContainerTwice) {
+  ExpectSample(MakeStats(0, 0));
+  ASSERT_OK(sampler_->AddContainer(kContainerName));
+  EXPECT_OK(sampler_->AddContainer(kContainerName));
+}
+
+TEST_F(StatsSamplerTest, AddContainerDoesNotExist) {
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre(kContainerName), _, _))
+      .WillOnce(Return(map<string, ContainerStats>()));
+
+  EXPECT_ERROR_CODE(NOT_FOUND, sampler_->AddContainer(kContainerName));
+  EXPECT_ERROR_CODE(NOT_FOUND, sampler_->GetRates(kContainerName));
+}
+
+TEST_F(StatsSamplerTest, AddContainerFails) {
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre(kContainerName), _, _))
+      .WillOnce(Return(Status(::util::error::INTERNAL, "")));
+
+  EXPECT_FALSE(sampler_->AddContainer(kContainerName).ok());
+}
+
+TEST_F(StatsSamplerTest, RingKeepsLatestSamples) {
+  ExpectSample(MakeStats(0, 0));
+  ASSERT_OK(sampler_->AddContainer(kContainerName));
+  ExpectSample(MakeStats(1, 0));
+  ASSERT_OK(sampler_->SampleAll());
+  ExpectSample(MakeStats(2, 0));
+  ASSERT_OK(sampler_->SampleAll());
+  ExpectSample(MakeStats(5, 0));
+  ASSERT_OK(sampler_->SampleAll());
+
+  // The first sample was overwritten.
+  StatusOr<ContainerStatsRates> statusor = sampler_->GetRates(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(kRingSize, statusor.ValueOrDie().num_samples());
+  EXPECT_DOUBLE_EQ(2.0, statusor.ValueOrDie().cpu().cores_used());
+}
+
+TEST_F(StatsSamplerTest, DestroyedContainerStopsBeingSampled) {
+  ExpectSample(MakeStats(0, 0));
+  ASSERT_OK(sampler_->AddContainer(kContainerName));
+
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre(kContainerName), _, _))
+      .WillOnce(Return(map<string, ContainerStats>()));
+  ASSERT_OK(sampler_->SampleAll());
+
+  EXPECT_ERROR_CODE(NOT_FOUND, sampler_->GetRates(kContainerName));
+}
+
+TEST_F(StatsSamplerTest, FailedSampleIsSkipped) {
+  ExpectSample(MakeStats(0, 0));
+  ASSERT_OK(sampler_->AddContainer(kContainerName));
+
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre(kContainerName), _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(map<string, Status>(
+                          {{kContainerName, Status::CANCELLED}})),
+                      Return(map<string, ContainerStats>())));
+  ASSERT_OK(sampler_->SampleAll());
+
+  // The container is still sampled.
+  ExpectSample(MakeStats(1, 0));
+  ASSERT_OK(sampler_->SampleAll());
+  StatusOr<ContainerStatsRates> statusor = sampler_->GetRates(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_EQ(2, statusor.ValueOrDie().num_samples());
+}
+
+TEST_F(StatsSamplerTest, IdleContainerStopsBeingSampled) {
+  sampler_.reset(new TestStatsSampler(&mock_lmctfy_, 2));
+  ExpectSample(MakeStats(0, 0));
+  ASSERT_OK(sampler_->AddContainer(kContainerName));
+  ExpectSample(MakeStats(1, 0));
+  ASSERT_OK(sampler_->SampleAll());
+
+  // Nobody read the rates for 2 samples.
+  EXPECT_CALL(mock_lmctfy_, StatsMany(ElementsAre(kContainerName), _, _))
+      .WillOnce(Return(map<string, ContainerStats>(
+          {{kContainerName, MakeStats(2, 0)}})));
+  ASSERT_OK(sampler_->SampleAll());
+
+  EXPECT_ERROR_CODE(NOT_FOUND, sampler_->GetRates(kContainerName));
+}
+
+TEST_F(StatsSamplerTest, RemoveContainer) {
+  ExpectSample(MakeStats(0, 0));
+  ASSERT_OK(sampler_->AddContainer(kContainerName));
+
+  sampler_->RemoveContainer(kContainerName);
+
+  // Nothing left to sample.
+  EXPECT_OK(sampler_->SampleAll());
+  EXPECT_ERROR_CODE(NOT_FOUND, sampler_->GetRates(kContainerName));
+}
+
+}  // namespace
+}  // namespace lmctfy
+}  // namespace containers
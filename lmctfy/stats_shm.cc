@@ -0,0 +1,468 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/stats_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "base/logging.h"
+#include "file/base/path.h"
+#include "util/errors.h"
+#include "util/scoped_cleanup.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+using ::std::atomic;
+using ::std::make_pair;
+using ::std::memory_order_acquire;
+using ::std::memory_order_relaxed;
+using ::std::memory_order_release;
+using ::std::vector;
+using ::strings::Substitute;
+using ::util::ScopedCleanup;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+namespace {
+
+// The layouts below are documented in the header, keep them in sync.
+
+struct Header {
+  uint64 magic;
+  uint32 layout_version;
+  uint32 header_size;
+  uint32 num_slots;
+  uint32 slot_size;
+  uint32 stats_type;
+  atomic<uint32> retired;
+  atomic<uint64> generation;
+  atomic<int64> publish_time_ns;
+};
+
+enum SlotState {
+  SLOT_EMPTY = 0,
+  SLOT_VALID = 1,
+  SLOT_REMOVED = 2,
+  SLOT_OVERSIZED = 3,
+};
+
+struct SlotHeader {
+  atomic<uint64> seq;
+  uint32 state;
+  uint32 name_length;
+  uint32 stats_length;
+  uint32 reserved;
+  uint64 version;
+  uint64 generation;
+  int64 time_ns;
+  char name[kStatsShmMaxNameLength];
+};
+
+static_assert(sizeof(atomic<uint64>) == sizeof(uint64) &&
+                  sizeof(atomic<uint32>) == sizeof(uint32),
+              "Atomics must be lock-free to be shared between processes");
+static_assert(sizeof(Header) == 48, "Header layout changed");
+static_assert(sizeof(Header) <= kStatsShmHeaderSize, "Header too large");
+static_assert(sizeof(SlotHeader) == 48 + kStatsShmMaxNameLength,
+              "SlotHeader layout changed");
+
+// Readers retry a slot that is being written at most this many times.
+const int kMaxReadAttempts = 10000;
+
+// Gets the slot at the specified index.
+const SlotHeader *GetSlot(const char *map, uint32 slot_size, uint32 index) {
+  return reinterpret_cast<const SlotHeader *>(
+      map + kStatsShmHeaderSize + static_cast<size_t>(index) * slot_size);
+}
+SlotHeader *GetSlot(char *map, uint32 slot_size, uint32 index) {
+  return reinterpret_cast<SlotHeader *>(
+      map + kStatsShmHeaderSize + static_cast<size_t>(index) * slot_size);
+}
+
+// Gets the slot a probe for the name starts at.
+uint32 FirstSlot(const string &name, uint32 num_slots) {
+  // FNV-1a, so that the publisher and readers agree across binaries.
+  uint64 hash = 14695981039346656037ULL;
+  for (char c : name) {
+    hash ^= static_cast<uint8>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash % num_slots;
+}
+
+// Returns an error for the failure of the operation on the file in errno.
+Status FileError(const string &operation, const string &path) {
+  return Status(errno == ENOENT ? ::util::error::NOT_FOUND
+                                : ::util::error::INTERNAL,
+                Substitute("Failed to $0 \"$1\": $2", operation, path,
+                           StrError(errno)));
+}
+
+// Marks the stats file at path as retired, if there is one.
+void RetireFile(const string &path) {
+  const int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  ScopedCleanup close_fd([fd]() { close(fd); });
+
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0 || statbuf.st_size < kStatsShmHeaderSize) {
+    return;
+  }
+  void *map = mmap(nullptr, kStatsShmHeaderSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    return;
+  }
+  Header *header = static_cast<Header *>(map);
+  if (header->magic == kStatsShmMagic) {
+    header->retired.store(1, memory_order_release);
+  }
+  munmap(map, kStatsShmHeaderSize);
+}
+
+}  // namespace
+
+StatusOr<StatsShmWriter *> StatsShmWriter::New(const string &path,
+                                               int num_slots, int slot_size,
+                                               Container::StatsType type) {
+  if (num_slots <= 0 || slot_size % 64 != 0 ||
+      slot_size <= static_cast<int>(sizeof(SlotHeader))) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  Substitute("Invalid stats file geometry: $0 slots of $1 "
+                             "bytes",
+                             num_slots, slot_size));
+  }
+
+  const string dir = ::file::Dirname(path).ToString();
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    return FileError("create directory", dir);
+  }
+
+  // Build the file aside so that readers never see it half initialized.
+  const string tmp_path = Substitute("$0.$1.tmp", path, getpid());
+  const int fd =
+      open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return FileError("create", tmp_path);
+  }
+  ScopedCleanup close_fd([fd]() { close(fd); });
+  ScopedCleanup unlink_tmp([&tmp_path]() { unlink(tmp_path.c_str()); });
+
+  // The file is sparse, slots only take memory once written.
+  const size_t map_size =
+      kStatsShmHeaderSize + static_cast<size_t>(num_slots) * slot_size;
+  if (ftruncate(fd, map_size) != 0) {
+    return FileError("resize", tmp_path);
+  }
+  void *map =
+      mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    return FileError("map", tmp_path);
+  }
+  ScopedCleanup unmap([map, map_size]() { munmap(map, map_size); });
+
+  Header *header = static_cast<Header *>(map);
+  header->magic = kStatsShmMagic;
+  header->layout_version = kStatsShmLayoutVersion;
+  header->header_size = kStatsShmHeaderSize;
+  header->num_slots = num_slots;
+  header->slot_size = slot_size;
+  header->stats_type = type;
+
+  RetireFile(path);
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    return FileError("rename stats file to", path);
+  }
+  unlink_tmp.Cancel();
+  unmap.Cancel();
+
+  return new StatsShmWriter(static_cast<char *>(map), map_size, num_slots,
+                            slot_size);
+}
+
+StatsShmWriter::StatsShmWriter(char *map, size_t map_size, uint32 num_slots,
+                               uint32 slot_size)
+    : map_(map),
+      map_size_(map_size),
+      num_slots_(num_slots),
+      slot_size_(slot_size) {}
+
+StatsShmWriter::~StatsShmWriter() {
+  reinterpret_cast<Header *>(map_)->retired.store(1, memory_order_release);
+  munmap(map_, map_size_);
+}
+
+Status StatsShmWriter::Write(const string &container_name,
+                             const ContainerStats &stats, int64 time_ns) {
+  if (container_name.size() > kStatsShmMaxNameLength) {
+    return Status(::util::error::INVALID_ARGUMENT,
+                  Substitute("Container name \"$0\" is too long to publish",
+                             container_name));
+  }
+
+  // Claim the first unused slot of the probe if the container is new.
+  auto it = slots_.find(container_name);
+  bool is_new = false;
+  if (it == slots_.end()) {
+    const uint32 first = FirstSlot(container_name, num_slots_);
+    for (uint32 i = 0; i < num_slots_; ++i) {
+      const uint32 index = (first + i) % num_slots_;
+      const uint32 state = GetSlot(map_, slot_size_, index)->state;
+      if (state == SLOT_EMPTY || state == SLOT_REMOVED) {
+        it = slots_.insert(make_pair(container_name, index)).first;
+        is_new = true;
+        break;
+      }
+    }
+    if (it == slots_.end()) {
+      return Status(::util::error::RESOURCE_EXHAUSTED,
+                    Substitute("No slot left to publish container \"$0\"",
+                               container_name));
+    }
+  }
+  SlotHeader *slot = GetSlot(map_, slot_size_, it->second);
+
+  const size_t capacity = slot_size_ - sizeof(SlotHeader);
+  const size_t stats_length = stats.ByteSize();
+  const bool oversized = stats_length > capacity;
+
+  // Readers retry while seq is odd or if it changed under them.
+  const uint64 seq = slot->seq.load(memory_order_relaxed);
+  slot->seq.store(seq + 1, memory_order_relaxed);
+  ::std::atomic_thread_fence(memory_order_release);
+
+  slot->state = oversized ? SLOT_OVERSIZED : SLOT_VALID;
+  slot->name_length = container_name.size();
+  memcpy(slot->name, container_name.data(), container_name.size());
+  slot->version = is_new ? 1 : slot->version + 1;
+  slot->generation = reinterpret_cast<Header *>(map_)->generation.load(
+                         memory_order_relaxed) + 1;
+  slot->time_ns = time_ns;
+  if (oversized) {
+    slot->stats_length = 0;
+  } else {
+    slot->stats_length = stats_length;
+    stats.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8 *>(slot + 1));
+  }
+
+  slot->seq.store(seq + 2, memory_order_release);
+
+  if (oversized) {
+    return Status(::util::error::RESOURCE_EXHAUSTED,
+                  Substitute("Stats of container \"$0\" take $1 bytes, only "
+                             "$2 fit in a slot",
+                             container_name, stats_length, capacity));
+  }
+  return Status::OK;
+}
+
+void StatsShmWriter::Remove(const string &container_name) {
+  auto it = slots_.find(container_name);
+  if (it == slots_.end()) {
+    return;
+  }
+  SlotHeader *slot = GetSlot(map_, slot_size_, it->second);
+  slots_.erase(it);
+
+  const uint64 seq = slot->seq.load(memory_order_relaxed);
+  slot->seq.store(seq + 1, memory_order_relaxed);
+  ::std::atomic_thread_fence(memory_order_release);
+  slot->state = SLOT_REMOVED;
+  slot->seq.store(seq + 2, memory_order_release);
+}
+
+void StatsShmWriter::FinishRound(int64 time_ns) {
+  Header *header = reinterpret_cast<Header *>(map_);
+  header->publish_time_ns.store(time_ns, memory_order_relaxed);
+  header->generation.fetch_add(1, memory_order_release);
+}
+
+vector<string> StatsShmWriter::ContainerNames() const {
+  vector<string> names;
+  names.reserve(slots_.size());
+  for (const auto &name_slot : slots_) {
+    names.push_back(name_slot.first);
+  }
+  return names;
+}
+
+StatusOr<StatsShmReader *> StatsShmReader::Open(const string &path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return FileError("open", path);
+  }
+  // The mapping outlives the fd.
+  ScopedCleanup close_fd([fd]() { close(fd); });
+
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0) {
+    return FileError("stat", path);
+  }
+  const size_t map_size = statbuf.st_size;
+  if (map_size < kStatsShmHeaderSize) {
+    return Status(::util::error::FAILED_PRECONDITION,
+                  Substitute("\"$0\" is not a stats file", path));
+  }
+  void *map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    return FileError("map", path);
+  }
+
+  const Header *header = static_cast<const Header *>(map);
+  if (header->magic != kStatsShmMagic ||
+      header->layout_version != kStatsShmLayoutVersion ||
+      header->header_size != kStatsShmHeaderSize ||
+      header->num_slots == 0 || header->slot_size <= sizeof(SlotHeader) ||
+      map_size < kStatsShmHeaderSize +
+                     static_cast<size_t>(header->num_slots) *
+                         header->slot_size) {
+    munmap(map, map_size);
+    return Status(::util::error::FAILED_PRECONDITION,
+                  Substitute("\"$0\" is not a stats file of layout version $1",
+                             path, kStatsShmLayoutVersion));
+  }
+
+  return new StatsShmReader(static_cast<const char *>(map), map_size);
+}
+
+StatsShmReader::StatsShmReader(const char *map, size_t map_size)
+    : map_(map), map_size_(map_size) {}
+
+StatsShmReader::~StatsShmReader() {
+  munmap(const_cast<char *>(map_), map_size_);
+}
+
+StatusOr<StatsShmReader::Record> StatsShmReader::Read(
+    const string &container_name) const {
+  if (retired()) {
+    return Status(::util::error::UNAVAILABLE,
+                  "The stats file is no longer published, open it again");
+  }
+
+  // Names that long are never published, don't probe for them.
+  if (container_name.size() > kStatsShmMaxNameLength) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("No stats published for container \"$0\"",
+                             container_name));
+  }
+
+  const Header *header = reinterpret_cast<const Header *>(map_);
+  const uint32 num_slots = header->num_slots;
+  const uint32 slot_size = header->slot_size;
+  const size_t capacity = slot_size - sizeof(SlotHeader);
+
+  const uint32 first = FirstSlot(container_name, num_slots);
+  string serialized_stats;
+  Record record;
+  for (uint32 i = 0; i < num_slots; ++i) {
+    const SlotHeader *slot = GetSlot(map_, slot_size, (first + i) % num_slots);
+
+    // Copy what is needed out of the slot, retrying if it was written
+    // meanwhile.
+    uint32 state = SLOT_EMPTY;
+    bool matches = false;
+    int attempts = 0;
+    while (true) {
+      if (++attempts > kMaxReadAttempts) {
+        return Status(::util::error::UNAVAILABLE,
+                      Substitute("Stats of container \"$0\" are being written",
+                                 container_name));
+      }
+      const uint64 seq = slot->seq.load(memory_order_acquire);
+      if (seq & 1) {
+        continue;
+      }
+
+      state = slot->state;
+      matches = state != SLOT_EMPTY &&
+                slot->name_length == container_name.size() &&
+                memcmp(slot->name, container_name.data(),
+                       container_name.size()) == 0;
+      if (matches && state == SLOT_VALID) {
+        record.version = slot->version;
+        record.generation = slot->generation;
+        record.time_ns = slot->time_ns;
+        serialized_stats.assign(reinterpret_cast<const char *>(slot + 1),
+                                ::std::min<size_t>(slot->stats_length,
+                                                   capacity));
+      }
+
+      ::std::atomic_thread_fence(memory_order_acquire);
+      if (slot->seq.load(memory_order_relaxed) == seq) {
+        break;
+      }
+    }
+
+    if (state == SLOT_EMPTY) {
+      break;
+    }
+    if (!matches || state == SLOT_REMOVED) {
+      continue;
+    }
+    if (state == SLOT_OVERSIZED) {
+      return Status(::util::error::RESOURCE_EXHAUSTED,
+                    Substitute("Stats of container \"$0\" are too large to "
+                               "be published",
+                               container_name));
+    }
+    if (!record.stats.ParseFromString(serialized_stats)) {
+      return Status(::util::error::INTERNAL,
+                    Substitute("Failed to parse the stats of container \"$0\"",
+                               container_name));
+    }
+    return record;
+  }
+
+  return Status(::util::error::NOT_FOUND,
+                Substitute("No stats published for container \"$0\"",
+                           container_name));
+}
+
+Container::StatsType StatsShmReader::stats_type() const {
+  return static_cast<Container::StatsType>(
+      reinterpret_cast<const Header *>(map_)->stats_type);
+}
+
+uint64 StatsShmReader::generation() const {
+  return reinterpret_cast<const Header *>(map_)->generation.load(
+      memory_order_acquire);
+}
+
+int64 StatsShmReader::publish_time_ns() const {
+  return reinterpret_cast<const Header *>(map_)->publish_time_ns.load(
+      memory_order_relaxed);
+}
+
+bool StatsShmReader::retired() const {
+  return reinterpret_cast<const Header *>(map_)->retired.load(
+             memory_order_acquire) != 0;
+}
+
+}  // namespace lmctfy
+}  // namespace containers
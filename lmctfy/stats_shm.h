@@ -0,0 +1,212 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_STATS_SHM_H_
+#define SRC_STATS_SHM_H_
+
+#include <map>
+#include <string>
+using ::std::string;
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "include/lmctfy.h"
+#include "include/lmctfy.pb.h"
+#include "util/task/status.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace lmctfy {
+
+// Shared-memory publication of the latest stats of every container.
+//
+// A single publisher writes the ContainerStats of each container into a file
+// (under /run, i.e.: tmpfs) that any number of readers mmap. Once mapped, reading
+// the stats of a container takes no syscalls and no cgroupfs parsing.
+//
+// The file has a fixed layout, in native byte order:
+//
+//   Header (the first kStatsShmHeaderSize bytes):
+//     uint64 magic              "LMCTFYSS"
+//     uint32 layout_version     kStatsShmLayoutVersion
+//     uint32 header_size
+//     uint32 num_slots
+//     uint32 slot_size          Size of a slot, header included.
+//     uint32 stats_type         Container::StatsType of the stats.
+//     uint32 retired            Non-zero once the publisher stopped writing.
+//     uint64 generation         Number of completed publication rounds.
+//     int64 publish_time_ns     Wall time of the last completed round.
+//
+//   num_slots slots of slot_size bytes each:
+//     uint64 seq                Seqlock, odd while the slot is written.
+//     uint32 state              EMPTY (0), VALID (1), REMOVED (2), OVERSIZED (3)
+//     uint32 name_length
+//     uint32 stats_length
+//     uint32 reserved
+//     uint64 version            Number of times the record was written.
+//     uint64 generation         Round the record was written in.
+//     int64 time_ns             Wall time the stats were gathered at.
+//     char name[kStatsShmMaxNameLength]
+//     char stats[]              Serialized ContainerStats.
+//
+// The slots are an open-addressing hash table indexed by container name: a
+// container is in the first slot at or after FNV-1a-64(name) % num_slots that
+// holds its name, and is not in the table if an EMPTY slot comes first. REMOVED
+// slots hold no container but do not end a probe.
+//
+// Readers copy a slot and retry if its seq was odd or changed meanwhile, so a
+// reader never blocks the publisher nor sees a torn record.
+
+// Magic number of the stats file, "LMCTFYSS" in memory order.
+static const uint64 kStatsShmMagic = 0x5353594654434d4cULL;
+
+// Version of the layout above.
+static const uint32 kStatsShmLayoutVersion = 1;
+
+// Size of the header, the slots start right after it.
+static const uint32 kStatsShmHeaderSize = 4096;
+
+// Container names longer than this are not published.
+static const uint32 kStatsShmMaxNameLength = 256;
+
+// Writes the stats of containers to a stats file. There must be a single writer
+// per file.
+//
+// Class is thread-compatible.
+class StatsShmWriter {
+ public:
+  // Creates a new stats file at path, replacing and retiring any existing one.
+  //
+  // Arguments:
+  //   path: Path of the stats file. Its directory is created if needed.
+  //   num_slots: Maximum number of containers in the file.
+  //   slot_size: Size of each slot in bytes, its header included. Stats that do
+  //       not fit are marked as oversized. Must be a multiple of 64.
+  //   stats_type: Type of the stats that are written.
+  // Return:
+  //   StatusOr: Status of the operation. Iff OK, the writer. The caller takes
+  //       ownership.
+  static ::util::StatusOr<StatsShmWriter *> New(const string &path,
+                                                int num_slots, int slot_size,
+                                                Container::StatsType type);
+
+  // Retires the file, readers stop reading it.
+  ~StatsShmWriter();
+
+  // Writes the stats of the container, adding it if it is not in the file.
+  //
+  // Arguments:
+  //   container_name: Absolute name of the container.
+  //   stats: The stats of the container.
+  //   time_ns: Wall time the stats were gathered at.
+  // Return:
+  //   Status: Status of the operation. INVALID_ARGUMENT if the name is too
+  //       long, RESOURCE_EXHAUSTED if all slots are used or if the stats do not
+  //       fit in a slot, in which case the container is marked as oversized.
+  ::util::Status Write(const string &container_name,
+                       const ContainerStats &stats, int64 time_ns);
+
+  // Removes the container from the file. No-op if it is not in it.
+  void Remove(const string &container_name);
+
+  // Ends a publication round.
+  //
+  // Arguments:
+  //   time_ns: Wall time of the round.
+  void FinishRound(int64 time_ns);
+
+  // Gets the names of the containers in the file.
+  ::std::vector<string> ContainerNames() const;
+
+ private:
+  StatsShmWriter(char *map, size_t map_size, uint32 num_slots,
+                 uint32 slot_size);
+
+  char *const map_;
+  const size_t map_size_;
+  const uint32 num_slots_;
+  const uint32 slot_size_;
+
+  // Map of container name to its slot.
+  ::std::map<string, uint32> slots_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatsShmWriter);
+};
+
+// Reads the stats of containers from a stats file. Reads take no syscalls.
+//
+// Class is thread-safe.
+class StatsShmReader {
+ public:
+  // A published record of the stats of a container.
+  struct Record {
+    ContainerStats stats;
+
+    // Number of times the record was written. Changes whenever the stats do.
+    uint64 version;
+
+    // Round the record was written in.
+    uint64 generation;
+
+    // Wall time the stats were gathered at, in nanoseconds.
+    int64 time_ns;
+  };
+
+  // Maps the stats file at path.
+  //
+  // Return:
+  //   StatusOr: Status of the operation. NOT_FOUND if there is no stats file
+  //       and FAILED_PRECONDITION if it is not one of this layout version.
+  //       Iff OK, the reader. The caller takes ownership.
+  static ::util::StatusOr<StatsShmReader *> Open(const string &path);
+
+  ~StatsShmReader();
+
+  // Reads the latest stats of the container.
+  //
+  // Arguments:
+  //   container_name: Absolute name of the container.
+  // Return:
+  //   StatusOr: Status of the operation. NOT_FOUND if the container is not
+  //       published, RESOURCE_EXHAUSTED if its stats do not fit in the file and
+  //       UNAVAILABLE if the publisher retired the file, in which case it must
+  //       be opened again. Iff OK, the record.
+  ::util::StatusOr<Record> Read(const string &container_name) const;
+
+  // Type of the published stats.
+  Container::StatsType stats_type() const;
+
+  // Number of completed publication rounds.
+  uint64 generation() const;
+
+  // Wall time of the last completed round, in nanoseconds.
+  int64 publish_time_ns() const;
+
+  // Whether the publisher stopped writing the file.
+  bool retired() const;
+
+ private:
+  StatsShmReader(const char *map, size_t map_size);
+
+  const char *const map_;
+  const size_t map_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatsShmReader);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_STATS_SHM_H_
@@ -0,0 +1,264 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/stats_shm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "base/logging.h"
+#include "file/base/path.h"
+#include "util/errors_test_util.h"
+#include "strings/substitute.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "util/task/codes.pb.h"
+#include "util/testing/equals_initialized_proto.h"
+
+using ::file::JoinPath;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::testing::ElementsAre;
+using ::testing::EqualsInitializedProto;
+using ::util::StatusOr;
+
+DECLARE_string(test_tmpdir);
+
+namespace containers {
+namespace lmctfy {
+namespace {
+
+static const char kContainerName[] = "/test";
+static const int kNumSlots = 8;
+static const int kSlotSize = 1024;
+
+// Returns stats with the specified CPU usage.
+ContainerStats MakeStats(uint64 cpu_usage) {
+  ContainerStats stats;
+  stats.mutable_cpu()->mutable_usage()->set_total(cpu_usage);
+  return stats;
+}
+
+class StatsShmTest : public ::testing::Test {
+ protected:
+  StatsShmTest()
+      : test_dir_(JoinPath(FLAGS_test_tmpdir, "stats_shm_test")),
+        path_(JoinPath(test_dir_, "stats")) {}
+
+  void SetUp() override {
+    writer_.reset(NewWriter(kNumSlots, kSlotSize));
+    reader_.reset(OpenReader());
+  }
+
+  void TearDown() override {
+    reader_.reset();
+    writer_.reset();
+    CHECK_EQ(0, system(Substitute("rm -rf $0", test_dir_).c_str()));
+  }
+
+  StatsShmWriter *NewWriter(int num_slots, int slot_size) {
+    StatusOr<StatsShmWriter *> statusor = StatsShmWriter::New(
+        path_, num_slots, slot_size, Container::STATS_FULL);
+    CHECK(statusor.ok()) << statusor.status().ToString();
+    return statusor.ValueOrDie();
+  }
+
+  StatsShmReader *OpenReader() {
+    StatusOr<StatsShmReader *> statusor = StatsShmReader::Open(path_);
+    CHECK(statusor.ok()) << statusor.status().ToString();
+    return statusor.ValueOrDie();
+  }
+
+  const string test_dir_;
+  const string path_;
+  unique_ptr<StatsShmWriter> writer_;
+  unique_ptr<StatsShmReader> reader_;
+};
+
+TEST_F(StatsShmTest, Header) {
+  EXPECT_EQ(Container::STATS_FULL, reader_->stats_type());
+  EXPECT_EQ(0, reader_->generation());
+  EXPECT_FALSE(reader_->retired());
+
+  writer_->FinishRound(42);
+  EXPECT_EQ(1, reader_->generation());
+  EXPECT_EQ(42, reader_->publish_time_ns());
+}
+
+TEST_F(StatsShmTest, WriteAndRead) {
+  ASSERT_OK(writer_->Write(kContainerName, MakeStats(10), 100));
+
+  StatusOr<StatsShmReader::Record> statusor = reader_->Read(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_THAT(statusor.ValueOrDie().stats,
+              EqualsInitializedProto(MakeStats(10)));
+  EXPECT_EQ(1, statusor.ValueOrDie().version);
+  EXPECT_EQ(1, statusor.ValueOrDie().generation);
+  EXPECT_EQ(100, statusor.ValueOrDie().time_ns);
+  EXPECT_THAT(writer_->ContainerNames(), ElementsAre(kContainerName));
+}
+
+TEST_F(StatsShmTest, RewriteBumpsVersion) {
+  ASSERT_OK(writer_->Write(kContainerName, MakeStats(10), 100));
+  writer_->FinishRound(100);
+  ASSERT_OK(writer_->Write(kContainerName, MakeStats(20), 200));
+
+  StatusOr<StatsShmReader::Record> statusor = reader_->Read(kContainerName);
+  ASSERT_OK(statusor);
+  EXPECT_THAT(statusor.ValueOrDie().stats,
+              EqualsInitializedProto(MakeStats(20)));
+  EXPECT_EQ(2, statusor.ValueOrDie().version);
+  EXPECT_EQ(2, statusor.ValueOrDie().generation);
+  EXPECT_EQ(200, statusor.ValueOrDie().time_ns);
+}
+
+TEST_F(StatsShmTest, ReadNotPublished) {
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, reader_->Read(kContainerName));
+}
+
+TEST_F(StatsShmTest, Remove) {
+  ASSERT_OK(writer_->Write(kContainerName, MakeStats(10), 100));
+  writer_->Remove(kContainerName);
+  writer_->Remove("/missing");
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, reader_->Read(kContainerName));
+  EXPECT_TRUE(writer_->ContainerNames().empty());
+}
+
+TEST_F(StatsShmTest, CollidingNames) {
+  // With two slots the names share their probes.
+  writer_.reset(NewWriter(2, kSlotSize));
+  reader_.reset(OpenReader());
+
+  ASSERT_OK(writer_->Write("/a", MakeStats(1), 100));
+  ASSERT_OK(writer_->Write("/b", MakeStats(2), 100));
+  EXPECT_ERROR_CODE(::util::error::RESOURCE_EXHAUSTED,
+                    writer_->Write("/c", MakeStats(3), 100));
+
+  writer_->Remove("/a");
+  StatusOr<StatsShmReader::Record> statusor = reader_->Read("/b");
+  ASSERT_OK(statusor);
+  EXPECT_THAT(statusor.ValueOrDie().stats,
+              EqualsInitializedProto(MakeStats(2)));
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND, reader_->Read("/a"));
+
+  // The removed slot is reused.
+  ASSERT_OK(writer_->Write("/c", MakeStats(3), 100));
+  statusor = reader_->Read("/c");
+  ASSERT_OK(statusor);
+  EXPECT_THAT(statusor.ValueOrDie().stats,
+              EqualsInitializedProto(MakeStats(3)));
+  EXPECT_EQ(1, statusor.ValueOrDie().version);
+}
+
+TEST_F(StatsShmTest, OversizedStats) {
+  writer_.reset(NewWriter(kNumSlots, 384));
+  reader_.reset(OpenReader());
+
+  ContainerStats stats;
+  for (int i = 0; i < 64; ++i) {
+    stats.mutable_cpu()->mutable_usage()->add_per_cpu(i);
+  }
+
+  EXPECT_ERROR_CODE(::util::error::RESOURCE_EXHAUSTED,
+                    writer_->Write(kContainerName, stats, 100));
+  EXPECT_ERROR_CODE(::util::error::RESOURCE_EXHAUSTED,
+                    reader_->Read(kContainerName));
+}
+
+TEST_F(StatsShmTest, NameTooLong) {
+  EXPECT_ERROR_CODE(
+      ::util::error::INVALID_ARGUMENT,
+      writer_->Write("/" + string(kStatsShmMaxNameLength, 'a'), MakeStats(1),
+                     100));
+}
+
+TEST_F(StatsShmTest, ReadNameTooLong) {
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    reader_->Read("/" + string(kStatsShmMaxNameLength, 'a')));
+}
+
+TEST_F(StatsShmTest, InvalidGeometry) {
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    StatsShmWriter::New(path_, 0, kSlotSize,
+                                        Container::STATS_FULL));
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    StatsShmWriter::New(path_, kNumSlots, 1000,
+                                        Container::STATS_FULL));
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    StatsShmWriter::New(path_, kNumSlots, 256,
+                                        Container::STATS_FULL));
+}
+
+TEST_F(StatsShmTest, WriterDestructionRetiresFile) {
+  ASSERT_OK(writer_->Write(kContainerName, MakeStats(10), 100));
+  writer_.reset();
+
+  EXPECT_TRUE(reader_->retired());
+  EXPECT_ERROR_CODE(::util::error::UNAVAILABLE, reader_->Read(kContainerName));
+}
+
+TEST_F(StatsShmTest, NewWriterRetiresOldFile) {
+  unique_ptr<StatsShmWriter> new_writer(NewWriter(kNumSlots, kSlotSize));
+  ASSERT_OK(new_writer->Write(kContainerName, MakeStats(10), 100));
+
+  EXPECT_ERROR_CODE(::util::error::UNAVAILABLE, reader_->Read(kContainerName));
+
+  // Readers that open the file again read the new one.
+  reader_.reset(OpenReader());
+  EXPECT_OK(reader_->Read(kContainerName));
+}
+
+TEST_F(StatsShmTest, OpenMissing) {
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    StatsShmReader::Open(JoinPath(test_dir_, "missing")));
+}
+
+TEST_F(StatsShmTest, OpenNotStatsFile) {
+  const string path = JoinPath(test_dir_, "other");
+  FILE *file = fopen(path.c_str(), "w");
+  ASSERT_NE(nullptr, file);
+  fprintf(file, "%s", string(8192, 'x').c_str());
+  fclose(file);
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    StatsShmReader::Open(path));
+}
+
+TEST_F(StatsShmTest, OpenNoSlots) {
+  // A copy of the stats file with num_slots (at offset 16) zeroed.
+  FILE *file = fopen(path_.c_str(), "r");
+  ASSERT_NE(nullptr, file);
+  string contents(kStatsShmHeaderSize + kNumSlots * kSlotSize, '\0');
+  ASSERT_EQ(contents.size(), fread(&contents[0], 1, contents.size(), file));
+  fclose(file);
+  contents.replace(16, sizeof(uint32), sizeof(uint32), '\0');
+
+  const string path = JoinPath(test_dir_, "no_slots");
+  file = fopen(path.c_str(), "w");
+  ASSERT_NE(nullptr, file);
+  ASSERT_EQ(contents.size(), fwrite(contents.data(), 1, contents.size(), file));
+  fclose(file);
+
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    StatsShmReader::Open(path));
+}
+
+}  // namespace
+}  // namespace lmctfy
+}  // namespace containers
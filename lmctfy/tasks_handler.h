@@ -15,11 +15,14 @@
 #ifndef SRC_TASKS_HANDLER_H_
 #define SRC_TASKS_HANDLER_H_
 
+#include <functional>
 #include <string>
 using ::std::string;
 #include <vector>
 
+#include "base/callback.h"
 #include "base/macros.h"
+#include "lmctfy/active_notifications.h"
 #include "util/safe_types/unix_gid.h"
 #include "util/safe_types/unix_uid.h"
 #include "util/task/statusor.h"
@@ -108,6 +111,37 @@ class TasksHandler {
   virtual ::util::StatusOr<::std::vector<pid_t>> ListThreads(
       ListType type) const = 0;
 
+  // Visitor of PIDs/TIDs, called once per PID/TID.
+  typedef ::std::function<void(pid_t pid)> PidVisitor;
+
+  // Calls visitor with each of the processes running inside this handler (not
+  // its subcontainers). Implementations may stream the PIDs rather than
+  // listing them all first, by default this uses ListProcesses().
+  virtual ::util::Status VisitProcesses(const PidVisitor &visitor) const {
+    return VisitAll(ListProcesses(ListType::SELF), visitor);
+  }
+
+  // Calls visitor with each of the threads running inside this handler (not
+  // its subcontainers). Implementations may stream the TIDs rather than
+  // listing them all first, by default this uses ListThreads().
+  virtual ::util::Status VisitThreads(const PidVisitor &visitor) const {
+    return VisitAll(ListThreads(ListType::SELF), visitor);
+  }
+
+  // Registers a notification for when there are no longer any tasks in this
+  // handler or in any of its subcontainers.
+  //
+  // Arguments:
+  //   callback: Used to deliver the notification with the status argument
+  //       indicating if there were any errors or simply the delivery of a
+  //       notification (i.e.: Status of OK). Must be a permanent callback.
+  //       Takes ownership of the pointer.
+  // Return:
+  //   StatusOr: Status of the operation. Iff OK, the Handle of the registered
+  //       notification.
+  virtual ::util::StatusOr<ActiveNotifications::Handle>
+  RegisterEmptyNotification(Callback1< ::util::Status> *callback) = 0;
+
   // Returns the absolute name of the container this TasksHandler manages.
   const string &container_name() const { return container_name_; }
 
@@ -117,6 +151,19 @@ class TasksHandler {
   const string container_name_;
 
  private:
+  // Calls visitor with each of the PIDs/TIDs in statusor, if it is OK.
+  static ::util::Status VisitAll(
+      const ::util::StatusOr<::std::vector<pid_t>> &statusor,
+      const PidVisitor &visitor) {
+    if (!statusor.ok()) {
+      return statusor.status();
+    }
+    for (pid_t pid : statusor.ValueOrDie()) {
+      visitor(pid);
+    }
+    return ::util::Status::OK;
+  }
+
   DISALLOW_COPY_AND_ASSIGN(TasksHandler);
 };
 
@@ -53,6 +53,9 @@ class MockTasksHandler : public TasksHandler {
                      ::util::StatusOr<::std::vector<pid_t>>(ListType type));
   MOCK_CONST_METHOD1(ListThreads,
                      ::util::StatusOr<::std::vector<pid_t>>(ListType type));
+  MOCK_METHOD1(RegisterEmptyNotification,
+               ::util::StatusOr<ActiveNotifications::Handle>(
+                   Callback1< ::util::Status> *callback));
 };
 
 typedef ::testing::NiceMock<MockTasksHandler> NiceMockTasksHandler;
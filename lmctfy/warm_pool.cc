@@ -0,0 +1,396 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/warm_pool.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/logging.h"
+#include "file/base/path.h"
+#include "thread/thread_options.h"
+#include "util/errors.h"
+#include "strings/numbers.h"
+#include "strings/stringpiece.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+using ::file::Basename;
+using ::file::Dirname;
+using ::file::JoinPath;
+using ::std::min;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace lmctfy {
+
+// Prefix of the names of warm containers. Container names can't start with an
+// underscore.
+static const char kWarmNamePrefix[] = "_warm.";
+
+// Time a pool is not refilled for after its first failure. It doubles with
+// every failure in a row, up to kMaxRefillBackoffNs.
+static const int64 kInitialRefillBackoffNs = 100 * 1000 * 1000;
+static const int64 kMaxRefillBackoffNs = 60 * 1000 * 1000 * 1000LL;
+
+// Determines whether the specified parent is the container or one of its
+// subcontainers.
+static bool IsInContainer(const string &parent, const string &container_name) {
+  return container_name == "/" || parent == container_name ||
+         StringPiece(parent).starts_with(container_name + "/");
+}
+
+// Gets the key of the pool of warm containers of the parent and template.
+static string PoolKey(const string &parent, const ContainerSpec &spec) {
+  return parent + "\n" + spec.SerializeAsString();
+}
+
+WarmPool::WarmPool(const Backend *backend, int pool_size, int max_pools)
+    : backend_(CHECK_NOTNULL(backend)),
+      pool_size_(pool_size),
+      max_pools_(max_pools),
+      refill_requested_(false),
+      stopping_(false) {
+  CHECK_GT(pool_size_, 0);
+  CHECK_EQ(0, pthread_mutex_init(&wake_mutex_, nullptr));
+  CHECK_EQ(0, pthread_cond_init(&wake_cond_, nullptr));
+}
+
+WarmPool::~WarmPool() {
+  pthread_mutex_lock(&wake_mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&wake_cond_);
+  pthread_mutex_unlock(&wake_mutex_);
+
+  if (thread_ != nullptr) {
+    thread_->Join();
+  }
+
+  pthread_cond_destroy(&wake_cond_);
+  pthread_mutex_destroy(&wake_mutex_);
+}
+
+void WarmPool::Start() {
+  CHECK(thread_ == nullptr) << "Warm pool already started";
+
+  ::thread::Options options;
+  options.set_joinable(true);
+  thread_.reset(new ClosureThread(
+      options, "WarmPool", NewPermanentCallback(this, &WarmPool::Run)));
+  thread_->Start();
+}
+
+void WarmPool::Run() {
+  Status status = Reap();
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to reap stale warm containers: "
+                 << status.ToString();
+  }
+
+  pthread_mutex_lock(&wake_mutex_);
+  while (!stopping_) {
+    while (!stopping_ && !refill_requested_) {
+      pthread_cond_wait(&wake_cond_, &wake_mutex_);
+    }
+    if (stopping_) {
+      break;
+    }
+    refill_requested_ = false;
+    pthread_mutex_unlock(&wake_mutex_);
+
+    Status status = Refill();
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to refill the warm container pool: "
+                   << status.ToString();
+    }
+
+    pthread_mutex_lock(&wake_mutex_);
+  }
+  pthread_mutex_unlock(&wake_mutex_);
+}
+
+void WarmPool::RequestRefill() {
+  pthread_mutex_lock(&wake_mutex_);
+  refill_requested_ = true;
+  pthread_cond_signal(&wake_cond_);
+  pthread_mutex_unlock(&wake_mutex_);
+}
+
+bool WarmPool::IsWarmName(const string &container_name) {
+  return Basename(container_name).starts_with(kWarmNamePrefix);
+}
+
+bool WarmPool::CanClaim(const ContainerSpec &spec) {
+  return !spec.has_owner() && !spec.has_owner_group() &&
+         !spec.has_children_limit() && !spec.has_virtual_host() &&
+         !spec.has_security_spec();
+}
+
+ContainerSpec WarmPool::TemplateFor(const ContainerSpec &spec) {
+  ContainerSpec template_spec;
+  if (spec.has_cpu()) {
+    // Scheduling latency is only set at creation and decides where the
+    // container is placed in the cpu hierarchy.
+    CpuSpec *cpu = template_spec.mutable_cpu();
+    if (spec.cpu().has_scheduling_latency()) {
+      cpu->set_scheduling_latency(spec.cpu().scheduling_latency());
+    }
+  }
+  if (spec.has_memory()) {
+    template_spec.mutable_memory();
+  }
+  if (spec.has_network()) {
+    template_spec.mutable_network();
+  }
+  if (spec.has_blockio()) {
+    template_spec.mutable_blockio();
+  }
+  if (spec.has_monitoring()) {
+    template_spec.mutable_monitoring();
+  }
+  if (spec.has_filesystem()) {
+    template_spec.mutable_filesystem();
+  }
+  if (spec.has_device()) {
+    template_spec.mutable_device();
+  }
+  return template_spec;
+}
+
+string WarmPool::NewWarmName(const string &parent) {
+  // Shared by all pools so that two pools of the process (e.g.: of two
+  // ContainerApi instances) never pick the same name under a parent.
+  static ::std::atomic<int64> next_id(0);
+  return JoinPath(parent, Substitute("$0$1.$2", kWarmNamePrefix, getpid(),
+                                     next_id.fetch_add(1)));
+}
+
+Status WarmPool::Claim(const string &container_name,
+                       const ContainerSpec &spec) {
+  const string parent = Dirname(container_name).ToString();
+  const ContainerSpec template_spec = TemplateFor(spec);
+  const string key = PoolKey(parent, template_spec);
+
+  string warm_name;
+  {
+    MutexLock l(&lock_);
+    auto it = pools_.find(key);
+    if (it == pools_.end()) {
+      // Start keeping a pool for containers like this one.
+      if (pools_.size() < max_pools_ &&
+          evicted_parents_.find(parent) == evicted_parents_.end()) {
+        pools_[key].reset(new Pool(parent, template_spec));
+      }
+    } else if (!it->second->warm_names.empty()) {
+      warm_name = it->second->warm_names.front();
+      it->second->warm_names.pop_front();
+    }
+  }
+  RequestRefill();
+
+  if (warm_name.empty()) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("No warm container to claim for \"$0\"",
+                             container_name));
+  }
+
+  Status status = backend_->RenameWarm(warm_name, container_name);
+  if (!status.ok()) {
+    Status destroy_status = backend_->DestroyWarm(warm_name);
+    if (!destroy_status.ok()) {
+      LOG(WARNING) << "Failed to destroy warm container \"" << warm_name
+                   << "\": " << destroy_status.ToString();
+    }
+    return status;
+  }
+
+  return Status::OK;
+}
+
+Status WarmPool::Refill() {
+  MutexLock refill_lock(&refill_lock_);
+
+  Status status = Status::OK;
+  while (true) {
+    // Find a pool that is not full and not backed off. Pools are only removed
+    // while holding refill_lock_ so it will still be there after the warm
+    // container is created.
+    Pool *pool = nullptr;
+    string warm_name;
+    {
+      MutexLock l(&lock_);
+      const int64 now_ns = NowNs();
+      for (const auto &key_pool_pair : pools_) {
+        if (key_pool_pair.second->warm_names.size() < pool_size_ &&
+            key_pool_pair.second->retry_ns <= now_ns) {
+          pool = key_pool_pair.second.get();
+          warm_name = NewWarmName(pool->parent);
+          break;
+        }
+      }
+    }
+    if (pool == nullptr) {
+      return status;
+    }
+
+    // Create the warm container outside of the lock so claims don't wait on it.
+    Status create_status = backend_->CreateWarm(warm_name, pool->spec);
+
+    MutexLock l(&lock_);
+    if (create_status.ok()) {
+      pool->num_failures = 0;
+      pool->warm_names.push_back(warm_name);
+      continue;
+    }
+
+    // The parent may be gone or full, back off so that the other pools are
+    // still refilled.
+    int64 backoff_ns = kInitialRefillBackoffNs;
+    for (int i = 0;
+         i < pool->num_failures && backoff_ns < kMaxRefillBackoffNs; ++i) {
+      backoff_ns *= 2;
+    }
+    pool->retry_ns = NowNs() + min(backoff_ns, kMaxRefillBackoffNs);
+    ++pool->num_failures;
+    if (status.ok()) {
+      status = create_status;
+    }
+  }
+}
+
+Status WarmPool::Drain(const string &container_name) {
+  MutexLock refill_lock(&refill_lock_);
+
+  vector<string> warm_names;
+  {
+    MutexLock l(&lock_);
+    for (auto it = pools_.begin(); it != pools_.end();) {
+      if (IsInContainer(it->second->parent, container_name)) {
+        warm_names.insert(warm_names.end(), it->second->warm_names.begin(),
+                          it->second->warm_names.end());
+        it = pools_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (auto it = evicted_parents_.begin(); it != evicted_parents_.end();) {
+      if (IsInContainer(*it, container_name)) {
+        it = evicted_parents_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Destroy all warm containers, even if some fail.
+  Status status = Status::OK;
+  for (const string &warm_name : warm_names) {
+    Status destroy_status = backend_->DestroyWarm(warm_name);
+    if (!destroy_status.ok() && status.ok()) {
+      status = destroy_status;
+    }
+  }
+  return status;
+}
+
+StatusOr<int> WarmPool::Evict(const string &parent) {
+  MutexLock refill_lock(&refill_lock_);
+
+  vector<string> warm_names;
+  {
+    MutexLock l(&lock_);
+    evicted_parents_.insert(parent);
+    for (auto it = pools_.begin(); it != pools_.end();) {
+      if (it->second->parent == parent) {
+        warm_names.insert(warm_names.end(), it->second->warm_names.begin(),
+                          it->second->warm_names.end());
+        it = pools_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Destroy all warm containers, even if some fail.
+  Status status = Status::OK;
+  for (const string &warm_name : warm_names) {
+    Status destroy_status = backend_->DestroyWarm(warm_name);
+    if (!destroy_status.ok() && status.ok()) {
+      status = destroy_status;
+    }
+  }
+  RETURN_IF_ERROR(status);
+  return warm_names.size();
+}
+
+Status WarmPool::Reap() const {
+  const vector<string> warm_names = RETURN_IF_ERROR(backend_->ListWarm("/"));
+
+  // Destroy all stale warm containers, even if some fail.
+  Status status = Status::OK;
+  for (const string &warm_name : warm_names) {
+    // Names are "_warm.<PID>.<ID>", skip any that are not.
+    StringPiece pid_and_id = Basename(warm_name);
+    pid_and_id.remove_prefix(strlen(kWarmNamePrefix));
+    const StringPiece::size_type dot = pid_and_id.find('.');
+    pid_t pid;
+    if (dot == StringPiece::npos ||
+        !SimpleAtoi(pid_and_id.substr(0, dot).ToString(), &pid) ||
+        pid == getpid() || ProcessExists(pid)) {
+      continue;
+    }
+
+    // The warm container may be destroyed along with its parent meanwhile.
+    Status destroy_status = backend_->DestroyWarm(warm_name);
+    if (!destroy_status.ok() &&
+        destroy_status.error_code() != ::util::error::NOT_FOUND &&
+        status.ok()) {
+      status = destroy_status;
+    }
+  }
+  return status;
+}
+
+bool WarmPool::ProcessExists(pid_t pid) const {
+  return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+int64 WarmPool::NowNs() const {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int WarmPool::Size() const {
+  MutexLock l(&lock_);
+  int size = 0;
+  for (const auto &key_pool_pair : pools_) {
+    size += key_pool_pair.second->warm_names.size();
+  }
+  return size;
+}
+
+}  // namespace lmctfy
+}  // namespace containers
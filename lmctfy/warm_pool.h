@@ -0,0 +1,248 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_WARM_POOL_H_
+#define SRC_WARM_POOL_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+using ::std::string;
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "include/lmctfy.pb.h"
+#include "thread/thread.h"
+#include "util/task/status.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace lmctfy {
+
+// Keeps pools of containers that were created and set up ahead of time so that
+// creating a container only has to claim one, rename it and apply the
+// requested spec.
+//
+// Warm containers are created with a template spec that isolates the same
+// resources as the specs they are claimed for, with every setting left at its
+// default. Applying the requested spec as a diff then leaves the container as a
+// regular Create() would have. Since the kernel only renames cgroups within
+// their parent, warm containers live next to the containers they will become
+// rather than under a parent of their own. Their names start with a character
+// container names can't start with so they can't be reached or created by
+// users, and carry the PID of the process that created them so that those left
+// behind by processes that exited can be reaped.
+//
+// A pool is kept for each (parent, template) pair that had a claim, up to a
+// maximum number of pools. Pools are refilled after every claim.
+//
+// Being siblings of real containers, warm containers count against the
+// children limit of their parent (cgroup.children_limit, or
+// cgroup.max.descendants in the unified hierarchy). A full pool can then make
+// a regular create in that parent fail. Evict() gives their places back and
+// stops keeping pools in the parent, callers evict and retry when a create
+// fails.
+//
+// Class is thread-safe.
+class WarmPool {
+ public:
+  // The container operations the pool is built on. All names are absolute and
+  // resolved.
+  class Backend {
+   public:
+    virtual ~Backend() {}
+
+    // Creates the specified warm container from the spec.
+    virtual ::util::Status CreateWarm(const string &warm_name,
+                                      const ContainerSpec &spec) const = 0;
+
+    // Renames the specified warm container to new_name, which has the same
+    // parent. On failure the warm container keeps its name.
+    virtual ::util::Status RenameWarm(const string &warm_name,
+                                      const string &new_name) const = 0;
+
+    // Destroys the specified warm container.
+    virtual ::util::Status DestroyWarm(const string &warm_name) const = 0;
+
+    // Lists the warm containers in and under the specified container, those of
+    // other processes included.
+    virtual ::util::StatusOr<::std::vector<string>> ListWarm(
+        const string &container_name) const = 0;
+  };
+
+  // Arguments:
+  //   backend: Used to create, rename and destroy warm containers. Does not
+  //       take ownership.
+  //   pool_size: Number of warm containers kept in each pool.
+  //   max_pools: Maximum number of (parent, template) pairs that have a pool.
+  WarmPool(const Backend *backend, int pool_size, int max_pools);
+  virtual ~WarmPool();
+
+  // Starts refilling the pools in a background thread after every claim. The
+  // thread first reaps the warm containers left behind by processes that
+  // exited. Must be called at most once. Refilling stops on destruction. Warm
+  // containers are not destroyed on destruction, see Drain().
+  void Start();
+
+  // Determines whether the specified container name is that of a warm
+  // container.
+  static bool IsWarmName(const string &container_name);
+
+  // Determines whether a container with the specified spec can be claimed from
+  // a pool. Specs with settings that only apply at creation time (e.g.: owner,
+  // children limit, virtual host) can't be.
+  static bool CanClaim(const ContainerSpec &spec);
+
+  // Gets the spec warm containers claimed for the specified spec are created
+  // with: one that isolates the same resources with default settings.
+  static ContainerSpec TemplateFor(const ContainerSpec &spec);
+
+  // Claims a warm container for the specified spec and renames it to
+  // container_name. If the pool is empty, a refill is requested.
+  //
+  // Arguments:
+  //   container_name: The absolute name of the container to create.
+  //   spec: The spec the container is being created with. CanClaim() must be
+  //       true for it.
+  // Return:
+  //   Status: OK iff the container now exists with the template spec.
+  //       NOT_FOUND if there was no warm container to claim.
+  ::util::Status Claim(const string &container_name, const ContainerSpec &spec)
+      LOCKS_EXCLUDED(lock_, refill_lock_);
+
+  // Creates warm containers until all pools are full. A pool that fails to
+  // create a warm container is backed off exponentially and the other pools
+  // are still refilled. Pools being backed off are skipped.
+  //
+  // Return:
+  //   Status: OK iff no warm container failed to be created. Otherwise the
+  //       first failure.
+  ::util::Status Refill() LOCKS_EXCLUDED(lock_, refill_lock_);
+
+  // Destroys the warm containers in and under the specified container and
+  // forgets their pools. Must be called before destroying a container.
+  //
+  // Arguments:
+  //   container_name: The absolute name of the container. "/" drains all
+  //       pools.
+  // Return:
+  //   Status: OK iff all warm containers in and under the container were
+  //       destroyed.
+  ::util::Status Drain(const string &container_name)
+      LOCKS_EXCLUDED(lock_, refill_lock_);
+
+  // Destroys the warm containers of the pools in the specified parent and stops
+  // keeping pools there, until the parent is drained. Used when the warm
+  // containers may be taking the places of real ones (e.g.: the parent has a
+  // children limit).
+  //
+  // Arguments:
+  //   parent: The absolute name of the parent.
+  // Return:
+  //   StatusOr<int>: Status of the operation. Iff OK, the number of warm
+  //       containers destroyed.
+  ::util::StatusOr<int> Evict(const string &parent)
+      LOCKS_EXCLUDED(lock_, refill_lock_);
+
+  // Destroys the warm containers created by processes that no longer exist.
+  // Those of live processes, this one included, are left alone.
+  //
+  // Return:
+  //   Status: OK iff all warm containers of exited processes were destroyed.
+  ::util::Status Reap() const;
+
+  // Number of warm containers ready to be claimed, across all pools.
+  int Size() const LOCKS_EXCLUDED(lock_);
+
+ protected:
+  // Determines whether the process with the specified PID exists.
+  virtual bool ProcessExists(pid_t pid) const;
+
+  // Gets the current time in nanoseconds. Virtual for testing.
+  virtual int64 NowNs() const;
+
+ private:
+  // The warm containers of one (parent, template) pair.
+  struct Pool {
+    Pool(const string &parent, const ContainerSpec &spec)
+        : parent(parent), spec(spec) {}
+
+    const string parent;
+    const ContainerSpec spec;
+
+    // Absolute names of the warm containers ready to be claimed.
+    ::std::deque<string> warm_names;
+
+    // Number of warm containers that failed to be created in a row.
+    int num_failures = 0;
+
+    // NowNs() time before which the pool is not refilled after a failure.
+    int64 retry_ns = 0;
+  };
+
+  // Wakes up the background thread to refill the pools.
+  void RequestRefill();
+
+  // Generates a new warm container name under the parent, unique across all
+  // the WarmPools of the process.
+  static string NewWarmName(const string &parent);
+
+  // Body of the background thread.
+  void Run();
+
+  const Backend *backend_;
+  const int pool_size_;
+  const int max_pools_;
+
+  // Map of pool key to its pool. The key is made of the parent and template.
+  ::std::map<string, ::std::unique_ptr<Pool>> pools_ GUARDED_BY(lock_);
+
+  // Parents pools are not kept in, see Evict().
+  ::std::set<string> evicted_parents_ GUARDED_BY(lock_);
+
+  // Protects pools_ and evicted_parents_. Never held while calling the
+  // backend.
+  mutable Mutex lock_;
+
+  // Held while refilling or draining pools, so that a drained pool is not
+  // being refilled.
+  Mutex refill_lock_;
+
+  ::std::unique_ptr<ClosureThread> thread_;
+
+  // Whether a refill was requested and whether the background thread should
+  // exit.
+  bool refill_requested_;
+  bool stopping_;
+
+  // Protects refill_requested_ and stopping_.
+  pthread_mutex_t wake_mutex_;
+
+  // Signalled when a refill is requested or the background thread should exit.
+  pthread_cond_t wake_cond_;
+
+  DISALLOW_COPY_AND_ASSIGN(WarmPool);
+};
+
+}  // namespace lmctfy
+}  // namespace containers
+
+#endif  // SRC_WARM_POOL_H_
@@ -0,0 +1,427 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lmctfy/warm_pool.h"
+
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util/errors_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+#include "util/testing/equals_initialized_proto.h"
+
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::testing::Contains;
+using ::testing::EqualsInitializedProto;
+using ::testing::Invoke;
+using ::testing::Not;
+using ::testing::Return;
+using ::testing::StartsWith;
+using ::testing::StrictMock;
+using ::testing::_;
+using ::util::Status;
+using ::util::StatusOr;
+using ::util::error::INTERNAL;
+using ::util::error::NOT_FOUND;
+
+namespace containers {
+namespace lmctfy {
+namespace {
+
+static const int kPoolSize = 2;
+static const int kMaxPools = 2;
+
+class MockBackend : public WarmPool::Backend {
+ public:
+  MOCK_CONST_METHOD2(CreateWarm, Status(const string &warm_name,
+                                        const ContainerSpec &spec));
+  MOCK_CONST_METHOD2(RenameWarm,
+                     Status(const string &warm_name, const string &new_name));
+  MOCK_CONST_METHOD1(DestroyWarm, Status(const string &warm_name));
+  MOCK_CONST_METHOD1(ListWarm,
+                     StatusOr<vector<string>>(const string &container_name));
+};
+
+class WarmPoolUnderTest : public WarmPool {
+ public:
+  WarmPoolUnderTest(const Backend *backend, int pool_size, int max_pools)
+      : WarmPool(backend, pool_size, max_pools), now_ns_(0) {}
+
+  MOCK_CONST_METHOD1(ProcessExists, bool(pid_t pid));
+
+  int64 NowNs() const override { return now_ns_; }
+
+  void AdvanceNs(int64 ns) { now_ns_ += ns; }
+
+ private:
+  int64 now_ns_;
+};
+
+class WarmPoolTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    pool_.reset(
+        new StrictMock<WarmPoolUnderTest>(&mock_backend_, kPoolSize, kMaxPools));
+  }
+
+  // Claims a container for the spec from an empty pool so that the pool starts
+  // being kept, and refills it. Returns the names of the warm containers.
+  vector<string> FillPool(const string &parent, const ContainerSpec &spec) {
+    EXPECT_ERROR_CODE(NOT_FOUND,
+                      pool_->Claim(JoinName(parent, "first"), spec));
+
+    vector<string> warm_names;
+    EXPECT_CALL(mock_backend_,
+                CreateWarm(StartsWith(JoinName(parent, "_warm.")),
+                           EqualsInitializedProto(WarmPool::TemplateFor(spec))))
+        .Times(kPoolSize)
+        .WillRepeatedly(Invoke([&warm_names](const string &warm_name,
+                                             const ContainerSpec &spec) {
+          warm_names.push_back(warm_name);
+          return Status::OK;
+        }))
+        .RetiresOnSaturation();
+    EXPECT_OK(pool_->Refill());
+    return warm_names;
+  }
+
+  static string JoinName(const string &parent, const string &name) {
+    return parent == "/" ? "/" + name : parent + "/" + name;
+  }
+
+ protected:
+  StrictMock<MockBackend> mock_backend_;
+  unique_ptr<WarmPoolUnderTest> pool_;
+};
+
+TEST(WarmPoolStaticTest, IsWarmName) {
+  EXPECT_TRUE(WarmPool::IsWarmName("/_warm.1.0"));
+  EXPECT_TRUE(WarmPool::IsWarmName("/test/_warm.1.0"));
+  EXPECT_FALSE(WarmPool::IsWarmName("/test"));
+  EXPECT_FALSE(WarmPool::IsWarmName("/_warm.1.0/test"));
+}
+
+TEST(WarmPoolStaticTest, CanClaim) {
+  ContainerSpec spec;
+  spec.mutable_memory()->set_limit(100);
+  EXPECT_TRUE(WarmPool::CanClaim(spec));
+
+  spec.set_owner(1);
+  EXPECT_FALSE(WarmPool::CanClaim(spec));
+
+  spec.Clear();
+  spec.set_children_limit(10);
+  EXPECT_FALSE(WarmPool::CanClaim(spec));
+
+  spec.Clear();
+  spec.mutable_virtual_host();
+  EXPECT_FALSE(WarmPool::CanClaim(spec));
+}
+
+TEST(WarmPoolStaticTest, TemplateFor) {
+  ContainerSpec spec;
+  spec.mutable_cpu()->set_limit(1000);
+  spec.mutable_cpu()->set_scheduling_latency(BEST_EFFORT);
+  spec.mutable_memory()->set_limit(100);
+
+  ContainerSpec expected;
+  expected.mutable_cpu()->set_scheduling_latency(BEST_EFFORT);
+  expected.mutable_memory();
+  EXPECT_THAT(WarmPool::TemplateFor(spec), EqualsInitializedProto(expected));
+}
+
+TEST_F(WarmPoolTest, ClaimEmptyPool) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/test", spec));
+  EXPECT_EQ(0, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, Claim) {
+  ContainerSpec spec;
+  spec.mutable_memory()->set_limit(100);
+  const vector<string> warm_names = FillPool("/", spec);
+  ASSERT_EQ(kPoolSize, warm_names.size());
+  EXPECT_EQ(kPoolSize, pool_->Size());
+
+  // Settings other than the isolated resources don't matter.
+  spec.mutable_memory()->set_limit(200);
+  EXPECT_CALL(mock_backend_, RenameWarm(warm_names[0], "/test"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_OK(pool_->Claim("/test", spec));
+  EXPECT_EQ(kPoolSize - 1, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, ClaimDifferentResources) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  FillPool("/", spec);
+
+  spec.mutable_cpu();
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/test", spec));
+  EXPECT_EQ(kPoolSize, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, ClaimDifferentParent) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  FillPool("/parent", spec);
+
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/other/test", spec));
+  EXPECT_EQ(kPoolSize, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, ClaimRenameFails) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  const vector<string> warm_names = FillPool("/", spec);
+
+  EXPECT_CALL(mock_backend_, RenameWarm(warm_names[0], "/test"))
+      .WillOnce(Return(Status(INTERNAL, "")));
+  EXPECT_CALL(mock_backend_, DestroyWarm(warm_names[0]))
+      .WillOnce(Return(Status::OK));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Claim("/test", spec));
+  EXPECT_EQ(kPoolSize - 1, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, RefillFails) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/test", spec));
+
+  EXPECT_CALL(mock_backend_, CreateWarm(_, _))
+      .WillOnce(Return(Status(INTERNAL, "")));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Refill());
+  EXPECT_EQ(0, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, RefillFailsBacksOff) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/test", spec));
+
+  EXPECT_CALL(mock_backend_, CreateWarm(_, _))
+      .WillOnce(Return(Status(INTERNAL, "")));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Refill());
+
+  // The pool is not refilled until it is done backing off.
+  EXPECT_OK(pool_->Refill());
+  pool_->AdvanceNs(50 * 1000 * 1000);
+  EXPECT_OK(pool_->Refill());
+
+  pool_->AdvanceNs(50 * 1000 * 1000);
+  EXPECT_CALL(mock_backend_, CreateWarm(_, _))
+      .Times(kPoolSize)
+      .WillRepeatedly(Return(Status::OK));
+  EXPECT_OK(pool_->Refill());
+  EXPECT_EQ(kPoolSize, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, RefillFailsOtherPoolsRefilled) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/bad/test", spec));
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/good/test", spec));
+
+  // The pool whose parent keeps failing does not starve the other one.
+  EXPECT_CALL(mock_backend_, CreateWarm(StartsWith("/bad/_warm."), _))
+      .WillOnce(Return(Status(INTERNAL, "")));
+  EXPECT_CALL(mock_backend_, CreateWarm(StartsWith("/good/_warm."), _))
+      .Times(kPoolSize)
+      .WillRepeatedly(Return(Status::OK));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Refill());
+  EXPECT_EQ(kPoolSize, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, RefillNamesUniqueAcrossPools) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  const vector<string> warm_names = FillPool("/", spec);
+
+  // Another pool of the process does not reuse the names.
+  StrictMock<WarmPoolUnderTest> other_pool(&mock_backend_, kPoolSize,
+                                           kMaxPools);
+  EXPECT_ERROR_CODE(NOT_FOUND, other_pool.Claim("/test", spec));
+  vector<string> other_warm_names;
+  EXPECT_CALL(mock_backend_, CreateWarm(_, _))
+      .Times(kPoolSize)
+      .WillRepeatedly(Invoke([&other_warm_names](const string &warm_name,
+                                                 const ContainerSpec &spec) {
+        other_warm_names.push_back(warm_name);
+        return Status::OK;
+      }));
+  EXPECT_OK(other_pool.Refill());
+  for (const string &warm_name : other_warm_names) {
+    EXPECT_THAT(warm_names, Not(Contains(warm_name)));
+  }
+}
+
+TEST_F(WarmPoolTest, MaxPools) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  FillPool("/parent1", spec);
+  FillPool("/parent2", spec);
+
+  // No more pools are kept.
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/parent3/test", spec));
+  EXPECT_OK(pool_->Refill());
+  EXPECT_EQ(kMaxPools * kPoolSize, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, Drain) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  const vector<string> warm_names = FillPool("/parent/sub", spec);
+  FillPool("/other", spec);
+
+  for (const string &warm_name : warm_names) {
+    EXPECT_CALL(mock_backend_, DestroyWarm(warm_name))
+        .WillOnce(Return(Status::OK));
+  }
+  EXPECT_OK(pool_->Drain("/parent"));
+  EXPECT_EQ(kPoolSize, pool_->Size());
+
+  // The drained pool is not refilled.
+  EXPECT_OK(pool_->Refill());
+  EXPECT_EQ(kPoolSize, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, DrainAll) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  FillPool("/parent", spec);
+
+  EXPECT_CALL(mock_backend_, DestroyWarm(_))
+      .Times(kPoolSize)
+      .WillRepeatedly(Return(Status::OK));
+  EXPECT_OK(pool_->Drain("/"));
+  EXPECT_EQ(0, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, DrainFails) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  FillPool("/parent", spec);
+
+  // All warm containers are destroyed even if one fails.
+  EXPECT_CALL(mock_backend_, DestroyWarm(_))
+      .WillOnce(Return(Status(INTERNAL, "")))
+      .WillOnce(Return(Status::OK));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Drain("/parent"));
+  EXPECT_EQ(0, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, Evict) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  const vector<string> warm_names = FillPool("/parent", spec);
+  FillPool("/parent/sub", spec);
+
+  // Only the pools directly in the parent are evicted.
+  for (const string &warm_name : warm_names) {
+    EXPECT_CALL(mock_backend_, DestroyWarm(warm_name))
+        .WillOnce(Return(Status::OK));
+  }
+  StatusOr<int> statusor = pool_->Evict("/parent");
+  ASSERT_OK(statusor);
+  EXPECT_EQ(kPoolSize, statusor.ValueOrDie());
+  EXPECT_EQ(kPoolSize, pool_->Size());
+
+  // No pool is kept in the parent anymore.
+  EXPECT_ERROR_CODE(NOT_FOUND, pool_->Claim("/parent/test", spec));
+  EXPECT_OK(pool_->Refill());
+  EXPECT_EQ(kPoolSize, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, EvictEmpty) {
+  StatusOr<int> statusor = pool_->Evict("/parent");
+  ASSERT_OK(statusor);
+  EXPECT_EQ(0, statusor.ValueOrDie());
+}
+
+TEST_F(WarmPoolTest, EvictFails) {
+  ContainerSpec spec;
+  spec.mutable_memory();
+  FillPool("/parent", spec);
+
+  EXPECT_CALL(mock_backend_, DestroyWarm(_))
+      .WillOnce(Return(Status(INTERNAL, "")))
+      .WillOnce(Return(Status::OK));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Evict("/parent"));
+  EXPECT_EQ(0, pool_->Size());
+}
+
+TEST_F(WarmPoolTest, DrainForgetsEvictedParents) {
+  EXPECT_OK(pool_->Evict("/parent"));
+  EXPECT_OK(pool_->Drain("/parent"));
+
+  // Pools are kept again in a parent of the same name.
+  ContainerSpec spec;
+  spec.mutable_memory();
+  EXPECT_EQ(kPoolSize, FillPool("/parent", spec).size());
+}
+
+// Tests for Reap().
+
+TEST_F(WarmPoolTest, Reap) {
+  const string kOwnWarmName = Substitute("/_warm.$0.0", getpid());
+  EXPECT_CALL(mock_backend_, ListWarm("/"))
+      .WillOnce(Return(vector<string>(
+          {"/_warm.100.0", "/test/_warm.100.1", "/test/_warm.200.0",
+           kOwnWarmName, "/_warm.bad"})));
+  EXPECT_CALL(*pool_, ProcessExists(100)).WillRepeatedly(Return(false));
+  EXPECT_CALL(*pool_, ProcessExists(200)).WillRepeatedly(Return(true));
+
+  // Only the warm containers of exited processes are destroyed.
+  EXPECT_CALL(mock_backend_, DestroyWarm("/_warm.100.0"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_CALL(mock_backend_, DestroyWarm("/test/_warm.100.1"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_OK(pool_->Reap());
+}
+
+TEST_F(WarmPoolTest, ReapListFails) {
+  EXPECT_CALL(mock_backend_, ListWarm("/"))
+      .WillOnce(Return(Status(INTERNAL, "")));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Reap());
+}
+
+TEST_F(WarmPoolTest, ReapDestroyFails) {
+  EXPECT_CALL(mock_backend_, ListWarm("/"))
+      .WillOnce(Return(vector<string>(
+          {"/_warm.100.0", "/_warm.100.1", "/_warm.100.2"})));
+  EXPECT_CALL(*pool_, ProcessExists(100)).WillRepeatedly(Return(false));
+
+  // All stale warm containers are destroyed even if one fails, those already
+  // gone are not failures.
+  EXPECT_CALL(mock_backend_, DestroyWarm("/_warm.100.0"))
+      .WillOnce(Return(Status(NOT_FOUND, "")));
+  EXPECT_CALL(mock_backend_, DestroyWarm("/_warm.100.1"))
+      .WillOnce(Return(Status(INTERNAL, "")));
+  EXPECT_CALL(mock_backend_, DestroyWarm("/_warm.100.2"))
+      .WillOnce(Return(Status::OK));
+  EXPECT_ERROR_CODE(INTERNAL, pool_->Reap());
+}
+
+}  // namespace
+}  // namespace lmctfy
+}  // namespace containers
@@ -0,0 +1,114 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// CloneStackPool implementation.
+//
+
+#include "nscon/clone_stack_pool.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "strings/substitute.h"
+#include "util/task/codes.pb.h"
+
+using ::strings::Substitute;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace nscon {
+
+// Rounds size up to a multiple of the page size.
+static size_t RoundUpToPage(size_t size, size_t page_size) {
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+CloneStackPool::CloneStackPool(size_t stack_size, int max_free_stacks)
+    : stack_size_(RoundUpToPage(stack_size, sysconf(_SC_PAGESIZE))),
+      page_size_(sysconf(_SC_PAGESIZE)),
+      max_free_stacks_(max_free_stacks) {
+  CHECK_GT(stack_size_, 0);
+  CHECK_GE(max_free_stacks_, 0);
+}
+
+CloneStackPool::~CloneStackPool() {
+  MutexLock l(&lock_);
+  for (Stack *stack : free_stacks_) {
+    Unmap(stack);
+  }
+}
+
+StatusOr<CloneStackPool::Stack *> CloneStackPool::Acquire() {
+  {
+    MutexLock l(&lock_);
+    if (!free_stacks_.empty()) {
+      Stack *stack = free_stacks_.back();
+      free_stacks_.pop_back();
+      return stack;
+    }
+  }
+
+  // The guard page is at the bottom since stacks grow down.
+  const size_t mapping_size = page_size_ + stack_size_;
+  void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (mapping == MAP_FAILED) {
+    return Status(::util::error::RESOURCE_EXHAUSTED,
+                  Substitute("Failed to map a clone stack: $0",
+                             StrError(errno)));
+  }
+  if (mprotect(mapping, page_size_, PROT_NONE) != 0) {
+    const int mprotect_errno = errno;
+    munmap(mapping, mapping_size);
+    return Status(::util::error::INTERNAL,
+                  Substitute("Failed to protect the clone stack guard page: $0",
+                             StrError(mprotect_errno)));
+  }
+
+  // The mapping is page aligned, so its end is 16-byte aligned.
+  void *top = static_cast<char *>(mapping) + mapping_size;
+  return new Stack(mapping, mapping_size, top);
+}
+
+void CloneStackPool::Release(Stack *stack) {
+  CHECK(stack != nullptr);
+  {
+    MutexLock l(&lock_);
+    if (free_stacks_.size() < max_free_stacks_) {
+      free_stacks_.push_back(stack);
+      return;
+    }
+  }
+
+  Unmap(stack);
+}
+
+int CloneStackPool::num_free_stacks() const {
+  MutexLock l(&lock_);
+  return free_stacks_.size();
+}
+
+void CloneStackPool::Unmap(Stack *stack) {
+  if (munmap(stack->mapping_, stack->mapping_size_) != 0) {
+    LOG(WARNING) << "Failed to unmap clone stack: " << StrError(errno);
+  }
+  delete stack;
+}
+
+}  // namespace nscon
+}  // namespace containers
@@ -0,0 +1,108 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// CloneStackPool hands out the stacks passed to clone() when launching
+// processes.
+//
+
+#ifndef PRODUCTION_CONTAINERS_NSCON_CLONE_STACK_POOL_H_
+#define PRODUCTION_CONTAINERS_NSCON_CLONE_STACK_POOL_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace nscon {
+
+// Keeps a few mmap()ed stacks for clone() so that processes can be launched
+// from several threads at once. Each stack has a guard page below it so that
+// an overflow faults instead of silently writing over other memory.
+//
+// The clone() wrapper writes to the child stack from the calling thread, so a
+// stack must not be shared by concurrent launches. Without CLONE_VM the child
+// gets its own copy of the stack, which can then be released as soon as
+// clone() returns.
+//
+// Class is thread-safe.
+class CloneStackPool {
+ public:
+  // A stack from the pool.
+  class Stack {
+   public:
+    // Address to pass to clone(): the (16-byte aligned) top of the stack.
+    void *top() const { return top_; }
+
+   private:
+    Stack(void *mapping, size_t mapping_size, void *top)
+        : mapping_(mapping), mapping_size_(mapping_size), top_(top) {}
+
+    // The whole mapping, guard page included.
+    void *const mapping_;
+    const size_t mapping_size_;
+    void *const top_;
+
+    friend class CloneStackPool;
+
+    DISALLOW_COPY_AND_ASSIGN(Stack);
+  };
+
+  // Arguments:
+  //   stack_size: Usable size of each stack, rounded up to whole pages.
+  //   max_free_stacks: Maximum number of released stacks kept for reuse.
+  //       Stacks released past this are unmapped.
+  CloneStackPool(size_t stack_size, int max_free_stacks);
+
+  // Unmaps the free stacks. All acquired stacks must have been released.
+  ~CloneStackPool();
+
+  // Gets a stack that no other caller is using, mapping a new one if none is
+  // free.
+  //
+  // Return:
+  //   StatusOr: OK iff a stack was available. The caller owns the stack until
+  //       it releases it.
+  ::util::StatusOr<Stack *> Acquire() LOCKS_EXCLUDED(lock_);
+
+  // Returns the stack to the pool. Takes ownership of stack.
+  void Release(Stack *stack) LOCKS_EXCLUDED(lock_);
+
+  // Number of stacks ready to be acquired.
+  int num_free_stacks() const LOCKS_EXCLUDED(lock_);
+
+ private:
+  // Unmaps the stack and deletes it.
+  static void Unmap(Stack *stack);
+
+  const size_t stack_size_;
+  const size_t page_size_;
+  const int max_free_stacks_;
+
+  // Stacks ready to be acquired, owned.
+  ::std::vector<Stack *> free_stacks_ GUARDED_BY(lock_);
+  mutable Mutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(CloneStackPool);
+};
+
+}  // namespace nscon
+}  // namespace containers
+
+#endif  // PRODUCTION_CONTAINERS_NSCON_CLONE_STACK_POOL_H_
@@ -0,0 +1,115 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// Tests for CloneStackPool class.
+//
+
+#include "nscon/clone_stack_pool.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+using ::std::unique_ptr;
+
+namespace containers {
+namespace nscon {
+
+static const size_t kStackSize = 64 * 1024;
+static const int kMaxFreeStacks = 2;
+
+class CloneStackPoolTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    pool_.reset(new CloneStackPool(kStackSize, kMaxFreeStacks));
+  }
+
+  CloneStackPool::Stack *Acquire() {
+    auto statusor = pool_->Acquire();
+    EXPECT_TRUE(statusor.ok());
+    return statusor.ValueOrDie();
+  }
+
+ protected:
+  unique_ptr<CloneStackPool> pool_;
+};
+
+TEST_F(CloneStackPoolTest, StackIsUsable) {
+  CloneStackPool::Stack *stack = Acquire();
+  ASSERT_NE(nullptr, stack->top());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(stack->top()) % 16);
+
+  // The whole stack can be written.
+  char *top = static_cast<char *>(stack->top());
+  memset(top - kStackSize, 0xab, kStackSize);
+
+  pool_->Release(stack);
+}
+
+TEST_F(CloneStackPoolTest, StackHasGuardPage) {
+  CloneStackPool::Stack *stack = Acquire();
+
+  // The page below the stack is mapped (mincore() fails otherwise) but can't
+  // be accessed.
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  char *guard = static_cast<char *>(stack->top()) - kStackSize - page_size;
+  unsigned char residency;
+  EXPECT_EQ(0, mincore(guard, page_size, &residency));
+  EXPECT_DEATH({ *guard = 0; }, "");
+
+  pool_->Release(stack);
+}
+
+TEST_F(CloneStackPoolTest, ConcurrentStacksAreDistinct) {
+  CloneStackPool::Stack *stack1 = Acquire();
+  CloneStackPool::Stack *stack2 = Acquire();
+  EXPECT_NE(stack1->top(), stack2->top());
+
+  pool_->Release(stack1);
+  pool_->Release(stack2);
+}
+
+TEST_F(CloneStackPoolTest, ReleasedStacksAreReused) {
+  CloneStackPool::Stack *stack = Acquire();
+  void *top = stack->top();
+  pool_->Release(stack);
+  EXPECT_EQ(1, pool_->num_free_stacks());
+
+  stack = Acquire();
+  EXPECT_EQ(top, stack->top());
+  EXPECT_EQ(0, pool_->num_free_stacks());
+  pool_->Release(stack);
+}
+
+TEST_F(CloneStackPoolTest, MaxFreeStacks) {
+  CloneStackPool::Stack *stacks[kMaxFreeStacks + 1];
+  for (int i = 0; i < kMaxFreeStacks + 1; ++i) {
+    stacks[i] = Acquire();
+  }
+  for (int i = 0; i < kMaxFreeStacks + 1; ++i) {
+    pool_->Release(stacks[i]);
+  }
+
+  // The extra stack was unmapped.
+  EXPECT_EQ(kMaxFreeStacks, pool_->num_free_stacks());
+}
+
+}  // namespace nscon
+}  // namespace containers
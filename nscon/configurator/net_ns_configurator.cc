@@ -199,6 +199,9 @@ Status NetNsConfigurator::SetupOutsideNamespace(const NamespaceSpec &spec,
 
   const Network &net_spec = spec.net();
   RETURN_IF_ERROR(SanityCheckNetSpec(net_spec));
+  if (rtnetlink_factory_ != nullptr) {
+    return SetupOutsideNamespaceWithRtNetlink(net_spec, init_pid);
+  }
 
   unique_ptr<SubProcess> sp(subprocess_factory_->Run());
   if (net_spec.has_connection()) {
@@ -246,6 +249,9 @@ NetNsConfigurator::SetupInsideNamespace(const NamespaceSpec &spec) const {
 
   const Network &net_spec = spec.net();
   RETURN_IF_ERROR(SanityCheckNetSpec(net_spec));
+  if (rtnetlink_factory_ != nullptr) {
+    return SetupInsideNamespaceWithRtNetlink(net_spec);
+  }
 
   unique_ptr<SubProcess> sp(subprocess_factory_->Run());
   // Activate the loopback interface.
@@ -278,5 +284,85 @@ NetNsConfigurator::SetupInsideNamespace(const NamespaceSpec &spec) const {
   return Status::OK;
 }
 
+Status NetNsConfigurator::SetupOutsideNamespaceWithRtNetlink(
+    const Network &net_spec, pid_t init_pid) const {
+  unique_ptr<RtNetlink> rtnetlink(
+      RETURN_IF_ERROR(rtnetlink_factory_->Create()));
+  if (net_spec.has_connection()) {
+    const auto &connection = net_spec.connection();
+    const Network_VethPair &veth_pair = connection.veth_pair();
+    // The veth pair is created on its own so that a failure to create it (e.g.:
+    // it already exists) is not followed by configuring someone else's link.
+    rtnetlink->AddVethPair(veth_pair.outside(), veth_pair.inside(), init_pid);
+    RETURN_IF_ERROR(rtnetlink->Commit());
+
+    if (connection.has_bridge()) {
+      const Network_Bridge &bridge = connection.bridge();
+      if (bridge.has_type() && bridge.type() == Network::Bridge::OVS) {
+        // OVS ports can only be added through ovs-vsctl.
+        unique_ptr<SubProcess> sp(subprocess_factory_->Run());
+        RETURN_IF_ERROR(RunCommand(
+            GetOvsBridgeAddInterfaceCommand(veth_pair.outside(),
+                                            bridge.name()),
+            sp.get()));
+      } else {
+        RETURN_IF_ERROR(
+            rtnetlink->SetMaster(veth_pair.outside(), bridge.name()));
+      }
+    }
+
+    if (net_spec.has_virtual_ip() && net_spec.virtual_ip().has_mtu()) {
+      rtnetlink->SetMtu(veth_pair.outside(), net_spec.virtual_ip().mtu());
+    }
+    rtnetlink->SetUp(veth_pair.outside());
+    return rtnetlink->Commit();
+  }
+
+  if (net_spec.has_interface()) {
+    rtnetlink->MoveToNetNs(net_spec.interface(), init_pid);
+    return rtnetlink->Commit();
+  }
+
+  // Nothing to do if neither interface nor connection are specified.
+  return Status::OK;
+}
+
+Status NetNsConfigurator::SetupInsideNamespaceWithRtNetlink(
+    const Network &net_spec) const {
+  // The socket has to be created inside the namespace to configure its links.
+  unique_ptr<RtNetlink> rtnetlink(
+      RETURN_IF_ERROR(rtnetlink_factory_->Create()));
+  rtnetlink->SetUp("lo");
+
+  string interface;
+  if (net_spec.has_interface()) {
+    interface = net_spec.interface();
+  } else if (net_spec.has_connection()) {
+    interface = net_spec.connection().veth_pair().inside();
+  } else {
+    return rtnetlink->Commit();  // no interface inside namespace to configure.
+  }
+
+  rtnetlink->SetUp(interface);
+  if (!net_spec.has_virtual_ip()) {
+    return rtnetlink->Commit();  // no further configuration required.
+  }
+
+  Network_VirtualIp virtual_ip = net_spec.virtual_ip();
+  if (virtual_ip.has_mtu()) {
+    rtnetlink->SetMtu(interface, virtual_ip.mtu());
+    virtual_ip.clear_mtu();
+  }
+  RETURN_IF_ERROR(rtnetlink->Commit());
+
+  // Addresses, routes and sysctls are still configured by commands.
+  unique_ptr<SubProcess> sp(subprocess_factory_->Run());
+  for (const auto &argv :
+       GetConfigureNetworkInterfaceCommands(interface, virtual_ip)) {
+    RETURN_IF_ERROR(RunCommand(argv, sp.get()));
+  }
+  return Status::OK;
+}
+
 }  // namespace nscon
 }  // namespace containers
@@ -20,6 +20,7 @@
 #include "base/callback.h"
 #include "base/macros.h"
 #include "nscon/configurator/ns_configurator.h"
+#include "nscon/configurator/rtnetlink.h"
 #include "include/namespaces.pb.h"
 
 class SubProcess;
@@ -33,7 +34,17 @@ class NetNsConfigurator : public NsConfigurator {
   // Takes ownership of |spf|.  Does not take ownership of |ns_util|.
   // TODO(ameyd): Remove 'ns' from the arguments of constructor.
   NetNsConfigurator(NsUtil *ns_util, SubProcessFactory *spf)
-      : NsConfigurator(CLONE_NEWNET, ns_util), subprocess_factory_(spf) {}
+      : NetNsConfigurator(ns_util, spf, nullptr) {}
+
+  // Takes ownership of |spf| and |rtnetlink_factory|.  Does not take ownership
+  // of |ns_util|. Unless |rtnetlink_factory| is null, links are configured
+  // through rtnetlink and commands are only run to attach to OVS bridges and
+  // to configure addresses, routes and sysctls.
+  NetNsConfigurator(NsUtil *ns_util, SubProcessFactory *spf,
+                    RtNetlinkFactory *rtnetlink_factory)
+      : NsConfigurator(CLONE_NEWNET, ns_util),
+        subprocess_factory_(spf),
+        rtnetlink_factory_(rtnetlink_factory) {}
 
   ~NetNsConfigurator() override {}
 
@@ -100,8 +111,22 @@ class NetNsConfigurator : public NsConfigurator {
   ::util::Status RunCommand(const ::std::vector<string> &command,
                             SubProcess *sp) const;
 
+  // Same as SetupOutsideNamespace(), but the veth pair is created, attached to
+  // an ethernet bridge, and brought up (or the interface moved) with a single
+  // rtnetlink message.
+  ::util::Status SetupOutsideNamespaceWithRtNetlink(const Network &net_spec,
+                                                    pid_t init_pid) const;
+
+  // Same as SetupInsideNamespace(), but the links are brought up and their MTU
+  // set with a single rtnetlink message.
+  ::util::Status SetupInsideNamespaceWithRtNetlink(
+      const Network &net_spec) const;
+
   ::std::unique_ptr<SubProcessFactory> subprocess_factory_;
 
+  // Null if links are configured by running commands.
+  ::std::unique_ptr<RtNetlinkFactory> rtnetlink_factory_;
+
   friend class NetNsConfiguratorTest;
   DISALLOW_COPY_AND_ASSIGN(NetNsConfigurator);
 };
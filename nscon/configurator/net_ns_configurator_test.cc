@@ -18,6 +18,7 @@
 
 #include "nscon/configurator/net_ns_configurator.h"
 
+#include "nscon/configurator/rtnetlink_mock.h"
 #include "nscon/ns_util_mock.h"
 #include "include/namespaces.pb.h"
 #include "util/errors_test_util.h"
@@ -31,6 +32,7 @@ using ::std::unique_ptr;
 using ::strings::Join;
 using ::testing::_;
 using ::testing::AtLeast;
+using ::testing::InSequence;
 using ::testing::Sequence;
 using ::testing::NotNull;
 using ::testing::Return;
@@ -717,6 +719,197 @@ TEST_F(NetNsConfiguratorTest, SetupInsideNamespace_Success) {
   ASSERT_OK(net_ns_config_->SetupInsideNamespace(spec));
 }
 
+class NetNsConfiguratorRtNetlinkTest : public NetNsConfiguratorTest {
+ protected:
+  void SetUp() override {
+    NetNsConfiguratorTest::SetUp();
+    mock_rtnetlink_factory_ = new ::testing::StrictMock<MockRtNetlinkFactory>();
+    mock_rtnetlink_ = new ::testing::StrictMock<MockRtNetlink>();
+    SubProcessFactory *mock_subprocess_factory =
+        NewPermanentCallback(&IdentitySubProcessFactory, mock_subprocess_);
+    net_ns_config_.reset(new NetNsConfigurator(mock_ns_util_.get(),
+                                               mock_subprocess_factory,
+                                               mock_rtnetlink_factory_));
+    EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+        .WillRepeatedly(Return(mock_rtnetlink_));
+  }
+
+  MockRtNetlinkFactory *mock_rtnetlink_factory_;
+  MockRtNetlink *mock_rtnetlink_;
+};
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupOutsideNamespace_VethSuccess) {
+  NamespaceSpec spec;
+  auto *connection = spec.mutable_net()->mutable_connection();
+  connection->mutable_veth_pair()->set_outside("vethXYZ123");
+  connection->mutable_veth_pair()->set_inside(kInterface);
+  connection->mutable_bridge()->set_name("my_bridge");
+  spec.mutable_net()->mutable_virtual_ip()->set_ip(kVip);
+  spec.mutable_net()->mutable_virtual_ip()->set_mtu(1500);
+
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_rtnetlink_, AddVethPair("vethXYZ123", kInterface, kPid));
+    EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+    EXPECT_CALL(*mock_rtnetlink_, SetMaster("vethXYZ123", "my_bridge"))
+        .WillOnce(Return(Status::OK));
+    EXPECT_CALL(*mock_rtnetlink_, SetMtu("vethXYZ123", 1500));
+    EXPECT_CALL(*mock_rtnetlink_, SetUp("vethXYZ123"));
+    EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+  }
+
+  ASSERT_OK(net_ns_config_->SetupOutsideNamespace(spec, kPid));
+  delete mock_subprocess_;
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupOutsideNamespace_NoBridge) {
+  NamespaceSpec spec;
+  auto *connection = spec.mutable_net()->mutable_connection();
+  connection->mutable_veth_pair()->set_outside("vethXYZ123");
+  connection->mutable_veth_pair()->set_inside(kInterface);
+  connection->mutable_bridge()->set_name("my_bridge");
+
+  EXPECT_CALL(*mock_rtnetlink_, AddVethPair("vethXYZ123", kInterface, kPid));
+  EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+  EXPECT_CALL(*mock_rtnetlink_, SetMaster("vethXYZ123", "my_bridge"))
+      .WillOnce(Return(Status(::util::error::NOT_FOUND, "")));
+
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    net_ns_config_->SetupOutsideNamespace(spec, kPid));
+  delete mock_subprocess_;
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupOutsideNamespace_VethExists) {
+  NamespaceSpec spec;
+  auto *connection = spec.mutable_net()->mutable_connection();
+  connection->mutable_veth_pair()->set_outside("vethXYZ123");
+  connection->mutable_veth_pair()->set_inside(kInterface);
+  connection->mutable_bridge()->set_name("my_bridge");
+  spec.mutable_net()->mutable_virtual_ip()->set_ip(kVip);
+  spec.mutable_net()->mutable_virtual_ip()->set_mtu(1500);
+
+  // The existing link is left alone: not bridged, resized, nor brought up.
+  EXPECT_CALL(*mock_rtnetlink_, AddVethPair("vethXYZ123", kInterface, kPid));
+  EXPECT_CALL(*mock_rtnetlink_, Commit())
+      .WillOnce(Return(Status(::util::error::ALREADY_EXISTS, "")));
+
+  EXPECT_ERROR_CODE(::util::error::ALREADY_EXISTS,
+                    net_ns_config_->SetupOutsideNamespace(spec, kPid));
+  delete mock_subprocess_;
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupOutsideNamespace_OvsBridge) {
+  NamespaceSpec spec;
+  auto *connection = spec.mutable_net()->mutable_connection();
+  connection->mutable_veth_pair()->set_outside("vethXYZ123");
+  connection->mutable_veth_pair()->set_inside(kInterface);
+  connection->mutable_bridge()->set_name("my_bridge");
+  connection->mutable_bridge()->set_type(Network::Bridge::OVS);
+  FLAGS_nscon_ovs_bin = "ovs-vsctl";
+
+  CommonMockSubProcessSetup();
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_rtnetlink_, AddVethPair("vethXYZ123", kInterface, kPid));
+    EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+    EXPECT_CALL(*mock_subprocess_,
+                SetArgv(CallGetOvsBridgeAddInterfaceCommand("vethXYZ123",
+                                                            "my_bridge")));
+    EXPECT_CALL(*mock_subprocess_, Communicate(NotNull(), NotNull()))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*mock_rtnetlink_, SetUp("vethXYZ123"));
+    EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+  }
+
+  ASSERT_OK(net_ns_config_->SetupOutsideNamespace(spec, kPid));
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupOutsideNamespace_MoveDevToNs) {
+  NamespaceSpec spec;
+  spec.mutable_net()->set_interface(kInterface);
+
+  EXPECT_CALL(*mock_rtnetlink_, MoveToNetNs(kInterface, kPid));
+  EXPECT_CALL(*mock_rtnetlink_, Commit())
+      .WillOnce(Return(Status(::util::error::INTERNAL, "")));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    net_ns_config_->SetupOutsideNamespace(spec, kPid));
+  delete mock_subprocess_;
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupOutsideNamespace_CreateFails) {
+  NamespaceSpec spec;
+  spec.mutable_net()->set_interface(kInterface);
+
+  EXPECT_CALL(*mock_rtnetlink_factory_, Create())
+      .WillOnce(Return(Status(::util::error::INTERNAL, "")));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    net_ns_config_->SetupOutsideNamespace(spec, kPid));
+  delete mock_rtnetlink_;
+  delete mock_subprocess_;
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupInsideNamespace_NoInterface) {
+  NamespaceSpec spec;
+  spec.mutable_net();
+
+  EXPECT_CALL(*mock_rtnetlink_, SetUp("lo"));
+  EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+
+  ASSERT_OK(net_ns_config_->SetupInsideNamespace(spec));
+  delete mock_subprocess_;
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupInsideNamespace_CommitFails) {
+  NamespaceSpec spec;
+  spec.mutable_net()->set_interface(kInterface);
+  spec.mutable_net()->mutable_virtual_ip()->set_ip(kVip);
+
+  EXPECT_CALL(*mock_rtnetlink_, SetUp("lo"));
+  EXPECT_CALL(*mock_rtnetlink_, SetUp(kInterface));
+  EXPECT_CALL(*mock_rtnetlink_, Commit())
+      .WillOnce(Return(Status(::util::error::INTERNAL, "")));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL,
+                    net_ns_config_->SetupInsideNamespace(spec));
+  delete mock_subprocess_;
+}
+
+TEST_F(NetNsConfiguratorRtNetlinkTest, SetupInsideNamespace_Success) {
+  NamespaceSpec spec;
+  spec.mutable_net()->set_interface(kInterface);
+  spec.mutable_net()->mutable_virtual_ip()->set_ip(kVip);
+  spec.mutable_net()->mutable_virtual_ip()->set_netmask(kNetmask);
+  spec.mutable_net()->mutable_virtual_ip()->set_gateway(kGateway);
+  spec.mutable_net()->mutable_virtual_ip()->set_mtu(1500);
+  spec.mutable_net()->mutable_virtual_ip()->set_ip_forward(true);
+
+  {
+    InSequence s;
+    EXPECT_CALL(*mock_rtnetlink_, SetUp("lo"));
+    EXPECT_CALL(*mock_rtnetlink_, SetUp(kInterface));
+    EXPECT_CALL(*mock_rtnetlink_, SetMtu(kInterface, 1500));
+    EXPECT_CALL(*mock_rtnetlink_, Commit()).WillOnce(Return(Status::OK));
+  }
+
+  // Only the address, route and sysctl are set by commands.
+  Network_VirtualIp virtual_ip = spec.net().virtual_ip();
+  virtual_ip.clear_mtu();
+  const vector<vector<string>> commands =
+      CallConfigureNetworkInterfaceCommands(kInterface, virtual_ip);
+  ASSERT_EQ(3, commands.size());
+  for (const auto &argv : commands) {
+    EXPECT_CALL(*mock_subprocess_, SetArgv(argv));
+  }
+
+  CommonMockSubProcessSetup();
+  EXPECT_CALL(*mock_subprocess_, Communicate(NotNull(), NotNull()))
+      .Times(3)
+      .WillRepeatedly(Return(0));
+  ASSERT_OK(net_ns_config_->SetupInsideNamespace(spec));
+}
+
 }  // namespace nscon
 }  // namespace containers
 
@@ -22,9 +22,11 @@
 #include "nscon/configurator/mnt_ns_configurator.h"
 #include "nscon/configurator/net_ns_configurator.h"
 #include "nscon/configurator/ns_configurator.h"
+#include "nscon/configurator/rtnetlink.h"
 #include "nscon/configurator/user_ns_configurator.h"
 #include "nscon/configurator/uts_ns_configurator.h"
 #include "nscon/ns_util.h"
+#include "gflags/gflags.h"
 #include "util/errors.h"
 #include "strings/substitute.h"
 #include "util/process/subprocess.h"
@@ -33,6 +35,10 @@ using ::strings::Substitute;
 using ::util::Status;
 using ::util::StatusOr;
 
+DEFINE_bool(nscon_use_rtnetlink, true,
+            "Whether to configure network links through rtnetlink rather than "
+            "by running ip and brctl.");
+
 namespace containers {
 namespace nscon {
 
@@ -56,8 +62,9 @@ StatusOr<NsConfigurator *> NsConfiguratorFactory::Get(int ns) const {
     case CLONE_NEWIPC:
       return new NsConfigurator(ns, ns_util_);  // Default implementation.
     case CLONE_NEWNET:
-      return new NetNsConfigurator(ns_util_,
-                                   NewPermanentCallback(&NewSubProcess));
+      return new NetNsConfigurator(
+          ns_util_, NewPermanentCallback(&NewSubProcess),
+          FLAGS_nscon_use_rtnetlink ? new RtNetlinkFactory() : nullptr);
     case CLONE_NEWNS:
       return new MntNsConfigurator(ns_util_);
     case CLONE_NEWUSER:
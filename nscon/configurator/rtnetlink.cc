@@ -0,0 +1,387 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// RtNetlink implementation
+//
+
+#include "nscon/configurator/rtnetlink.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/veth.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <string.h>
+
+#include "util/errors.h"
+#include "system_api/libc_fs_api.h"
+#include "system_api/libc_net_api.h"
+#include "strings/substitute.h"
+
+using ::std::vector;
+using ::system_api::GlobalLibcFsApi;
+using ::system_api::GlobalLibcNetApi;
+using ::strings::Substitute;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace nscon {
+
+// Size of the buffer acks are read into. Each ack is read on its own and is at
+// most a nlmsgerr followed by the request it acks.
+static const size_t kAckBufferSize = 8192;
+
+// Size of the buffer link dumps are read into. The kernel fills each read of a
+// dump with as many links as fit, up to 32KiB.
+static const size_t kDumpBufferSize = 32768;
+
+// Returns |data| padded with zeros to the netlink alignment.
+static string Pad(const string &data) {
+  return data + string(NLMSG_ALIGN(data.size()) - data.size(), '\0');
+}
+
+// Returns a route attribute of |type| holding |len| bytes at |data|.
+static string Attribute(uint16 type, const void *data, size_t len) {
+  struct rtattr rta;
+  rta.rta_type = type;
+  rta.rta_len = RTA_LENGTH(len);
+  string attribute(reinterpret_cast<const char *>(&rta), sizeof(rta));
+  attribute.append(reinterpret_cast<const char *>(data), len);
+  return Pad(attribute);
+}
+
+static string StringAttribute(uint16 type, const string &value) {
+  // The kernel expects names to be NUL-terminated.
+  return Attribute(type, value.c_str(), value.size() + 1);
+}
+
+static string Uint32Attribute(uint16 type, uint32 value) {
+  return Attribute(type, &value, sizeof(value));
+}
+
+// Returns an attribute of |type| that nests the |attributes|.
+static string NestedAttribute(uint16 type, const string &attributes) {
+  return Attribute(type, attributes.data(), attributes.size());
+}
+
+// Returns a link header that sets the link |flags| in |change|.
+static string LinkHeader(uint32 flags, uint32 change) {
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  ifi.ifi_flags = flags;
+  ifi.ifi_change = change;
+  return Pad(string(reinterpret_cast<const char *>(&ifi), sizeof(ifi)));
+}
+
+// Returns the string held in the attribute |rta|, without its terminating NUL.
+static string StringAttributeValue(const struct rtattr *rta) {
+  const char *value = static_cast<const char *>(RTA_DATA(rta));
+  return string(value, strnlen(value, RTA_PAYLOAD(rta)));
+}
+
+// Sets the counters of |link| from the kernel's 32 or 64 bit link |stats|.
+template <typename LinkStats>
+static void SetLinkCounters(const LinkStats &stats, RtNetlink::Link *link) {
+  link->rx_bytes = stats.rx_bytes;
+  link->rx_packets = stats.rx_packets;
+  link->rx_errors = stats.rx_errors;
+  link->rx_dropped = stats.rx_dropped;
+  link->tx_bytes = stats.tx_bytes;
+  link->tx_packets = stats.tx_packets;
+  link->tx_errors = stats.tx_errors;
+  link->tx_dropped = stats.tx_dropped;
+}
+
+// Returns the link described by the RTM_NEWLINK message |nlh|.
+static RtNetlink::Link ParseLink(const struct nlmsghdr *nlh) {
+  RtNetlink::Link link;
+  bool have_stats64 = false;
+  int len = IFLA_PAYLOAD(nlh);
+  for (const struct rtattr *rta = IFLA_RTA(NLMSG_DATA(nlh)); RTA_OK(rta, len);
+       rta = RTA_NEXT(rta, len)) {
+    switch (rta->rta_type) {
+      case IFLA_IFNAME:
+        link.name = StringAttributeValue(rta);
+        break;
+      case IFLA_IFALIAS:
+        link.alias = StringAttributeValue(rta);
+        break;
+      case IFLA_STATS64:
+        if (RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64)) {
+          // The attribute is only 4 byte aligned.
+          struct rtnl_link_stats64 stats;
+          memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+          SetLinkCounters(stats, &link);
+          have_stats64 = true;
+        }
+        break;
+      case IFLA_STATS:
+        // Older kernels only have the 32 bit counters.
+        if (!have_stats64 &&
+            RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats)) {
+          struct rtnl_link_stats stats;
+          memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+          SetLinkCounters(stats, &link);
+        }
+        break;
+    }
+  }
+  return link;
+}
+
+StatusOr<RtNetlink *> RtNetlinkFactory::Create() const {
+  const int fd = GlobalLibcNetApi()->Socket(
+      AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0) {
+    return Status(::util::error::INTERNAL,
+                  Substitute("socket(NETLINK_ROUTE) failed: $0",
+                             StrError(errno)));
+  }
+  return new RtNetlink(fd);
+}
+
+RtNetlink::~RtNetlink() {
+  if (fd_ >= 0) {
+    GlobalLibcFsApi()->Close(fd_);
+  }
+}
+
+void RtNetlink::QueueNewLink(uint16 nlmsg_flags, const string &interface,
+                             uint32 flags, uint32 change,
+                             const string &attributes,
+                             const string &description) {
+  const string payload = LinkHeader(flags, change) +
+                         StringAttribute(IFLA_IFNAME, interface) + attributes;
+
+  struct nlmsghdr nlh;
+  memset(&nlh, 0, sizeof(nlh));
+  nlh.nlmsg_len = NLMSG_LENGTH(payload.size());
+  nlh.nlmsg_type = RTM_NEWLINK;
+  nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | nlmsg_flags;
+  nlh.nlmsg_seq = next_seq_++;
+  requests_.append(
+      Pad(string(reinterpret_cast<const char *>(&nlh), sizeof(nlh))));
+  requests_.append(payload);
+  descriptions_.push_back(description);
+}
+
+void RtNetlink::AddVethPair(const string &outside, const string &inside,
+                            pid_t pid) {
+  const string peer = LinkHeader(0, 0) + StringAttribute(IFLA_IFNAME, inside) +
+                      Uint32Attribute(IFLA_NET_NS_PID, pid);
+  const string link_info =
+      StringAttribute(IFLA_INFO_KIND, "veth") +
+      NestedAttribute(IFLA_INFO_DATA, NestedAttribute(VETH_INFO_PEER, peer));
+  QueueNewLink(NLM_F_CREATE | NLM_F_EXCL, outside, 0, 0,
+               NestedAttribute(IFLA_LINKINFO, link_info),
+               Substitute("create veth pair $0/$1", outside, inside));
+}
+
+void RtNetlink::MoveToNetNs(const string &interface, pid_t pid) {
+  QueueNewLink(0, interface, 0, 0, Uint32Attribute(IFLA_NET_NS_PID, pid),
+               Substitute("move $0 to the network namespace of $1", interface,
+                          pid));
+}
+
+void RtNetlink::SetMtu(const string &interface, int32 mtu) {
+  QueueNewLink(0, interface, 0, 0, Uint32Attribute(IFLA_MTU, mtu),
+               Substitute("set mtu of $0 to $1", interface, mtu));
+}
+
+void RtNetlink::SetUp(const string &interface) {
+  QueueNewLink(0, interface, IFF_UP, IFF_UP, "",
+               Substitute("bring up $0", interface));
+}
+
+void RtNetlink::SetAlias(const string &interface, const string &alias) {
+  QueueNewLink(0, interface, 0, 0, StringAttribute(IFLA_IFALIAS, alias),
+               Substitute("set alias of $0 to \"$1\"", interface, alias));
+}
+
+Status RtNetlink::SetMaster(const string &interface, const string &bridge) {
+  const unsigned int index = GlobalLibcNetApi()->IfNameToIndex(bridge.c_str());
+  if (index == 0) {
+    return Status(::util::error::NOT_FOUND,
+                  Substitute("Bridge $0 not found: $1", bridge,
+                             StrError(errno)));
+  }
+  QueueNewLink(0, interface, 0, 0, Uint32Attribute(IFLA_MASTER, index),
+               Substitute("attach $0 to bridge $1", interface, bridge));
+  return Status::OK;
+}
+
+Status RtNetlink::Commit() {
+  if (descriptions_.empty()) {
+    return Status::OK;
+  }
+
+  const uint32 first_seq = next_seq_ - descriptions_.size();
+  const string requests = requests_;
+  requests_.clear();
+
+  Status status = Send(requests);
+  if (status.ok()) {
+    status = ReadAcks(first_seq);
+  }
+  descriptions_.clear();
+  return status;
+}
+
+StatusOr<vector<RtNetlink::Link>> RtNetlink::GetLinks() {
+  if (!descriptions_.empty()) {
+    return Status(::util::error::FAILED_PRECONDITION,
+                  "Cannot dump links while link requests are queued");
+  }
+
+  const string payload = LinkHeader(0, 0);
+  struct nlmsghdr nlh;
+  memset(&nlh, 0, sizeof(nlh));
+  nlh.nlmsg_len = NLMSG_LENGTH(payload.size());
+  nlh.nlmsg_type = RTM_GETLINK;
+  nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  nlh.nlmsg_seq = next_seq_++;
+  RETURN_IF_ERROR(
+      Send(Pad(string(reinterpret_cast<const char *>(&nlh), sizeof(nlh))) +
+           payload));
+
+  vector<Link> links;
+  RETURN_IF_ERROR(ReadLinks(nlh.nlmsg_seq, &links));
+  return links;
+}
+
+Status RtNetlink::Send(const string &data) {
+  const ssize_t sent =
+      GlobalLibcNetApi()->Send(fd_, data.data(), data.size(), 0);
+  if (sent < 0) {
+    return Status(::util::error::INTERNAL,
+                  Substitute("send() on rtnetlink socket failed: $0",
+                             StrError(errno)));
+  }
+  if (sent != data.size()) {
+    return Status(::util::error::INTERNAL,
+                  Substitute("Short send() on rtnetlink socket: $0 of $1",
+                             sent, data.size()));
+  }
+  return Status::OK;
+}
+
+Status RtNetlink::ReadAcks(uint32 first_seq) {
+  // Keep the buffer aligned for the netlink headers.
+  uint32 buf[kAckBufferSize / sizeof(uint32)];
+  ::std::vector<bool> acked(descriptions_.size(), false);
+  int num_acked = 0;
+  Status status = Status::OK;
+
+  while (num_acked < descriptions_.size()) {
+    const ssize_t recvd = GlobalLibcNetApi()->Recv(fd_, buf, sizeof(buf), 0);
+    if (recvd < 0 && errno == EINTR) {
+      continue;
+    }
+    if (recvd < 0) {
+      return Status(::util::error::INTERNAL,
+                    Substitute("recv() on rtnetlink socket failed: $0",
+                               StrError(errno)));
+    }
+    if (recvd == 0) {
+      return Status(::util::error::INTERNAL,
+                    "rtnetlink socket closed before all requests were acked");
+    }
+
+    int len = recvd;
+    for (struct nlmsghdr *nlh = reinterpret_cast<struct nlmsghdr *>(buf);
+         NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+      if (nlh->nlmsg_type != NLMSG_ERROR ||
+          nlh->nlmsg_seq < first_seq ||
+          nlh->nlmsg_seq - first_seq >= descriptions_.size() ||
+          nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+        continue;
+      }
+
+      const uint32 i = nlh->nlmsg_seq - first_seq;
+      if (acked[i]) {
+        continue;
+      }
+      acked[i] = true;
+      ++num_acked;
+
+      const struct nlmsgerr *err =
+          reinterpret_cast<const struct nlmsgerr *>(NLMSG_DATA(nlh));
+      if (err->error != 0 && status.ok()) {
+        status = Status(err->error == -EEXIST ? ::util::error::ALREADY_EXISTS
+                                              : ::util::error::INTERNAL,
+                        Substitute("Failed to $0: $1", descriptions_[i],
+                                   StrError(-err->error)));
+      }
+    }
+  }
+
+  return status;
+}
+
+Status RtNetlink::ReadLinks(uint32 seq, vector<Link> *links) {
+  // Keep the buffer aligned for the netlink headers.
+  vector<uint32> buf(kDumpBufferSize / sizeof(uint32));
+
+  while (true) {
+    const ssize_t recvd = GlobalLibcNetApi()->Recv(
+        fd_, buf.data(), buf.size() * sizeof(uint32), 0);
+    if (recvd < 0 && errno == EINTR) {
+      continue;
+    }
+    if (recvd < 0) {
+      return Status(::util::error::INTERNAL,
+                    Substitute("recv() on rtnetlink socket failed: $0",
+                               StrError(errno)));
+    }
+    if (recvd == 0) {
+      return Status(::util::error::INTERNAL,
+                    "rtnetlink socket closed before the link dump ended");
+    }
+
+    int len = recvd;
+    for (struct nlmsghdr *nlh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+         NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+      // Skip leftovers of earlier requests.
+      if (nlh->nlmsg_seq != seq) {
+        continue;
+      }
+      if (nlh->nlmsg_type == NLMSG_DONE) {
+        return Status::OK;
+      }
+      if (nlh->nlmsg_type == NLMSG_ERROR) {
+        if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+          return Status(::util::error::INTERNAL,
+                        "Truncated error in the link dump");
+        }
+        const struct nlmsgerr *err =
+            reinterpret_cast<const struct nlmsgerr *>(NLMSG_DATA(nlh));
+        return Status(::util::error::INTERNAL,
+                      Substitute("Failed to dump links: $0",
+                                 StrError(-err->error)));
+      }
+      if (nlh->nlmsg_type != RTM_NEWLINK ||
+          nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg))) {
+        continue;
+      }
+      links->push_back(ParseLink(nlh));
+    }
+  }
+}
+
+}  // namespace nscon
+}  // namespace containers
@@ -0,0 +1,180 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// rtnetlink.h
+// Configures network links by talking rtnetlink to the kernel, without running
+// ip(8) or brctl(8), and reads their counters.
+//
+#ifndef PRODUCTION_CONTAINERS_NSCON_CONFIGURATOR_RTNETLINK_H_
+#define PRODUCTION_CONTAINERS_NSCON_CONFIGURATOR_RTNETLINK_H_
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "util/task/status.h"
+#include "util/task/statusor.h"
+
+namespace containers {
+namespace nscon {
+
+class RtNetlink;
+
+class RtNetlinkFactory {
+ public:
+  RtNetlinkFactory() {}
+
+  virtual ~RtNetlinkFactory() {}
+
+  // Returns an RtNetlink on a new NETLINK_ROUTE socket. The socket configures
+  // the links of the network namespace of the calling thread.
+  virtual ::util::StatusOr<RtNetlink *> Create() const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RtNetlinkFactory);
+};
+
+//
+// RtNetlink
+// Queues link requests and sends them to the kernel in one message on
+// Commit(). The kernel runs the requests in the order they were queued and
+// acks each one, so a batch of steps costs a single sendmsg() instead of a
+// fork()/exec() per step.
+//
+// Links are named rather than referred to by index, so a request can refer to
+// a link created earlier in the same batch. If a request fails, the requests
+// after it are still run by the kernel, and Commit() reports the first error.
+//
+// Typical Usage:
+//    unique_ptr<RtNetlink> rtnetlink(RETURN_IF_ERROR(factory->Create()));
+//    rtnetlink->AddVethPair("veth0", "veth1", pid);
+//    rtnetlink->SetMtu("veth0", 1500);
+//    rtnetlink->SetUp("veth0");
+//    RETURN_IF_ERROR(rtnetlink->Commit());
+//
+// Class is not thread-safe.
+//
+class RtNetlink {
+ public:
+  virtual ~RtNetlink();
+
+  // Queues the creation of a veth pair whose |inside| end is created in the
+  // network namespace of process |pid|.
+  virtual void AddVethPair(const string &outside, const string &inside,
+                           pid_t pid);
+
+  // Queues moving |interface| to the network namespace of process |pid|.
+  virtual void MoveToNetNs(const string &interface, pid_t pid);
+
+  // Queues setting the |mtu| of |interface|.
+  virtual void SetMtu(const string &interface, int32 mtu);
+
+  // Queues bringing |interface| up.
+  virtual void SetUp(const string &interface);
+
+  // Queues setting the alias of |interface| to |alias|. An empty |alias|
+  // removes it.
+  virtual void SetAlias(const string &interface, const string &alias);
+
+  // Queues attaching |interface| to the ethernet |bridge|. The bridge must
+  // already exist.
+  // Returns: NOT_FOUND if there is no such bridge.
+  virtual ::util::Status SetMaster(const string &interface,
+                                   const string &bridge);
+
+  // Sends the queued requests and waits for all of them to be acked. The queue
+  // is empty afterwards, even on failure.
+  // Returns: OK iff all requests succeeded. ALREADY_EXISTS if the first request
+  //     to fail created a link that already exists.
+  virtual ::util::Status Commit();
+
+  // A link and its counters, as seen from the network namespace of the socket.
+  struct Link {
+    Link()
+        : rx_bytes(0),
+          rx_packets(0),
+          rx_errors(0),
+          rx_dropped(0),
+          tx_bytes(0),
+          tx_packets(0),
+          tx_errors(0),
+          tx_dropped(0) {}
+
+    string name;
+    // Empty if the link has no alias.
+    string alias;
+
+    uint64 rx_bytes;
+    uint64 rx_packets;
+    uint64 rx_errors;
+    uint64 rx_dropped;
+    uint64 tx_bytes;
+    uint64 tx_packets;
+    uint64 tx_errors;
+    uint64 tx_dropped;
+  };
+
+  // Dumps all the links with a single RTM_GETLINK request. Must not be called
+  // while there are queued requests.
+  // Returns: FAILED_PRECONDITION if there are queued requests.
+  virtual ::util::StatusOr< ::std::vector<Link>> GetLinks();
+
+ protected:
+  explicit RtNetlink(int fd) : fd_(fd), next_seq_(1) {}
+
+ private:
+  // Appends a RTM_NEWLINK request for |interface| to the queue. |flags| and
+  // |change| are the link flags to set and the ones to change. |attributes|
+  // are appended after the interface name. |description| is used in errors.
+  void QueueNewLink(uint16 nlmsg_flags, const string &interface, uint32 flags,
+                    uint32 change, const string &attributes,
+                    const string &description);
+
+  // Sends |data| on the socket in a single send().
+  ::util::Status Send(const string &data);
+
+  // Reads acks until the requests with sequence numbers in [first_seq,
+  // next_seq_) have all been acked.
+  ::util::Status ReadAcks(uint32 first_seq);
+
+  // Reads the replies to the RTM_GETLINK dump with sequence number |seq| into
+  // |links| until the end of the dump.
+  ::util::Status ReadLinks(uint32 seq, ::std::vector<Link> *links);
+
+  // NETLINK_ROUTE socket.
+  const int fd_;
+
+  // Requests to send on Commit().
+  string requests_;
+
+  // Sequence number of the next request.
+  uint32 next_seq_;
+
+  // Description of each queued request, by sequence number minus that of the
+  // first queued request.
+  ::std::vector<string> descriptions_;
+
+  friend class RtNetlinkFactory;
+  friend class RtNetlinkTest;
+
+  DISALLOW_COPY_AND_ASSIGN(RtNetlink);
+};
+
+}  // namespace nscon
+}  // namespace containers
+
+#endif  // PRODUCTION_CONTAINERS_NSCON_CONFIGURATOR_RTNETLINK_H_
@@ -0,0 +1,57 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PRODUCTION_CONTAINERS_NSCON_CONFIGURATOR_RTNETLINK_MOCK_H_
+#define PRODUCTION_CONTAINERS_NSCON_CONFIGURATOR_RTNETLINK_MOCK_H_
+
+#include "nscon/configurator/rtnetlink.h"
+
+#include "gmock/gmock.h"
+
+namespace containers {
+namespace nscon {
+
+class MockRtNetlinkFactory : public RtNetlinkFactory {
+ public:
+  MockRtNetlinkFactory() {}
+
+  MOCK_CONST_METHOD0(Create, ::util::StatusOr<RtNetlink *>(void));
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MockRtNetlinkFactory);
+};
+
+class MockRtNetlink : public RtNetlink {
+ public:
+  MockRtNetlink() : RtNetlink(-1) {}
+
+  MOCK_METHOD3(AddVethPair, void(const string &outside, const string &inside,
+                                 pid_t pid));
+  MOCK_METHOD2(MoveToNetNs, void(const string &interface, pid_t pid));
+  MOCK_METHOD2(SetMtu, void(const string &interface, int32 mtu));
+  MOCK_METHOD1(SetUp, void(const string &interface));
+  MOCK_METHOD2(SetAlias, void(const string &interface, const string &alias));
+  MOCK_METHOD2(SetMaster, ::util::Status(const string &interface,
+                                         const string &bridge));
+  MOCK_METHOD0(Commit, ::util::Status());
+  MOCK_METHOD0(GetLinks, ::util::StatusOr< ::std::vector<Link>>());
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MockRtNetlink);
+};
+
+}  // namespace nscon
+}  // namespace containers
+
+#endif  // PRODUCTION_CONTAINERS_NSCON_CONFIGURATOR_RTNETLINK_MOCK_H_
@@ -0,0 +1,465 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//
+// Unit tests for RtNetlink class
+//
+
+#include "nscon/configurator/rtnetlink.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/veth.h>
+#include <net/if.h>
+#include <string.h>
+#include <memory>
+
+#include "util/errors_test_util.h"
+#include "system_api/libc_fs_api_test_util.h"
+#include "system_api/libc_net_api_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::std::unique_ptr;
+using ::std::vector;
+using ::testing::HasSubstr;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetErrnoAndReturn;
+using ::testing::StrEq;
+using ::testing::_;
+using ::util::Status;
+using ::util::StatusOr;
+
+namespace containers {
+namespace nscon {
+
+static const int kFd = 42;
+static const pid_t kPid = 9999;
+static const unsigned int kBridgeIndex = 7;
+
+// Returns an ack of the request with |seq|, |error| is a negated errno.
+static string Ack(uint32 seq, int error) {
+  struct {
+    struct nlmsghdr nlh;
+    struct nlmsgerr err;
+  } ack;
+  memset(&ack, 0, sizeof(ack));
+  ack.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(ack.err));
+  ack.nlh.nlmsg_type = NLMSG_ERROR;
+  ack.nlh.nlmsg_seq = seq;
+  ack.err.error = error;
+  return string(reinterpret_cast<const char *>(&ack), sizeof(ack));
+}
+
+// Returns a message of |type| with |seq| that carries |payload|.
+static string Message(uint16 type, uint32 seq, const string &payload) {
+  struct nlmsghdr nlh;
+  memset(&nlh, 0, sizeof(nlh));
+  nlh.nlmsg_len = NLMSG_LENGTH(payload.size());
+  nlh.nlmsg_type = type;
+  nlh.nlmsg_flags = NLM_F_MULTI;
+  nlh.nlmsg_seq = seq;
+  string message(reinterpret_cast<const char *>(&nlh), sizeof(nlh));
+  message.append(payload);
+  return message + string(NLMSG_ALIGN(message.size()) - message.size(), '\0');
+}
+
+// Returns an attribute of |type| that holds the |len| bytes at |data|.
+static string LinkAttribute(uint16 type, const void *data, size_t len) {
+  struct rtattr rta;
+  rta.rta_type = type;
+  rta.rta_len = RTA_LENGTH(len);
+  string attribute(reinterpret_cast<const char *>(&rta), sizeof(rta));
+  attribute.append(static_cast<const char *>(data), len);
+  return attribute + string(RTA_ALIGN(attribute.size()) - attribute.size(),
+                            '\0');
+}
+
+// Returns a link in a dump with |seq|. The link is named |name|, has |alias|
+// if it is not empty, and has received |rx_bytes|.
+static string DumpedLink(uint32 seq, const string &name, const string &alias,
+                         uint64 rx_bytes) {
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  string payload(reinterpret_cast<const char *>(&ifi), sizeof(ifi));
+  payload.append(LinkAttribute(IFLA_IFNAME, name.c_str(), name.size() + 1));
+  if (!alias.empty()) {
+    payload.append(LinkAttribute(IFLA_IFALIAS, alias.data(), alias.size()));
+  }
+
+  // The 32 bit counters are stale, the 64 bit ones win.
+  struct rtnl_link_stats stats;
+  memset(&stats, 0, sizeof(stats));
+  stats.rx_bytes = 1;
+  payload.append(LinkAttribute(IFLA_STATS, &stats, sizeof(stats)));
+  struct rtnl_link_stats64 stats64;
+  memset(&stats64, 0, sizeof(stats64));
+  stats64.rx_bytes = rx_bytes;
+  stats64.rx_packets = 2;
+  stats64.rx_errors = 3;
+  stats64.rx_dropped = 4;
+  stats64.tx_bytes = 5;
+  stats64.tx_packets = 6;
+  stats64.tx_errors = 7;
+  stats64.tx_dropped = 8;
+  payload.append(LinkAttribute(IFLA_STATS64, &stats64, sizeof(stats64)));
+  return Message(RTM_NEWLINK, seq, payload);
+}
+
+// Receives |data| into the buffer of a Recv().
+ACTION_P(Receive, data) {
+  memcpy(arg1, data.data(), data.size());
+  return data.size();
+}
+
+// Returns the attribute of |type| among the |len| bytes of attributes at
+// |data|, or nullptr if there is none.
+static const struct rtattr *FindAttribute(const void *data, int len,
+                                          uint16 type) {
+  for (const struct rtattr *rta = static_cast<const struct rtattr *>(data);
+       RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    if (rta->rta_type == type) {
+      return rta;
+    }
+  }
+  return nullptr;
+}
+
+// Returns the attribute of |type| of a link request.
+static const struct rtattr *FindLinkAttribute(const struct nlmsghdr *nlh,
+                                              uint16 type) {
+  return FindAttribute(IFLA_RTA(NLMSG_DATA(nlh)), IFLA_PAYLOAD(nlh), type);
+}
+
+class RtNetlinkTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    rtnetlink_.reset(new RtNetlink(kFd));
+  }
+
+  void TearDown() override {
+    EXPECT_CALL(libc_fs_api_.Mock(), Close(kFd)).WillOnce(Return(0));
+    rtnetlink_.reset();
+  }
+
+  // Expects the queued requests to be sent, and keeps them in sent_.
+  void ExpectSend() {
+    EXPECT_CALL(libc_net_api_.Mock(), Send(kFd, _, _, 0))
+        .WillOnce(Invoke([this](int fd, const void *buf, size_t len,
+                                int flags) {
+          sent_.assign(static_cast<const char *>(buf), len);
+          return static_cast<ssize_t>(len);
+        }));
+  }
+
+  // Returns the requests in sent_.
+  vector<const struct nlmsghdr *> SentRequests() const {
+    vector<const struct nlmsghdr *> requests;
+    int len = sent_.size();
+    for (const struct nlmsghdr *nlh =
+             reinterpret_cast<const struct nlmsghdr *>(sent_.data());
+         NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+      requests.push_back(nlh);
+    }
+    EXPECT_EQ(0, len);
+    return requests;
+  }
+
+ protected:
+  unique_ptr<RtNetlink> rtnetlink_;
+  string sent_;
+  ::system_api::MockLibcFsApiOverride libc_fs_api_;
+  ::system_api::MockLibcNetApiOverride libc_net_api_;
+};
+
+TEST_F(RtNetlinkTest, CreateSuccess) {
+  RtNetlinkFactory factory;
+  EXPECT_CALL(libc_net_api_.Mock(),
+              Socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE))
+      .WillOnce(Return(kFd + 1));
+
+  StatusOr<RtNetlink *> statusor = factory.Create();
+  ASSERT_OK(statusor);
+  unique_ptr<RtNetlink> rtnetlink(statusor.ValueOrDie());
+
+  EXPECT_CALL(libc_fs_api_.Mock(), Close(kFd + 1)).WillOnce(Return(0));
+}
+
+TEST_F(RtNetlinkTest, CreateFails) {
+  RtNetlinkFactory factory;
+  EXPECT_CALL(libc_net_api_.Mock(), Socket(AF_NETLINK, _, NETLINK_ROUTE))
+      .WillOnce(SetErrnoAndReturn(EACCES, -1));
+
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, factory.Create());
+}
+
+TEST_F(RtNetlinkTest, CommitNothing) {
+  EXPECT_OK(rtnetlink_->Commit());
+}
+
+TEST_F(RtNetlinkTest, CommitBatchesRequests) {
+  rtnetlink_->SetMtu("veth0", 1500);
+  rtnetlink_->SetUp("veth0");
+  rtnetlink_->MoveToNetNs("eth1", kPid);
+
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, 0)))
+      .WillOnce(Receive(Ack(2, 0) + Ack(3, 0)));
+  EXPECT_OK(rtnetlink_->Commit());
+
+  const vector<const struct nlmsghdr *> requests = SentRequests();
+  ASSERT_EQ(3, requests.size());
+  for (int i = 0; i < requests.size(); ++i) {
+    EXPECT_EQ(RTM_NEWLINK, requests[i]->nlmsg_type);
+    EXPECT_EQ(i + 1, requests[i]->nlmsg_seq);
+    EXPECT_EQ(NLM_F_REQUEST | NLM_F_ACK, requests[i]->nlmsg_flags);
+  }
+
+  const struct rtattr *rta = FindLinkAttribute(requests[0], IFLA_IFNAME);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_STREQ("veth0", static_cast<const char *>(RTA_DATA(rta)));
+  rta = FindLinkAttribute(requests[0], IFLA_MTU);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_EQ(1500, *static_cast<const uint32 *>(RTA_DATA(rta)));
+
+  const struct ifinfomsg *ifi =
+      static_cast<const struct ifinfomsg *>(NLMSG_DATA(requests[1]));
+  EXPECT_EQ(IFF_UP, ifi->ifi_flags);
+  EXPECT_EQ(IFF_UP, ifi->ifi_change);
+
+  rta = FindLinkAttribute(requests[2], IFLA_IFNAME);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_STREQ("eth1", static_cast<const char *>(RTA_DATA(rta)));
+  rta = FindLinkAttribute(requests[2], IFLA_NET_NS_PID);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_EQ(kPid, *static_cast<const uint32 *>(RTA_DATA(rta)));
+}
+
+TEST_F(RtNetlinkTest, AddVethPair) {
+  rtnetlink_->AddVethPair("veth0", "eth0", kPid);
+
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, 0)));
+  EXPECT_OK(rtnetlink_->Commit());
+
+  const vector<const struct nlmsghdr *> requests = SentRequests();
+  ASSERT_EQ(1, requests.size());
+  EXPECT_EQ(NLM_F_REQUEST | NLM_F_ACK | NLM_F_CREATE | NLM_F_EXCL,
+            requests[0]->nlmsg_flags);
+
+  const struct rtattr *link_info =
+      FindLinkAttribute(requests[0], IFLA_LINKINFO);
+  ASSERT_NE(nullptr, link_info);
+  const struct rtattr *kind = FindAttribute(
+      RTA_DATA(link_info), RTA_PAYLOAD(link_info), IFLA_INFO_KIND);
+  ASSERT_NE(nullptr, kind);
+  EXPECT_STREQ("veth", static_cast<const char *>(RTA_DATA(kind)));
+
+  const struct rtattr *data = FindAttribute(
+      RTA_DATA(link_info), RTA_PAYLOAD(link_info), IFLA_INFO_DATA);
+  ASSERT_NE(nullptr, data);
+  const struct rtattr *peer =
+      FindAttribute(RTA_DATA(data), RTA_PAYLOAD(data), VETH_INFO_PEER);
+  ASSERT_NE(nullptr, peer);
+
+  // The peer is a link header followed by its attributes.
+  const char *peer_attributes =
+      static_cast<const char *>(RTA_DATA(peer)) +
+      NLMSG_ALIGN(sizeof(struct ifinfomsg));
+  const int peer_len =
+      RTA_PAYLOAD(peer) - NLMSG_ALIGN(sizeof(struct ifinfomsg));
+  const struct rtattr *rta =
+      FindAttribute(peer_attributes, peer_len, IFLA_IFNAME);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_STREQ("eth0", static_cast<const char *>(RTA_DATA(rta)));
+  rta = FindAttribute(peer_attributes, peer_len, IFLA_NET_NS_PID);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_EQ(kPid, *static_cast<const uint32 *>(RTA_DATA(rta)));
+}
+
+TEST_F(RtNetlinkTest, SetMaster) {
+  EXPECT_CALL(libc_net_api_.Mock(), IfNameToIndex(StrEq("br0")))
+      .WillOnce(Return(kBridgeIndex));
+  EXPECT_OK(rtnetlink_->SetMaster("veth0", "br0"));
+
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, 0)));
+  EXPECT_OK(rtnetlink_->Commit());
+
+  const vector<const struct nlmsghdr *> requests = SentRequests();
+  ASSERT_EQ(1, requests.size());
+  const struct rtattr *rta = FindLinkAttribute(requests[0], IFLA_MASTER);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_EQ(kBridgeIndex, *static_cast<const uint32 *>(RTA_DATA(rta)));
+}
+
+TEST_F(RtNetlinkTest, SetMasterNoBridge) {
+  EXPECT_CALL(libc_net_api_.Mock(), IfNameToIndex(StrEq("br0")))
+      .WillOnce(SetErrnoAndReturn(ENODEV, 0));
+  EXPECT_ERROR_CODE(::util::error::NOT_FOUND,
+                    rtnetlink_->SetMaster("veth0", "br0"));
+
+  // Nothing was queued.
+  EXPECT_OK(rtnetlink_->Commit());
+}
+
+TEST_F(RtNetlinkTest, SetAlias) {
+  rtnetlink_->SetAlias("veth0", "lmctfy:/test");
+
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, 0)));
+  EXPECT_OK(rtnetlink_->Commit());
+
+  const vector<const struct nlmsghdr *> requests = SentRequests();
+  ASSERT_EQ(1, requests.size());
+  EXPECT_EQ(RTM_NEWLINK, requests[0]->nlmsg_type);
+  const struct rtattr *rta = FindLinkAttribute(requests[0], IFLA_IFALIAS);
+  ASSERT_NE(nullptr, rta);
+  EXPECT_STREQ("lmctfy:/test", static_cast<const char *>(RTA_DATA(rta)));
+}
+
+TEST_F(RtNetlinkTest, CommitReportsFirstError) {
+  rtnetlink_->AddVethPair("veth0", "eth0", kPid);
+  rtnetlink_->SetUp("veth0");
+
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, -EEXIST)))
+      .WillOnce(Receive(Ack(2, -ENODEV)));
+  const Status status = rtnetlink_->Commit();
+  EXPECT_ERROR_CODE(::util::error::ALREADY_EXISTS, status);
+  EXPECT_THAT(status.error_message(),
+              HasSubstr("create veth pair veth0/eth0"));
+}
+
+TEST_F(RtNetlinkTest, CommitReportsOtherErrorsAsInternal) {
+  rtnetlink_->SetUp("veth0");
+
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, -ENODEV)));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, rtnetlink_->Commit());
+}
+
+TEST_F(RtNetlinkTest, CommitIgnoresStaleAcks) {
+  rtnetlink_->SetUp("veth0");
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, 0)));
+  EXPECT_OK(rtnetlink_->Commit());
+
+  // Acks of the earlier batch and duplicates are skipped.
+  rtnetlink_->SetUp("veth1");
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, -ENODEV)))
+      .WillOnce(Receive(Ack(2, 0) + Ack(2, -ENODEV)));
+  EXPECT_OK(rtnetlink_->Commit());
+}
+
+TEST_F(RtNetlinkTest, CommitSendFails) {
+  rtnetlink_->SetUp("veth0");
+  EXPECT_CALL(libc_net_api_.Mock(), Send(kFd, _, _, 0))
+      .WillOnce(SetErrnoAndReturn(ENOBUFS, -1));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, rtnetlink_->Commit());
+
+  // The failed requests are not sent again.
+  EXPECT_OK(rtnetlink_->Commit());
+}
+
+TEST_F(RtNetlinkTest, CommitRecvFails) {
+  rtnetlink_->SetUp("veth0");
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(SetErrnoAndReturn(EINTR, -1))
+      .WillOnce(SetErrnoAndReturn(EBADF, -1));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, rtnetlink_->Commit());
+}
+
+TEST_F(RtNetlinkTest, CommitSocketClosed) {
+  rtnetlink_->SetUp("veth0");
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0)).WillOnce(Return(0));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, rtnetlink_->Commit());
+}
+
+TEST_F(RtNetlinkTest, GetLinks) {
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(DumpedLink(1, "lo", "", 100) +
+                        DumpedLink(1, "veth0", "lmctfy:/test", 200)))
+      .WillOnce(Receive(Ack(7, 0) + DumpedLink(1, "eth0", "", 300) +
+                        Message(NLMSG_DONE, 1, string(sizeof(int), '\0'))));
+
+  StatusOr<vector<RtNetlink::Link>> statusor = rtnetlink_->GetLinks();
+  ASSERT_OK(statusor);
+  const vector<RtNetlink::Link> links = statusor.ValueOrDie();
+
+  const vector<const struct nlmsghdr *> requests = SentRequests();
+  ASSERT_EQ(1, requests.size());
+  EXPECT_EQ(RTM_GETLINK, requests[0]->nlmsg_type);
+  EXPECT_EQ(NLM_F_REQUEST | NLM_F_DUMP, requests[0]->nlmsg_flags);
+
+  // Stale acks are skipped.
+  ASSERT_EQ(3, links.size());
+  EXPECT_EQ("lo", links[0].name);
+  EXPECT_EQ("", links[0].alias);
+  EXPECT_EQ(100, links[0].rx_bytes);
+  EXPECT_EQ("veth0", links[1].name);
+  EXPECT_EQ("lmctfy:/test", links[1].alias);
+  EXPECT_EQ(200, links[1].rx_bytes);
+  EXPECT_EQ(2, links[1].rx_packets);
+  EXPECT_EQ(3, links[1].rx_errors);
+  EXPECT_EQ(4, links[1].rx_dropped);
+  EXPECT_EQ(5, links[1].tx_bytes);
+  EXPECT_EQ(6, links[1].tx_packets);
+  EXPECT_EQ(7, links[1].tx_errors);
+  EXPECT_EQ(8, links[1].tx_dropped);
+  EXPECT_EQ("eth0", links[2].name);
+  EXPECT_EQ(300, links[2].rx_bytes);
+}
+
+TEST_F(RtNetlinkTest, GetLinksWithQueuedRequests) {
+  rtnetlink_->SetUp("veth0");
+  EXPECT_ERROR_CODE(::util::error::FAILED_PRECONDITION,
+                    rtnetlink_->GetLinks());
+}
+
+TEST_F(RtNetlinkTest, GetLinksError) {
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0))
+      .WillOnce(Receive(Ack(1, -EPERM)));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, rtnetlink_->GetLinks());
+}
+
+TEST_F(RtNetlinkTest, GetLinksSendFails) {
+  EXPECT_CALL(libc_net_api_.Mock(), Send(kFd, _, _, 0))
+      .WillOnce(SetErrnoAndReturn(ENOBUFS, -1));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, rtnetlink_->GetLinks());
+}
+
+TEST_F(RtNetlinkTest, GetLinksSocketClosed) {
+  ExpectSend();
+  EXPECT_CALL(libc_net_api_.Mock(), Recv(kFd, _, _, 0)).WillOnce(Return(0));
+  EXPECT_ERROR_CODE(::util::error::INTERNAL, rtnetlink_->GetLinks());
+}
+
+}  // namespace nscon
+}  // namespace containers
@@ -13,31 +13,25 @@
 // limitations under the License.
 
 //
-// IpcAgent implementation that uses a pipe to transfer data.
+// IpcAgent implementation that uses a socketpair to transfer data.
 //
 #include "nscon/ipc_agent.h"
 
 #include <sys/socket.h>
-#include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/un.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <string.h>
 
-#include "file/base/path.h"
-#include "global_utils/time_utils.h"
 #include "util/errors.h"
 #include "system_api/libc_fs_api.h"
 #include "system_api/libc_net_api.h"
-#include "system_api/libc_process_api.h"
 #include "strings/substitute.h"
 
-using ::util::GlobalTimeUtils;
 using ::system_api::GlobalLibcFsApi;
 using ::system_api::GlobalLibcNetApi;
-using ::system_api::GlobalLibcProcessApi;
 using ::system_api::ScopedFileCloser;
 using ::std::pair;
-using ::std::unique_ptr;
 using ::strings::Substitute;
 using ::util::Status;
 using ::util::StatusOr;
@@ -45,54 +39,27 @@ using ::util::StatusOr;
 namespace containers {
 namespace nscon {
 
-static Status InitSockAddr(struct sockaddr_un *addr, const string &sun_path) {
-  if (sun_path.length() >= sizeof(addr->sun_path)) {
-    return Status(::util::error::INTERNAL, "unix-domain-socket path too long");
-  }
-
-  memset(addr, 0, sizeof(struct sockaddr_un));
-  addr->sun_family = AF_UNIX;
-  snprintf(addr->sun_path, sizeof(addr->sun_path), "%s", sun_path.c_str());
-
-  return Status::OK;
-}
-
 // Returns the implementation of the IpcAgent class.
 StatusOr<IpcAgent *> IpcAgentFactory::Create() const {
-  int sock_fd =
-      GlobalLibcNetApi()->Socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
-  if (sock_fd < 0) {
-    return Status(::util::error::INTERNAL,
-                  Substitute("socket() failed: $0", StrError(errno)));
-  }
-
-  // Auto-close the valid fd in case of errors.
-  ScopedFileCloser fd_closer(sock_fd);
-
-  // TODO(adityakali): Instead of "/tmp", we should create the file under
-  // rootfs of the job so that it is accessible after pivot_root/chroot.
-  const string uds_path = ::file::JoinPath(
-      "/tmp/", Substitute("nscon.uds_$0_$1", GlobalLibcProcessApi()->GetPid(),
-                          GlobalTimeUtils()->MicrosecondsSinceEpoch().value()));
-  struct sockaddr_un addr;
-  RETURN_IF_ERROR(InitSockAddr(&addr, uds_path));
-  if (GlobalLibcNetApi()->Bind(sock_fd, (struct sockaddr *)&addr,
-                               sizeof(addr)) < 0) {
+  int sockfd[2];
+  if (GlobalLibcNetApi()->SocketPair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0,
+                                     sockfd) < 0) {
     return Status(::util::error::INTERNAL,
-                  Substitute("bind() failed: $0", StrError(errno)));
+                  Substitute("socketpair() failed: $0", StrError(errno)));
   }
 
-  // chmod() the UDS file to 0777 so that the child process can connect to it
-  // even after changing its uid.
-  if (GlobalLibcFsApi()->ChMod(uds_path.c_str(), 0777) < 0) {
-    return Status(::util::error::INTERNAL,
-                  Substitute("chmod('$0', 0777) failed: $1",
-                             uds_path.c_str(), StrError(errno)));
-  }
+  // Auto-close the valid fds in case of errors.
+  ScopedFileCloser read_closer(sockfd[0]);
+  ScopedFileCloser write_closer(sockfd[1]);
 
-  if (GlobalLibcNetApi()->Listen(sock_fd, 1) < 0) {
+  // Have the kernel attach the credentials of the sender to every datagram, so
+  // that ReadData() gets the PID of the sender with the data.
+  const int enable = 1;
+  if (GlobalLibcNetApi()->SetSockOpt(sockfd[0], SOL_SOCKET, SO_PASSCRED,
+                                     &enable, sizeof(enable)) < 0) {
     return Status(::util::error::INTERNAL,
-                  Substitute("listen() failed: $0", StrError(errno)));
+                  Substitute("setsockopt(SO_PASSCRED) failed: $0",
+                             StrError(errno)));
   }
 
   // Now initialize the pipe.
@@ -102,13 +69,17 @@ StatusOr<IpcAgent *> IpcAgentFactory::Create() const {
                   Substitute("pipe2() failed: $0", StrError(errno)));
   }
 
-  fd_closer.Cancel();
-  return new IpcAgent(sock_fd, uds_path, pipefd);
+  read_closer.Cancel();
+  write_closer.Cancel();
+  return new IpcAgent(sockfd, pipefd);
 }
 
 IpcAgent::~IpcAgent() {
-  if (sock_fd_ >= 0) {
-    GlobalLibcFsApi()->Close(sock_fd_);
+  if (sockfd_read_ >= 0) {
+    GlobalLibcFsApi()->Close(sockfd_read_);
+  }
+  if (sockfd_write_ >= 0) {
+    GlobalLibcFsApi()->Close(sockfd_write_);
   }
   if (pipefd_read_ >= 0) {
     GlobalLibcFsApi()->Close(pipefd_read_);
@@ -119,89 +90,63 @@ IpcAgent::~IpcAgent() {
 }
 
 Status IpcAgent::Destroy() {
-  if (GlobalLibcFsApi()->Unlink(uds_path_.c_str()) < 0) {
-    return Status(
-        ::util::error::INTERNAL,
-        Substitute("unlink($0) failed: $1", uds_path_, StrError(errno)));
-  }
-
   delete this;
   return Status::OK;
 }
 
-// Creates a new socket and connects it to the unix-domain-path for
-// communication. We need to take care that we call only basic system calls here
-// as this gets invoked from between fork() and exec(). Using ScopedCleanup too
-// resulted in a hang.
+// Sends the data as a single datagram. We need to take care that we call only
+// basic system calls here as this gets invoked from between fork() and exec().
+// Using ScopedCleanup too resulted in a hang.
 Status IpcAgent::WriteData(const string &data) {
-  int fd = GlobalLibcNetApi()->Socket(AF_UNIX, SOCK_STREAM, 0);
-  if (fd < 0) {
-    return Status(::util::error::INTERNAL,
-                  Substitute("socket() failed: $0", StrError(errno)));
-  }
-
-  struct sockaddr_un addr;
-  Status status = InitSockAddr(&addr, uds_path_);
-  if (!status.ok()) {
-    GlobalLibcFsApi()->Close(fd);
-    return status;
-  }
-
-  if (GlobalLibcNetApi()->Connect(fd, (struct sockaddr *)&addr, sizeof(addr)) <
-      0) {
-    GlobalLibcFsApi()->Close(fd);
-    return Status(::util::error::INTERNAL,
-                  Substitute("connect() failed: $0", StrError(errno)));
-  }
-
-  ssize_t sent = GlobalLibcNetApi()->Send(fd, data.c_str(), data.size(), 0);
+  ssize_t sent =
+      GlobalLibcNetApi()->Send(sockfd_write_, data.c_str(), data.size(), 0);
   if (sent < 0) {
-    GlobalLibcFsApi()->Close(fd);
     return Status(::util::error::INTERNAL,
                   Substitute("send() failed: $0", StrError(errno)));
   }
 
-  GlobalLibcFsApi()->Close(fd);
   return Status::OK;
 }
 
 StatusOr<pair<string, pid_t>> IpcAgent::ReadData() {
-  int fd;
-  do {
-    fd = GlobalLibcNetApi()->Accept(sock_fd_, 0, 0);
-    if (fd >= 0) {
-      break;
-    }
-    if (errno == EINTR) {
-      continue;
-    }
-    return Status(::util::error::INTERNAL,
-                  Substitute("accept() failed: $0", StrError(errno)));
-    // TODO(adityakali): Use SOCK_NONBLOCK above and wait for only few seconds.
-  } while (1);
-
-  // Auto-close the valid fd in case of errors.
-  ScopedFileCloser fd_closer(fd);
-
-  struct ucred credential;
-  socklen_t len = sizeof(credential);
-  if (GlobalLibcNetApi()->GetSockOpt(fd, SOL_SOCKET, SO_PEERCRED, &credential,
-                                     &len) < 0) {
-    return Status(::util::error::INTERNAL,
-                  Substitute("getsockopt() failed: $0", StrError(errno)));
-  }
-
-  pid_t sender = credential.pid;
-  // Read data from socket.
   char buf[4096];
   memset(buf, 0, sizeof(buf));
-  ssize_t recvd = GlobalLibcNetApi()->Recv(fd, buf, sizeof(buf), 0);
+  struct iovec iov;
+  iov.iov_base = buf;
+  // Leave room for the terminating NUL.
+  iov.iov_len = sizeof(buf) - 1;
+
+  // The credentials of the sender come as ancillary data.
+  char control[CMSG_SPACE(sizeof(struct ucred))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t recvd;
+  do {
+    recvd = GlobalLibcNetApi()->RecvMsg(sockfd_read_, &msg, 0);
+  } while (recvd < 0 && errno == EINTR);
   if (recvd < 0) {
     return Status(::util::error::INTERNAL,
-                  Substitute("recv() failed: $0", StrError(errno)));
+                  Substitute("recvmsg() failed: $0", StrError(errno)));
+  }
+
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_CREDENTIALS &&
+        cmsg->cmsg_len == CMSG_LEN(sizeof(struct ucred))) {
+      struct ucred credential;
+      memcpy(&credential, CMSG_DATA(cmsg), sizeof(credential));
+      return pair<string, pid_t>(string(buf, recvd), credential.pid);
+    }
   }
 
-  return pair<string, pid_t>(buf, sender);
+  return Status(::util::error::INTERNAL,
+                "recvmsg() returned no credentials of the sender");
 }
 
 Status IpcAgent::WaitForChild() {
@@ -64,7 +64,11 @@ class IpcAgentFactory {
 // callers. For example, if parent waits on ReadUint32() and child exits before
 // sending any data, then the parent may block forever.
 //
-// The initial implementation of this class uses unix-domain sockets for IPC.
+// Data is sent over a SOCK_SEQPACKET socketpair that the child inherits across
+// fork()/clone(), so it keeps working after the child changes its namespaces
+// or root. Each WriteData() is a single datagram that the kernel tags with the
+// PID of the sender. Data written by either side is read from the same end of
+// the socketpair, so the two sides must not read at the same time.
 //
 class IpcAgent {
  public:
@@ -91,16 +95,15 @@ class IpcAgent {
   virtual ::util::Status Destroy();
 
  protected:
-  IpcAgent(int sock_fd, const string &uds_path, const int pipefd[2])
-      : sock_fd_(sock_fd), uds_path_(uds_path),
+  IpcAgent(const int sockfd[2], const int pipefd[2])
+      : sockfd_read_(sockfd[0]), sockfd_write_(sockfd[1]),
         pipefd_read_(pipefd[0]), pipefd_write_(pipefd[1]) {}
 
  private:
-  // Unix-Domain Socket FD used for listening and accepting a connection by
-  // receiver (during ReadData()).
-  const int sock_fd_;
-  // Unix-Domain Socket path used for connection by sender (during WriteData()).
-  const string uds_path_;
+  // Ends of the socketpair. Data is read from the first (which has
+  // SO_PASSCRED set) and written to the second.
+  const int sockfd_read_;
+  const int sockfd_write_;
   // Pipe to support Wait()/Signal(). These allows us to detect process
   // termination.
   int pipefd_read_;
@@ -34,7 +34,7 @@ class MockIpcAgentFactory : public IpcAgentFactory {
 
 class MockIpcAgent : public IpcAgent {
  public:
-  MockIpcAgent() : IpcAgent(-1, "", (const int[2]){-1, -1}) {}
+  MockIpcAgent() : IpcAgent((const int[2]){-1, -1}, (const int[2]){-1, -1}) {}
 
   MOCK_METHOD1(WriteData, ::util::Status(const string &data));
   MOCK_METHOD0(ReadData, ::util::StatusOr<::std::pair<string, pid_t>>());
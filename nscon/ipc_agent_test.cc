@@ -17,24 +17,21 @@
 #include <fcntl.h>
 #include <string.h>
 #include <sys/socket.h>
-#include <sys/un.h>
 #include <memory>
 
-#include "global_utils/time_utils_test_util.h"
 #include "util/errors_test_util.h"
 #include "system_api/libc_fs_api_test_util.h"
 #include "system_api/libc_net_api_test_util.h"
-#include "system_api/libc_process_api_test_util.h"
 #include "gtest/gtest.h"
 
 using ::std::pair;
 using ::std::unique_ptr;
+using ::testing::DoAll;
 using ::testing::Invoke;
 using ::testing::NotNull;
 using ::testing::Return;
 using ::testing::SetArrayArgument;
 using ::testing::SetErrnoAndReturn;
-using ::testing::StrEq;
 using ::testing::_;
 using ::util::error::INTERNAL;
 using ::util::Status;
@@ -43,34 +40,24 @@ using ::util::StatusOr;
 namespace containers {
 namespace nscon {
 
-static const int kSocket = 32;
+static const int kSocketRead = 32;
+static const int kSocketWrite = 33;
 static const int kPipefdRead = 88;
 static const int kPipefdWrite = 99;
 static const pid_t kPid = 650;
 static const char kData[] = "hello 5353";
-static const ::util::Microseconds kTime(1392567140);
-static const char kPath[] = "/tmp/nscon.uds_650_1392567140";
-
-MATCHER(HasUnixPath, "") {
-  const struct sockaddr_un *addr = (const struct sockaddr_un *)arg;
-  if (strcmp(addr->sun_path, kPath) != 0) {
-    *result_listener << "Expected \"" << kPath << "\" but received \""
-                     << addr->sun_path << "\"";
-    return false;
-  }
-
-  return true;
-}
 
 class IpcAgentTest : public ::testing::Test {
  public:
   void SetUp() override {
+    int sockfd[2] = { kSocketRead, kSocketWrite };
     int pipefd[2] = { kPipefdRead, kPipefdWrite };
-    ipc_agent_.reset(new IpcAgent(kSocket, kPath, pipefd));
+    ipc_agent_.reset(new IpcAgent(sockfd, pipefd));
   }
 
   void TearDown() override {
-    EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocket)).WillOnce(Return(0));
+    EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocketRead)).WillOnce(Return(0));
+    EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocketWrite)).WillOnce(Return(0));
     EXPECT_CALL(libc_fs_api_.Mock(), Close(kPipefdRead))
         .WillRepeatedly(Return(0));
     EXPECT_CALL(libc_fs_api_.Mock(), Close(kPipefdWrite))
@@ -80,9 +67,8 @@ class IpcAgentTest : public ::testing::Test {
   }
 
   // Wrapper for protected functions in IpcAgent class.
-  IpcAgent *NewIpcAgent(int sock_fd, const string &uds_path,
-                        const int pipefd[2]) {
-    return new IpcAgent(sock_fd, uds_path, pipefd);
+  IpcAgent *NewIpcAgent(const int sockfd[2], const int pipefd[2]) {
+    return new IpcAgent(sockfd, pipefd);
   }
 
  protected:
@@ -90,8 +76,6 @@ class IpcAgentTest : public ::testing::Test {
   unique_ptr<IpcAgentFactory> ipc_agent_factory_;
   ::system_api::MockLibcFsApiOverride libc_fs_api_;
   ::system_api::MockLibcNetApiOverride libc_net_api_;
-  ::system_api::MockLibcProcessApiOverride libc_process_api_;
-  ::util::MockTimeUtilsOverride time_utils_;
 };
 
 typedef IpcAgentTest IpcAgentFactoryTest;
@@ -99,19 +83,12 @@ typedef IpcAgentTest IpcAgentFactoryTest;
 TEST_F(IpcAgentFactoryTest, Create) {
   // Implicitly tested by SetUp() and TearDown().
   unique_ptr<IpcAgentFactory> ipc_agent_factory(new IpcAgentFactory());
+  int sockfd[2] = { kSocketRead, kSocketWrite };
   EXPECT_CALL(libc_net_api_.Mock(),
-              Socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0))
-      .WillOnce(Return(kSocket));
-  EXPECT_CALL(libc_net_api_.Mock(), Bind(kSocket, HasUnixPath(), _))
-      .WillOnce(Return(0));
-  EXPECT_CALL(libc_net_api_.Mock(), Listen(kSocket, 1))
-      .WillOnce(Return(0));
-
-  EXPECT_CALL(libc_process_api_.Mock(), GetPid())
-      .WillRepeatedly(Return(kPid));
-  EXPECT_CALL(time_utils_.Mock(), MicrosecondsSinceEpoch())
-      .WillRepeatedly(Return(kTime));
-  EXPECT_CALL(libc_fs_api_.Mock(), ChMod(StrEq(kPath), 0777))
+              SocketPair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, NotNull()))
+      .WillOnce(DoAll(SetArrayArgument<3>(sockfd, sockfd + 2), Return(0)));
+  EXPECT_CALL(libc_net_api_.Mock(),
+              SetSockOpt(kSocketRead, SOL_SOCKET, SO_PASSCRED, NotNull(), _))
       .WillOnce(Return(0));
 
   int pipefd[2] = { kPipefdRead, kPipefdWrite };
@@ -121,18 +98,51 @@ TEST_F(IpcAgentFactoryTest, Create) {
   StatusOr<IpcAgent *> statusor = ipc_agent_factory->Create();
   ASSERT_OK(statusor);
 
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocket)).WillOnce(Return(0));
+  EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocketRead)).WillOnce(Return(0));
+  EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocketWrite)).WillOnce(Return(0));
   EXPECT_CALL(libc_fs_api_.Mock(), Close(kPipefdRead)).WillOnce(Return(0));
   EXPECT_CALL(libc_fs_api_.Mock(), Close(kPipefdWrite)).WillOnce(Return(0));
   delete statusor.ValueOrDie();
 }
 
+TEST_F(IpcAgentFactoryTest, CreateSocketPairFailure) {
+  unique_ptr<IpcAgentFactory> ipc_agent_factory(new IpcAgentFactory());
+  EXPECT_CALL(libc_net_api_.Mock(),
+              SocketPair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, NotNull()))
+      .WillOnce(SetErrnoAndReturn(EMFILE, -1));
+
+  EXPECT_ERROR_CODE(INTERNAL, ipc_agent_factory->Create());
+}
+
+TEST_F(IpcAgentFactoryTest, CreateSetSockOptFailure) {
+  unique_ptr<IpcAgentFactory> ipc_agent_factory(new IpcAgentFactory());
+  const int kOtherSocketRead = 42;
+  const int kOtherSocketWrite = 43;
+  int sockfd[2] = { kOtherSocketRead, kOtherSocketWrite };
+  EXPECT_CALL(libc_net_api_.Mock(),
+              SocketPair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, NotNull()))
+      .WillOnce(DoAll(SetArrayArgument<3>(sockfd, sockfd + 2), Return(0)));
+  EXPECT_CALL(libc_net_api_.Mock(), SetSockOpt(kOtherSocketRead, SOL_SOCKET,
+                                               SO_PASSCRED, NotNull(), _))
+      .WillOnce(SetErrnoAndReturn(EINVAL, -1));
+
+  // The socketpair is closed.
+  EXPECT_CALL(libc_fs_api_.Mock(), Close(kOtherSocketRead))
+      .WillOnce(Return(0));
+  EXPECT_CALL(libc_fs_api_.Mock(), Close(kOtherSocketWrite))
+      .WillOnce(Return(0));
+
+  EXPECT_ERROR_CODE(INTERNAL, ipc_agent_factory->Create());
+}
+
 TEST_F(IpcAgentTest, Destroy) {
+  int sockfd[2] = { kSocketRead, kSocketWrite };
   int pipefd[2] = { kPipefdRead, kPipefdWrite };
-  unique_ptr<IpcAgent> ipc_agent(NewIpcAgent(kSocket, kPath, pipefd));
+  unique_ptr<IpcAgent> ipc_agent(NewIpcAgent(sockfd, pipefd));
 
-  EXPECT_CALL(libc_fs_api_.Mock(), Unlink(StrEq(kPath))).WillOnce(Return(0));
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocket)).WillOnce(Return(0));
+  // Nothing to remove from the filesystem.
+  EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocketRead)).WillOnce(Return(0));
+  EXPECT_CALL(libc_fs_api_.Mock(), Close(kSocketWrite)).WillOnce(Return(0));
   EXPECT_CALL(libc_fs_api_.Mock(), Close(kPipefdRead)).WillOnce(Return(0));
   EXPECT_CALL(libc_fs_api_.Mock(), Close(kPipefdWrite)).WillOnce(Return(0));
 
@@ -144,76 +154,50 @@ TEST_F(IpcAgentTest, Destroy) {
 typedef IpcAgentTest WriteDataTest;
 
 TEST_F(WriteDataTest, Success) {
-  const int kWriteSocket = 42;
-
-  EXPECT_CALL(libc_net_api_.Mock(), Socket(AF_UNIX, SOCK_STREAM, 0))
-      .WillOnce(Return(kWriteSocket));
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kWriteSocket)).WillOnce(Return(0));
-  EXPECT_CALL(libc_net_api_.Mock(), Connect(kWriteSocket, HasUnixPath(), _))
-      .WillOnce(Return(0));
-  EXPECT_CALL(libc_net_api_.Mock(), Send(kWriteSocket, NotNull(), _, 0))
-      .WillOnce(Return(0));
+  EXPECT_CALL(libc_net_api_.Mock(),
+              Send(kSocketWrite, NotNull(), strlen(kData), 0))
+      .WillOnce(Return(strlen(kData)));
 
   EXPECT_OK(ipc_agent_->WriteData(kData));
 }
 
-TEST_F(WriteDataTest, SocketFailure) {
-  EXPECT_CALL(libc_net_api_.Mock(), Socket(AF_UNIX, SOCK_STREAM, 0))
-      .WillOnce(SetErrnoAndReturn(EINVAL, -1));
-
-  EXPECT_ERROR_CODE(INTERNAL, ipc_agent_->WriteData(kData));
-}
-
-TEST_F(WriteDataTest, ConnectFailure) {
-  const int kWriteSocket = 42;
-
-  EXPECT_CALL(libc_net_api_.Mock(), Socket(AF_UNIX, SOCK_STREAM, 0))
-      .WillOnce(Return(kWriteSocket));
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kWriteSocket)).WillOnce(Return(0));
-  EXPECT_CALL(libc_net_api_.Mock(), Connect(kWriteSocket, HasUnixPath(), _))
-      .WillOnce(SetErrnoAndReturn(EBADF, -1));
-
-  EXPECT_ERROR_CODE(INTERNAL, ipc_agent_->WriteData(kData));
-}
-
 TEST_F(WriteDataTest, SendFailure) {
-  const int kWriteSocket = 42;
-
-  EXPECT_CALL(libc_net_api_.Mock(), Socket(AF_UNIX, SOCK_STREAM, 0))
-      .WillOnce(Return(kWriteSocket));
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kWriteSocket)).WillOnce(Return(0));
-  EXPECT_CALL(libc_net_api_.Mock(), Connect(kWriteSocket, HasUnixPath(), _))
-      .WillOnce(Return(0));
-  EXPECT_CALL(libc_net_api_.Mock(), Send(kWriteSocket, NotNull(), _, 0))
+  EXPECT_CALL(libc_net_api_.Mock(), Send(kSocketWrite, NotNull(), _, 0))
       .WillOnce(SetErrnoAndReturn(EINVAL, -1));
 
   EXPECT_ERROR_CODE(INTERNAL, ipc_agent_->WriteData(kData));
 }
 
-void SetPid(int sockfd, int level, int optname, void *optval,
-            socklen_t *optlen) {
-  static_cast<struct ucred *>(optval)->pid = kPid;
-}
+// Fills in the message with kData and, if with_credentials, the credentials of
+// kPid. Returns the length of the data.
+ssize_t SetRecvMsg(bool with_credentials, struct msghdr *msg) {
+  strncpy(static_cast<char *>(msg->msg_iov[0].iov_base), kData,
+          msg->msg_iov[0].iov_len);
 
-void SetRecvData(int sockfd, void *buf, size_t len, int flags) {
-  strncpy(static_cast<char *>(buf), kData, len);
+  if (!with_credentials) {
+    msg->msg_controllen = 0;
+    return strlen(kData);
+  }
+
+  struct ucred credential;
+  memset(&credential, 0, sizeof(credential));
+  credential.pid = kPid;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_CREDENTIALS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(credential));
+  memcpy(CMSG_DATA(cmsg), &credential, sizeof(credential));
+  msg->msg_controllen = CMSG_SPACE(sizeof(credential));
+  return strlen(kData);
 }
 
 typedef IpcAgentTest ReadDataTest;
 
 TEST_F(ReadDataTest, Success) {
-  const int kReadSocket = 52;
-
-  EXPECT_CALL(libc_net_api_.Mock(), Accept(kSocket, 0, 0))
-      .WillOnce(Return(kReadSocket));
-  EXPECT_CALL(
-      libc_net_api_.Mock(),
-      GetSockOpt(kReadSocket, SOL_SOCKET, SO_PEERCRED, NotNull(), NotNull()))
-      .WillOnce(DoAll(Invoke(&SetPid), Return(0)));
-  EXPECT_CALL(libc_net_api_.Mock(), Recv(kReadSocket, NotNull(), _, 0))
-      .WillOnce(DoAll(Invoke(&SetRecvData), Return(0)));
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kReadSocket))
-      .WillOnce(Return(0));
+  EXPECT_CALL(libc_net_api_.Mock(), RecvMsg(kSocketRead, NotNull(), 0))
+      .WillOnce(Invoke([](int sockfd, struct msghdr *msg, int flags) {
+        return SetRecvMsg(true, msg);
+      }));
 
   StatusOr<pair<string, pid_t>> statusor = ipc_agent_->ReadData();
   ASSERT_OK(statusor);
@@ -222,40 +206,29 @@ TEST_F(ReadDataTest, Success) {
   EXPECT_EQ(kPid, result.second);
 }
 
-TEST_F(ReadDataTest, AcceptFailure) {
-  EXPECT_CALL(libc_net_api_.Mock(), Accept(kSocket, 0, 0))
-      .WillOnce(SetErrnoAndReturn(EBADF, -1));
+TEST_F(ReadDataTest, Interrupted) {
+  EXPECT_CALL(libc_net_api_.Mock(), RecvMsg(kSocketRead, NotNull(), 0))
+      .WillOnce(SetErrnoAndReturn(EINTR, -1))
+      .WillOnce(Invoke([](int sockfd, struct msghdr *msg, int flags) {
+        return SetRecvMsg(true, msg);
+      }));
 
-  EXPECT_ERROR_CODE(INTERNAL, ipc_agent_->ReadData());
+  StatusOr<pair<string, pid_t>> statusor = ipc_agent_->ReadData();
+  ASSERT_OK(statusor);
+  EXPECT_EQ(kPid, statusor.ValueOrDie().second);
 }
 
-TEST_F(ReadDataTest, GetSockOptFailure) {
-  const int kReadSocket = 52;
-
-  EXPECT_CALL(libc_net_api_.Mock(), Accept(kSocket, 0, 0))
-      .WillOnce(Return(kReadSocket));
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kReadSocket))
-      .WillOnce(Return(0));
-  EXPECT_CALL(
-      libc_net_api_.Mock(),
-      GetSockOpt(kReadSocket, SOL_SOCKET, SO_PEERCRED, NotNull(), NotNull()))
-      .WillOnce(SetErrnoAndReturn(EBADF, -1));
+TEST_F(ReadDataTest, NoCredentials) {
+  EXPECT_CALL(libc_net_api_.Mock(), RecvMsg(kSocketRead, NotNull(), 0))
+      .WillOnce(Invoke([](int sockfd, struct msghdr *msg, int flags) {
+        return SetRecvMsg(false, msg);
+      }));
 
   EXPECT_ERROR_CODE(INTERNAL, ipc_agent_->ReadData());
 }
 
-TEST_F(ReadDataTest, RecvFailure) {
-  const int kReadSocket = 52;
-
-  EXPECT_CALL(libc_net_api_.Mock(), Accept(kSocket, 0, 0))
-      .WillOnce(Return(kReadSocket));
-  EXPECT_CALL(libc_fs_api_.Mock(), Close(kReadSocket))
-      .WillOnce(Return(0));
-  EXPECT_CALL(
-      libc_net_api_.Mock(),
-      GetSockOpt(kReadSocket, SOL_SOCKET, SO_PEERCRED, NotNull(), NotNull()))
-      .WillOnce(DoAll(Invoke(&SetPid), Return(0)));
-  EXPECT_CALL(libc_net_api_.Mock(), Recv(kReadSocket, NotNull(), _, 0))
+TEST_F(ReadDataTest, RecvMsgFailure) {
+  EXPECT_CALL(libc_net_api_.Mock(), RecvMsg(kSocketRead, NotNull(), 0))
       .WillOnce(SetErrnoAndReturn(EBADF, -1));
 
   EXPECT_ERROR_CODE(INTERNAL, ipc_agent_->ReadData());
@@ -29,6 +29,7 @@
 
 #include "gflags/gflags.h"
 #include "file/base/path.h"
+#include "nscon/clone_stack_pool.h"
 #include "nscon/configurator/ns_configurator.h"
 #include "nscon/ns_util.h"
 #include "include/namespaces.pb.h"
@@ -56,7 +57,25 @@ using ::util::StatusOr;
 namespace containers {
 namespace nscon {
 
-static char g_stack[1<<20] __attribute__((aligned(16)));
+// Size of the stack of cloned children until they exec.
+static const size_t kCloneStackSize = 1 << 20;
+
+// Number of clone stacks kept for reuse.
+static const int kMaxFreeCloneStacks = 4;
+
+// The only clone flags that may be requested as namespaces. Anything else
+// (e.g.: CLONE_VM) would share the parent's memory, and with it the clone stack
+// that is released as soon as clone() returns.
+static const int kNamespaceCloneFlags = CLONE_NEWUSER | CLONE_NEWPID |
+                                        CLONE_NEWNS | CLONE_NEWIPC |
+                                        CLONE_NEWNET | CLONE_NEWUTS;
+
+// Gets the pool of stacks shared by all launchers of this process.
+static CloneStackPool *GlobalCloneStackPool() {
+  static CloneStackPool *pool =
+      new CloneStackPool(kCloneStackSize, kMaxFreeCloneStacks);
+  return pool;
+}
 
 StatusOr<ProcessLauncher *> ProcessLauncher::New(NsUtil *ns_util) {
   return new ProcessLauncher(ns_util,
@@ -220,6 +239,15 @@ StatusOr<pid_t> ProcessLauncher::CloneAndLaunch(
     const NamespaceSpec &spec,
     const RunSpec &run_spec,
     IpcAgent *pid_notification_agent) const {
+  int clone_flags = SIGCHLD;
+  for (int ns : namespaces) {
+    if ((ns & ~kNamespaceCloneFlags) != 0) {
+      return Status(INVALID_ARGUMENT,
+                    Substitute("Unknown namespace flag '$0'", ns));
+    }
+    clone_flags |= ns;
+  }
+
   int console_fd = -1;
   unique_ptr<ScopedFileCloser> console_fd_closer;
   if (run_spec.has_console()) {
@@ -228,11 +256,6 @@ StatusOr<pid_t> ProcessLauncher::CloneAndLaunch(
     console_fd = RETURN_IF_ERROR(GetConsoleFd(run_spec.console()));
     console_fd_closer.reset(new ScopedFileCloser(console_fd));
   }
-  int clone_flags = SIGCHLD;
-  for (int ns : namespaces) {
-    clone_flags |= ns;
-  }
-
   // We need synchronization between child and parent.
   IpcAgent *sync_agent = RETURN_IF_ERROR(ipc_agent_factory_->Create());
   ScopedCleanup sc(&IpcAgent::Destroy, sync_agent);
@@ -254,13 +277,20 @@ StatusOr<pid_t> ProcessLauncher::CloneAndLaunch(
   // - Parent waits till the child execs successfully (no signal from child). If
   //   child failed, it retrieves the error and reports it.
 
+  // Each launch clones on a stack of its own so that launches can run
+  // concurrently. The child has its own copy of the stack, so it is released
+  // as soon as clone() returns.
+  CloneStackPool::Stack *stack =
+      RETURN_IF_ERROR(GlobalCloneStackPool()->Acquire());
   pid_t child_pid =
-      GlobalLibcProcessApi()->Clone(&CloneFnInvoker, &g_stack[sizeof(g_stack)],
+      GlobalLibcProcessApi()->Clone(&CloneFnInvoker, stack->top(),
                                     clone_flags,
                                     static_cast<void *>(&clone_args));
+  const int clone_errno = errno;
+  GlobalCloneStackPool()->Release(stack);
   if (child_pid < 0) {
     return Status(INTERNAL,
-                  Substitute("clone() failed: $0", StrError(errno)));
+                  Substitute("clone() failed: $0", StrError(clone_errno)));
   }
 
   // TODO(adityakali): Setup scoped process cleaner - it will kill the child
@@ -0,0 +1,135 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nscon/process_launcher.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <memory>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/timer.h"
+#include "include/namespaces.pb.h"
+#include "nscon/ns_util.h"
+#include "thread/thread.h"
+#include "thread/thread_options.h"
+#include "util/errors_test_util.h"
+#include "gtest/gtest.h"
+
+using ::std::unique_ptr;
+using ::std::vector;
+using ::util::StatusOr;
+
+namespace containers {
+namespace nscon {
+
+// Number of launching threads in the parallel benchmark.
+static const int kBenchmarkThreads = 8;
+
+// Number of launches of each thread.
+static const int kBenchmarkLaunchesPerThread = 50;
+
+class ProcessLauncherRealTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    ns_util_.reset(NsUtil::New().ValueOrDie());
+    launcher_.reset(ProcessLauncher::New(ns_util_.get()).ValueOrDie());
+  }
+
+  // Launches /bin/true in namespaces and waits for it to exit, count times.
+  void LaunchMany(const vector<int> *namespaces, int count) {
+    for (int i = 0; i < count; ++i) {
+      StatusOr<pid_t> statusor = launcher_->NewNsProcess(
+          {"/bin/true"}, *namespaces, {}, NamespaceSpec(), RunSpec());
+      ASSERT_OK(statusor);
+
+      int status = 0;
+      ASSERT_EQ(statusor.ValueOrDie(),
+                waitpid(statusor.ValueOrDie(), &status, 0));
+      EXPECT_TRUE(WIFEXITED(status));
+      EXPECT_EQ(0, WEXITSTATUS(status));
+    }
+  }
+
+ protected:
+  unique_ptr<NsUtil> ns_util_;
+  unique_ptr<ProcessLauncher> launcher_;
+};
+
+TEST_F(ProcessLauncherRealTest, NewNsProcess) {
+  const vector<int> namespaces;
+  LaunchMany(&namespaces, 1);
+}
+
+TEST_F(ProcessLauncherRealTest, ConcurrentNewNsProcess) {
+  const vector<int> namespaces;
+  ::thread::Options options;
+  options.set_joinable(true);
+  vector<unique_ptr<ClosureThread>> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back(new ClosureThread(
+        options, "launch",
+        NewPermanentCallback(this, &ProcessLauncherRealTest::LaunchMany,
+                             &namespaces, 5)));
+    threads.back()->Start();
+  }
+  for (const auto &thread : threads) {
+    thread->Join();
+  }
+}
+
+// Compares launching from a single thread, as callers had to when all clones
+// shared one stack, with launching from several threads at once. Needs root
+// for the namespaces.
+TEST_F(ProcessLauncherRealTest, DISABLED_BenchmarkParallelLaunch) {
+  const vector<int> namespaces = {CLONE_NEWUTS, CLONE_NEWIPC};
+  const int kLaunches = kBenchmarkThreads * kBenchmarkLaunchesPerThread;
+
+  CycleTimer timer;
+  timer.Start();
+  LaunchMany(&namespaces, kLaunches);
+  timer.Stop();
+  const int64 serial_usec = timer.GetInUsec();
+
+  ::thread::Options options;
+  options.set_joinable(true);
+  vector<unique_ptr<ClosureThread>> threads;
+  timer.Reset();
+  timer.Start();
+  for (int i = 0; i < kBenchmarkThreads; ++i) {
+    threads.emplace_back(new ClosureThread(
+        options, "launch",
+        NewPermanentCallback(this, &ProcessLauncherRealTest::LaunchMany,
+                             &namespaces, kBenchmarkLaunchesPerThread)));
+    threads.back()->Start();
+  }
+  for (const auto &thread : threads) {
+    thread->Join();
+  }
+  timer.Stop();
+  const int64 parallel_usec = timer.GetInUsec();
+
+  printf("1 thread:  %lld launches/s\n"
+         "%d threads: %lld launches/s\n",
+         static_cast<long long>(  // NOLINT(runtime/int)
+             kLaunches * 1000000LL / serial_usec),
+         kBenchmarkThreads,
+         static_cast<long long>(  // NOLINT(runtime/int)
+             kLaunches * 1000000LL / parallel_usec));
+}
+
+}  // namespace nscon
+}  // namespace containers
@@ -249,11 +249,21 @@ TEST_F(NewNsProcessTest, InvalidCommand) {
                                       run_spec));
 }
 
+TEST_F(NewNsProcessTest, NotNamespaces) {
+  NamespaceSpec spec;
+  RunSpec run_spec;
+  // The child would share the clone stack with the parent.
+  const vector<int> kNamespaces = {CLONE_NEWPID, CLONE_VM};
+
+  EXPECT_ERROR_CODE(::util::error::INVALID_ARGUMENT,
+                    pl_->NewNsProcess(kCommand_, kNamespaces, {}, spec,
+                                      run_spec));
+}
+
 TEST_F(NewNsProcessTest, CloneFailure) {
   NamespaceSpec spec;
   RunSpec run_spec;
-  // Invalid namespace flags.
-  const vector<int> kNamespaces = {CLONE_FS, CLONE_VM};
+  const vector<int> kNamespaces = {CLONE_NEWPID, CLONE_NEWNS};
 
   EXPECT_CALL(*mock_ipc_agent_factory_, Create())
       .WillOnce(Return(mock_ipc_agent_.get()));
@@ -17,15 +17,19 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/perf_event.h>
 #include <poll.h>
 #include <signal.h>
+#include <stdio.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/file.h>
+#include <sys/inotify.h>
 #include <sys/klog.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/swap.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <algorithm>
 #include <memory>
@@ -131,6 +135,11 @@ int KernelAPI::RmDir(const string& path) const {
   return retval;
 }
 
+int KernelAPI::Rename(const string& old_path, const string& new_path) const {
+  ElapsedTimer timer("Rename", true, kMaxAllowedTimeInSec);
+  return rename(old_path.c_str(), new_path.c_str());
+}
+
 int KernelAPI::Kill(pid_t pid) const {
   ElapsedTimer timer("Kill", true, kMaxAllowedTimeInSec);
   return kill(pid, SIGKILL);
@@ -340,11 +349,48 @@ int KernelAPI::EpollWait(int epfd, struct epoll_event *events, int maxevents,
   return epoll_wait(epfd, events, maxevents, timeout);
 }
 
+int KernelAPI::InotifyInit1(int flags) const {
+  ElapsedTimer timer("InotifyInit1: ", true, kMaxAllowedTimeInSec);
+  return inotify_init1(flags);
+}
+
+int KernelAPI::InotifyAddWatch(int fd, const char *pathname,
+                               uint32 mask) const {
+  ElapsedTimer timer("InotifyAddWatch: ", true, kMaxAllowedTimeInSec);
+  return inotify_add_watch(fd, pathname, mask);
+}
+
+int KernelAPI::InotifyRmWatch(int fd, int wd) const {
+  ElapsedTimer timer("InotifyRmWatch: ", true, kMaxAllowedTimeInSec);
+  return inotify_rm_watch(fd, wd);
+}
+
 ssize_t KernelAPI::Read(int fd, void *buf, int count) const {
   ElapsedTimer timer("Read: ", true, kMaxAllowedTimeInSec);
   return read(fd, buf, count);
 }
 
+ssize_t KernelAPI::Pread(int fd, void *buf, size_t count, off_t offset) const {
+  ElapsedTimer timer("Pread: ", true, kMaxAllowedTimeInSec);
+  return pread(fd, buf, count, offset);
+}
+
+int KernelAPI::PerfEventOpen(struct perf_event_attr *attr, pid_t pid, int cpu,
+                             int group_fd, unsigned long flags) const {
+  ElapsedTimer timer("PerfEventOpen: ", true, kMaxAllowedTimeInSec);
+  // glibc has no wrapper for perf_event_open().
+  return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+int KernelAPI::GetNumConfiguredCpus() const {
+  return sysconf(_SC_NPROCESSORS_CONF);
+}
+
+ssize_t KernelAPI::Write(int fd, const void *buf, size_t count) const {
+  ElapsedTimer timer("Write: ", true, kMaxAllowedTimeInSec);
+  return write(fd, buf, count);
+}
+
 int KernelAPI::Open(const char *pathname, int flags) const {
   ElapsedTimer timer("Open: ", true, kMaxAllowedTimeInSec);
   return open(pathname, flags);
@@ -366,6 +412,11 @@ int KernelAPI::Unlink(const char *pathname) const {
   return unlink(pathname);
 }
 
+int KernelAPI::MkFifo(const char *pathname, mode_t mode) const {
+  ElapsedTimer timer("MkFifo: ", true, kMaxAllowedTimeInSec);
+  return mkfifo(pathname, mode);
+}
+
 int KernelAPI::Flock(int fd, int operation) const {
   ElapsedTimer timer("Flock: ", true, kMaxAllowedTimeInSec);
   return flock(fd, operation);
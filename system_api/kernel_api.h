@@ -35,6 +35,7 @@
 
 struct pollfd;
 struct epoll_event;
+struct perf_event_attr;
 
 using ::std::string;
 
@@ -66,6 +67,8 @@ class KernelAPI : public SystemClockAPI {
   // Removes a directory. Retries internally if the system call gets
   // interrupted.
   virtual int RmDir(const string& path) const;
+  // Renames a file or directory. Both paths must be in the same filesystem.
+  virtual int Rename(const string& old_path, const string& new_path) const;
   virtual int Kill(pid_t pid) const;
   virtual int Signal(pid_t pid, int sig) const;
   virtual int PthreadKill(pthread_t thread, int sig) const;
@@ -113,8 +116,23 @@ class KernelAPI : public SystemClockAPI {
   // Wrapper around epoll_wait() system call.
   virtual int EpollWait(int epfd, struct epoll_event *events, int maxevents,
                         int timeout) const;
+  // Wrapper around inotify_init1() system call.
+  virtual int InotifyInit1(int flags) const;
+  // Wrapper around inotify_add_watch() system call.
+  virtual int InotifyAddWatch(int fd, const char *pathname, uint32 mask) const;
+  // Wrapper around inotify_rm_watch() system call.
+  virtual int InotifyRmWatch(int fd, int wd) const;
   // Wrapper around read() system call.
   virtual ssize_t Read(int fd, void *buf, int count) const;
+  // Wrapper around pread() system call.
+  virtual ssize_t Pread(int fd, void *buf, size_t count, off_t offset) const;
+  // Wrapper around perf_event_open() system call.
+  virtual int PerfEventOpen(struct perf_event_attr *attr, pid_t pid, int cpu,
+                            int group_fd, unsigned long flags) const;
+  // Number of CPUs configured in the system, online or not.
+  virtual int GetNumConfiguredCpus() const;
+  // Wrapper around write() system call.
+  virtual ssize_t Write(int fd, const void *buf, size_t count) const;
   // Wrapper around open() system call.
   virtual int Open(const char *pathname, int flags) const;
   virtual int OpenWithMode(const char *pathname, int flags, mode_t mode) const;
@@ -122,6 +140,8 @@ class KernelAPI : public SystemClockAPI {
   virtual int Close(int fd) const;
   // Wrapper around unlink() system call.
   virtual int Unlink(const char *pathname) const;
+  // Wrapper around mkfifo() call.
+  virtual int MkFifo(const char *pathname, mode_t mode) const;
   // Wrapper around flock() system call.
   virtual int Flock(int fd, int operation) const;
   // Wrapper around chown() system call.
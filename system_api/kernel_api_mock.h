@@ -35,6 +35,8 @@ class KernelAPIMock : public KernelAPI {
   MOCK_CONST_METHOD1(MkDir, int(const string& path));
   MOCK_CONST_METHOD1(MkDirRecursive, int(const string& path));
   MOCK_CONST_METHOD1(RmDir, int(const string& path));
+  MOCK_CONST_METHOD2(Rename,
+                     int(const string& old_path, const string& new_path));
   MOCK_CONST_METHOD1(Kill, int(pid_t pid));
   MOCK_CONST_METHOD2(Signal, int(pid_t pid, int sig));
   MOCK_CONST_METHOD2(PthreadKill, int(pthread_t thread, int sig));
@@ -76,12 +78,24 @@ class KernelAPIMock : public KernelAPI {
                                    struct epoll_event *event));
   MOCK_CONST_METHOD4(EpollWait, int(int epfd, struct epoll_event *events,
                                     int maxevents, int timeout));
+  MOCK_CONST_METHOD1(InotifyInit1, int(int flags));
+  MOCK_CONST_METHOD3(InotifyAddWatch, int(int fd, const char *pathname,
+                                          uint32 mask));
+  MOCK_CONST_METHOD2(InotifyRmWatch, int(int fd, int wd));
   MOCK_CONST_METHOD3(Read, ssize_t(int fd, void *buf, int count));
+  MOCK_CONST_METHOD4(Pread, ssize_t(int fd, void *buf, size_t count,
+                                    off_t offset));
+  MOCK_CONST_METHOD5(PerfEventOpen, int(struct perf_event_attr *attr, pid_t pid,
+                                        int cpu, int group_fd,
+                                        unsigned long flags));
+  MOCK_CONST_METHOD0(GetNumConfiguredCpus, int());
+  MOCK_CONST_METHOD3(Write, ssize_t(int fd, const void *buf, size_t count));
   MOCK_CONST_METHOD2(Open, int(const char *pathname, int flags));
   MOCK_CONST_METHOD3(OpenWithMode, int(const char *pathname,
                                        int flags, mode_t mode));
   MOCK_CONST_METHOD1(Close, int(int fd));
   MOCK_CONST_METHOD1(Unlink, int(const char *pathname));
+  MOCK_CONST_METHOD2(MkFifo, int(const char *pathname, mode_t mode));
   MOCK_CONST_METHOD2(Flock, int(int fd, int operation));
   MOCK_CONST_METHOD3(Chown, int(const string &path, uid_t uid, gid_t gid));
   MOCK_CONST_METHOD1(Usleep, int(useconds_t usec));
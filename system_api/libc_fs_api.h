@@ -57,6 +57,9 @@ class LibcFsApi {
 
   virtual int OpenWithMode(const char *path, int oflag, int mode) const = 0;
 
+  // Opens path relative to the directory dirfd. See openat(2).
+  virtual int OpenAt(int dirfd, const char *path, int oflag) const = 0;
+
   // Returns 0 on success, EOF on failure.
   virtual int FClose(FILE *file_pointer) const = 0;
 
@@ -95,6 +98,10 @@ class LibcFsApi {
 
   virtual int FStat(int file_descriptor, struct stat *buf) const = 0;
 
+  // Stats path relative to the directory dirfd. See fstatat(2).
+  virtual int FStatAt(int dirfd, const char *path, struct stat *buf,
+                      int flags) const = 0;
+
   virtual int StatFs64(const char *path, struct statfs64 *buf) const = 0;
 
   virtual int Mount(const char *source, const char *target,
@@ -133,6 +140,12 @@ class LibcFsApi {
 
   virtual int ReadDirR(DIR *dir, dirent *entry, dirent **result) const = 0;
 
+  // Reads as many struct dirent64 entries of the open directory
+  // file_descriptor as fit in nbytes of buf. Returns the number of bytes read,
+  // 0 at the end of the directory. See getdents64(2).
+  virtual ssize_t GetDents64(int file_descriptor, char *buf,
+                             size_t nbytes) const = 0;
+
   virtual int CloseDir(DIR *dir) const = 0;
 
   virtual ssize_t ReadLink(const char *path, char *buf, size_t len) const = 0;
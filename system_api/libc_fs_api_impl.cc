@@ -51,6 +51,10 @@ int LibcFsApiImpl::OpenWithMode(const char *path, int oflag, int mode) const {
   return open(path, oflag, mode);
 }
 
+int LibcFsApiImpl::OpenAt(int dirfd, const char *path, int oflag) const {
+  return openat(dirfd, path, oflag);
+}
+
 int LibcFsApiImpl::FClose(FILE *file_pointer) const {
   return fclose(file_pointer);
 }
@@ -112,6 +116,11 @@ int LibcFsApiImpl::FStat(int file_descriptor, struct stat *buf) const {
   return fstat(file_descriptor, buf);
 }
 
+int LibcFsApiImpl::FStatAt(int dirfd, const char *path, struct stat *buf,
+                           int flags) const {
+  return fstatat(dirfd, path, buf, flags);
+}
+
 int LibcFsApiImpl::StatFs64(const char *path, struct statfs64 *buf) const {
   return statfs64(path, buf);
 }
@@ -165,6 +174,12 @@ int LibcFsApiImpl::ReadDirR(DIR *dir, dirent *entry, dirent **result) const {
   return readdir_r(dir, entry, result);
 }
 
+ssize_t LibcFsApiImpl::GetDents64(int file_descriptor, char *buf,
+                                  size_t nbytes) const {
+  // glibc has no wrapper for getdents64().
+  return syscall(SYS_getdents64, file_descriptor, buf, nbytes);
+}
+
 int LibcFsApiImpl::CloseDir(DIR *dir) const { return closedir(dir); }
 
 ssize_t LibcFsApiImpl::ReadLink(const char *path, char *buf, size_t len) const {
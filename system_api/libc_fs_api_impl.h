@@ -44,6 +44,8 @@ class LibcFsApiImpl : public LibcFsApi {
 
   virtual int OpenWithMode(const char *path, int oflag, int mode) const;
 
+  virtual int OpenAt(int dirfd, const char *path, int oflag) const;
+
   virtual int FClose(FILE *file_pointer) const;
 
   virtual int FScanfUU(FILE *file_pointer, unsigned int *first,
@@ -77,6 +79,9 @@ class LibcFsApiImpl : public LibcFsApi {
 
   virtual int FStat(int file_descriptor, struct stat *buf) const;
 
+  virtual int FStatAt(int dirfd, const char *path, struct stat *buf,
+                      int flags) const;
+
   virtual int StatFs64(const char *path, struct statfs64 *buf) const;
 
   virtual int Mount(const char *source, const char *target,
@@ -108,6 +113,9 @@ class LibcFsApiImpl : public LibcFsApi {
 
   virtual int ReadDirR(DIR *dir, dirent *entry, dirent **result) const;
 
+  virtual ssize_t GetDents64(int file_descriptor, char *buf,
+                             size_t nbytes) const;
+
   virtual int CloseDir(DIR *dir) const;
 
   virtual ssize_t ReadLink(const char *path, char *buf, size_t len) const;
@@ -37,6 +37,7 @@ class MockLibcFsApi : public LibcFsApi {
   MOCK_CONST_METHOD1(OpenDir, DIR *(const char *name));
   MOCK_CONST_METHOD2(Open, int(const char *path, int oflag));
   MOCK_CONST_METHOD3(OpenWithMode, int(const char *path, int oflag, int mode));
+  MOCK_CONST_METHOD3(OpenAt, int(int dirfd, const char *path, int oflag));
   MOCK_CONST_METHOD1(FClose, int(FILE *file_pointer));
   MOCK_CONST_METHOD3(FScanfUU, int(FILE *file_pointer, unsigned int *first,
                                    unsigned int *second));
@@ -54,6 +55,8 @@ class MockLibcFsApi : public LibcFsApi {
   MOCK_CONST_METHOD2(Stat64, int(const char *path, struct stat64 *buf));
   MOCK_CONST_METHOD2(LStat, int(const char *path, struct stat *buf));
   MOCK_CONST_METHOD2(FStat, int(int file_descriptor, struct stat *buf));
+  MOCK_CONST_METHOD4(FStatAt, int(int dirfd, const char *path,
+                                  struct stat *buf, int flags));
   MOCK_CONST_METHOD2(StatFs64, int(const char *path, struct statfs64 *buf));
   MOCK_CONST_METHOD5(Mount, int(const char *source, const char *target,
                                 const char *filesystemtype,
@@ -74,6 +77,8 @@ class MockLibcFsApi : public LibcFsApi {
   MOCK_CONST_METHOD1(FSync, int(int file_descriptor));
   MOCK_CONST_METHOD1(ChDir, int(const char *path));
   MOCK_CONST_METHOD3(ReadDirR, int(DIR *dir, dirent *entry, dirent **result));
+  MOCK_CONST_METHOD3(GetDents64,
+                     ssize_t(int file_descriptor, char *buf, size_t nbytes));
   MOCK_CONST_METHOD1(CloseDir, int(DIR *dir));
   MOCK_CONST_METHOD3(ReadLink,
                      ssize_t(const char *path, char *buf, size_t len));
@@ -16,6 +16,7 @@
 
 #include "system_api/libc_net_api.h"
 
+#include <net/if.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -42,12 +43,18 @@ class LibcNetApiImpl : public LibcNetApi {
                  socklen_t *optlen) const override {
     return ::getsockopt(sockfd, level, optname, optval, optlen);
   }
+  unsigned int IfNameToIndex(const char *ifname) const override {
+    return ::if_nametoindex(ifname);
+  }
   int Listen(int sockfd, int backlog) const override {
     return ::listen(sockfd, backlog);
   }
   ssize_t Recv(int sockfd, void *buf, size_t len, int flags) const override {
     return ::recv(sockfd, buf, len, flags);
   }
+  ssize_t RecvMsg(int sockfd, struct msghdr *msg, int flags) const override {
+    return ::recvmsg(sockfd, msg, flags);
+  }
   ssize_t Send(int sockfd, const void *buf, size_t len,
                int flags) const override {
     return ::send(sockfd, buf, len, flags);
@@ -62,6 +69,10 @@ class LibcNetApiImpl : public LibcNetApi {
   int Socket(int domain, int type, int protocol) const override {
     return ::socket(domain, type, protocol);
   }
+  int SocketPair(int domain, int type, int protocol,
+                 int sv[2]) const override {
+    return ::socketpair(domain, type, protocol, sv);
+  }
 };
 
 }  // namespace
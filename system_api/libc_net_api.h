@@ -38,14 +38,18 @@ class LibcNetApi {
                       socklen_t addrlen) const = 0;
   virtual int GetSockOpt(int sockfd, int level, int optname, void *optval,
                          socklen_t *optlen) const = 0;
+  virtual unsigned int IfNameToIndex(const char *ifname) const = 0;
   virtual int Listen(int sockfd, int backlog) const = 0;
   virtual ssize_t Recv(int sockfd, void *buf, size_t len, int flags) const = 0;
+  virtual ssize_t RecvMsg(int sockfd, struct msghdr *msg, int flags) const = 0;
   virtual ssize_t Send(int sockfd, const void *buf, size_t len,
                        int flags) const = 0;
   virtual int SetHostname(const char *name, size_t len) const = 0;
   virtual int SetSockOpt(int sockfd, int level, int optname, const void *optval,
                          socklen_t optlen) const = 0;
   virtual int Socket(int domain, int type, int protocol) const = 0;
+  virtual int SocketPair(int domain, int type, int protocol,
+                         int sv[2]) const = 0;
 
  protected:
   LibcNetApi() {}
@@ -32,15 +32,20 @@ class MockLibcNetApi : public LibcNetApi {
                                   socklen_t addrlen));
   MOCK_CONST_METHOD5(GetSockOpt, int(int sockfd, int level, int optname,
                                      void *optval, socklen_t *optlen));
+  MOCK_CONST_METHOD1(IfNameToIndex, unsigned int(const char *ifname));
   MOCK_CONST_METHOD2(Listen, int(int sockfd, int backlog));
   MOCK_CONST_METHOD4(Recv,
                      ssize_t(int sockfd, void *buf, size_t len, int flags));
+  MOCK_CONST_METHOD3(RecvMsg,
+                     ssize_t(int sockfd, struct msghdr *msg, int flags));
   MOCK_CONST_METHOD4(Send, ssize_t(int sockfd, const void *buf, size_t len,
                                    int flags));
   MOCK_CONST_METHOD2(SetHostname, int(const char *, size_t));
   MOCK_CONST_METHOD5(SetSockOpt, int(int sockfd, int level, int optname,
                                      const void *optval, socklen_t optlen));
   MOCK_CONST_METHOD3(Socket, int(int domain, int type, int protocol));
+  MOCK_CONST_METHOD4(SocketPair,
+                     int(int domain, int type, int protocol, int sv[2]));
 };
 
 extern const LibcNetApi *GlobalLibcNetApi();
@@ -21,10 +21,10 @@
 
 #include "system_api/libc_process_api.h"
 
-#include <grp.h>
 #include <sched.h>
 #include <signal.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -105,16 +105,17 @@ class LibcProcessApiImpl : public LibcProcessApi {
     return ::getpgid(pid);
   }
 
+  // The raw syscalls, see the header.
   int SetResUid(uid_t ruid, uid_t euid, uid_t suid) const override {
-    return ::setresuid(ruid, euid, suid);
+    return ::syscall(SYS_setresuid, ruid, euid, suid);
   }
 
   int SetResGid(gid_t rgid, gid_t egid, gid_t sgid) const override {
-    return ::setresgid(rgid, egid, sgid);
+    return ::syscall(SYS_setresgid, rgid, egid, sgid);
   }
 
   int SetGroups(size_t size, const gid_t *list) const override {
-    return ::setgroups(size, list);
+    return ::syscall(SYS_setgroups, size, list);
   }
 };
 
@@ -58,6 +58,12 @@ class LibcProcessApi {
   virtual uid_t GetUid() const = 0;
   virtual pid_t GetPid() const = 0;
   virtual pid_t GetPGid(pid_t pid) const = 0;
+
+  // Unlike the libc functions, these only change the credentials of the
+  // calling thread. They are meant for processes that are single-threaded,
+  // like the children of Clone(): libc would otherwise try to change the
+  // credentials of every thread the cloning process had, and wait on them
+  // forever.
   virtual int SetResUid(uid_t ruid, uid_t euid, uid_t suid) const = 0;
   virtual int SetResGid(gid_t rgid, gid_t egid, gid_t sgid) const = 0;
   virtual int SetGroups(size_t size, const gid_t *list) const = 0;
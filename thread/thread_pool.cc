@@ -0,0 +1,98 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "thread/thread_pool.h"
+
+#include "base/logging.h"
+#include "thread/thread_options.h"
+
+using ::std::function;
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(num_threads), num_active_(0), stopping_(false) {
+  CHECK_GT(num_threads_, 0);
+  CHECK_EQ(0, pthread_mutex_init(&mutex_, nullptr));
+  CHECK_EQ(0, pthread_cond_init(&work_available_, nullptr));
+  CHECK_EQ(0, pthread_cond_init(&idle_, nullptr));
+}
+
+ThreadPool::~ThreadPool() {
+  Wait();
+
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&work_available_);
+  pthread_mutex_unlock(&mutex_);
+
+  for (auto &worker : workers_) {
+    worker->Join();
+  }
+
+  pthread_cond_destroy(&idle_);
+  pthread_cond_destroy(&work_available_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+void ThreadPool::StartWorkers() {
+  CHECK(workers_.empty()) << "Workers already started";
+
+  ::thread::Options options;
+  options.set_joinable(true);
+  for (int i = 0; i < num_threads_; ++i) {
+    workers_.emplace_back(new ClosureThread(
+        options, "ThreadPool", NewPermanentCallback(this, &ThreadPool::Work)));
+    workers_.back()->Start();
+  }
+}
+
+void ThreadPool::Schedule(function<void()> work) {
+  pthread_mutex_lock(&mutex_);
+  queue_.push_back(::std::move(work));
+  pthread_cond_signal(&work_available_);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void ThreadPool::Wait() {
+  pthread_mutex_lock(&mutex_);
+  while (!queue_.empty() || num_active_ > 0) {
+    pthread_cond_wait(&idle_, &mutex_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+void ThreadPool::Work() {
+  pthread_mutex_lock(&mutex_);
+  while (true) {
+    while (queue_.empty() && !stopping_) {
+      pthread_cond_wait(&work_available_, &mutex_);
+    }
+    if (queue_.empty()) {
+      break;
+    }
+
+    function<void()> work = ::std::move(queue_.front());
+    queue_.pop_front();
+    ++num_active_;
+    pthread_mutex_unlock(&mutex_);
+
+    work();
+
+    pthread_mutex_lock(&mutex_);
+    --num_active_;
+    if (queue_.empty() && num_active_ == 0) {
+      pthread_cond_broadcast(&idle_);
+    }
+  }
+  pthread_mutex_unlock(&mutex_);
+}
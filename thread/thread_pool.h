@@ -0,0 +1,78 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THREAD_THREAD_POOL_H__
+#define THREAD_THREAD_POOL_H__
+
+#include <pthread.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "thread/thread.h"
+
+// A fixed number of worker threads that run scheduled work in FIFO order.
+// Work may schedule more work.
+//
+// Class is thread-safe.
+class ThreadPool {
+ public:
+  // Creates a pool of num_threads workers. The workers are not started until
+  // StartWorkers() is called.
+  explicit ThreadPool(int num_threads);
+
+  // Waits for all scheduled work to finish and stops the workers.
+  ~ThreadPool();
+
+  // Starts the worker threads. Must be called exactly once.
+  void StartWorkers();
+
+  // Schedules work to be run by one of the workers.
+  void Schedule(::std::function<void()> work);
+
+  // Blocks until there is no scheduled or running work. Work scheduled from
+  // running work is waited for too.
+  void Wait();
+
+ private:
+  // Body of each worker thread: runs work until the pool is stopped.
+  void Work();
+
+  const int num_threads_;
+  ::std::vector< ::std::unique_ptr<ClosureThread>> workers_;
+
+  // Work not yet picked up by a worker.
+  ::std::deque< ::std::function<void()>> queue_;
+
+  // Number of workers running work.
+  int num_active_;
+
+  // Whether the workers should exit once the queue is empty.
+  bool stopping_;
+
+  // Protects all of the above.
+  pthread_mutex_t mutex_;
+
+  // Signalled when work is added or the pool is stopping.
+  pthread_cond_t work_available_;
+
+  // Signalled when the queue is empty and no work is running.
+  pthread_cond_t idle_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+#endif  // THREAD_THREAD_POOL_H__
@@ -0,0 +1,130 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "thread/thread_pool.h"
+
+#include <memory>
+#include <vector>
+
+#include "base/mutex.h"
+#include "base/notification.h"
+#include "gtest/gtest.h"
+
+using ::std::unique_ptr;
+using ::std::vector;
+
+namespace {
+
+static const int kNumThreads = 4;
+
+class ThreadPoolTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    pool_.reset(new ThreadPool(kNumThreads));
+    pool_->StartWorkers();
+  }
+
+ protected:
+  unique_ptr<ThreadPool> pool_;
+};
+
+TEST_F(ThreadPoolTest, RunsAllWork) {
+  Mutex lock;
+  int count = 0;
+  for (int i = 0; i < 100; ++i) {
+    pool_->Schedule([&lock, &count]() {
+      MutexLock l(&lock);
+      ++count;
+    });
+  }
+
+  pool_->Wait();
+  EXPECT_EQ(100, count);
+}
+
+TEST_F(ThreadPoolTest, WaitWithNoWork) {
+  pool_->Wait();
+}
+
+TEST_F(ThreadPoolTest, WaitsForWorkScheduledByWork) {
+  Mutex lock;
+  vector<int> order;
+  pool_->Schedule([this, &lock, &order]() {
+    pool_->Schedule([&lock, &order]() {
+      MutexLock l(&lock);
+      order.push_back(2);
+    });
+    MutexLock l(&lock);
+    order.push_back(1);
+  });
+
+  pool_->Wait();
+  ASSERT_EQ(2, order.size());
+}
+
+TEST_F(ThreadPoolTest, RunsWorkConcurrently) {
+  // Each piece of work only finishes once all of them are running, which
+  // deadlocks unless there are kNumThreads workers.
+  Mutex lock;
+  int running = 0;
+  Notification all_running;
+  for (int i = 0; i < kNumThreads; ++i) {
+    pool_->Schedule([&lock, &running, &all_running]() {
+      {
+        MutexLock l(&lock);
+        if (++running == kNumThreads) {
+          all_running.Notify();
+        }
+      }
+      all_running.WaitForNotification();
+    });
+  }
+
+  pool_->Wait();
+  EXPECT_EQ(kNumThreads, running);
+}
+
+TEST_F(ThreadPoolTest, DestructorWaitsForWork) {
+  Notification started;
+  Notification release;
+  bool done = false;
+  pool_->Schedule([&started, &release, &done]() {
+    started.Notify();
+    release.WaitForNotification();
+    done = true;
+  });
+  started.WaitForNotification();
+
+  release.Notify();
+  pool_.reset();
+  EXPECT_TRUE(done);
+}
+
+TEST(ThreadPoolSingleThreadTest, RunsWorkInOrder) {
+  vector<int> order;
+  {
+    ThreadPool pool(1);
+    pool.StartWorkers();
+    for (int i = 0; i < 10; ++i) {
+      pool.Schedule([&order, i]() { order.push_back(i); });
+    }
+  }
+
+  ASSERT_EQ(10, order.size());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, order[i]);
+  }
+}
+
+}  // namespace
@@ -49,6 +49,8 @@ using ::system_api::KernelAPI;
 // notifications.
 static const char kEventControlFile[] = "cgroup.event_control";
 static const int64 kPollTimeoutMs = 200;
+// Size of the reads of watched files and FIFOs.
+static const int kReadBufferSize = 4096;
 
 EventfdListener::EventfdListener(const KernelAPI &kernel,
                                  const string &thread_name,
@@ -104,7 +106,9 @@ void EventfdListener::Start() {
 
 bool EventfdListener::AddToEpoll(int eventfd, EventInfo *info) {
   struct epoll_event event;
-  event.events = EPOLLIN;
+  // Triggers and watches are signaled with POLLPRI on the file itself.
+  event.events = (info->type_ == EventInfo::TRIGGER ||
+                  info->type_ == EventInfo::WATCH) ? EPOLLPRI : EPOLLIN;
   event.data.ptr = static_cast<void *>(info);
   if (kernel_.EpollCtl(epoll_fd_, EPOLL_CTL_ADD, eventfd, &event)) {
     LOG(ERROR) << "epoll_ctl failed for adding eventfd for "
@@ -117,6 +121,34 @@ bool EventfdListener::AddToEpoll(int eventfd, EventInfo *info) {
 bool EventfdListener::Add(const string& basepath, const string &control_file,
                           const string &args, const string &name,
                           EventReceiverInterface *callback) {
+  return AddEvent(basepath, control_file, args, name, callback,
+                  EventInfo::EVENTFD);
+}
+
+bool EventfdListener::AddTrigger(const string &basepath,
+                                 const string &trigger_file,
+                                 const string &trigger, const string &name,
+                                 EventReceiverInterface *callback) {
+  return AddEvent(basepath, trigger_file, trigger, name, callback,
+                  EventInfo::TRIGGER);
+}
+
+bool EventfdListener::AddWatch(const string &basepath,
+                               const string &watch_file, const string &name,
+                               EventReceiverInterface *callback) {
+  return AddEvent(basepath, watch_file, "", name, callback, EventInfo::WATCH);
+}
+
+bool EventfdListener::AddStream(const string &basepath, const string &fifo,
+                                const string &name,
+                                EventReceiverInterface *callback) {
+  return AddEvent(basepath, fifo, "", name, callback, EventInfo::STREAM);
+}
+
+bool EventfdListener::AddEvent(const string &basepath, const string &file,
+                               const string &args, const string &name,
+                               EventReceiverInterface *callback,
+                               EventInfo::Type type) {
   {
     // We're on our way out so don't accept any more events.
     MutexLock lock(&mutex_);
@@ -131,13 +163,32 @@ bool EventfdListener::Add(const string& basepath, const string &control_file,
     return false;
   int eventfd = -1;
   // Do the setup for the eventfd w/o holding the mutex_.
-  if (!SetupEvent(basepath, control_file, args, name, &eventfd))
-    return false;
+  switch (type) {
+    case EventInfo::EVENTFD:
+      if (!SetupEvent(basepath, file, args, name, &eventfd))
+        return false;
+      break;
+    case EventInfo::TRIGGER:
+      if (!SetupTrigger(basepath, file, args, name, &eventfd))
+        return false;
+      break;
+    case EventInfo::WATCH:
+      if (!SetupPolledFile(basepath, file, O_RDONLY, name, &eventfd))
+        return false;
+      break;
+    case EventInfo::STREAM:
+      // Opening the FIFO for writing too keeps it from reaching end of file
+      // (and signaling POLLHUP) whenever no writer has it open.
+      if (!SetupPolledFile(basepath, file, O_RDWR, name, &eventfd))
+        return false;
+      break;
+  }
   MutexLock lock(&mutex_);
   EventInfo *info = new EventInfo(name, args, eventfd, callback,
-      JoinPath(basepath, control_file));
+      JoinPath(basepath, file), type);
   if (!AddToEpoll(eventfd, info)) {
     delete info;
+    kernel_.Close(eventfd);
     return false;
   }
   names_[eventfd] = info;
@@ -198,6 +249,73 @@ bool EventfdListener::SetupEvent(const string& basepath,
   return true;
 }
 
+bool EventfdListener::SetupTrigger(const string &basepath,
+                                   const string &trigger_file,
+                                   const string &trigger, const string &name,
+                                   int *fd) {
+  // The trigger stays armed for as long as the file it was written to is kept
+  // open, so the file is what we poll on.
+  string trigger_file_path = JoinPath(basepath, trigger_file);
+  *fd = kernel_.Open(trigger_file_path.c_str(),
+                     O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (*fd < 0) {
+    LOG(ERROR) << "Failed to open " << trigger_file_path
+               << ", cgroup was probably destroyed for container "
+               << "'" << name << "'";
+    return false;
+  }
+
+  // The trigger must be written in a single write, including the terminating
+  // NUL.
+  if (kernel_.Write(*fd, trigger.c_str(), trigger.size() + 1) < 0) {
+    LOG(ERROR) << "Failed to write trigger \"" << trigger << "\" to "
+               << trigger_file_path << " for container '" << name << "'";
+    kernel_.Close(*fd);
+    return false;
+  }
+
+  LOG(INFO) << "Starting to listen for events for trigger file "
+            << trigger_file_path << " with trigger " << trigger;
+  return true;
+}
+
+bool EventfdListener::SetupPolledFile(const string &basepath,
+                                      const string &file, int flags,
+                                      const string &name, int *fd) {
+  string file_path = JoinPath(basepath, file);
+  *fd = kernel_.Open(file_path.c_str(), flags | O_NONBLOCK | O_CLOEXEC);
+  if (*fd < 0) {
+    LOG(ERROR) << "Failed to open " << file_path << " for container "
+               << "'" << name << "'";
+    return false;
+  }
+
+  LOG(INFO) << "Starting to listen for events for file " << file_path;
+  return true;
+}
+
+bool EventfdListener::ReadPolledFile(const EventInfo &info, string *data) {
+  char buf[kReadBufferSize];
+  data->clear();
+  if (info.type_ == EventInfo::WATCH) {
+    // Watched files are read from the start every time, which is also what
+    // re-arms the notification.
+    ssize_t nbytes;
+    while ((nbytes = kernel_.Pread(info.eventfd_, buf, sizeof(buf),
+                                   data->size())) > 0) {
+      data->append(buf, nbytes);
+    }
+    return nbytes == 0;
+  }
+
+  // Drain the FIFO.
+  ssize_t nbytes;
+  while ((nbytes = kernel_.Read(info.eventfd_, buf, sizeof(buf))) > 0) {
+    data->append(buf, nbytes);
+  }
+  return nbytes == 0 || errno == EAGAIN || errno == EINTR;
+}
+
 void EventfdListener::ReportTermination(int eventfd, bool error) {
   string name;
   EventReceiverInterface *callback = event_receiver_;
@@ -228,6 +346,60 @@ void EventfdListener::HandlePolledEvent(struct epoll_event *events,
 
   WallTime start_time = WallTime_Now();
   for (int i = 0; i < num_events; i++) {
+    EventInfo *polled_info = static_cast<EventInfo *>(events[i].data.ptr);
+    if (polled_info->type_ == EventInfo::WATCH ||
+        polled_info->type_ == EventInfo::STREAM) {
+      // Watched files signal POLLERR along with POLLPRI on every change, so
+      // only their removal ends the watch.
+      if (kernel_.Access(polled_info->path_, F_OK) < 0) {
+        pending_delete.push_back(make_pair(polled_info->eventfd_, false));
+        continue;
+      }
+      if (events[i].events & (EPOLLPRI | EPOLLIN)) {
+        string data;
+        if (!ReadPolledFile(*polled_info, &data)) {
+          LOG(ERROR) << "Cannot read " << polled_info->path_;
+          pending_delete.push_back(make_pair(polled_info->eventfd_, true));
+          continue;
+        }
+        if (data.empty()) {
+          continue;
+        }
+        LOG(INFO) << "Received event for " << polled_info->name_;
+        EventReceiverInterface *callback = event_receiver_;
+        if (polled_info->callback_) {
+          callback = polled_info->callback_;
+        }
+        if (!callback->ReportEvent(polled_info->name_, data)) {
+          LOG(ERROR) << "ReportEvent failed for '" << polled_info->name_
+                     << "'";
+          pending_delete.push_back(make_pair(polled_info->eventfd_, false));
+        }
+      }
+      continue;
+    }
+    EventInfo *trigger_info = polled_info;
+    if (trigger_info->type_ == EventInfo::TRIGGER) {
+      // The kernel signals POLLERR once the cgroup of the trigger is removed.
+      if ((events[i].events & EPOLLERR) ||
+          kernel_.Access(trigger_info->path_, F_OK) < 0) {
+        pending_delete.push_back(make_pair(trigger_info->eventfd_, false));
+        continue;
+      }
+      if (events[i].events & EPOLLPRI) {
+        LOG(INFO) << "Received trigger event for " << trigger_info->name_;
+        EventReceiverInterface *callback = event_receiver_;
+        if (trigger_info->callback_) {
+          callback = trigger_info->callback_;
+        }
+        if (!callback->ReportEvent(trigger_info->name_, "1")) {
+          LOG(ERROR) << "ReportEvent failed for '" << trigger_info->name_
+                     << "'";
+          pending_delete.push_back(make_pair(trigger_info->eventfd_, false));
+        }
+      }
+      continue;
+    }
     if (events[i].events & EPOLLIN) {
       EventInfo *info = static_cast<EventInfo *>(events[i].data.ptr);
       WallTime elapsed_time = WallTime_Now() - start_time;
@@ -18,6 +18,12 @@
 // Add(): Register an event to be listened for by this thread. Sets up the
 //        eventfd and such for the event. Returns false if setup fails or if
 //        this exceeds the max_multiplexed_events value.
+// AddTrigger(): Like Add(), for files that signal events with POLLPRI on the
+//        file itself once a trigger is written to them (e.g. the cgroup
+//        pressure stall information files).
+// AddWatch(): Like Add(), for files that signal changes to their contents with
+//        POLLPRI (e.g. cgroup.events). The new contents are reported.
+// AddStream(): Like Add(), for FIFOs. The data read from the FIFO is reported.
 // Start(): Start the event listen loop for added eventfds.
 // EventCount(): Number of registered events.
 // StopSoon(): Notifies the thread that it should stop soon.
@@ -75,19 +81,35 @@ class EventReceiverInterface {
 };
 
 struct EventInfo {
+  // How the event is signaled.
+  enum Type {
+    // Added with Add(), signaled through an eventfd.
+    EVENTFD,
+    // Added with AddTrigger(), signaled with POLLPRI on the trigger file.
+    TRIGGER,
+    // Added with AddWatch(), signaled with POLLPRI on the watched file.
+    WATCH,
+    // Added with AddStream(), signaled with POLLIN on the FIFO.
+    STREAM,
+  };
+
   EventInfo(const string& name, const string& args, int eventfd,
-      EventReceiverInterface *callback, const string& control_file_path)
+      EventReceiverInterface *callback, const string& control_file_path,
+      Type type)
     : name_(name),
       args_(args),
       eventfd_(eventfd),
       callback_(callback),
-      path_(control_file_path) {}
+      path_(control_file_path),
+      type_(type) {}
 
   const string name_;
   const string args_;
+  // For all types but EVENTFD, the file descriptor of the polled file.
   int eventfd_;
   EventReceiverInterface *callback_;
   const string path_;
+  const Type type_;
 };
 
 // This helps get notifications when the interesting event happens. This is
@@ -124,6 +146,37 @@ class EventfdListener : public Thread {
     const string &basepath, const string &control_file,
     const string &args, const string &name,
     EventReceiverInterface *callback) LOCKS_EXCLUDED(mutex_);
+  // basepath: base path of the container
+  // trigger_file: file to write the trigger to. This is prefixed with basepath
+  // trigger: the trigger, written to trigger_file in a single write
+  // name: identifier to pass back to the Report* calls
+  // Add a new trigger to be listened to. trigger_file is kept open for as long
+  // as the trigger is listened to, and an event is reported each time the
+  // kernel signals POLLPRI on it. Returns false in the same cases as Add().
+  virtual bool AddTrigger(
+    const string &basepath, const string &trigger_file,
+    const string &trigger, const string &name,
+    EventReceiverInterface *callback) LOCKS_EXCLUDED(mutex_);
+  // basepath: base path of the container
+  // watch_file: file to watch. This is prefixed with basepath
+  // name: identifier to pass back to the Report* calls
+  // Add a new file to be watched for changes. An event is reported each time
+  // the kernel signals POLLPRI on the file, with its new contents as the
+  // arguments. Returns false in the same cases as Add().
+  virtual bool AddWatch(
+    const string &basepath, const string &watch_file, const string &name,
+    EventReceiverInterface *callback) LOCKS_EXCLUDED(mutex_);
+  // basepath: directory of the FIFO
+  // fifo: FIFO to read from. This is prefixed with basepath
+  // name: identifier to pass back to the Report* calls
+  // Add a new FIFO to be read from. An event is reported each time data is
+  // available, with the data read as the arguments. Data written by a single
+  // write of at most PIPE_BUF bytes is never split across events. The FIFO is
+  // kept open for writing too so that it is never at end of file. Returns
+  // false in the same cases as Add().
+  virtual bool AddStream(
+    const string &basepath, const string &fifo, const string &name,
+    EventReceiverInterface *callback) LOCKS_EXCLUDED(mutex_);
   // Return the number of events being listened to.
   // When reporting error or exit events, this will already be decremented for
   // the event in question.
@@ -137,9 +190,9 @@ class EventfdListener : public Thread {
   // Start() in between.
   virtual void Stop();
   // Waits for the notification thread to stop.
-  void WaitUntilStopped() LOCKS_EXCLUDED(mutex_);
+  virtual void WaitUntilStopped() LOCKS_EXCLUDED(mutex_);
   // Returns true when the notification thread is not running.
-  bool IsNotRunning() LOCKS_EXCLUDED(mutex_) {
+  virtual bool IsNotRunning() LOCKS_EXCLUDED(mutex_) {
     MutexLock lock(&mutex_);
     return IsNotRunningLocked();
   }
@@ -150,6 +203,14 @@ class EventfdListener : public Thread {
   // each time Update() is invoked.
   bool SetupEvent(const string &basepath, const string &control_file,
                   const string &args, const string &name, int *eventfd);
+  // Setup a trigger by writing it to the opened trigger file, whose file
+  // descriptor is returned in fd.
+  bool SetupTrigger(const string &basepath, const string &trigger_file,
+                    const string &trigger, const string &name, int *fd);
+  // Open the file to poll for a watch or a stream, whose file descriptor is
+  // returned in fd.
+  bool SetupPolledFile(const string &basepath, const string &file, int flags,
+                       const string &name, int *fd);
   // Remove the event from the internal data structures and report termination
   // for that event (error or exit).
   void ReportTermination(int index, bool error) LOCKS_EXCLUDED(mutex_);
@@ -160,8 +221,15 @@ class EventfdListener : public Thread {
   EventReceiverInterface *event_receiver_;
 
  private:
+  // Common implementation of the Add*() methods.
+  bool AddEvent(const string &basepath, const string &file, const string &args,
+                const string &name, EventReceiverInterface *callback,
+                EventInfo::Type type) LOCKS_EXCLUDED(mutex_);
   bool AddToEpoll(int eventfd, EventInfo *info);
   void HandlePolledEvent(struct epoll_event *events, int size);
+  // Reads the data to report for an event of type WATCH or STREAM. Returns
+  // false if the data could not be read.
+  bool ReadPolledFile(const EventInfo &info, string *data);
   void TerminateAll(bool error);
   // Returns true when the notification thread is not running.
   bool IsNotRunningLocked() const EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
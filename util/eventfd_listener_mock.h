@@ -36,6 +36,12 @@ class MockEventfdListener : public EventfdListener {
                         max_multiplexed_events) {}
   MOCK_METHOD5(Add, bool(const string &, const string &, const string &,
                          const string &, EventReceiverInterface *er));
+  MOCK_METHOD5(AddTrigger, bool(const string &, const string &, const string &,
+                                const string &, EventReceiverInterface *er));
+  MOCK_METHOD4(AddWatch, bool(const string &, const string &, const string &,
+                              EventReceiverInterface *er));
+  MOCK_METHOD4(AddStream, bool(const string &, const string &, const string &,
+                               EventReceiverInterface *er));
   MOCK_METHOD0(Start, void());
   MOCK_METHOD0(Stop, void());
   MOCK_METHOD0(IsNotRunning, bool());
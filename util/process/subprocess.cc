@@ -34,10 +34,47 @@
 using ::std::string;
 using ::std::vector;
 
+#ifndef __NR_clone3
+#define __NR_clone3 435
+#endif
+
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+
 namespace {
 int getdents(unsigned int fd, struct kernel_dirent* dirp, unsigned int count) {
   return syscall(__NR_getdents, fd, dirp, count);
 }
+
+// Arguments of clone3(), as in struct clone_args of <linux/sched.h> up to the
+// cgroup field (CLONE_ARGS_SIZE_VER2).
+struct CloneArgs {
+  uint64 flags;
+  uint64 pidfd;
+  uint64 child_tid;
+  uint64 parent_tid;
+  uint64 exit_signal;
+  uint64 stack;
+  uint64 stack_size;
+  uint64 tls;
+  uint64 set_tid;
+  uint64 set_tid_size;
+  uint64 cgroup;
+};
+
+// Forks into the cgroup open at cgroup_fd. Returns as fork() does.
+pid_t CloneIntoCgroup(int cgroup_fd) {
+  CloneArgs args;
+  memset(&args, 0, sizeof(args));
+  args.flags = CLONE_INTO_CGROUP;
+  args.exit_signal = SIGCHLD;
+  args.cgroup = cgroup_fd;
+  return syscall(__NR_clone3, &args, sizeof(args));
+}
+
+// Cgroup fd of the innermost ScopedCloneIntoCgroup of each thread.
+__thread int clone_cgroup_fd = -1;
 }  // namespace
 
 static const int kMaxNumChannels = 3;
@@ -317,14 +354,7 @@ void SubProcess::ChildFork() {
 }
 
 void SubProcess::ExecChild() {
-  // Build a vector of C-compatible strings.
-  vector<const char *> cargv;
-  for (const string &s : argv_) {
-    cargv.push_back(s.c_str());
-  }
-  cargv.push_back(nullptr);
-
-  execvp(argv_[0].c_str(), const_cast<char *const *>(&cargv.front()));
+  execvp(exec_argv_[0], const_cast<char *const *>(&exec_argv_.front()));
 }
 
 bool SubProcess::Wait() {
@@ -387,17 +417,33 @@ bool SubProcess::Start() {
     return false;
   }
 
+  // Build a vector of C-compatible strings.
+  exec_argv_.clear();
+  for (const string &s : argv_) {
+    exec_argv_.push_back(s.c_str());
+  }
+  exec_argv_.push_back(nullptr);
+
   BlockSignals();
 
   // Fork, exec.
-  pid_t pid = fork();
+  const int cgroup_fd = ScopedCloneIntoCgroup::CurrentCgroupFd();
+  pid_t pid = cgroup_fd >= 0 ? CloneIntoCgroup(cgroup_fd) : fork();
   if (pid == 0) {
     // Child never returns;
     ChildFork();
   }
+  const int fork_errno = errno;
 
   UnblockSignals();
 
+  if (pid < 0) {
+    exit_status_ = fork_errno;
+    error_text_ = string("Failed to fork. Error: ") + strerror(fork_errno);
+    CloseAllPipeFds();
+    return false;
+  }
+
   if (!ReceiveMessageFromChild()) {
     CloseAllPipeFds();
     return false;
@@ -534,3 +580,16 @@ int SubProcess::Communicate(string* stdout_output,
   }
   return exit_code();
 }
+
+ScopedCloneIntoCgroup::ScopedCloneIntoCgroup(int cgroup_fd)
+    : previous_cgroup_fd_(clone_cgroup_fd) {
+  clone_cgroup_fd = cgroup_fd;
+}
+
+ScopedCloneIntoCgroup::~ScopedCloneIntoCgroup() {
+  clone_cgroup_fd = previous_cgroup_fd_;
+}
+
+int ScopedCloneIntoCgroup::CurrentCgroupFd() {
+  return clone_cgroup_fd;
+}
@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "base/integral_types.h"
+#include "base/macros.h"
 
 enum Channel {
   CHAN_STDIN = STDIN_FILENO,
@@ -87,7 +88,8 @@ class SubProcess {
                           ::std::string* stderr_output);
 
  protected:
-  // Actually exec the child process.
+  // Actually exec the child process. Runs in the child, so it uses the
+  // argument list prepared by Start() instead of allocating one.
   virtual void ExecChild();
 
  private:
@@ -118,6 +120,8 @@ class SubProcess {
 
   pid_t pid_;
   ::std::vector<::std::string> argv_;
+  // argv_ as C strings, null-terminated. Built by Start().
+  ::std::vector<const char *> exec_argv_;
   sigset_t old_signals_;
   ::std::vector<ChannelAction> actions_;
 
@@ -135,4 +139,31 @@ class SubProcess {
   ::std::unique_ptr<CommBuf> comm_buf_;
 };
 
+// While an instance is alive, the processes that SubProcess starts on the thread
+// that created it are cloned straight into a cgroup of the cgroup v2 unified
+// hierarchy (clone3() with CLONE_INTO_CGROUP), instead of starting in the
+// cgroups of their parent. Instances can be nested, the innermost one applies.
+//
+// clone3() is called directly, so the fork handlers registered with
+// pthread_atfork() are not run in the child.
+//
+// Class is not thread-safe, it must be used by the thread that created it.
+class ScopedCloneIntoCgroup {
+ public:
+  // Does not take ownership of cgroup_fd, a directory fd of the cgroup that
+  // must stay open while the instance is alive.
+  explicit ScopedCloneIntoCgroup(int cgroup_fd);
+  ~ScopedCloneIntoCgroup();
+
+  // Gets the cgroup fd of the innermost instance of the current thread, -1 if
+  // there is none.
+  static int CurrentCgroupFd();
+
+ private:
+  // The cgroup fd that was current when this instance was created.
+  const int previous_cgroup_fd_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedCloneIntoCgroup);
+};
+
 #endif  // UTIL_PROCESS_SUBPROCESS_H__
@@ -0,0 +1,332 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/sharded_eventfd_listener.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+
+#include "base/hash.h"
+#include "base/logging.h"
+#include "base/walltime.h"
+#include "strings/substitute.h"
+
+namespace util {
+
+using ::std::deque;
+using ::std::function;
+using ::std::max;
+using ::std::string;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::strings::Substitute;
+using ::system_api::KernelAPI;
+
+// Receives the events of one registration from its shard and runs the actual
+// callbacks on the callback pool, one at a time and in order. Once the event is
+// terminated (ReportError() or ReportExit(), the last call from the shard) and
+// its queued callbacks have run, the receiver is released from the listener.
+//
+// Class is thread-safe.
+class ShardedEventfdListener::DispatchingReceiver
+    : public EventReceiverInterface {
+ public:
+  // Does not take ownership of any of the arguments.
+  DispatchingReceiver(ShardedEventfdListener *listener, Shard *shard,
+                      EventReceiverInterface *receiver)
+      : listener_(listener),
+        shard_(shard),
+        receiver_(receiver),
+        scheduled_(false),
+        stopped_(false),
+        terminated_(false) {}
+  ~DispatchingReceiver() override {}
+
+  bool ReportEvent(const string &name, const string &args) override {
+    {
+      MutexLock lock(&lock_);
+      if (stopped_) {
+        return false;
+      }
+    }
+
+    Dispatch([this, name, args]() {
+      if (!receiver_->ReportEvent(name, args)) {
+        MutexLock lock(&lock_);
+        stopped_ = true;
+      }
+    }, false);
+    return true;
+  }
+
+  void ReportError(const string &name, EventfdListener *efdl) override {
+    Dispatch([this, name]() { receiver_->ReportError(name, listener_); },
+             true);
+  }
+
+  void ReportExit(const string &name, EventfdListener *efdl) override {
+    Dispatch([this, name]() { receiver_->ReportExit(name, listener_); },
+             true);
+  }
+
+ private:
+  // Queues the callback and schedules this receiver on the callback pool if it
+  // is not already. terminates is true for the last callback of the event.
+  void Dispatch(function<void()> callback, bool terminates) {
+    const WallTime received = WallTime_Now();
+    {
+      MutexLock lock(&shard_->lock);
+      ++shard_->stats.queue_depth;
+    }
+
+    MutexLock lock(&lock_);
+    terminated_ = terminates;
+    pending_.push_back([this, received, callback]() {
+      {
+        MutexLock lock(&shard_->lock);
+        --shard_->stats.queue_depth;
+      }
+
+      callback();
+
+      const int64 latency_usec = (WallTime_Now() - received) * 1000000;
+      MutexLock lock(&shard_->lock);
+      ShardStats *stats = &shard_->stats;
+      ++stats->num_callbacks;
+      stats->total_callback_latency_usec += latency_usec;
+      stats->max_callback_latency_usec =
+          max(stats->max_callback_latency_usec, latency_usec);
+    });
+    if (!scheduled_) {
+      scheduled_ = true;
+      listener_->callback_pool_.Schedule([this]() { RunPending(); });
+    }
+  }
+
+  // Runs the queued callbacks until there are none left. Releases (and so
+  // deletes) the receiver if the event was terminated.
+  void RunPending() {
+    while (true) {
+      function<void()> callback;
+      {
+        MutexLock lock(&lock_);
+        if (pending_.empty()) {
+          scheduled_ = false;
+          if (!terminated_) {
+            return;
+          }
+          break;
+        }
+        callback = ::std::move(pending_.front());
+        pending_.pop_front();
+      }
+      callback();
+    }
+
+    // The shard makes no more calls after terminating the event.
+    listener_->ReleaseReceiver(this);
+  }
+
+  ShardedEventfdListener *listener_;
+  Shard *shard_;
+  EventReceiverInterface *receiver_;
+
+  Mutex lock_;
+
+  // Callbacks waiting to run.
+  deque<function<void()>> pending_ GUARDED_BY(lock_);
+
+  // Whether RunPending() is scheduled or running.
+  bool scheduled_ GUARDED_BY(lock_);
+
+  // Whether the receiver asked to stop receiving events.
+  bool stopped_ GUARDED_BY(lock_);
+
+  // Whether the shard terminated the event.
+  bool terminated_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(DispatchingReceiver);
+};
+
+// The base listener is never started and only needs room for a single event.
+ShardedEventfdListener::ShardedEventfdListener(
+    const KernelAPI &kernel, const string &thread_name,
+    EventReceiverInterface *er, bool joinable, int max_multiplexed_events,
+    int num_shards, int num_callback_threads,
+    EventfdListenerFactory *listener_factory)
+    : EventfdListener(kernel, thread_name, er, joinable, 1),
+      callback_pool_(num_callback_threads) {
+  CHECK_GT(num_shards, 0);
+  for (int i = 0; i < num_shards; ++i) {
+    unique_ptr<Shard> shard(new Shard());
+    shard->listener.reset(listener_factory->NewEventfdListener(
+        kernel, Substitute("$0_$1", thread_name, i), nullptr, joinable,
+        max_multiplexed_events));
+    shards_.emplace_back(shard.release());
+  }
+  callback_pool_.StartWorkers();
+}
+
+ShardedEventfdListener::~ShardedEventfdListener() {
+  WaitForCallbacks();
+}
+
+int ShardedEventfdListener::ShardFor(const string &basepath) const {
+  return HashStringThoroughly(basepath.data(), basepath.size()) %
+         shards_.size();
+}
+
+bool ShardedEventfdListener::Add(const string &basepath,
+                                 const string &control_file,
+                                 const string &args, const string &name,
+                                 EventReceiverInterface *callback) {
+  return AddToShard(basepath, control_file, args, name, callback,
+                    EventInfo::EVENTFD);
+}
+
+bool ShardedEventfdListener::AddTrigger(const string &basepath,
+                                        const string &trigger_file,
+                                        const string &trigger,
+                                        const string &name,
+                                        EventReceiverInterface *callback) {
+  return AddToShard(basepath, trigger_file, trigger, name, callback,
+                    EventInfo::TRIGGER);
+}
+
+bool ShardedEventfdListener::AddWatch(const string &basepath,
+                                      const string &watch_file,
+                                      const string &name,
+                                      EventReceiverInterface *callback) {
+  return AddToShard(basepath, watch_file, "", name, callback,
+                    EventInfo::WATCH);
+}
+
+bool ShardedEventfdListener::AddStream(const string &basepath,
+                                       const string &fifo, const string &name,
+                                       EventReceiverInterface *callback) {
+  return AddToShard(basepath, fifo, "", name, callback, EventInfo::STREAM);
+}
+
+bool ShardedEventfdListener::AddToShard(const string &basepath,
+                                        const string &file,
+                                        const string &args, const string &name,
+                                        EventReceiverInterface *callback,
+                                        EventInfo::Type type) {
+  // At least one callback (global per eventfd-listener or per event)
+  // is needed. Else return false.
+  if (!callback && !event_receiver_) {
+    return false;
+  }
+
+  // The receiver is kept before it is added to the shard since the event may
+  // be terminated, and the receiver released, right away.
+  Shard *shard = shards_[ShardFor(basepath)].get();
+  DispatchingReceiver *receiver = new DispatchingReceiver(
+      this, shard, callback != nullptr ? callback : event_receiver_);
+  {
+    MutexLock lock(&lock_);
+    receivers_[receiver].reset(receiver);
+  }
+  bool added = false;
+  switch (type) {
+    case EventInfo::EVENTFD:
+      added = shard->listener->Add(basepath, file, args, name, receiver);
+      break;
+    case EventInfo::TRIGGER:
+      added = shard->listener->AddTrigger(basepath, file, args, name,
+                                          receiver);
+      break;
+    case EventInfo::WATCH:
+      added = shard->listener->AddWatch(basepath, file, name, receiver);
+      break;
+    case EventInfo::STREAM:
+      added = shard->listener->AddStream(basepath, file, name, receiver);
+      break;
+  }
+  if (!added) {
+    ReleaseReceiver(receiver);
+    return false;
+  }
+  return true;
+}
+
+void ShardedEventfdListener::ReleaseReceiver(DispatchingReceiver *receiver) {
+  MutexLock lock(&lock_);
+  receivers_.erase(receiver);
+}
+
+int ShardedEventfdListener::ReceiverCount() {
+  MutexLock lock(&lock_);
+  return receivers_.size();
+}
+
+int ShardedEventfdListener::EventCount() {
+  int count = 0;
+  for (const auto &shard : shards_) {
+    count += shard->listener->EventCount();
+  }
+  return count;
+}
+
+void ShardedEventfdListener::Start() {
+  for (const auto &shard : shards_) {
+    if (shard->listener->IsNotRunning()) {
+      shard->listener->Start();
+    }
+  }
+}
+
+void ShardedEventfdListener::StopSoon() {
+  for (const auto &shard : shards_) {
+    shard->listener->StopSoon();
+  }
+}
+
+void ShardedEventfdListener::Stop() {
+  StopSoon();
+  WaitUntilStopped();
+  WaitForCallbacks();
+}
+
+void ShardedEventfdListener::WaitUntilStopped() {
+  for (const auto &shard : shards_) {
+    shard->listener->WaitUntilStopped();
+  }
+}
+
+bool ShardedEventfdListener::IsNotRunning() {
+  for (const auto &shard : shards_) {
+    if (!shard->listener->IsNotRunning()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+vector<ShardedEventfdListener::ShardStats>
+ShardedEventfdListener::GetShardStats() const {
+  vector<ShardStats> stats;
+  for (const auto &shard : shards_) {
+    MutexLock lock(&shard->lock);
+    stats.push_back(shard->stats);
+  }
+  return stats;
+}
+
+void ShardedEventfdListener::WaitForCallbacks() {
+  callback_pool_.Wait();
+}
+
+}  // namespace util
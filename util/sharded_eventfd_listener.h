@@ -0,0 +1,161 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// EventfdListener that spreads its events over several EventfdListener shards,
+// each with its own epoll thread. An event is assigned to a shard by hashing
+// the cgroup path it was registered for.
+//
+// Callbacks do not run on the polling threads: they are dispatched to a pool
+// of worker threads so that a slow callback does not delay the delivery of
+// other events. Callbacks for a single event are still delivered one at a time
+// and in order.
+//
+// Since callbacks run asynchronously, a ReportEvent() that returns false stops
+// the event on its next notification (or when the listener is stopped) rather
+// than right away.
+
+#ifndef UTIL_SHARDED_EVENTFD_LISTENER_H_
+#define UTIL_SHARDED_EVENTFD_LISTENER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/mutex.h"
+#include "base/thread_annotations.h"
+#include "thread/thread_pool.h"
+#include "util/eventfd_listener.h"
+
+namespace util {
+
+class ShardedEventfdListener : public EventfdListener {
+ public:
+  // Counters for the events of a shard.
+  struct ShardStats {
+    ShardStats()
+        : queue_depth(0),
+          num_callbacks(0),
+          total_callback_latency_usec(0),
+          max_callback_latency_usec(0) {}
+
+    // Number of callbacks waiting to run.
+    int64 queue_depth;
+    // Number of callbacks that have run.
+    int64 num_callbacks;
+    // Time from the event being received to its callback returning, summed
+    // over all callbacks and the maximum seen.
+    int64 total_callback_latency_usec;
+    int64 max_callback_latency_usec;
+  };
+
+  // kernel: Interface for kernel operations that may be mocked out for testing
+  // thread_name: identifier for the shard threads.
+  // er: Event reporting object
+  // joinable: Whether the shard threads should be marked joinable or not.
+  // max_multiplexed_events: Maximum number of events per shard.
+  // num_shards: Number of shards (and epoll threads).
+  // num_callback_threads: Number of threads that run callbacks.
+  // listener_factory: Used to create the shards. Not owned, only used during
+  //                   construction.
+  ShardedEventfdListener(const ::system_api::KernelAPI &kernel,
+                         const string &thread_name,
+                         EventReceiverInterface *er,
+                         bool joinable,
+                         int max_multiplexed_events,
+                         int num_shards,
+                         int num_callback_threads,
+                         EventfdListenerFactory *listener_factory);
+  ~ShardedEventfdListener() override;
+
+  // These methods are documented in EventfdListener.
+  bool Add(const string &basepath, const string &control_file,
+           const string &args, const string &name,
+           EventReceiverInterface *callback) override LOCKS_EXCLUDED(lock_);
+  bool AddTrigger(const string &basepath, const string &trigger_file,
+                  const string &trigger, const string &name,
+                  EventReceiverInterface *callback) override
+      LOCKS_EXCLUDED(lock_);
+  bool AddWatch(const string &basepath, const string &watch_file,
+                const string &name, EventReceiverInterface *callback) override
+      LOCKS_EXCLUDED(lock_);
+  bool AddStream(const string &basepath, const string &fifo,
+                 const string &name, EventReceiverInterface *callback) override
+      LOCKS_EXCLUDED(lock_);
+  int EventCount() override;
+  void Start() override;
+  void StopSoon() override;
+  // Also waits for the callbacks of the stopped events to run.
+  void Stop() override;
+  void WaitUntilStopped() override;
+  // True when no shard is running.
+  bool IsNotRunning() override;
+
+  // Returns the index of the shard events for basepath are assigned to.
+  int ShardFor(const string &basepath) const;
+
+  // Returns the counters of every shard, indexed by shard.
+  ::std::vector<ShardStats> GetShardStats() const;
+
+  // Blocks until all callbacks dispatched so far have run.
+  void WaitForCallbacks();
+
+  // Returns the number of events whose receivers are kept: those not yet
+  // terminated or with callbacks still to run.
+  int ReceiverCount() LOCKS_EXCLUDED(lock_);
+
+ protected:
+  // The shards do the polling, this thread is never started.
+  void Run() override {}
+
+ private:
+  class DispatchingReceiver;
+
+  // Common implementation of the Add*() methods, adds the event of the
+  // specified type to the shard of basepath.
+  bool AddToShard(const string &basepath, const string &file,
+                  const string &args, const string &name,
+                  EventReceiverInterface *callback, EventInfo::Type type)
+      LOCKS_EXCLUDED(lock_);
+
+  // Deletes the receiver. Called once its event is terminated and its
+  // callbacks have run, or when its event could not be added.
+  void ReleaseReceiver(DispatchingReceiver *receiver) LOCKS_EXCLUDED(lock_);
+
+  struct Shard {
+    ::std::unique_ptr<EventfdListener> listener;
+    mutable Mutex lock;
+    ShardStats stats GUARDED_BY(lock);
+  };
+
+  ::std::vector< ::std::unique_ptr<Shard>> shards_;
+
+  // Receivers of the added events, keyed by address. They are kept until their
+  // event is terminated and its queued callbacks have run.
+  ::std::map<const DispatchingReceiver *,
+             ::std::unique_ptr<DispatchingReceiver>> receivers_
+      GUARDED_BY(lock_);
+  Mutex lock_;
+
+  // Runs the callbacks. Destroyed first so that no callback outlives the
+  // receivers.
+  ThreadPool callback_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedEventfdListener);
+};
+
+}  // namespace util
+
+#endif  // UTIL_SHARDED_EVENTFD_LISTENER_H_
@@ -0,0 +1,330 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/sharded_eventfd_listener.h"
+
+#include <memory>
+#include <vector>
+
+#include "base/notification.h"
+#include "system_api/kernel_api_mock.h"
+#include "util/eventfd_listener_mock.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using ::system_api::KernelAPIMock;
+using ::std::unique_ptr;
+using ::std::vector;
+using ::testing::DoAll;
+using ::testing::InSequence;
+using ::testing::Invoke;
+using ::testing::NotNull;
+using ::testing::Return;
+using ::testing::SaveArg;
+using ::testing::StrictMock;
+using ::testing::_;
+
+namespace util {
+namespace {
+
+static const char kCgroupPath[] = "/dev/cgroup/memory/test";
+static const char kCgroupFile[] = "memory.oom_control";
+static const char kArgs[] = "1024";
+static const char kName[] = "test";
+static const int kNumShards = 2;
+static const int kNumCallbackThreads = 2;
+static const int kMaxEvents = 10;
+static const int kEpollFd = 1000;
+
+class ShardedEventfdListenerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    EXPECT_CALL(mock_kernel_, EpollCreate(_))
+        .WillRepeatedly(Return(kEpollFd));
+
+    for (int i = 0; i < kNumShards; ++i) {
+      mock_shards_.push_back(new StrictMock<MockEventfdListener>(
+          mock_kernel_, "shard", nullptr, false, kMaxEvents));
+    }
+    EXPECT_CALL(mock_factory_,
+                NewEventfdListener(_, _, nullptr, false, kMaxEvents))
+        .WillOnce(Return(mock_shards_[0]))
+        .WillOnce(Return(mock_shards_[1]));
+
+    listener_.reset(new ShardedEventfdListener(
+        mock_kernel_, "test", nullptr, false, kMaxEvents, kNumShards,
+        kNumCallbackThreads, &mock_factory_));
+  }
+
+  // Expects an Add() of kCgroupPath to its shard which returns ret. The
+  // receiver registered with the shard is saved in receiver.
+  void ExpectShardAdd(bool ret, EventReceiverInterface **receiver) {
+    MockEventfdListener *shard =
+        mock_shards_[listener_->ShardFor(kCgroupPath)];
+    EXPECT_CALL(*shard, Add(kCgroupPath, kCgroupFile, kArgs, kName, NotNull()))
+        .WillOnce(DoAll(SaveArg<4>(receiver), Return(ret)));
+  }
+
+ protected:
+  StrictMock<KernelAPIMock> mock_kernel_;
+  StrictMock<MockEventfdListenerFactory> mock_factory_;
+  StrictMock<MockEventReceiverInterface> mock_receiver_;
+  vector<MockEventfdListener *> mock_shards_;
+  unique_ptr<ShardedEventfdListener> listener_;
+};
+
+TEST_F(ShardedEventfdListenerTest, ShardFor) {
+  const int shard = listener_->ShardFor(kCgroupPath);
+  EXPECT_LE(0, shard);
+  EXPECT_GT(kNumShards, shard);
+  EXPECT_EQ(shard, listener_->ShardFor(kCgroupPath));
+}
+
+TEST_F(ShardedEventfdListenerTest, AddSuccess) {
+  EventReceiverInterface *receiver = nullptr;
+  ExpectShardAdd(true, &receiver);
+
+  EXPECT_TRUE(listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName,
+                             &mock_receiver_));
+  EXPECT_NE(&mock_receiver_, receiver);
+  EXPECT_EQ(1, listener_->ReceiverCount());
+}
+
+TEST_F(ShardedEventfdListenerTest, AddShardFails) {
+  EventReceiverInterface *receiver = nullptr;
+  ExpectShardAdd(false, &receiver);
+
+  EXPECT_FALSE(listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName,
+                              &mock_receiver_));
+  EXPECT_EQ(0, listener_->ReceiverCount());
+}
+
+TEST_F(ShardedEventfdListenerTest, AddNoCallback) {
+  EXPECT_FALSE(
+      listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName, nullptr));
+}
+
+TEST_F(ShardedEventfdListenerTest, AddTriggerSuccess) {
+  MockEventfdListener *shard = mock_shards_[listener_->ShardFor(kCgroupPath)];
+  EventReceiverInterface *receiver = nullptr;
+  EXPECT_CALL(*shard, AddTrigger(kCgroupPath, "cpu.pressure", "some 1 2",
+                                 kName, NotNull()))
+      .WillOnce(DoAll(SaveArg<4>(&receiver), Return(true)));
+
+  EXPECT_TRUE(listener_->AddTrigger(kCgroupPath, "cpu.pressure", "some 1 2",
+                                    kName, &mock_receiver_));
+  EXPECT_NE(&mock_receiver_, receiver);
+}
+
+TEST_F(ShardedEventfdListenerTest, AddTriggerShardFails) {
+  MockEventfdListener *shard = mock_shards_[listener_->ShardFor(kCgroupPath)];
+  EXPECT_CALL(*shard, AddTrigger(kCgroupPath, "cpu.pressure", "some 1 2",
+                                 kName, NotNull()))
+      .WillOnce(Return(false));
+
+  EXPECT_FALSE(listener_->AddTrigger(kCgroupPath, "cpu.pressure", "some 1 2",
+                                     kName, &mock_receiver_));
+}
+
+TEST_F(ShardedEventfdListenerTest, AddTriggerNoCallback) {
+  EXPECT_FALSE(listener_->AddTrigger(kCgroupPath, "cpu.pressure", "some 1 2",
+                                     kName, nullptr));
+}
+
+TEST_F(ShardedEventfdListenerTest, AddWatchSuccess) {
+  MockEventfdListener *shard = mock_shards_[listener_->ShardFor(kCgroupPath)];
+  EventReceiverInterface *receiver = nullptr;
+  EXPECT_CALL(*shard, AddWatch(kCgroupPath, "cgroup.events", kName, NotNull()))
+      .WillOnce(DoAll(SaveArg<3>(&receiver), Return(true)));
+
+  EXPECT_TRUE(listener_->AddWatch(kCgroupPath, "cgroup.events", kName,
+                                  &mock_receiver_));
+  EXPECT_NE(&mock_receiver_, receiver);
+}
+
+TEST_F(ShardedEventfdListenerTest, AddWatchShardFails) {
+  MockEventfdListener *shard = mock_shards_[listener_->ShardFor(kCgroupPath)];
+  EXPECT_CALL(*shard, AddWatch(kCgroupPath, "cgroup.events", kName, NotNull()))
+      .WillOnce(Return(false));
+
+  EXPECT_FALSE(listener_->AddWatch(kCgroupPath, "cgroup.events", kName,
+                                   &mock_receiver_));
+}
+
+TEST_F(ShardedEventfdListenerTest, AddStreamSuccess) {
+  MockEventfdListener *shard = mock_shards_[listener_->ShardFor("/run/lmctfy")];
+  EXPECT_CALL(*shard, AddStream("/run/lmctfy", "release_agent", kName,
+                                NotNull()))
+      .WillOnce(Return(true));
+
+  EXPECT_TRUE(listener_->AddStream("/run/lmctfy", "release_agent", kName,
+                                   &mock_receiver_));
+}
+
+TEST_F(ShardedEventfdListenerTest, AddStreamNoCallback) {
+  EXPECT_FALSE(listener_->AddStream("/run/lmctfy", "release_agent", kName,
+                                    nullptr));
+}
+
+TEST_F(ShardedEventfdListenerTest, ReportEventIsDispatched) {
+  EventReceiverInterface *receiver = nullptr;
+  ExpectShardAdd(true, &receiver);
+  ASSERT_TRUE(listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName,
+                             &mock_receiver_));
+
+  EXPECT_CALL(mock_receiver_, ReportEvent(kName, "1"))
+      .WillOnce(Return(true));
+  EXPECT_CALL(mock_receiver_, ReportEvent(kName, "2"))
+      .WillOnce(Return(true));
+
+  EXPECT_TRUE(receiver->ReportEvent(kName, "1"));
+  EXPECT_TRUE(receiver->ReportEvent(kName, "2"));
+  listener_->WaitForCallbacks();
+
+  const vector<ShardedEventfdListener::ShardStats> stats =
+      listener_->GetShardStats();
+  ASSERT_EQ(kNumShards, stats.size());
+  const ShardedEventfdListener::ShardStats &shard_stats =
+      stats[listener_->ShardFor(kCgroupPath)];
+  EXPECT_EQ(0, shard_stats.queue_depth);
+  EXPECT_EQ(2, shard_stats.num_callbacks);
+  EXPECT_LE(0, shard_stats.total_callback_latency_usec);
+  EXPECT_LE(shard_stats.max_callback_latency_usec,
+            shard_stats.total_callback_latency_usec);
+}
+
+TEST_F(ShardedEventfdListenerTest, ReportEventStops) {
+  EventReceiverInterface *receiver = nullptr;
+  ExpectShardAdd(true, &receiver);
+  ASSERT_TRUE(listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName,
+                             &mock_receiver_));
+
+  EXPECT_CALL(mock_receiver_, ReportEvent(kName, "1"))
+      .WillOnce(Return(false));
+
+  EXPECT_TRUE(receiver->ReportEvent(kName, "1"));
+  listener_->WaitForCallbacks();
+
+  // The event is stopped on the next notification.
+  EXPECT_FALSE(receiver->ReportEvent(kName, "2"));
+
+  // The receiver is kept until the shard terminates the event.
+  EXPECT_EQ(1, listener_->ReceiverCount());
+  EXPECT_CALL(mock_receiver_, ReportExit(kName, listener_.get()));
+  receiver->ReportExit(kName, mock_shards_[listener_->ShardFor(kCgroupPath)]);
+  listener_->WaitForCallbacks();
+  EXPECT_EQ(0, listener_->ReceiverCount());
+}
+
+TEST_F(ShardedEventfdListenerTest, ReportError) {
+  EventReceiverInterface *receiver = nullptr;
+  ExpectShardAdd(true, &receiver);
+  ASSERT_TRUE(listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName,
+                             &mock_receiver_));
+
+  // The sharded listener is reported, not the shard.
+  EXPECT_CALL(mock_receiver_, ReportError(kName, listener_.get()));
+
+  receiver->ReportError(kName, mock_shards_[listener_->ShardFor(kCgroupPath)]);
+  listener_->WaitForCallbacks();
+  EXPECT_EQ(0, listener_->ReceiverCount());
+}
+
+TEST_F(ShardedEventfdListenerTest, ReportExitAfterQueuedEvents) {
+  EventReceiverInterface *receiver = nullptr;
+  ExpectShardAdd(true, &receiver);
+  ASSERT_TRUE(listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName,
+                             &mock_receiver_));
+
+  // The receiver is released only after the callbacks queued before the exit
+  // have run.
+  Notification release_event;
+  {
+    InSequence sequence;
+    EXPECT_CALL(mock_receiver_, ReportEvent(kName, "1"))
+        .WillOnce(Invoke([&release_event](const string &, const string &) {
+          release_event.WaitForNotification();
+          return true;
+        }));
+    EXPECT_CALL(mock_receiver_, ReportExit(kName, listener_.get()));
+  }
+
+  EXPECT_TRUE(receiver->ReportEvent(kName, "1"));
+  receiver->ReportExit(kName, mock_shards_[listener_->ShardFor(kCgroupPath)]);
+  EXPECT_EQ(1, listener_->ReceiverCount());
+  release_event.Notify();
+  listener_->WaitForCallbacks();
+  EXPECT_EQ(0, listener_->ReceiverCount());
+}
+
+TEST_F(ShardedEventfdListenerTest, SlowCallbackDoesNotBlockOtherEvents) {
+  const char kOtherPath[] = "/dev/cgroup/memory/test2";
+  MockEventReceiverInterface *const kNoReceiver = nullptr;
+  StrictMock<MockEventReceiverInterface> other_receiver;
+  EventReceiverInterface *receivers[2] = {nullptr, nullptr};
+  for (MockEventfdListener *shard : mock_shards_) {
+    EXPECT_CALL(*shard, Add(_, kCgroupFile, kArgs, kName, NotNull()))
+        .WillRepeatedly(Invoke([&receivers](
+            const string &basepath, const string &, const string &,
+            const string &, EventReceiverInterface *receiver) {
+          receivers[basepath == kCgroupPath ? 0 : 1] = receiver;
+          return true;
+        }));
+  }
+  ASSERT_TRUE(listener_->Add(kCgroupPath, kCgroupFile, kArgs, kName,
+                             &mock_receiver_));
+  ASSERT_TRUE(listener_->Add(kOtherPath, kCgroupFile, kArgs, kName,
+                             &other_receiver));
+  ASSERT_NE(kNoReceiver, receivers[0]);
+  ASSERT_NE(kNoReceiver, receivers[1]);
+
+  // The first callback blocks until the second one has run.
+  Notification other_delivered;
+  EXPECT_CALL(mock_receiver_, ReportEvent(kName, "1"))
+      .WillOnce(Invoke([&other_delivered](const string &, const string &) {
+        other_delivered.WaitForNotification();
+        return true;
+      }));
+  EXPECT_CALL(other_receiver, ReportEvent(kName, "1"))
+      .WillOnce(Invoke([&other_delivered](const string &, const string &) {
+        other_delivered.Notify();
+        return true;
+      }));
+
+  EXPECT_TRUE(receivers[0]->ReportEvent(kName, "1"));
+  EXPECT_TRUE(receivers[1]->ReportEvent(kName, "1"));
+  listener_->WaitForCallbacks();
+}
+
+TEST_F(ShardedEventfdListenerTest, StartStartsStoppedShards) {
+  EXPECT_CALL(*mock_shards_[0], IsNotRunning())
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_shards_[1], IsNotRunning())
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*mock_shards_[0], Start());
+
+  listener_->Start();
+  EXPECT_FALSE(listener_->IsNotRunning());
+}
+
+TEST_F(ShardedEventfdListenerTest, Stop) {
+  for (MockEventfdListener *shard : mock_shards_) {
+    EXPECT_CALL(*shard, WaitUntilStopped());
+  }
+
+  listener_->Stop();
+}
+
+}  // namespace
+}  // namespace util